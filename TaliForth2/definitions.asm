@@ -209,7 +209,7 @@ cold_zp_table_end:
 cold_user_table:
     .logical 0          ; make labels here offsets that we can add to 'up'
 
-nc_limit_offset:        .word 20        ; byte limit for Native Compile size
+nc_limit_offset:        .word TALI_OPTION_NC_LIMIT ; byte limit for Native Compile size
 uf_strip_offset:        .word 0         ; flag to strip underflow detection (0 off)
 
 ; Block variables
@@ -72,7 +72,9 @@ io_getc:        .byte ?         ; $f004     non-blocking read input character (0
 io_clk_start:   .byte ?         ; $f006     *read* to start cycle counter
 io_clk_stop:    .byte ?         ; $f007     *read* to stop the cycle counter
 io_clk_cycles:  .word ?,?       ; $f008-b   32-bit cycle count in NUXI order
-                .word ?,?
+io_perf_tag:    .byte ?         ; $f00c     write to start a profiling region (c65 only)
+io_perf:        .byte ?         ; $f00d     write to copy the performance counters (c65 only)
+io_perf_buffer: .word ?         ; $f00e     Little endian address of 40 byte counter buffer
 
 .cerror * != io_start + $10, "Mismatched magic IO interface"
 
@@ -6,10 +6,14 @@
 ; Memory map:
 ;   $0000-$007F  Zero page: Tali variables + data stack
 ;   $0080-$0091  Zero page: keyboard buffer (kernel)
+;   $0092-$0093  Zero page: output buffer state (kernel)
+;   $0094-$0097  Zero page: block copy pointers (kernel)
 ;   $0100-$01FF  Return stack (hardware stack)
 ;   $0200-$02FF  Input buffer
+;   $0300-$03FE  Output buffer (kernel)
 ;   $0400+       Tali code + kernel (this binary)
 ;   cp0+         Dictionary (grows upward to ram_end)
+;   $9000-$9FFF  Block cache, 4 x 1 KiB (kernel)
 ;   $9FFF        End of main RAM
 ;   $E040        Pi Pico bridge I/O port
 
@@ -19,8 +23,8 @@
 ; =====================================================================
 ; Memory configuration
 
-ram_end = $9FFF
-cp0 = $3C00                     ; dictionary starts after code
+ram_end = $8FFF                 ; block cache above
+cp0 = $4400                     ; dictionary starts after code
                                 ; must be past end of all assembled code
                                 ; (assertion at bottom verifies this)
 
@@ -28,6 +32,7 @@ cp0 = $3C00                     ; dictionary starts after code
 ; I/O constants
 
 RPI_PORT = $E040                 ; single-byte I/O port to Pi Pico bridge
+DEV_STATUS = 0                   ; device 0: status (read)
 DEV_VIDEO_KB = 2                 ; device 2: video (write) / keyboard (read)
 
 ; Keyboard buffer in upper zero page
@@ -36,6 +41,17 @@ kb_count = $81                   ; number of bytes in buffer
 kb_buf   = $82                   ; 16-byte buffer ($82-$91)
 KB_SIZE  = 16
 
+; Output buffer, sent to video as one TLV write (max len 255)
+out_count = $92                  ; number of bytes in buffer
+out_len  = $93                   ; scratch for kernel_type
+out_buf  = $0300                 ; 255-byte buffer ($0300-$03FE)
+OUT_SIZE = 255
+
+; Block cache and its copy pointers (words/netblock.asm)
+blk_src = $94
+blk_dst = $96
+blk_cache = $9000
+
 ; =====================================================================
 ; Entry point — netboot loads binary here and jumps to $0400
 
@@ -44,11 +60,15 @@ KB_SIZE  = 16
 ; =====================================================================
 ; Build options (minimal for RAM conservation)
 
-TALI_OPTIONAL_WORDS := [ ]
+TALI_OPTIONAL_WORDS := [ "block" ]
 TALI_OPTION_CR_EOL := [ "lf" ]
 TALI_OPTION_HISTORY := 0
 TALI_OPTION_TERSE := 1
 TALI_OPTION_MAX_COLS := 40       ; 40-column terminal
+; Inlining for the application at hand: regenerate these two with
+; tools/native_profile.py from a c65 heatmap of it running
+TALI_OPTION_NC_LIMIT := 20
+TALI_OPTION_ALWAYS_NATIVE := [ ]
 
 ; =====================================================================
 ; Kernel routines
@@ -60,6 +80,7 @@ kernel_init:
 
                 stz kb_head
                 stz kb_count
+                stz out_count
 
                 ldx #0
 -               lda s_kernel_id,x
@@ -73,20 +94,86 @@ _done:
 
 kernel_bye:
         ; Exit Forth — jump through reset vector to restart bootloader
+                jsr kernel_flush
+                jsr blk_writeback
                 jmp ($FFFC)
 
 
 kernel_putc:
         ; Print character in A to video (Device 2).
-        ; TLV write: [device=2] [len=1] [char]
-        ; Preserves X and Y (only uses A and stack).
+        ; Characters collect in out_buf and go out as one TLV write at the
+        ; end of a line, when the buffer fills, or when input is awaited.
+        ; Preserves X and Y.
+                phy
+                ldy out_count
+                sta out_buf,y
+                iny
+                sty out_count
+                cpy #OUT_SIZE
+                beq _flush
+                cmp #AscLF
+                beq _flush
+                cmp #AscCR
+                bne _done
+_flush:
+                jsr kernel_flush
+_done:
+                ply
+                rts
+
+
+kernel_type:
+        ; Print A (1-255) characters from (tmp1) for TYPE. They are
+        ; buffered like kernel_putc's, a whole string at a time, sending
+        ; what is already waiting first if there isn't room.
+        ; Preserves X.
+                sta out_len
+                clc
+                adc out_count
+                bcc +
+                jsr kernel_flush
++
+                phx
+                ldx out_count
+                ldy #0
+-
+                lda (tmp1),y
+                sta out_buf,x
+                inx
+                iny
+                cpy out_len
+                bne -
+                stx out_count
+                cpx #OUT_SIZE
+                bne +
+                jsr kernel_flush
++
+                plx
+                rts
+
+
+kernel_flush:
+        ; Send the output buffer to video (Device 2).
+        ; TLV write: [device=2] [len] [chars...]
+        ; Preserves A, X and Y.
                 pha
+                phy
+                ldy out_count
+                beq _done
                 lda #DEV_VIDEO_KB
                 sta RPI_PORT
-                lda #1
+                sty RPI_PORT
+                ldy #0
+-
+                lda out_buf,y
                 sta RPI_PORT
+                iny
+                cpy out_count
+                bne -
+                stz out_count
+_done:
+                ply
                 pla
-                sta RPI_PORT
                 rts
 
 
@@ -96,6 +183,7 @@ kernel_getc:
         ;
         ; Uses a 16-byte ring buffer to handle multi-byte TLV responses
         ; (ANSI escape sequences, buffered keystrokes).
+                jsr kernel_flush        ; show output before waiting
                 phx
                 phy
 
@@ -103,7 +191,9 @@ kernel_getc:
                 lda kb_count
                 bne _from_buf
 
-                ; Buffer empty — do TLV read from Device 2
+                ; Buffer empty — write back cached blocks while the
+                ; user is idle, then do TLV read from Device 2
+                jsr blk_writeback
 _read_device:
                 lda #(DEV_VIDEO_KB | $80)
                 sta RPI_PORT
@@ -155,6 +245,7 @@ _from_buf:
 kernel_kbhit:
         ; Check if a character is available. Returns non-zero in A if yes.
         ; Preserves X and Y.
+                jsr kernel_flush        ; callers poll this while they wait
                 lda kb_count
                 bne _has_key
 
@@ -203,7 +294,10 @@ s_kernel_id:
         .text "Tali Forth 2 on mattbrew", AscLF, 0
 
 ; =====================================================================
-; Include Tali Forth 2
+; Include Tali Forth 2, along with the extra words we need
+
+prev_nt := 0
+.include "words/netblock.asm"
 
 .include "../../taliforth.asm"
 
@@ -213,6 +307,13 @@ s_kernel_id:
 
 .cerror * > cp0, "Code exceeds cp0 — increase cp0 in memory configuration"
 
+; Boot compiles no Forth source: every word is native, TERSE drops the splash
+; strings and platform_forth.fs isn't included, so COLD evaluates nothing and
+; the dictionary starts empty at cp0. Keep it that way -- at 1 MHz, source
+; evaluated on every reset costs seconds -- by adding words in assembly.
+
+.cerror user_words_end != user_words_start, "mattbrew should boot without compiling Forth source"
+
 ; No interrupt vectors — this is a RAM program.
 ; The ROM bootloader owns $FFFA-$FFFF.
 
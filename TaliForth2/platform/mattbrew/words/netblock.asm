@@ -0,0 +1,432 @@
+;----------------------------------------------------------------------
+; Network block storage
+;----------------------------------------------------------------------
+
+; Blocks live in a file on the Zero, block u at byte u*1024, reached
+; through the File read device (see protocol.md): a block is read with
+; one 1024-byte request and written as BLK_CHUNK-byte 'W' commands.
+;
+; The kernel keeps the last BLK_SLOTS blocks used in blk_cache, so
+; BLOCK-READ of a cached block doesn't ask the Zero and BLOCK-WRITE only
+; updates the cache.  A dirty block goes to the Zero when its slot is
+; reused (least recently used first), when the kernel waits for a key,
+; and at BYE.
+
+DEV_FILE = 6                    ; device 6: file read (write/read)
+BLK_SLOTS = 4                   ; cached blocks (1 KiB each, at blk_cache)
+BLK_CHUNK = 128                 ; data bytes per 'W' command
+BLK_NAME_MAX = 32               ; longest block file name
+
+; Slot states, as in Tali's buffstatus
+BLK_FREE = 0
+BLK_CLEAN = 1
+BLK_DIRTY = 3
+
+
+#nt_header block_mattbrew_init, "block-mattbrew-init"
+
+; ## BLOCK_MATTBREW_INIT ( addr u -- f ) "Use a file on the Zero for blocks"
+; ## "block-mattbrew-init"  tested ad hoc
+        ; """Set up block IO to read/write the named file on the Zero,
+        ; e.g. `s" forth.blk" block-mattbrew-init`.  Returns true if the
+        ; file exists and false otherwise (nothing is created).  Dirty
+        ; blocks of the previous file are written first."""
+
+xt_block_mattbrew_init:
+        jsr underflow_2
+w_block_mattbrew_init:
+        jsr blk_writeback
+
+        lda 2,x                 ; ( addr u )
+        sta tmp1
+        lda 3,x
+        sta tmp1+1
+        lda 1,x
+        bne _long
+        lda 0,x
+        cmp #BLK_NAME_MAX+1
+        bcc +
+_long:
+        lda #BLK_NAME_MAX
++
+        sta blk_name_len
+        ldy #0
+-
+        cpy blk_name_len
+        beq +
+        lda (tmp1),y
+        sta blk_name,y
+        iny
+        bra -
++
+        ; Empty the cache
+        ldy #BLK_SLOTS-1
+-
+        lda #BLK_FREE
+        sta blk_state,y
+        tya
+        sta blk_order,y
+        dey
+        bpl -
+
+        ; Stat: [off x 3] [0 0] ['S'] [name_len] [name...]
+        stz blk_off
+        stz blk_off+1
+        stz blk_off+2
+        lda blk_name_len
+        clc
+        adc #7
+        jsr blk_header
+        stz RPI_PORT
+        stz RPI_PORT
+        lda #'S'
+        sta RPI_PORT
+        lda blk_name_len
+        sta RPI_PORT
+        jsr blk_send_name
+        jsr blk_ack             ; A = 1 if the file exists
+
+        inx                     ; ( f )
+        inx
+        cmp #1                  ; C = ok
+        lda #0
+        sbc #0                  ; 0 or -1
+        eor #$ff
+        sta 0,x
+        sta 1,x
+        beq z_block_mattbrew_init
+
+        jsr push_inline_literal ; set block read/write vectors
+        .word blk_read
+        jsr w_block_read_vector
+        jsr w_store
+
+        jsr push_inline_literal
+        .word blk_write
+        jsr w_block_write_vector
+        jsr w_store
+
+z_block_mattbrew_init:
+        rts
+
+
+blk_read:
+        ; BLOCK-READ vector ( addr blk# -- )
+        sec                     ; fetch on a miss
+        jsr blk_find
+        jsr blk_slot_page
+        sta blk_src+1
+        stz blk_src
+        lda 2,x
+        sta blk_dst
+        lda 3,x
+        sta blk_dst+1
+        jsr blk_copy
+        bra blk_drop2
+
+blk_write:
+        ; BLOCK-WRITE vector ( addr blk# -- )
+        clc                     ; the whole block is replaced
+        jsr blk_find
+        lda 2,x
+        sta blk_src
+        lda 3,x
+        sta blk_src+1
+        jsr blk_slot_page
+        sta blk_dst+1
+        stz blk_dst
+        jsr blk_copy
+        ldy blk_slot
+        lda #BLK_DIRTY
+        sta blk_state,y
+blk_drop2:
+        inx
+        inx
+        inx
+        inx
+        rts
+
+
+blk_find:
+        ; Find block (0,x) in the cache, or reuse the least recently used
+        ; slot for it, writing that slot back first if it's dirty and then
+        ; reading the block from the Zero if C is set.  Leaves the slot in
+        ; blk_slot, first in blk_order.  Preserves X.
+        php
+        ldy #BLK_SLOTS-1
+-
+        lda blk_state,y
+        beq _next
+        lda blk_num_lo,y
+        cmp 0,x
+        bne _next
+        lda blk_num_hi,y
+        cmp 1,x
+        beq _hit
+_next:
+        dey
+        bpl -
+
+        ; Free slots are never used, so they are always last in blk_order.
+        ldy blk_order+BLK_SLOTS-1
+        sty blk_slot
+        lda blk_state,y
+        cmp #BLK_DIRTY
+        bne +
+        jsr blk_store
++
+        ldy blk_slot
+        lda 0,x
+        sta blk_num_lo,y
+        lda 1,x
+        sta blk_num_hi,y
+        lda #BLK_CLEAN
+        sta blk_state,y
+        plp
+        bcc _touch
+        jsr blk_fetch
+        bra _touch
+_hit:
+        sty blk_slot
+        plp
+_touch:
+        ; Move blk_slot to the front of blk_order
+        ldy #0
+-
+        lda blk_order,y
+        cmp blk_slot
+        beq +
+        iny
+        bra -
++
+-
+        cpy #0
+        beq +
+        lda blk_order-1,y
+        sta blk_order,y
+        dey
+        bra -
++
+        lda blk_slot
+        sta blk_order
+        rts
+
+
+blk_writeback:
+        ; Write every dirty cached block to the Zero.  Preserves X.
+        ldy #BLK_SLOTS-1
+-
+        lda blk_state,y
+        cmp #BLK_DIRTY
+        bne +
+        sty blk_slot
+        jsr blk_store
+        ldy blk_slot
++
+        dey
+        bpl -
+        rts
+
+
+blk_fetch:
+        ; Read blk_slot's block from the Zero into its buffer.
+        ; Request: [off x 3] [0 4] [name...], reply: 1024 bytes
+        lda #0
+        jsr blk_set_offset
+        lda blk_name_len
+        clc
+        adc #5
+        jsr blk_header
+        stz RPI_PORT            ; count = 1024
+        lda #>1024
+        sta RPI_PORT
+        jsr blk_send_name
+
+        jsr blk_slot_page
+        sta blk_dst+1
+        stz blk_dst
+        phx
+        ldx #4                  ; pages to go
+        ldy #0                  ; offset in this page
+_read:
+        lda #(DEV_FILE | $80)
+        sta RPI_PORT
+-
+        lda RPI_PORT
+        cmp #$FF
+        beq -
+        sta blk_left
+        cmp #0
+        beq _read               ; len=0: no data yet, retry
+_byte:
+        lda RPI_PORT
+        sta (blk_dst),y
+        iny
+        bne +
+        inc blk_dst+1
+        dex
++
+        dec blk_left
+        bne _byte
+        cpx #0
+        bne _read
+        plx
+        rts
+
+
+blk_store:
+        ; Write blk_slot's buffer to the Zero and mark it clean.
+        ; Each command: [off x 3] [0 0] ['W'] [name_len] [name...] [data...]
+        jsr blk_slot_page
+        sta blk_src+1
+        stz blk_src
+        stz blk_chunk
+_chunk:
+        lda blk_chunk
+        jsr blk_set_offset
+        lda blk_name_len
+        clc
+        adc #7+BLK_CHUNK
+        jsr blk_header
+        stz RPI_PORT
+        stz RPI_PORT
+        lda #'W'
+        sta RPI_PORT
+        lda blk_name_len
+        sta RPI_PORT
+        jsr blk_send_name
+        ldy #0
+-
+        lda (blk_src),y
+        sta RPI_PORT
+        iny
+        cpy #BLK_CHUNK
+        bne -
+        jsr blk_ack
+
+        lda blk_src
+        clc
+        adc #BLK_CHUNK
+        sta blk_src
+        bcc +
+        inc blk_src+1
++
+        inc blk_chunk
+        lda blk_chunk
+        cmp #1024/BLK_CHUNK
+        bne _chunk
+
+        ldy blk_slot
+        lda #BLK_CLEAN
+        sta blk_state,y
+        rts
+
+
+blk_ack:
+        ; Read a file command's reply, [ok] [size x 3], into blk_reply.
+        ; Returns ok in A.  Preserves X.
+        phx
+        ldx #0
+_read:
+        lda #(DEV_FILE | $80)
+        sta RPI_PORT
+-
+        lda RPI_PORT
+        cmp #$FF
+        beq -
+        tay
+        beq _read               ; len=0: no data yet, retry
+-
+        lda RPI_PORT
+        sta blk_reply,x
+        inx
+        dey
+        bne -
+        cpx #4
+        bcc _read
+        plx
+        lda blk_reply
+        rts
+
+
+blk_set_offset:
+        ; Set blk_off to blk_slot's block * 1024 + A * BLK_CHUNK (A = 0-7).
+        lsr                     ; C = chunk bit 0
+        sta blk_off+1
+        lda #0
+        ror
+        sta blk_off
+        ldy blk_slot
+        lda blk_num_lo,y
+        asl
+        asl
+        ora blk_off+1
+        sta blk_off+1
+        lda blk_num_hi,y
+        asl
+        asl
+        sta blk_off+2
+        lda blk_num_lo,y
+        lsr
+        lsr
+        lsr
+        lsr
+        lsr
+        lsr
+        ora blk_off+2
+        sta blk_off+2
+        rts
+
+
+blk_header:
+        ; Start a device 6 write of A bytes: [6] [A] [off x 3]
+        pha
+        lda #DEV_FILE
+        sta RPI_PORT
+        pla
+        sta RPI_PORT
+        lda blk_off
+        sta RPI_PORT
+        lda blk_off+1
+        sta RPI_PORT
+        lda blk_off+2
+        sta RPI_PORT
+        rts
+
+
+blk_send_name:
+        ldy #0
+-
+        cpy blk_name_len
+        beq +
+        lda blk_name,y
+        sta RPI_PORT
+        iny
+        bra -
++
+        rts
+
+
+blk_slot_page:
+        ; Return the high byte of blk_slot's buffer in A.
+        lda blk_slot
+        asl
+        asl
+        clc
+        adc #>blk_cache
+        rts
+
+
+; Cache state.  The binary is loaded to RAM, so these are assembled as
+; zeros: every slot starts free.
+blk_name_len:   .byte 0
+blk_name:       .fill BLK_NAME_MAX
+blk_num_lo:     .fill BLK_SLOTS         ; block in each slot
+blk_num_hi:     .fill BLK_SLOTS
+blk_state:      .fill BLK_SLOTS         ; BLK_FREE, BLK_CLEAN or BLK_DIRTY
+blk_order:      .byte range(BLK_SLOTS)  ; slots, most recently used first
+blk_off:        .fill 3                 ; file offset of a request
+blk_reply:      .fill 4                 ; last command reply
+blk_chunk:      .byte 0                 ; BLK_CHUNK pieces written so far
+blk_left:       .byte 0                 ; bytes left in a TLV
+blk_slot:       .byte 0                 ; slot being worked on
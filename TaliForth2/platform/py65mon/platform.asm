@@ -73,6 +73,13 @@ TALI_OPTION_CR_EOL := [ "lf" ]
 TALI_OPTION_HISTORY := 1
 ;TALI_OPTION_HISTORY := 0
 
+; TALI_OPTION_NC_LIMIT is the starting nc-limit, and TALI_OPTION_ALWAYS_NATIVE
+; lists words to always natively compile, e.g. hot ones picked by
+; tools/native_profile.py from a c65 heatmap of an application.
+
+TALI_OPTION_NC_LIMIT := 20
+TALI_OPTION_ALWAYS_NATIVE := [ ]
+
 ; TALI_OPTION_TERSE strips or shortens various strings to reduce the memory
 ; footprint when set to 1 (~0.5K)
 
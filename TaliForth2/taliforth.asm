@@ -28,9 +28,22 @@ TALI_OPTION_TERSE :?= 0
 ; Default to ctrl-n/p accept history
 TALI_OPTION_HISTORY :?= 1
 
+; Default NC-LIMIT, the longest word natively compiled
+TALI_OPTION_NC_LIMIT :?= 20
+
+; Words to flag always native (AN) on top of those in headers.asm,
+; e.g. from tools/native_profile.py
+TALI_OPTION_ALWAYS_NATIVE :?= [ ]
+
 ; Optional hardware/simulator architecture name for customization
 TALI_ARCH :?= ""
 
+; Optional kernel routine that prints A (1-255) characters from (tmp1) in one
+; go, preserving X; TYPE uses it while OUTPUT is kernel_putc.
+.weak
+kernel_type = 0
+.endweak
+
 ; Label used to calculate UNUSED based on the hardware configuration in platform/
 code0:
 
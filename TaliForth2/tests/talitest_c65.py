@@ -10,18 +10,21 @@ PROGRAMMERS : Sam Colwell, Scot W. Stevenson, Patrick Surry
 FILE        : talitest_c65.py
 
 First version: 16. May 2018
-This version: 06. Apr 2024
+This version: 14. Oct 2026
 """
 
 import argparse
+import os
 import sys
 
 import subprocess
+from concurrent.futures import ThreadPoolExecutor
 
 
 TESTER = 'tester.fs'
 RESULTS = 'results.txt'
 BLOCK_FILE = 'blocks.bin'
+SNAPSHOT_FILE = 'tester.snap'
 C65_LOCATION = '../tools/c65/c65'
 TALIFORTH_LOCATION = '../taliforth-c65.bin'
 TALI_ERRORS = ['Undefined word',
@@ -58,6 +61,9 @@ parser.add_argument('-s', '--suppress_tester', action='store_true',
                     help='Suppress the output while the tester is loading', default=False)
 parser.add_argument('-t', '--tests', nargs='+', type=str, default=['all'],
                     help=TESTS_HELP)
+parser.add_argument('-j', '--jobs', type=int, default=1,
+                    help='Run tests in this many parallel c65 processes, '
+                    'each resuming from a snapshot taken after loading the tester')
 args = parser.parse_args()
 
 # Make sure we were given a legal list of tests: Must be either 'all' or one or
@@ -71,32 +77,63 @@ if args.tests == ['all']:
 
 # Load the tester first.
 with open(TESTER, 'r') as tester:
-    # Create a string with all of the tests we will be running in it.
-    test_string = tester.read()
+    tester_string = tester.read()
 
-# Load all of the tests selected from the command line.
-for test in args.tests:
 
-    # Determine the test file name.
+def test_source(test):
+    """Return the Forth source for one test file, headed by a comment"""
     testfile = test + '.fs'
 
     with open(testfile, 'r') as infile:
-        # Add a forth comment with the test file name.
-        test_string = test_string +\
-                      "\n ( Running test '{0}' from file '{1}' )\n".\
-                      format(test, testfile)
-        # Add the tests.
-        test_string = test_string + infile.read()
+        return "\n ( Running test '{0}' from file '{1}' )\n".\
+               format(test, testfile) + infile.read()
 
-# Have Tali2 quit at the end of all the tests.
-test_string = test_string + "\nbye\n"
 
-# Create an empty block file
-open(BLOCK_FILE, 'wb').close()
+def run_c65(options, source):
+    """Run c65 with the given options feeding it source, return its output"""
+    process = subprocess.Popen([C65_LOCATION] + options,
+                               stdin=subprocess.PIPE, stdout=subprocess.PIPE)
+    (raw, err) = process.communicate(source.encode('ascii'))
+    return raw.decode('ascii', 'ignore')
 
-process = subprocess.Popen([C65_LOCATION, '-r', TALIFORTH_LOCATION, '-b', BLOCK_FILE], stdin=subprocess.PIPE, stdout=subprocess.PIPE)
-(raw, err) = process.communicate(test_string.encode('ascii'))
-out = raw.decode('ascii', 'ignore')
+
+def run_shard(test):
+    """Run one test from the post-tester snapshot with its own block file"""
+    block_file = 'blocks_' + test + '.bin'
+    open(block_file, 'wb').close()
+    try:
+        # Have Tali2 quit at the end of the test.
+        return run_c65(['-R', SNAPSHOT_FILE, '-b', block_file],
+                       test_source(test) + "\nbye\n")
+    finally:
+        os.remove(block_file)
+
+
+if args.jobs > 1:
+    # Boot Tali and load the tester once.  c65 exits at the end of its
+    # input, still polling for the next key, and snapshots the machine
+    # so that every test can start from there in its own process.
+    tester_out = run_c65(['-q', '-r', TALIFORTH_LOCATION, '-S', SNAPSHOT_FILE],
+                         tester_string)
+
+    with ThreadPoolExecutor(max_workers=args.jobs) as pool:
+        shard_outs = list(pool.map(run_shard, args.tests))
+
+    os.remove(SNAPSHOT_FILE)
+    out = tester_out + ''.join(shard_outs)
+    crashed = not all("bye c65:" in shard for shard in shard_outs)
+
+else:
+    # Create a string with the tester followed by all of the tests we
+    # will be running in it, and have Tali2 quit at the end.
+    test_string = tester_string + ''.join(map(test_source, args.tests)) +\
+                  "\nbye\n"
+
+    # Create an empty block file
+    open(BLOCK_FILE, 'wb').close()
+
+    out = run_c65(['-r', TALIFORTH_LOCATION, '-b', BLOCK_FILE], test_string)
+    crashed = "bye c65:" not in out
 
 # Log the results
 with open(args.output, 'w') as fout:
@@ -108,7 +145,7 @@ print('='*80)
 print('Summary for: ' + ' '.join(args.tests))
 
 # Check to see if we crashed before reading all of the tests.
-if f"bye c65:" not in out:
+if crashed:
     print("Tali Forth 2 crashed before all tests completed\n")
 else:
     print("Tali Forth 2 ran all tests requested")
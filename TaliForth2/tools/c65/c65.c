@@ -13,16 +13,18 @@
 #include "c65.h"
 #include "magicio.h"
 #include "monitor.h"
+#include "history.h"
 
 uint8_t memory[0x10000];
 uint8_t breakpoints[0x10000];
-uint64_t heat_rs[0x10000];
-uint64_t heat_ws[0x10000];
-uint64_t heat_xs[0x10000];
+heat_t heat_rs[0x10000];
+heat_t heat_ws[0x10000];
+heat_t heat_xs[0x10000];
 
 uint64_t ticks = 0;
 
 int break_flag = 0, step_mode = STEP_RUN, step_target = -1, quiet = 0;
+static int brk_action = MONITOR_EXIT;
 uint16_t rw_brk;
 
 static uint8_t _opmodes[256] = { 255 };
@@ -75,10 +77,140 @@ const char* opfmt(uint8_t op) {
 }
 
 
+/*
+  page_flags marks the 256-byte pages where a memory access needs more
+  than a plain array read or write: PAGE_IO for the magic IO block at
+  io_addr, PAGE_WATCH where the monitor has set read/write breakpoints
+  (see update_watch_pages), PAGE_VECTOR for the BRK check below and
+  PAGE_CODE where the block cache holds decoded code.
+  Every other access costs one table lookup.
+*/
+uint8_t page_flags[0x100];
+
+void update_watch_pages(int start, int end) {
+  int page, addr;
+
+  /* recompute PAGE_WATCH for every page overlapping [start, end) */
+  for (page = start >> 8; page <= (end - 1) >> 8; page++) {
+    page_flags[page] &= ~PAGE_WATCH;
+    for (addr = page << 8; addr < (page + 1) << 8; addr++)
+      if (breakpoints[addr] & MONITOR_DATA) {
+        page_flags[page] |= PAGE_WATCH;
+        break;
+      }
+  }
+}
+
+static void set_io_pages() {
+  /* the magic IO block needn't be page aligned */
+  page_flags[(io_addr >> 8) & 0xff] |= PAGE_IO;
+  if (io_addr + 0xff < 0x10000) page_flags[(io_addr + 0xff) >> 8] |= PAGE_IO;
+}
+
+/*
+  With no debugger attached nothing looks at breakpoints or the heatmap,
+  so main() runs the CPU in batches through exec6502() with run_fast set
+  and memory accesses skip straight to the array.  Only the magic IO page
+  is still routed through io_magic_read/write, with ticks brought up to
+  date first for the timer.  Anything that would have stopped the step
+  loop (BRK exit, EOF on getc) zeroes clockgoal6502 so the batch ends
+  after the current instruction.
+*/
+#define RUN_BATCH_TICKS 100000
+
+static int run_fast = 0;
+static uint64_t run_base;
+
+static void run_sync_io(void) {
+  ticks = run_base + clockticks6502;
+}
+
+static void run_check_break(void) {
+  if (break_flag) clockgoal6502 = 0;
+}
+
+/*
+  -c runs the batches through execblocks6502(), fake65c02's cache of
+  decoded basic blocks.  Pages it caches are marked PAGE_CODE, and the
+  first write to one drops its blocks.  The magic IO page is never
+  cached so instruction fetches from it still reach io_magic_read.
+*/
+static int run_cached = 0;
+
+int cachepage6502(uint8_t page) {
+  if (page_flags[page] & PAGE_IO) return 0;
+  page_flags[page] |= PAGE_CODE;
+  return 1;
+}
+
+/* Drop the cached blocks of a page written behind write6502's back. */
+void flush_code_page(uint8_t page) {
+  if (!(page_flags[page] & PAGE_CODE)) return;
+  page_flags[page] &= ~PAGE_CODE;
+#ifdef FAKE6502_BLOCK_CACHE
+  flushpage6502(page);
+#endif
+}
+
+/*
+  -p samples the CPU every prof_interval ticks, debugger or not, writing
+  the address of the instruction running at that tick to prof_file as
+  one hex line per sample.  It's driven from fake65c02's loopexternal
+  hook so a run without -p pays nothing for it.
+*/
+static FILE *prof_file = NULL;
+static uint32_t prof_interval = 1000;
+static uint64_t prof_next;
+static uint16_t prof_pc;
+
+static void profile_sample(void) {
+  /* called at the end of each instruction, inside exec6502 or step6502 */
+  uint64_t now = (run_fast ? run_base : ticks) + clockticks6502;
+
+  while (now >= prof_next) {
+    fprintf(prof_file, "%04x\n", prof_pc);
+    prof_next += prof_interval;
+  }
+  prof_pc = pc;
+}
+
+/*
+  Bus accesses for the magic IO performance counters.  With -c an
+  instruction's fetches are counted once, when execblocks6502 decodes
+  its block, rather than each time it runs from the cache.
+*/
+uint64_t reads6502 = 0, writes6502 = 0;
+
+void perf_read(uint64_t counters[PERF_COUNTERS]) {
+  counters[PERF_CYCLES] = ticks;
+  counters[PERF_INSTRUCTIONS] = instructions;
+  counters[PERF_PENALTY] = penaltyticks6502;
+  counters[PERF_READS] = reads6502;
+  counters[PERF_WRITES] = writes6502;
+}
+
 uint8_t read6502(uint16_t addr) {
-  io_magic_read(addr);
-  heat_rs[addr] += 1;
-  if (breakpoints[addr] & MONITOR_READ) {
+  uint8_t flags = page_flags[addr >> 8];
+
+  reads6502++;
+  if (run_fast) {
+    if (flags) {
+      if (flags & PAGE_IO) {
+        run_sync_io();
+        io_magic_read(addr);
+      }
+      if ((flags & PAGE_VECTOR) && addr == 0xffff && opcode == 0x00) {
+        /* BRK fetching the high byte of its vector */
+        break_flag |= MONITOR_EXIT;
+      }
+      run_check_break();
+    }
+    return memory[addr];
+  }
+  if (flags & PAGE_IO) io_magic_read(addr);
+  HEAT_INC(heat_rs[addr]);
+  if ((flags & PAGE_WATCH) && (breakpoints[addr] & MONITOR_READ)
+      && (!(breakpoints[addr] & MONITOR_COND) || monitor_break_hit(addr))) {
     break_flag |= MONITOR_READ;
     rw_brk = addr;
   }
@@ -86,9 +218,23 @@ uint8_t read6502(uint16_t addr) {
 }
 
 void write6502(uint16_t addr, uint8_t val) {
-  io_magic_write(addr, val);
-  heat_ws[addr] += 1;
-  if (breakpoints[addr] & MONITOR_WRITE) {
+  uint8_t flags = page_flags[addr >> 8];
+
+  writes6502++;
+  if (run_fast) {
+    if (flags & PAGE_IO) {
+      run_sync_io();
+      io_magic_write(addr, val);
+    }
+    if (flags & PAGE_CODE) flush_code_page(addr >> 8);
+    memory[addr] = val;
+    return;
+  }
+  if (flags & PAGE_IO) io_magic_write(addr, val);
+  page_flags[addr >> 8] |= PAGE_DIRTY;
+  HEAT_INC(heat_ws[addr]);
+  if ((flags & PAGE_WATCH) && (breakpoints[addr] & MONITOR_WRITE)
+      && (!(breakpoints[addr] & MONITOR_COND) || monitor_break_hit(addr))) {
     break_flag |= MONITOR_WRITE;
     rw_brk = addr;
   }
@@ -96,25 +242,36 @@ void write6502(uint16_t addr, uint8_t val) {
 }
 
 const char *_flags = "nv bdizc";
-int get_reg_or_flag(const char *name) {
+const char *_regs[] = { "pc", "a", "x", "y", "sp", 0 };
+
+int get_reg_or_flag_id(const char *name) {
     const char *q;
-    /* return register or flag value with case insenstive name */
-    if (0 == strcasecmp(name, "pc")) {
-        return pc;
-    } else if (0 == strcasecmp(name, "a")) {
-        return a;
-    } else if (0 == strcasecmp(name, "x")) {
-        return x;
-    } else if (0 == strcasecmp(name, "y")) {
-        return y;
-    } else if (0 == strcasecmp(name, "sp")) {
-        return sp;
-    } else if (strlen(name) == 1 && (q = strchr(_flags, tolower(name[0])))) {
-        return status & (1 << (7-(q-_flags))) ? 1: 0;
-    }
+    int i;
+    /* number a register (0-4, see _regs) or flag (8 + its status bit) with case insensitive name */
+    for (i=0; _regs[i]; i++)
+        if (0 == strcasecmp(name, _regs[i])) return i;
+    if (strlen(name) == 1 && (q = strchr(_flags, tolower(name[0]))))
+        return 8 + 7-(q-_flags);
     return -1;
 }
 
+int get_reg_or_flag_by_id(int id) {
+    switch (id) {
+        case 0: return pc;
+        case 1: return a;
+        case 2: return x;
+        case 3: return y;
+        case 4: return sp;
+    }
+    return status & (1 << (id-8)) ? 1: 0;
+}
+
+int get_reg_or_flag(const char *name) {
+    /* return register or flag value with case insenstive name */
+    int id = get_reg_or_flag_id(name);
+    return id < 0 ? -1 : get_reg_or_flag_by_id(id);
+}
+
 int set_reg_or_flag(const char *name, int v) {
     const char *q;
     uint8_t bit;
@@ -183,6 +340,108 @@ int save_memory(const char* romfile, uint16_t start, uint16_t end) {
   return 0;
 }
 
+/*
+  A snapshot holds the whole machine so a run can resume where another
+  left off, e.g. after TaliForth has booted and is waiting for input.
+  Layout, little endian: "c65snap" and a version byte, then pc (2), a,
+  x, y, sp, status, waiting6502 (1 each), ticks (8), the magic IO
+  timer start (8), the block file position (8, all ones if none is
+  open), memory[] and breakpoints[].
+*/
+#define SNAPSHOT_MAGIC "c65snap"
+#define SNAPSHOT_VERSION 1
+
+static void put_le(FILE *f, uint64_t v, int n) {
+  while (n--) {
+    fputc((int)(v & 0xff), f);
+    v >>= 8;
+  }
+}
+
+static uint64_t get_le(FILE *f, int n) {
+  uint64_t v = 0;
+  int i;
+  for (i = 0; i < n; i++) v |= (uint64_t)(fgetc(f) & 0xff) << (8 * i);
+  return v;
+}
+
+int save_snapshot(const char* fname) {
+  FILE *fout;
+
+  fout = fopen(fname, "wb");
+  if (!fout) {
+    fprintf(stderr, "Error writing %s\n", fname);
+    return -1;
+  }
+  io_blksync();  /* the snapshot expects the blocks written so far */
+  fwrite(SNAPSHOT_MAGIC, 1, sizeof(SNAPSHOT_MAGIC) - 1, fout);
+  fputc(SNAPSHOT_VERSION, fout);
+  put_le(fout, pc, 2);
+  put_le(fout, a, 1);
+  put_le(fout, x, 1);
+  put_le(fout, y, 1);
+  put_le(fout, sp, 1);
+  put_le(fout, status, 1);
+  put_le(fout, waiting6502, 1);
+  put_le(fout, ticks, 8);
+  put_le(fout, (uint64_t)(int64_t)io_mark, 8);
+  put_le(fout, (uint64_t)(int64_t)io_blkpos(), 8);
+  fwrite(memory, 1, sizeof(memory), fout);
+  fwrite(breakpoints, 1, sizeof(breakpoints), fout);
+  if (fclose(fout) != 0) {
+    fprintf(stderr, "Error writing %s\n", fname);
+    return -1;
+  }
+  if (!quiet)
+    printf("c65: wrote snapshot %s\n", fname);
+  return 0;
+}
+
+int load_snapshot(const char* fname) {
+  FILE *fin;
+  char magic[sizeof(SNAPSHOT_MAGIC) - 1];
+  long blkpos;
+
+  fin = fopen(fname, "rb");
+  if (!fin) {
+    fprintf(stderr, "File not found: %s\n", fname);
+    return -1;
+  }
+  if (
+    fread(magic, 1, sizeof(magic), fin) != sizeof(magic)
+    || memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic)) != 0
+    || fgetc(fin) != SNAPSHOT_VERSION
+  ) {
+    fprintf(stderr, "Not a c65 snapshot: %s\n", fname);
+    fclose(fin);
+    return -1;
+  }
+  pc = get_le(fin, 2);
+  a = get_le(fin, 1);
+  x = get_le(fin, 1);
+  y = get_le(fin, 1);
+  sp = get_le(fin, 1);
+  status = get_le(fin, 1);
+  waiting6502 = get_le(fin, 1);
+  ticks = get_le(fin, 8);
+  io_mark = (long)(int64_t)get_le(fin, 8);
+  blkpos = (long)(int64_t)get_le(fin, 8);
+  if (
+    fread(memory, 1, sizeof(memory), fin) != sizeof(memory)
+    || fread(breakpoints, 1, sizeof(breakpoints), fin) != sizeof(breakpoints)
+  ) {
+    fprintf(stderr, "Truncated snapshot: %s\n", fname);
+    fclose(fin);
+    return -1;
+  }
+  fclose(fin);
+  update_watch_pages(0, 0x10000);
+  if (blkpos >= 0) io_blkseek(blkpos);
+  if (!quiet)
+    printf("c65: restored snapshot %s\n", fname);
+  return 0;
+}
+
 void show_cpu() {
   if (!quiet)
     printf(
@@ -197,11 +456,11 @@ void show_cpu() {
 
 int main(int argc, char *argv[]) {
   const char *romfile = NULL, *labelfile = NULL;
+  const char *snapfile = NULL, *restorefile = NULL;
   int addr = -1, start = -1, debug = 0, errflg = 0, c;
-  int brk_action = MONITOR_EXIT;
-  uint16_t over_addr;
+  uint16_t over_addr = 0;
 
-  while ((c = getopt(argc, argv, "vxgqr:a:s:m:b:l:")) != -1) {
+  while ((c = getopt(argc, argv, "vxgqcBr:a:s:m:b:l:p:P:S:R:")) != -1) {
     switch (c) {
       case 'r':
         romfile = optarg;
@@ -239,6 +498,35 @@ int main(int argc, char *argv[]) {
         errflg++;
         break;
 
+      case 'p':
+        prof_file = fopen(optarg, "w");
+        if (!prof_file) {
+          fprintf(stderr, "Error writing %s\n", optarg);
+          errflg++;
+        }
+        break;
+
+      case 'P':
+        prof_interval = strtol(optarg, NULL, 0);
+        if (!prof_interval) prof_interval = 1;
+        break;
+
+      case 'S':
+        snapfile = optarg;
+        break;
+
+      case 'R':
+        restorefile = optarg;
+        break;
+
+      case 'c':
+        run_cached = 1;
+        break;
+
+      case 'B':
+        io_buffered = 1;
+        break;
+
       case 'q':
         quiet = 1;
         break;
@@ -254,7 +542,7 @@ int main(int argc, char *argv[]) {
     }
   }
 
-  if (romfile == NULL)
+  if (romfile == NULL && restorefile == NULL)
     errflg++;
 
   if (errflg) {
@@ -265,6 +553,8 @@ int main(int argc, char *argv[]) {
             "-v         : Show semantic version\n"
             "-q         : Quiet, suppress informational output\n"
             "-r <file>  : Load file and reset into it via address at fffc\n"
+            "-R <file>  : Resume from a snapshot file (after loading any -r file)\n"
+            "-S <file>  : Write a snapshot file on exit\n"
             "-a <addr>  : Load at address instead of aligning to end of memory\n"
             "-s <addr>  : Start executing at addr instead of via reset vector\n"
             "-m <addr>  : Set magic IO base address (default 0xf000)\n"
@@ -273,22 +563,37 @@ int main(int argc, char *argv[]) {
             "-x         : BRK should reset via $fffe rather than exit (implied by -g)\n"
             "-g         : Run with interactive debugger\n"
             "-gg        : Debug but don't break on startup\n"
+            "-c         : Cache decoded basic blocks (ignored with -g)\n"
+            "-B         : Fully buffer output when it isn't a terminal\n"
+            "-p <file>  : Write a sampled PC profile to file\n"
+            "-P <ticks> : Sample the profile every ticks cycles (default 1000)\n"
             "Note: write <addr> like 8192 (decimal) or 0x2000 (hex)\n");
     exit(2);
   }
 
-  if (load_memory(romfile, addr) != 0) exit(3);
+  if (romfile && load_memory(romfile, addr) != 0) exit(3);
 
   reset6502();
+  if (restorefile && load_snapshot(restorefile) != 0) exit(3);
   if (start >= 0)
     pc = (uint16_t)start;
   show_cpu();
 
+  if (prof_file) {
+    prof_pc = pc;
+    prof_next = prof_interval;
+    hookexternal(profile_sample);
+  }
+
   /* -l implies debug, but don't want -g -l to behave like -gg, see #3 */
   if (labelfile && !debug) debug = 1;
 
   io_init(debug);
-  if (debug) monitor_init(labelfile);
+  set_io_pages();
+  if (debug) {
+    monitor_init(labelfile);
+    history_start(HISTORY_INTERVAL);  /* so the monitor can step backwards */
+  }
 
   /*
   The simulator runs in one of several states:
@@ -305,6 +610,19 @@ int main(int argc, char *argv[]) {
   Ctrl-C (SIGINT) generates MONITOR_SIGINT
   */
 
+  if (!debug) {
+    run_fast = 1;
+    if (brk_action == MONITOR_EXIT) page_flags[0xff] |= PAGE_VECTOR;
+    while (!(break_flag & MONITOR_EXIT)) {
+      run_base = ticks;
+#ifdef FAKE6502_BLOCK_CACHE
+      ticks = run_base + (run_cached ? execblocks6502 : exec6502)(RUN_BATCH_TICKS);
+#else
+      ticks = run_base + exec6502(RUN_BATCH_TICKS);
+#endif
+    }
+  }
+
   while (!(break_flag & MONITOR_EXIT)) {
     if (debug) {
       /* -gg skips initial break */
@@ -322,18 +640,22 @@ int main(int argc, char *argv[]) {
         step_mode = STEP_OVER;
         over_addr = pc+3;
       }
-      heat_xs[pc]++;
+      HEAT_INC(heat_xs[pc]);
       ticks += step6502();
+      history_step();
       if (step_mode == STEP_OVER && pc == over_addr) step_mode = STEP_NEXT;
       if (opcode == 0x00) break_flag |= brk_action;  /* BRK ? */
-      if (breakpoints[pc] & MONITOR_PC) {
+      if ((breakpoints[pc] & MONITOR_PC)
+          && (!(breakpoints[pc] & MONITOR_COND) || monitor_break_hit(pc))) {
         break_flag |= MONITOR_PC;
         if (breakpoints[pc] & MONITOR_ONCE) breakpoints[pc] ^= (MONITOR_ONCE|MONITOR_PC);
       }
       if (step_mode == STEP_NEXT || step_mode == STEP_INST) step_target--;
     }
   }
+  if (snapfile) (void)save_snapshot(snapfile);
   show_cpu();
   io_exit();
+  if (prof_file) fclose(prof_file);
   if (debug) monitor_exit();
 }
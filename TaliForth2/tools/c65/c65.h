@@ -5,6 +5,7 @@
 #define MONITOR_PC           4
 #define MONITOR_ANY          (MONITOR_PC|MONITOR_DATA)
 #define MONITOR_ONCE         8       /* flag to clear on hit */
+#define MONITOR_COND         128     /* has a condition, count or log, see monitor_break_hit */
 
 /* special break conditions */
 #define MONITOR_BRK          16      /* BRK instruction */
@@ -20,13 +21,34 @@
 extern uint8_t memory[0x10000];
 extern uint8_t breakpoints[0x10000];
 
+/* page_flags bits, see read6502 */
+#define PAGE_IO              1       /* magic IO block */
+#define PAGE_WATCH           2       /* read/write breakpoints */
+#define PAGE_VECTOR          4       /* BRK exits (no debugger) */
+#define PAGE_CODE            8       /* holds cached blocks (-c) */
+#define PAGE_DIRTY           16      /* written since the last history checkpoint */
+
+extern uint8_t page_flags[0x100];
+void update_watch_pages(int start, int end);
+void flush_code_page(uint8_t page);
+
 extern uint16_t pc;
 extern uint8_t a, x, y, sp, status;
 extern uint16_t rw_brk;
 
-extern uint64_t heat_rs[0x10000], heat_ws[0x10000], heat_xs[0x10000];
+/* heatmap counters saturate at HEAT_MAX rather than wrapping */
+typedef uint32_t heat_t;
+#define HEAT_MAX             UINT32_MAX
+#define HEAT_INC(h)          ((h) += (h) != HEAT_MAX)
+
+extern heat_t heat_rs[0x10000], heat_ws[0x10000], heat_xs[0x10000];
 
 extern uint64_t ticks;
+
+/* performance counters, see the magic IO perf block */
+enum { PERF_CYCLES, PERF_INSTRUCTIONS, PERF_PENALTY, PERF_READS, PERF_WRITES, PERF_COUNTERS };
+extern uint64_t reads6502, writes6502;
+void perf_read(uint64_t counters[PERF_COUNTERS]);
 extern int break_flag, step_mode, step_target, quiet;
 
 const char* opname(uint8_t op);
@@ -34,10 +56,14 @@ uint8_t oplen(uint8_t op);
 const char* opfmt(uint8_t op);
 
 int get_reg_or_flag(const char *name);
+int get_reg_or_flag_id(const char *name);
+int get_reg_or_flag_by_id(int id);
 int set_reg_or_flag(const char *name, int v);
 
 int load_memory(const char* romfile, int addr);
 int save_memory(const char* romfile, uint16_t start, uint16_t end);
+int save_snapshot(const char* fname);
+int load_snapshot(const char* fname);
 
 extern void reset6502();
 extern void irq6502();
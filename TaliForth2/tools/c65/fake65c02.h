@@ -111,11 +111,16 @@
  * uint32 clockticks6502                             *
  *   - A running total of the emulated cycle count   *
  *     during a call to exec6502.                    *
- * uint32 instructions                               *
+ * uint64 instructions                               *
  *   - A running total of the total emulated         *
  *     instruction count. This is not related to     *
  *     clock cycle timing.                           *
  *                                                   *
+ * uint64 penaltyticks6502                           *
+ *   - A running total of the cycles added for page  *
+ *     crossings, by indexed addressing and by       *
+ *     branches, included in clockticks6502.         *
+ *                                                   *
  *****************************************************/
 
 
@@ -137,6 +142,7 @@
 typedef uint16_t ushort;
 typedef unsigned char uint8;
 typedef uint32_t uint32
+typedef uint64_t uint64;
 #else
 typedef unsigned short ushort ;
 typedef unsigned char uint8;
@@ -147,6 +153,7 @@ typedef unsigned long uint32;
 typedef unsigned int uint32;
 #endif
 
+typedef unsigned long long uint64;
 #endif
 
 
@@ -202,20 +209,90 @@ typedef unsigned int uint32;
         else clearoverflow();\
 }
 
+#ifdef FAKE6502_INSTANCE
+#ifdef FAKE6502_BLOCK_CACHE
+#error "FAKE6502_INSTANCE does not support FAKE6502_BLOCK_CACHE"
+#endif
+/*
+	Instance mode: the CPU state lives in a cpu6502 rather than in globals,
+	and memory goes through its read and write callbacks, so any number of
+	CPUs can run in one process, each on whichever thread calls into it.
+	The cpu6502_*() calls point the thread-local fake6502_self at the CPU
+	for their duration; the core below reaches its state through macros.
+*/
+typedef struct cpu6502 {
+    /*6502 CPU registers*/
+    ushort pc;
+    uint8 sp, a, x, y, status;
+    /*helper variables*/
+    uint64 instructions, penaltyticks6502;
+    uint32 clockticks6502, clockgoal6502;
+    ushort oldpc, ea, reladdr, value, result;
+    uint8 opcode, oldstatus, waiting6502, penaltyop, penaltyaddr;
+    /*supplied by the embedder*/
+    uint8 (*read)(struct cpu6502 *cpu, ushort address);
+    void (*write)(struct cpu6502 *cpu, ushort address, uint8 val);
+    void (*hook)(struct cpu6502 *cpu);  /*called after every instruction, if set*/
+    void *user;
+} cpu6502;
+
+typedef uint8 (*cpu6502_read_fn)(cpu6502 *cpu, ushort address);
+typedef void (*cpu6502_write_fn)(cpu6502 *cpu, ushort address, uint8 val);
+
+/*zero the state and install the callbacks; cpu6502_reset() before running*/
+void cpu6502_init(cpu6502 *cpu, cpu6502_read_fn read, cpu6502_write_fn write, void *user);
+void cpu6502_reset(cpu6502 *cpu);
+void cpu6502_nmi(cpu6502 *cpu);
+void cpu6502_irq(cpu6502 *cpu);
+uint32 cpu6502_exec(cpu6502 *cpu, uint32 tickcount);
+uint32 cpu6502_step(cpu6502 *cpu);
+#endif
+
 #ifdef FAKE6502_INCLUDE
 
+#ifndef FAKE6502_INSTANCE
 extern ushort pc;
 extern uint8 sp, a, x, y, status;
+extern uint8 opcode, waiting6502;
 extern uint32 step6502();
+#endif
 
 #else
 
-#ifdef FAKE6502_NOT_STATIC
+#ifdef FAKE6502_INSTANCE
+static _Thread_local cpu6502 *fake6502_self;
+#define pc (fake6502_self->pc)
+#define sp (fake6502_self->sp)
+#define a (fake6502_self->a)
+#define x (fake6502_self->x)
+#define y (fake6502_self->y)
+#define status (fake6502_self->status)
+#define instructions (fake6502_self->instructions)
+#define penaltyticks6502 (fake6502_self->penaltyticks6502)
+#define clockticks6502 (fake6502_self->clockticks6502)
+#define clockgoal6502 (fake6502_self->clockgoal6502)
+#define oldpc (fake6502_self->oldpc)
+#define ea (fake6502_self->ea)
+#define reladdr (fake6502_self->reladdr)
+#define value (fake6502_self->value)
+#define result (fake6502_self->result)
+#define opcode (fake6502_self->opcode)
+#define oldstatus (fake6502_self->oldstatus)
+#define waiting6502 (fake6502_self->waiting6502)
+#define penaltyop (fake6502_self->penaltyop)
+#define penaltyaddr (fake6502_self->penaltyaddr)
+#define read6502(address) (fake6502_self->read(fake6502_self, (address)))
+#define write6502(address, val) (fake6502_self->write(fake6502_self, (address), (val)))
+#define FAKE6502_HOOK() if (fake6502_self->hook) fake6502_self->hook(fake6502_self)
+/*the legacy entry points only make sense inside a cpu6502_*() call*/
+#define FAKE6502_API static
+#elif defined(FAKE6502_NOT_STATIC)
 /*6502 CPU registers*/
 ushort pc;
 uint8 sp, a, x, y, status;
 /*helper variables*/
-uint32 instructions = 0;
+uint64 instructions = 0;
+uint64 penaltyticks6502 = 0;
 uint32 clockticks6502 = 0;
 uint32 clockgoal6502 = 0;
 ushort oldpc, ea, reladdr, value, result;
@@ -227,18 +304,30 @@ void irq6502();
 uint32 exec6502(uint32 tickcount);
 uint32 step6502();
 void hookexternal(void *funcptr);
+#ifdef FAKE6502_BLOCK_CACHE
+uint32 execblocks6502(uint32 tickcount);
+void flushpage6502(uint8 page);
+#endif
 #else
 static ushort pc;
 static uint8 sp, a, x, y, status;
-static uint32 instructions = 0;
+static uint64 instructions = 0;
+static uint64 penaltyticks6502 = 0;
 static uint32 clockticks6502 = 0;
 static uint32 clockgoal6502 = 0;
 static ushort oldpc, ea, reladdr, value, result;
 static uint8 opcode, oldstatus, waiting6502 = 0;
 #endif
+#ifndef FAKE6502_INSTANCE
 /*externally supplied functions*/
 extern uint8 read6502(ushort address);
 extern void write6502(ushort address, uint8 value);
+#define FAKE6502_HOOK() if (callexternal) (*loopexternal)()
+#define FAKE6502_API
+#endif
+#ifdef FAKE6502_BLOCK_CACHE
+extern int cachepage6502(uint8 page);
+#endif
 
 /*a few general functions used by various other functions*/
 static void push_6502_16(ushort pushval) {
@@ -267,7 +356,7 @@ static ushort mem_6502_read16(ushort addr) {
             ((ushort)read6502(addr + 1) << 8));
 }
 
-void reset6502() {
+FAKE6502_API void reset6502() {
 	/*
 	    pc = (ushort)read6502(0xFFFC) | ((ushort)read6502(0xFFFD) << 8);
 	    a = 0;
@@ -288,8 +377,12 @@ void reset6502() {
 
 
 static void (*addrtable[256])();
+#ifndef FAKE6502_SWITCH_CORE
 static void (*optable[256])();
+#endif
+#ifndef FAKE6502_INSTANCE
 static uint8 penaltyop, penaltyaddr;
+#endif
 
 /*addressing mode functions, calculates effective addresses*/
 static void imp() {
@@ -461,7 +554,7 @@ static void bcc() {
     if ((status & FLAG_CARRY) == 0) {
         oldpc = pc;
         pc += reladdr;
-        if ((oldpc & 0xFF00) != (pc & 0xFF00)) clockticks6502 += 2; /*check if jump crossed a page boundary*/
+        if ((oldpc & 0xFF00) != (pc & 0xFF00)) { clockticks6502 += 2; penaltyticks6502++; } /*check if jump crossed a page boundary*/
             else clockticks6502++;
     }
 }
@@ -470,7 +563,7 @@ static void bcs() {
     if ((status & FLAG_CARRY) == FLAG_CARRY) {
         oldpc = pc;
         pc += reladdr;
-        if ((oldpc & 0xFF00) != (pc & 0xFF00)) clockticks6502 += 2; /*check if jump crossed a page boundary*/
+        if ((oldpc & 0xFF00) != (pc & 0xFF00)) { clockticks6502 += 2; penaltyticks6502++; } /*check if jump crossed a page boundary*/
             else clockticks6502++;
     }
 }
@@ -479,7 +572,7 @@ static void beq() {
     if ((status & FLAG_ZERO) == FLAG_ZERO) {
         oldpc = pc;
         pc += reladdr;
-        if ((oldpc & 0xFF00) != (pc & 0xFF00)) clockticks6502 += 2; /*check if jump crossed a page boundary*/
+        if ((oldpc & 0xFF00) != (pc & 0xFF00)) { clockticks6502 += 2; penaltyticks6502++; } /*check if jump crossed a page boundary*/
             else clockticks6502++;
     }
 }
@@ -501,7 +594,7 @@ static void bmi() {
     if ((status & FLAG_SIGN) == FLAG_SIGN) {
         oldpc = pc;
         pc += reladdr;
-        if ((oldpc & 0xFF00) != (pc & 0xFF00)) clockticks6502 += 2; /*check if jump crossed a page boundary*/
+        if ((oldpc & 0xFF00) != (pc & 0xFF00)) { clockticks6502 += 2; penaltyticks6502++; } /*check if jump crossed a page boundary*/
             else clockticks6502++;
     }
 }
@@ -510,7 +603,7 @@ static void bne() {
     if ((status & FLAG_ZERO) == 0) {
         oldpc = pc;
         pc += reladdr;
-        if ((oldpc & 0xFF00) != (pc & 0xFF00)) clockticks6502 += 2; /*check if jump crossed a page boundary*/
+        if ((oldpc & 0xFF00) != (pc & 0xFF00)) { clockticks6502 += 2; penaltyticks6502++; } /*check if jump crossed a page boundary*/
             else clockticks6502++;
     }
 }
@@ -519,7 +612,7 @@ static void bpl() {
     if ((status & FLAG_SIGN) == 0) {
         oldpc = pc;
         pc += reladdr;
-        if ((oldpc & 0xFF00) != (pc & 0xFF00)) clockticks6502 += 2; /*check if jump crossed a page boundary*/
+        if ((oldpc & 0xFF00) != (pc & 0xFF00)) { clockticks6502 += 2; penaltyticks6502++; } /*check if jump crossed a page boundary*/
             else clockticks6502++;
     }
 }
@@ -537,7 +630,7 @@ static void bvc() {
     if ((status & FLAG_OVERFLOW) == 0) {
         oldpc = pc;
         pc += reladdr;
-        if ((oldpc & 0xFF00) != (pc & 0xFF00)) clockticks6502 += 2; /*check if jump crossed a page boundary*/
+        if ((oldpc & 0xFF00) != (pc & 0xFF00)) { clockticks6502 += 2; penaltyticks6502++; } /*check if jump crossed a page boundary*/
             else clockticks6502++;
     }
 }
@@ -546,7 +639,7 @@ static void bvs() {
     if ((status & FLAG_OVERFLOW) == FLAG_OVERFLOW) {
         oldpc = pc;
         pc += reladdr;
-        if ((oldpc & 0xFF00) != (pc & 0xFF00)) clockticks6502 += 2; /*check if jump crossed a page boundary*/
+        if ((oldpc & 0xFF00) != (pc & 0xFF00)) { clockticks6502 += 2; penaltyticks6502++; } /*check if jump crossed a page boundary*/
             else clockticks6502++;
     }
 }
@@ -907,7 +1000,7 @@ static void stz(){
 static void bra() {
     oldpc = pc;
     pc += reladdr;
-    if ((oldpc & 0xFF00) != (pc & 0xFF00)) clockticks6502 += 2; /*page boundary*/
+    if ((oldpc & 0xFF00) != (pc & 0xFF00)) { clockticks6502 += 2; penaltyticks6502++; } /*page boundary*/
         else clockticks6502++;
 }
 
@@ -964,7 +1057,7 @@ static void bbr(ushort bitmask)
 	if ((getvalue() & bitmask) == 0) {
 		oldpc = pc;
 		pc += reladdr;
-		if ((oldpc & 0xFF00) != (pc & 0xFF00)) clockticks6502 += 2; /*check if jump crossed a page boundary*/
+		if ((oldpc & 0xFF00) != (pc & 0xFF00)) { clockticks6502 += 2; penaltyticks6502++; } /*check if jump crossed a page boundary*/
 		else clockticks6502++;
 	}
 }
@@ -982,7 +1075,7 @@ static void bbs(ushort bitmask)
 	if ((getvalue() & bitmask) != 0) {
 		oldpc = pc;
 		pc += reladdr;
-		if ((oldpc & 0xFF00) != (pc & 0xFF00)) clockticks6502 += 2; /*check if jump crossed a page boundary*/
+		if ((oldpc & 0xFF00) != (pc & 0xFF00)) { clockticks6502 += 2; penaltyticks6502++; } /*check if jump crossed a page boundary*/
 		else clockticks6502++;
 	}
 }
@@ -1015,50 +1108,105 @@ static void rmb6() { putvalue(getvalue() & ~0x40); }
 static void rmb7() { putvalue(getvalue() & ~0x80); }
 
 
-static void (*addrtable[256])() = {
-/*        |  0  |  1  |  2  |  3  |  4  |  5  |  6  |  7  |  8  |  9  |  A  |  B  |  C  |  D  |  E  |  F  |     */
-/* 0 */     imp, indx,  imm,  imp,   zp,   zp,   zp,   zp,  imp,  imm,  acc,  imp, abso, abso, abso,zprel, /* 0 */
-/* 1 */     rel, indy, ind0,  imp,   zp,  zpx,  zpx,   zp,  imp, absy,  acc,  imp, abso, absx, absx,zprel, /* 1 */
-/* 2 */    abso, indx,  imm,  imp,   zp,   zp,   zp,   zp,  imp,  imm,  acc,  imp, abso, abso, abso,zprel, /* 2 */
-/* 3 */     rel, indy, ind0,  imp,  zpx,  zpx,  zpx,   zp,  imp, absy,  acc,  imp, absx, absx, absx,zprel, /* 3 */
-/* 4 */     imp, indx,  imm,  imp,   zp,   zp,   zp,   zp,  imp,  imm,  acc,  imp, abso, abso, abso,zprel, /* 4 */
-/* 5 */     rel, indy, ind0,  imp,  zpx,  zpx,  zpx,   zp,  imp, absy,  imp,  imp, abso, absx, absx,zprel, /* 5 */
-/* 6 */     imp, indx,  imm,  imp,   zp,   zp,   zp,   zp,  imp,  imm,  acc,  imp,  ind, abso, abso,zprel, /* 6 */
-/* 7 */     rel, indy, ind0,  imp,  zpx,  zpx,  zpx,   zp,  imp, absy,  imp,  imp, ainx, absx, absx,zprel, /* 7 */
-/* 8 */     rel, indx,  imm,  imp,   zp,   zp,   zp,   zp,  imp,  imm,  imp,  imp, abso, abso, abso,zprel, /* 8 */
-/* 9 */     rel, indy, ind0,  imp,  zpx,  zpx,  zpy,   zp,  imp, absy,  imp,  imp, abso, absx, absx,zprel, /* 9 */
-/* A */     imm, indx,  imm,  imp,   zp,   zp,   zp,   zp,  imp,  imm,  imp,  imp, abso, abso, abso,zprel, /* A */
-/* B */     rel, indy, ind0,  imp,  zpx,  zpx,  zpy,   zp,  imp, absy,  imp,  imp, absx, absx, absy,zprel, /* B */
-/* C */     imm, indx,  imm,  imp,   zp,   zp,   zp,   zp,  imp,  imm,  imp,  imp, abso, abso, abso,zprel, /* C */
-/* D */     rel, indy, ind0,  imp,  zpx,  zpx,  zpx,   zp,  imp, absy,  imp,  imp, abso, absx, absx,zprel, /* D */
-/* E */     imm, indx,  imm,  imp,   zp,   zp,   zp,   zp,  imp,  imm,  imp,  imp, abso, abso, abso,zprel, /* E */
-/* F */     rel, indy, ind0,  imp,  zpx,  zpx,  zpx,   zp,  imp, absy,  imp,  imp, abso, absx, absx,zprel  /* F */
-};
-
 /*
+	Every opcode's addressing mode and operation, in opcode order.  The
+	dispatch tables below and the FAKE6502_SWITCH_CORE switch are both
+	generated from this one list.
+
 	NOTE: the "db6502" instruction is *supposed* to be "wait until hardware reset"
 	NOTE: updated nops per http://www.6502.org/tutorials/65c02opcodes.html#9
 */
 
-static void (*optable[256])() = {
-/*        |  0  |  1  |  2  |  3  |  4  |  5  |  6  |  7  |  8  |  9  |  A  |  B  |  C  |  D  |  E  |  F  |     */
-/* 0 */ brk_6502,  ora,  nop,  nop,  tsb,  ora,  asl, rmb0,  php,  ora,  asl,  nop,  tsb,  ora,  asl, bbr0, /* 0 */
-/* 1 */      bpl,  ora,  ora,  nop,  trb,  ora,  asl, rmb1,  clc,  ora,  inc,  nop,  trb,  ora,  asl, bbr1, /* 1 */
-/* 2 */      jsr,  and,  nop,  nop,  bit,  and,  rol, rmb2,  plp,  and,  rol,  nop,  bit,  and,  rol, bbr2, /* 2 */
-/* 3 */      bmi,  and,  and,  nop,  bit,  and,  rol, rmb3,  sec,  and,  dec,  nop,  bit,  and,  rol, bbr3, /* 3 */
-/* 4 */      rti,  eor,  nop,  nop,  nop,  eor,  lsr, rmb4,  pha,  eor,  lsr,  nop,  jmp,  eor,  lsr, bbr4, /* 4 */
-/* 5 */      bvc,  eor,  eor,  nop,  nop,  eor,  lsr, rmb5,  cli,  eor,  phy,  nop,  nop,  eor,  lsr, bbr5, /* 5 */
-/* 6 */      rts,  adc,  nop,  nop,  stz,  adc,  ror, rmb6,  pla,  adc,  ror,  nop,  jmp,  adc,  ror, bbr6, /* 6 */
-/* 7 */      bvs,  adc,  adc,  nop,  stz,  adc,  ror, rmb7,  sei,  adc,  ply,  nop,  jmp,  adc,  ror, bbr7, /* 7 */
-/* 8 */      bra,  sta,  nop,  nop,  sty,  sta,  stx, smb0,  dey,bit_imm,txa,  nop,  sty,  sta,  stx, bbs0, /* 8 */
-/* 9 */      bcc,  sta,  sta,  nop,  sty,  sta,  stx, smb1,  tya,  sta,  txs,  nop,  stz,  sta,  stz, bbs1, /* 9 */
-/* A */      ldy,  lda,  ldx,  nop,  ldy,  lda,  ldx, smb2,  tay,  lda,  tax,  nop,  ldy,  lda,  ldx, bbs2, /* A */
-/* B */      bcs,  lda,  lda,  nop,  ldy,  lda,  ldx, smb3,  clv,  lda,  tsx,  nop,  ldy,  lda,  ldx, bbs3, /* B */
-/* C */      cpy,  cmp,  nop,  nop,  cpy,  cmp,  dec, smb4,  iny,  cmp,  dex,  wai,  cpy,  cmp,  dec, bbs4, /* C */
-/* D */      bne,  cmp,  cmp,  nop,  nop,  cmp,  dec, smb5,  cld,  cmp,  phx,db6502, nop,  cmp,  dec, bbs5, /* D */
-/* E */      cpx,  sbc,  nop,  nop,  cpx,  sbc,  inc, smb6,  inx,  sbc,  nop,  nop,  cpx,  sbc,  inc, bbs6, /* E */
-/* F */      beq,  sbc,  sbc,  nop,  nop,  sbc,  inc, smb7,  sed,  sbc,  plx,  nop,  nop,  sbc,  inc, bbs7  /* F */
-};
+#define FAKE6502_OPCODES(X) \
+/* 0 */ \
+    X(00, imp, brk_6502) X(01, indx, ora) X(02, imm, nop) X(03, imp, nop) \
+    X(04, zp, tsb) X(05, zp, ora) X(06, zp, asl) X(07, zp, rmb0) \
+    X(08, imp, php) X(09, imm, ora) X(0A, acc, asl) X(0B, imp, nop) \
+    X(0C, abso, tsb) X(0D, abso, ora) X(0E, abso, asl) X(0F, zprel, bbr0) \
+/* 1 */ \
+    X(10, rel, bpl) X(11, indy, ora) X(12, ind0, ora) X(13, imp, nop) \
+    X(14, zp, trb) X(15, zpx, ora) X(16, zpx, asl) X(17, zp, rmb1) \
+    X(18, imp, clc) X(19, absy, ora) X(1A, acc, inc) X(1B, imp, nop) \
+    X(1C, abso, trb) X(1D, absx, ora) X(1E, absx, asl) X(1F, zprel, bbr1) \
+/* 2 */ \
+    X(20, abso, jsr) X(21, indx, and) X(22, imm, nop) X(23, imp, nop) \
+    X(24, zp, bit) X(25, zp, and) X(26, zp, rol) X(27, zp, rmb2) \
+    X(28, imp, plp) X(29, imm, and) X(2A, acc, rol) X(2B, imp, nop) \
+    X(2C, abso, bit) X(2D, abso, and) X(2E, abso, rol) X(2F, zprel, bbr2) \
+/* 3 */ \
+    X(30, rel, bmi) X(31, indy, and) X(32, ind0, and) X(33, imp, nop) \
+    X(34, zpx, bit) X(35, zpx, and) X(36, zpx, rol) X(37, zp, rmb3) \
+    X(38, imp, sec) X(39, absy, and) X(3A, acc, dec) X(3B, imp, nop) \
+    X(3C, absx, bit) X(3D, absx, and) X(3E, absx, rol) X(3F, zprel, bbr3) \
+/* 4 */ \
+    X(40, imp, rti) X(41, indx, eor) X(42, imm, nop) X(43, imp, nop) \
+    X(44, zp, nop) X(45, zp, eor) X(46, zp, lsr) X(47, zp, rmb4) \
+    X(48, imp, pha) X(49, imm, eor) X(4A, acc, lsr) X(4B, imp, nop) \
+    X(4C, abso, jmp) X(4D, abso, eor) X(4E, abso, lsr) X(4F, zprel, bbr4) \
+/* 5 */ \
+    X(50, rel, bvc) X(51, indy, eor) X(52, ind0, eor) X(53, imp, nop) \
+    X(54, zpx, nop) X(55, zpx, eor) X(56, zpx, lsr) X(57, zp, rmb5) \
+    X(58, imp, cli) X(59, absy, eor) X(5A, imp, phy) X(5B, imp, nop) \
+    X(5C, abso, nop) X(5D, absx, eor) X(5E, absx, lsr) X(5F, zprel, bbr5) \
+/* 6 */ \
+    X(60, imp, rts) X(61, indx, adc) X(62, imm, nop) X(63, imp, nop) \
+    X(64, zp, stz) X(65, zp, adc) X(66, zp, ror) X(67, zp, rmb6) \
+    X(68, imp, pla) X(69, imm, adc) X(6A, acc, ror) X(6B, imp, nop) \
+    X(6C, ind, jmp) X(6D, abso, adc) X(6E, abso, ror) X(6F, zprel, bbr6) \
+/* 7 */ \
+    X(70, rel, bvs) X(71, indy, adc) X(72, ind0, adc) X(73, imp, nop) \
+    X(74, zpx, stz) X(75, zpx, adc) X(76, zpx, ror) X(77, zp, rmb7) \
+    X(78, imp, sei) X(79, absy, adc) X(7A, imp, ply) X(7B, imp, nop) \
+    X(7C, ainx, jmp) X(7D, absx, adc) X(7E, absx, ror) X(7F, zprel, bbr7) \
+/* 8 */ \
+    X(80, rel, bra) X(81, indx, sta) X(82, imm, nop) X(83, imp, nop) \
+    X(84, zp, sty) X(85, zp, sta) X(86, zp, stx) X(87, zp, smb0) \
+    X(88, imp, dey) X(89, imm, bit_imm) X(8A, imp, txa) X(8B, imp, nop) \
+    X(8C, abso, sty) X(8D, abso, sta) X(8E, abso, stx) X(8F, zprel, bbs0) \
+/* 9 */ \
+    X(90, rel, bcc) X(91, indy, sta) X(92, ind0, sta) X(93, imp, nop) \
+    X(94, zpx, sty) X(95, zpx, sta) X(96, zpy, stx) X(97, zp, smb1) \
+    X(98, imp, tya) X(99, absy, sta) X(9A, imp, txs) X(9B, imp, nop) \
+    X(9C, abso, stz) X(9D, absx, sta) X(9E, absx, stz) X(9F, zprel, bbs1) \
+/* A */ \
+    X(A0, imm, ldy) X(A1, indx, lda) X(A2, imm, ldx) X(A3, imp, nop) \
+    X(A4, zp, ldy) X(A5, zp, lda) X(A6, zp, ldx) X(A7, zp, smb2) \
+    X(A8, imp, tay) X(A9, imm, lda) X(AA, imp, tax) X(AB, imp, nop) \
+    X(AC, abso, ldy) X(AD, abso, lda) X(AE, abso, ldx) X(AF, zprel, bbs2) \
+/* B */ \
+    X(B0, rel, bcs) X(B1, indy, lda) X(B2, ind0, lda) X(B3, imp, nop) \
+    X(B4, zpx, ldy) X(B5, zpx, lda) X(B6, zpy, ldx) X(B7, zp, smb3) \
+    X(B8, imp, clv) X(B9, absy, lda) X(BA, imp, tsx) X(BB, imp, nop) \
+    X(BC, absx, ldy) X(BD, absx, lda) X(BE, absy, ldx) X(BF, zprel, bbs3) \
+/* C */ \
+    X(C0, imm, cpy) X(C1, indx, cmp) X(C2, imm, nop) X(C3, imp, nop) \
+    X(C4, zp, cpy) X(C5, zp, cmp) X(C6, zp, dec) X(C7, zp, smb4) \
+    X(C8, imp, iny) X(C9, imm, cmp) X(CA, imp, dex) X(CB, imp, wai) \
+    X(CC, abso, cpy) X(CD, abso, cmp) X(CE, abso, dec) X(CF, zprel, bbs4) \
+/* D */ \
+    X(D0, rel, bne) X(D1, indy, cmp) X(D2, ind0, cmp) X(D3, imp, nop) \
+    X(D4, zpx, nop) X(D5, zpx, cmp) X(D6, zpx, dec) X(D7, zp, smb5) \
+    X(D8, imp, cld) X(D9, absy, cmp) X(DA, imp, phx) X(DB, imp, db6502) \
+    X(DC, abso, nop) X(DD, absx, cmp) X(DE, absx, dec) X(DF, zprel, bbs5) \
+/* E */ \
+    X(E0, imm, cpx) X(E1, indx, sbc) X(E2, imm, nop) X(E3, imp, nop) \
+    X(E4, zp, cpx) X(E5, zp, sbc) X(E6, zp, inc) X(E7, zp, smb6) \
+    X(E8, imp, inx) X(E9, imm, sbc) X(EA, imp, nop) X(EB, imp, nop) \
+    X(EC, abso, cpx) X(ED, abso, sbc) X(EE, abso, inc) X(EF, zprel, bbs6) \
+/* F */ \
+    X(F0, rel, beq) X(F1, indy, sbc) X(F2, ind0, sbc) X(F3, imp, nop) \
+    X(F4, zpx, nop) X(F5, zpx, sbc) X(F6, zpx, inc) X(F7, zp, smb7) \
+    X(F8, imp, sed) X(F9, absy, sbc) X(FA, imp, plx) X(FB, imp, nop) \
+    X(FC, abso, nop) X(FD, absx, sbc) X(FE, absx, inc) X(FF, zprel, bbs7)
+
+#define FAKE6502_ADDRTABLE_ENTRY(n, mode, op) [0x##n] = mode,
+#define FAKE6502_OPTABLE_ENTRY(n, mode, op) [0x##n] = op,
+
+static void (*addrtable[256])() = { FAKE6502_OPCODES(FAKE6502_ADDRTABLE_ENTRY) };
+#ifndef FAKE6502_SWITCH_CORE
+static void (*optable[256])() = { FAKE6502_OPCODES(FAKE6502_OPTABLE_ENTRY) };
+#endif
+
 
 static char *opnames =
     "brk ora nop nop tsb ora asl rmb0php ora asl nop tsb ora asl bbr0"
@@ -1099,7 +1247,29 @@ static const uint32 ticktable[256] = {
 };
 
 
-void nmi6502() {
+/*
+	Run the current opcode's addressing mode and operation.  With
+	FAKE6502_SWITCH_CORE every opcode gets its own case, so the compiler
+	can inline both halves into it (build with optimisation on) instead of
+	making two indirect calls per instruction.  Cycle accounting is left to
+	the callers either way.
+*/
+#ifdef FAKE6502_SWITCH_CORE
+#define FAKE6502_SWITCH_CASE(n, mode, op) case 0x##n: mode(); op(); break;
+
+static inline void dispatch6502() {
+	switch (opcode) {
+		FAKE6502_OPCODES(FAKE6502_SWITCH_CASE)
+	}
+}
+#else
+static inline void dispatch6502() {
+	(*addrtable[opcode])();
+	(*optable[opcode])();
+}
+#endif
+
+FAKE6502_API void nmi6502() {
     push_6502_16(pc);
     push_6502_8(status  & ~FLAG_BREAK);
     setinterrupt();
@@ -1108,7 +1278,7 @@ void nmi6502() {
     waiting6502 = 0;
 }
 
-void irq6502() {
+FAKE6502_API void irq6502() {
 	/*
 	    push_6502_16(pc);
 	    push_6502_8(status);
@@ -1127,10 +1297,12 @@ void irq6502() {
 
 }
 
+#ifndef FAKE6502_INSTANCE
 uint8 callexternal = 0;
 void (*loopexternal)();
+#endif
 
-uint32 exec6502(uint32 tickcount) {
+FAKE6502_API uint32 exec6502(uint32 tickcount) {
 	/*
 		BUG FIX:
 		overflow of unsigned 32 bit integer causes emulation to hang.
@@ -1146,17 +1318,16 @@ uint32 exec6502(uint32 tickcount) {
         status |= FLAG_CONSTANT;
         penaltyop = 0;
         penaltyaddr = 0;
-       	(*addrtable[opcode])();
-        (*optable[opcode])();
+        dispatch6502();
         clockticks6502 += ticktable[opcode];
-        if (penaltyop && penaltyaddr) {clockticks6502++;}
+        if (penaltyop && penaltyaddr) {clockticks6502++; penaltyticks6502++;}
         instructions++;
-        if (callexternal) (*loopexternal)();
+        FAKE6502_HOOK();
     }
 	return clockticks6502;
 }
 
-uint32 step6502() {
+FAKE6502_API uint32 step6502() {
 	if(waiting6502) return 1;
     opcode = read6502(pc++);
     status |= FLAG_CONSTANT;
@@ -1164,25 +1335,341 @@ uint32 step6502() {
     penaltyop = 0;
     penaltyaddr = 0;
 	clockticks6502 = 0;
-    (*addrtable[opcode])();
-    (*optable[opcode])();
+    dispatch6502();
     clockticks6502 += ticktable[opcode];
     /*The following line goes commented out in Mike Chamber's usage of the 6502 emulator for MOARNES*/
-    if (penaltyop && penaltyaddr) clockticks6502++;
+    if (penaltyop && penaltyaddr) {clockticks6502++; penaltyticks6502++;}
     /*clockgoal6502 = clockticks6502; irrelevant.*/
 
     instructions++;
 
-    if (callexternal) (*loopexternal)();
+    FAKE6502_HOOK();
+    return clockticks6502;
+}
+
+#ifdef FAKE6502_BLOCK_CACHE
+/*
+	Basic-block cache, used by execblocks6502() in place of exec6502().
+
+	Straight-line runs of instructions are decoded once into blocks of
+	micro-ops (opcode, length, operand bytes, ticktable cycles) keyed by
+	their start pc.  Running a block skips the opcode and operand fetches
+	and the mode's decode; the *_cached addressing modes below rebuild ea
+	from the stored operand and then the ordinary operation runs.  A block
+	ends after any instruction that can change pc other than by falling
+	through, or before one that would cross into the next page.
+
+	Blocks never span pages, so each records the generation of its page
+	and is stale once that moves on.  The embedder supplies
+	cachepage6502(page), returning 0 to keep a page (e.g. memory-mapped
+	IO) out of the cache, and must call flushpage6502(page) the next time
+	it sees a write to a page it has agreed to cache.
+*/
+#define FAKE6502_BLOCK_OPS    16
+#define FAKE6502_BLOCK_SLOTS  4096  /*direct mapped, a power of two*/
+
+typedef struct {
+    uint8 opcode;
+    uint8 len;
+    uint8 ticks;
+    ushort operand;   /*zp/abs operand, or sign-extended branch offset*/
+    ushort rel;       /*zprel branch offset*/
+} fake6502_uop;
+
+typedef struct {
+    ushort start;
+    uint8 n;
+    uint32 gen;
+    fake6502_uop uops[FAKE6502_BLOCK_OPS];
+} fake6502_block;
+
+static fake6502_block blocks6502[FAKE6502_BLOCK_SLOTS];
+static uint32 blockgen6502[256];
+static const fake6502_uop *uop6502;
+
+void flushpage6502(uint8 page) {
+    blockgen6502[page]++;
+}
+
+#define FAKE6502_LEN_imp   1
+#define FAKE6502_LEN_acc   1
+#define FAKE6502_LEN_imm   2
+#define FAKE6502_LEN_zp    2
+#define FAKE6502_LEN_zpx   2
+#define FAKE6502_LEN_zpy   2
+#define FAKE6502_LEN_rel   2
+#define FAKE6502_LEN_indx  2
+#define FAKE6502_LEN_indy  2
+#define FAKE6502_LEN_ind0  2
+#define FAKE6502_LEN_abso  3
+#define FAKE6502_LEN_absx  3
+#define FAKE6502_LEN_absy  3
+#define FAKE6502_LEN_ind   3
+#define FAKE6502_LEN_ainx  3
+#define FAKE6502_LEN_zprel 3
+#define FAKE6502_LEN_ENTRY(n, mode, op) [0x##n] = FAKE6502_LEN_##mode,
+
+static const uint8 oplen6502[256] = { FAKE6502_OPCODES(FAKE6502_LEN_ENTRY) };
+
+/*addressing modes for a decoded instruction, pc already points past it*/
+static void imp_cached() {
+}
+
+static void acc_cached() {
+}
+
+static void imm_cached() {
+    ea = pc - 1;
+}
+
+static void zp_cached() {
+    ea = uop6502->operand;
+}
+
+static void zpx_cached() {
+    ea = (uop6502->operand + (ushort)x) & 0xFF;
+}
+
+static void zpy_cached() {
+    ea = (uop6502->operand + (ushort)y) & 0xFF;
+}
+
+static void rel_cached() {
+    reladdr = uop6502->operand;
+}
+
+static void abso_cached() {
+    ea = uop6502->operand;
+}
+
+static void absx_cached() {
+    ea = uop6502->operand + (ushort)x;
+    if ((uop6502->operand & 0xFF00) != (ea & 0xFF00)) penaltyaddr = 1;
+}
+
+static void absy_cached() {
+    ea = uop6502->operand + (ushort)y;
+    if ((uop6502->operand & 0xFF00) != (ea & 0xFF00)) penaltyaddr = 1;
+}
+
+static void ind_cached() {
+    ushort eahelp = uop6502->operand;
+    ea = (ushort)read6502(eahelp) | ((ushort)read6502((eahelp+1) & 0xFFFF) << 8);
+}
+
+static void indx_cached() {
+    ushort eahelp = (uop6502->operand + (ushort)x) & 0xFF;
+    ea = (ushort)read6502(eahelp & 0x00FF) | ((ushort)read6502((eahelp+1) & 0x00FF) << 8);
+}
+
+static void indy_cached() {
+    ushort eahelp = uop6502->operand, startpage;
+    ea = (ushort)read6502(eahelp) | ((ushort)read6502((eahelp + 1) & 0x00FF) << 8);
+    startpage = ea & 0xFF00;
+    ea += (ushort)y;
+    if (startpage != (ea & 0xFF00)) penaltyaddr = 1;
+}
+
+static void ind0_cached() {
+    ushort eahelp = uop6502->operand;
+    ea = (ushort)read6502(eahelp) | ((ushort)read6502((eahelp + 1) & 0x00FF) << 8);
+}
+
+static void ainx_cached() {
+    ushort eahelp = (uop6502->operand + (ushort)x) & 0xFFFF;
+    ea = (ushort)read6502(eahelp) | ((ushort)read6502(eahelp + 1) << 8);
+}
+
+static void zprel_cached() {
+    ea = uop6502->operand;
+    reladdr = uop6502->rel;
+}
+
+#define FAKE6502_CACHED_CASE(n, mode, op) case 0x##n: mode##_cached(); op(); break;
+
+static inline void dispatchcached6502() {
+    switch (opcode) {
+        FAKE6502_OPCODES(FAKE6502_CACHED_CASE)
+    }
+}
+
+static ushort sext6502(uint8 offset) {
+    return offset & 0x80 ? offset | 0xFF00 : offset;
+}
+
+/*decode the block starting at pc into b, or return NULL to run it uncached*/
+static fake6502_block *decodeblock6502(fake6502_block *b) {
+    ushort addr = pc;
+    uint8 page = pc >> 8, op, len;
+    fake6502_uop *u;
+    int n = 0, end = 0;
+
+    b->n = 0;
+    if (!cachepage6502(page)) return NULL;
+
+    while (n < FAKE6502_BLOCK_OPS && !end) {
+        op = read6502(addr);
+        len = oplen6502[op];
+        if (((addr + len - 1) >> 8) != page) break;
+
+        u = &b->uops[n++];
+        u->opcode = op;
+        u->len = len;
+        u->ticks = ticktable[op];
+        u->operand = len > 1 ? read6502(addr + 1) : 0;
+        if (len > 2) u->operand |= (ushort)read6502(addr + 2) << 8;
+        u->rel = 0;
+
+        if (addrtable[op] == rel) {
+            u->operand = sext6502(u->operand);
+            end = 1;
+        } else if (addrtable[op] == zprel) {
+            u->rel = sext6502(u->operand >> 8);
+            u->operand &= 0xFF;
+            end = 1;
+        }
+        switch (op) {
+            case 0x00: /*brk*/  case 0x20: /*jsr*/  case 0x40: /*rti*/
+            case 0x4C: case 0x6C: case 0x7C: /*jmp*/  case 0x60: /*rts*/
+            case 0xCB: /*wai*/  case 0xDB: /*stp*/
+                end = 1;
+        }
+        addr += len;
+    }
+    if (!n) return NULL;
+    b->start = pc;
+    b->n = n;
+    b->gen = blockgen6502[page];
+    return b;
+}
+
+uint32 execblocks6502(uint32 tickcount) {
+    fake6502_block *b;
+    const fake6502_uop *u, *end;
+    uint8 page;
+
+    if(waiting6502) return tickcount;
+    clockgoal6502 = tickcount;
+    clockticks6502 = 0;
+    while (clockticks6502 < clockgoal6502) {
+        b = &blocks6502[(pc ^ (pc >> 12)) & (FAKE6502_BLOCK_SLOTS - 1)];
+        page = pc >> 8;
+        if (!(b->n && b->start == pc && b->gen == blockgen6502[page]))
+            b = decodeblock6502(b);
+        if (!b) {
+            opcode = read6502(pc++);
+            status |= FLAG_CONSTANT;
+            penaltyop = 0;
+            penaltyaddr = 0;
+            dispatch6502();
+            clockticks6502 += ticktable[opcode];
+            if (penaltyop && penaltyaddr) {clockticks6502++; penaltyticks6502++;}
+            instructions++;
+            FAKE6502_HOOK();
+            continue;
+        }
+        for (u = b->uops, end = u + b->n; u < end; u++) {
+            opcode = u->opcode;
+            pc += u->len;
+            status |= FLAG_CONSTANT;
+            penaltyop = 0;
+            penaltyaddr = 0;
+            uop6502 = u;
+            dispatchcached6502();
+            clockticks6502 += u->ticks;
+            if (penaltyop && penaltyaddr) {clockticks6502++; penaltyticks6502++;}
+            instructions++;
+            FAKE6502_HOOK();
+            /*stop early at the goal, or if the block just rewrote its own page*/
+            if (clockticks6502 >= clockgoal6502 || b->gen != blockgen6502[page]) break;
+        }
+    }
     return clockticks6502;
 }
+#endif
+
+#ifdef FAKE6502_INSTANCE
+void cpu6502_init(cpu6502 *cpu, cpu6502_read_fn read, cpu6502_write_fn write, void *user) {
+    static const cpu6502 zero;
+    *cpu = zero;
+    cpu->read = read;
+    cpu->write = write;
+    cpu->user = user;
+}
 
+/*
+	Each call saves and restores fake6502_self, so a callback may drive
+	another cpu6502 (a coprocessor, say) and return to this one.
+*/
+void cpu6502_reset(cpu6502 *cpu) {
+    cpu6502 *saved = fake6502_self;
+    fake6502_self = cpu;
+    reset6502();
+    fake6502_self = saved;
+}
+
+void cpu6502_nmi(cpu6502 *cpu) {
+    cpu6502 *saved = fake6502_self;
+    fake6502_self = cpu;
+    nmi6502();
+    fake6502_self = saved;
+}
+
+void cpu6502_irq(cpu6502 *cpu) {
+    cpu6502 *saved = fake6502_self;
+    fake6502_self = cpu;
+    irq6502();
+    fake6502_self = saved;
+}
+
+uint32 cpu6502_exec(cpu6502 *cpu, uint32 tickcount) {
+    cpu6502 *saved = fake6502_self;
+    uint32 ticks;
+    fake6502_self = cpu;
+    ticks = exec6502(tickcount);
+    fake6502_self = saved;
+    return ticks;
+}
+
+uint32 cpu6502_step(cpu6502 *cpu) {
+    cpu6502 *saved = fake6502_self;
+    uint32 ticks;
+    fake6502_self = cpu;
+    ticks = step6502();
+    fake6502_self = saved;
+    return ticks;
+}
+
+#undef pc
+#undef sp
+#undef a
+#undef x
+#undef y
+#undef status
+#undef instructions
+#undef penaltyticks6502
+#undef clockticks6502
+#undef clockgoal6502
+#undef oldpc
+#undef ea
+#undef reladdr
+#undef value
+#undef result
+#undef opcode
+#undef oldstatus
+#undef waiting6502
+#undef penaltyop
+#undef penaltyaddr
+#undef read6502
+#undef write6502
+#else
 void hookexternal(void *funcptr) {
     if (funcptr != (void *)NULL) {
         loopexternal = funcptr;
         callexternal = 1;
     } else callexternal = 0;
 }
+#endif
 
 /*
 	Check all changes against
@@ -0,0 +1,319 @@
+/*
+Record and replay for the monitor's rstep and rcontinue.
+
+While recording, each debugger step counts in history_steps, and every
+history_interval ticks a checkpoint keeps the registers along with the
+256-byte pages written since the checkpoint before (write6502 flags them
+PAGE_DIRTY); the first checkpoint keeps every page.  Input is the one thing
+a re-run can't reproduce, so each byte the program reads from kbhit or getc
+is journaled, run length encoded, and a re-run reads it back from there.
+
+Going back restores the latest checkpoint at or before the target step,
+taking each page from the newest copy at or before it, and re-runs from
+there.  Until a re-run reaches the furthest step recorded (present) output
+and block writes are dropped since they've already happened.  Block reads
+see the file as it is now, and re-runs add to the heatmap.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+
+#define FAKE6502_NOT_STATIC 1
+#define FAKE6502_INCLUDE 1
+#include "fake65c02.h"
+
+#include "c65.h"
+#include "magicio.h"
+#include "monitor.h"
+#include "history.h"
+
+#define MAX_CHECKPOINTS 256
+
+typedef struct Checkpoint {
+    uint64_t steps, ticks, inputs;
+    long io_mark, blkpos;
+    uint16_t pc;
+    uint8_t a, x, y, sp, status, waiting;
+    uint8_t *pages[0x100];      /* pages written since the previous checkpoint, as they were at this one */
+} Checkpoint;
+
+typedef struct Input {
+    uint8_t value;
+    uint32_t count;
+} Input;
+
+int history_on = 0, history_interval = HISTORY_INTERVAL;
+uint64_t history_steps = 0;
+
+static uint64_t present, next_checkpoint;
+
+static Checkpoint *cps = NULL;
+static int n_cps = 0;
+
+static Input *inputs = NULL;
+static size_t n_inputs = 0, max_inputs = 0;
+static uint64_t input_pos = 0, input_len = 0;     /* bytes read so far, and journaled */
+static size_t input_idx = 0;                      /* input_pos as inputs[input_idx] + input_off */
+static uint32_t input_off = 0;
+
+static int hit_flags;
+static uint16_t hit_addr;
+
+
+static void free_checkpoint(Checkpoint *cp) {
+    int p;
+    for (p=0; p < 0x100; p++) free(cp->pages[p]);
+}
+
+static void checkpoint() {
+    Checkpoint *cp;
+    int p;
+
+    if (n_cps == MAX_CHECKPOINTS) {
+        /* fold the oldest checkpoint into the next, which then holds every page */
+        for (p=0; p < 0x100; p++) {
+            if (cps[1].pages[p]) free(cps[0].pages[p]);
+            else cps[1].pages[p] = cps[0].pages[p];
+        }
+        memmove(cps, cps + 1, --n_cps * sizeof(Checkpoint));
+    }
+    cp = cps + n_cps++;
+    cp->steps = history_steps;
+    cp->ticks = ticks;
+    cp->inputs = input_pos;
+    cp->io_mark = io_mark;
+    cp->blkpos = io_blkpos();
+    cp->pc = pc;
+    cp->a = a;
+    cp->x = x;
+    cp->y = y;
+    cp->sp = sp;
+    cp->status = status;
+    cp->waiting = waiting6502;
+    /* the magic IO pages change without write6502 so always keep those */
+    for (p=0; p < 0x100; p++) {
+        cp->pages[p] = NULL;
+        if (n_cps == 1 || (page_flags[p] & (PAGE_DIRTY | PAGE_IO))) {
+            cp->pages[p] = malloc(0x100);
+            memcpy(cp->pages[p], memory + (p << 8), 0x100);
+        }
+        page_flags[p] &= ~PAGE_DIRTY;
+    }
+    next_checkpoint = ticks + history_interval;
+}
+
+static void seek_input(uint64_t pos) {
+    input_pos = pos;
+    for (input_idx=0; input_idx < n_inputs && pos >= inputs[input_idx].count; input_idx++)
+        pos -= inputs[input_idx].count;
+    input_off = (uint32_t)pos;
+}
+
+static void restore(int k) {
+    Checkpoint *cp = cps + k;
+    int p, j;
+
+    for (p=0; p < 0x100; p++) {
+        /* only pages written since checkpoint k can differ from it */
+        for (j=n_cps-1; j > k && !cps[j].pages[p]; j--) /**/ ;
+        if (j == k && !(page_flags[p] & (PAGE_DIRTY | PAGE_IO))) continue;
+        for (j=k; !cps[j].pages[p]; j--) /**/ ;
+        memcpy(memory + (p << 8), cps[j].pages[p], 0x100);
+        /* and they can now differ from the last checkpoint */
+        page_flags[p] |= PAGE_DIRTY;
+    }
+    history_steps = cp->steps;
+    ticks = cp->ticks;
+    io_mark = cp->io_mark;
+    if (cp->blkpos >= 0) io_blkseek(cp->blkpos);
+    pc = cp->pc;
+    a = cp->a;
+    x = cp->x;
+    y = cp->y;
+    sp = cp->sp;
+    status = cp->status;
+    waiting6502 = cp->waiting;
+    seek_input(cp->inputs);
+}
+
+static uint64_t replay(uint64_t until, int check) {
+    /*
+    re-run to step until, returning the last step at which a breakpoint
+    fired (0 if none) with its flags in hit_flags, if check is set
+    */
+    uint64_t hit = 0;
+    int saved = break_flag, flags;
+
+    while (history_steps < until) {
+        break_flag = 0;
+        ticks += step6502();
+        history_steps++;
+        if (!check) continue;
+        flags = break_flag & MONITOR_DATA;
+        if (opcode == 0x00) flags |= MONITOR_BRK;
+        if (
+            (breakpoints[pc] & (MONITOR_PC | MONITOR_ONCE)) == MONITOR_PC
+            && (!(breakpoints[pc] & MONITOR_COND) || monitor_break_hit(pc))
+        ) flags |= MONITOR_PC;
+        if (flags) {
+            hit = history_steps;
+            hit_flags = flags;
+            hit_addr = rw_brk;
+        }
+    }
+    break_flag = saved;
+    return hit;
+}
+
+
+void history_start(int interval) {
+    history_stop();
+    if (!cps) cps = malloc(MAX_CHECKPOINTS * sizeof(Checkpoint));
+    history_on = 1;
+    history_interval = interval;
+    history_steps = present = 0;
+    checkpoint();
+}
+
+void history_stop() {
+    while (n_cps) free_checkpoint(cps + --n_cps);
+    n_inputs = 0;
+    input_pos = input_len = 0;
+    input_idx = input_off = 0;
+    history_on = 0;
+}
+
+void history_step() {
+    /* count a debugger step, checkpointing when one is due */
+    if (!history_on) return;
+    if (++history_steps > present) present = history_steps;
+    if (history_steps == present && ticks >= next_checkpoint) checkpoint();
+}
+
+void history_forget(int start, int end) {
+    /*
+    the monitor changed registers or memory [start, end) by hand, so what
+    was recorded from here on can't happen now: drop it, and checkpoint
+    the new state since re-running to this step would miss the change
+    */
+    Checkpoint *cp;
+    int p;
+
+    if (!history_on) return;
+    while (n_cps && (cp = cps + n_cps-1)->steps >= history_steps) {
+        /* its pages may differ from the checkpoint before */
+        for (p=0; p < 0x100; p++)
+            if (cp->pages[p]) page_flags[p] |= PAGE_DIRTY;
+        free_checkpoint(cp);
+        n_cps--;
+    }
+    n_inputs = input_idx;
+    if (input_off) inputs[n_inputs++].count = input_off;
+    input_idx = n_inputs;
+    input_off = 0;
+    input_len = input_pos;
+    present = history_steps;
+    for (p = start >> 8; start < end && p <= (end - 1) >> 8; p++) page_flags[p] |= PAGE_DIRTY;
+    checkpoint();
+}
+
+int history_replaying() {
+    return history_on && history_steps < present;
+}
+
+int history_input(uint8_t *v) {
+    /* read back journaled input, returning 0 if there's none */
+    if (!history_on || input_pos == input_len) return 0;
+    *v = inputs[input_idx].value;
+    if (++input_off == inputs[input_idx].count) {
+        input_idx++;
+        input_off = 0;
+    }
+    input_pos++;
+    return 1;
+}
+
+void history_journal(uint8_t v) {
+    if (!history_on) return;
+    if (n_inputs && inputs[n_inputs-1].value == v && inputs[n_inputs-1].count < UINT32_MAX) {
+        inputs[n_inputs-1].count++;
+    } else {
+        if (n_inputs == max_inputs) {
+            max_inputs = max_inputs ? 2 * max_inputs : 1024;
+            inputs = realloc(inputs, max_inputs * sizeof(Input));
+        }
+        inputs[n_inputs].value = v;
+        inputs[n_inputs++].count = 1;
+    }
+    input_idx = n_inputs;
+    input_pos = ++input_len;
+}
+
+int history_back(uint64_t n) {
+    /* go back n steps, or to the start of the recording, returning -1 if not recording */
+    uint64_t target;
+    int k;
+
+    if (!history_on) return -1;
+    target = n > history_steps - cps[0].steps ? cps[0].steps : history_steps - n;
+    for (k=n_cps-1; cps[k].steps > target; k--) /**/ ;
+    restore(k);
+    (void)replay(target, 0);
+    return 0;
+}
+
+int history_back_to_break() {
+    /*
+    go back to the last step where a breakpoint fired, returning its
+    MONITOR_ flags, or to the start of the recording returning 0,
+    or -1 if not recording
+    */
+    uint64_t end, hit;
+    int k, flags;
+
+    if (!history_on) return -1;
+    if (history_steps == cps[0].steps) return 0;
+    end = history_steps - 1;
+    for (k=n_cps-1; cps[k].steps > end; k--) /**/ ;
+    /* search back a checkpoint at a time, each re-run covering steps after it up to end */
+    for (;; k--) {
+        restore(k);
+        if ((hit = replay(end, 1))) {
+            flags = hit_flags;
+            /* a checkpoint at the hit may have been changed by hand, see history_forget */
+            if (k+1 < n_cps && cps[k+1].steps == hit) {
+                restore(k+1);
+            } else {
+                restore(k);
+                (void)replay(hit, 0);
+            }
+            rw_brk = hit_addr;
+            return flags;
+        }
+        if (k == 0) break;
+        end = cps[k].steps;
+    }
+    restore(0);
+    return 0;
+}
+
+void history_show() {
+    size_t bytes = 0;
+    int i, p;
+
+    if (!history_on) {
+        puts("Not recording.");
+        return;
+    }
+    for (i=0; i < n_cps; i++)
+        for (p=0; p < 0x100; p++)
+            if (cps[i].pages[p]) bytes += 0x100;
+    printf(
+        "Recording every %d ticks: %d checkpoint%s (%zu KiB of pages) "
+        "back to step %" PRIu64 ", now at step %" PRIu64 " of %" PRIu64 "\n",
+        history_interval, n_cps, n_cps == 1 ? "" : "s", bytes >> 10, cps[0].steps, history_steps, present
+    );
+}
@@ -0,0 +1,17 @@
+#define HISTORY_INTERVAL 100000     /* default ticks between checkpoints */
+
+extern int history_on, history_interval;
+extern uint64_t history_steps;
+
+void history_start(int interval);
+void history_stop();
+void history_step();
+void history_forget(int start, int end);
+
+int history_replaying();
+int history_input(uint8_t *v);
+void history_journal(uint8_t v);
+
+int history_back(uint64_t n);
+int history_back_to_break();
+void history_show();
@@ -6,11 +6,15 @@
 #ifdef WINDOWS_NATIVE
 #include <stdio.h>
 #include <conio.h> // Windows specific
+#include <io.h>
 
 void set_terminal_nb() {} // No-op
 //int _kbhit(); // _kbhit already available in conio.h
 int _getc() { return getch(); } // getch() from conio.h has no echo.
-void _putc(char ch) { putchar(ch); fflush(stdout); return; }
+int _pending() { return 0; }
+void _wait_input() {} // conio has nothing to block on, so polling goes on
+void _putc(char ch) { putchar(ch); }
+int stdout_tty() { return _isatty(_fileno(stdout)); }
 #else
 // These should work on Linux, OSX, and WSL.
 #include <stdio.h>
@@ -43,10 +47,18 @@ void set_terminal_nb() {
   new_termios.c_cflag |= CS8;
 
   tcsetattr(0, TCSANOW, &new_termios);
-
-  setbuf(stdout, NULL); /* unbuffered output */
 }
 
+/*
+input is read ahead into in_buf, as much as is ready at once, so piped
+input costs a syscall per buffer rather than a select and a read per byte
+*/
+static unsigned char in_buf[1 << 16];
+static int in_pos = 0, in_len = 0;
+
+/* non-zero if input is already buffered, so reading it won't wait */
+int _pending() { return in_pos < in_len; }
+
 /*
 compatibility with windows _kbhit, return non-zero if key ready
 see https://stackoverflow.com/questions/448944/c-non-blocking-keyboard-input
@@ -54,6 +66,7 @@ see https://stackoverflow.com/questions/448944/c-non-blocking-keyboard-input
 int _kbhit() {
   int flag;
   struct timeval tv = {0L, 0L};
+  if (_pending()) return 1;
   fd_set fds;
   FD_ZERO(&fds);
   FD_SET(0, &fds);
@@ -62,21 +75,38 @@ int _kbhit() {
   return flag;
 }
 
-/* non-blocking version of getch() */
+/* block until input is ready, or a signal interrupts the wait */
+void _wait_input() {
+  fd_set fds;
+  if (_pending()) return;
+  FD_ZERO(&fds);
+  FD_SET(0, &fds);
+  select(1, &fds, NULL, NULL, NULL);
+}
+
+/* non-blocking version of getch(), once _kbhit() says input is ready */
 int _getc() {
-  int r;
-  unsigned char c;
-  r = read(0, &c, sizeof(c));
-  return r < 0 ? r : c;
+  if (!_pending()) {
+    in_pos = 0;
+    in_len = read(0, in_buf, sizeof(in_buf));
+    if (in_len <= 0) {
+      in_len = 0;
+      return EOF;  /* select saw end of input or an error */
+    }
+  }
+  return in_buf[in_pos++];
 }
 
-void _putc(char ch) { putchar((int)ch); }
+void _putc(char ch) { putchar_unlocked((int)ch); }
+int stdout_tty() { return isatty(1); }
 #endif
 
 #include <signal.h>
 #include <stdint.h>
+#include <inttypes.h>
 #include "magicio.h"
 #include "c65.h"
+#include "history.h"
 
 /*
 blkio supports the following action values.  write the action value
@@ -97,15 +127,63 @@ typedef struct BLKIO {
 
 BLKIO *blkiop;
 FILE *fblk = NULL;
+long blkpos = 0; // file offset after the last block read or written
 int io_addr = 0xf000;
-long mark = 0;    // used for timer
+long io_mark = 0; // used for timer
+int io_buffered = 0; // -B: fully buffer output that isn't going to a terminal
+static int io_idle_wait = 0; // no debugger: idle input polls wait, see io_magic_read
 
 #define io_putc   (io_addr + 1)
 #define io_kbhit  (io_addr + 3)
 #define io_getc   (io_addr + 4)
 #define io_timer  (io_addr + 6)
+#define io_tag    (io_addr + 12)
+#define io_perf   (io_addr + 13)
+#define io_perfbuf (io_addr + 14)
 #define io_blkio  (io_addr + 16)
 
+/*
+Performance counters.  Writing io_perf copies all PERF_COUNTERS, 64 bits
+each little-endian, to the buffer at the low-endian pointer in io_perfbuf.
+Writing io_tag starts a region: the counts up to then go to the region
+that is ending, and once any tag has been written io_exit() prints each
+region's totals.  Everything before the first tag is region 0.
+*/
+static uint64_t perf_totals[256][PERF_COUNTERS];
+static uint64_t perf_mark[PERF_COUNTERS];
+static int perf_region = 0, perf_tagged = 0;
+
+static const char *perf_names[PERF_COUNTERS] = {
+  "cycles", "instructions", "penalty", "reads", "writes"
+};
+
+static void perf_switch(int tag) {
+  uint64_t now[PERF_COUNTERS];
+  int i;
+
+  perf_read(now);
+  for (i = 0; i < PERF_COUNTERS; i++) {
+    perf_totals[perf_region][i] += now[i] - perf_mark[i];
+    perf_mark[i] = now[i];
+  }
+  perf_region = tag;
+}
+
+static void perf_summary() {
+  int tag, i;
+
+  perf_switch(perf_region);
+  printf("c65: region");
+  for (i = 0; i < PERF_COUNTERS; i++) printf(" %14s", perf_names[i]);
+  printf("\n");
+  for (tag = 0; tag < 256; tag++) {
+    if (!perf_totals[tag][PERF_CYCLES]) continue;
+    printf("c65: $%02x   ", tag);
+    for (i = 0; i < PERF_COUNTERS; i++) printf(" %14" PRIu64, perf_totals[tag][i]);
+    printf("\n");
+  }
+}
+
 
 void sigint_handler() {
   // catch ctrl-c and break back to monitor
@@ -113,39 +191,200 @@ void sigint_handler() {
   break_flag |= MONITOR_SIGINT;
 }
 
+static char io_outbuf[1 << 16];
+
 void io_init(int debug) {
   /* initialize blkio struct once io_addr is set */
   blkiop = (BLKIO *)(memory + io_blkio);
   set_terminal_nb();
+  /*
+  output collects in io_outbuf and goes out at each newline, when the
+  program reads input (see io_magic_read) and at exit; with -B and no
+  terminal it only goes out when the buffer fills, or at input and exit.
+  */
+  setvbuf(stdout, io_outbuf,
+          io_buffered && !stdout_tty() ? _IOFBF : _IOLBF, sizeof(io_outbuf));
   if (debug) signal(SIGINT, sigint_handler);
+  io_idle_wait = !debug;
 }
 
 void io_exit() {
+    if (perf_tagged && !quiet) perf_summary();
     io_blkfile(NULL);
 }
 
 
+#ifdef WINDOWS_NATIVE
+/* no mmap: blocks go through stdio, flushed by io_blksync() and at exit */
+
+static void blk_open() {}
+static void blk_close() {}
+
+static void blk_read(uint8_t *dst) {
+  fseek(fblk, blkpos, SEEK_SET);
+  fread(dst, 1024, 1, fblk);
+  blkpos = ftell(fblk);
+}
+
+static void blk_write(const uint8_t *src) {
+  fseek(fblk, blkpos, SEEK_SET);
+  fwrite(src, 1024, 1, fblk);
+  blkpos = ftell(fblk);
+}
+
+void io_blksync() {
+  if (fblk) fflush(fblk);
+}
+#else
+/*
+The block file is mapped shared, so a read is a memcpy and a write lands in
+the page cache for the kernel to write out; io_blksync() forces it to disk.
+A write past the end grows the file, as fwrite would, and maps it again.
+*/
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static uint8_t *blk_map = NULL;
+static size_t blk_size = 0;
+
+static void blk_map_file(size_t size) {
+  if (blk_map) munmap(blk_map, blk_size);
+  blk_map = NULL;
+  blk_size = 0;
+  if (size == 0) return; /* can't map an empty file */
+  blk_map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                 fileno(fblk), 0);
+  if (blk_map == MAP_FAILED) {
+    blk_map = NULL;
+    return;
+  }
+  blk_size = size;
+}
+
+static void blk_open() {
+  struct stat st;
+  if (fstat(fileno(fblk), &st) == 0) blk_map_file((size_t)st.st_size);
+}
+
+static void blk_close() {
+  io_blksync();
+  blk_map_file(0);
+}
+
+static void blk_read(uint8_t *dst) {
+  size_t off = (size_t)blkpos, n;
+  if (off >= blk_size) return;
+  n = blk_size - off < 1024 ? blk_size - off : 1024;
+  memcpy(dst, blk_map + off, n);
+  blkpos += n;
+}
+
+static void blk_write(const uint8_t *src) {
+  size_t end = (size_t)blkpos + 1024;
+  if (end > blk_size) {
+    if (ftruncate(fileno(fblk), (off_t)end) != 0) return;
+    blk_map_file(end);
+    if (!blk_map) return;
+  }
+  memcpy(blk_map + blkpos, src, 1024);
+  blkpos += 1024;
+}
+
+void io_blksync() {
+  if (blk_map) msync(blk_map, blk_size, MS_SYNC);
+}
+#endif
+
+
 FILE* io_blkfile(const char *fname) {
-  if (fblk) fclose(fblk);
+  if (fblk) {
+    blk_close();
+    fclose(fblk);
+    fblk = NULL;
+  }
   if (fname) fblk = fopen(fname, "r+b");
+  if (fblk) blk_open();
+  blkpos = 0;
   return fblk;
 }
 
 
+/* block file position for snapshots, -1 if no block file is open */
+long io_blkpos() {
+  return fblk ? blkpos : -1;
+}
+
+void io_blkseek(long pos) {
+  if (fblk) blkpos = pos;
+}
+
+
+/*
+A program waiting for a key polls kbhit or getc in a loop.  Without the
+debugger, once a poll comes up empty from the same instruction with the
+same registers as the last one, with nothing written and no other magic
+IO read in between, the loop can see nothing new until a key arrives:
+rather than spin through it, c65 waits for one.  There's no timer event
+to wake for, as the cycle counter is only read on demand, so the cycles
+simply stop while it waits.
+*/
+static uint64_t io_reads = 0;
+static struct {
+  int empty;
+  uint16_t pc;
+  uint8_t a, x, y, sp, status;
+  uint64_t reads, writes;
+} io_poll;
+
+static int io_poll_idle() {
+  return io_idle_wait && io_poll.empty && io_poll.pc == pc
+    && io_poll.a == a && io_poll.x == x && io_poll.y == y
+    && io_poll.sp == sp && io_poll.status == status
+    && io_poll.reads + 1 == io_reads && io_poll.writes == writes6502;
+}
+
+static void io_poll_done(uint8_t v) {
+  io_poll.empty = !v;
+  io_poll.pc = pc;
+  io_poll.a = a;
+  io_poll.x = x;
+  io_poll.y = y;
+  io_poll.sp = sp;
+  io_poll.status = status;
+  io_poll.reads = io_reads;
+  io_poll.writes = writes6502;
+}
+
 void io_magic_read(uint16_t addr) {
   int ch;
   long delta;
 
+  io_reads++;
+  if (addr == io_kbhit || addr == io_getc) {
+    /* a re-run of recorded history reads what the first run did */
+    if (history_input(memory + addr)) return;
+    /* a program waiting for input has usually just prompted for it */
+    if (!_pending()) fflush(stdout);
+    if (io_poll_idle()) _wait_input();
+  }
   if (addr == io_kbhit) {
     memory[addr] = _kbhit() ? 0xff : 0;
+    history_journal(memory[addr]);
+    io_poll_done(memory[addr]);
   } else if (addr == io_getc) {
     ch = break_flag ? 0x03 : (_kbhit() ? _getc() : 0);
-    if (ch == EOF) break_flag |= MONITOR_EXIT;
+    if (ch == EOF) {
+      /* exit, with getc reading as no key so a -S snapshot resumes polling */
+      break_flag |= MONITOR_EXIT;
+      ch = 0;
+    }
     memory[addr] = (uint8_t)ch;
+    history_journal(memory[addr]);
+    io_poll_done(memory[addr]);
   } else if (addr == io_timer /* start timer */) {
-    mark = ticks;
+    io_mark = ticks;
   } else if (addr == io_timer + 1 /* stop timer */) {
-    delta = ticks - mark;
+    delta = ticks - io_mark;
     memory[io_timer + 2] = (uint8_t)((delta >> 16) & 0xff);
     memory[io_timer + 3] = (uint8_t)((delta >> 24) & 0xff);
     memory[io_timer + 4] = (uint8_t)((delta >> 0) & 0xff);
@@ -155,20 +394,43 @@ void io_magic_read(uint16_t addr) {
 
 
 void io_magic_write(uint16_t addr, uint8_t val) {
+  uint64_t counters[PERF_COUNTERS];
+  uint16_t buf;
+  int page, i, j;
+
   if (addr == io_putc) {
-    _putc(val);
+    if (!history_replaying()) _putc(val);
+  } else if (addr == io_tag) {
+    perf_switch(val);
+    perf_tagged = 1;
+  } else if (addr == io_perf) {
+    perf_read(counters);
+    buf = memory[io_perfbuf] | memory[io_perfbuf + 1] << 8;
+    for (i = 0; i < PERF_COUNTERS; i++)
+      for (j = 0; j < 8; j++)
+        memory[(uint16_t)(buf + 8*i + j)] = (uint8_t)(counters[i] >> 8*j);
+    for (page = buf >> 8; page <= (buf + 8*PERF_COUNTERS - 1) >> 8; page++) {
+      page_flags[page & 0xff] |= PAGE_DIRTY;
+      flush_code_page(page & 0xff);
+    }
   } else if (addr == io_blkio) {
     blkiop->status = 0xff;
     if (fblk) {
       if (val < 3) {
         blkiop->status = 0;
         if (val == 1 || val == 2) {
-          fseek(fblk, 1024 * blkiop->blknum, SEEK_SET);
+          blkpos = 1024L * blkiop->blknum;
           if (val == 1) {
-            fread(memory + blkiop->bufptr, 1024, 1, fblk);
+            blk_read(memory + blkiop->bufptr);
+            /* read straight into memory, not through write6502 */
+            for (page = blkiop->bufptr >> 8; page <= (blkiop->bufptr + 1023) >> 8; page++) {
+              page_flags[page & 0xff] |= PAGE_DIRTY;
+              flush_code_page(page & 0xff);
+            }
+          } else if (history_replaying()) {
+            blkpos += 1024;  /* written the first time round */
           } else {
-            fwrite(memory + blkiop->bufptr, 1024, 1, fblk);
-            fflush(fblk);
+            blk_write(memory + blkiop->bufptr);
           }
         }
       }
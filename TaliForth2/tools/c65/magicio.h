@@ -1,8 +1,13 @@
 extern int io_addr;
+extern long io_mark;
+extern int io_buffered;
 
 void io_init(int debug);
 void io_exit();
 
 FILE* io_blkfile(const char *fname);
+long io_blkpos();
+void io_blksync();
+void io_blkseek(long pos);
 void io_magic_read(uint16_t addr);
 void io_magic_write(uint16_t addr, uint8_t);
@@ -13,6 +13,7 @@
 #include "parse.h"
 #include "c65.h"
 #include "magicio.h"
+#include "history.h"
 #include "linenoise.h"
 
 
@@ -45,6 +46,37 @@ const int _monitor_vals[] = {
     MONITOR_READ, MONITOR_WRITE, MONITOR_DATA, MONITOR_PC, MONITOR_PC
 };
 
+/* optional clauses after break, avoiding names that start with hex digits */
+#define CLAUSE_IF 0
+#define CLAUSE_HITS 1
+#define CLAUSE_LOG 2
+
+const char* _clause_names[] = {
+    "if", "hits", "log", 0
+};
+
+const int _clause_vals[] = {
+    CLAUSE_IF, CLAUSE_HITS, CLAUSE_LOG
+};
+
+/*
+A breakpoint with clauses gets a BreakCond, shared by every address in the
+range it was set on, which are flagged MONITOR_COND.  Hits that fail the
+condition are ignored, and of the rest only every nth counts: that one
+either logs and carries on or breaks.  None of this is in snapshots, so
+the breakpoints come back unconditional.
+*/
+typedef struct BreakCond {
+    int refs;               /* addresses sharing this */
+    int has_test, has_log;
+    Code test, log;
+    int every, hits;
+    char log_text[64];      /* the log expression as typed */
+    char text[128];         /* all the clauses, for inspect */
+} BreakCond;
+
+static BreakCond *break_conds[0x10000];
+
 char* prompt() {
     sprintf(_prompt,
         TXT_LO "PC" TXT_N " %.4x  "
@@ -205,7 +237,7 @@ char* _fmt_addr(char *buf, uint16_t addr, int len) {
 uint16_t disasm(uint16_t start, uint16_t end) {
     uint8_t op, k, n;
     int8_t offset;
-    char line[80], buf[32], *p;
+    char line[80], buf[2*17], *p;     /* two labels of up to 16 chars */
     const char *fmt;
     const Symbol *sym;
     const int n_fmt = strlen(TXT_LO);
@@ -259,7 +291,7 @@ uint16_t disasm(uint16_t start, uint16_t end) {
             /* 1 or 2 bytes with relative address */
             offset = memory[addr + n-2];
             if (n==3) {
-                p += sprintf(p, fmt, _fmt_addr(buf+16, memory[addr], 2), _fmt_addr(buf, addr+2+offset, 4), offset);
+                p += sprintf(p, fmt, _fmt_addr(buf+17, memory[addr], 2), _fmt_addr(buf, addr+2+offset, 4), offset);
                 addr+=2;
             } else {
                 p += sprintf(p, fmt, _fmt_addr(buf, addr+1+offset, 4), offset);
@@ -328,9 +360,20 @@ void cmd_go() {
     /* run indefinitely from optional addr or PC*/
     if (E_OK != parse_addr(&pc, pc) || E_OK != parse_end()) return;
 
+    history_forget(0, 0);
     step_mode = STEP_RUN;
 }
 
+void show_stop(int flags) {
+    /* show where the simulation stopped, given its break_flag */
+    org = pc;
+    if (flags & MONITOR_DATA) {
+        printf("%.4x: memory %s\n", rw_brk, flags & MONITOR_READ ? "read": "write");
+        dump(rw_brk & 0xfff0, rw_brk | 0xf);
+    }
+    disasm(pc, pc+1);
+}
+
 void cmd_continue() {
     /* run indefinitely, optionally to one-time breakpoint */
     uint16_t addr;
@@ -359,6 +402,58 @@ void cmd_next() {
     _cmd_single(STEP_NEXT);
 }
 
+void cmd_rstep() {
+    /* step backwards by re-running recorded history */
+    int v;
+
+    if (E_OK != parse_int(&v, 1) || E_OK != parse_end()) return;
+    if (v < 1) {
+        printf("rstep: count %d out of range\n", v);
+        return;
+    }
+    if (history_back(v) < 0) {
+        puts("Not recording, see record");
+        return;
+    }
+    show_stop(0);
+}
+
+void cmd_rcontinue() {
+    /* run backwards to the last breakpoint */
+    int flags;
+
+    if (E_OK != parse_end()) return;
+    if ((flags = history_back_to_break()) < 0) {
+        puts("Not recording, see record");
+        return;
+    }
+    if (!flags) puts("Reached the start of the recording");
+    show_stop(flags);
+}
+
+void cmd_record() {
+    /* record [on|off] [ticks] */
+    const char* _names[] = {"on", "off", 0};
+    const int _vals[] = {1, 0};
+    uint8_t on = 1;
+    int v, err;
+
+    if ((err = parse_enum(_names, _vals, &on, DEFAULT_OPTIONAL)) == E_MISSING) {
+        err = parse_int(&v, DEFAULT_OPTIONAL);
+        if (err == E_MISSING) {
+            if (E_OK == parse_end()) history_show();
+            return;
+        }
+    } else if (err == E_OK && on) {
+        err = parse_int(&v, history_interval);
+    }
+    if (err != E_OK || E_OK != parse_end()) return;
+
+    if (!on) history_stop();
+    else if (v < 1) printf("record: interval %d out of range\n", v);
+    else history_start(v);
+}
+
 void cmd_call() {
     uint16_t ret = pc, target;
 
@@ -373,6 +468,7 @@ void cmd_call() {
     memory[BASE_STACK + sp] = (ret >> 8) & 0xFF;
     memory[BASE_STACK + ((sp - 1) & 0xFF)] = ret & 0xFF;
     sp -= 2;
+    history_forget(BASE_STACK, BASE_STACK + 0x100);
 
     step_mode = STEP_RUN;
 }
@@ -389,6 +485,7 @@ void cmd_signal() {
         case 1: irq6502(); break;
         case 2: nmi6502(); break;
     }
+    history_forget(0, 0);
 }
 
 void cmd_disasm() {
@@ -414,18 +511,91 @@ void cmd_stack() {
     dump(sp + 0x101, 0x200);
 }
 
+int monitor_break_hit(uint16_t addr) {
+    /* called on hitting a MONITOR_COND breakpoint, returning non-zero to break */
+    BreakCond *bc = break_conds[addr];
+    int v;
+
+    if (!bc) return 1;
+    if (bc->has_test && (eval_code(&bc->test, &v) || !v)) return 0;
+    if (++bc->hits < bc->every) return 0;
+    bc->hits = 0;
+    if (!bc->has_log) return 1;
+    if (history_replaying()) return 0;  /* logged the first time round */
+    if (!eval_code(&bc->log, &v))
+        printf("%.4x log %s :=  $%x  #%d\n", addr, bc->log_text, v, v);
+    else
+        printf("%.4x log %s :=  error\n", addr, bc->log_text);
+    return 0;
+}
+
+static void set_break_cond(int addr, BreakCond *bc) {
+    BreakCond *old = break_conds[addr];
+
+    if (old && !--old->refs) free(old);
+    break_conds[addr] = bc;
+    if (bc) {
+        bc->refs++;
+        breakpoints[addr] |= MONITOR_COND;
+    } else {
+        breakpoints[addr] &= ~MONITOR_COND;
+    }
+}
+
 void cmd_break() {
     uint16_t start, end;
-    uint8_t mode;
-    int endl, addr;
+    uint8_t mode, clause;
+    int endl, addr, err, n, len;
+    char *arg;
+    BreakCond bc, *p = NULL;
 
     if (E_OK != parse_range(&start, &end, pc, 1)) return;
     endl = end < start ? 0x10000 : end;
 
-    if (E_OK != parse_enum(_monitor_names, _monitor_vals, &mode, MONITOR_PC) || E_OK != parse_end()) return;
+    err = parse_enum(_monitor_names, _monitor_vals, &mode, DEFAULT_OPTIONAL);
+    if (err == E_MISSING) mode = MONITOR_PC;
+    else if (err != E_OK) return;
+
+    memset(&bc, 0, sizeof(bc));
+    bc.every = 1;
+    while (E_OK == parse_enum(_clause_names, _clause_vals, &clause, DEFAULT_OPTIONAL)) {
+        switch (clause) {
+            case CLAUSE_IF:
+                if (E_OK != parse_code(&bc.test)) return;
+                bc.has_test = 1;
+                break;
+            case CLAUSE_HITS:
+                if (E_OK != parse_int(&bc.every, DEFAULT_REQUIRED)) return;
+                if (bc.every < 1) {
+                    printf("hits: value %d out of range\n", bc.every);
+                    return;
+                }
+                break;
+            case CLAUSE_LOG:
+                if (E_OK != parse_code(&bc.log)) return;
+                bc.has_log = 1;
+                break;
+        }
+        /* keep the clause as typed */
+        for (arg = parsed_str(), len = parsed_length(); len && isblank(*arg); arg++, len--) /**/ ;
+        if (clause == CLAUSE_LOG) snprintf(bc.log_text, sizeof(bc.log_text), "%.*s", len, arg);
+        n = strlen(bc.text);
+        snprintf(bc.text + n, sizeof(bc.text) - n, "%s%s %.*s",
+            n ? " " : "", _clause_names[clause], len, arg);
+    }
+    if (E_OK != parse_end()) return;
 
-    for(addr=start; addr < endl; addr++)
+    /* a breakpoint without clauses replaces any with them */
+    if (bc.has_test || bc.has_log || bc.every > 1) {
+        p = malloc(sizeof(BreakCond));
+        *p = bc;
+    }
+    for(addr=start; addr < endl; addr++) {
         breakpoints[addr] |= mode;
+        set_break_cond(addr, p);
+    }
+    if (p && !p->refs) free(p);
+    update_watch_pages(start, endl);
     org = start;
 }
 
@@ -445,17 +615,19 @@ void cmd_delete() {
     for(n=0, addr=start; addr < endl; addr++)
         if (breakpoints[addr] & mode) {
             breakpoints[addr] &= ~mode;
+            if (!(breakpoints[addr] & MONITOR_ANY)) set_break_cond(addr, NULL);
             n++;
         }
+    update_watch_pages(start, endl);
     org = start;
     printf("Removed %d breakpoint%s.\n", n, n==1?"":"s");
 }
 
 void cmd_inspect() {
     /* show breakpoints and labels for a range of memory */
-    uint16_t start, end, nmax, raddr, waddr, xaddr;
-    uint64_t rmax, wmax, xmax;
-    int endl, addr, span, n, prv, brk, new;
+    uint16_t start, end, nmax, raddr = 0, waddr = 0, xaddr = 0;
+    uint64_t rmax = 0, wmax = 0, xmax = 0;
+    int endl, addr, span, n, prv, brk = 0, new;
     const Symbol *sym;
 
     if (
@@ -502,6 +674,7 @@ void cmd_inspect() {
                 if (--span != addr) printf("  w %.4x.%.4x", addr, span);
                 else printf("  w %.4x", addr);
             }
+            if (break_conds[addr]) printf("  %s", break_conds[addr]->text);
             puts("");
             n++;
         }
@@ -525,6 +698,8 @@ void cmd_set() {
     if (E_OK != parse_int(&v, DEFAULT_REQUIRED) || E_OK != parse_end()) return;
     if (E_OK != set_reg_or_flag(name, v))
         puts("Unknown register/flag, expected one of a,x,y,sp,pc or n,v,b,d,i,z,c");
+    else
+        history_forget(0, 0);
 }
 
 void cmd_ticks() {
@@ -533,6 +708,7 @@ void cmd_ticks() {
 
     if (E_OK == (err = parse_int(&v, DEFAULT_OPTIONAL))) {
         ticks = v;
+        history_forget(0, 0);
     } else if (E_MISSING == err) {
         printf("%" PRIu64 " ticks\n", ticks);
     }
@@ -567,6 +743,7 @@ void cmd_fill() {
     while (addr < endl) {
         memory[addr++] = memory[start++];
     }
+    history_forget(org, endl);
 }
 
 static char _bits[33];
@@ -627,7 +804,10 @@ void cmd_blockfile() {
     if (E_OK != parse_end()) return;
 
     if(!p) puts("Missing block file name");
-    else io_blkfile(p);
+    else {
+        io_blkfile(p);
+        history_forget(0, 0);
+    }
 }
 
 void cmd_load() {
@@ -640,7 +820,7 @@ void cmd_load() {
     }
     if (E_OK != parse_addr(&addr, DEFAULT_REQUIRED) || E_OK != parse_end()) return;
 
-    (void)load_memory(fname, addr);
+    if (0 == load_memory(fname, addr)) history_forget(0, 0x10000);
     org = addr;
 }
 
@@ -660,11 +840,36 @@ void cmd_save() {
 }
 
 
+void cmd_snapshot() {
+    const char* fname = parse_delim();
+
+    if (!fname) {
+        puts("Missing snapshot file name");
+        return;
+    }
+    if (E_OK != parse_end()) return;
+
+    (void)save_snapshot(fname);
+}
+
+void cmd_restore() {
+    const char* fname = parse_delim();
+
+    if (!fname) {
+        puts("Missing snapshot file name");
+        return;
+    }
+    if (E_OK != parse_end()) return;
+
+    /* the recording so far doesn't lead here */
+    if (0 == load_snapshot(fname) && history_on) history_start(history_interval);
+}
+
 void cmd_heatmap() {
     /* heatmap [clear|save mapfile] [range] [r|w|d|x] */
     uint16_t start=0, end=0;
     uint8_t mode, cmd=0;
-    const char *fname, *_sub_names[] = { "clear", "save", 0 };
+    const char *fname = NULL, *_sub_names[] = { "clear", "save", 0 };
     const int _sub_vals[] = {1, 2};
     int err;
 
@@ -730,13 +935,17 @@ Command _cmds[] = {
     { "continue [addr]", "- run from pc until breakpoint (or optional addr)", 1, cmd_continue },
     { "step", "- [count] step by single instructions", 1, cmd_step },
     { "next", "- [count] like step but treats jsr ... rts as one step", 1, cmd_next },
+    { "rstep", "- [count] step backwards by single instructions", 1, cmd_rstep },
+    { "rcontinue", "- run backwards to the previous breakpoint", 0, cmd_rcontinue },
+    { "record", "[on|off] [ticks] - show, restart or stop recording for rstep and rcontinue, checkpointing every ticks cycles", 0, cmd_record },
     { "call", "addr - call subroutine leaving PC unchanged", 0, cmd_call },
     { "signal", "irq|nmi|reset - signal an interrupt", 0, cmd_signal },
 
     { "disassemble", "[range] - show code disassembly for range (or current)", 1, cmd_disasm },
     { "memory", "[range] - dump memory contents for range (or current)", 1, cmd_memory },
     { "stack", "- show stack contents, sp+1 through $1ff", 0, cmd_stack },
-    { "break",  "[range] [r|w|d|x] - trigger break on read, write, any access or execute (default)", 0, cmd_break },
+    { "break",  "[range] [r|w|d|x] [if expr] [hits n] [log expr] - trigger break on read, write, any access or execute (default), "
+                "optionally only when expr is true, on every nth hit, or printing expr without stopping", 0, cmd_break },
     { "delete",  "[range] - remove all breakpoints in range (default PC)", 0, cmd_delete },
     { "inspect", "[range] [max] - show labels and breakpoints in range, up to max lines", 0, cmd_inspect },
 
@@ -749,6 +958,8 @@ Command _cmds[] = {
 
     { "load", "romfile addr - read binary file to memory", 0, cmd_load },
     { "save", "romfile [range] - write memory to file (default full dump)", 0, cmd_save },
+    { "snapshot", "file - write registers, memory, ticks and breakpoints to file", 0, cmd_snapshot },
+    { "restore", "file - resume from a snapshot file", 0, cmd_restore },
     { "heatmap", " [clear|save mapfile] [range] [r|w|d|x] - view, reset or save heatmap data", 0, cmd_heatmap },
     { "blockfile", "[blockfile] - use binary file for block storage, empty to disable", 0, cmd_blockfile },
     { "quit", "- leave c65", 0, cmd_quit },
@@ -853,15 +1064,11 @@ void monitor_command() {
     char *line;
 
     if (step_mode != STEP_NONE) {
-        org = pc;
         step_mode = STEP_NONE;
-        if (break_flag & MONITOR_DATA) {
-            printf("%.4x: memory %s\n", rw_brk, break_flag & MONITOR_READ ? "read": "write");
-            dump(rw_brk & 0xfff0, rw_brk | 0xf);
-        }
-        disasm(pc, pc+1);
+        show_stop(break_flag);
     }
 
+    fflush(stdout);  /* linenoise writes to the terminal directly */
     line = linenoise(prompt());
     if (!line) return;
 
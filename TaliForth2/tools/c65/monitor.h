@@ -1,3 +1,4 @@
 void monitor_init(const char *labelfile);
 void monitor_exit();
 void monitor_command();
+int monitor_break_hit(uint16_t addr);
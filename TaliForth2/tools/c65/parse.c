@@ -26,6 +26,8 @@ T --> val | "(" E ")" | ~ T
 #define EX_UNARY 6
 #define EX_BINARY 7
 #define EX_TERNARY 8
+#define EX_ZERO 9
+#define EX_CODE 10
 
 
 #define OP_NONE 0               /* special sentinal */
@@ -38,7 +40,15 @@ T --> val | "(" E ")" | ~ T
 #define OP_OR 0x02
 #define BINOP_FLAG 0x80     /* flags binary operators in the operator stack */
 
-Symbol *symbols = NULL;
+/*
+Labels are chained from a hash of their name, and from their address.
+Each address chain is newest first, so the most recently added label is
+the one that names an address.
+*/
+#define SYMBOL_BUCKETS 4096     /* power of two */
+
+static Symbol *symbols_by_name[SYMBOL_BUCKETS];
+static Symbol *symbols_by_value[0x10000];
 
 char *cursor, *parse_last;
 
@@ -46,6 +56,7 @@ char *cursor, *parse_last;
 static unsigned char opstk[32]; /* stack of operators */
 static int valstk[32], qstk[32], literal; /* stack of values, ?: conditions, and most recent literal */
 static uint16_t n_op, n_val, n_q;    /* stack pointers */
+static Code *emit;      /* when set, compile operators to postfix code rather than applying them */
 
 /* characters representing each operator, usually corresponding to the input text */
 const char
@@ -97,8 +108,8 @@ int apply_unary(unsigned char op, int v, int *out) {
 int apply_binary(unsigned char op, int a, int b, int *out) {
     switch (op) {
         case '*': *out = a * b; return EX_OK;
-        case '/': *out = a / b; return EX_OK;
-        case '%': *out = a % b; return EX_OK;
+        case '/': if (!b) return EX_ZERO; *out = a / b; return EX_OK;
+        case '%': if (!b) return EX_ZERO; *out = a % b; return EX_OK;
 
         case '+': *out = a + b; return EX_OK;
         case '-': *out = a - b; return EX_OK;
@@ -130,64 +141,67 @@ int apply_binary(unsigned char op, int a, int b, int *out) {
     return EX_BINARY;
 }
 
+static Symbol** name_bucket(const char *name) {
+    /* FNV-1a */
+    uint32_t h = 2166136261u;
+    for (; *name; name++) h = (h ^ (uint8_t)*name) * 16777619u;
+    return &symbols_by_name[h & (SYMBOL_BUCKETS - 1)];
+}
+
+/* unlink sym from its address chain and free it (it's already off its name chain) */
+static void free_symbol(Symbol *sym) {
+    Symbol **p;
+    for (p = &symbols_by_value[sym->value]; *p != sym; p = &(*p)->next_value) /**/ ;
+    *p = sym->next_value;
+    free((void*)sym->name);
+    free(sym);
+}
+
 void add_symbol(const char* name, uint16_t value) {
-    Symbol *sym, *prv;
+    Symbol *sym, **bucket = name_bucket(name);
 
     /* first discard any existing label with the same name */
-    for (prv=NULL, sym=symbols; sym; prv=sym, sym=sym->next) {
-        if (0==strcmp(sym->name, name)) {
-            if (prv) prv->next = sym->next;
-            else symbols = sym->next;
-            free((void*)sym->name);
-            free(sym);
-            break;
-        }
-    }
+    remove_symbol(name);
 
-    /* add the new label to head of list*/
+    /* add the new label to the head of both chains */
     sym = malloc(sizeof(Symbol));
     sym->name = strdup(name);
     sym->value = value;
-    sym->next = symbols;
-    symbols = sym;
+    sym->next_name = *bucket;
+    *bucket = sym;
+    sym->next_value = symbols_by_value[value];
+    symbols_by_value[value] = sym;
 }
 
 const Symbol* get_symbol(const char *name) {
     Symbol *sym;
-    for(sym=symbols; sym && 0 != strcmp(sym->name, name); sym = sym->next) /**/ ;
+    for(sym=*name_bucket(name); sym && 0 != strcmp(sym->name, name); sym = sym->next_name) /**/ ;
     return sym;
 }
 
 const Symbol* get_next_symbol_by_value(const Symbol* sym, uint16_t value) {
-    for(sym = sym ? sym ->next : symbols; sym && sym->value != value; sym = sym->next) /**/ ;
-    return sym;
+    return sym ? sym->next_value : symbols_by_value[value];
 }
 
 void remove_symbol(const char *name) {
-    Symbol *prv, *sym;
-    for (prv=NULL, sym=symbols; sym && 0 != strcmp(sym->name, name); prv=sym, sym=sym->next) /**/ ;
+    Symbol **p, *sym;
+    for (p = name_bucket(name); (sym = *p) && 0 != strcmp(sym->name, name); p = &sym->next_name) /**/ ;
 
     if (sym) {
-        if (prv) prv->next = sym->next;
-        else symbols = sym->next;
-        free((void*)sym->name);
-        free(sym);
+        *p = sym->next_name;
+        free_symbol(sym);
     }
 }
 
 int remove_symbols_by_value(uint16_t value) {
-    Symbol *prv, *sym;
+    Symbol *sym, **p;
     int n=0;
     /* remove all labels matching addr */
-    for (prv=NULL, sym=symbols; sym; prv=sym, sym=sym->next) {
-        if(sym->value == value) {
-            if (prv) prv->next = sym->next;
-            else symbols = sym->next;
-            free((void*)sym->name);
-            free(sym);
-            sym = prv ? prv : symbols;
-            n++;
-        }
+    while ((sym = symbols_by_value[value])) {
+        for (p = name_bucket(sym->name); *p != sym; p = &(*p)->next_name) /**/ ;
+        *p = sym->next_name;
+        free_symbol(sym);
+        n++;
     }
     return n;
 }
@@ -202,7 +216,7 @@ int symlen(const char *s) {
 unsigned char maybe_literal(void) {
     char *p;
     static char name[64];
-    int base, n;
+    int base, n, id;
     const Symbol *sym;
 
     n = symlen(cursor);
@@ -213,8 +227,14 @@ unsigned char maybe_literal(void) {
         strncpy(name, cursor, n);
         name[n] = 0;
         /* is it dynamic symbol? */
-        if ((literal = get_reg_or_flag(name)) >= 0) {
+        if ((id = get_reg_or_flag_id(name)) >= 0) {
             cursor += n;
+            /* compiled code reads registers each time it runs */
+            if (emit) {
+                literal = id;
+                return 'r';
+            }
+            literal = get_reg_or_flag_by_id(id);
             return '#';
         }
         /* regular symbol? */
@@ -297,10 +317,22 @@ unsigned char next_token(uint8_t need_binary) {
     return tok;
 }
 
+int emit_code(unsigned char op, int arg) {
+    if (emit->n == CODE_MAX) return EX_CODE;
+    emit->op[emit->n] = op;
+    emit->arg[emit->n++] = arg;
+    return EX_OK;
+}
+
 int pop_op() {
     /* process the top operator on the stack, consuming its input value(s) to produce an output value */
     unsigned char tok = opstk[--n_op];
     int err;
+    if (emit) {
+        /* just track the value stack depth */
+        if (tok & BINOP_FLAG) n_val--;
+        return emit_code(tok, 0);
+    }
     if (tok & BINOP_FLAG) {
         tok ^= BINOP_FLAG;
         err = apply_binary(tok, valstk[n_val-2], valstk[n_val-1], valstk + n_val-2);
@@ -336,8 +368,9 @@ int match_term() {
     int err;
 
     tok = next_token(0);
-    if (tok == '#') {
+    if (tok == '#' || tok == 'r') {
         valstk[n_val++] = literal;
+        if (emit && (err = emit_code(tok, literal))) return err;
     } else if (tok == '(') {
         if ((err = push_op(OP_NONE))) return err;
         if ((err = match_expr())) return err;
@@ -412,6 +445,12 @@ void show_error(int error) {
         case EX_TERNARY:
             puts("unbalanced or ambiguous ?: expression");
             break;
+        case EX_ZERO:
+            puts("division by zero");
+            break;
+        case EX_CODE:
+            puts("expression too long");
+            break;
     }
     /* restore delimited word if that was last */
     if (strlen(parse_last) < cursor - parse_last)
@@ -545,6 +584,50 @@ int parse_addr(uint16_t *v, int dflt) {
     return E_OK;
 }
 
+/* compile an expression to code for eval_code */
+int parse_code(Code *code) {
+    int err, i, q, v;
+
+    parse_last = cursor;
+    code->n = 0;
+    emit = code;
+    err = strexpr(parse_last, &v);
+    emit = NULL;
+    /* ?: is resolved as the code runs, so check it pairs up now */
+    for (q=i=0; !err && i < code->n; i++)
+        if (code->op[i] == ('?' | BINOP_FLAG)) q++;
+        else if (code->op[i] == (':' | BINOP_FLAG) && !q--) err = EX_TERNARY;
+    if (!err && q) err = EX_TERNARY;
+    if (err) {
+        show_error(err);
+        return E_PARSE;
+    }
+    return E_OK;
+}
+
+/* run compiled code, returning non-zero if an operator fails (e.g. division by zero) */
+int eval_code(const Code *code, int *result) {
+    int stk[CODE_MAX], n=0, i, err=EX_OK;
+    unsigned char op;
+
+    n_q = 0;
+    for (i=0; !err && i < code->n; i++) {
+        op = code->op[i];
+        if (op == '#') {
+            stk[n++] = code->arg[i];
+        } else if (op == 'r') {
+            stk[n++] = get_reg_or_flag_by_id(code->arg[i]);
+        } else if (op & BINOP_FLAG) {
+            n--;
+            err = apply_binary(op ^ BINOP_FLAG, stk[n-1], stk[n], stk + n-1);
+        } else {
+            err = apply_unary(op, stk[n-1], stk + n-1);
+        }
+    }
+    if (!err) *result = stk[0];
+    return err;
+}
+
 /* parse a range expression start.end or start,offset */
 int parse_range(uint16_t* start, uint16_t* end, int dflt_start, int dflt_length) {
     int dflt, err;
@@ -1,12 +1,13 @@
 /*
-Linked list of symbolic address labels.
+Symbolic address labels, indexed by name and by address.
 We can have multiple labels for a single address,
 but require that label names are unique.
 */
 typedef struct Symbol {
     const char *name;
     uint16_t value;
-    struct Symbol* next;
+    struct Symbol* next_name;   /* next in the same name hash bucket */
+    struct Symbol* next_value;  /* next label for the same address, older */
 } Symbol;
 
 extern const char *pexpr;
@@ -26,6 +27,21 @@ int remove_symbols_by_value(uint16_t value);
 #define E_RANGE -3
 
 int strexpr(char *src, int *result);
+
+/*
+An expression compiled to postfix code, for breakpoint conditions which
+are evaluated on every hit.  Labels are resolved once when it's compiled,
+but registers, flags and dereferenced memory are read each time it runs.
+*/
+#define CODE_MAX 32
+
+typedef struct Code {
+    uint8_t n;
+    unsigned char op[CODE_MAX];     /* '#' literal, 'r' register or flag id, or an operator */
+    int arg[CODE_MAX];
+} Code;
+
+int eval_code(const Code *code, int *result);
 int symlen(const char *s);
 
 int parse_start(char *src);
@@ -36,6 +52,7 @@ int parse_int(int *v, int dflt);
 int parse_byte(uint8_t *v, int dflt);
 int parse_addr(uint16_t *v, int dflt);
 int parse_range(uint16_t* start, uint16_t* end, int dflt_start, int dflt_length);
+int parse_code(Code *code);
 
 char* parsed_str();
 int parsed_length();
@@ -0,0 +1,204 @@
+#!/usr/bin/env python3
+"""Pick words to flag always-native (AN) from a c65 execution heatmap.
+
+Tali natively compiles (inlines) a word when it is no longer than NC-LIMIT,
+so bigger words are always reached by JSR, paying 12 cycles for the JSR/RTS
+pair on every call.  For an application that spends its time in a few such
+words, flagging them AN trades a few bytes per call site for those cycles.
+
+Run the application under c65 with the labelmap, then save the execution
+heatmap from the monitor, e.g.:
+
+    make taliforth-mattbrew.bin   # or whichever platform, for its labelmap
+    tools/c65/c65 -r taliforth-c65.bin -l platform/c65/c65-labelmap.txt
+    ... run the application, break into the monitor with ^C ...
+    heatmap save app.heat 0..0 x
+
+The heatmap holds a 64-bit execution count per address (from the start of
+the saved range, see --base), so the count at xt_foo is the number of times
+FOO was entered.  That includes calls from Tali's own assembled words, which
+an AN flag doesn't change, so treat the result as a starting point.
+
+A candidate must have a header that isn't NN, IM or already AN, must be longer
+than NC-LIMIT (else it is inlined anyway), no longer than --max-size, and
+its source between xt_foo and z_foo must be safe to copy: no RTS before the
+end, no JMP other than to error handling, and no absolute reference to a
+label of its own.
+
+The output is a block for the platform file, e.g. platform/mattbrew/platform.asm:
+
+    python3 tools/native_profile.py platform/c65/c65-labelmap.txt app.heat
+"""
+
+import argparse
+import re
+import struct
+import sys
+from glob import glob
+from os.path import dirname, join
+
+# Header flags from definitions.asm
+IM = 16
+AN = 32
+NN = 64
+FLAGS = {'FP': 1, 'LC': 2, 'DC': 4, 'CO': 8, 'IM': IM, 'AN': AN, 'NN': NN,
+         'ST': AN+NN, 'HC': 128}
+
+# Cycles a JSR/RTS pair costs, which inlining saves
+CALL_CYCLES = 12
+
+# Jumps that stay fine when inlined: they never come back
+ERROR_TARGETS = re.compile(r'^(error|underflow)')
+
+BRANCHES = {'bcc', 'bcs', 'beq', 'bne', 'bmi', 'bpl', 'bvc', 'bvs', 'bra',
+            'bbr0', 'bbr1', 'bbr2', 'bbr3', 'bbr4', 'bbr5', 'bbr6', 'bbr7',
+            'bbs0', 'bbs1', 'bbs2', 'bbs3', 'bbs4', 'bbs5', 'bbs6', 'bbs7'}
+
+HEADER = re.compile(r"""^#nt_header\s+(\w+)(?:\s*,\s*(?:"([^"]*)"|'([^']*)'))?(?:\s*,\s*([\w+ ]+))?""")
+LABEL = re.compile(r'^([\w]+):')
+
+
+def read_labels(fname):
+    """Map label to address from a vice labelmap ('al C:fc00 .label')"""
+    labels = {}
+    for line in open(fname):
+        parts = line.split()
+        if len(parts) < 3:
+            continue
+        labels[parts[2].lstrip('.')] = int(parts[1].split(':')[-1], 16)
+    return labels
+
+
+def read_heat(fname, base):
+    """Execution count per address from a c65 'heatmap save'"""
+    raw = open(fname, 'rb').read()
+    counts = struct.unpack(f'<{len(raw) // 8}Q', raw[:len(raw) // 8 * 8])
+    return lambda addr: counts[addr - base] if 0 <= addr - base < len(counts) else 0
+
+
+def read_headers(sources):
+    """Map label to (forth name, flags) for each #nt_header"""
+    headers = {}
+    for src in sources:
+        for line in open(src):
+            m = HEADER.match(line.strip())
+            if not m:
+                continue
+            label, dq, sq, flags = m.groups()
+            name = dq if dq is not None else sq
+            bits = sum(FLAGS.get(f.strip(), 0) for f in (flags or '').split('+'))
+            headers[label] = (name if name is not None else label, bits)
+    return headers
+
+
+def read_bodies(sources):
+    """Map label to the source lines from xt_label: up to z_label:"""
+    bodies = {}
+    for src in sources:
+        lines = [l.split(';')[0].rstrip() for l in open(src)]
+        starts = {}
+        for i, line in enumerate(lines):
+            m = LABEL.match(line)
+            if not m:
+                continue
+            label = m.group(1)
+            if label.startswith('xt_'):
+                starts[label[3:]] = i
+            elif label.startswith('z_') and label[2:] in starts:
+                bodies[label[2:]] = lines[starts[label[2:]]:i+1]
+    return bodies
+
+
+def quote(name):
+    """A 64tass string for name"""
+    return f"'{name}'" if '"' in name else f'"{name}"'
+
+
+def unsafe(body):
+    """Why this word's code can't be copied inline, or None"""
+    own = set()
+    for line in body:
+        m = LABEL.match(line)
+        if m:
+            own.add(m.group(1))
+    for line in body[:-1]:
+        code = LABEL.sub('', line).split()
+        if not code:
+            continue
+        op = code[0].lower()
+        arg = ' '.join(code[1:])
+        if op == 'rts':
+            return 'returns early'
+        if op == 'jmp' and not ERROR_TARGETS.match(arg):
+            return f'jumps to {arg}'
+        if op not in BRANCHES and any(re.search(rf'\b{l}\b', arg) for l in own):
+            return f'refers to its own code ({op} {arg})'
+    return None
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    parser.add_argument('labelmap', help='labelmap from the build, e.g. platform/c65/c65-labelmap.txt')
+    parser.add_argument('heatmap', help="file from c65's 'heatmap save <file> [range] x'")
+    parser.add_argument('--base', type=lambda s: int(s, 0), default=0,
+                        help='start address of the saved heatmap range (default 0)')
+    parser.add_argument('--nc-limit', type=int, default=20,
+                        help='NC-LIMIT the application compiles with (default 20)')
+    parser.add_argument('--max-size', type=int, default=64,
+                        help='longest word to flag always-native (default 64)')
+    parser.add_argument('--count', type=int, default=16,
+                        help='most words to flag (default 16)')
+    parser.add_argument('--min-share', type=float, default=0.5,
+                        help='ignore words with less than this percent of all calls (default 0.5)')
+    args = parser.parse_args()
+
+    labels = read_labels(args.labelmap)
+    heat = read_heat(args.heatmap, args.base)
+
+    # We assume this file lives in the tools folder
+    root = join(dirname(__file__), '..')
+    sources = glob(join(root, 'words', '*.asm')) \
+        + glob(join(dirname(args.labelmap), '**', '*.asm'), recursive=True)
+    headers = read_headers(sources)
+    bodies = read_bodies(sources)
+
+    calls = {}
+    for label, (name, flags) in headers.items():
+        if f'xt_{label}' in labels and f'z_{label}' in labels:
+            calls[label] = heat(labels[f'xt_{label}'])
+    total = sum(calls.values())
+    if not total:
+        print(f"No calls to any word in {args.heatmap}, is --base right?", file=sys.stderr)
+        sys.exit(1)
+
+    picked = []
+    for label, n in sorted(calls.items(), key=lambda kv: -kv[1]):
+        name, flags = headers[label]
+        size = labels[f'z_{label}'] - labels[f'xt_{label}']
+        if len(picked) == args.count or 100 * n / total < args.min_share:
+            break
+        if flags & (AN+NN):
+            why = 'flagged ' + {AN: 'AN', NN: 'NN', AN+NN: 'ST'}[flags & (AN+NN)]
+        elif flags & IM:
+            why = 'immediate'
+        elif size <= args.nc_limit:
+            why = 'inlined by nc-limit already'
+        elif size > args.max_size:
+            why = f'longer than {args.max_size} bytes'
+        elif label not in bodies:
+            why = 'source not found'
+        else:
+            why = unsafe(bodies[label])
+        print(f'{name:>16} {n:>12} calls {100*n/total:5.1f}% {size:>4} bytes  '
+              + (why or 'always-native'), file=sys.stderr)
+        if not why:
+            picked.append((name, n, size))
+
+    cycles = sum(n for _, n, _ in picked) * CALL_CYCLES
+    print(f'; From tools/native_profile.py {args.heatmap}: saves about {cycles} cycles')
+    print('TALI_OPTION_ALWAYS_NATIVE := [ ' + ', '.join(quote(name) for name, _, _ in picked) + ' ]')
+    print(f'TALI_OPTION_NC_LIMIT := {args.nc_limit}')
+
+
+if __name__ == '__main__':
+    main()
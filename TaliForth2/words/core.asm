@@ -6500,7 +6500,9 @@ z_two_to_r:     jmp (tmp1)
 ; ## TYPE ( addr u -- ) "Print string"
 ; ## "type"  auto  ANS core
         ; """https://forth-standard.org/standard/core/TYPE
-        ; Works through EMIT to allow OUTPUT revectoring.
+        ; Works through EMIT to allow OUTPUT revectoring. If the platform
+        ; has a kernel_type and OUTPUT is still kernel_putc, the string goes
+        ; to kernel_type instead, up to 255 characters at a time.
         ; """
 
 xt_type:
@@ -6512,6 +6514,44 @@ w_type:
                 lda 3,x
                 sta tmp1+1
 
+.if kernel_type != 0
+                lda output
+                cmp #<kernel_putc
+                bne _by_char
+                lda output+1
+                cmp #>kernel_putc
+                bne _by_char
+_chunk:
+                lda 1,x
+                beq +
+                lda #$ff        ; 256 or more left: send 255
+                bra _send
++
+                lda 0,x
+                beq _cleanup
+_send:
+                pha
+                jsr kernel_type ; A characters from (tmp1)
+                pla
+
+                ; Step past them: tmp1 += A, u -= A
+                pha
+                clc
+                adc tmp1
+                sta tmp1
+                bcc +
+                inc tmp1+1
++
+                pla
+                eor #$ff        ; u + ~A + 1 = u - A
+                sec
+                adc 0,x
+                sta 0,x
+                bcs _chunk
+                dec 1,x
+                bra _chunk
+_by_char:
+.endif
                 ldy #0          ; initialize offset
 
                 lda 0,x
@@ -140,8 +140,10 @@ _nt:                    ; remember start of header to update prev_nt pointer
     _sz := z_\label - xt_\label
     _lc := _sz > 255 ? LC : 0
     _dc := _nt_end != xt_\label ? DC : 0
+    ; platforms can flag more words AN, but never ones that must be called
+    _an := _s in TALI_OPTION_ALWAYS_NATIVE && ((\flags) & (NN|IM)) == 0 ? AN : 0
 
-    .byte \flags | _fp | _lc | _dc       ; status flags byte
+    .byte \flags | _fp | _lc | _dc | _an ; status flags byte
     .byte len(_s)       ; length of word string, max 31
 .if _fp
     .word prev_nt       ; previous Dictionary header, 0000 signals start
@@ -1,37 +1,416 @@
 use std::{env, fs, process};
 
-fn main() {
-    let args: Vec<String> = env::args().collect();
-    if args.len() != 3 {
-        eprintln!("Usage: {} <input> <output>", args[0]);
-        process::exit(1);
+/// Section flag (format version 2): data is LZ4-style compressed.
+const SECTION_COMPRESSED: u8 = 0x01;
+/// Section flag (format version 3): a relocation bitmap follows the data.
+const SECTION_RELOCATABLE: u8 = 0x02;
+/// Section flag (format version 4): no data, the loader clears `len` bytes.
+const SECTION_ZERO: u8 = 0x04;
+
+const MIN_MATCH: usize = 4;
+const MAX_OFFSET: usize = 0xFFFF;
+const HASH_BITS: u32 = 12;
+
+/// Append an LZ4 extended length (the part of `n` that didn't fit in the
+/// token nibble).
+fn push_len(out: &mut Vec<u8>, mut n: usize) {
+    while n >= 255 {
+        out.push(255);
+        n -= 255;
+    }
+    out.push(n as u8);
+}
+
+/// Emit one sequence: `literals`, then (if present) an `(offset, len)` match
+/// copying `len` bytes from `offset` bytes back.
+fn push_sequence(out: &mut Vec<u8>, literals: &[u8], m: Option<(usize, usize)>) {
+    let lit_nib = literals.len().min(15) as u8;
+    let match_nib = m.map_or(0, |(_, len)| (len - MIN_MATCH).min(15) as u8);
+    out.push((lit_nib << 4) | match_nib);
+    if literals.len() >= 15 {
+        push_len(out, literals.len() - 15);
+    }
+    out.extend_from_slice(literals);
+    if let Some((offset, len)) = m {
+        out.extend_from_slice(&(offset as u16).to_le_bytes());
+        if len - MIN_MATCH >= 15 {
+            push_len(out, len - MIN_MATCH - 15);
+        }
+    }
+}
+
+/// Compress `data` into LZ4 block-style sequences (greedy, one hash slot per
+/// 4-byte prefix). The decoder stops once it has produced `data.len()`
+/// bytes, so the stream simply ends with a literals-only sequence (or with
+/// a match that reaches the end).
+fn compress(data: &[u8]) -> Vec<u8> {
+    let mut out = Vec::new();
+    let mut table = vec![usize::MAX; 1 << HASH_BITS];
+    let hash = |p: usize| {
+        let v = u32::from_le_bytes([data[p], data[p + 1], data[p + 2], data[p + 3]]);
+        (v.wrapping_mul(2654435761) >> (32 - HASH_BITS)) as usize
+    };
+
+    let mut anchor = 0;
+    let mut pos = 0;
+    while pos + MIN_MATCH <= data.len() {
+        let h = hash(pos);
+        let cand = table[h];
+        table[h] = pos;
+        if cand != usize::MAX
+            && pos - cand <= MAX_OFFSET
+            && data[cand..cand + MIN_MATCH] == data[pos..pos + MIN_MATCH]
+        {
+            let mut len = MIN_MATCH;
+            while pos + len < data.len() && data[cand + len] == data[pos + len] {
+                len += 1;
+            }
+            push_sequence(&mut out, &data[anchor..pos], Some((pos - cand, len)));
+            pos += len;
+            anchor = pos;
+        } else {
+            pos += 1;
+        }
+    }
+    if anchor < data.len() {
+        push_sequence(&mut out, &data[anchor..], None);
+    }
+    out
+}
+
+/// Build a relocation bitmap from two links of the same program, `data` at
+/// the load address and `moved` one page higher: the bytes that differ are
+/// the high bytes of addresses, and must differ by exactly one.
+fn reloc_bitmap(data: &[u8], moved: &[u8]) -> Result<Vec<u8>, String> {
+    if data.len() != moved.len() {
+        return Err(format!(
+            "links differ in size ({} and {} bytes)",
+            data.len(),
+            moved.len()
+        ));
+    }
+    let mut bitmap = vec![0u8; data.len().div_ceil(8)];
+    for (i, (&a, &b)) in data.iter().zip(moved).enumerate() {
+        if a == b {
+            continue;
+        }
+        if b != a.wrapping_add(1) {
+            return Err(format!(
+                "byte at offset {i:#06x} is {a:#04x} and {b:#04x}, not an address high byte"
+            ));
+        }
+        bitmap[i / 8] |= 1 << (i % 8);
+    }
+    Ok(bitmap)
+}
+
+/// One output section: `data` to load at `addr` in `bank`, or for a
+/// zero-fill section, `len` bytes to clear there.
+struct Section {
+    addr: u16,
+    bank: u8,
+    len: usize,
+    data: Vec<u8>,
+    zero: bool,
+    /// Relocation bitmap of a relocatable section (empty for zero-fill).
+    bitmap: Option<Vec<u8>>,
+}
+
+impl Section {
+    fn data(addr: u16, bank: u8, data: Vec<u8>) -> Self {
+        Self { addr, bank, len: data.len(), data, zero: false, bitmap: None }
+    }
+
+    fn zero(addr: u16, bank: u8, len: usize) -> Self {
+        Self { addr, bank, len, data: Vec::new(), zero: true, bitmap: None }
     }
+}
+
+/// A PT_LOAD program header: where its bytes load, and how many of them
+/// the file holds (the rest of `memsz` is zero-fill).
+struct Segment {
+    paddr: u32,
+    data: Vec<u8>,
+    memsz: u32,
+}
 
-    let data = fs::read(&args[1]).unwrap_or_else(|e| {
-        eprintln!("Error reading {}: {}", args[1], e);
+struct Elf {
+    entry: u32,
+    segments: Vec<Segment>,
+}
+
+const ELF_MAGIC: &[u8; 4] = b"\x7fELF";
+const PT_LOAD: u32 = 1;
+
+/// Read the loadable segments of a 32-bit little-endian ELF executable,
+/// as llvm-mos links them.
+fn parse_elf(bytes: &[u8]) -> Result<Elf, String> {
+    let u16_at = |pos: usize| -> Result<u32, String> {
+        bytes
+            .get(pos..pos + 2)
+            .map(|b| u16::from_le_bytes([b[0], b[1]]) as u32)
+            .ok_or_else(|| "truncated ELF header".to_string())
+    };
+    let u32_at = |pos: usize| -> Result<u32, String> {
+        bytes
+            .get(pos..pos + 4)
+            .map(|b| u32::from_le_bytes([b[0], b[1], b[2], b[3]]))
+            .ok_or_else(|| "truncated ELF header".to_string())
+    };
+    if bytes.len() < 52 || &bytes[..4] != ELF_MAGIC || bytes[4] != 1 || bytes[5] != 1 {
+        return Err("not a 32-bit little-endian ELF file".to_string());
+    }
+    let entry = u32_at(24)?;
+    let phoff = u32_at(28)? as usize;
+    let phentsize = u16_at(42)? as usize;
+    let phnum = u16_at(44)? as usize;
+
+    let mut segments = Vec::new();
+    for i in 0..phnum {
+        let ph = phoff + i * phentsize;
+        if u32_at(ph)? != PT_LOAD {
+            continue;
+        }
+        let offset = u32_at(ph + 4)? as usize;
+        let paddr = u32_at(ph + 12)?;
+        let filesz = u32_at(ph + 16)? as usize;
+        let memsz = u32_at(ph + 20)?;
+        if memsz == 0 {
+            continue;
+        }
+        let data = bytes
+            .get(offset..offset + filesz)
+            .ok_or_else(|| format!("segment {i}: data past the end of the file"))?;
+        segments.push(Segment { paddr, data: data.to_vec(), memsz });
+    }
+    Ok(Elf { entry, segments })
+}
+
+/// Split a linked address into its CPU address and bank. Addresses above
+/// 64K are banked, as overlay.ld links them: 0x(B+1)A000 is $A000 in bank
+/// B. The rest are in main RAM (bank 0xFF).
+fn place(addr: u32, len: usize) -> Result<(u16, u8), String> {
+    match addr >> 16 {
+        0 if addr as usize + len <= 0x10000 => Ok((addr as u16, 0xFF)),
+        0 => Err(format!("{addr:#06x}+{len} runs past 64K")),
+        b if b <= 32 => {
+            let cpu = addr & 0xFFFF;
+            if cpu < 0xA000 || cpu as usize + len > 0xE000 {
+                return Err(format!("{addr:#x}+{len} is outside the bank window"));
+            }
+            Ok((cpu as u16, (b - 1) as u8))
+        }
+        _ => Err(format!("{addr:#x} is beyond the last bank")),
+    }
+}
+
+/// Runs of zeros at least this long in a segment's data go out as zero-fill
+/// sections: they cost a 6-byte section header instead.
+const MIN_ZERO_RUN: usize = 32;
+
+/// Split `data` at `addr` into data sections and zero-fill sections for
+/// its long runs of zeros.
+fn split_zero_runs(addr: u16, bank: u8, data: &[u8], out: &mut Vec<Section>) {
+    let mut start = 0;
+    let mut pos = 0;
+    while pos < data.len() {
+        if data[pos] != 0 {
+            pos += 1;
+            continue;
+        }
+        let run = data[pos..].iter().take_while(|&&b| b == 0).count();
+        if run >= MIN_ZERO_RUN {
+            if start < pos {
+                out.push(Section::data(addr + start as u16, bank, data[start..pos].to_vec()));
+            }
+            out.push(Section::zero(addr + pos as u16, bank, run));
+            start = pos + run;
+        }
+        pos += run;
+    }
+    if start < data.len() {
+        out.push(Section::data(addr + start as u16, bank, data[start..].to_vec()));
+    }
+}
+
+/// Sections for every PT_LOAD of `elf`: its file bytes as data (long zero
+/// runs as zero-fill, unless relocatable), and the rest of its memory
+/// size, the .bss, as zero-fill. With `moved`, the same program linked a
+/// page higher, every section is relocatable. Zero-fill below $0400 (the
+/// zero page and stack) is left to crt0, which clears it anyway.
+fn elf_sections(elf: &Elf, moved: Option<&Elf>) -> Result<Vec<Section>, String> {
+    if let Some(moved) = moved {
+        if moved.segments.len() != elf.segments.len() {
+            return Err("links differ in their segments".to_string());
+        }
+    }
+    let mut sections = Vec::new();
+    for (i, seg) in elf.segments.iter().enumerate() {
+        let (addr, bank) = place(seg.paddr, seg.memsz as usize).map_err(|e| format!("segment {i}: {e}"))?;
+        let zero_len = seg.memsz as usize - seg.data.len().min(seg.memsz as usize);
+        if addr < 0x0400 {
+            if !seg.data.is_empty() {
+                return Err(format!("segment {i}: data at {addr:#06x}, below 0x0400"));
+            }
+            eprintln!("Skipping {zero_len} zero bytes at {addr:#06x} (crt0 clears them)");
+            continue;
+        }
+        if let Some(moved) = moved {
+            if !seg.data.is_empty() {
+                let bitmap = reloc_bitmap(&seg.data, &moved.segments[i].data)
+                    .map_err(|e| format!("segment {i}: {e}"))?;
+                let mut section = Section::data(addr, bank, seg.data.clone());
+                section.bitmap = Some(bitmap);
+                sections.push(section);
+            }
+        } else {
+            split_zero_runs(addr, bank, &seg.data, &mut sections);
+        }
+        if zero_len > 0 {
+            let mut section = Section::zero(addr + seg.data.len() as u16, bank, zero_len);
+            section.bitmap = moved.map(|_| Vec::new());
+            sections.push(section);
+        }
+    }
+    Ok(sections)
+}
+
+fn read_file(name: &str) -> Vec<u8> {
+    fs::read(name).unwrap_or_else(|e| {
+        eprintln!("Error reading {}: {}", name, e);
         process::exit(1);
-    });
+    })
+}
+
+fn fail(msg: String) -> ! {
+    eprintln!("Error: {msg}");
+    process::exit(1);
+}
 
-    if data.len() > 0xFFFF {
-        eprintln!("Error: file is {} bytes, max is 65535", data.len());
+/// Write the executable (see binary_format.md), in the lowest format
+/// version that has every feature it uses.
+fn pack(entry: u16, sections: &[Section], compressed: bool) -> Vec<u8> {
+    let version = if sections.iter().any(|s| s.zero) {
+        0x04
+    } else if sections.iter().any(|s| s.bitmap.is_some()) {
+        0x03
+    } else if compressed {
+        0x02
+    } else {
+        0x01
+    };
+    if sections.len() > 255 {
+        fail(format!("{} sections, max is 255", sections.len()));
+    }
+
+    let mut out = vec![0x45u8, 0x69, version];
+    out.extend_from_slice(&entry.to_le_bytes());
+    out.push(sections.len() as u8);
+    let (mut raw, mut packed, mut zeros) = (0, 0, 0);
+    for s in sections {
+        if s.len > 0xFFFF {
+            fail(format!("section at {:#06x} is {} bytes, max is 65535", s.addr, s.len));
+        }
+        out.extend_from_slice(&s.addr.to_le_bytes());
+        out.push(s.bank);
+        out.extend_from_slice(&(s.len as u16).to_le_bytes());
+        let compress_this = compressed && !s.zero;
+        if version >= 2 {
+            let mut flags = 0;
+            if compress_this {
+                flags |= SECTION_COMPRESSED;
+            }
+            if s.bitmap.is_some() {
+                flags |= SECTION_RELOCATABLE;
+            }
+            if s.zero {
+                flags |= SECTION_ZERO;
+            }
+            out.push(flags);
+        }
+        if s.zero {
+            zeros += s.len;
+        } else if compress_this {
+            let stream = compress(&s.data);
+            if stream.len() > 0xFFFF {
+                fail(format!("compressed section is {} bytes, max is 65535", stream.len()));
+            }
+            out.extend_from_slice(&(stream.len() as u16).to_le_bytes());
+            out.extend_from_slice(&stream);
+            raw += s.len;
+            packed += stream.len();
+        } else {
+            out.extend_from_slice(&s.data);
+        }
+        if let Some(bitmap) = s.bitmap.as_ref().filter(|_| !s.zero) {
+            out.extend_from_slice(bitmap);
+            eprintln!(
+                "Relocatable: {} high bytes, {} byte bitmap",
+                bitmap.iter().map(|b| b.count_ones()).sum::<u32>(),
+                bitmap.len()
+            );
+        }
+    }
+    if compressed {
+        eprintln!("Compressed {raw} -> {packed} bytes");
+    }
+    if zeros > 0 {
+        eprintln!("{} sections, {zeros} zero bytes left to the loader", sections.len());
+    }
+    out
+}
+
+fn main() {
+    let mut args: Vec<String> = env::args().collect();
+    let mut compressed = false;
+    let mut moved_name = None;
+    while args.len() > 1 && args[1].starts_with('-') {
+        match args[1].as_str() {
+            "-c" => compressed = true,
+            "-r" if args.len() > 2 => moved_name = Some(args.remove(2)),
+            _ => break,
+        }
+        args.remove(1);
+    }
+    if args.len() != 3 {
+        eprintln!("Usage: {} [-c] [-r <input+0x100>] <input> <output>", args[0]);
+        eprintln!("  <input> is a flat binary linked at 0x0400, or an ELF executable:");
+        eprintln!("      a section per segment, banked above 64K, with .bss and long");
+        eprintln!("      runs of zeros left for the loader to clear (format version 4)");
+        eprintln!("  -c  compress the sections (format version 2)");
+        eprintln!("  -r  make the sections relocatable (format version 3), given the");
+        eprintln!("      program also linked one page higher");
         process::exit(1);
     }
 
-    let len = data.len() as u16;
-    let mut out = vec![
-        // Magic
-        0x45u8, 0x69, 0x01,
-        // Entrypoint
-        0x00, 0x04,
-        // Section count
-        0x01,
-        // Section address
-        0x00, 0x04,
-        // Ram bank
-        0xff];
-    out.extend_from_slice(&len.to_le_bytes());
-    out.extend_from_slice(&data);
+    let data = read_file(&args[1]);
+    let moved = moved_name.map(|name| read_file(&name));
+
+    let (entry, sections) = if data.starts_with(ELF_MAGIC) {
+        let elf = parse_elf(&data).unwrap_or_else(|e| fail(format!("{}: {e}", args[1])));
+        let moved_elf = moved.as_ref().map(|m| {
+            parse_elf(m).unwrap_or_else(|e| fail(format!("moved link: {e}")))
+        });
+        let sections = elf_sections(&elf, moved_elf.as_ref())
+            .unwrap_or_else(|e| fail(format!("cannot pack {}: {e}", args[1])));
+        if elf.entry > 0xFFFF {
+            fail(format!("entry point {:#x} is banked", elf.entry));
+        }
+        (elf.entry as u16, sections)
+    } else {
+        if data.len() > 0xFFFF {
+            fail(format!("file is {} bytes, max is 65535", data.len()));
+        }
+        let bitmap = moved.map(|moved| {
+            reloc_bitmap(&data, &moved)
+                .unwrap_or_else(|e| fail(format!("cannot relocate {}: {e}", args[1])))
+        });
+        let mut section = Section::data(0x0400, 0xFF, data);
+        section.bitmap = bitmap;
+        (0x0400, vec![section])
+    };
 
+    let out = pack(entry, &sections, compressed);
     fs::write(&args[2], &out).unwrap_or_else(|e| {
         eprintln!("Error writing {}: {}", args[2], e);
         process::exit(1);
@@ -1,7 +1,10 @@
 #include <cstdint>
 
+#include <keywords.h>
 #include <mattbrew.h>
 
+#define IO_PORT (*(volatile uint8_t*)RPI_BASE)
+
 // ===================
 // Utility functions
 // ===================
@@ -43,17 +46,6 @@ bool parse_hex(const char* str, uint16_t* out) {
     return true;
 }
 
-bool starts_with(const char* str, const char* prefix) {
-    while (*prefix != 0) {
-        if (*str != *prefix) {
-            return false;
-        }
-        str++;
-        prefix++;
-    }
-    return true;
-}
-
 // ===================
 // LCD
 // ===================
@@ -132,41 +124,228 @@ void term_getline(char* line_buf) {
     line_buf[total_len - 1] = 0;
 }
 
-// Checks that |buf| has at least |minimum| bytes remaining starting from |*idx|. If not,
-// copies remaining data between |*idx| and |*len| to the start of |buf|, updates |*len| and |*idx| accordingly,
-// and pulls another chunk of data from device 3.
-bool check_len(uint8_t minimum, uint8_t* buf, uint8_t* idx, uint8_t* len) {
-    if (*idx + minimum < *len) {
-        return true;
+void select_bank(uint8_t bank) {
+    if (bank != 0xFF) {
+        (*(volatile uint8_t*)BANK_SEL) = bank;
     }
+}
+
+// Terminal lines (see term_getline) and the device 0 status.
+static uint8_t buf[128];
+
+// ===================
+// Netboot (device 3)
+// ===================
 
-    // Move remaining data to start of buffer
-    uint8_t remaining = *len - *idx;
-    for (uint8_t i = 0; i < remaining; i++) {
-        buf[i] = buf[*idx + i];
+// Bytes left in the current netboot chunk, which is read straight off the bus.
+static uint8_t netboot_left;
+
+// Issue a device 3 read, waiting until a chunk is available.
+void netboot_begin() {
+    do {
+        IO_PORT = 3 | 0x80;
+        while ((netboot_left = IO_PORT) == 0xFF);
+    } while (netboot_left == 0);
+}
+
+// Next byte of the image, moving on to the next chunk as needed.
+uint8_t netboot_byte() {
+    if (netboot_left == 0) {
+        netboot_begin();
     }
-    *len = remaining;
-    *idx = 0;
+    netboot_left--;
+    return IO_PORT;
+}
 
-    *len += io_read(3, buf + remaining);
-    return *len >= minimum;
+// Finish reading the current chunk, so the bus is free for other devices.
+void netboot_drain() {
+    for (; netboot_left > 0; netboot_left--) {
+        IO_PORT;
+    }
 }
 
-uint8_t blocking_read(uint8_t* buf) {
+// ===================
+// Block load (device 5)
+// ===================
+
+// Block kinds (4th header byte)
+#define BLOCK_RAW           0   // Data goes straight to addr
+#define BLOCK_PACKED_START  1   // Starts a compressed stream decompressing to addr
+#define BLOCK_PACKED_MORE   2   // Continues the current compressed stream
+#define BLOCK_RELOC         3   // [delta][bitmap...] of the bytes from addr to relocate
+#define BLOCK_ZERO          4   // [len_lo][len_hi] bytes from addr to clear
+
+// Issue a device 5 read and consume the [addr_lo][addr_hi][bank][kind]
+// header, waiting until a block is available. Returns the data length.
+uint8_t block_begin(uint16_t* addr, uint8_t* bank, uint8_t* kind) {
     uint8_t len;
     do {
-        len = io_read(3, buf);
+        IO_PORT = 5 | 0x80;
+        while ((len = IO_PORT) == 0xFF);
     } while (len == 0);
-    return len;
+
+    *addr = IO_PORT;
+    *addr |= IO_PORT << 8;
+    *bank = IO_PORT;
+    *kind = IO_PORT;
+    return len - 4;
+}
+
+// Data bytes left in the current compressed block.
+static uint8_t packed_left;
+
+// Next byte of the compressed stream, moving on to the next block as needed.
+uint8_t packed_byte() {
+    while (packed_left == 0) {
+        uint16_t addr;
+        uint8_t bank, kind;
+        packed_left = block_begin(&addr, &bank, &kind);
+    }
+    packed_left--;
+    return IO_PORT;
+}
+
+// LZ4 length: |n| from the token nibble, extended by bytes while they're 255.
+uint16_t packed_len(uint16_t n) {
+    if (n == 15) {
+        uint8_t b;
+        do {
+            b = packed_byte();
+            n += b;
+        } while (b == 255);
+    }
+    return n;
 }
 
-// The netboot device on 3 returns data in chunks of up to 128 bytes, plus we need
-// a little margin to store a previous header's worth of data.
-static uint8_t buf[128 + 6];
+// Decompress |len| bytes to |dst| as the stream arrives (see binary_format.md).
+void unpack(uint8_t* dst, uint16_t len) {
+    uint8_t* end = dst + len;
+    while (dst != end) {
+        uint8_t token = packed_byte();
+        for (uint16_t n = packed_len(token >> 4); n > 0; n--) {
+            *dst++ = packed_byte();
+        }
+        if (dst == end) {
+            break;
+        }
+        uint16_t offset = packed_byte();
+        offset |= packed_byte() << 8;
+        const uint8_t* src = dst - offset;
+        for (uint16_t n = packed_len(token & 0x0F) + 4; n > 0; n--) {
+            *dst++ = *src++;
+        }
+    }
+}
+
+// Add |delta| to each byte from |dst| on whose bit is set in the next |len|
+// bitmap bytes off the bus, low bit first: the high bytes of the addresses
+// in a section moved by |delta| pages.
+void relocate(uint8_t* dst, uint8_t delta, uint8_t len) {
+    for (; len > 0; len--) {
+        uint8_t bits = IO_PORT;
+        for (uint8_t i = 0; i < 8; i++, dst++) {
+            if (bits & 1) {
+                *dst += delta;
+            }
+            bits >>= 1;
+        }
+    }
+}
+
+// Load a program from device 5 (block load) into RAM. The Zero parses the
+// executable and sends [addr_lo][addr_hi][bank][kind][data...] blocks; raw
+// data is read off the bus straight to its destination, and compressed
+// sections are decompressed there as they stream in, and zero-fill ones
+// cleared, so there is no intermediate buffer or header parsing here. A block without data ends
+// the load, its address being the entry point (0 on error).
+// With a page, the program's relocatable sections are placed from there,
+// and the Zero follows each with its relocation bitmap.
+// args is "<name> [page]" and must be <255 chars (guaranteed by
+// term_getline's uint8_t length).
+void cmd_load(char* args) {
+    uint8_t name_len = 0;
+    while (args[name_len] != 0 && args[name_len] != ' ') {
+        name_len++;
+    }
+    if (name_len == 0) {
+        term_putstr("Usage: load <name> [page]\n");
+        return;
+    }
 
-// Load a program from device 3 (netboot) into RAM.
+    uint8_t request_len = name_len;
+    if (args[name_len] == ' ') {
+        uint16_t page;
+        if (!parse_hex(args + name_len + 1, &page) || page > 0xFF) {
+            term_putstr("Usage: load <name> [page]\n");
+            return;
+        }
+        // The request is [name][0x00][page], built over the space and the
+        // (parsed) page digits.
+        args[name_len] = 0;
+        args[name_len + 1] = page;
+        request_len += 2;
+    }
+    io_write(5, (const uint8_t*)args, request_len);
+
+    uint16_t blocks = 0;
+    uint16_t addr;
+    uint8_t bank, kind;
+    while (true) {
+        uint8_t len = block_begin(&addr, &bank, &kind);
+        if (len == 0) {
+            break;
+        }
+
+        select_bank(bank);
+        if (kind == BLOCK_PACKED_START) {
+            // Stream starts with the uncompressed length
+            packed_left = len;
+            uint16_t unpacked_len = packed_byte();
+            unpacked_len |= packed_byte() << 8;
+            unpack((uint8_t*)addr, unpacked_len);
+            while (packed_left > 0) {
+                packed_byte();
+            }
+        } else if (kind == BLOCK_RELOC) {
+            uint8_t delta = IO_PORT;
+            relocate((uint8_t*)addr, delta, len - 1);
+        } else if (kind == BLOCK_ZERO) {
+            uint16_t zero_len = IO_PORT;
+            zero_len |= IO_PORT << 8;
+            uint8_t* dst = (uint8_t*)addr;
+            for (; zero_len > 0; zero_len--) {
+                *dst++ = 0;
+            }
+        } else {
+            uint8_t* dst = (uint8_t*)addr;
+            for (uint8_t i = 0; i < len; i++) {
+                dst[i] = IO_PORT;
+            }
+        }
+        blocks++;
+    }
+
+    if (addr == 0) {
+        term_putstr("load failed (see Zero log)\n");
+        return;
+    }
+
+    term_putstr("Loaded 0x");
+    term_puthex16(blocks);
+    term_putstr(" blocks, entrypoint=0x");
+    term_puthex16(addr);
+    term_putstr("\n");
+    ((void (*)(void))addr)();
+}
+
+// Load a program from device 3 (netboot) into RAM, parsing the executable
+// on the 6502. The Zero streams the whole image as the bridge has room for
+// it, and each chunk is read off the bus straight to where its bytes go,
+// section headers and all, so the next chunk arrives in the bridge while the
+// 6502 copies this one. Nothing else may use the bus until a chunk has been
+// read to its end, so errors drain it first.
 // name must be <255 chars (guaranteed by term_getline's uint8_t length).
-void cmd_load(const char* name) {
+void cmd_netload(const char* name) {
     uint8_t name_len = strlen(name);
     if (name_len == 0) {
         term_putstr("Usage: load <name>\n");
@@ -176,80 +355,101 @@ void cmd_load(const char* name) {
     // Send filename to device 3
     io_write(3, (const uint8_t*)name, (uint8_t)name_len);
 
-    // Buffer holds 1 full chunk (128 bytes) plus 5 bytes for header parsing.
-    uint8_t len = blocking_read(buf);
-    uint8_t idx = 0;
-
-    // For the header, we can get away with not using next_byte, since we know the 
-    // first chunk will contain the entire header.
-    if (len == 0) {
-        term_putstr("not found\n");
-        return;
-    }
-
-    if (len < 6) {
+    // The first chunk holds the entire header.
+    netboot_begin();
+    if (netboot_left < 6) {
+        netboot_drain();
         term_putstr("response too short\n");
         return;
     }
-    if (buf[idx] != 0x45 || buf[idx+1] != 0x69 || buf[idx+2] != 0x1) {
+    uint8_t magic0 = IO_PORT;
+    uint8_t magic1 = IO_PORT;
+    uint8_t magic2 = IO_PORT;
+    netboot_left -= 3;
+    if (magic0 != 0x45 || magic1 != 0x69 || magic2 != 0x1) {
+        netboot_drain();
         term_putstr("invalid binary magic\n");
         return;
     }
-    idx += 3;
-    uint16_t entrypoint = buf[idx++];
-    entrypoint |= buf[idx++] << 8;
-    uint8_t section_count = buf[idx++];
-    uint8_t current_section = 0;
-
-    while (current_section < section_count) {
-        check_len(5, buf, &idx, &len);
-        uint16_t section_addr = buf[idx++];
-        section_addr |= buf[idx++] << 8;
-        term_putstr("Loading section ");
-        term_puthex16(current_section);
-        term_putstr(" to 0x");
-        term_puthex16(section_addr);
-        term_putstr("\n");
+    uint16_t entrypoint = netboot_byte();
+    entrypoint |= netboot_byte() << 8;
+    uint8_t section_count = netboot_byte();
+
+    for (uint8_t current_section = 0; current_section < section_count; current_section++) {
+        uint16_t section_addr = netboot_byte();
+        section_addr |= netboot_byte() << 8;
+        uint8_t bank = netboot_byte();
+        uint16_t section_len = netboot_byte();
+        section_len |= netboot_byte() << 8;
         if (section_addr < 0x0400) {
+            netboot_drain();
             term_putstr("invalid section address ");
             term_puthex16(section_addr);
             term_putstr("\n");
             return;
         }
-        uint8_t bank = buf[idx++];
-        if (bank != 0xFF) {
-            (*(volatile uint8_t*)0xE040) = bank;
-        }
-        uint16_t section_len = buf[idx++];
-        section_len |= buf[idx++] << 8;
         if (section_addr + section_len > 0xdfff) {
+            netboot_drain();
             term_putstr("section 0x");
             term_puthex16(current_section);
             term_putstr(" out of bounds\n");
             return;
         }
-        uint8_t* section_data = (uint8_t*)section_addr;
-        
+        select_bank(bank);
+
+        // As much of the section as the chunk holds at a time, straight from
+        // the bus.
+        uint8_t* dst = (uint8_t*)section_addr;
         while (section_len > 0) {
-            if (idx < len) {
-                *section_data++ = buf[idx++];
-                section_len--;
-            } else {
-                // Buffer is empty, read another chunk
-                len = blocking_read(buf);
-                idx = 0;
+            if (netboot_left == 0) {
+                netboot_begin();
+            }
+            uint8_t n = netboot_left;
+            if (section_len < n) {
+                n = section_len;
             }
+            for (uint8_t i = 0; i < n; i++) {
+                dst[i] = IO_PORT;
+            }
+            netboot_left -= n;
+            dst += n;
+            section_len -= n;
         }
-
-        current_section++;
     }
+    netboot_drain();
 
-    term_putstr("Load complete, entrypoint=0x");
+    term_putstr("Loaded 0x");
+    term_puthex16(section_count);
+    term_putstr(" sections, entrypoint=0x");
     term_puthex16(entrypoint);
     term_putstr("\n");
     ((void (*)(void))entrypoint)();
 }
 
+// ===================
+// Prompt
+// ===================
+
+// In the order of command_names.
+enum Command : uint8_t { CMD_LCD, CMD_LOAD, CMD_NETLOAD, CMD_PEEK, CMD_POKE, CMD_JUMP };
+
+static constexpr const char* command_names[] = {"lcd", "load", "netload", "peek", "poke", "jump"};
+static constexpr KeywordTable commands(command_names);
+
+// The command that line starts with, or commands.None. Every command takes
+// arguments, so it must be followed by a space; args is set past it.
+uint8_t parse_command(char* line, char** args) {
+    uint8_t len = 0;
+    while (line[len] != ' ') {
+        if (line[len] == 0) {
+            return commands.None;
+        }
+        len++;
+    }
+    *args = line + len + 1;
+    return commands.lookup(line, len);
+}
+
 int main() {
     // lcd_init();
     // lcd_putstr("Waiting for Zero...");
@@ -270,15 +470,22 @@ int main() {
     while (true) {
         term_putstr("> ");
         term_getline((char*)buf);
-        if (starts_with((char*)buf, "lcd ")) {
+        char* args;
+        switch (parse_command((char*)buf, &args)) {
+        case CMD_LCD:
             term_putstr("LCD disabled\n");
             // lcd_reset();
-            // lcd_putstr((char*)buf + 4);
-        } else if (starts_with((char*)buf, "load ")) {
-            cmd_load((char*)buf + 5);
-        } else if (starts_with((char*)buf, "peek ")) {
+            // lcd_putstr(args);
+            break;
+        case CMD_LOAD:
+            cmd_load(args);
+            break;
+        case CMD_NETLOAD:
+            cmd_netload(args);
+            break;
+        case CMD_PEEK: {
             uint16_t address;
-            bool ok = parse_hex((char*)buf + 5, &address);
+            bool ok = parse_hex(args, &address);
             if (ok) {
                 uint8_t value = *(volatile uint8_t*)address;
                 term_puthex16(address);
@@ -287,11 +494,12 @@ int main() {
                 term_putstr("\n");
             } else {
                 term_putstr("Invalid address ");
-                term_putstr((char*)buf + 5);
+                term_putstr(args);
                 term_putstr("\n");
             }
-        } else if (starts_with((char*)buf, "poke ")) {
-            char* args = (char*)buf + 5;
+            break;
+        }
+        case CMD_POKE: {
             char* space = nullptr;
             for (char* p = args; *p != 0; p++) {
                 if (*p == ' ') {
@@ -319,9 +527,11 @@ int main() {
             } else {
                 term_putstr("Usage: poke <address> <value>\n");
             }
-        } else if (starts_with((char*)buf, "jump ")) {
+            break;
+        }
+        case CMD_JUMP: {
             uint16_t address;
-            bool ok = parse_hex((char*)buf + 5, &address);
+            bool ok = parse_hex(args, &address);
             if (ok) {
                 term_putstr("=> ");
                 term_puthex16(address);
@@ -329,10 +539,12 @@ int main() {
                 ((void (*)(void))address)();
             } else {
                 term_putstr("Invalid address ");
-                term_putstr((char*)buf + 5);
+                term_putstr(args);
                 term_putstr("\n");
             }
-        } else {
+            break;
+        }
+        default:
             term_putstr("Unknown command\n");
         }
     }
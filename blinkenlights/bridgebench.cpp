@@ -0,0 +1,217 @@
+#include <cstdint>
+#include <cstdio>
+
+#include <mattbrew.h>
+
+// Bridge throughput benchmark: for each length 1..255, a write of that many
+// bytes to the Echo device and the reads that bring them back, timed in 6502
+// cycles by VIA T1.  Printed to the bridge terminal per length:
+//
+//   write   cycles in io_write()
+//   read    cycles in the io_read() calls that returned data
+//   poll    cycles between sending a read request and its length byte
+//           arriving (each 0xFF polled is a wait for the Pico), and
+//   polls   the 0xFF bytes polled, per read
+//   rtt     io_write() start until io_read() has returned every byte
+//
+// each the best of REPEATS runs, then bytes/s totals and the latency of a
+// 1-byte round trip.  Build with -DBENCH_MHZ=2 or 4 to run at that clock,
+// and with -DBENCH_LOCAL_ECHO=1 to have the Pico echo instead of the Zero
+// (Device 1 ['E'], see protocol.md), leaving SPI and shein out of it.
+
+#ifndef BENCH_MHZ
+#define BENCH_MHZ 1
+#endif
+
+#ifndef BENCH_LOCAL_ECHO
+#define BENCH_LOCAL_ECHO 0
+#endif
+
+const uint8_t ECHO_DEVICE = 7;
+const uint8_t REPEATS = 4;
+
+#define IO_PORT (*(volatile uint8_t*)RPI_BASE)
+#define VIA_T1CL (*(volatile uint8_t*)(VIA_BASE + 0x04))
+#define VIA_T1CH (*(volatile uint8_t*)(VIA_BASE + 0x05))
+#define VIA_ACR (*(volatile uint8_t*)(VIA_BASE + 0x0b))
+
+// T1 free-running with a period of 65536 cycles, its wraps counted in
+// software as profile.c does.  Spans between readings stay far below that.
+static uint16_t last_count, wraps;
+
+void timer_start() {
+    VIA_ACR = (VIA_ACR & 0x3f) | 0x40;  // T1 continuous, PB7 unused.
+    VIA_T1CL = 0xfe;
+    VIA_T1CH = 0xff;                    // Loads the counter and starts it.
+}
+
+uint32_t cycles() {
+    // The low byte can borrow from the high between the two reads.
+    uint8_t hi, lo;
+    do {
+        hi = VIA_T1CH;
+        lo = VIA_T1CL;
+    } while (hi != VIA_T1CH);
+
+    const uint16_t now = ~(hi << 8 | lo);
+    if (now < last_count) ++wraps;
+    last_count = now;
+    return (uint32_t)wraps << 16 | now;
+}
+
+// The cost of a cycles() call, taken off every span.
+static uint16_t timer_cost;
+
+uint16_t span(uint32_t start, uint32_t end) {
+    uint32_t d = end - start;
+    return d > timer_cost ? d - timer_cost : 0;
+}
+
+struct Sample {
+    uint16_t write;
+    uint16_t read;
+    uint16_t poll;
+    uint16_t polls;
+    uint16_t rtt;
+};
+
+uint8_t send_buf[255];
+uint8_t recv_buf[255];
+
+void fill(uint8_t len) {
+    for (uint8_t i = 0; i < len; i++) {
+        send_buf[i] = len + i;
+    }
+}
+
+// io_write() then io_read() until all |len| bytes are back.  Returns false
+// if the echo differs.
+bool round_trip(uint8_t len, Sample* s) {
+    uint32_t start = cycles();
+    io_write(ECHO_DEVICE, send_buf, len);
+    uint32_t written = cycles();
+
+    uint16_t read = 0, got = 0;
+    while (got < len) {
+        uint32_t before = cycles();
+        uint8_t n = io_read(ECHO_DEVICE, recv_buf);
+        uint32_t after = cycles();
+        if (n == 0) continue;
+        read += span(before, after);
+        for (uint8_t i = 0; i < n; i++) {
+            if (got + i >= len || recv_buf[i] != send_buf[got + i]) return false;
+        }
+        got += n;
+    }
+    uint32_t end = cycles();
+
+    s->write = span(start, written);
+    s->read = read;
+    s->rtt = span(start, end);
+    return true;
+}
+
+// The read handshake alone: echo |len| bytes again and read them with a
+// probe that times the wait for each length byte.  Sets the mean per read.
+void handshake(uint8_t len, Sample* s) {
+    io_write(ECHO_DEVICE, send_buf, len);
+
+    uint32_t poll = 0, polls = 0;
+    uint16_t reads = 0, got = 0;
+    while (got < len) {
+        uint8_t n;
+        IO_PORT = ECHO_DEVICE | 0x80;
+        uint32_t start = cycles();
+        while ((n = IO_PORT) == 0xFF) polls++;
+        uint32_t end = cycles();
+        for (uint8_t i = 0; i < n; i++) {
+            (void)IO_PORT;
+        }
+        poll += span(start, end);
+        reads++;
+        got += n;
+    }
+    s->poll = poll / reads;
+    s->polls = polls / reads;
+}
+
+uint32_t per_second(uint32_t bytes, uint32_t cycles) {
+    // bytes * BENCH_MHZ * 10^6 / cycles, kept within 32 bits
+    return cycles ? bytes * (BENCH_MHZ * 15625ul) / cycles * 64 : 0;
+}
+
+void lcd_putstr(const char* msg) {
+    while (*msg != 0) {
+        lcd_putchar(*msg);
+        msg++;
+    }
+}
+
+int main() {
+    lcd_init();
+    lcd_instruction(LCD_I_CLEAR);
+    lcd_instruction(LCD_I_HOME);
+    lcd_putstr("Bridge bench");
+
+    if (BENCH_MHZ != 1 && !io_set_clock(BENCH_MHZ)) {
+        printf("bridgebench: %u MHz failed the loopback test\n", BENCH_MHZ);
+        return 1;
+    }
+    if (BENCH_LOCAL_ECHO) {
+        const uint8_t on[2] = {'E', 1 << ECHO_DEVICE};
+        io_write(1, on, sizeof(on));
+    }
+
+    // The systick ISR would land in the timed spans.
+    asm volatile("sei");
+    timer_start();
+    uint32_t t = cycles();
+    timer_cost = cycles() - t;
+
+    printf("bridge bench, device %u (%s echo), %u MHz, best of %u\n",
+           ECHO_DEVICE, BENCH_LOCAL_ECHO ? "Pico" : "Zero", BENCH_MHZ, REPEATS);
+    printf("len write  read  poll polls    rtt\n");
+
+    uint32_t bytes = 0, write_total = 0, read_total = 0, poll_total = 0;
+    uint16_t latency = 0;
+    for (uint16_t len = 1; len <= 255; len++) {
+        fill(len);
+        Sample best = {0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF};
+        for (uint8_t r = 0; r < REPEATS; r++) {
+            Sample s;
+            if (!round_trip(len, &s)) {
+                printf("echo mismatch at len %u\n", len);
+                lcd_instruction(LCD_I_DDRAM | 0x40);  // Move to second line
+                lcd_putstr("FAIL");
+                return 1;
+            }
+            handshake(len, &s);
+            if (s.write < best.write) best.write = s.write;
+            if (s.read < best.read) best.read = s.read;
+            if (s.poll < best.poll) best.poll = s.poll;
+            if (s.polls < best.polls) best.polls = s.polls;
+            if (s.rtt < best.rtt) best.rtt = s.rtt;
+        }
+        printf("%3u %5u %5u %5u %5u %6u\n", len, best.write, best.read,
+               best.poll, best.polls, best.rtt);
+        bytes += len;
+        write_total += best.write;
+        read_total += best.read;
+        poll_total += best.poll;
+        if (len == 1) latency = best.rtt;
+    }
+
+    printf("write %lu B/s, read %lu B/s, handshake %lu cycles/read\n",
+           per_second(bytes, write_total), per_second(bytes, read_total),
+           poll_total / 255);
+    printf("1-byte round trip %u cycles (%u us)\n", latency,
+           latency / BENCH_MHZ);
+
+    if (BENCH_LOCAL_ECHO) {
+        const uint8_t off[2] = {'E', 0};
+        io_write(1, off, sizeof(off));
+    }
+    lcd_instruction(LCD_I_DDRAM | 0x40);  // Move to second line
+    lcd_putstr("Done");
+    return 0;
+}
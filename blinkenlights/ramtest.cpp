@@ -147,11 +147,189 @@ void devtest() {
     lcd_putstr("Received all OK");
 }
 
+#ifdef RAMTEST_BURNIN
+// Burn-in: every byte of main RAM and of each bank, through the page-unrolled
+// kernels in ramtest_kernels.S, pass after pass.  Results and throughput go
+// to the bridge terminal, and the pass number to the LCD.
+
+// Kernel patterns; also update ramtest_kernels.S if these change.
+const uint8_t RAMK_SOLID = 0;
+const uint8_t RAMK_CHECKER = 2;
+const uint8_t RAMK_ADDRESS = 4;
+
+extern "C" {
+void ramk_fill(uint8_t first_page, uint8_t pages, uint8_t kind, uint8_t value);
+uint16_t ramk_check(uint8_t first_page, uint8_t pages, uint8_t kind, uint8_t value);
+}
+
+// Main RAM above the data, soft stack and hardware stack (link.ld), and
+// the bank window.  Region 0 is main RAM, region n the window in bank n - 1.
+const uint8_t MAIN_FIRST_PAGE = 0x04;
+const uint8_t MAIN_PAGES = 0xA0 - MAIN_FIRST_PAGE;
+const uint8_t WINDOW_FIRST_PAGE = BANK_WINDOW >> 8;
+const uint8_t WINDOW_PAGES = BANK_WINDOW_SIZE >> 8;
+const uint8_t REGIONS = 1 + BANK_COUNT;
+
+struct Test {
+    const char* name;
+    uint8_t kind;
+    uint8_t value;
+};
+
+const Test tests[] = {
+    {"walk", RAMK_SOLID, 0x01}, {"walk", RAMK_SOLID, 0x02},
+    {"walk", RAMK_SOLID, 0x04}, {"walk", RAMK_SOLID, 0x08},
+    {"walk", RAMK_SOLID, 0x10}, {"walk", RAMK_SOLID, 0x20},
+    {"walk", RAMK_SOLID, 0x40}, {"walk", RAMK_SOLID, 0x80},
+    {"checker", RAMK_CHECKER, 0x55}, {"checker", RAMK_CHECKER, 0xAA},
+    {"address", RAMK_ADDRESS, 0x00}, {"address", RAMK_ADDRESS, 0xFF},
+};
+const uint8_t NUM_TESTS = sizeof(tests) / sizeof(tests[0]);
+
+// Terminal output, a line per bridge write
+char term_line[64];
+uint8_t term_len = 0;
+
+void term_putchar(char c) {
+    term_line[term_len++] = c;
+    if (c == '\n' || term_len == sizeof(term_line)) {
+        io_write(TERM_DEVICE, (const uint8_t*)term_line, term_len);
+        term_len = 0;
+    }
+}
+
+void term_putstr(const char* msg) {
+    while (*msg != 0) {
+        term_putchar(*msg);
+        msg++;
+    }
+}
+
+void term_puthex8(uint8_t val) {
+    uint8_t hi = val >> 4, lo = val & 0x0F;
+    term_putchar(hi < 10 ? '0' + hi : 'A' + hi - 10);
+    term_putchar(lo < 10 ? '0' + lo : 'A' + lo - 10);
+}
+
+void term_putdec(uint32_t val) {
+    char digits[10];
+    uint8_t n = 0;
+    do {
+        digits[n++] = '0' + val % 10;
+        val /= 10;
+    } while (val != 0);
+    while (n > 0) {
+        term_putchar(digits[--n]);
+    }
+}
+
+// Map |region| in and return its pages.
+uint8_t select_region(uint8_t region, uint8_t* first_page) {
+    if (region == 0) {
+        *first_page = MAIN_FIRST_PAGE;
+        return MAIN_PAGES;
+    }
+    set_bank(region - 1);
+    *first_page = WINDOW_FIRST_PAGE;
+    return WINDOW_PAGES;
+}
+
+// The address pattern differs per region, so a bank select line that
+// doesn't work shows up as another bank's pattern.
+uint8_t region_value(const Test& test, uint8_t region) {
+    return test.kind == RAMK_ADDRESS ? test.value ^ region : test.value;
+}
+
+uint8_t expected_at(uint8_t kind, uint8_t value, uint16_t addr) {
+    uint8_t offset = addr & 0xFF;
+    if (kind == RAMK_CHECKER) return offset & 1 ? value ^ 0xFF : value;
+    if (kind == RAMK_ADDRESS) return offset ^ (addr >> 8) ^ value;
+    return value;
+}
+
+// Fill every region, then check every region.  Returns false, having
+// reported the first bad byte, if any region fails.
+bool run_test(const Test& test) {
+    uint8_t first_page;
+    for (uint8_t region = 0; region < REGIONS; region++) {
+        uint8_t pages = select_region(region, &first_page);
+        ramk_fill(first_page, pages, test.kind, region_value(test, region));
+    }
+    for (uint8_t region = 0; region < REGIONS; region++) {
+        uint8_t pages = select_region(region, &first_page);
+        uint8_t value = region_value(test, region);
+        uint16_t bad = ramk_check(first_page, pages, test.kind, value);
+        if (bad == 0) continue;
+
+        // "FAIL walk 01 bank 03 $A123: want 01 got 00"
+        term_putstr("FAIL ");
+        term_putstr(test.name);
+        term_putchar(' ');
+        term_puthex8(test.value);
+        if (region == 0) {
+            term_putstr(" main");
+        } else {
+            term_putstr(" bank ");
+            term_puthex8(region - 1);
+        }
+        term_putstr(" $");
+        term_puthex8(bad >> 8);
+        term_puthex8(bad & 0xFF);
+        term_putstr(": want ");
+        term_puthex8(expected_at(test.kind, value, bad));
+        term_putstr(" got ");
+        term_puthex8(*((volatile uint8_t*)bad));
+        term_putchar('\n');
+        return false;
+    }
+    return true;
+}
+
+void burnin() {
+    const uint32_t pass_bytes =
+        (uint32_t)(MAIN_PAGES + BANK_COUNT * WINDOW_PAGES) * 256 * 2 * NUM_TESTS;
+
+    term_putstr("RAM burn-in: main $0400-$9FFF, ");
+    term_putdec(BANK_COUNT);
+    term_putstr(" banks at $A000\n");
+    for (uint16_t pass = 1;; pass++) {
+        lcd_reset();
+        lcd_putstr("Burn-in pass ");
+        lcd_puthex16(pass);
+
+        uint32_t start = millis();
+        bool ok = true;
+        for (uint8_t i = 0; i < NUM_TESTS && ok; i++) {
+            ok = run_test(tests[i]);
+        }
+        uint32_t ms = millis() - start;
+
+        lcd_instruction(LCD_I_DDRAM | 0x40);  // Move to second line
+        lcd_putstr(ok ? "OK" : "FAIL");
+        if (!ok) {
+            while (1) {}
+        }
+        // Bytes written and read back per ms, i.e. KB/s
+        term_putstr("pass ");
+        term_putdec(pass);
+        term_putstr(" ok, ");
+        term_putdec(ms);
+        term_putstr(" ms, ");
+        term_putdec(ms ? pass_bytes / ms : 0);
+        term_putstr(" KB/s\n");
+    }
+}
+#endif
+
 int main() {
     lcd_init();
 
+#ifdef RAMTEST_BURNIN
+    burnin();
+#else
     ramtest();
     devtest();
+#endif
 
     while (1) {}
 }
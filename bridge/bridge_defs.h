@@ -25,7 +25,16 @@
 // Clock configuration
 // ============================================================================
 
-#define CLK_SPEED_6502  1000000 // 1 MHz target clock for 6502
+#define CLK_SPEED_6502  1000000 // 1 MHz target clock for 6502 at boot
+
+// Speeds the 6502 can select with Device 1 ['C', mhz], as { MHz, PIO delay }.
+// The delay is the wait_cycle sample delay after PHI2 rises, in 150 MHz PIO
+// cycles.  It must let the write data settle (tMDS) yet leave a read's
+// `mov pindirs` (~11 cycles plus the delay after the edge) inside PHI2 high
+// with tDSR to spare: at 4 MHz PHI2 is high for 18 cycles (120ns), so 4
+// puts read data on the bus ~20ns before the fall.  8 MHz (~62ns high) is
+// shorter than the read path itself, so it isn't offered.
+#define CLK_6502_SPEEDS { { 1, 18 }, { 2, 18 }, { 4, 4 } }
 
 // ============================================================================
 // Buffer / ring sizes
@@ -35,9 +44,113 @@
 #define BUS_DMA_RING_SIZE   (1u << BUS_DMA_RING_BITS)   // 32768
 
 #define BUS_MAX_DEVICES     8
-#define BUS_MAX_BUFFER_SIZE 4096
 
-#define SPI_TX_QUEUE_SIZE   4096
+// Read-any: the 6502 writes [0x80 | BUS_READ_ANY][mask] and gets back
+// [total][device][len][data...]... covering every device in |mask| that
+// has data, within the current read limit.
+#define BUS_READ_ANY        0x0F
+
+// Read-block: the 6502 writes [0x80 | BUS_READ_BLOCK][device][n] and gets
+// back exactly [n][data x n], held back (0xFF) until the device has n bytes
+// buffered, so a known-length payload needs no length check or retry.
+#define BUS_READ_BLOCK      0x0E
+
+// Most bytes one Zero -> Pico Device 0 ['Z'] TLV of compressed data may
+// decompress to (see protocol.md), so a copy of its output fits the stack.
+#define BUS_LZ_MAX_OUT      1024
+
+// Per-device TX buffer (Zero -> 6502) sizes, log2 bytes.  All eight rings
+// are carved out of one arena of BUS_BUFFER_ARENA_SIZE bytes, so a size
+// given to one device is taken from no other.  At most 15 bits each (the
+// fill counts are 16-bit).
+#define BUS_DEV0_BUFFER_BITS 8      // Status: served by a TX callback
+#define BUS_DEV1_BUFFER_BITS 8      // System control
+#define BUS_DEV2_BUFFER_BITS 12     // Video/keyboard
+#define BUS_DEV3_BUFFER_BITS 14     // Netboot
+#define BUS_DEV4_BUFFER_BITS 15     // Network: received streams burst in
+#define BUS_DEV5_BUFFER_BITS 12     // Block load
+#define BUS_DEV6_BUFFER_BITS 10     // File read: a 512-byte page, twice over
+#define BUS_DEV7_BUFFER_BITS 12     // Echo
+
+#define BUS_DEVICE_BUFFER_BITS { \
+    BUS_DEV0_BUFFER_BITS, BUS_DEV1_BUFFER_BITS, BUS_DEV2_BUFFER_BITS, \
+    BUS_DEV3_BUFFER_BITS, BUS_DEV4_BUFFER_BITS, BUS_DEV5_BUFFER_BITS, \
+    BUS_DEV6_BUFFER_BITS, BUS_DEV7_BUFFER_BITS }
+
+#define BUS_BUFFER_ARENA_SIZE ( \
+    (1u << BUS_DEV0_BUFFER_BITS) + (1u << BUS_DEV1_BUFFER_BITS) + \
+    (1u << BUS_DEV2_BUFFER_BITS) + (1u << BUS_DEV3_BUFFER_BITS) + \
+    (1u << BUS_DEV4_BUFFER_BITS) + (1u << BUS_DEV5_BUFFER_BITS) + \
+    (1u << BUS_DEV6_BUFFER_BITS) + (1u << BUS_DEV7_BUFFER_BITS))
+
+// Per-device SPI TX lane (Pico -> Zero) sizes, log2 bytes, carved out of
+// one queue of SPI_TX_QUEUE_SIZE bytes like the device buffers above.
+// Each READ frame empties the control lanes (Devices 0 and 1) first and
+// then takes TLVs from the others in turn.
+#define SPI_DEV0_LANE_BITS  10      // Status, error strings, telemetry
+#define SPI_DEV1_LANE_BITS  10      // System control: acks, reset, latency
+#define SPI_DEV2_LANE_BITS  12      // Video/keyboard
+#define SPI_DEV3_LANE_BITS  10      // Netboot
+#define SPI_DEV4_LANE_BITS  12      // Network
+#define SPI_DEV5_LANE_BITS  10      // Block load
+#define SPI_DEV6_LANE_BITS  9       // File read
+#define SPI_DEV7_LANE_BITS  12      // Echo
+
+#define SPI_TX_LANE_BITS { \
+    SPI_DEV0_LANE_BITS, SPI_DEV1_LANE_BITS, SPI_DEV2_LANE_BITS, \
+    SPI_DEV3_LANE_BITS, SPI_DEV4_LANE_BITS, SPI_DEV5_LANE_BITS, \
+    SPI_DEV6_LANE_BITS, SPI_DEV7_LANE_BITS }
+
+#define SPI_TX_CTRL_LANES   2       // Devices below this are served first
+
+#define SPI_TX_QUEUE_SIZE ( \
+    (1u << SPI_DEV0_LANE_BITS) + (1u << SPI_DEV1_LANE_BITS) + \
+    (1u << SPI_DEV2_LANE_BITS) + (1u << SPI_DEV3_LANE_BITS) + \
+    (1u << SPI_DEV4_LANE_BITS) + (1u << SPI_DEV5_LANE_BITS) + \
+    (1u << SPI_DEV6_LANE_BITS) + (1u << SPI_DEV7_LANE_BITS))
+
+// Expansion RAM the 6502 stashes to and fetches from through Device 0
+// ['A'|'S'|'F'] (see protocol.md), kept in Pico SRAM.  A power of two: the
+// 24-bit address wraps at this size.
+#define BRIDGE_REU_SIZE     (256u * 1024u)
+
+// Netboot image cache (BRIDGE_NETBOOT_CACHE builds only): slots at the top
+// of flash, one image each, well clear of the firmware at the bottom.  A
+// slot gives one page to its header, so the largest image it keeps is
+// NETBOOT_CACHE_SLOT_SIZE - 258 bytes.  Names longer than
+// NETBOOT_CACHE_NAME_MAX always go to the Zero.
+#define NETBOOT_CACHE_SLOTS     8
+#define NETBOOT_CACHE_SLOT_SIZE (36u * 1024u)   // Whole 4 KB sectors
+#define NETBOOT_CACHE_NAME_MAX  64
+#define NETBOOT_CACHE_TLV       128     // Bytes per served chunk, as the Zero's
+
+// Most 6502 bytes one bus_task() call parses before handing back to the
+// main loop, so a write backlog can't hold off the SPI task for long.
+#define BUS_TASK_RX_BUDGET  1024
+
+// Fill level (percent) above which ring_stats.h counts a ring as "high"
+#define RING_HIGH_PCT       75
+
+// Cross-core TLV queues (BRIDGE_DUAL_CORE builds only), one per direction
+#define XCORE_QUEUE_SIZE    4096
+
+// 6502 IRQ coalescing, per device, as { bytes, us }: once a device enabled
+// for IRQ has data, the line is asserted when it has |bytes| buffered or
+// its oldest byte has waited |us|, whichever comes first, and then held
+// until every enabled device is empty.  { 1, 0 } is immediate, as the
+// keyboard and the request/response devices want; network receive waits
+// for a batch so a 1 MHz handler isn't entered per packet.  Device 1
+// ['Q'] changes them at run time.  Under BRIDGE_EVENT_LOOP the wait is
+// rounded up to the next EVENT_LOOP_TICK_US.
+#define IRQ_COALESCE { \
+    { 1, 0 },       /* Status (never buffered) */ \
+    { 1, 0 },       /* System control */ \
+    { 1, 0 },       /* Video/keyboard */ \
+    { 1, 0 },       /* Netboot */ \
+    { 128, 2000 },  /* Network */ \
+    { 1, 0 },       /* Block load */ \
+    { 1, 0 },       /* File read */ \
+    { 1, 0 } }      /* Echo */
 
 // ============================================================================
 // DMA TRANS_COUNT mode bits (RP2350)
@@ -56,6 +169,8 @@
 
 #define STATS_INTERVAL_MS   5000
 #define STARTUP_DELAY_MS    2000
+#define EVENT_LOOP_TICK_US  1000    // Longest __wfe() sleep (BRIDGE_EVENT_LOOP)
+#define RESET_PULSE_US      20      // Shortest RESB low time (BRIDGE_WARM_RESET)
 
 // ============================================================================
 // Debug output
@@ -73,15 +188,144 @@
 #define DBG_PRINTF(...) ((void)0)
 #endif
 
+// ============================================================================
+// Dual-core mode
+// ============================================================================
+// Set BRIDGE_DUAL_CORE=1 (e.g. via -DBRIDGE_DUAL_CORE=1) to run the SPI slave
+// pipeline on core 1 while core 0 services the 6502 bus.  The two cores
+// exchange TLVs through lock-free SPSC queues (spsc_queue.h).
+
+#ifndef BRIDGE_DUAL_CORE
+#define BRIDGE_DUAL_CORE 0
+#endif
+
+// ============================================================================
+// Event-driven main loop
+// ============================================================================
+// Set BRIDGE_EVENT_LOOP=1 (e.g. via -DBRIDGE_EVENT_LOOP=1) to sleep in
+// __wfe() whenever the bus and SPI tasks are idle instead of busy polling.
+// Wakeups come from the PIO RX FIFO, DMA and CS-edge IRQs (SEVONPEND),
+// cross-core queue pushes (__sev) and a timer every EVENT_LOOP_TICK_US,
+// which bounds the latency of everything else (stats, timeouts).  USB
+// stdio is only read when the chars-available callback reports input.
+
+#ifndef BRIDGE_EVENT_LOOP
+#define BRIDGE_EVENT_LOOP 0
+#endif
+
+// ============================================================================
+// Latency histograms
+// ============================================================================
+// Set BRIDGE_LATENCY_STATS=1 (e.g. via -DBRIDGE_LATENCY_STATS=1) to keep
+// per-device log2 histograms of bus read, Zero -> 6502 and 6502 -> Zero
+// latency in clk_sys cycles (latency.h).  They are printed with the stats,
+// sent to the Zero as Device 1 ['L'] TLVs every STATS_INTERVAL_MS, and
+// readable by the 6502 through device 0.
+
+#ifndef BRIDGE_LATENCY_STATS
+#define BRIDGE_LATENCY_STATS 0
+#endif
+
+// ============================================================================
+// Bus capture
+// ============================================================================
+// Set BRIDGE_BUS_CAPTURE=1 (e.g. via -DBRIDGE_BUS_CAPTURE=1) for a logic
+// analyzer on the 6502 bus (capture.h).  A third PIO state machine
+// (bus_capture in bus_interface.pio) samples RW, CS_N, PHI2, STAT_CS_N and
+// D[7:0] every cycle into a 16 KB DMA ring; the Zero arms it with a
+// Device 0 ['B'] TLV and gets the cycles around the trigger back as
+// Device 1 ['B'] TLVs.
+
+#ifndef BRIDGE_BUS_CAPTURE
+#define BRIDGE_BUS_CAPTURE 0
+#endif
+
+// ============================================================================
+// Trace events
+// ============================================================================
+// Set BRIDGE_EVENT_TRACE=1 (e.g. via -DBRIDGE_EVENT_TRACE=1) to log bus
+// reads, responses and writes and SPI WRITEs, REQUESTs and READs with
+// microsecond timestamps (events.h).  The Zero turns the log on with a
+// Device 0 ['T', 1] and gets it as Device 1 ['T'] TLVs, to merge with its
+// own trace into one timeline.
+
+#ifndef BRIDGE_EVENT_TRACE
+#define BRIDGE_EVENT_TRACE 0
+#endif
+
+// ============================================================================
+// USB link
+// ============================================================================
+// Set BRIDGE_USB_LINK=1 (e.g. via -DBRIDGE_USB_LINK=1) for bench setups
+// without a Zero: usb_link.c takes the place of spi_slave.c and carries
+// the same TLVs over the USB serial port, with no REQUEST/READY handshake
+// (protocol.md, "USB Link").  The port is all TLVs then, so printf output
+// goes nowhere; the telemetry TLVs still carry the stats.
+
+#ifndef BRIDGE_USB_LINK
+#define BRIDGE_USB_LINK 0
+#endif
+
+// ============================================================================
+// Status port
+// ============================================================================
+// Set BRIDGE_STATUS_PORT=1 (e.g. via -DBRIDGE_STATUS_PORT=1) for boards
+// built with CPLD/chipsel_fast.pld, which decodes a status port at $E0C0
+// onto GPIO 5.  A second PIO state machine (bus_status in
+// bus_interface.pio) answers its reads with the device data mask straight
+// from the FIFO, so the 6502 can poll it without a device 0 read.
+
+#ifndef BRIDGE_STATUS_PORT
+#define BRIDGE_STATUS_PORT 0
+#endif
+
+// ============================================================================
+// Netboot image cache
+// ============================================================================
+// Set BRIDGE_NETBOOT_CACHE=1 (e.g. via -DBRIDGE_NETBOOT_CACHE=1) to keep
+// recently booted device 3 images in spare flash (netboot_cache.h).  A
+// repeat boot is confirmed by hash with the Zero and then served from
+// flash, and a cached image boots without the Zero at all.  Flash is only
+// written while the bus is quiet or the 6502 is held in reset.
+
+#ifndef BRIDGE_NETBOOT_CACHE
+#define BRIDGE_NETBOOT_CACHE 0
+#endif
+
+// ============================================================================
+// Warm reset
+// ============================================================================
+// Set BRIDGE_WARM_RESET=1 (e.g. via -DBRIDGE_WARM_RESET=1) to answer a 6502
+// reset (pushbutton or device 1) by restarting the 6502 alone: the Pico
+// tells the Zero with a Device 1 ['W'], clears the bus and every device
+// buffer and releases RESB again, without the watchdog reboot and
+// STARTUP_DELAY_MS.  The SPI link, its protocol version and clock, the
+// expansion RAM and the netboot cache carry on.  USB 'R' still reboots.
+
+#ifndef BRIDGE_WARM_RESET
+#define BRIDGE_WARM_RESET 0
+#endif
+
 // ============================================================================
 // Static asserts for power-of-two ring buffer sizes
 // ============================================================================
 
 _Static_assert((BUS_DMA_RING_SIZE & (BUS_DMA_RING_SIZE - 1)) == 0,
                "BUS_DMA_RING_SIZE must be a power of two");
-_Static_assert((BUS_MAX_BUFFER_SIZE & (BUS_MAX_BUFFER_SIZE - 1)) == 0,
-               "BUS_MAX_BUFFER_SIZE must be a power of two");
-_Static_assert((SPI_TX_QUEUE_SIZE & (SPI_TX_QUEUE_SIZE - 1)) == 0,
-               "SPI_TX_QUEUE_SIZE must be a power of two");
+_Static_assert((BRIDGE_REU_SIZE & (BRIDGE_REU_SIZE - 1)) == 0 &&
+               BRIDGE_REU_SIZE <= (1u << 24),
+               "BRIDGE_REU_SIZE must be a power of two of at most 16 MB");
+_Static_assert(BUS_DEV0_BUFFER_BITS <= 15 && BUS_DEV1_BUFFER_BITS <= 15 &&
+               BUS_DEV2_BUFFER_BITS <= 15 && BUS_DEV3_BUFFER_BITS <= 15 &&
+               BUS_DEV4_BUFFER_BITS <= 15 && BUS_DEV5_BUFFER_BITS <= 15 &&
+               BUS_DEV6_BUFFER_BITS <= 15 && BUS_DEV7_BUFFER_BITS <= 15,
+               "device buffer sizes must fit the 16-bit fill counts");
+_Static_assert(SPI_DEV0_LANE_BITS >= 9 && SPI_DEV1_LANE_BITS >= 9 &&
+               SPI_DEV2_LANE_BITS >= 9 && SPI_DEV3_LANE_BITS >= 9 &&
+               SPI_DEV4_LANE_BITS >= 9 && SPI_DEV5_LANE_BITS >= 9 &&
+               SPI_DEV6_LANE_BITS >= 9 && SPI_DEV7_LANE_BITS >= 9,
+               "every SPI TX lane must hold a 257-byte TLV");
+_Static_assert((XCORE_QUEUE_SIZE & (XCORE_QUEUE_SIZE - 1)) == 0,
+               "XCORE_QUEUE_SIZE must be a power of two");
 
 #endif // BRIDGE_DEFS_H
@@ -5,11 +5,19 @@
  *   Write (CPU -> MCU): [device] [length] [data...]
  *   Read  (MCU -> CPU): [device|0x80] -> poll for != 0xFF, then [length] [data...]
  *
+ * With BRIDGE_STATUS_PORT a second state machine (bus_status) answers reads
+ * of a separate status port, selected on its own pin, from bus_set_status().
+ * With BRIDGE_BUS_CAPTURE a third (bus_capture) samples every bus cycle for
+ * capture.c, which arms it and watches transaction start bytes through
+ * cap_trigger_byte.
+ *
  * RX data is dispatched to per-device callbacks directly from the DMA
  * ring buffer.  DMA runs in TRIGGER_SELF mode for endless operation;
  * an epoch counter (maintained via DMA IRQ) tracks total bytes written
  * for overrun detection.  A post-callback check detects the case where
  * DMA overwrites data while a callback is executing ("bankruptcy").
+ * Either one resyncs the parser to the DMA write position (resync_rx)
+ * rather than halting.
  */
 
 #include "bus_interface.h"
@@ -23,6 +31,18 @@ _Static_assert(BUS_PIN_PHI2 == PIN_6502_PHI2,
 #include "hardware/dma.h"
 #include "hardware/irq.h"
 
+#if BRIDGE_LATENCY_STATS
+#include "latency.h"
+#endif
+
+#if BRIDGE_BUS_CAPTURE
+#include "capture.h"
+#endif
+
+#if BRIDGE_EVENT_TRACE
+#include "events.h"
+#endif
+
 #include <stdio.h>
 #include <string.h>
 
@@ -31,6 +51,17 @@ static PIO bus_pio = pio0;
 static uint bus_sm = 0;
 static uint bus_program_offset;
 
+#if BRIDGE_STATUS_PORT
+static uint status_sm = 1;
+static uint status_program_offset;
+static uint8_t status_last;
+#endif
+
+#if BRIDGE_BUS_CAPTURE
+static uint capture_sm = 2;
+static uint capture_program_offset;
+#endif
+
 // DMA channels
 static int dma_rx_chan = -1;
 static int dma_tx_chan = -1;
@@ -45,18 +76,42 @@ static uint32_t dma_rx_total_read = 0;
 // from the IRQ handler and read from the main loop.
 static volatile uint32_t dma_rx_epoch = 0;
 
-// One-shot TX DMA staging buffer.  Each byte is widened to a 32-bit word
-// because PIO TX FIFO entries are 32 bits and DMA uses DMA_SIZE_32.
-static uint32_t tx_staging[256];
+// One-shot TX DMA staging buffer: [len][data...].  The PIO shifts each
+// 32-bit FIFO word out a byte at a time, so bytes are DMA'd packed.
+// Used for callback devices and empty responses.
+static uint8_t __attribute__((aligned(4))) tx_staging[256];
+
+// Pre-staged read responses for buffered devices.  While idle, the head of
+// each device's TX buffer is copied into its slot ahead of time, so a
+// read request only has to fill in the length byte and trigger the DMA.
+// The bytes stay in the device buffer until the response is sent.
+//
+// The ring can't be DMA'd to the PIO directly: FIFO words are packed four
+// bytes each, so a response must start word-aligned with the length byte
+// sharing a word with the first data bytes, while the device tail can sit
+// at any offset.  The memcpy into the slot happens while idle, off the
+// 6502's read path.
+typedef struct {
+    uint8_t __attribute__((aligned(4))) bytes[256];  // [len][data x254][pad]
+    uint8_t len;            // Bytes from the buffer tail copied so far
+} tx_slot_t;
+
+static tx_slot_t tx_slots[BUS_MAX_DEVICES];
+static int tx_dma_slot = -1;    // Slot the in-flight TX DMA reads from, or -1
+static uint8_t tx_read_limit = 254;    // Max data bytes per buffered read
 
-// Per-device TX buffers (MCU -> CPU)
+// Per-device TX buffers (MCU -> CPU), each a power-of-two ring carved
+// out of tx_buffer_arena at bus_init() (sizes in bridge_defs.h).
 typedef struct {
-    uint8_t data[BUS_MAX_BUFFER_SIZE];
+    uint8_t *data;
+    uint16_t size;  // Power of two
     uint16_t head;  // Write position
     uint16_t tail;  // Read position
     uint16_t count; // Bytes in buffer
+    uint16_t freed; // Bytes read out, cleared or dropped on arrival (wraps)
 } device_buffer_t;
 
+static uint8_t tx_buffer_arena[BUS_BUFFER_ARENA_SIZE];
 static device_buffer_t device_tx_buffers[BUS_MAX_DEVICES];
 
 // Per-device RX callbacks
@@ -65,6 +120,12 @@ static bus_rx_callback_t rx_callbacks[BUS_MAX_DEVICES];
 // Per-device TX callbacks (bypass circular buffer when set)
 static bus_tx_callback_t tx_callbacks[BUS_MAX_DEVICES];
 
+// Devices whose writes are echoed into their TX buffers (bus_set_loopback)
+static uint8_t loopback_mask = 0;
+
+// Told about bytes dropped by an RX resync
+static bus_rx_loss_callback_t rx_loss_callback = NULL;
+
 // Temp buffer for assembling wrapped DMA ring data (max transfer = 255)
 static uint8_t rx_transaction_buf[255];
 
@@ -78,7 +139,13 @@ typedef enum {
     // Receiving write data bytes
     PROTO_RECEIVING,
     // Received read request, preparing response
-    PROTO_SENDING
+    PROTO_SENDING,
+    // Received read-any command, waiting for the device mask
+    PROTO_GOT_READ_ANY,
+    // Received read-block command, waiting for the device
+    PROTO_GOT_READ_BLOCK,
+    // Received read-block device, waiting for the block length
+    PROTO_GOT_BLOCK_DEVICE
 } proto_state_t;
 
 static proto_state_t proto_state = PROTO_IDLE;
@@ -86,6 +153,14 @@ static uint8_t current_device = 0;
 static uint16_t transfer_remaining = 0;
 static bool pending_read_request = false;
 static uint8_t pending_read_device = 0;   // device ID saved when read request is received
+static uint8_t pending_read_mask = 0;     // device mask of a BUS_READ_ANY request
+static uint8_t pending_read_exact = 0;    // BUS_READ_BLOCK length (0 = any length)
+#if BRIDGE_LATENCY_STATS
+static uint32_t pending_read_stamp = 0;   // lat_now() when the read request was parsed
+#endif
+#if BRIDGE_BUS_CAPTURE
+static uint32_t pending_read_us = 0;      // time_us_32() when the read request was parsed
+#endif
 static bool empty_read_recorded = false;
 
 // RX transaction tracking for callback dispatch + overrun detection
@@ -98,9 +173,13 @@ static bus_stats_t stats = {0};
 
 // Forward declarations
 static void setup_dma(void);
-static void process_rx_data(void);
+static void configure_rx_dma(void);
+static void process_rx_data(uint budget);
 static void feed_tx_fifo(void);
 static void dma_rx_irq_handler(void);
+#if BRIDGE_EVENT_LOOP
+static void pio_rx_wakeup_irq_handler(void);
+#endif
 static void handle_transaction_start_byte(uint8_t byte);
 
 void bus_register_rx_callback(uint8_t device, bus_rx_callback_t callback) {
@@ -115,11 +194,23 @@ void bus_register_tx_callback(uint8_t device, bus_tx_callback_t callback) {
     }
 }
 
+void bus_set_rx_loss_callback(bus_rx_loss_callback_t callback) {
+    rx_loss_callback = callback;
+}
+
 bool bus_init(void) {
+    static const uint8_t buffer_bits[BUS_MAX_DEVICES] = BUS_DEVICE_BUFFER_BITS;
+    uint8_t *arena = tx_buffer_arena;
     memset(device_tx_buffers, 0, sizeof(device_tx_buffers));
+    for (uint8_t d = 0; d < BUS_MAX_DEVICES; d++) {
+        device_tx_buffers[d].data = arena;
+        device_tx_buffers[d].size = (uint16_t)(1u << buffer_bits[d]);
+        arena += device_tx_buffers[d].size;
+    }
+    memset(tx_slots, 0, sizeof(tx_slots));
     memset(rx_callbacks, 0, sizeof(rx_callbacks));
     memset(tx_callbacks, 0, sizeof(tx_callbacks));
-    memset(&stats, 0, sizeof(stats));
+    bus_clear_stats();
 
     // Load PIO program
     if (!pio_can_add_program(bus_pio, &bus_interface_program)) {
@@ -130,6 +221,23 @@ bool bus_init(void) {
     // Initialize PIO state machine
     bus_interface_program_init(bus_pio, bus_sm, bus_program_offset);
 
+#if BRIDGE_STATUS_PORT
+    if (!pio_can_add_program(bus_pio, &bus_status_program)) {
+        return false;
+    }
+    status_program_offset = pio_add_program(bus_pio, &bus_status_program);
+    bus_status_program_init(bus_pio, status_sm, status_program_offset);
+    status_last = 0;
+#endif
+
+#if BRIDGE_BUS_CAPTURE
+    if (!pio_can_add_program(bus_pio, &bus_capture_program)) {
+        return false;
+    }
+    capture_program_offset = pio_add_program(bus_pio, &bus_capture_program);
+    bus_capture_program_init(bus_pio, capture_sm, capture_program_offset);
+#endif
+
     // Set up DMA
     setup_dma();
 
@@ -141,6 +249,20 @@ static void setup_dma(void) {
     dma_rx_chan = dma_claim_unused_channel(true);
     dma_tx_chan = dma_claim_unused_channel(true);
 
+    configure_rx_dma();
+    irq_set_exclusive_handler(DMA_IRQ_0, dma_rx_irq_handler);
+    irq_set_enabled(DMA_IRQ_0, true);
+
+#if BRIDGE_EVENT_LOOP
+    // RX FIFO not-empty IRQ: wakes the main loop out of __wfe() when the
+    // 6502 writes a byte.  One-shot, re-armed by bus_arm_wakeup().
+    irq_set_exclusive_handler(PIO0_IRQ_0, pio_rx_wakeup_irq_handler);
+    irq_set_enabled(PIO0_IRQ_0, true);
+#endif
+}
+
+// Point the RX channel at the start of an empty ring, not yet started.
+static void configure_rx_dma(void) {
     // === RX DMA: PIO RX FIFO -> RAM ring buffer ===
     dma_channel_config rx_config = dma_channel_get_default_config(dma_rx_chan);
     channel_config_set_transfer_data_size(&rx_config, DMA_SIZE_8);
@@ -168,8 +290,6 @@ static void setup_dma(void) {
     // BUS_DMA_RING_SIZE bytes).  We use this to maintain the epoch counter
     // for total-bytes-written tracking.
     dma_channel_set_irq0_enabled(dma_rx_chan, true);
-    irq_set_exclusive_handler(DMA_IRQ_0, dma_rx_irq_handler);
-    irq_set_enabled(DMA_IRQ_0, true);
 
     dma_rx_epoch = 0;
     dma_rx_read_idx = 0;
@@ -183,21 +303,67 @@ static void __isr dma_rx_irq_handler(void) {
     dma_rx_epoch++;
 }
 
+#if BRIDGE_EVENT_LOOP
+// RX FIFO went non-empty.  Taking the interrupt is what wakes the core;
+// disable the source so the DMA draining the FIFO can't cause a storm.
+static void __isr pio_rx_wakeup_irq_handler(void) {
+    pio_set_irq0_source_enabled(bus_pio, pis_sm0_rx_fifo_not_empty + bus_sm, false);
+}
+
+void bus_arm_wakeup(void) {
+    pio_set_irq0_source_enabled(bus_pio, pis_sm0_rx_fifo_not_empty + bus_sm, true);
+}
+#endif
+
 void bus_start(void) {
     dma_channel_start(dma_rx_chan);
     bus_interface_enable(bus_pio, bus_sm);
+#if BRIDGE_STATUS_PORT
+    pio_sm_set_enabled(bus_pio, status_sm, true);
+#endif
 }
 
 void bus_stop(void) {
     bus_interface_disable(bus_pio, bus_sm);
+#if BRIDGE_STATUS_PORT
+    pio_sm_set_enabled(bus_pio, status_sm, false);
+#endif
     dma_channel_abort(dma_rx_chan);
     dma_channel_abort(dma_tx_chan);
     dma_channel_set_irq0_enabled(dma_rx_chan, false);
     proto_state = PROTO_IDLE;
 }
 
+void bus_reset(void) {
+    // State machines back at their first instruction with empty FIFOs
+    bus_interface_program_init(bus_pio, bus_sm, bus_program_offset);
+#if BRIDGE_STATUS_PORT
+    bus_status_program_init(bus_pio, status_sm, status_program_offset);
+    status_last = 0;
+#endif
+    configure_rx_dma();
+
+    proto_state = PROTO_IDLE;
+    transfer_remaining = 0;
+    pending_read_request = false;
+    pending_read_exact = 0;
+    empty_read_recorded = false;
+    rx_transaction_len = 0;
+    tx_dma_slot = -1;
+    for (uint8_t d = 0; d < BUS_MAX_DEVICES; d++) {
+        bus_device_clear(d);
+    }
+    tx_read_limit = 254;
+    loopback_mask = 0;
+}
+
+// Priority order: a read the 6502 is already polling for, then (by
+// returning within BUS_TASK_RX_BUDGET bytes) the SPI task, then the rest
+// of the RX backlog on later calls.  Parsing also stops at a new read
+// command so its response goes out before the bytes behind it are parsed.
 void bus_task(void) {
-    process_rx_data();
+    if (pending_read_request) feed_tx_fifo();
+    process_rx_data(BUS_TASK_RX_BUDGET);
     feed_tx_fifo();
 }
 
@@ -239,6 +405,18 @@ static inline uint32_t get_dma_rx_total_written(void) {
 }
 
 static void handle_transaction_start_byte(uint8_t byte) {
+#if BRIDGE_BUS_CAPTURE
+    if (byte == cap_trigger_byte) cap_trigger();
+#endif
+    if (byte == (0x80 | BUS_READ_ANY)) {
+        proto_state = PROTO_GOT_READ_ANY;
+        return;
+    }
+    if (byte == (0x80 | BUS_READ_BLOCK)) {
+        proto_state = PROTO_GOT_READ_BLOCK;
+        return;
+    }
+
     // First byte: device number (bit 7 = read flag)
     current_device = byte & 0x7F;
     if (current_device >= BUS_MAX_DEVICES) {
@@ -252,6 +430,16 @@ static void handle_transaction_start_byte(uint8_t byte) {
         // Read request - save device and queue for feed_tx_fifo
         pending_read_request = true;
         pending_read_device = current_device;
+        pending_read_exact = 0;
+#if BRIDGE_LATENCY_STATS
+        pending_read_stamp = lat_now();
+#endif
+#if BRIDGE_BUS_CAPTURE
+        pending_read_us = time_us_32();
+#endif
+#if BRIDGE_EVENT_TRACE
+        evt_record(&evt_bus, EVT_BUS_READ, current_device, 0);
+#endif
         empty_read_recorded = false;
         proto_state = PROTO_IDLE;
     } else {
@@ -260,11 +448,44 @@ static void handle_transaction_start_byte(uint8_t byte) {
     }
 }
 
+// Recover from the DMA lapping the parser: drop every unparsed byte up to
+// the DMA write position and restart transaction parsing there.  A read
+// request already parsed stays pending, and a response in flight is left
+// to finish; everything else in the dropped span is lost.
+static void resync_rx(bool bankrupt) {
+    uint32_t total_written = get_dma_rx_total_written();
+    uint32_t dropped = total_written - dma_rx_total_read;
+
+    dma_rx_total_read = total_written;
+    dma_rx_read_idx = total_written & (BUS_DMA_RING_SIZE - 1);
+    if (proto_state != PROTO_SENDING) {
+        proto_state = PROTO_IDLE;
+    }
+    transfer_remaining = 0;
+
+    if (bankrupt) {
+        stats.rx_bankruptcies++;
+    } else {
+        stats.rx_dma_overruns++;
+    }
+    stats.rx_bytes_lost += dropped;
+    printf("!!! 6502 RX %s: resynced, %lu bytes dropped\n",
+           bankrupt ? "BANKRUPTCY" : "DMA OVERRUN", (unsigned long)dropped);
+
+    if (rx_loss_callback) {
+        rx_loss_callback(dropped, bankrupt);
+    }
+}
+
 // Dispatch the completed RX transaction to the device callback.
 // Returns true on bankruptcy (caller must bail out of process_rx_data).
 static bool dispatch_rx_callback(void) {
+#if BRIDGE_EVENT_TRACE
+    evt_record(&evt_bus, EVT_BUS_WRITE, current_device, rx_transaction_len);
+#endif
     bus_rx_callback_t cb = rx_callbacks[current_device];
-    if (!cb) return false;
+    bool loopback = loopback_mask & (1u << current_device);
+    if (!cb && !loopback) return false;
 
     const uint8_t *data;
     if (rx_transaction_start_idx + rx_transaction_len <= BUS_DMA_RING_SIZE) {
@@ -280,38 +501,66 @@ static bool dispatch_rx_callback(void) {
         data = rx_transaction_buf;
     }
 
-    cb(current_device, data, rx_transaction_len);
+    if (loopback) {
+        bus_device_write(current_device, data, rx_transaction_len);
+    } else {
+        cb(current_device, data, rx_transaction_len);
+    }
 
     // Post-callback overrun check: if DMA has written more than a full
     // buffer since we started reading this transaction's data, the bytes
     // the callback just processed may have been overwritten mid-read.
     uint32_t total_written_now = get_dma_rx_total_written();
+    // The delivered data can't be taken back; resync so at least the
+    // parser isn't fed the overwritten bytes that follow.
     if (total_written_now - rx_transaction_total_read_start > BUS_DMA_RING_SIZE) {
-        printf("!!! FATAL: 6502 RX BANKRUPTCY: DMA overran data during callback "
+        printf("!!! 6502 RX BANKRUPTCY: DMA overran data during callback "
                "(device %d, %d bytes)\n",
                current_device, rx_transaction_len);
-        for (;;) tight_loop_contents();
+        resync_rx(true);
+        return true;
     }
 
     return false;
 }
 
-static void process_rx_data(void) {
+static void process_rx_data(uint budget) {
     uint32_t total_written = get_dma_rx_total_written();
     uint32_t unread = total_written - dma_rx_total_read;
     uint write_idx = get_dma_rx_write_idx();
 
     if (unread > BUS_DMA_RING_SIZE) {
-        printf("!!! FATAL: 6502 RX DMA OVERRUN: %lu bytes lost\n",
-               (unsigned long)(unread - BUS_DMA_RING_SIZE));
-        for (;;) tight_loop_contents();
+        resync_rx(false);
+        return;
     }
+    ring_stats_sample(&stats.rx_ring, unread);
+
+    bool read_was_pending = pending_read_request;
+    while (dma_rx_read_idx != write_idx && budget > 0) {
+        if (proto_state == PROTO_RECEIVING) {
+            // Bulk fast path: payload bytes are never inspected here (the
+            // callback reads them straight from the ring), so skip as many
+            // as are available in one step instead of looping per byte.
+            uint avail = (write_idx - dma_rx_read_idx) & (BUS_DMA_RING_SIZE - 1);
+            uint skip = (transfer_remaining < avail) ? transfer_remaining : avail;
+            if (skip > budget) skip = budget;
+            dma_rx_read_idx = (dma_rx_read_idx + skip) & (BUS_DMA_RING_SIZE - 1);
+            dma_rx_total_read += skip;
+            stats.rx_bytes += skip;
+            transfer_remaining -= skip;
+            budget -= skip;
+            if (transfer_remaining == 0) {
+                if (dispatch_rx_callback()) return;
+                proto_state = PROTO_IDLE;
+            }
+            continue;
+        }
 
-    while (dma_rx_read_idx != write_idx) {
         uint8_t byte = dma_rx_buffer[dma_rx_read_idx];
         dma_rx_read_idx = (dma_rx_read_idx + 1) & (BUS_DMA_RING_SIZE - 1);
         dma_rx_total_read++;
         stats.rx_bytes++;
+        budget--;
 
         DBG_PRINTF("RX byte=0x%02x dev=%d state=%d\n", byte,
                    byte & 0x7F, proto_state);
@@ -336,12 +585,54 @@ static void process_rx_data(void) {
                 break;
 
             case PROTO_RECEIVING:
-                // Consume data bytes (no copy - callback reads from DMA buffer)
-                transfer_remaining--;
-                if (transfer_remaining == 0) {
-                    if (dispatch_rx_callback()) return;
+                // Handled by the bulk fast path above.
+                break;
+
+            case PROTO_GOT_READ_ANY:
+                // Second byte: device mask
+                pending_read_request = true;
+                pending_read_device = BUS_READ_ANY;
+                pending_read_mask = byte;
+#if BRIDGE_LATENCY_STATS
+                pending_read_stamp = lat_now();
+#endif
+#if BRIDGE_BUS_CAPTURE
+                pending_read_us = time_us_32();
+#endif
+#if BRIDGE_EVENT_TRACE
+                evt_record(&evt_bus, EVT_BUS_READ, pending_read_device, 0);
+#endif
+                empty_read_recorded = false;
+                proto_state = PROTO_IDLE;
+                break;
+
+            case PROTO_GOT_READ_BLOCK:
+                // Second byte: device
+                current_device = byte & 0x7F;
+                if (current_device >= BUS_MAX_DEVICES) {
+                    printf("!!! Invalid read-block device %d\n", current_device);
                     proto_state = PROTO_IDLE;
+                    break;
                 }
+                proto_state = PROTO_GOT_BLOCK_DEVICE;
+                break;
+
+            case PROTO_GOT_BLOCK_DEVICE:
+                // Third byte: block length, within what one response holds
+                pending_read_request = true;
+                pending_read_device = current_device;
+                pending_read_exact = (byte > tx_read_limit) ? tx_read_limit : byte;
+#if BRIDGE_LATENCY_STATS
+                pending_read_stamp = lat_now();
+#endif
+#if BRIDGE_BUS_CAPTURE
+                pending_read_us = time_us_32();
+#endif
+#if BRIDGE_EVENT_TRACE
+                evt_record(&evt_bus, EVT_BUS_READ, pending_read_device, 0);
+#endif
+                empty_read_recorded = false;
+                proto_state = PROTO_IDLE;
                 break;
 
             case PROTO_SENDING:
@@ -359,11 +650,21 @@ static void process_rx_data(void) {
                 handle_transaction_start_byte(byte);
                 break;
         }
+
+        // A read parsed just now is answered before the bytes behind it.
+        if (pending_read_request && !read_was_pending) return;
     }
 }
 
-// Start a one-shot DMA transfer from tx_staging to PIO TX FIFO.
-static void start_tx_dma(uint count) {
+// Start a one-shot DMA transfer of the |count| bytes at |buf| to the PIO
+// TX FIFO.  The last word is padded with 0xFF, which the 6502 only ever
+// sees as extra "not ready" polls ahead of the next response.
+static void start_tx_dma(uint8_t *buf, uint count) {
+    uint words = (count + 3) / 4;
+    for (uint i = count; i < words * 4; i++) {
+        buf[i] = 0xFF;
+    }
+
     dma_channel_config tx_config = dma_channel_get_default_config(dma_tx_chan);
     channel_config_set_transfer_data_size(&tx_config, DMA_SIZE_32);
     channel_config_set_read_increment(&tx_config, true);
@@ -374,43 +675,129 @@ static void start_tx_dma(uint count) {
         dma_tx_chan,
         &tx_config,
         &bus_pio->txf[bus_sm],
-        tx_staging,
-        count,
+        buf,
+        words,
         true  // Start immediately
     );
 }
 
+// True if a buffered device has bytes its slot could still pre-stage.
+// The slot the TX DMA is still reading from is left alone until it finishes.
+static bool tx_slot_stale(uint8_t device) {
+    if (tx_callbacks[device] || (int)device == tx_dma_slot) return false;
+    return tx_slots[device].len < 254 &&
+           tx_slots[device].len < device_tx_buffers[device].count;
+}
+
+// Copy newly buffered bytes into a device's slot, up to one response.
+static void stage_tx_slot(uint8_t device) {
+    device_buffer_t *buf = &device_tx_buffers[device];
+    tx_slot_t *slot = &tx_slots[device];
+    uint16_t want = (buf->count > 254) ? 254 : buf->count;
+    if (want <= slot->len) return;
+
+    // Copy in up to two chunks (handles ring wrap)
+    uint16_t n = want - slot->len;
+    uint16_t pos = (buf->tail + slot->len) & (buf->size - 1);
+    uint16_t first = buf->size - pos;
+    if (first > n) first = n;
+    memcpy(&slot->bytes[1 + slot->len], &buf->data[pos], first);
+    if (n > first) {
+        memcpy(&slot->bytes[1 + slot->len + first], buf->data, n - first);
+    }
+    slot->len = (uint8_t)want;
+}
+
+// Move up to |max| bytes from a device's buffer tail to |dst|.
+static uint16_t take_tx_bytes(uint8_t device, uint8_t *dst, uint16_t max) {
+    device_buffer_t *buf = &device_tx_buffers[device];
+    uint16_t n = (buf->count > max) ? max : buf->count;
+    uint16_t first = buf->size - buf->tail;
+    if (first > n) first = n;
+    memcpy(dst, &buf->data[buf->tail], first);
+    if (n > first) {
+        memcpy(dst + first, buf->data, n - first);
+    }
+    buf->tail = (buf->tail + n) & (buf->size - 1);
+    buf->count -= n;
+    buf->freed += n;
+    tx_slots[device].len = 0;   // Staged bytes started at the old tail
+    ring_stats_sample(&stats.tx_buffers[device], buf->count);
+    return n;
+}
+
+// Assemble a BUS_READ_ANY response in tx_staging: one [device][len][data]
+// record per buffered device in |mask| with data, in device order, until
+// the read limit is used up.  Returns the total length.
+static uint8_t build_read_any(uint8_t mask) {
+    uint16_t total = 0;
+    for (uint8_t d = 1; d < BUS_MAX_DEVICES; d++) {
+        if (!(mask & (1u << d)) || tx_callbacks[d]) continue;
+        if (device_tx_buffers[d].count == 0) continue;
+        if (total + 3 > tx_read_limit) break;
+        uint8_t *rec = &tx_staging[1 + total];
+        uint16_t n = take_tx_bytes(d, rec + 2, tx_read_limit - total - 2);
+        rec[0] = d;
+        rec[1] = (uint8_t)n;
+        total += 2 + n;
+    }
+    return (uint8_t)total;
+}
+
 static void feed_tx_fifo(void) {
     // Check if a previous one-shot DMA has completed
     if (proto_state == PROTO_SENDING && !dma_channel_is_busy(dma_tx_chan)) {
         proto_state = PROTO_IDLE;
     }
+    if (proto_state != PROTO_SENDING) {
+        tx_dma_slot = -1;
+    }
 
     // Handle pending read request (only if no DMA in flight)
     if (pending_read_request && proto_state != PROTO_SENDING) {
         uint8_t len = 0;
 
         // If a TX callback is registered, use it instead of the device buffer
-        bus_tx_callback_t tx_cb = tx_callbacks[pending_read_device];
-        if (tx_cb) {
-            uint8_t cb_data[254];
-            len = tx_cb(cb_data, 254);
-            tx_staging[0] = (uint32_t)len;
-            for (uint8_t i = 0; i < len; i++) {
-                tx_staging[1 + i] = (uint32_t)cb_data[i];
+        bus_tx_callback_t tx_cb = (pending_read_device < BUS_MAX_DEVICES)
+                                  ? tx_callbacks[pending_read_device] : NULL;
+        if (pending_read_device == BUS_READ_ANY) {
+            len = build_read_any(pending_read_mask);
+            tx_staging[0] = len;
+            if (len > 0) {
+                start_tx_dma(tx_staging, len + 1);
+            }
+        } else if (tx_cb) {
+            len = tx_cb(&tx_staging[1], 254);
+            tx_staging[0] = len;
+            if (len > 0) {
+                start_tx_dma(tx_staging, len + 1);
             }
         } else {
             device_buffer_t *buf = &device_tx_buffers[pending_read_device];
-            DBG_PRINTF("dev%d buf: count=%d head=%d tail=%d\n",
-                       pending_read_device, buf->count, buf->head, buf->tail);
-            if (buf->count > 0) {
-                len = (buf->count > 254) ? 254 : buf->count;
-                tx_staging[0] = (uint32_t)len;
-                for (uint16_t i = 0; i < len; i++) {
-                    tx_staging[1 + i] = (uint32_t)buf->data[buf->tail];
-                    buf->tail = (buf->tail + 1) & (BUS_MAX_BUFFER_SIZE - 1);
-                    buf->count--;
-                }
+            tx_slot_t *slot = &tx_slots[pending_read_device];
+            // A read-block keeps the 6502 polling on 0xFF until the whole
+            // block is buffered, rather than answering short.
+            if (buf->count < pending_read_exact) return;
+            DBG_PRINTF("dev%d buf: count=%d head=%d tail=%d staged=%d\n",
+                       pending_read_device, buf->count, buf->head, buf->tail,
+                       slot->len);
+
+            // Normally already staged; this only tops up bytes that
+            // arrived since the last idle pass.
+            stage_tx_slot(pending_read_device);
+            len = slot->len;
+            if (len > tx_read_limit) len = tx_read_limit;
+            if (pending_read_exact) len = pending_read_exact;
+            if (len > 0) {
+                slot->bytes[0] = len;
+                start_tx_dma(slot->bytes, len + 1);
+                tx_dma_slot = pending_read_device;
+
+                buf->tail = (buf->tail + len) & (buf->size - 1);
+                buf->count -= len;
+                buf->freed += len;
+                slot->len = 0;
+                ring_stats_sample(&stats.tx_buffers[pending_read_device], buf->count);
             }
         }
 
@@ -418,7 +805,6 @@ static void feed_tx_fifo(void) {
 
         if (len > 0) {
             stats.tx_bytes += len;
-            start_tx_dma(len + 1);
             proto_state = PROTO_SENDING;
             pending_read_request = false;
             empty_read_recorded = false;
@@ -426,7 +812,7 @@ static void feed_tx_fifo(void) {
             // No data available - send length=0 so the 6502 can move on
             // (otherwise it polls 0xFF forever)
             tx_staging[0] = 0;
-            start_tx_dma(1);
+            start_tx_dma(tx_staging, 1);
             proto_state = PROTO_SENDING;
             pending_read_request = false;
             if (!empty_read_recorded) {
@@ -434,43 +820,255 @@ static void feed_tx_fifo(void) {
                 empty_read_recorded = true;
             }
         }
+#if BRIDGE_LATENCY_STATS
+        if (pending_read_device < BUS_MAX_DEVICES) {
+            lat_record(LAT_BUS_READ, pending_read_device, pending_read_stamp);
+        }
+#endif
+#if BRIDGE_EVENT_TRACE
+        evt_record(&evt_bus, EVT_BUS_RESPONSE, pending_read_device, len);
+#endif
+    }
+
+    // Pre-stage the next response of every buffered device.
+    if (!pending_read_request) {
+        for (uint8_t d = 0; d < BUS_MAX_DEVICES; d++) {
+            if (tx_slot_stale(d)) {
+                stage_tx_slot(d);
+            }
+        }
     }
 }
 
+bool bus_idle(void) {
+    if (pending_read_request) return false;
+    if (dma_rx_read_idx != get_dma_rx_write_idx()) return false;
+    for (uint8_t d = 0; d < BUS_MAX_DEVICES; d++) {
+        if (tx_slot_stale(d)) return false;
+    }
+    return true;
+}
+
 uint16_t bus_device_write(uint8_t device, const uint8_t *data, uint16_t len) {
     if (device >= BUS_MAX_DEVICES) return 0;
     device_buffer_t *buf = &device_tx_buffers[device];
-    uint16_t space = BUS_MAX_BUFFER_SIZE - buf->count;
+    uint16_t space = buf->size - buf->count;
     uint16_t to_write = (len < space) ? len : space;
 
     // Copy in up to two chunks (handles ring wrap)
-    uint16_t first = BUS_MAX_BUFFER_SIZE - buf->head;
+    uint16_t first = buf->size - buf->head;
     if (first > to_write) first = to_write;
     memcpy(&buf->data[buf->head], data, first);
     if (to_write > first) {
         memcpy(buf->data, data + first, to_write - first);
     }
-    buf->head = (buf->head + to_write) & (BUS_MAX_BUFFER_SIZE - 1);
+    buf->head = (buf->head + to_write) & (buf->size - 1);
     buf->count += to_write;
+    buf->freed += len - to_write;
+    ring_stats_sample(&stats.tx_buffers[device], buf->count);
 
     return to_write;
 }
 
+uint8_t bus_device_writev(const bus_tlv_t *tlvs, uint count) {
+    // Pass 1: total bytes per device, and which devices can take them all.
+    uint32_t need[BUS_MAX_DEVICES] = {0};
+    for (uint i = 0; i < count; i++) {
+        if (tlvs[i].device < BUS_MAX_DEVICES) need[tlvs[i].device] += tlvs[i].len;
+    }
+    uint8_t dropped = 0;
+    for (uint8_t d = 0; d < BUS_MAX_DEVICES; d++) {
+        const device_buffer_t *buf = &device_tx_buffers[d];
+        if (need[d] > (uint32_t)(buf->size - buf->count)) dropped |= 1u << d;
+    }
+
+    // Pass 2: copy the accepted TLVs, then publish each device once.
+    uint16_t head[BUS_MAX_DEVICES];
+    for (uint8_t d = 0; d < BUS_MAX_DEVICES; d++) {
+        head[d] = device_tx_buffers[d].head;
+    }
+    for (uint i = 0; i < count; i++) {
+        uint8_t d = tlvs[i].device;
+        if (d >= BUS_MAX_DEVICES || (dropped & (1u << d))) continue;
+        device_buffer_t *buf = &device_tx_buffers[d];
+        uint16_t len = tlvs[i].len;
+        uint16_t first = buf->size - head[d];
+        if (first > len) first = len;
+        memcpy(&buf->data[head[d]], tlvs[i].data, first);
+        if (len > first) {
+            memcpy(buf->data, tlvs[i].data + first, len - first);
+        }
+        head[d] = (head[d] + len) & (buf->size - 1);
+    }
+    for (uint8_t d = 0; d < BUS_MAX_DEVICES; d++) {
+        if (need[d] == 0) continue;
+        device_buffer_t *buf = &device_tx_buffers[d];
+        if (dropped & (1u << d)) {
+            buf->freed += (uint16_t)need[d];
+            continue;
+        }
+        buf->head = head[d];
+        buf->count += need[d];
+        ring_stats_sample(&stats.tx_buffers[d], buf->count);
+    }
+    return dropped;
+}
+
+// An LZ4 extended length: bytes added to |*n| until one isn't 255.
+static bool lz_read_len(const uint8_t **p, const uint8_t *end, uint32_t *n) {
+    uint8_t b;
+    do {
+        if (*p >= end) return false;
+        b = *(*p)++;
+        *n += b;
+    } while (b == 255);
+    return true;
+}
+
+bool bus_device_write_lz(uint8_t device, const uint8_t *src, uint16_t src_len,
+                         uint16_t out_len) {
+    if (device >= BUS_MAX_DEVICES) return false;
+    device_buffer_t *buf = &device_tx_buffers[device];
+    uint16_t mask = buf->size - 1;
+    const uint8_t *p = src;
+    const uint8_t *end = src + src_len;
+    uint16_t head = buf->head;
+    uint32_t out = 0;
+    if (out_len > buf->size - buf->count) goto drop;
+
+    // Decode into the free part of the ring and publish only once the
+    // whole of |src| has checked out.
+    while (out < out_len) {
+        if (p >= end) goto drop;
+        uint8_t token = *p++;
+        uint32_t n = token >> 4;
+        if (n == 15 && !lz_read_len(&p, end, &n)) goto drop;
+        if (n > out_len - out || n > (uint32_t)(end - p)) goto drop;
+        uint32_t first = buf->size - head;
+        if (first > n) first = n;
+        memcpy(&buf->data[head], p, first);
+        memcpy(buf->data, p + first, n - first);
+        head = (head + n) & mask;
+        p += n;
+        out += n;
+        if (out == out_len) break;      // Ends on literals: no match follows
+
+        if (end - p < 2) goto drop;
+        uint16_t offset = (uint16_t)(p[0] | p[1] << 8);
+        p += 2;
+        n = (token & 15) + 4;
+        if ((token & 15) == 15 && !lz_read_len(&p, end, &n)) goto drop;
+        if (offset == 0 || offset > buf->size || n > out_len - out) goto drop;
+        // Byte by byte: the match may overlap what it produces
+        uint16_t from = (head - offset) & mask;
+        for (uint32_t i = 0; i < n; i++) {
+            buf->data[head] = buf->data[from];
+            head = (head + 1) & mask;
+            from = (from + 1) & mask;
+        }
+        out += n;
+    }
+    if (p != end) goto drop;
+
+    buf->head = head;
+    buf->count += out_len;
+    ring_stats_sample(&stats.tx_buffers[device], buf->count);
+    return true;
+
+drop:
+    buf->freed += out_len;
+    return false;
+}
+
+void bus_device_copy_last(uint8_t device, uint8_t *dst, uint16_t len) {
+    if (device >= BUS_MAX_DEVICES) return;
+    const device_buffer_t *buf = &device_tx_buffers[device];
+    uint16_t from = (buf->head - len) & (buf->size - 1);
+    uint16_t first = buf->size - from;
+    if (first > len) first = len;
+    memcpy(dst, &buf->data[from], first);
+    memcpy(dst + first, buf->data, len - first);
+}
+
 void bus_device_clear(uint8_t device) {
     if (device >= BUS_MAX_DEVICES) return;
+    device_tx_buffers[device].freed += device_tx_buffers[device].count;
     device_tx_buffers[device].head = 0;
     device_tx_buffers[device].tail = 0;
     device_tx_buffers[device].count = 0;
+    tx_slots[device].len = 0;
+    ring_stats_sample(&stats.tx_buffers[device], 0);
+}
+
+void bus_set_read_limit(uint8_t max_len) {
+    tx_read_limit = (max_len == 0 || max_len > 254) ? 254 : max_len;
+}
+
+void bus_set_loopback(uint8_t mask) {
+    loopback_mask = mask;
+}
+
+void bus_set_sample_delay(uint cycles) {
+    if (cycles > 31) cycles = 31;
+    // A single 16-bit instruction store, so the SM never fetches half of it
+    bus_pio->instr_mem[bus_program_offset + bus_interface_offset_wait_cycle] =
+        pio_encode_wait_gpio(true, BUS_PIN_PHI2) | pio_encode_delay(cycles);
+#if BRIDGE_STATUS_PORT
+    bus_pio->instr_mem[status_program_offset + bus_status_offset_wait_cycle] =
+        pio_encode_wait_gpio(true, BUS_PIN_PHI2) | pio_encode_delay(cycles);
+#endif
+#if BRIDGE_BUS_CAPTURE
+    bus_pio->instr_mem[capture_program_offset + bus_capture_offset_wait_cycle] =
+        pio_encode_wait_gpio(true, BUS_PIN_PHI2) | pio_encode_delay(cycles);
+#endif
+}
+
+#if BRIDGE_STATUS_PORT
+void bus_set_status(uint8_t status) {
+    if (status == status_last) return;
+    // Only the newest byte matters, so make room rather than wait
+    if (pio_sm_is_tx_fifo_full(bus_pio, status_sm)) {
+        pio_sm_clear_fifos(bus_pio, status_sm);
+    }
+    pio_sm_put(bus_pio, status_sm, status);
+    status_last = status;
+}
+#endif
+
+#if BRIDGE_BUS_CAPTURE
+void bus_capture_enable(bool enable) {
+    if (enable) {
+        pio_sm_clear_fifos(bus_pio, capture_sm);
+        pio_sm_restart(bus_pio, capture_sm);
+        pio_sm_exec(bus_pio, capture_sm, pio_encode_jmp(capture_program_offset));
+    }
+    pio_sm_set_enabled(bus_pio, capture_sm, enable);
+}
+
+const volatile void *bus_capture_fifo(uint *dreq) {
+    *dreq = pio_get_dreq(bus_pio, capture_sm, false);
+    return &bus_pio->rxf[capture_sm];
+}
+
+bool bus_read_pending(uint32_t *since_us) {
+    *since_us = pending_read_us;
+    return pending_read_request;
 }
+#endif
 
 uint16_t bus_device_tx_count(uint8_t device) {
     if (device >= BUS_MAX_DEVICES) return 0;
     return device_tx_buffers[device].count;
 }
 
+uint16_t bus_device_tx_freed(uint8_t device) {
+    if (device >= BUS_MAX_DEVICES) return 0;
+    return device_tx_buffers[device].freed;
+}
+
 uint16_t bus_device_tx_free(uint8_t device) {
     if (device >= BUS_MAX_DEVICES) return 0;
-    return BUS_MAX_BUFFER_SIZE - device_tx_buffers[device].count;
+    return device_tx_buffers[device].size - device_tx_buffers[device].count;
 }
 
 bus_stats_t bus_get_stats(void) {
@@ -479,13 +1077,29 @@ bus_stats_t bus_get_stats(void) {
 
 void bus_clear_stats(void) {
     memset(&stats, 0, sizeof(stats));
+    ring_stats_init(&stats.rx_ring, BUS_DMA_RING_SIZE);
+    for (uint8_t d = 0; d < BUS_MAX_DEVICES; d++) {
+        ring_stats_init(&stats.tx_buffers[d], device_tx_buffers[d].size);
+    }
+}
+
+bus_diag_t bus_get_diag(void) {
+    bus_diag_t diag = {
+        .pc = pio_sm_get_pc(bus_pio, bus_sm),
+        .tx_fifo = (uint8_t)pio_sm_get_tx_fifo_level(bus_pio, bus_sm),
+        .rx_fifo = (uint8_t)pio_sm_get_rx_fifo_level(bus_pio, bus_sm),
+        .proto_state = (uint8_t)proto_state,
+    };
+    return diag;
 }
 
 void bus_diagnose(void) {
+#if BRIDGE_DEBUG
     // PIO state machine
-    uint8_t pc = pio_sm_get_pc(bus_pio, bus_sm);
-    uint tx_fifo = pio_sm_get_tx_fifo_level(bus_pio, bus_sm);
-    uint rx_fifo = pio_sm_get_rx_fifo_level(bus_pio, bus_sm);
+    bus_diag_t diag = bus_get_diag();
+    uint8_t pc = diag.pc;
+    uint tx_fifo = diag.tx_fifo;
+    uint rx_fifo = diag.rx_fifo;
 
     // GPIO 6-13 pin directions (1=output, 0=input)
     uint8_t pindirs = 0;
@@ -503,4 +1117,5 @@ void bus_diagnose(void) {
     DBG_PRINTF("             proto=%d pending_rd=%d rd_dev=%d dma_tx_busy=%d dev7_buf=%d\n",
            proto_state, pending_read_request, pending_read_device,
            dma_channel_is_busy(dma_tx_chan), device_tx_buffers[7].count);
+#endif
 }
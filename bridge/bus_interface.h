@@ -18,6 +18,7 @@
 #include <stdbool.h>
 
 #include "bridge_defs.h"
+#include "ring_stats.h"
 
 // RX callback: called when a complete write transaction is received.
 // |data| points into the DMA ring buffer and is only valid for the
@@ -33,6 +34,13 @@ void bus_register_rx_callback(uint8_t device, bus_rx_callback_t callback);
 typedef uint8_t (*bus_tx_callback_t)(uint8_t *data, uint8_t max_len);
 void bus_register_tx_callback(uint8_t device, bus_tx_callback_t callback);
 
+// RX loss callback: called after the DMA RX ring overran the parser and
+// bus_task() resynchronized by dropping |bytes_lost| unparsed bytes.
+// |bankrupt| is set when the overrun hit a transaction while its callback
+// was running, so that callback may have seen corrupt data.
+typedef void (*bus_rx_loss_callback_t)(uint32_t bytes_lost, bool bankrupt);
+void bus_set_rx_loss_callback(bus_rx_loss_callback_t callback);
+
 // Initialize the bus interface (PIO + DMA)
 // Returns true on success, false on failure
 bool bus_init(void);
@@ -43,35 +51,129 @@ void bus_start(void);
 // Stop the bus interface (disables PIO state machine)
 void bus_stop(void);
 
+// Between bus_stop() and bus_start(): put the bus back as bus_init() left
+// it, for a 6502 reset that doesn't reboot the Pico.  Unparsed writes and
+// every device buffer are dropped (their bytes count as freed), and the
+// read limit and loopback are turned off.  Callbacks and statistics stay.
+void bus_reset(void);
+
 // Process incoming/outgoing data (call regularly from main loop)
-// This handles the protocol layer and dispatches RX callbacks
+// This handles the protocol layer and dispatches RX callbacks.  Each call
+// parses at most BUS_TASK_RX_BUDGET bytes, so bus_idle() may still be
+// false when it returns.
 void bus_task(void);
 
+// Returns true when bus_task() has nothing left to do until the next bus
+// event (no unparsed RX bytes, pending read or stageable response).
+bool bus_idle(void);
+
+#if BRIDGE_EVENT_LOOP
+// Arm the one-shot PIO RX FIFO IRQ that wakes the core from __wfe() on the
+// next 6502 write.  Call right before sleeping.
+void bus_arm_wakeup(void);
+#endif
+
 // Write data to a device buffer (for CPU to read)
 // Returns number of bytes actually written
 uint16_t bus_device_write(uint8_t device, const uint8_t *data, uint16_t len);
 
+// One TLV for bus_device_writev()
+typedef struct {
+    const uint8_t *data;
+    uint8_t device;
+    uint8_t len;
+} bus_tlv_t;
+
+// Write a batch of TLVs to their device buffers in one pass.  Per device
+// it is all or nothing: if a device's TLVs don't all fit, none of them
+// are written.  Returns a bitmask of the devices whose TLVs were dropped.
+uint8_t bus_device_writev(const bus_tlv_t *tlvs, uint count);
+
+// Decompress |src|, whole LZ4-style sequences (binary_format.md), into a
+// device buffer: exactly |out_len| bytes, or nothing if they don't fit or
+// |src| doesn't decode to them.  Matches reach back through the bytes
+// already in the ring, read or not, so they may go back up to the buffer
+// size.  Returns false when the bytes were dropped.
+bool bus_device_write_lz(uint8_t device, const uint8_t *src, uint16_t src_len,
+                         uint16_t out_len);
+
+// Copy the last |len| bytes written to a device buffer, read or not, ending
+// at its write position.
+void bus_device_copy_last(uint8_t device, uint8_t *dst, uint16_t len);
+
 // Clear a device's TX buffer
 void bus_device_clear(uint8_t device);
 
+// Cap the data bytes one read of a buffered device, or one BUS_READ_ANY
+// response, returns (0 = the default 254), so an interrupt handler can
+// drain into a small ring.  Callback devices (Device 0) are not affected.
+void bus_set_read_limit(uint8_t max_len);
+
+// Echo writes to the devices in |mask| (bit n = device n) straight into
+// their own TX buffers, in place of their RX callbacks, so the 6502 can
+// time the bus alone.  0 turns it off.
+void bus_set_loopback(uint8_t mask);
+
+// Set the PIO delay (0-31 cycles) between PHI2 rising and the bus being
+// sampled.  Safe while running: the state machine picks it up on its next
+// bus cycle.
+void bus_set_sample_delay(uint cycles);
+
+#if BRIDGE_STATUS_PORT
+// Set the byte the status port answers with (bit n = device n has data).
+// Cheap when unchanged, so it can be called every loop.
+void bus_set_status(uint8_t status);
+#endif
+
+#if BRIDGE_BUS_CAPTURE
+// Start (from its first instruction, with an empty FIFO) or stop the
+// bus_capture state machine.
+void bus_capture_enable(bool enable);
+
+// The bus_capture RX FIFO, for a DMA channel to read from, and its DREQ.
+const volatile void *bus_capture_fifo(uint *dreq);
+
+// True while a read request waits for its response (the 6502 is polling
+// 0xFF), with the time_us_32() it was parsed at in |since_us|.
+bool bus_read_pending(uint32_t *since_us);
+#endif
+
 // Returns the number of bytes in a device's TX buffer
 uint16_t bus_device_tx_count(uint8_t device);
 
 // Returns the free space in a device's TX buffer (bytes)
 uint16_t bus_device_tx_free(uint8_t device);
 
+// Returns a free-running (wrapping) count of the bytes that have left a
+// device's TX buffer or were dropped instead of entering it: the credits
+// behind protocol v5 flow control.  Safe to read from the other core.
+uint16_t bus_device_tx_freed(uint8_t device);
+
 // Get statistics
 typedef struct {
     uint32_t rx_bytes;          // Total bytes received from CPU
     uint32_t tx_bytes;          // Total bytes sent to CPU
     uint32_t rx_dma_overruns;   // DMA overruns (data lost before processing)
     uint32_t rx_bankruptcies;   // DMA overruns during callback (data may be corrupt)
+    uint32_t rx_bytes_lost;     // Unparsed bytes dropped by resyncs
     uint32_t tx_empty_reads;    // Read requests served with len=0
+    ring_stats_t rx_ring;       // DMA RX ring: unparsed bytes
+    ring_stats_t tx_buffers[BUS_MAX_DEVICES];   // Per-device TX buffer fill
 } bus_stats_t;
 
 bus_stats_t bus_get_stats(void);
 void bus_clear_stats(void);
 
+// Snapshot of the PIO state machine and protocol state
+typedef struct {
+    uint8_t pc;             // PIO program counter
+    uint8_t tx_fifo;        // PIO TX FIFO level (words)
+    uint8_t rx_fifo;        // PIO RX FIFO level (words)
+    uint8_t proto_state;    // Bus protocol state (idle/device/receiving/sending)
+} bus_diag_t;
+
+bus_diag_t bus_get_diag(void);
+
 // Print PIO/DMA/protocol diagnostic state (call from stats block)
 void bus_diagnose(void);
 
@@ -0,0 +1,188 @@
+/*
+ * 6502 bus logic analyzer.  See capture.h.
+ *
+ * The DMA channel has no IRQ to spare for counting wraps, so it runs in
+ * normal mode with the longest count there is and the ring wrapping its
+ * write address; the words written so far are the count it started with
+ * less what is left.  A run nearing its end is restarted where it got
+ * to, as is the trigger, which restarts it for the post-trigger words
+ * only, so the channel stops itself with the capture complete.  The RX
+ * FIFO holds the samples that arrive while the channel is reprogrammed.
+ */
+
+#include "capture.h"
+
+#if BRIDGE_BUS_CAPTURE
+
+#include "bus_interface.h"
+#include "hardware/dma.h"
+#include "pico/stdlib.h"
+
+#define RING_WORDS      (CAP_SAMPLES / 2)
+#define RUN_WORDS       DMA_TRANS_COUNT_COUNT_MASK     // Normal mode's longest count
+#define CHUNK_SAMPLES   ((CAP_REPORT_MAX - 4) / 2)
+
+typedef enum {
+    CAP_IDLE,
+    CAP_ARMED,      // Ring running, waiting for the trigger
+    CAP_POST,       // Triggered; the channel stops once the ring is filled out
+    CAP_UPLOAD,     // Finished, going to the Zero
+} cap_state_t;
+
+// Two samples a word, the earlier in the low half
+static uint32_t __attribute__((aligned(1u << CAP_RING_BITS))) ring[RING_WORDS];
+static int dma_chan = -1;
+static uint dreq;
+static const volatile void *fifo;
+
+static cap_state_t state = CAP_IDLE;
+static uint8_t trigger;
+static uint16_t trigger_arg;
+uint16_t cap_trigger_byte = 0x100;
+
+static uint32_t run_words;      // Count the current run started with
+static uint32_t done_words;     // Words written by earlier runs since arming
+static uint32_t trigger_words;  // Words written when the trigger fired
+
+// The capture, once finished, in samples
+static uint first;              // Ring index of the oldest
+static uint16_t count;
+static uint16_t trigger_index;  // Of the first sample after the trigger
+static bool header_sent;
+static uint16_t sent;
+
+static uint32_t words_written(void) {
+    uint32_t left = dma_channel_hw_addr(dma_chan)->transfer_count &
+                    DMA_TRANS_COUNT_COUNT_MASK;
+    return done_words + run_words - left;
+}
+
+// Program a run of |words| from |dst| in the ring, and start it.
+static void start_run(uint32_t *dst, uint32_t words) {
+    dma_channel_config c = dma_channel_get_default_config(dma_chan);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, true);
+    channel_config_set_ring(&c, true, CAP_RING_BITS);
+    channel_config_set_dreq(&c, dreq);
+    dma_channel_configure(dma_chan, &c, dst, fifo, words, true);
+    run_words = words;
+}
+
+// Stop the run under way and start another of |words| where it got to.
+static void restart_run(uint32_t words) {
+    dma_channel_abort(dma_chan);
+    done_words = words_written();
+    uint32_t write_addr = dma_channel_hw_addr(dma_chan)->write_addr;
+    start_run((uint32_t *)write_addr, words);
+}
+
+static void stop(void) {
+    if (state == CAP_ARMED || state == CAP_POST) {
+        dma_channel_abort(dma_chan);
+        bus_capture_enable(false);
+    }
+    cap_trigger_byte = 0x100;
+    state = CAP_IDLE;
+}
+
+void cap_init(void) {
+    dma_chan = dma_claim_unused_channel(true);
+    fifo = bus_capture_fifo(&dreq);
+}
+
+void cap_arm(uint8_t trig, uint16_t arg) {
+    stop();
+    if (trig > CAP_TRIGGER_STALL) return;
+
+    trigger = trig;
+    trigger_arg = arg;
+    done_words = 0;
+    bus_capture_enable(true);
+    if (trig == CAP_TRIGGER_NOW) {
+        trigger_words = 0;
+        start_run(ring, RING_WORDS);
+        state = CAP_POST;
+        return;
+    }
+    start_run(ring, RUN_WORDS);
+    if (trig == CAP_TRIGGER_BYTE) cap_trigger_byte = arg & 0xFF;
+    state = CAP_ARMED;
+}
+
+void cap_trigger(void) {
+    if (state != CAP_ARMED) return;
+    cap_trigger_byte = 0x100;
+    restart_run(RING_WORDS / 2);
+    trigger_words = done_words;
+    state = CAP_POST;
+}
+
+// The channel has stopped: work out where the capture is in the ring.
+static void finish(void) {
+    bus_capture_enable(false);
+    uint32_t total = done_words + run_words;
+    uint32_t words = total < RING_WORDS ? total : RING_WORDS;
+    uint32_t write_addr = dma_channel_hw_addr(dma_chan)->write_addr;
+    uint end = (write_addr - (uint32_t)ring) / 4;
+    first = 2 * ((end - words) & (RING_WORDS - 1));
+    count = (uint16_t)(2 * words);
+    trigger_index = (uint16_t)(count - 2 * (total - trigger_words));
+    header_sent = false;
+    sent = 0;
+    state = CAP_UPLOAD;
+}
+
+void cap_task(void) {
+    if (state == CAP_ARMED) {
+        uint32_t since;
+        if (trigger == CAP_TRIGGER_STALL && bus_read_pending(&since) &&
+            time_us_32() - since >= trigger_arg) {
+            cap_trigger();
+        } else if ((dma_channel_hw_addr(dma_chan)->transfer_count &
+                    DMA_TRANS_COUNT_COUNT_MASK) < RING_WORDS) {
+            // The run is nearly out.  Before the trigger all that matters
+            // is whether the ring has filled, so the count stops there.
+            restart_run(RUN_WORDS);
+            if (done_words > RING_WORDS) done_words = RING_WORDS;
+        }
+    }
+    if (state == CAP_POST && !dma_channel_is_busy(dma_chan)) finish();
+}
+
+static uint8_t *put_u16(uint8_t *p, uint16_t v) {
+    *p++ = (uint8_t)v;
+    *p++ = (uint8_t)(v >> 8);
+    return p;
+}
+
+uint cap_report(uint8_t *msg, uint16_t clk_khz) {
+    if (state != CAP_UPLOAD) return 0;
+    uint8_t *p = msg;
+    *p++ = 'B';
+    if (!header_sent) {
+        // ['B', 'H', trigger, samples LE16, trigger index LE16, kHz LE16]
+        *p++ = 'H';
+        *p++ = trigger;
+        p = put_u16(p, count);
+        p = put_u16(p, trigger_index);
+        p = put_u16(p, clk_khz);
+        header_sent = true;
+        return p - msg;
+    }
+
+    // ['B', 'D', first sample LE16, samples LE16...]
+    const uint16_t *samples = (const uint16_t *)ring;
+    *p++ = 'D';
+    p = put_u16(p, sent);
+    uint n = count - sent;
+    if (n > CHUNK_SAMPLES) n = CHUNK_SAMPLES;
+    for (uint i = 0; i < n; i++) {
+        p = put_u16(p, samples[(first + sent + i) & (CAP_SAMPLES - 1)]);
+    }
+    sent += n;
+    if (sent == count) state = CAP_IDLE;
+    return p - msg;
+}
+
+#endif
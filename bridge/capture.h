@@ -0,0 +1,66 @@
+/*
+ * 6502 bus logic analyzer (BRIDGE_BUS_CAPTURE builds only).
+ *
+ * The bus_capture state machine samples GPIO 0-15 once per 6502 cycle
+ * and a DMA channel writes the samples round a CAP_SAMPLES ring.  Armed
+ * from the Zero, the ring runs until the trigger, then for half a ring
+ * more, so a capture holds the cycles either side of it:
+ *
+ *   CAP_TRIGGER_NOW    at once; the whole capture follows it
+ *   CAP_TRIGGER_BYTE   a transaction start byte (device, | 0x80 for a
+ *                      read) equal to the argument
+ *   CAP_TRIGGER_STALL  a read request left unanswered, with the 6502
+ *                      polling 0xFF, for the argument in microseconds
+ *
+ * A byte trigger fires when the parser reaches the byte, a stall when the
+ * main loop notices it, so the trigger sample is up to a few hundred
+ * cycles after the event.  The finished capture goes to the Zero oldest
+ * sample first, a header then the samples, from cap_report().
+ *
+ * Everything here runs on core 0.
+ */
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "bridge_defs.h"
+#include "pico/types.h"
+
+#define CAP_RING_BITS   14                          // 16 KB of samples
+#define CAP_SAMPLES     ((1u << CAP_RING_BITS) / 2)
+
+enum {
+    CAP_TRIGGER_NOW,
+    CAP_TRIGGER_BYTE,
+    CAP_TRIGGER_STALL,
+};
+
+// Longest TLV cap_report() builds.
+#define CAP_REPORT_MAX  (4 + 2 * 120)
+
+// The start byte CAP_TRIGGER_BYTE waits for, or 0x100 (no byte matches).
+// bus_interface.c compares every transaction start byte with it.
+extern uint16_t cap_trigger_byte;
+
+// Claim the DMA channel.  Call once, after bus_init().
+void cap_init(void);
+
+// Device 0 ['B', trigger, arg LE16] from the Zero: start a capture, or
+// with any other trigger drop the one under way.
+void cap_arm(uint8_t trigger, uint16_t arg);
+
+// Fire the armed trigger.
+void cap_trigger(void);
+
+// Main loop: check for a stall and for the end of the capture.
+void cap_task(void);
+
+// The next TLV of a finished capture, for Device 1, into |msg| (at least
+// CAP_REPORT_MAX bytes); |clk_khz| is the 6502 clock.  Returns its length,
+// or 0 with nothing to send.
+uint cap_report(uint8_t *msg, uint16_t clk_khz);
+
+#endif // CAPTURE_H
@@ -0,0 +1,94 @@
+/*
+ * Timestamped bridge events.  See events.h.
+ */
+
+#include "events.h"
+
+#if BRIDGE_EVENT_TRACE
+
+#define EVT_BATCH       30          // Events per TLV
+#define EVT_FLUSH_US    20000       // Longest an event waits for a full batch
+
+_Static_assert(3 + 8 * EVT_BATCH == EVT_REPORT_MAX, "EVT_REPORT_MAX is one batch");
+
+evt_ring_t evt_bus, evt_spi;
+volatile bool evt_enabled = false;
+
+// Each ring's dropped count as of the last batch.
+static uint32_t bus_dropped_sent, spi_dropped_sent;
+
+static void evt_drop_all(evt_ring_t *r, uint32_t *dropped_sent) {
+    r->tail = r->head;
+    *dropped_sent = r->dropped;
+}
+
+void evt_enable(bool on) {
+    evt_enabled = false;
+    __dmb();
+    evt_drop_all(&evt_bus, &bus_dropped_sent);
+    evt_drop_all(&evt_spi, &spi_dropped_sent);
+    __dmb();
+    evt_enabled = on;
+}
+
+static uint8_t *put_u16(uint8_t *p, uint16_t v) {
+    *p++ = (uint8_t)v;
+    *p++ = (uint8_t)(v >> 8);
+    return p;
+}
+
+static uint8_t *put_u32(uint8_t *p, uint32_t v) {
+    p = put_u16(p, (uint16_t)v);
+    return put_u16(p, (uint16_t)(v >> 16));
+}
+
+// Move up to |room| events from |r| to |p|.
+static uint8_t *take(evt_ring_t *r, uint8_t *p, uint *room) {
+    while (*room && r->tail != r->head) {
+        __dmb();
+        const evt_t *e = &r->events[r->tail & (EVT_RING - 1)];
+        p = put_u32(p, e->us);
+        *p++ = e->kind;
+        *p++ = e->device;
+        p = put_u16(p, e->arg);
+        __dmb();
+        r->tail++;
+        (*room)--;
+    }
+    return p;
+}
+
+// When the oldest waiting event of |r| was recorded, if there is one.
+static bool oldest(const evt_ring_t *r, uint32_t *us) {
+    if (r->tail == r->head) return false;
+    __dmb();
+    *us = r->events[r->tail & (EVT_RING - 1)].us;
+    return true;
+}
+
+uint evt_report(uint8_t *msg) {
+    uint32_t waiting = (evt_bus.head - evt_bus.tail) + (evt_spi.head - evt_spi.tail);
+    if (waiting == 0) return 0;
+    if (waiting < EVT_BATCH) {
+        uint32_t now = time_us_32(), us;
+        bool due = (oldest(&evt_bus, &us) && now - us >= EVT_FLUSH_US) ||
+                   (oldest(&evt_spi, &us) && now - us >= EVT_FLUSH_US);
+        if (!due) return 0;
+    }
+
+    // ['T', events dropped since the last batch LE16, events...]
+    uint32_t bus_dropped = evt_bus.dropped, spi_dropped = evt_spi.dropped;
+    uint32_t dropped = (bus_dropped - bus_dropped_sent) + (spi_dropped - spi_dropped_sent);
+    bus_dropped_sent = bus_dropped;
+    spi_dropped_sent = spi_dropped;
+
+    uint8_t *p = msg;
+    *p++ = 'T';
+    p = put_u16(p, dropped > 0xFFFF ? 0xFFFF : (uint16_t)dropped);
+    uint room = EVT_BATCH;
+    p = take(&evt_bus, p, &room);
+    p = take(&evt_spi, p, &room);
+    return p - msg;
+}
+
+#endif
@@ -0,0 +1,90 @@
+/*
+ * Timestamped bridge events for end-to-end traces (BRIDGE_EVENT_TRACE
+ * builds only).
+ *
+ * The bus and SPI drivers note what they do as it happens, stamped with
+ * time_us_32(), into one ring each: the bus ring is only written from the
+ * bus core, the SPI ring from core 0's task and CS-edge IRQ.  Recording
+ * is off until the Zero turns it on with a Device 0 ['T', 1], and then
+ * the main loop sends the events to the Zero in batches, as Device 1
+ * ['T'] TLVs (protocol.md, "Trace events").  A full ring drops events
+ * and counts them; it never delays the data path.
+ *
+ * The Zero notes its own SPI transactions in its clock.  Each side's
+ * EVT_SPI_READ marks the end of the same READ, which is what lines the
+ * two clocks up when the traces are merged.
+ */
+
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "bridge_defs.h"
+#include "hardware/sync.h"
+#include "pico/time.h"
+
+// The values travel in the TLVs, so only ever append.
+typedef enum {
+    EVT_BUS_READ,       // 6502 read request parsed (arg: 0)
+    EVT_BUS_RESPONSE,   // Its response started out (arg: data length)
+    EVT_BUS_WRITE,      // 6502 TLV received in full (arg: data length)
+    EVT_SPI_WRITE,      // Zero WRITE parsed (device 0xFF, arg: payload length)
+    EVT_SPI_REQUEST,    // Zero REQUEST parsed (device 0xFF)
+    EVT_SPI_READ,       // READ clocked out (device 0xFF, arg: its LEN)
+} evt_kind_t;
+
+#define EVT_RING        256     // Per ring, must be a power of two
+
+_Static_assert((EVT_RING & (EVT_RING - 1)) == 0,
+               "EVT_RING must be a power of two");
+
+typedef struct {
+    uint32_t us;
+    uint8_t kind;
+    uint8_t device;
+    uint16_t arg;
+} evt_t;
+
+typedef struct {
+    evt_t events[EVT_RING];
+    volatile uint32_t head;     // Written by producer only
+    volatile uint32_t tail;     // Written by consumer only
+    volatile uint32_t dropped;  // Written by producer only
+} evt_ring_t;
+
+extern evt_ring_t evt_bus, evt_spi;
+extern volatile bool evt_enabled;
+
+// Longest TLV evt_report() builds.
+#define EVT_REPORT_MAX  (3 + 8 * 30)
+
+static inline void evt_record(evt_ring_t *r, evt_kind_t kind, uint8_t device,
+                              uint16_t arg) {
+    if (!evt_enabled) return;
+    uint32_t saved = save_and_disable_interrupts();
+    if (r->head - r->tail >= EVT_RING) {
+        r->dropped++;
+    } else {
+        evt_t *e = &r->events[r->head & (EVT_RING - 1)];
+        e->us = time_us_32();
+        e->kind = (uint8_t)kind;
+        e->device = device;
+        e->arg = arg;
+        __dmb();
+        r->head++;
+    }
+    restore_interrupts(saved);
+}
+
+// Device 0 ['T', on] from the Zero: start or stop recording.  Starting
+// drops anything left from before.
+void evt_enable(bool on);
+
+// Main loop: the next batch for Device 1, into |msg| (at least
+// EVT_REPORT_MAX bytes), once enough events are waiting or the oldest has
+// waited long enough.  Returns its length, or 0 with nothing to send.
+uint evt_report(uint8_t *msg);
+
+#endif // EVENTS_H
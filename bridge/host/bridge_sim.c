@@ -0,0 +1,1139 @@
+/*
+ * Host simulation of the bridge firmware, for benchmarking.
+ *
+ * Runs bus_interface.c and spi_slave.c unmodified on the peripherals of
+ * sim_hw.c, glued together the way main.c's single-core build does it,
+ * with a scripted 6502 on one side and a scripted Zero on the other:
+ *
+ *   6502:  io_write(), io_read(), io_read_any() and io_read_block() as
+ *          bridge_io.S runs them, one bus cycle per bridge access, timed
+ *          in 6502 clock cycles.
+ *   Zero:  shein's spi_master.rs: SET_VERSION, batched WRITEs that respect
+ *          the BUF / credit flow control, REQUEST, polling READY, READ
+ *          (and NAK on a bad v6 CRC).  Each SPI byte is one event; every
+ *          transaction first pays a fixed syscall overhead.
+ *   Pico:  bus_task() and spi_slave_task() once every --loop-ns.
+ *
+ * All time is simulated except the host cost of the firmware loop, which
+ * is measured and reported per iteration.
+ *
+ * Traffic comes from a trace (see usage()), or a built-in script when none
+ * is given.  Payloads are a per-device byte pattern, checked on arrival;
+ * latency is from the moment a message exists (6502: its io_write()
+ * returns; Zero: its trace line fires) to the moment its last byte reaches
+ * the other side.
+ */
+
+#include "bus_interface.h"
+#include "spi_slave.h"
+#include "sim_hw.h"
+#if BRIDGE_EVENT_TRACE
+#include "events.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// 6502 cycles per bridge access in bridge_io.S's unrolled loops
+#define CPU_CALL_CYCLES     20      // jsr, php/sei, first stores
+#define CPU_WRITE_CYCLES    11      // lda (zp),y / sta abs / iny
+#define CPU_READ_CYCLES     12      // lda abs / sta (zp),y / iny
+#define CPU_POLL_CYCLES     9       // lda abs / cmp #$ff / beq
+
+#define ZERO_READY_TIMEOUT_US   100000  // shein's REQUEST -> READY timeout
+#define ZERO_READ_RETRIES       3       // v6 NAKs before giving up on a frame
+#define DRAIN_NS                100000000ull    // Stop after 100 ms of nothing
+
+// ============================================================================
+// Options
+// ============================================================================
+
+static struct {
+    uint proto;
+    double cpu_mhz;
+    uint32_t spi_hz;
+    uint32_t loop_ns;
+    uint32_t zero_gap_us;
+    uint32_t ready_poll_us;
+    uint32_t zero_poll_us;
+} opt = {
+    .proto = SPI_PROTO_MAX,
+    .cpu_mhz = 1.0,
+    .spi_hz = 8000000,
+    .loop_ns = 1000,
+    .zero_gap_us = 20,
+    .ready_poll_us = 100,
+    .zero_poll_us = 1000,
+};
+
+static uint64_t cpu_ns(uint cycles) {
+    return (uint64_t)(cycles * 1000.0 / opt.cpu_mhz + 0.5);
+}
+
+// ============================================================================
+// Script
+// ============================================================================
+
+typedef enum {
+    OP_WRITE,       // cpu write <dev> <len>
+    OP_READ,        // cpu read <dev>
+    OP_READ_ANY,    // cpu readany <mask>
+    OP_BLOCK,       // cpu block <dev> <len>
+    OP_ZERO_WRITE,  // zero write <dev> <len>
+} op_kind_t;
+
+typedef struct {
+    uint64_t at_ns;
+    size_t order;   // Line order, to keep the sort stable
+    op_kind_t kind;
+    uint8_t arg;
+    uint8_t len;
+} op_t;
+
+typedef struct {
+    op_t *v;
+    size_t len;
+    size_t cap;
+    size_t next;
+} op_list_t;
+
+static op_list_t cpu_ops;
+static op_list_t zero_ops;
+static uint64_t script_end_ns;      // 0: run until drained
+static uint64_t script_last_ns;
+
+static const char default_script[] =
+    "# Netboot-style download: 32 KB to device 3, read in exact blocks\n"
+    "0       zero write 3 254 128 0\n"
+    "0       cpu  block 3 254 128 0\n"
+    "# 6502 output: 200 lines of 40 bytes on the terminal\n"
+    "500000  cpu  write 2 40 200 0\n"
+    "# Interactive: a keystroke every 5 ms, the 6502 polling every 1 ms\n"
+    "700000  zero write 2 1 100 5000\n"
+    "700000  cpu  read 2 500 1000\n"
+    "# Echo: 6502 -> Zero -> 6502 sized packets on device 7\n"
+    "1200000 cpu  write 7 64 100 2000\n"
+    "1200000 zero write 7 64 100 2000\n"
+    "1200000 cpu  readany 0x80 100 2000\n";
+
+static void op_push(op_list_t *l, op_t op) {
+    if (l->len == l->cap) {
+        l->cap = l->cap ? 2 * l->cap : 256;
+        l->v = realloc(l->v, l->cap * sizeof(op_t));
+        if (!l->v) abort();
+    }
+    op.order = l->len;
+    l->v[l->len++] = op;
+}
+
+static int op_cmp(const void *a, const void *b) {
+    const op_t *x = a, *y = b;
+    if (x->at_ns != y->at_ns) return x->at_ns < y->at_ns ? -1 : 1;
+    return x->order < y->order ? -1 : (x->order > y->order);
+}
+
+static uint parse_num(const char *s, uint max, const char *what, int line) {
+    char *end;
+    unsigned long v = strtoul(s ? s : "", &end, 0);
+    if (!s || *end || v > max) {
+        fprintf(stderr, "trace line %d: bad %s '%s'\n", line, what, s ? s : "");
+        exit(2);
+    }
+    return (uint)v;
+}
+
+// One line: <time_us> cpu|zero <op> <args> [count [interval_us]], or
+// <time_us> end.
+static void parse_line(char *text, int line) {
+    char *hash = strchr(text, '#');
+    if (hash) *hash = '\0';
+    char *tok[8];
+    int n = 0;
+    for (char *t = strtok(text, " \t\r\n"); t && n < 8; t = strtok(NULL, " \t\r\n")) {
+        tok[n++] = t;
+    }
+    if (n == 0) return;
+    for (int i = n; i < 8; i++) tok[i] = NULL;
+
+    uint64_t at = (uint64_t)parse_num(tok[0], 0xFFFFFFFFu, "time", line) * 1000;
+    if (n == 2 && strcmp(tok[1], "end") == 0) {
+        script_end_ns = at;
+        return;
+    }
+    if (n < 3) {
+        fprintf(stderr, "trace line %d: expected <time_us> cpu|zero <op> ...\n", line);
+        exit(2);
+    }
+
+    op_t op = { .at_ns = at };
+    op_list_t *list = &cpu_ops;
+    int args;
+    if (strcmp(tok[1], "zero") == 0 && strcmp(tok[2], "write") == 0) {
+        list = &zero_ops;
+        op.kind = OP_ZERO_WRITE;
+        args = 2;
+    } else if (strcmp(tok[1], "cpu") != 0) {
+        fprintf(stderr, "trace line %d: unknown actor '%s'\n", line, tok[1]);
+        exit(2);
+    } else if (strcmp(tok[2], "write") == 0) {
+        op.kind = OP_WRITE;
+        args = 2;
+    } else if (strcmp(tok[2], "read") == 0) {
+        op.kind = OP_READ;
+        args = 1;
+    } else if (strcmp(tok[2], "readany") == 0) {
+        op.kind = OP_READ_ANY;
+        args = 1;
+    } else if (strcmp(tok[2], "block") == 0) {
+        op.kind = OP_BLOCK;
+        args = 2;
+    } else {
+        fprintf(stderr, "trace line %d: unknown op '%s'\n", line, tok[2]);
+        exit(2);
+    }
+
+    if (op.kind == OP_READ_ANY) {
+        op.arg = (uint8_t)parse_num(tok[3], 0xFF, "mask", line);
+    } else {
+        op.arg = (uint8_t)parse_num(tok[3], BUS_MAX_DEVICES - 1, "device", line);
+        if (op.arg < 2) {
+            fprintf(stderr, "trace line %d: devices 0 and 1 are the bridge's own\n", line);
+            exit(2);
+        }
+    }
+    if (args == 2) {
+        op.len = (uint8_t)parse_num(tok[4], 255, "length", line);
+        if (op.len == 0 || (op.kind == OP_BLOCK && op.len > 254)) {
+            fprintf(stderr, "trace line %d: bad length %u\n", line, op.len);
+            exit(2);
+        }
+    }
+    uint count = tok[3 + args] ? parse_num(tok[3 + args], 1000000, "count", line) : 1;
+    uint64_t interval = tok[4 + args]
+        ? (uint64_t)parse_num(tok[4 + args], 0xFFFFFFFFu, "interval", line) * 1000 : 0;
+
+    for (uint i = 0; i < count; i++) {
+        op_push(list, op);
+        if (op.at_ns > script_last_ns) script_last_ns = op.at_ns;
+        op.at_ns += interval;
+    }
+}
+
+static void load_script(const char *path) {
+    char *text;
+    if (path) {
+        FILE *f = fopen(path, "r");
+        if (!f) {
+            perror(path);
+            exit(2);
+        }
+        fseek(f, 0, SEEK_END);
+        long size = ftell(f);
+        rewind(f);
+        text = malloc((size_t)size + 1);
+        if (!text || fread(text, 1, (size_t)size, f) != (size_t)size) abort();
+        text[size] = '\0';
+        fclose(f);
+    } else {
+        text = strdup(default_script);
+    }
+
+    int line = 1;
+    for (char *p = text; *p; line++) {
+        char *nl = strchr(p, '\n');
+        if (nl) *nl = '\0';
+        parse_line(p, line);
+        if (!nl) break;
+        p = nl + 1;
+    }
+    free(text);
+
+    qsort(cpu_ops.v, cpu_ops.len, sizeof(op_t), op_cmp);
+    qsort(zero_ops.v, zero_ops.len, sizeof(op_t), op_cmp);
+}
+
+// ============================================================================
+// Streams: per-device byte pattern, integrity and latency
+// ============================================================================
+
+typedef struct {
+    uint64_t end;       // Stream offset just past the message
+    uint64_t at_ns;     // When it was sent
+} mark_t;
+
+typedef struct {
+    uint64_t *v;
+    size_t len;
+    size_t cap;
+} samples_t;
+
+typedef struct {
+    const char *name;
+    uint64_t sent[BUS_MAX_DEVICES];     // Bytes produced
+    uint64_t got[BUS_MAX_DEVICES];      // Bytes delivered
+    uint64_t drops[BUS_MAX_DEVICES];    // Bytes the bridge dropped
+    mark_t *marks[BUS_MAX_DEVICES];
+    size_t mark_head[BUS_MAX_DEVICES];
+    size_t mark_len[BUS_MAX_DEVICES];
+    size_t mark_cap[BUS_MAX_DEVICES];
+    samples_t latency;
+    samples_t dev_latency[BUS_MAX_DEVICES];
+    uint64_t msgs;
+    uint64_t errors;
+    uint64_t first_ns;
+    uint64_t last_ns;
+} stream_t;
+
+static stream_t up = { .name = "6502 -> Zero" };
+static stream_t down = { .name = "Zero -> 6502" };
+static samples_t read_latency;      // 6502 read command -> length byte
+static uint64_t read_polls;
+static uint64_t empty_reads;
+static uint64_t last_activity_ns;
+
+static void sample_push(samples_t *s, uint64_t v) {
+    if (s->len == s->cap) {
+        s->cap = s->cap ? 2 * s->cap : 1024;
+        s->v = realloc(s->v, s->cap * sizeof(uint64_t));
+        if (!s->v) abort();
+    }
+    s->v[s->len++] = v;
+}
+
+static inline uint8_t pattern(uint8_t device, uint64_t offset) {
+    return (uint8_t)(offset * 31 + (offset >> 8) + device * 67);
+}
+
+// A message of |len| bytes for |device| exists as of |at_ns|.
+static void stream_send(stream_t *s, uint8_t device, uint len, uint64_t at_ns) {
+    if (s->mark_len[device] == s->mark_cap[device]) {
+        size_t cap = s->mark_cap[device] ? 2 * s->mark_cap[device] : 256;
+        mark_t *m = malloc(cap * sizeof(mark_t));
+        if (!m) abort();
+        for (size_t i = 0; i < s->mark_len[device]; i++) {
+            m[i] = s->marks[device][(s->mark_head[device] + i) % s->mark_cap[device]];
+        }
+        free(s->marks[device]);
+        s->marks[device] = m;
+        s->mark_head[device] = 0;
+        s->mark_cap[device] = cap;
+    }
+    s->sent[device] += len;
+    size_t at = (s->mark_head[device] + s->mark_len[device]) % s->mark_cap[device];
+    s->marks[device][at] = (mark_t){ s->sent[device], at_ns };
+    s->mark_len[device]++;
+    if (s->msgs++ == 0) s->first_ns = at_ns;
+}
+
+// |len| bytes of |device| arrived at the other end.
+static void stream_receive(stream_t *s, uint8_t device, const uint8_t *data, uint len) {
+    uint64_t now = sim_now_ns();
+    // After a drop the pattern offsets no longer line up; count the bytes.
+    if (s->drops[device] == 0) {
+        for (uint i = 0; i < len; i++) {
+            if (data[i] != pattern(device, s->got[device] + i)) s->errors++;
+        }
+    }
+    s->got[device] += len;
+    // More than was sent means something arrived twice.
+    if (s->got[device] + s->drops[device] > s->sent[device]) {
+        s->errors += (s->got[device] + s->drops[device] - s->sent[device]);
+        s->got[device] = s->sent[device] - s->drops[device];
+    }
+    while (s->mark_len[device] > 0) {
+        mark_t *m = &s->marks[device][s->mark_head[device]];
+        if (m->end > s->got[device] + s->drops[device]) break;
+        sample_push(&s->latency, now - m->at_ns);
+        sample_push(&s->dev_latency[device], now - m->at_ns);
+        s->mark_head[device] = (s->mark_head[device] + 1) % s->mark_cap[device];
+        s->mark_len[device]--;
+    }
+    s->last_ns = now;
+    last_activity_ns = now;
+}
+
+static bool stream_drained(const stream_t *s) {
+    for (uint d = 0; d < BUS_MAX_DEVICES; d++) {
+        if (s->got[d] + s->drops[d] != s->sent[d]) return false;
+    }
+    return true;
+}
+
+// ============================================================================
+// Firmware glue (main.c, single core)
+// ============================================================================
+
+// Most TLVs one WRITE payload can carry (each is at least 3 bytes)
+#define SPI_TLV_BATCH   (SPI_SLAVE_MAX_PAYLOAD / 3)
+
+static uint32_t bus_rx_lost;
+static uint32_t spi_rx_lost;
+
+static void bus_to_spi_callback(uint8_t device, const uint8_t *data, uint16_t len) {
+    if (spi_slave_tx_queue_free(device) < len + 2u) {
+        up.drops[device] += len;
+        return;
+    }
+    spi_slave_tx_queue_tlv(device, data, (uint8_t)len);
+}
+
+static void spi_rx_callback(const uint8_t *data, uint16_t len) {
+    static bus_tlv_t batch[SPI_TLV_BATCH];
+    uint count = 0;
+    uint16_t pos = 0;
+    while (pos + 2 <= len) {
+        uint8_t device = data[pos];
+        uint8_t tlv_len = data[pos + 1];
+        if (pos + 2 + tlv_len > len) break;
+        if (device > 0 && device < BUS_MAX_DEVICES && tlv_len > 0) {
+            batch[count++] = (bus_tlv_t){ &data[pos + 2], device, tlv_len };
+        }
+        pos += 2 + tlv_len;
+    }
+    if (count == 0) return;
+    uint8_t dropped = bus_device_writev(batch, count);
+    for (uint i = 0; i < count; i++) {
+        if (dropped & (1u << batch[i].device)) down.drops[batch[i].device] += batch[i].len;
+    }
+}
+
+static void bus_rx_loss_callback(uint32_t bytes_lost, bool bankrupt) {
+    (void)bankrupt;
+    bus_rx_lost += bytes_lost;
+}
+
+static void spi_rx_loss_callback(uint32_t bytes_lost) {
+    spi_rx_lost += bytes_lost;
+}
+
+static void bridge_gpio_irq_callback(uint gpio, uint32_t events) {
+    spi_slave_gpio_irq(gpio, events);
+}
+
+static uint64_t fw_next_ns;
+static uint64_t fw_iterations;
+static uint64_t fw_host_ns;
+
+static uint64_t host_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void fw_init(void) {
+    if (!bus_init()) {
+        fprintf(stderr, "bus_init failed\n");
+        exit(1);
+    }
+    bus_set_rx_loss_callback(bus_rx_loss_callback);
+    for (uint8_t d = 2; d < BUS_MAX_DEVICES; d++) {
+        bus_register_rx_callback(d, bus_to_spi_callback);
+    }
+    bus_start();
+    gpio_set_irq_callback(bridge_gpio_irq_callback);
+
+    if (!spi_slave_init()) {
+        fprintf(stderr, "spi_slave_init failed\n");
+        exit(1);
+    }
+    spi_slave_set_rx_callback(spi_rx_callback);
+    spi_slave_set_rx_loss_callback(spi_rx_loss_callback);
+#if BRIDGE_EVENT_TRACE
+    evt_enable(true);
+#endif
+}
+
+#if BRIDGE_EVENT_TRACE
+// Batches main.c's send_events() would have sent; they aren't delivered.
+static uint32_t evt_batches, evt_events, evt_dropped;
+
+static void drain_events(void) {
+    uint8_t msg[EVT_REPORT_MAX];
+    uint len = evt_report(msg);
+    if (len == 0) return;
+    evt_batches++;
+    evt_events += (len - 3) / 8;
+    evt_dropped += msg[1] | msg[2] << 8;
+}
+#endif
+
+static void fw_step(void) {
+    uint64_t start = host_ns();
+    bus_task();
+    spi_slave_task();
+#if BRIDGE_EVENT_TRACE
+    drain_events();
+#endif
+    fw_host_ns += host_ns() - start;
+    fw_iterations++;
+    fw_next_ns += opt.loop_ns;
+}
+
+// ============================================================================
+// 6502
+// ============================================================================
+
+typedef enum { CPU_IDLE, CPU_WRITING, CPU_POLLING, CPU_READING } cpu_state_t;
+
+static struct {
+    cpu_state_t state;
+    uint64_t next_ns;
+    op_t op;
+    uint8_t out[2 + 255];
+    uint out_len;
+    uint out_pos;
+    uint8_t in[255];
+    uint in_len;
+    uint in_pos;
+    uint64_t read_start_ns;
+} cpu;
+
+static uint64_t cpu_next_ns(void) {
+    if (cpu.state != CPU_IDLE) return cpu.next_ns;
+    if (cpu_ops.next < cpu_ops.len) {
+        uint64_t at = cpu_ops.v[cpu_ops.next].at_ns;
+        return at > cpu.next_ns ? at : cpu.next_ns;
+    }
+    return UINT64_MAX;
+}
+
+static void cpu_start_op(void) {
+    cpu.op = cpu_ops.v[cpu_ops.next++];
+    const op_t *op = &cpu.op;
+    uint n = 0;
+    switch (op->kind) {
+        case OP_WRITE:
+            cpu.out[n++] = op->arg;
+            cpu.out[n++] = op->len;
+            for (uint i = 0; i < op->len; i++) {
+                cpu.out[n++] = pattern(op->arg, up.sent[op->arg] + i);
+            }
+            break;
+        case OP_READ:
+            cpu.out[n++] = 0x80 | op->arg;
+            break;
+        case OP_READ_ANY:
+            cpu.out[n++] = 0x80 | BUS_READ_ANY;
+            cpu.out[n++] = op->arg;
+            break;
+        case OP_BLOCK:
+            cpu.out[n++] = 0x80 | BUS_READ_BLOCK;
+            cpu.out[n++] = op->arg;
+            cpu.out[n++] = op->len;
+            break;
+        case OP_ZERO_WRITE:
+            break;
+    }
+    cpu.out_len = n;
+    cpu.out_pos = 0;
+    cpu.state = CPU_WRITING;
+    cpu.next_ns = sim_now_ns() + cpu_ns(CPU_CALL_CYCLES);
+}
+
+// The response is in: hand its data to the 6502 -> Zero stream checker.
+static void cpu_read_done(void) {
+    if (cpu.op.kind == OP_READ_ANY) {
+        uint pos = 0;
+        while (pos + 2 <= cpu.in_len) {
+            uint8_t device = cpu.in[pos];
+            uint8_t len = cpu.in[pos + 1];
+            if (device >= BUS_MAX_DEVICES || pos + 2 + len > cpu.in_len) {
+                down.errors++;
+                break;
+            }
+            stream_receive(&down, device, &cpu.in[pos + 2], len);
+            pos += 2 + len;
+        }
+    } else {
+        stream_receive(&down, cpu.op.arg, cpu.in, cpu.in_len);
+    }
+}
+
+static void cpu_step(void) {
+    uint64_t now = sim_now_ns();
+    switch (cpu.state) {
+        case CPU_IDLE:
+            cpu_start_op();
+            break;
+
+        case CPU_WRITING:
+            sim_bus_write(cpu.out[cpu.out_pos++]);
+            cpu.next_ns = now + cpu_ns(CPU_WRITE_CYCLES);
+            if (cpu.out_pos < cpu.out_len) break;
+            if (cpu.op.kind == OP_WRITE) {
+                stream_send(&up, cpu.op.arg, cpu.op.len, now);
+                cpu.state = CPU_IDLE;
+            } else {
+                cpu.state = CPU_POLLING;
+                cpu.read_start_ns = now;
+            }
+            break;
+
+        case CPU_POLLING: {
+            uint8_t len = sim_bus_read();
+            read_polls++;
+            if (len == 0xFF) {
+                cpu.next_ns = now + cpu_ns(CPU_POLL_CYCLES);
+                break;
+            }
+            sample_push(&read_latency, now - cpu.read_start_ns);
+            cpu.next_ns = now + cpu_ns(CPU_READ_CYCLES);
+            if (len == 0) {
+                empty_reads++;
+                cpu.state = CPU_IDLE;
+                break;
+            }
+            cpu.in_len = len;
+            cpu.in_pos = 0;
+            cpu.state = CPU_READING;
+            break;
+        }
+
+        case CPU_READING:
+            cpu.in[cpu.in_pos++] = sim_bus_read();
+            cpu.next_ns = now + cpu_ns(CPU_READ_CYCLES);
+            if (cpu.in_pos == cpu.in_len) {
+                cpu_read_done();
+                cpu.state = CPU_IDLE;
+            }
+            break;
+    }
+}
+
+// ============================================================================
+// Zero
+// ============================================================================
+
+typedef enum { ZERO_IDLE, ZERO_XFER, ZERO_WAIT_READY, ZERO_WAIT_UNREADY } zero_state_t;
+
+typedef struct {
+    uint8_t *v;
+    size_t head;
+    size_t len;
+    size_t cap;
+} len_queue_t;
+
+static struct {
+    zero_state_t state;
+    uint64_t next_ns;
+    uint8_t tx[SPI_SLAVE_READ_SIZE + SPI_SLAVE_CRC_SIZE];
+    uint8_t rx[SPI_SLAVE_READ_SIZE + SPI_SLAVE_CRC_SIZE];
+    uint xfer_len;
+    uint xfer_pos;
+    uint rx_at;             // Where in rx[] the transaction's MISO bytes go
+    void (*done)(void);
+    uint64_t deadline_ns;
+
+    uint version;
+    bool negotiated;
+    bool version_sent;
+    bool more;
+    uint retries;
+    uint8_t write_seq;
+    uint64_t last_request_ns;
+
+    len_queue_t pending[BUS_MAX_DEVICES];   // TLV lengths waiting to be sent
+    uint64_t built[BUS_MAX_DEVICES];        // Stream bytes put in WRITEs
+    int32_t buf[BUS_MAX_DEVICES];           // Free space the Zero believes in
+    uint16_t last_freed[BUS_MAX_DEVICES];
+    bool have_freed;
+
+    uint32_t writes;
+    uint32_t requests;
+    uint32_t reads;
+    uint32_t timeouts;
+    uint32_t crc_errors;
+    uint32_t naks_received;
+    uint32_t errors_reported;
+} zero;
+
+static uint64_t spi_byte_ns(void) {
+    return 8ull * 1000000000ull / opt.spi_hz;
+}
+
+static uint32_t crc32_ieee(const uint8_t *data, size_t len, uint32_t crc) {
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int b = 0; b < 8; b++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+        }
+    }
+    return crc;
+}
+
+static void len_queue_push(len_queue_t *q, uint8_t len) {
+    if (q->len == q->cap) {
+        size_t cap = q->cap ? 2 * q->cap : 256;
+        uint8_t *v = malloc(cap);
+        if (!v) abort();
+        for (size_t i = 0; i < q->len; i++) v[i] = q->v[(q->head + i) % q->cap];
+        free(q->v);
+        q->v = v;
+        q->head = 0;
+        q->cap = cap;
+    }
+    q->v[(q->head + q->len) % q->cap] = len;
+    q->len++;
+}
+
+static uint8_t len_queue_pop(len_queue_t *q) {
+    uint8_t len = q->v[q->head];
+    q->head = (q->head + 1) % q->cap;
+    q->len--;
+    return len;
+}
+
+static void zero_xfer(uint len, void (*done)(void)) {
+    zero.xfer_len = len;
+    zero.xfer_pos = 0;
+    zero.rx_at = 0;
+    zero.done = done;
+    zero.state = ZERO_XFER;
+    zero.next_ns = sim_now_ns() + opt.zero_gap_us * 1000ull;
+}
+
+static void zero_wait_ready(void) {
+    zero.state = ZERO_WAIT_READY;
+    zero.next_ns = sim_now_ns();
+    zero.deadline_ns = sim_now_ns() + ZERO_READY_TIMEOUT_US * 1000ull;
+}
+
+static bool zero_writes_pending(void) {
+    for (uint d = 0; d < BUS_MAX_DEVICES; d++) {
+        if (zero.pending[d].len) return true;
+    }
+    return false;
+}
+
+static uint read_hdr_size(void) {
+    return SPI_SLAVE_READ_HDR_SIZE + (zero.version >= SPI_PROTO_V6 ? SPI_SLAVE_CRC_SIZE : 0);
+}
+
+// Device 1 TLVs meant for the Zero itself.
+static void zero_system_tlv(const uint8_t *data, uint len) {
+    if (len >= 2 && data[0] == 'V') {
+        zero.version = data[1];
+        zero.negotiated = true;
+        zero.more = false;
+        zero.write_seq = 0;
+        zero.have_freed = false;
+    } else if (len >= 1 + 2 * BUS_MAX_DEVICES && data[0] == 'K') {
+        for (uint d = 0; d < BUS_MAX_DEVICES; d++) {
+            uint16_t freed = (uint16_t)(data[1 + 2 * d] | (data[2 + 2 * d] << 8));
+            if (zero.have_freed) zero.buf[d] += (uint16_t)(freed - zero.last_freed[d]);
+            zero.last_freed[d] = freed;
+        }
+        zero.have_freed = true;
+    } else if (len >= 2 && data[0] == 'N') {
+        // WRITE resends aren't modelled: nothing is ever corrupted here.
+        zero.naks_received++;
+    }
+}
+
+static void zero_frame_done(void);
+
+static void zero_read_header_done(void) {
+    uint len = ((zero.rx[8] & ~SPI_READ_LEN_MORE) << 8) | zero.rx[9];
+    if (len > SPI_SLAVE_MAX_PAYLOAD) len = SPI_SLAVE_MAX_PAYLOAD;
+    if (len == 0) {
+        zero_frame_done();
+        return;
+    }
+    memset(zero.tx, 0, len);
+    zero_xfer(len, zero_frame_done);
+    zero.rx_at = read_hdr_size();   // The payload lands after the header
+}
+
+static void zero_start_read(void) {
+    zero.reads++;
+    memset(zero.tx, 0, sizeof(zero.tx));
+    zero.tx[0] = SPI_CMD_READ;
+    if (zero.version >= SPI_PROTO_V2) {
+        zero_xfer(read_hdr_size(), zero_read_header_done);
+    } else {
+        zero_xfer(SPI_SLAVE_READ_SIZE, zero_frame_done);
+    }
+}
+
+static void zero_nak_done(void) {
+    zero.state = ZERO_WAIT_UNREADY;
+    zero.next_ns = sim_now_ns();
+    zero.deadline_ns = sim_now_ns() + 10000000ull;
+}
+
+static void zero_request_done(void) {
+    zero_wait_ready();
+}
+
+static void zero_version_done(void) {
+    zero.version_sent = true;
+}
+
+static void zero_write_done(void) {
+    if (zero.version >= SPI_PROTO_V6) zero.write_seq++;
+}
+
+static void zero_xfer_step(void) {
+    zero.rx[zero.rx_at + zero.xfer_pos] = sim_spi_clock(zero.tx[zero.xfer_pos]);
+    zero.xfer_pos++;
+    zero.next_ns = sim_now_ns() + spi_byte_ns();
+    if (zero.xfer_pos < zero.xfer_len) return;
+
+    sim_gpio_edge(SPI_SLAVE_PIN_CSN, GPIO_IRQ_EDGE_RISE);
+    zero.state = ZERO_IDLE;
+    zero.done();
+}
+
+// A whole READ frame is in rx[]: check it, then take its TLVs.
+static void zero_frame_done(void) {
+    uint hdr = read_hdr_size();
+    uint len = ((zero.rx[8] & ~SPI_READ_LEN_MORE) << 8) | zero.rx[9];
+    if (len > SPI_SLAVE_MAX_PAYLOAD) len = SPI_SLAVE_MAX_PAYLOAD;
+
+    if (zero.version >= SPI_PROTO_V6) {
+        uint32_t crc = crc32_ieee(zero.rx, SPI_SLAVE_READ_HDR_SIZE, 0xFFFFFFFFu);
+        crc = ~crc32_ieee(zero.rx + hdr, len, crc);
+        uint32_t sent = (uint32_t)zero.rx[10] | ((uint32_t)zero.rx[11] << 8) |
+                        ((uint32_t)zero.rx[12] << 16) | ((uint32_t)zero.rx[13] << 24);
+        if (crc != sent) {
+            zero.crc_errors++;
+            if (zero.retries++ < ZERO_READ_RETRIES) {
+                zero.tx[0] = SPI_CMD_NAK;
+                zero_xfer(1, zero_nak_done);
+            }
+            return;
+        }
+    }
+    zero.retries = 0;
+    zero.more = zero.version >= SPI_PROTO_V3 && (zero.rx[8] & SPI_READ_LEN_MORE);
+
+    uint unit = zero.version >= SPI_PROTO_V4 ? SPI_BUF_UNIT_V4 : SPI_BUF_UNIT;
+    if (zero.version < SPI_PROTO_V5) {
+        for (uint d = 0; d < BUS_MAX_DEVICES; d++) zero.buf[d] = zero.rx[d] * unit;
+    }
+
+    const uint8_t *p = zero.rx + hdr;
+    uint pos = 0;
+    while (pos + 2 <= len) {
+        uint8_t device = p[pos];
+        uint8_t tlv_len = p[pos + 1];
+        if (pos + 2 + tlv_len > len) break;
+        if (device == 0) {
+            zero.errors_reported++;
+        } else if (device == 1) {
+            zero_system_tlv(&p[pos + 2], tlv_len);
+        } else if (device < BUS_MAX_DEVICES) {
+            stream_receive(&up, device, &p[pos + 2], tlv_len);
+        }
+        pos += 2 + tlv_len;
+    }
+
+    // v5+: the header BUF is a floor under what the credits say
+    if (zero.version >= SPI_PROTO_V5) {
+        for (uint d = 0; d < BUS_MAX_DEVICES; d++) {
+            int32_t floor = zero.rx[d] * (int32_t)unit;
+            if (zero.buf[d] < floor) zero.buf[d] = floor;
+        }
+    }
+
+    if (zero.more) zero_wait_ready();
+}
+
+// Pack every pending TLV the Zero thinks fits into one WRITE.
+static bool zero_start_write(void) {
+    bool checked = zero.version >= SPI_PROTO_V6;
+    uint hdr = checked ? 4 : 3;
+    uint8_t *payload = zero.tx + hdr;
+    uint n = 0;
+    for (uint8_t d = 1; d < BUS_MAX_DEVICES; d++) {
+        len_queue_t *q = &zero.pending[d];
+        while (q->len) {
+            uint8_t len = q->v[q->head];
+            if (n + 2 + len > SPI_SLAVE_MAX_PAYLOAD || zero.buf[d] < len) break;
+            len_queue_pop(q);
+            payload[n++] = d;
+            payload[n++] = len;
+            for (uint i = 0; i < len; i++) payload[n++] = pattern(d, zero.built[d] + i);
+            zero.built[d] += len;
+            zero.buf[d] -= len;
+        }
+    }
+    if (n == 0) return false;
+
+    zero.tx[0] = SPI_CMD_WRITE;
+    zero.tx[1] = (uint8_t)(n >> 8);
+    zero.tx[2] = (uint8_t)n;
+    uint frame = hdr + n;
+    if (checked) {
+        zero.tx[3] = zero.write_seq;
+        uint32_t crc = ~crc32_ieee(zero.tx + 1, frame - 1, 0xFFFFFFFFu);
+        for (uint i = 0; i < SPI_SLAVE_CRC_SIZE; i++) zero.tx[frame++] = (uint8_t)(crc >> (8 * i));
+    }
+    zero.writes++;
+    zero_xfer(frame, zero_write_done);
+    return true;
+}
+
+static void zero_start_request(void) {
+    zero.requests++;
+    zero.last_request_ns = sim_now_ns();
+    zero.tx[0] = SPI_CMD_REQUEST;
+    zero_xfer(1, zero_request_done);
+}
+
+static void zero_step(void) {
+    uint64_t now = sim_now_ns();
+    switch (zero.state) {
+        case ZERO_XFER:
+            zero_xfer_step();
+            return;
+
+        case ZERO_WAIT_READY:
+            if (!gpio_get(SPI_SLAVE_PIN_READY)) {
+                zero_start_read();
+            } else if (now >= zero.deadline_ns) {
+                zero.timeouts++;
+                zero.more = false;
+                zero.state = ZERO_IDLE;
+                zero.next_ns = now;
+            } else {
+                zero.next_ns = now + opt.ready_poll_us * 1000ull;
+            }
+            return;
+
+        case ZERO_WAIT_UNREADY:
+            if (gpio_get(SPI_SLAVE_PIN_READY) || now >= zero.deadline_ns) {
+                zero_wait_ready();
+            } else {
+                zero.next_ns = now + opt.ready_poll_us * 1000ull;
+            }
+            return;
+
+        case ZERO_IDLE:
+            break;
+    }
+
+    if (opt.proto > SPI_PROTO_V1 && !zero.version_sent) {
+        zero.tx[0] = SPI_CMD_SET_VERSION;
+        zero.tx[1] = (uint8_t)opt.proto;
+        zero_xfer(2, zero_version_done);
+        return;
+    }
+    bool ready_to_write = zero.negotiated || opt.proto == SPI_PROTO_V1;
+    if (ready_to_write && zero_start_write()) return;
+
+    // Read on IRQ; or, if writes are stuck waiting for space (or the
+    // version ack), ask for a fresh BUF every --zero-poll-us.
+    bool stuck = zero_writes_pending() || !ready_to_write;
+    if (!gpio_get(SPI_SLAVE_PIN_IRQ) ||
+        (stuck && now - zero.last_request_ns >= opt.zero_poll_us * 1000ull)) {
+        zero_start_request();
+        return;
+    }
+    zero.next_ns = now + opt.zero_gap_us * 1000ull;
+}
+
+static uint64_t zero_op_next_ns(void) {
+    return zero_ops.next < zero_ops.len ? zero_ops.v[zero_ops.next].at_ns : UINT64_MAX;
+}
+
+static void zero_op_step(void) {
+    const op_t *op = &zero_ops.v[zero_ops.next++];
+    len_queue_push(&zero.pending[op->arg], op->len);
+    stream_send(&down, op->arg, op->len, op->at_ns);
+    last_activity_ns = op->at_ns;
+}
+
+// ============================================================================
+// Report
+// ============================================================================
+
+static int u64_cmp(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : (x > y);
+}
+
+static void print_latency(const char *what, samples_t *s) {
+    if (s->len == 0) {
+        printf("  %-26s no samples\n", what);
+        return;
+    }
+    qsort(s->v, s->len, sizeof(uint64_t), u64_cmp);
+    uint64_t sum = 0;
+    for (size_t i = 0; i < s->len; i++) sum += s->v[i];
+    printf("  %-26s n=%zu  p50 %.1f us  p99 %.1f us  max %.1f us  mean %.1f us\n",
+           what, s->len,
+           s->v[s->len / 2] / 1000.0,
+           s->v[(s->len * 99) / 100] / 1000.0,
+           s->v[s->len - 1] / 1000.0,
+           (double)sum / s->len / 1000.0);
+}
+
+static void print_stream(stream_t *s) {
+    uint64_t bytes = 0, drops = 0, sent = 0;
+    for (uint d = 0; d < BUS_MAX_DEVICES; d++) {
+        bytes += s->got[d];
+        drops += s->drops[d];
+        sent += s->sent[d];
+    }
+    double secs = (s->last_ns > s->first_ns) ? (s->last_ns - s->first_ns) / 1e9 : 0;
+    printf("%s: %llu of %llu bytes in %llu msgs", s->name,
+           (unsigned long long)bytes, (unsigned long long)sent,
+           (unsigned long long)s->msgs);
+    if (secs > 0) printf(", %.0f bytes/s over %.1f ms", bytes / secs, secs * 1000);
+    printf(", %llu dropped, %llu corrupt\n",
+           (unsigned long long)drops, (unsigned long long)s->errors);
+    print_latency("message latency", &s->latency);
+
+    // Broken down by device when more than one carried traffic
+    uint used = 0;
+    for (uint d = 0; d < BUS_MAX_DEVICES; d++) used += s->dev_latency[d].len > 0;
+    if (used < 2) return;
+    for (uint d = 0; d < BUS_MAX_DEVICES; d++) {
+        if (s->dev_latency[d].len == 0) continue;
+        char what[32];
+        snprintf(what, sizeof(what), "  device %u (%llu dropped)", d,
+                 (unsigned long long)s->drops[d]);
+        print_latency(what, &s->dev_latency[d]);
+    }
+}
+
+static void report(uint64_t host_total_ns) {
+    printf("bridge_sim: protocol v%u, 6502 %.2f MHz, SPI %.2f MHz, loop %u ns, %.1f ms simulated\n",
+           zero.negotiated ? zero.version : SPI_PROTO_V1, opt.cpu_mhz, opt.spi_hz / 1e6,
+           opt.loop_ns, sim_now_ns() / 1e6);
+    print_stream(&up);
+    print_stream(&down);
+    printf("6502 reads: %zu, %llu empty, %.1f polls each\n",
+           read_latency.len, (unsigned long long)empty_reads,
+           read_latency.len ? (double)read_polls / read_latency.len : 0.0);
+    print_latency("command -> length", &read_latency);
+    printf("Zero: %u writes, %u requests, %u reads, %u READY timeouts, "
+           "%u CRC errors, %u WRITE NAKs, %u error TLVs\n",
+           zero.writes, zero.requests, zero.reads, zero.timeouts,
+           zero.crc_errors, zero.naks_received, zero.errors_reported);
+
+    bus_stats_t bs = bus_get_stats();
+    spi_slave_stats_t ss = spi_slave_get_stats();
+    printf("bus: rx=%lu tx=%lu overruns=%lu lost=%lu empty_reads=%lu fifo_overflows=%lu\n",
+           (unsigned long)bs.rx_bytes, (unsigned long)bs.tx_bytes,
+           (unsigned long)bs.rx_dma_overruns, (unsigned long)(bs.rx_bytes_lost + bus_rx_lost),
+           (unsigned long)bs.tx_empty_reads, (unsigned long)sim_bus_rx_overflows());
+    printf("spi: wr=%lu rd=%lu req=%lu proto_err=%lu overruns=%lu crc_err=%lu naks=%lu "
+           "lost=%lu fifo_overflows=%lu\n",
+           (unsigned long)ss.rx_writes, (unsigned long)ss.tx_reads,
+           (unsigned long)ss.requests, (unsigned long)ss.proto_errors,
+           (unsigned long)ss.rx_dma_overruns, (unsigned long)ss.rx_crc_errors,
+           (unsigned long)ss.tx_naks, (unsigned long)spi_rx_lost,
+           (unsigned long)sim_spi_rx_overflows());
+#if BRIDGE_EVENT_TRACE
+    printf("events: %lu in %lu batches, %lu dropped\n", (unsigned long)evt_events,
+           (unsigned long)evt_batches, (unsigned long)evt_dropped);
+#endif
+    printf("host: %.1f ns per firmware loop (%llu loops), %.2f s total\n",
+           fw_iterations ? (double)fw_host_ns / fw_iterations : 0.0,
+           (unsigned long long)fw_iterations, host_total_ns / 1e9);
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+static void usage(void) {
+    fprintf(stderr,
+        "usage: bridge_sim [options] [trace]\n"
+        "  --proto N          protocol version the Zero asks for (default %u)\n"
+        "  --cpu-mhz F        6502 clock (default 1)\n"
+        "  --spi-hz N         SPI clock (default 8000000)\n"
+        "  --loop-ns N        firmware main loop period (default 1000)\n"
+        "  --zero-gap-us N    Zero per-transaction overhead (default 20)\n"
+        "  --ready-poll-us N  Zero READY poll interval (default 100)\n"
+        "  --zero-poll-us N   REQUEST interval while writes wait for space (default 1000)\n"
+        "\n"
+        "trace lines (# comments; times in us; ops run in time order, each\n"
+        "once its actor is free; count repeats it every interval_us):\n"
+        "  <time> cpu write <dev> <len> [count [interval]]   io_write()\n"
+        "  <time> cpu read <dev> [count [interval]]          io_read()\n"
+        "  <time> cpu readany <mask> [count [interval]]      io_read_any()\n"
+        "  <time> cpu block <dev> <len> [count [interval]]   io_read_block()\n"
+        "  <time> zero write <dev> <len> [count [interval]]  a TLV for the 6502\n"
+        "  <time> end                                        stop here\n",
+        SPI_PROTO_MAX);
+    exit(2);
+}
+
+int main(int argc, char **argv) {
+    const char *trace = NULL;
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        const char *v = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (a[0] != '-') {
+            trace = a;
+            continue;
+        }
+        if (!v) usage();
+        if (strcmp(a, "--proto") == 0) {
+            opt.proto = (uint)strtoul(v, NULL, 0);
+        } else if (strcmp(a, "--cpu-mhz") == 0) {
+            opt.cpu_mhz = strtod(v, NULL);
+        } else if (strcmp(a, "--spi-hz") == 0) {
+            opt.spi_hz = (uint32_t)strtoul(v, NULL, 0);
+        } else if (strcmp(a, "--loop-ns") == 0) {
+            opt.loop_ns = (uint32_t)strtoul(v, NULL, 0);
+        } else if (strcmp(a, "--zero-gap-us") == 0) {
+            opt.zero_gap_us = (uint32_t)strtoul(v, NULL, 0);
+        } else if (strcmp(a, "--ready-poll-us") == 0) {
+            opt.ready_poll_us = (uint32_t)strtoul(v, NULL, 0);
+        } else if (strcmp(a, "--zero-poll-us") == 0) {
+            opt.zero_poll_us = (uint32_t)strtoul(v, NULL, 0);
+        } else {
+            usage();
+        }
+        i++;
+    }
+    if (opt.proto < SPI_PROTO_V1 || opt.proto > SPI_PROTO_MAX || opt.cpu_mhz <= 0 ||
+        opt.spi_hz == 0 || opt.loop_ns == 0 || opt.ready_poll_us == 0) {
+        usage();
+    }
+
+    load_script(trace);
+    fw_init();
+    zero.version = SPI_PROTO_V1;
+
+    uint64_t host_start = host_ns();
+    for (;;) {
+        uint64_t now = sim_now_ns();
+        if (script_end_ns) {
+            if (now >= script_end_ns) break;
+        } else if (zero_ops.next == zero_ops.len && now > script_last_ns) {
+            bool settled = cpu_ops.next == cpu_ops.len && cpu.state == CPU_IDLE &&
+                           !zero_writes_pending() && stream_drained(&up) &&
+                           stream_drained(&down);
+            if (settled || now - last_activity_ns >= DRAIN_NS) break;
+        }
+
+        // Next event; ties go to the script, the 6502, the Zero, the Pico.
+        uint64_t t_op = zero_op_next_ns();
+        uint64_t t_cpu = cpu_next_ns();
+        uint64_t t_zero = zero.next_ns;
+        uint64_t t = fw_next_ns;
+        if (t_zero <= t) t = t_zero;
+        if (t_cpu <= t) t = t_cpu;
+        if (t_op <= t) t = t_op;
+        if (t > now) sim_advance_ns(t - now);
+
+        if (t == t_op) {
+            zero_op_step();
+        } else if (t == t_cpu) {
+            cpu_step();
+        } else if (t == t_zero) {
+            zero_step();
+        } else {
+            fw_step();
+        }
+    }
+    report(host_ns() - host_start);
+    return (up.errors || down.errors) ? 1 : 0;
+}
@@ -0,0 +1,45 @@
+// Host simulation build: stands in for the header pioasm generates from
+// bus_interface.pio.  sim_hw.c models what the program does with the
+// FIFOs, so only the names bus_interface.c uses are needed here.
+
+#ifndef SIM_BUS_INTERFACE_PIO_H
+#define SIM_BUS_INTERFACE_PIO_H
+
+#include "sim_hw.h"
+
+#define bus_interface_offset_wait_cycle 0u
+
+#define bus_interface_PIN_RW    0
+#define bus_interface_PIN_CS_N  1
+#define bus_interface_PIN_PHI2  2
+#define bus_interface_PIN_D0    6
+
+#define BUS_PIN_RW      0
+#define BUS_PIN_CS_N    1
+#define BUS_PIN_PHI2    2
+#define BUS_PIN_D0      6
+#define BUS_PIN_D_COUNT 8
+
+static const uint16_t bus_interface_program_instructions[1];
+
+static const pio_program_t bus_interface_program = {
+    .instructions = bus_interface_program_instructions,
+    .length = 1,
+    .origin = -1,
+};
+
+static inline void bus_interface_program_init(PIO pio, uint sm, uint offset) {
+    (void)pio;
+    (void)sm;
+    (void)offset;
+}
+
+static inline void bus_interface_enable(PIO pio, uint sm) {
+    pio_sm_set_enabled(pio, sm, true);
+}
+
+static inline void bus_interface_disable(PIO pio, uint sm) {
+    pio_sm_set_enabled(pio, sm, false);
+}
+
+#endif // SIM_BUS_INTERFACE_PIO_H
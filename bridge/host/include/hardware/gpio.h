@@ -0,0 +1,5 @@
+// Host simulation build: see sim_hw.h.
+#ifndef SIM_HARDWARE_GPIO_H
+#define SIM_HARDWARE_GPIO_H
+#include "sim_hw.h"
+#endif
@@ -0,0 +1,5 @@
+// Host simulation build: see sim_hw.h.
+#ifndef SIM_PICO_STDLIB_H
+#define SIM_PICO_STDLIB_H
+#include "sim_hw.h"
+#endif
@@ -0,0 +1,5 @@
+// Host simulation build: see sim_hw.h.
+#ifndef SIM_PICO_TIME_H
+#define SIM_PICO_TIME_H
+#include "sim_hw.h"
+#endif
@@ -0,0 +1,256 @@
+/*
+ * Host simulation of the RP2350 peripherals the bridge firmware uses.
+ *
+ * Just enough of the pico-sdk API for bus_interface.c, spi_slave.c and
+ * latency.c to build and run on a PC: DMA channels (ring, TRIGGER_SELF,
+ * chaining, the sniffer), the bus PIO state machine's FIFOs and OSR, the
+ * SPI slave FIFOs and GPIO levels.  Every pico-sdk header in this
+ * directory just includes this one.
+ *
+ * Nothing moves on its own.  bridge_sim.c plays the 6502 and the Zero and
+ * calls the sim_*() hooks at the bottom, which push bytes through the
+ * FIFOs and let each DMA channel with a matching DREQ run, as its
+ * hardware would at that instant.
+ */
+
+#ifndef SIM_HW_H
+#define SIM_HW_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+typedef unsigned int uint;
+
+#define __isr
+#define __compiler_memory_barrier() __asm__ volatile("" ::: "memory")
+#define __dmb() __compiler_memory_barrier()
+#define __wfe() ((void)0)
+#define __sev() ((void)0)
+#define count_of(a) (sizeof(a) / sizeof((a)[0]))
+
+static inline uint32_t save_and_disable_interrupts(void) { return 0; }
+static inline void restore_interrupts(uint32_t saved) { (void)saved; }
+
+// ============================================================================
+// Time: clk_sys runs at SIM_CLK_SYS_HZ, advanced by sim_advance_ns()
+// ============================================================================
+
+#define SIM_CLK_SYS_HZ  150000000u
+
+uint32_t time_us_32(void);
+uint64_t time_us_64(void);
+
+typedef struct {
+    volatile uint32_t mtime_ctrl;
+    volatile uint32_t mtime;    // clk_sys cycles (full-speed mode is assumed)
+} sio_hw_t;
+
+extern sio_hw_t sim_sio;
+#define sio_hw (&sim_sio)
+#define SIO_MTIME_CTRL_EN_BITS          0x1u
+#define SIO_MTIME_CTRL_FULLSPEED_BITS   0x2u
+
+// ============================================================================
+// IRQs
+// ============================================================================
+
+typedef void (*irq_handler_t)(void);
+
+enum { DMA_IRQ_0, DMA_IRQ_1, PIO0_IRQ_0, SIM_IRQ_COUNT };
+
+void irq_set_exclusive_handler(uint num, irq_handler_t handler);
+void irq_set_enabled(uint num, bool enabled);
+
+// ============================================================================
+// GPIO
+// ============================================================================
+
+#define GPIO_IN         false
+#define GPIO_OUT        true
+#define GPIO_FUNC_SPI   1
+#define GPIO_FUNC_PIO0  6
+#define GPIO_IRQ_EDGE_FALL  0x4u
+#define GPIO_IRQ_EDGE_RISE  0x8u
+#define SIM_GPIO_COUNT  48
+
+void gpio_init(uint gpio);
+void gpio_set_dir(uint gpio, bool out);
+bool gpio_get_dir(uint gpio);
+void gpio_put(uint gpio, bool value);
+bool gpio_get(uint gpio);
+void gpio_set_function(uint gpio, uint fn);
+void gpio_set_pulls(uint gpio, bool up, bool down);
+void gpio_set_irq_enabled(uint gpio, uint32_t events, bool enabled);
+
+typedef void (*gpio_irq_callback_t)(uint gpio, uint32_t event_mask);
+void gpio_set_irq_callback(gpio_irq_callback_t callback);
+
+// ============================================================================
+// DMA
+// ============================================================================
+
+enum dma_channel_transfer_size { DMA_SIZE_8 = 0, DMA_SIZE_16 = 1, DMA_SIZE_32 = 2 };
+
+#define DREQ_PIO0_TX0   0
+#define DREQ_PIO0_RX0   4
+#define DREQ_SPI0_TX    24
+#define DREQ_SPI0_RX    25
+#define DREQ_FORCE      0x3f
+
+#define DMA_SNIFF_CTRL_CALC_VALUE_CRC32     0
+#define DMA_SNIFF_CTRL_CALC_VALUE_CRC32R    1
+
+#define SIM_DMA_CHANNELS 16
+
+// Register view.  Addresses are 32-bit on the RP2350, so read_addr and
+// write_addr hold the low half of the host pointer; the firmware only
+// ever subtracts them from its own (truncated) buffer addresses.
+typedef struct {
+    volatile uint32_t read_addr;
+    volatile uint32_t write_addr;
+    volatile uint32_t transfer_count;
+    volatile uint32_t ctrl_trig;
+    volatile uint32_t al3_transfer_count;
+    volatile uint32_t al3_read_addr_trig;
+} dma_channel_hw_t;
+
+typedef struct {
+    uint size;
+    bool read_incr;
+    bool write_incr;
+    uint ring_bits;
+    bool ring_write;
+    uint dreq;
+    int chain_to;       // -1: none
+    bool high_priority;
+    bool sniff;
+} dma_channel_config;
+
+int dma_claim_unused_channel(bool required);
+dma_channel_config dma_channel_get_default_config(uint channel);
+void channel_config_set_transfer_data_size(dma_channel_config *c, enum dma_channel_transfer_size size);
+void channel_config_set_read_increment(dma_channel_config *c, bool incr);
+void channel_config_set_write_increment(dma_channel_config *c, bool incr);
+void channel_config_set_ring(dma_channel_config *c, bool write, uint size_bits);
+void channel_config_set_dreq(dma_channel_config *c, uint dreq);
+void channel_config_set_chain_to(dma_channel_config *c, uint chain_to);
+void channel_config_set_high_priority(dma_channel_config *c, bool high);
+void channel_config_set_sniff_enable(dma_channel_config *c, bool sniff);
+
+void dma_channel_configure(uint channel, const dma_channel_config *config,
+                           volatile void *write_addr, const volatile void *read_addr,
+                           uint32_t transfer_count, bool trigger);
+void dma_channel_set_read_addr(uint channel, const volatile void *read_addr, bool trigger);
+void dma_channel_set_trans_count(uint channel, uint32_t count, bool trigger);
+void dma_channel_start(uint channel);
+void dma_channel_abort(uint channel);
+bool dma_channel_is_busy(uint channel);
+void dma_channel_wait_for_finish_blocking(uint channel);
+dma_channel_hw_t *dma_channel_hw_addr(uint channel);
+
+void dma_channel_set_irq0_enabled(uint channel, bool enabled);
+void dma_channel_set_irq1_enabled(uint channel, bool enabled);
+void dma_channel_acknowledge_irq0(uint channel);
+void dma_channel_acknowledge_irq1(uint channel);
+
+void dma_sniffer_enable(uint channel, uint mode, bool force_channel_enable);
+void dma_sniffer_set_output_reverse_enabled(bool enable);
+void dma_sniffer_set_output_invert_enabled(bool enable);
+void dma_sniffer_set_data_accumulator(uint32_t seed);
+uint32_t dma_sniffer_get_data_accumulator(void);
+
+// ============================================================================
+// PIO (one state machine running bus_interface.pio)
+// ============================================================================
+
+typedef struct {
+    volatile uint32_t txf[4];
+    volatile uint32_t rxf[4];
+    volatile uint32_t dbg_padoe;
+    volatile uint16_t instr_mem[32];
+} pio_hw_t;
+
+typedef pio_hw_t *PIO;
+extern pio_hw_t sim_pio0;
+#define pio0 (&sim_pio0)
+
+typedef struct pio_program {
+    const uint16_t *instructions;
+    uint8_t length;
+    int8_t origin;
+} pio_program_t;
+
+typedef enum { pis_sm0_rx_fifo_not_empty = 0 } pio_interrupt_source_t;
+
+bool pio_can_add_program(PIO pio, const pio_program_t *program);
+uint pio_add_program(PIO pio, const pio_program_t *program);
+uint pio_get_dreq(PIO pio, uint sm, bool is_tx);
+uint8_t pio_sm_get_pc(PIO pio, uint sm);
+uint pio_sm_get_tx_fifo_level(PIO pio, uint sm);
+uint pio_sm_get_rx_fifo_level(PIO pio, uint sm);
+void pio_sm_set_enabled(PIO pio, uint sm, bool enabled);
+void pio_set_irq0_source_enabled(PIO pio, pio_interrupt_source_t source, bool enabled);
+
+static inline uint pio_encode_wait_gpio(bool polarity, uint gpio) {
+    return 0x2080u | (polarity ? 0x80u : 0) | gpio;
+}
+
+static inline uint pio_encode_delay(uint cycles) {
+    return (cycles & 0x1fu) << 8;
+}
+
+// ============================================================================
+// SPI (PL022 in slave mode)
+// ============================================================================
+
+typedef struct {
+    volatile uint32_t dr;
+} spi_hw_t;
+
+typedef struct spi_inst spi_inst_t;
+extern spi_inst_t *const sim_spi0;
+#define spi0 sim_spi0
+
+typedef enum { SPI_CPOL_0, SPI_CPOL_1 } spi_cpol_t;
+typedef enum { SPI_CPHA_0, SPI_CPHA_1 } spi_cpha_t;
+typedef enum { SPI_LSB_FIRST, SPI_MSB_FIRST } spi_order_t;
+
+uint spi_init(spi_inst_t *spi, uint baudrate);
+void spi_set_slave(spi_inst_t *spi, bool slave);
+void spi_set_format(spi_inst_t *spi, uint data_bits, spi_cpol_t cpol, spi_cpha_t cpha,
+                    spi_order_t order);
+spi_hw_t *spi_get_hw(spi_inst_t *spi);
+uint spi_get_dreq(spi_inst_t *spi, bool is_tx);
+bool spi_is_readable(spi_inst_t *spi);
+
+// ============================================================================
+// Simulation hooks (bridge_sim.c)
+// ============================================================================
+
+// Advance simulated time.
+void sim_advance_ns(uint64_t ns);
+uint64_t sim_now_ns(void);
+
+// One 6502 bus cycle with the bridge selected.  A write pushes |byte| into
+// the PIO RX FIFO; a read returns the byte the state machine drives (0xFF
+// while it has nothing).  Returns false if a write found the RX FIFO full,
+// which stalls the real state machine and loses the byte.
+bool sim_bus_write(uint8_t byte);
+uint8_t sim_bus_read(void);
+
+// One SPI byte clocked by the Zero while CS is low: |mosi| goes into the
+// slave's RX FIFO and the byte it shifts out is returned (0x00 if its TX
+// FIFO is empty).  A full RX FIFO loses |mosi|, as the PL022 does.
+uint8_t sim_spi_clock(uint8_t mosi);
+
+// An edge on |gpio| driven from outside (CS rising at the end of a
+// transaction): runs the GPIO IRQ callback if |events| are enabled.
+void sim_gpio_edge(uint gpio, uint32_t events);
+
+// Bytes the SPI RX FIFO and the bus state machine dropped while full.
+uint32_t sim_spi_rx_overflows(void);
+uint32_t sim_bus_rx_overflows(void);
+
+#endif // SIM_HW_H
@@ -0,0 +1,641 @@
+/*
+ * Host simulation of the RP2350 peripherals.  See include/sim_hw.h.
+ *
+ * DMA channels keep full host pointers and mirror the low 32 bits into
+ * the register view the firmware reads.  A transfer runs whenever its
+ * source has data and its destination has room, which is what the DREQs
+ * the firmware configures amount to; every hook that moves a FIFO, and
+ * every trigger, lets all channels run to a standstill.
+ */
+
+#include "sim_hw.h"
+#include "bridge_defs.h"   // DMA TRANS_COUNT mode bits
+
+#include <stdlib.h>
+#include <string.h>
+
+// ============================================================================
+// Time
+// ============================================================================
+
+static uint64_t now_ns;
+sio_hw_t sim_sio;
+
+void sim_advance_ns(uint64_t ns) {
+    now_ns += ns;
+    sim_sio.mtime = (uint32_t)(now_ns * (SIM_CLK_SYS_HZ / 1000000u) / 1000u);
+}
+
+uint64_t sim_now_ns(void) {
+    return now_ns;
+}
+
+uint32_t time_us_32(void) {
+    return (uint32_t)(now_ns / 1000u);
+}
+
+uint64_t time_us_64(void) {
+    return now_ns / 1000u;
+}
+
+// ============================================================================
+// IRQs
+// ============================================================================
+
+static irq_handler_t irq_handlers[SIM_IRQ_COUNT];
+static bool irq_enabled[SIM_IRQ_COUNT];
+
+void irq_set_exclusive_handler(uint num, irq_handler_t handler) {
+    if (num < SIM_IRQ_COUNT) irq_handlers[num] = handler;
+}
+
+void irq_set_enabled(uint num, bool enabled) {
+    if (num < SIM_IRQ_COUNT) irq_enabled[num] = enabled;
+}
+
+static void irq_raise(uint num) {
+    if (irq_enabled[num] && irq_handlers[num]) irq_handlers[num]();
+}
+
+// ============================================================================
+// GPIO
+// ============================================================================
+
+static bool gpio_level[SIM_GPIO_COUNT];
+static bool gpio_out[SIM_GPIO_COUNT];
+static uint32_t gpio_irq_events[SIM_GPIO_COUNT];
+static gpio_irq_callback_t gpio_callback;
+
+void gpio_init(uint gpio) {
+    gpio_out[gpio] = false;
+    gpio_level[gpio] = false;
+}
+
+void gpio_set_dir(uint gpio, bool out) {
+    gpio_out[gpio] = out;
+}
+
+bool gpio_get_dir(uint gpio) {
+    return gpio_out[gpio];
+}
+
+void gpio_put(uint gpio, bool value) {
+    gpio_level[gpio] = value;
+}
+
+bool gpio_get(uint gpio) {
+    return gpio_level[gpio];
+}
+
+void gpio_set_function(uint gpio, uint fn) {
+    (void)gpio;
+    (void)fn;
+}
+
+void gpio_set_pulls(uint gpio, bool up, bool down) {
+    (void)down;
+    if (!gpio_out[gpio]) gpio_level[gpio] = up;
+}
+
+void gpio_set_irq_enabled(uint gpio, uint32_t events, bool enabled) {
+    if (enabled) {
+        gpio_irq_events[gpio] |= events;
+    } else {
+        gpio_irq_events[gpio] &= ~events;
+    }
+}
+
+void gpio_set_irq_callback(gpio_irq_callback_t callback) {
+    gpio_callback = callback;
+}
+
+void sim_gpio_edge(uint gpio, uint32_t events) {
+    events &= gpio_irq_events[gpio];
+    if (events && gpio_callback) gpio_callback(gpio, events);
+}
+
+// ============================================================================
+// FIFOs
+// ============================================================================
+
+typedef struct {
+    uint32_t data[8];
+    uint depth;
+    uint head;
+    uint count;
+} fifo_t;
+
+static bool fifo_full(const fifo_t *f) {
+    return f->count == f->depth;
+}
+
+static void fifo_push(fifo_t *f, uint32_t v) {
+    f->data[(f->head + f->count) % f->depth] = v;
+    f->count++;
+}
+
+static uint32_t fifo_pop(fifo_t *f) {
+    uint32_t v = f->data[f->head];
+    f->head = (f->head + 1) % f->depth;
+    f->count--;
+    return v;
+}
+
+// Bus PIO: 4-word FIFOs each way, and the OSR the read path shifts from.
+pio_hw_t sim_pio0;
+static fifo_t pio_tx = { .depth = 4 };
+static fifo_t pio_rx = { .depth = 4 };
+static uint32_t pio_osr = 0xFFFFFFFFu;  // bus_interface_program_init() preloads
+static uint pio_osr_bytes = 4;          // the 0xFF sentinel
+static bool pio_enabled;
+static uint32_t pio_rx_overflows;
+
+// SPI0: the PL022's 8-entry FIFOs.
+struct spi_inst { int unused; };
+static struct spi_inst spi0_inst;
+spi_inst_t *const sim_spi0 = &spi0_inst;
+static spi_hw_t spi0_hw;
+static fifo_t spi_tx = { .depth = 8 };
+static fifo_t spi_rx = { .depth = 8 };
+static uint32_t spi_rx_overflow_count;
+
+// ============================================================================
+// DMA
+// ============================================================================
+
+// Matches bridge_defs.h / spi_slave.c tx_dma_block_t: what a control
+// channel writing a data channel's alias-3 pair reads per trigger.
+typedef struct {
+    uint32_t len;
+    const void *read_addr;
+} sim_dma_block_t;
+
+typedef struct {
+    bool claimed;
+    bool busy;
+    bool irq0;
+    bool irq1;
+    dma_channel_config cfg;
+    uintptr_t read;
+    uintptr_t write;
+    uint32_t count;
+    uint32_t reload;        // Last value written to TRANS_COUNT (with mode)
+    int al3_target;         // Channel whose alias-3 pair this one writes, or -1
+} sim_dma_t;
+
+static sim_dma_t dma[SIM_DMA_CHANNELS];
+static dma_channel_hw_t dma_hw[SIM_DMA_CHANNELS];
+
+static struct {
+    bool enabled;
+    uint channel;
+    uint mode;
+    bool reverse;
+    bool invert;
+    uint32_t acc;
+} sniffer;
+
+static bool dma_running;
+static void dma_run(void);
+
+int dma_claim_unused_channel(bool required) {
+    for (int ch = 0; ch < SIM_DMA_CHANNELS; ch++) {
+        if (!dma[ch].claimed) {
+            dma[ch].claimed = true;
+            dma[ch].al3_target = -1;
+            return ch;
+        }
+    }
+    if (required) {
+        fprintf(stderr, "sim: out of DMA channels\n");
+        abort();
+    }
+    return -1;
+}
+
+dma_channel_config dma_channel_get_default_config(uint channel) {
+    dma_channel_config c = {
+        .size = DMA_SIZE_32,
+        .read_incr = true,
+        .write_incr = false,
+        .dreq = DREQ_FORCE,
+        .chain_to = (int)channel,
+    };
+    return c;
+}
+
+void channel_config_set_transfer_data_size(dma_channel_config *c, enum dma_channel_transfer_size size) {
+    c->size = size;
+}
+
+void channel_config_set_read_increment(dma_channel_config *c, bool incr) {
+    c->read_incr = incr;
+}
+
+void channel_config_set_write_increment(dma_channel_config *c, bool incr) {
+    c->write_incr = incr;
+}
+
+void channel_config_set_ring(dma_channel_config *c, bool write, uint size_bits) {
+    c->ring_write = write;
+    c->ring_bits = size_bits;
+}
+
+void channel_config_set_dreq(dma_channel_config *c, uint dreq) {
+    c->dreq = dreq;
+}
+
+void channel_config_set_chain_to(dma_channel_config *c, uint chain_to) {
+    c->chain_to = (int)chain_to;
+}
+
+void channel_config_set_high_priority(dma_channel_config *c, bool high) {
+    c->high_priority = high;
+}
+
+void channel_config_set_sniff_enable(dma_channel_config *c, bool sniff) {
+    c->sniff = sniff;
+}
+
+static void dma_mirror(uint ch) {
+    dma_hw[ch].read_addr = (uint32_t)dma[ch].read;
+    dma_hw[ch].write_addr = (uint32_t)dma[ch].write;
+    dma_hw[ch].transfer_count = dma[ch].count;
+}
+
+static void dma_trigger(uint ch) {
+    sim_dma_t *c = &dma[ch];
+    c->count = c->reload & DMA_TRANS_COUNT_COUNT_MASK;
+    c->busy = c->count > 0 || c->al3_target >= 0;
+    dma_mirror(ch);
+    dma_run();
+}
+
+void dma_channel_configure(uint channel, const dma_channel_config *config,
+                           volatile void *write_addr, const volatile void *read_addr,
+                           uint32_t transfer_count, bool trigger) {
+    sim_dma_t *c = &dma[channel];
+    c->cfg = *config;
+    c->write = (uintptr_t)write_addr;
+    c->read = (uintptr_t)read_addr;
+    c->reload = transfer_count;
+    c->al3_target = -1;
+    for (int t = 0; t < SIM_DMA_CHANNELS; t++) {
+        if (write_addr == &dma_hw[t].al3_transfer_count) c->al3_target = t;
+    }
+    dma_mirror(channel);
+    if (trigger) dma_trigger(channel);
+}
+
+void dma_channel_set_read_addr(uint channel, const volatile void *read_addr, bool trigger) {
+    dma[channel].read = (uintptr_t)read_addr;
+    dma_mirror(channel);
+    if (trigger) dma_trigger(channel);
+}
+
+void dma_channel_set_trans_count(uint channel, uint32_t count, bool trigger) {
+    dma[channel].reload = count;
+    if (trigger) dma_trigger(channel);
+}
+
+void dma_channel_start(uint channel) {
+    dma_trigger(channel);
+}
+
+void dma_channel_abort(uint channel) {
+    dma[channel].busy = false;
+    dma[channel].count = 0;
+    dma_mirror(channel);
+}
+
+bool dma_channel_is_busy(uint channel) {
+    return dma[channel].busy;
+}
+
+void dma_channel_wait_for_finish_blocking(uint channel) {
+    dma_run();
+    if (dma[channel].busy) {
+        fprintf(stderr, "sim: DMA channel %u would block forever\n", channel);
+        abort();
+    }
+}
+
+dma_channel_hw_t *dma_channel_hw_addr(uint channel) {
+    return &dma_hw[channel];
+}
+
+void dma_channel_set_irq0_enabled(uint channel, bool enabled) {
+    dma[channel].irq0 = enabled;
+}
+
+void dma_channel_set_irq1_enabled(uint channel, bool enabled) {
+    dma[channel].irq1 = enabled;
+}
+
+void dma_channel_acknowledge_irq0(uint channel) {
+    (void)channel;
+}
+
+void dma_channel_acknowledge_irq1(uint channel) {
+    (void)channel;
+}
+
+// --- Sniffer: CRC-32 (poly 0x04C11DB7, MSB first) as the hardware runs it ---
+
+static uint32_t bitrev32(uint32_t v) {
+    uint32_t r = 0;
+    for (int i = 0; i < 32; i++) {
+        r = (r << 1) | (v & 1);
+        v >>= 1;
+    }
+    return r;
+}
+
+static void sniff_byte(uint8_t b) {
+    uint32_t data = b;
+    if (sniffer.mode == DMA_SNIFF_CTRL_CALC_VALUE_CRC32R) {
+        data = bitrev32(data) >> 24;
+    }
+    sniffer.acc ^= data << 24;
+    for (int i = 0; i < 8; i++) {
+        sniffer.acc = (sniffer.acc & 0x80000000u) ? (sniffer.acc << 1) ^ 0x04C11DB7u
+                                                  : sniffer.acc << 1;
+    }
+}
+
+void dma_sniffer_enable(uint channel, uint mode, bool force_channel_enable) {
+    (void)force_channel_enable;
+    sniffer.enabled = true;
+    sniffer.channel = channel;
+    sniffer.mode = mode;
+}
+
+void dma_sniffer_set_output_reverse_enabled(bool enable) {
+    sniffer.reverse = enable;
+}
+
+void dma_sniffer_set_output_invert_enabled(bool enable) {
+    sniffer.invert = enable;
+}
+
+void dma_sniffer_set_data_accumulator(uint32_t seed) {
+    sniffer.acc = seed;
+}
+
+uint32_t dma_sniffer_get_data_accumulator(void) {
+    uint32_t v = sniffer.acc;
+    if (sniffer.reverse) v = bitrev32(v);
+    if (sniffer.invert) v = ~v;
+    return v;
+}
+
+// --- Transfers ---
+
+static bool addr_is(uintptr_t addr, const volatile void *reg) {
+    return addr == (uintptr_t)reg;
+}
+
+static bool dma_can_read(uintptr_t addr) {
+    if (addr_is(addr, &sim_pio0.rxf[0])) return pio_rx.count > 0;
+    if (addr_is(addr, &spi0_hw.dr)) return spi_rx.count > 0;
+    return true;
+}
+
+static bool dma_can_write(uintptr_t addr) {
+    if (addr_is(addr, &sim_pio0.txf[0])) return !fifo_full(&pio_tx);
+    if (addr_is(addr, &spi0_hw.dr)) return !fifo_full(&spi_tx);
+    return true;
+}
+
+static uint32_t dma_read(uintptr_t addr, uint size) {
+    if (addr_is(addr, &sim_pio0.rxf[0])) return fifo_pop(&pio_rx);
+    if (addr_is(addr, &spi0_hw.dr)) return fifo_pop(&spi_rx);
+    uint32_t v = 0;
+    memcpy(&v, (const void *)addr, 1u << size);
+    return v;
+}
+
+static void dma_write(uintptr_t addr, uint size, uint32_t v) {
+    if (addr_is(addr, &sim_pio0.txf[0])) {
+        fifo_push(&pio_tx, v);
+    } else if (addr_is(addr, &spi0_hw.dr)) {
+        fifo_push(&spi_tx, v & 0xFF);
+    } else {
+        memcpy((void *)addr, &v, 1u << size);
+    }
+}
+
+static void dma_complete(uint ch) {
+    sim_dma_t *c = &dma[ch];
+    if ((c->reload & ~DMA_TRANS_COUNT_COUNT_MASK) == DMA_TRANS_COUNT_MODE_TRIGGER_SELF) {
+        c->count = c->reload & DMA_TRANS_COUNT_COUNT_MASK;
+    } else {
+        c->busy = false;
+    }
+    dma_mirror(ch);
+    if (c->irq0) irq_raise(DMA_IRQ_0);
+    if (c->irq1) irq_raise(DMA_IRQ_1);
+    if (c->cfg.chain_to != (int)ch) {
+        dma_trigger((uint)c->cfg.chain_to);
+    }
+}
+
+// A control channel aimed at an alias-3 pair: one block per trigger, the
+// read address write being the data channel's trigger (NULL: null trigger).
+static void dma_run_control(uint ch) {
+    sim_dma_t *c = &dma[ch];
+    sim_dma_block_t block;
+    memcpy(&block, (const void *)c->read, sizeof(block));
+    c->read += sizeof(block);
+    c->busy = false;
+    dma_mirror(ch);
+
+    sim_dma_t *t = &dma[c->al3_target];
+    if (block.read_addr == NULL) return;
+    t->read = (uintptr_t)block.read_addr;
+    t->reload = block.len;
+    t->count = block.len;
+    t->busy = true;
+    dma_mirror((uint)c->al3_target);
+    if (t->count == 0) dma_complete((uint)c->al3_target);
+}
+
+// Run every busy channel until none can make progress.
+static void dma_run(void) {
+    if (dma_running) return;    // A chain trigger from inside the loop
+    dma_running = true;
+    bool progress = true;
+    while (progress) {
+        progress = false;
+        for (uint ch = 0; ch < SIM_DMA_CHANNELS; ch++) {
+            sim_dma_t *c = &dma[ch];
+            if (!c->busy) continue;
+            if (c->al3_target >= 0) {
+                dma_run_control(ch);
+                progress = true;
+                continue;
+            }
+            while (c->busy && c->count > 0 &&
+                   dma_can_read(c->read) && dma_can_write(c->write)) {
+                uint size = c->cfg.size;
+                uint32_t v = dma_read(c->read, size);
+                dma_write(c->write, size, v);
+                if (sniffer.enabled && c->cfg.sniff && sniffer.channel == ch) {
+                    for (uint i = 0; i < (1u << size); i++) sniff_byte((uint8_t)(v >> (8 * i)));
+                }
+                if (c->cfg.read_incr) {
+                    c->read += 1u << size;
+                }
+                if (c->cfg.write_incr) {
+                    uintptr_t next = c->write + (1u << size);
+                    if (c->cfg.ring_write && c->cfg.ring_bits) {
+                        uintptr_t mask = ((uintptr_t)1 << c->cfg.ring_bits) - 1;
+                        next = (c->write & ~mask) | (next & mask);
+                    }
+                    c->write = next;
+                }
+                c->count--;
+                progress = true;
+                dma_mirror(ch);
+                if (c->count == 0) dma_complete(ch);
+            }
+        }
+    }
+    dma_running = false;
+}
+
+// ============================================================================
+// PIO
+// ============================================================================
+
+bool pio_can_add_program(PIO pio, const pio_program_t *program) {
+    (void)pio;
+    (void)program;
+    return true;
+}
+
+uint pio_add_program(PIO pio, const pio_program_t *program) {
+    (void)pio;
+    (void)program;
+    return 0;
+}
+
+uint pio_get_dreq(PIO pio, uint sm, bool is_tx) {
+    (void)pio;
+    return (is_tx ? DREQ_PIO0_TX0 : DREQ_PIO0_RX0) + sm;
+}
+
+uint8_t pio_sm_get_pc(PIO pio, uint sm) {
+    (void)pio;
+    (void)sm;
+    return 0;
+}
+
+uint pio_sm_get_tx_fifo_level(PIO pio, uint sm) {
+    (void)pio;
+    (void)sm;
+    return pio_tx.count;
+}
+
+uint pio_sm_get_rx_fifo_level(PIO pio, uint sm) {
+    (void)pio;
+    (void)sm;
+    return pio_rx.count;
+}
+
+void pio_sm_set_enabled(PIO pio, uint sm, bool enabled) {
+    (void)pio;
+    (void)sm;
+    pio_enabled = enabled;
+}
+
+void pio_set_irq0_source_enabled(PIO pio, pio_interrupt_source_t source, bool enabled) {
+    (void)pio;
+    (void)source;
+    (void)enabled;
+}
+
+bool sim_bus_write(uint8_t byte) {
+    if (!pio_enabled) return true;
+    if (fifo_full(&pio_rx)) {
+        pio_rx_overflows++;
+        return false;
+    }
+    fifo_push(&pio_rx, byte);
+    dma_run();
+    return true;
+}
+
+uint8_t sim_bus_read(void) {
+    if (!pio_enabled) return 0xFF;
+    // pull ifempty noblock: an empty FIFO copies X, the 0xFF sentinel
+    if (pio_osr_bytes == 0) {
+        pio_osr = (pio_tx.count > 0) ? fifo_pop(&pio_tx) : 0xFFFFFFFFu;
+        pio_osr_bytes = 4;
+    }
+    uint8_t byte = (uint8_t)pio_osr;
+    pio_osr >>= 8;
+    pio_osr_bytes--;
+    dma_run();
+    return byte;
+}
+
+uint32_t sim_bus_rx_overflows(void) {
+    return pio_rx_overflows;
+}
+
+// ============================================================================
+// SPI
+// ============================================================================
+
+uint spi_init(spi_inst_t *spi, uint baudrate) {
+    (void)spi;
+    // The reset empties both FIFOs
+    spi_tx.count = 0;
+    spi_rx.count = 0;
+    return baudrate;
+}
+
+void spi_set_slave(spi_inst_t *spi, bool slave) {
+    (void)spi;
+    (void)slave;
+}
+
+void spi_set_format(spi_inst_t *spi, uint data_bits, spi_cpol_t cpol, spi_cpha_t cpha,
+                    spi_order_t order) {
+    (void)spi;
+    (void)data_bits;
+    (void)cpol;
+    (void)cpha;
+    (void)order;
+}
+
+spi_hw_t *spi_get_hw(spi_inst_t *spi) {
+    (void)spi;
+    return &spi0_hw;
+}
+
+uint spi_get_dreq(spi_inst_t *spi, bool is_tx) {
+    (void)spi;
+    return is_tx ? DREQ_SPI0_TX : DREQ_SPI0_RX;
+}
+
+bool spi_is_readable(spi_inst_t *spi) {
+    (void)spi;
+    return spi_rx.count > 0;
+}
+
+uint8_t sim_spi_clock(uint8_t mosi) {
+    uint8_t miso = (spi_tx.count > 0) ? (uint8_t)fifo_pop(&spi_tx) : 0x00;
+    if (fifo_full(&spi_rx)) {
+        spi_rx_overflow_count++;
+    } else {
+        fifo_push(&spi_rx, mosi);
+    }
+    dma_run();
+    return miso;
+}
+
+uint32_t sim_spi_rx_overflows(void) {
+    return spi_rx_overflow_count;
+}
@@ -0,0 +1,47 @@
+/*
+ * Per-device latency histograms.  See latency.h.
+ */
+
+#include "latency.h"
+
+#if BRIDGE_LATENCY_STATS
+
+uint32_t lat_hist[LAT_EVENTS][BUS_MAX_DEVICES][LAT_BUCKETS];
+
+void lat_init(void) {
+    // Count every clk_sys cycle instead of the 1 us RISC-V tick.
+    sio_hw->mtime_ctrl = SIO_MTIME_CTRL_EN_BITS | SIO_MTIME_CTRL_FULLSPEED_BITS;
+}
+
+uint lat_hist_read(lat_event_t event, uint8_t device, uint8_t *dst) {
+    const uint32_t *h = lat_hist[event][device];
+    for (uint i = 0; i < LAT_BUCKETS; i++) {
+        uint32_t v = h[i];
+        dst[4 * i + 0] = (uint8_t)v;
+        dst[4 * i + 1] = (uint8_t)(v >> 8);
+        dst[4 * i + 2] = (uint8_t)(v >> 16);
+        dst[4 * i + 3] = (uint8_t)(v >> 24);
+    }
+    return LAT_BUCKETS * 4;
+}
+
+uint32_t lat_hist_count(lat_event_t event, uint8_t device) {
+    uint32_t n = 0;
+    for (uint i = 0; i < LAT_BUCKETS; i++) {
+        n += lat_hist[event][device][i];
+    }
+    return n;
+}
+
+uint lat_hist_percentile(lat_event_t event, uint8_t device, uint permille) {
+    const uint32_t *h = lat_hist[event][device];
+    uint64_t want = ((uint64_t)lat_hist_count(event, device) * permille + 999) / 1000;
+    uint64_t seen = 0;
+    for (uint i = 0; i < LAT_BUCKETS; i++) {
+        seen += h[i];
+        if (seen >= want) return i;
+    }
+    return LAT_BUCKETS - 1;
+}
+
+#endif
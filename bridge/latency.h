@@ -0,0 +1,104 @@
+/*
+ * Per-device latency histograms (BRIDGE_LATENCY_STATS builds only).
+ *
+ * Timestamps come from the SIO machine timer running in full-speed mode,
+ * so they count clk_sys cycles and read the same on both cores.  Every
+ * (event, device) pair keeps a log2 histogram: bucket n counts samples
+ * of [2^n, 2^(n+1)) cycles, and bucket 0 also takes zero.
+ *
+ * When the two ends of an event are far apart (a TLV queued now and sent
+ * much later), the start stamps wait in a lat_marks_t: a small SPSC FIFO
+ * keyed by the free-running byte position just past each TLV, settled
+ * once the consumer's position reaches it.  A full FIFO drops samples;
+ * it never delays the data path.
+ */
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdint.h>
+
+#include "bridge_defs.h"
+#include "hardware/structs/sio.h"
+#include "hardware/sync.h"
+
+typedef enum {
+    LAT_BUS_READ,       // 6502 read request parsed -> TX DMA started
+    LAT_SPI_TO_BUS,     // Zero WRITE parsed -> bytes in the device buffer
+    LAT_BUS_TO_SPI,     // TLV queued for the Zero -> READ carrying it consumed
+    LAT_EVENTS
+} lat_event_t;
+
+#define LAT_BUCKETS     32
+#define LAT_MARKS       64      // Per FIFO, must be a power of two
+
+_Static_assert((LAT_MARKS & (LAT_MARKS - 1)) == 0,
+               "LAT_MARKS must be a power of two");
+
+typedef struct {
+    uint32_t end;       // Producer byte position just past the TLV
+    uint32_t stamp;
+    uint8_t device;
+} lat_mark_t;
+
+typedef struct {
+    lat_mark_t marks[LAT_MARKS];
+    volatile uint32_t head;     // Written by producer only
+    volatile uint32_t tail;     // Written by consumer only
+} lat_marks_t;
+
+// Each event is only ever recorded from one core.
+extern uint32_t lat_hist[LAT_EVENTS][BUS_MAX_DEVICES][LAT_BUCKETS];
+
+// Start the cycle timer.  Call once, before any stamps are taken.
+void lat_init(void);
+
+// Copy one histogram into |dst| as LAT_BUCKETS little-endian u32s.
+// Returns the number of bytes written.
+uint lat_hist_read(lat_event_t event, uint8_t device, uint8_t *dst);
+
+// Total samples in one histogram.
+uint32_t lat_hist_count(lat_event_t event, uint8_t device);
+
+// Smallest bucket at or below which |permille| / 1000 of the samples lie.
+uint lat_hist_percentile(lat_event_t event, uint8_t device, uint permille);
+
+static inline uint32_t lat_now(void) {
+    return sio_hw->mtime;
+}
+
+static inline void lat_record(lat_event_t event, uint8_t device, uint32_t stamp) {
+    uint32_t cycles = lat_now() - stamp;
+    lat_hist[event][device][31 - __builtin_clz(cycles | 1)]++;
+}
+
+static inline void lat_marks_init(lat_marks_t *m) {
+    m->head = 0;
+    m->tail = 0;
+}
+
+// Producer: remember |stamp| for the TLV ending at byte position |end|.
+static inline void lat_mark(lat_marks_t *m, uint32_t end, uint8_t device,
+                            uint32_t stamp) {
+    if (m->head - m->tail >= LAT_MARKS) return;
+    lat_mark_t *k = &m->marks[m->head & (LAT_MARKS - 1)];
+    k->end = end;
+    k->stamp = stamp;
+    k->device = device;
+    __dmb();
+    m->head++;
+}
+
+// Consumer: record every mark whose TLV ends at or before position |pos|.
+static inline void lat_settle(lat_marks_t *m, lat_event_t event, uint32_t pos) {
+    while (m->tail != m->head) {
+        __dmb();
+        const lat_mark_t *k = &m->marks[m->tail & (LAT_MARKS - 1)];
+        if ((int32_t)(pos - k->end) < 0) break;
+        lat_record(event, k->device, k->stamp);
+        __dmb();
+        m->tail++;
+    }
+}
+
+#endif // LATENCY_H
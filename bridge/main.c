@@ -10,18 +10,30 @@
  *
  * IRQ lines:
  *   GPIO 20 -> Zero:  "Pico has data" (managed by spi_slave)
- *   GPIO 3  -> 6502:  "Data available for read" (managed here)
+ *   GPIO 3  -> 6502:  "Data available for read" (managed here), only for
+ *                     devices the 6502 enabled with a Device 1 'I' write
+ *
+ * USB link (BRIDGE_USB_LINK=1):
+ *   usb_link.c stands in for spi_slave.c, carrying the same TLVs over the
+ *   USB serial port to a host instead of SPI to the Zero.
+ *
+ * Dual-core (BRIDGE_DUAL_CORE=1):
+ *   Core 0 runs bus_task(); core 1 runs spi_slave_task().  TLVs cross
+ *   between the cores through two lock-free SPSC queues, so neither side
+ *   ever touches the other's buffers directly.
  *
  * Reset:
  *   GPIO 4  -> 6502:  RESB (active-low, open-drain)
  *   The Pico holds RESB low on boot and releases after initialization.
  *   Reset can be triggered by:
  *     - External falling edge on RESB (pushbutton / supervisor IC)
- *     - 6502 writing to Device 1 (soft reset)
- *   On reset, the Pico notifies the Zero via a Device 0 TLV ('R'),
- *   waits for the Zero to read it, then reboots via watchdog.
+ *     - 6502 writing to Device 1 (soft reset; an 'I' write is IRQ setup)
+ *   On reset, the Pico notifies the Zero via a Device 1 TLV ('R'),
+ *   waits for the Zero to read it, then reboots via watchdog.  With
+ *   BRIDGE_WARM_RESET it sends 'W' instead and restarts only the 6502.
  */
 
+#include <math.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -34,37 +46,444 @@
 #include "bus_interface.h"
 #include "spi_slave.h"
 
+#if BRIDGE_DUAL_CORE
+#include "pico/multicore.h"
+#include "spsc_queue.h"
+#endif
+
+#if BRIDGE_EVENT_LOOP
+#include "hardware/structs/scb.h"
+#include "hardware/sync.h"
+#endif
+
+#if BRIDGE_LATENCY_STATS
+#include "latency.h"
+#endif
+
+#if BRIDGE_NETBOOT_CACHE
+#include "pico/flash.h"
+#include "netboot_cache.h"
+#endif
+
+#if BRIDGE_BUS_CAPTURE
+#include "capture.h"
+#endif
+
+#if BRIDGE_EVENT_TRACE
+#include "events.h"
+#endif
+
 // Stats
 static uint32_t bus_to_spi_msgs = 0;
 static uint32_t bus_to_spi_bytes = 0;
 static uint32_t spi_to_bus_msgs = 0;
 static uint32_t spi_to_bus_bytes = 0;
 static uint32_t spi_to_bus_drops = 0;
+static uint32_t spi_to_bus_refused = 0;    // TLVs answered with a NAK (v8)
+static uint32_t bus_to_spi_drops = 0;
+
+#if BRIDGE_DUAL_CORE
+// Core 0 (bus) -> core 1 (SPI): TLVs written by the 6502
+static uint8_t bus_to_spi_storage[XCORE_QUEUE_SIZE];
+static spsc_queue_t bus_to_spi_queue;
+
+// Core 1 (SPI) -> core 0 (bus): TLVs written by the Zero
+static uint8_t spi_to_bus_storage[XCORE_QUEUE_SIZE];
+static spsc_queue_t spi_to_bus_queue;
+
+// Zero -> 6502 TLVs dropped because spi_to_bus_queue was full.  Kept
+// separate from spi_to_bus_drops since it is only written by core 1.
+static uint32_t xcore_drops = 0;
+
+// Device buffer bytes of the Zero -> 6502 TLVs that have gone into
+// spi_to_bus_queue (written by core 1) and out of it into the device
+// buffers (core 0), so core 1 can tell whether a TLV will fit (v8).
+static volatile uint32_t xcore_pushed[BUS_MAX_DEVICES];
+static volatile uint32_t xcore_delivered[BUS_MAX_DEVICES];
+
+static volatile bool core1_ready = false;
+
+#if BRIDGE_LATENCY_STATS
+// WRITE stamps for TLVs in spi_to_bus_queue, keyed by its head position
+static lat_marks_t spi_to_bus_lat_marks;
+#endif
+#endif
 
 // Reset
 static volatile bool reset_requested = false;
 
+// Set when either RX ring resynced and dropped data; reported to the 6502
+// (and cleared) by the next device 0 read.
+static volatile bool rx_data_lost = false;
+
+// Set when a 6502 write had no room on its way to the Zero and was
+// dropped; reported to the 6502 (and cleared) by the next device 0 read.
+static bool tx_data_lost = false;
+
+// Device of the last 6502 write bound for the Zero, for the busy bit
+static uint8_t tx_last_device = 0;
+
 // Startup banner (deferred until USB is ready)
 static bool startup_banner_printed = false;
 
+#if BRIDGE_EVENT_LOOP
 // ============================================================================
-// Device 0: local status register (not forwarded over SPI)
+// Event loop
 // ============================================================================
 
-static uint8_t device0_tx_callback(uint8_t *data, uint8_t max_len) {
-    if (max_len < 2) return 0;
+// Set from the USB stdio chars-available callback, cleared once getchar
+// runs dry, so the main loop only touches stdio when there is input.
+static volatile bool usb_chars_available = false;
 
-    // Byte 0: bitmask of devices with data available (always 0 for device 0)
+static void usb_chars_available_callback(void *param) {
+    (void)param;
+    usb_chars_available = true;
+}
+
+// Make every interrupt that goes pending set the event register (this
+// core), so an IRQ that is taken just before __wfe() still ends the sleep.
+static void event_loop_init_core(void) {
+    scb_hw->scr |= M33_SCR_SEVONPEND_BITS;
+}
+
+// Sleep until the next event, or at most EVENT_LOOP_TICK_US.
+static void event_loop_sleep(void) {
+    best_effort_wfe_or_timeout(make_timeout_time_us(EVENT_LOOP_TICK_US));
+}
+#endif
+
+// ============================================================================
+// Device 0: local status register (not forwarded over SPI)
+// ============================================================================
+
+// Bitmask of devices with data available for the 6502 (bit 0 always clear)
+static uint8_t device_avail_mask(void) {
     uint8_t avail = 0;
     for (uint8_t i = 1; i < BUS_MAX_DEVICES; i++) {
         if (bus_device_tx_count(i) > 0) {
             avail |= (1 << i);
         }
     }
-    data[0] = avail;
+    return avail;
+}
+
+// Bytes from the 6502's last device 0 ['T', bytes...] write, returned by
+// the next device 0 read instead of the status bytes, so the 6502 can check
+// that data survives the bus both ways (e.g. after a clock change).
+static uint8_t loopback_data[254];
+static int loopback_len = -1;     // -1 when no loopback is pending
+
+// Expansion RAM: Device 0 ['A', addr24] sets the address, ['S', data...]
+// stores at it and ['F', n] has the next device 0 read return n bytes from
+// it instead of the status bytes; both advance the address.  Served here,
+// without the Zero, so a page costs two bus transactions.  Left out of the
+// boot-time clear, so it keeps its contents over a reset's watchdog reboot.
+static uint8_t __uninitialized_ram(reu_mem)[BRIDGE_REU_SIZE];
+static uint32_t reu_addr;
+static int reu_fetch_len = -1;    // -1 when no fetch is pending
+
+// Copy at reu_addr, which wraps at the end, and advance it.
+static void reu_stash(const uint8_t *buf, uint16_t len) {
+    while (len) {
+        uint32_t run = BRIDGE_REU_SIZE - reu_addr;
+        if (run > len) run = len;
+        memcpy(reu_mem + reu_addr, buf, run);
+        reu_addr = (reu_addr + run) & (BRIDGE_REU_SIZE - 1);
+        buf += run;
+        len -= run;
+    }
+}
+
+static void reu_fetch(uint8_t *buf, uint16_t len) {
+    while (len) {
+        uint32_t run = BRIDGE_REU_SIZE - reu_addr;
+        if (run > len) run = len;
+        memcpy(buf, reu_mem + reu_addr, run);
+        reu_addr = (reu_addr + run) & (BRIDGE_REU_SIZE - 1);
+        buf += run;
+        len -= run;
+    }
+}
+
+// ['C', len24] has the next device 0 read return the CRC-32 (IEEE, as zlib,
+// LE) of len bytes from reu_addr, wrapping, without moving the address.  The
+// DMA sniffer belongs to the SPI slave, so in dual-core builds core 1 runs
+// it: core 0 posts the range and waits before the result is read or the
+// memory is stored to.  A full 256 KB takes about 2ms.
+static uint32_t reu_crc;
+static bool reu_crc_pending;      // A result is waiting for the next read
+#if BRIDGE_DUAL_CORE
+static volatile bool reu_crc_busy;
+static uint32_t reu_crc_addr, reu_crc_len;
+#endif
+
+static uint32_t reu_crc_range(uint32_t addr, uint32_t len) {
+    uint32_t run = BRIDGE_REU_SIZE - addr;
+    if (run > len) run = len;
+    return spi_slave_crc32(reu_mem + addr, run, reu_mem, len - run);
+}
+
+static void reu_crc_start(uint32_t len) {
+    if (len > BRIDGE_REU_SIZE) len = BRIDGE_REU_SIZE;
+    reu_crc_pending = true;
+#if BRIDGE_DUAL_CORE
+    reu_crc_addr = reu_addr;
+    reu_crc_len = len;
+    __dmb();
+    reu_crc_busy = true;
+    __sev();    // Wake core 1 if it is sleeping in __wfe()
+#else
+    reu_crc = reu_crc_range(reu_addr, len);
+#endif
+}
+
+// Core 0: wait until core 1 has finished with the range.
+static inline void reu_crc_wait(void) {
+#if BRIDGE_DUAL_CORE
+    while (reu_crc_busy) tight_loop_contents();
+    __dmb();
+#endif
+}
+
+#if BRIDGE_DUAL_CORE
+// Core 1: run a CRC core 0 posted.
+static void reu_crc_service(void) {
+    if (!reu_crc_busy) return;
+    __dmb();
+    reu_crc = reu_crc_range(reu_crc_addr, reu_crc_len);
+    __dmb();
+    reu_crc_busy = false;
+}
+#endif
+
+// Math coprocessor: Device 0 ['M', records...] runs each [op][operands]
+// record on the M33 (hardware divider and FPU), and the next device 0 read
+// returns the results back to back instead of the status bytes.  Operands
+// and results are little-endian, as on both CPUs, so they are copied as
+// they are.  The batch stops at an unknown op, a short record or a result
+// that would overflow the read.  Layouts are in protocol.md.
+enum {
+    MATH_MULU16 = 1,    // u16, u16 -> u32
+    MATH_MULS16,        // s16, s16 -> s32
+    MATH_MUL32,         // u32, u32 -> low u32 (either sign)
+    MATH_DIVU16,        // u16 n, u16 d -> u16 q, u16 r
+    MATH_DIVS16,        // s16 n, s16 d -> s16 q, s16 r
+    MATH_DIVU32,        // u32 n, u32 d -> u32 q, u32 r
+    MATH_DIVS32,        // s32 n, s32 d -> s32 q, s32 r
+    MATH_FADD,          // f32, f32 -> f32
+    MATH_FSUB,
+    MATH_FMUL,
+    MATH_FDIV,
+    MATH_FSQRT,         // f32 -> f32
+    MATH_SIN,           // u16 angle (65536 = a full turn) -> s16 (1.0 = 0x4000)
+    MATH_COS,
+    MATH_OPS
+};
+
+// Operand and result bytes per op
+static const struct {
+    uint8_t in;
+    uint8_t out;
+} math_sizes[MATH_OPS] = {
+    [MATH_MULU16] = { 4, 4 }, [MATH_MULS16] = { 4, 4 }, [MATH_MUL32] = { 8, 4 },
+    [MATH_DIVU16] = { 4, 4 }, [MATH_DIVS16] = { 4, 4 },
+    [MATH_DIVU32] = { 8, 8 }, [MATH_DIVS32] = { 8, 8 },
+    [MATH_FADD] = { 8, 4 }, [MATH_FSUB] = { 8, 4 }, [MATH_FMUL] = { 8, 4 },
+    [MATH_FDIV] = { 8, 4 }, [MATH_FSQRT] = { 4, 4 },
+    [MATH_SIN] = { 2, 2 }, [MATH_COS] = { 2, 2 },
+};
+
+static uint8_t math_results[254];
+static int math_len = -1;         // -1 when no results are pending
+
+// A divide by zero gives all ones and the dividend back, and the one
+// signed overflow (MIN / -1) gives MIN and 0, so no op can trap.
+static void math_exec(uint8_t op, const uint8_t *a, uint8_t *r) {
+    union {
+        uint16_t u16[2];
+        int16_t s16[2];
+        uint32_t u32[2];
+        int32_t s32[2];
+        float f[2];
+    } x, y;
+    memcpy(&x, a, math_sizes[op].in);
+    switch (op) {
+    case MATH_MULU16: y.u32[0] = (uint32_t)x.u16[0] * x.u16[1]; break;
+    case MATH_MULS16: y.s32[0] = (int32_t)x.s16[0] * x.s16[1]; break;
+    case MATH_MUL32:  y.u32[0] = x.u32[0] * x.u32[1]; break;
+    case MATH_DIVU16:
+        y.u16[0] = x.u16[1] ? x.u16[0] / x.u16[1] : 0xffff;
+        y.u16[1] = x.u16[1] ? x.u16[0] % x.u16[1] : x.u16[0];
+        break;
+    case MATH_DIVS16:
+        // Promoted to int, so INT16_MIN / -1 wraps back to INT16_MIN
+        y.s16[0] = (int16_t)(x.s16[1] ? x.s16[0] / x.s16[1] : -1);
+        y.s16[1] = (int16_t)(x.s16[1] ? x.s16[0] % x.s16[1] : x.s16[0]);
+        break;
+    case MATH_DIVU32:
+        y.u32[0] = x.u32[1] ? x.u32[0] / x.u32[1] : 0xffffffffu;
+        y.u32[1] = x.u32[1] ? x.u32[0] % x.u32[1] : x.u32[0];
+        break;
+    case MATH_DIVS32:
+        if (x.s32[1] == 0) {
+            y.s32[0] = -1;
+            y.s32[1] = x.s32[0];
+        } else if (x.s32[0] == INT32_MIN && x.s32[1] == -1) {
+            y.s32[0] = INT32_MIN;
+            y.s32[1] = 0;
+        } else {
+            y.s32[0] = x.s32[0] / x.s32[1];
+            y.s32[1] = x.s32[0] % x.s32[1];
+        }
+        break;
+    case MATH_FADD:  y.f[0] = x.f[0] + x.f[1]; break;
+    case MATH_FSUB:  y.f[0] = x.f[0] - x.f[1]; break;
+    case MATH_FMUL:  y.f[0] = x.f[0] * x.f[1]; break;
+    case MATH_FDIV:  y.f[0] = x.f[0] / x.f[1]; break;
+    case MATH_FSQRT: y.f[0] = sqrtf(x.f[0]); break;
+    case MATH_SIN:
+    case MATH_COS: {
+        float rad = x.u16[0] * (6.28318531f / 65536.0f);
+        y.s16[0] = (int16_t)lroundf((op == MATH_SIN ? sinf(rad) : cosf(rad)) * 16384.0f);
+        break;
+    }
+    }
+    memcpy(r, &y, math_sizes[op].out);
+}
+
+static void math_run(const uint8_t *rec, uint16_t len) {
+    uint16_t n = 0;
+    while (len > 0) {
+        uint8_t op = rec[0];
+        if (op == 0 || op >= MATH_OPS || len < 1u + math_sizes[op].in ||
+            n + math_sizes[op].out > sizeof(math_results)) {
+            break;
+        }
+        math_exec(op, rec + 1, &math_results[n]);
+        n += math_sizes[op].out;
+        rec += 1 + math_sizes[op].in;
+        len -= 1 + math_sizes[op].in;
+    }
+    math_len = n;
+}
+
+#if BRIDGE_LATENCY_STATS
+// Histogram picked by the 6502's last device 0 write ([event, device]),
+// returned (LAT_BUCKETS LE u32s) by the next device 0 read instead of the
+// status bytes.  -1 when none is selected.
+static int lat_select = -1;
+#endif
+
+static void device0_rx_callback(uint8_t device, const uint8_t *data, uint16_t len) {
+    (void)device;
+    if (len >= 1 && data[0] == 'T') {
+        uint16_t n = len - 1;
+        if (n > sizeof(loopback_data)) n = sizeof(loopback_data);
+        memcpy(loopback_data, data + 1, n);
+        loopback_len = n;
+        return;
+    }
+    if (len >= 4 && data[0] == 'A') {
+        reu_addr = (data[1] | data[2] << 8 | (uint32_t)data[3] << 16) &
+                   (BRIDGE_REU_SIZE - 1);
+        return;
+    }
+    if (len >= 1 && data[0] == 'S') {
+        reu_crc_wait();
+        reu_stash(data + 1, len - 1);
+        return;
+    }
+    if (len >= 4 && data[0] == 'C') {
+        reu_crc_wait();
+        reu_crc_start(data[1] | data[2] << 8 | (uint32_t)data[3] << 16);
+        return;
+    }
+    if (len >= 2 && data[0] == 'F') {
+        reu_fetch_len = data[1] > 254 ? 254 : data[1];
+        return;
+    }
+    if (len >= 1 && data[0] == 'M') {
+        math_run(data + 1, len - 1);
+        return;
+    }
+#if BRIDGE_LATENCY_STATS
+    if (len >= 2 && data[0] < LAT_EVENTS && data[1] < BUS_MAX_DEVICES) {
+        lat_select = data[0] * BUS_MAX_DEVICES + data[1];
+    }
+#endif
+}
+
+// A full-size write to the device the 6502 last wrote would not fit on
+// its way to the Zero right now.
+static bool bus_to_spi_busy(void) {
+#if BRIDGE_DUAL_CORE
+    return spsc_free(&bus_to_spi_queue) < 2u + 255;
+#else
+    return spi_slave_tx_queue_free(tx_last_device) < 2u + 255;
+#endif
+}
+
+static uint8_t device0_tx_callback(uint8_t *data, uint8_t max_len) {
+    if (reu_fetch_len >= 0) {
+        // Device 0 reads aren't limited, but the address only advances by n
+        uint8_t n = reu_fetch_len < max_len ? (uint8_t)reu_fetch_len : max_len;
+        reu_fetch_len = -1;
+        reu_fetch(data, n);
+        return n;
+    }
+    if (loopback_len >= 0 && max_len >= loopback_len) {
+        uint8_t n = (uint8_t)loopback_len;
+        loopback_len = -1;
+        memcpy(data, loopback_data, n);
+        return n;
+    }
+    if (math_len >= 0 && max_len >= math_len) {
+        uint8_t n = (uint8_t)math_len;
+        math_len = -1;
+        memcpy(data, math_results, n);
+        return n;
+    }
+    if (reu_crc_pending && max_len >= 4) {
+        reu_crc_pending = false;
+        reu_crc_wait();
+        data[0] = (uint8_t)reu_crc;
+        data[1] = (uint8_t)(reu_crc >> 8);
+        data[2] = (uint8_t)(reu_crc >> 16);
+        data[3] = (uint8_t)(reu_crc >> 24);
+        return 4;
+    }
+#if BRIDGE_LATENCY_STATS
+    if (lat_select >= 0 && max_len >= LAT_BUCKETS * 4) {
+        int sel = lat_select;
+        lat_select = -1;
+        return (uint8_t)lat_hist_read((lat_event_t)(sel / BUS_MAX_DEVICES),
+                                      (uint8_t)(sel % BUS_MAX_DEVICES), data);
+    }
+#endif
+    if (max_len < 2) return 0;
 
-    // Byte 1: SPI bridge connected (at least 1 command received)
+    // Byte 0: bitmask of devices with data available (always 0 for device 0)
+    data[0] = device_avail_mask();
+
+    // Byte 1: bit 0 = SPI bridge connected (at least 1 command received),
+    // bit 1 = data was lost in an RX resync since the last status read,
+    // bit 2 = the netboot cache can boot an image without the Zero,
+    // bit 3 = a write for the Zero was dropped, for want of room, since the
+    // last status read, bit 4 = busy: a 255-byte write to the device last
+    // written would not fit on its way to the Zero right now
     data[1] = spi_slave_is_connected() ? 1 : 0;
+    if (rx_data_lost) {
+        rx_data_lost = false;
+        data[1] |= 2;
+    }
+    if (tx_data_lost) {
+        tx_data_lost = false;
+        data[1] |= 8;
+    }
+    if (bus_to_spi_busy()) data[1] |= 16;
+#if BRIDGE_NETBOOT_CACHE
+    if (nbc_has_images()) data[1] |= 4;
+#endif
 
     return 2;
 }
@@ -73,27 +492,413 @@ static uint8_t device0_tx_callback(uint8_t *data, uint8_t max_len) {
 // 6502 -> Zero: bus RX callback forwards to SPI TX queue
 // ============================================================================
 
+// A write that doesn't fit is dropped, and device 0's status tells the
+// 6502 so (bit 3), as its busy bit (4) warns of it beforehand.
 static void bus_to_spi_callback(uint8_t device, const uint8_t *data, uint16_t len) {
+    tx_last_device = device;
     // Bus transfers are max 255 bytes, so len fits in uint8_t.
+#if BRIDGE_DUAL_CORE
+    // Core 1 moves the TLV into the SPI TX queue (see drain_bus_to_spi).
+    DBG_PRINTF("bus->spi: dev=%d len=%d xcore_free=%lu\n", device, len,
+               (unsigned long)spsc_free(&bus_to_spi_queue));
+    if (!spsc_push_tlv(&bus_to_spi_queue, device, data, (uint8_t)len)) {
+        DBG_PRINTF("bus->spi: queue full, dropping\n");
+        bus_to_spi_drops++;
+        tx_data_lost = true;
+        return;
+    }
+#else
     // Check space upfront so each bus message is queued atomically.
-    uint free = spi_slave_tx_queue_free();
+    uint free = spi_slave_tx_queue_free(device);
     DBG_PRINTF("bus->spi: dev=%d len=%d free=%d\n", device, len, free);
     if (free < len + 2) {
-        printf("bus->spi: queue full, dropping\n");
+        DBG_PRINTF("bus->spi: queue full, dropping\n");
+        bus_to_spi_drops++;
+        tx_data_lost = true;
         return;
     }
     spi_slave_tx_queue_tlv(device, data, (uint8_t)len);
+#endif
 
     bus_to_spi_msgs++;
     bus_to_spi_bytes += len;
 }
 
+#if BRIDGE_NETBOOT_CACHE
+// Device 3: a netboot request the flash cache answers itself stays here;
+// the rest go to the Zero, tagged with the hash of any cached copy.
+static void netboot_rx_callback(uint8_t device, const uint8_t *data, uint16_t len) {
+    uint8_t fwd[255 + 5];
+    uint16_t fwd_len;
+    if (!nbc_request(data, len, spi_slave_is_connected(), fwd, &fwd_len)) {
+        bus_to_spi_callback(device, fwd, fwd_len);
+    }
+}
+
+#endif
+
 // ============================================================================
-// Device 1: system control (soft reset)
+// Ring occupancy report
 // ============================================================================
 
+static void print_ring(const char *name, const ring_stats_t *r) {
+    printf(" %s=%lu/%lu %lums", name, (unsigned long)r->peak,
+           (unsigned long)r->size,
+           (unsigned long)(ring_stats_above_us(r) / 1000));
+}
+
+// Peak fill / size and ms spent at or above RING_HIGH_PCT for every ring.
+static void print_ring_stats(const bus_stats_t *bs, const spi_slave_stats_t *ss) {
+    printf("       rings (peak/size, ms>=%d%%):", RING_HIGH_PCT);
+    print_ring("bus_rx", &bs->rx_ring);
+    print_ring("spi_rx", &ss->rx_ring);
+    print_ring("spi_txq", &ss->tx_queue);
+    printf("\n       dev bufs:");
+    for (uint8_t d = 1; d < BUS_MAX_DEVICES; d++) {
+        char name[4] = { 'd', (char)('0' + d), 0 };
+        print_ring(name, &bs->tx_buffers[d]);
+    }
+    printf("\n");
+}
+
+// ============================================================================
+// Telemetry: binary stats snapshot for the Zero
+// ============================================================================
+
+#define TELEMETRY_VERSION   4
+
+static uint8_t *put_u16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    return p + 2;
+}
+
+static uint8_t *put_u32(uint8_t *p, uint32_t v) {
+    p = put_u16(p, (uint16_t)v);
+    return put_u16(p, (uint16_t)(v >> 16));
+}
+
+// Queue a Device 0 telemetry TLV:
+//   [status][0x00][version][fields...]
+// The status byte matches a device 0 read, and the 0x00 marker tells the
+// Zero this is not a plain-text error string.  Layout is in protocol.md.
+static void send_telemetry(uint32_t now) {
+    bus_stats_t bs = bus_get_stats();
+    spi_slave_stats_t ss = spi_slave_get_stats();
+    bus_diag_t diag = bus_get_diag();
+
+    uint8_t msg[174];
+    uint8_t *p = msg;
+    *p++ = device_avail_mask();
+    *p++ = 0x00;
+    *p++ = TELEMETRY_VERSION;
+
+    p = put_u32(p, now);
+    p = put_u32(p, bus_to_spi_msgs);
+    p = put_u32(p, bus_to_spi_bytes);
+    p = put_u32(p, spi_to_bus_msgs);
+    p = put_u32(p, spi_to_bus_bytes);
+#if BRIDGE_DUAL_CORE
+    p = put_u32(p, spi_to_bus_drops + xcore_drops);
+#else
+    p = put_u32(p, spi_to_bus_drops);
+#endif
+
+    p = put_u32(p, bs.rx_bytes);
+    p = put_u32(p, bs.tx_bytes);
+    p = put_u32(p, bs.rx_dma_overruns);
+    p = put_u32(p, bs.rx_bankruptcies);
+    p = put_u32(p, bs.tx_empty_reads);
+
+    p = put_u32(p, ss.rx_writes);
+    p = put_u32(p, ss.rx_bytes);
+    p = put_u32(p, ss.tx_reads);
+    p = put_u32(p, ss.tx_bytes);
+    p = put_u32(p, ss.requests);
+    p = put_u32(p, ss.proto_errors);
+    p = put_u32(p, ss.rx_dma_overruns);
+
+    p = put_u16(p, (uint16_t)bs.rx_ring.peak);
+    p = put_u16(p, (uint16_t)ss.tx_queue.peak);
+    for (uint8_t d = 0; d < BUS_MAX_DEVICES; d++) {
+        p = put_u16(p, bus_device_tx_count(d));
+    }
+    for (uint8_t d = 0; d < BUS_MAX_DEVICES; d++) {
+        p = put_u16(p, (uint16_t)bs.tx_buffers[d].peak);
+    }
+
+    *p++ = diag.pc;
+    *p++ = diag.tx_fifo;
+    *p++ = diag.rx_fifo;
+    *p++ = diag.proto_state;
+    *p++ = (BRIDGE_DUAL_CORE ? 0x01 : 0) | (BRIDGE_EVENT_LOOP ? 0x02 : 0) |
+           (BRIDGE_LATENCY_STATS ? 0x04 : 0) | (BRIDGE_BUS_CAPTURE ? 0x08 : 0) |
+           (BRIDGE_EVENT_TRACE ? 0x10 : 0) | (BRIDGE_USB_LINK ? 0x20 : 0);
+
+    // Version 2: SPI RX ring peak, then ms spent above RING_HIGH_PCT
+    p = put_u16(p, (uint16_t)ss.rx_ring.peak);
+    p = put_u32(p, ring_stats_above_us(&bs.rx_ring) / 1000);
+    p = put_u32(p, ring_stats_above_us(&ss.rx_ring) / 1000);
+    p = put_u32(p, ring_stats_above_us(&ss.tx_queue) / 1000);
+    for (uint8_t d = 0; d < BUS_MAX_DEVICES; d++) {
+        p = put_u32(p, ring_stats_above_us(&bs.tx_buffers[d]) / 1000);
+    }
+
+    // Version 3: bytes dropped by bus RX resyncs
+    p = put_u32(p, bs.rx_bytes_lost);
+
+    // Version 4: 6502 writes dropped for want of room, TLVs NAKed (v8)
+    p = put_u32(p, bus_to_spi_drops);
+    p = put_u32(p, spi_to_bus_refused);
+
+    uint8_t len = (uint8_t)(p - msg);
+#if BRIDGE_DUAL_CORE
+    spsc_push_tlv(&bus_to_spi_queue, 0x00, msg, len);
+#else
+    spi_slave_tx_queue_tlv(0x00, msg, len);
+#endif
+}
+
+#if BRIDGE_LATENCY_STATS
+// ============================================================================
+// Latency histograms
+// ============================================================================
+
+static const char *const lat_event_names[LAT_EVENTS] = {
+    "bus_read", "zero->6502", "6502->zero",
+};
+
+// Sample counts as of the last report, so only histograms that changed
+// are printed and sent again.
+static uint32_t lat_reported[LAT_EVENTS][BUS_MAX_DEVICES];
+
+// Print a p50/p99 summary and send each changed histogram to the Zero as
+// a Device 1 ['L', event, device, buckets...] TLV.  Reports only go out
+// while the SPI TX queue is at most half full, so they never crowd out
+// 6502 traffic; whatever is skipped goes out next interval.
+static void report_latency(void) {
+    uint8_t msg[3 + LAT_BUCKETS * 4];
+    msg[0] = 'L';
+    for (uint e = 0; e < LAT_EVENTS; e++) {
+        for (uint8_t d = 0; d < BUS_MAX_DEVICES; d++) {
+            uint32_t n = lat_hist_count((lat_event_t)e, d);
+            if (n == lat_reported[e][d]) continue;
+
+#if BRIDGE_DUAL_CORE
+            if (spsc_free(&bus_to_spi_queue) < XCORE_QUEUE_SIZE / 2) return;
+#else
+            if (spi_slave_tx_queue_free(0x01) < (1u << SPI_DEV1_LANE_BITS) / 2) return;
+#endif
+            printf("       lat %s dev%d: n=%lu p50<2^%u p99<2^%u cycles\n",
+                   lat_event_names[e], d, (unsigned long)n,
+                   lat_hist_percentile((lat_event_t)e, d, 500) + 1,
+                   lat_hist_percentile((lat_event_t)e, d, 990) + 1);
+
+            msg[1] = (uint8_t)e;
+            msg[2] = d;
+            lat_hist_read((lat_event_t)e, d, &msg[3]);
+#if BRIDGE_DUAL_CORE
+            spsc_push_tlv(&bus_to_spi_queue, 0x01, msg, sizeof(msg));
+#else
+            spi_slave_tx_queue_tlv(0x01, msg, sizeof(msg));
+#endif
+            lat_reported[e][d] = n;
+        }
+    }
+}
+#endif
+
+// ============================================================================
+// RX loss reporting
+// ============================================================================
+
+// Core 0: the bus RX ring resynced.  Tell the Zero with a Device 0 error
+// string and flag the loss for the 6502's next status read.
+static void bus_rx_loss_callback(uint32_t bytes_lost, bool bankrupt) {
+    char msg[48];
+    int n = snprintf(msg, sizeof(msg), "6502 RX %s, %lu bytes lost",
+                     bankrupt ? "bankruptcy" : "overrun", (unsigned long)bytes_lost);
+#if BRIDGE_DUAL_CORE
+    spsc_push_tlv(&bus_to_spi_queue, 0x00, (const uint8_t *)msg, (uint8_t)n);
+#else
+    spi_slave_tx_queue_tlv(0x00, (const uint8_t *)msg, (uint8_t)n);
+#endif
+    rx_data_lost = true;
+}
+
+// SPI core: the SPI RX ring resynced (spi_slave already told the Zero).
+static void spi_rx_loss_callback(uint32_t bytes_lost) {
+    (void)bytes_lost;
+    rx_data_lost = true;
+}
+
+// ============================================================================
+// 6502 Clock management
+// ============================================================================
+
+// Speeds Device 1 ['C', mhz] may select, with the matching PIO sample delay
+static const struct {
+    uint8_t mhz;
+    uint8_t sample_delay;
+} clk_6502_speeds[] = CLK_6502_SPEEDS;
+
+static uint32_t clk_6502_hz = CLK_SPEED_6502;
+
+// Retune the PWM for |hz|.  TOP and the compare level are double-buffered,
+// so the change lands at the end of the current 6502 cycle without a runt
+// pulse.
+static void set_6502_clock_hz(uint32_t hz) {
+    // Assuming divider = 1.0: wrap = (f_sys / f_pwm) - 1
+    uint32_t f_sys = clock_get_hz(clk_sys);
+    uint32_t wrap = (f_sys / hz) - 1;
+    assert(wrap <= 0xffff);  // Wrap is 16 bits, so max PWM frequency is f_sys / 65536
+
+    pwm_set_wrap(pwm_gpio_to_slice_num(PIN_6502_OSC), (uint16_t)wrap);
+    // Set a 50% duty cycle
+    pwm_set_gpio_level(PIN_6502_OSC, (uint16_t)((wrap + 1) / 2));
+    clk_6502_hz = hz;
+}
+
+static void setup_6502_clock(void) {
+    gpio_set_function(PIN_6502_OSC, GPIO_FUNC_PWM);
+    uint slice_num = pwm_gpio_to_slice_num(PIN_6502_OSC);
+
+    // Configure the PWM slice
+    pwm_config config = pwm_get_default_config();
+    pwm_config_set_clkdiv(&config, 1.0f); // Fixed 1.0 divider for zero jitter
+    pwm_init(slice_num, &config, /*start=*/false);
+    set_6502_clock_hz(CLK_SPEED_6502);
+
+    pwm_set_enabled(slice_num, true);
+}
+
+// Device 1 ['C', mhz].  The PIO sample delay must suit both clocks while
+// they change over, so a shorter delay goes in before speeding up and a
+// longer one only after slowing down.  Unsupported speeds leave the clock
+// alone and tell the Zero.
+static void change_6502_clock(uint8_t mhz) {
+    for (uint i = 0; i < count_of(clk_6502_speeds); i++) {
+        if (clk_6502_speeds[i].mhz != mhz) continue;
+        uint32_t hz = (uint32_t)mhz * 1000000u;
+        if (hz > clk_6502_hz) {
+            bus_set_sample_delay(clk_6502_speeds[i].sample_delay);
+            set_6502_clock_hz(hz);
+        } else {
+            set_6502_clock_hz(hz);
+            bus_set_sample_delay(clk_6502_speeds[i].sample_delay);
+        }
+        DBG_PRINTF("6502 clock: %u MHz\n", mhz);
+        return;
+    }
+
+    char msg[40];
+    int n = snprintf(msg, sizeof(msg), "6502 clock %u MHz unsupported", mhz);
+#if BRIDGE_DUAL_CORE
+    spsc_push_tlv(&bus_to_spi_queue, 0x00, (const uint8_t *)msg, (uint8_t)n);
+#else
+    spi_slave_tx_queue_tlv(0x00, (const uint8_t *)msg, (uint8_t)n);
+#endif
+}
+
+#if BRIDGE_BUS_CAPTURE
+// ============================================================================
+// Bus capture
+// ============================================================================
+
+// Send the next TLV of a finished capture to the Zero on Device 1.  Like
+// the latency reports, a capture only goes out while the SPI TX queue is
+// at most half full, a TLV per loop.
+static void send_capture(void) {
+    cap_task();
+#if BRIDGE_DUAL_CORE
+    if (spsc_free(&bus_to_spi_queue) < XCORE_QUEUE_SIZE / 2) return;
+#else
+    if (spi_slave_tx_queue_free(0x01) < (1u << SPI_DEV1_LANE_BITS) / 2) return;
+#endif
+    uint8_t msg[CAP_REPORT_MAX];
+    uint len = cap_report(msg, (uint16_t)(clk_6502_hz / 1000));
+    if (len == 0) return;
+#if BRIDGE_DUAL_CORE
+    spsc_push_tlv(&bus_to_spi_queue, 0x01, msg, (uint8_t)len);
+#else
+    spi_slave_tx_queue_tlv(0x01, msg, (uint8_t)len);
+#endif
+}
+#endif
+
+#if BRIDGE_EVENT_TRACE
+// ============================================================================
+// Trace events
+// ============================================================================
+
+// Send the next batch of bridge events to the Zero on Device 1, held back
+// like a capture while the SPI TX queue is more than half full.
+static void send_events(void) {
+#if BRIDGE_DUAL_CORE
+    if (spsc_free(&bus_to_spi_queue) < XCORE_QUEUE_SIZE / 2) return;
+#else
+    if (spi_slave_tx_queue_free(0x01) < (1u << SPI_DEV1_LANE_BITS) / 2) return;
+#endif
+    uint8_t msg[EVT_REPORT_MAX];
+    uint len = evt_report(msg);
+    if (len == 0) return;
+#if BRIDGE_DUAL_CORE
+    spsc_push_tlv(&bus_to_spi_queue, 0x01, msg, (uint8_t)len);
+#else
+    spi_slave_tx_queue_tlv(0x01, msg, (uint8_t)len);
+#endif
+}
+#endif
+
+// ============================================================================
+// Device 1: system control (soft reset, IRQ mask, 6502 clock, local echo)
+// ============================================================================
+
+// Devices whose pending data asserts the 6502 IRQ line (bit n = device n).
+// Zero until the 6502 opts in, so polling programs never see an IRQ.
+static volatile uint8_t irq_6502_mask = 0;
+
+// Per-device IRQ coalescing thresholds (IRQ_COALESCE), used by
+// update_6502_irq().
+typedef struct {
+    uint16_t bytes;
+    uint16_t us;
+} irq_coalesce_t;
+
+static const irq_coalesce_t irq_coalesce_defaults[BUS_MAX_DEVICES] = IRQ_COALESCE;
+static irq_coalesce_t irq_coalesce[BUS_MAX_DEVICES] = IRQ_COALESCE;
+
+static uint16_t get_le16(const uint8_t *p) {
+    return (uint16_t)(p[0] | p[1] << 8);
+}
+
+// ['I', mask] or ['I', mask, read_limit] configures the 6502 IRQ, ['Q',
+// device, bytes (LE16), us (LE16)] its coalescing for one device, ['C',
+// mhz] the 6502 clock and ['E', mask] the local echo; any other write is a
+// soft reset.
 static void device1_rx_callback(uint8_t device, const uint8_t *data, uint16_t len) {
-    (void)device; (void)data; (void)len;
+    (void)device;
+    if (len >= 2 && data[0] == 'I') {
+        irq_6502_mask = data[1] & ~1u;     // Device 0 never has buffered data
+        bus_set_read_limit(len >= 3 ? data[2] : 0);
+        return;
+    }
+    if (len >= 6 && data[0] == 'Q') {
+        if (data[1] < BUS_MAX_DEVICES) {
+            uint16_t bytes = get_le16(&data[2]);
+            irq_coalesce[data[1]].bytes = bytes ? bytes : 1;
+            irq_coalesce[data[1]].us = get_le16(&data[4]);
+        }
+        return;
+    }
+    if (len >= 2 && data[0] == 'C') {
+        change_6502_clock(data[1]);
+        return;
+    }
+    if (len >= 2 && data[0] == 'E') {
+        bus_set_loopback(data[1] & ~3u);   // Devices 0 and 1 stay local
+        return;
+    }
     reset_requested = true;
 }
 
@@ -101,43 +906,430 @@ static void device1_rx_callback(uint8_t device, const uint8_t *data, uint16_t le
 // Zero -> 6502: SPI RX callback parses TLV and writes to bus device buffers
 // ============================================================================
 
+// Most TLVs one WRITE payload can carry (each is at least 3 bytes)
+#define SPI_TLV_BATCH   (SPI_SLAVE_MAX_PAYLOAD / 3)
+
+// Deliver a batch of Zero -> 6502 TLVs into the bus device buffers.  A
+// device that can't take all of its TLVs in the batch drops all of them.
+static void spi_to_bus_writev(const bus_tlv_t *tlvs, uint count) {
+    uint8_t dropped = bus_device_writev(tlvs, count);
+    for (uint i = 0; i < count; i++) {
+        if (dropped & (1u << tlvs[i].device)) {
+            spi_to_bus_drops++;
+        } else {
+            spi_to_bus_bytes += tlvs[i].len;
+        }
+#if BRIDGE_NETBOOT_CACHE
+        if (tlvs[i].device == 3) {
+            nbc_capture(tlvs[i].data, tlvs[i].len, !(dropped & (1u << 3)));
+        }
+#endif
+    }
+    spi_to_bus_msgs += count;
+    DBG_PRINTF("spi_rx batch: %u TLVs, dropped mask=0x%02x\n", count, dropped);
+}
+
+// Zero -> Pico Device 0 TLVs, which are for the Pico itself (core 0):
+// ['Z', device, out_len LE16, sequences...] is compressed data for a
+// device buffer, ['P', ...] a link training probe, ['N', ...] a netboot
+// cache reply and ['B', trigger, arg LE16] arms a bus capture.
+static void zero_control_rx(const uint8_t *data, uint8_t len) {
+    if (data[0] == 'P') {
+        // Echoed as it came, on Device 1, for the Zero to check.
+#if BRIDGE_DUAL_CORE
+        spsc_push_tlv(&bus_to_spi_queue, 0x01, data, len);
+#else
+        spi_slave_tx_queue_tlv(0x01, data, len);
+#endif
+        return;
+    }
+    if (len >= 4 && data[0] == 'Z') {
+        uint8_t device = data[1];
+        uint16_t out_len = (uint16_t)(data[2] | data[3] << 8);
+        bool ok = device > 0 &&
+                  bus_device_write_lz(device, data + 4, len - 4, out_len);
+        if (ok) {
+            spi_to_bus_bytes += out_len;
+        } else {
+            spi_to_bus_drops++;
+        }
+        spi_to_bus_msgs++;
+#if BRIDGE_NETBOOT_CACHE
+        if (device == 3) {
+            uint8_t plain[BUS_LZ_MAX_OUT];
+            ok = ok && out_len <= sizeof(plain);
+            if (ok) bus_device_copy_last(3, plain, out_len);
+            nbc_capture(plain, out_len, ok);
+        }
+#endif
+        return;
+    }
+    if (data[0] == 'X') {
+        // Push to run: reset the 6502 as its button would.
+        reset_requested = true;
+        return;
+    }
+#if BRIDGE_BUS_CAPTURE
+    if (len >= 4 && data[0] == 'B') {
+        cap_arm(data[1], (uint16_t)(data[2] | data[3] << 8));
+        return;
+    }
+#endif
+#if BRIDGE_EVENT_TRACE
+    if (len >= 2 && data[0] == 'T') {
+        evt_enable(data[1] != 0);
+        return;
+    }
+#endif
+#if BRIDGE_NETBOOT_CACHE
+    if (data[0] == 'N') nbc_reply(data, len);
+#endif
+}
+
+// ============================================================================
+// TLV NAKs (protocol v8)
+// ============================================================================
+//
+// Each Zero -> 6502 TLV for device d (a 'Z' TLV counts for the device it
+// fills) takes the next of d's 8-bit sequence numbers.  Numbering starts
+// when the Zero's Device 0 ['D', d, seq, epoch] marker says what the next
+// TLV's is; until then a TLV without room is dropped, as before v8.  Once
+// numbered, a TLV without room starts refusing d: it and every d TLV after
+// it are dropped and answered with a Device 1 ['D', d, seq, epoch] NAK
+// naming the first, until a marker carrying that epoch says the Zero has
+// gone back to it.  Refused bytes count as freed in the credits, since the
+// Zero charged them to its estimate.  Core 1 state.
+
+static uint8_t tlv_version;                 // Framing the state is for
+static uint8_t tlv_seq[BUS_MAX_DEVICES];    // Next TLV's number
+static uint8_t tlv_synced;                  // Device masks
+static uint8_t tlv_refusing;
+static uint8_t tlv_nak_due;
+static uint8_t tlv_nak_seq[BUS_MAX_DEVICES];
+static uint8_t tlv_nak_epoch[BUS_MAX_DEVICES];
+static uint16_t tlv_refused_bytes[BUS_MAX_DEVICES];
+
+// Forget the numbering when the framing changes; a v8 Zero marks every
+// device again once it sees the ack.
+static void tlv_check_version(void) {
+    uint8_t version = spi_slave_proto_version();
+    if (version == tlv_version) return;
+    tlv_version = version;
+    tlv_synced = 0;
+    tlv_refusing = 0;
+    tlv_nak_due = 0;
+}
+
+// Number a TLV that costs |cost| bytes of |device|'s buffer, and say
+// whether to deliver it: |fits| is whether there is room for it.
+static bool tlv_admit(uint8_t device, uint16_t cost, bool fits) {
+    uint8_t bit = (uint8_t)(1u << device);
+    if (!(tlv_synced & bit)) return true;
+    uint8_t seq = tlv_seq[device]++;
+    if (!(tlv_refusing & bit)) {
+        if (fits) return true;
+        tlv_refusing |= bit;
+        tlv_nak_seq[device] = seq;
+        tlv_nak_epoch[device]++;
+    }
+    tlv_nak_due |= bit;
+    tlv_refused_bytes[device] += cost;
+    spi_to_bus_refused++;
+    return false;
+}
+
+// The Zero's ['D', device, seq, epoch] marker: the next TLV for |device|
+// is number seq.  One for an earlier refusal than the current is stale.
+static void tlv_resume(const uint8_t *data, uint8_t len) {
+    if (len < 4 || tlv_version < SPI_PROTO_V8) return;
+    uint8_t device = data[1];
+    if (device == 0 || device >= BUS_MAX_DEVICES) return;
+    uint8_t bit = (uint8_t)(1u << device);
+    if ((tlv_refusing & bit) && data[3] != tlv_nak_epoch[device]) return;
+    tlv_refusing &= (uint8_t)~bit;
+    tlv_nak_due &= (uint8_t)~bit;
+    tlv_synced |= bit;
+    tlv_seq[device] = data[2];
+}
+
+// Queue the NAKs owed, as Device 1 lane room allows.
+static void tlv_nak_flush(void) {
+    while (tlv_nak_due && spi_slave_tx_queue_free(1) >= 2 + 4) {
+        uint8_t device = (uint8_t)__builtin_ctz(tlv_nak_due);
+        uint8_t nak[4] = { 'D', device, tlv_nak_seq[device], tlv_nak_epoch[device] };
+        spi_slave_tx_queue_tlv(0x01, nak, sizeof(nak));
+        tlv_nak_due &= (uint8_t)~(1u << device);
+    }
+}
+
+// Credit counts for the SPI slave: refused bytes are free again too.
+static uint16_t device_freed(uint8_t device) {
+    return (uint16_t)(bus_device_tx_freed(device) + tlv_refused_bytes[device]);
+}
+
+// The device a 'Z' TLV fills, or 0 if it isn't one.
+static uint8_t ztlv_device(const uint8_t *data, uint8_t len) {
+    if (len < 4 || data[0] != 'Z') return 0;
+    return data[1] < BUS_MAX_DEVICES ? data[1] : 0;
+}
+
+#if BRIDGE_DUAL_CORE
+// Room left in |device|'s buffer once the TLVs core 0 has yet to deliver
+// land.  delivered is read first: core 0 adds to it only after the bytes
+// are in the buffer, so they are never counted in neither place.
+static uint32_t xcore_room(uint8_t device) {
+    uint32_t delivered = xcore_delivered[device];
+    __dmb();
+    uint32_t free_bytes = bus_device_tx_free(device);
+    uint32_t in_flight = xcore_pushed[device] - delivered;
+    return free_bytes > in_flight ? free_bytes - in_flight : 0;
+}
+#endif
+
 static void spi_rx_callback(const uint8_t *data, uint16_t len) {
+#if BRIDGE_LATENCY_STATS
+    uint32_t stamp = lat_now();
+#endif
+#if !BRIDGE_DUAL_CORE
+    static bus_tlv_t batch[SPI_TLV_BATCH];
+    uint16_t batch_cost[BUS_MAX_DEVICES] = { 0 };
+    uint count = 0;
+#endif
+    tlv_check_version();
     uint16_t pos = 0;
     while (pos + 2 <= len) {
         uint8_t device = data[pos];
         uint8_t tlv_len = data[pos + 1];
+        const uint8_t *tlv = &data[pos + 2];
         DBG_PRINTF("SPI RX: device=%d, tlv_len=%d\n", device, tlv_len);
         if (pos + 2 + tlv_len > len) break;
-        if (device > 0 && device < BUS_MAX_DEVICES && tlv_len > 0) {
-            uint16_t written = bus_device_write(device, &data[pos + 2], tlv_len);
-            DBG_PRINTF("dev%d after spi_rx: written=%d, buf_count=%d\n",
-                        device, written, bus_device_tx_count(device));
-            if (written < tlv_len) {
-                spi_to_bus_drops++;
+        pos += 2 + tlv_len;
+        if (device >= BUS_MAX_DEVICES || tlv_len == 0) continue;
+        if (device == 0 && tlv[0] == 'D') {
+            tlv_resume(tlv, tlv_len);
+            continue;
+        }
+        // A 'Z' TLV is numbered, and costs, for the device it fills.
+        uint8_t target = device ? device : ztlv_device(tlv, tlv_len);
+        uint16_t cost = device ? tlv_len
+                        : target ? (uint16_t)(tlv[2] | tlv[3] << 8) : 0;
+#if !BRIDGE_DUAL_CORE
+        // Device 0 TLVs can fill device buffers too, so the batch so far
+        // goes first to keep every device's bytes in order.
+        if (device == 0) {
+            if (count > 0) {
+                spi_to_bus_writev(batch, count);
+#if BRIDGE_LATENCY_STATS
+                for (uint i = 0; i < count; i++) {
+                    lat_record(LAT_SPI_TO_BUS, batch[i].device, stamp);
+                }
+#endif
+                count = 0;
+                memset(batch_cost, 0, sizeof(batch_cost));
             }
-            spi_to_bus_msgs++;
-            spi_to_bus_bytes += written;
+            if (target == 0 ||
+                tlv_admit(target, cost, bus_device_tx_free(target) >= cost)) {
+                zero_control_rx(tlv, tlv_len);
+            }
+            continue;
         }
-        pos += 2 + tlv_len;
+        if (tlv_admit(device, cost,
+                      bus_device_tx_free(device) >= batch_cost[device] + cost)) {
+            batch[count++] = (bus_tlv_t){ tlv, device, tlv_len };
+            batch_cost[device] += cost;
+        }
+#else
+        // Dual-core, device 0 TLVs cross to core 0 in order with the rest.
+        if (target != 0) {
+            bool fits = spsc_free(&spi_to_bus_queue) >= 2u + tlv_len &&
+                        xcore_room(target) >= cost;
+            if (!tlv_admit(target, cost, fits)) continue;
+        }
+#if BRIDGE_LATENCY_STATS
+        // Mark before publishing, so core 0 can't consume the TLV first.
+        if (spsc_free(&spi_to_bus_queue) >= 2u + tlv_len) {
+            lat_mark(&spi_to_bus_lat_marks, spi_to_bus_queue.head + 2 + tlv_len,
+                     device, stamp);
+        }
+#endif
+        if (!spsc_push_tlv(&spi_to_bus_queue, device, tlv, tlv_len)) {
+            xcore_drops++;
+        } else if (target != 0) {
+            xcore_pushed[target] += cost;
+        }
+#endif
+    }
+#if !BRIDGE_DUAL_CORE
+    if (count > 0) {
+        spi_to_bus_writev(batch, count);
+#if BRIDGE_LATENCY_STATS
+        for (uint i = 0; i < count; i++) {
+            lat_record(LAT_SPI_TO_BUS, batch[i].device, stamp);
+        }
+#endif
     }
+#endif
+    tlv_nak_flush();
 }
 
+#if BRIDGE_DUAL_CORE
+// ============================================================================
+// Cross-core plumbing
+// ============================================================================
+
+// Core 0: move TLVs that core 1 received from the Zero into the bus
+// device buffers, a payload's worth per batch.  The queue space is only
+// released after the batch lands, so device_buf_free() on core 1 never
+// sees the bytes in neither place.
+static void drain_spi_to_bus(void) {
+    static uint8_t buf[SPI_SLAVE_MAX_PAYLOAD];
+    static bus_tlv_t batch[SPI_TLV_BATCH];
+    uint8_t device, len;
+    for (;;) {
+        uint count = 0;
+        uint32_t offset = 0, used = 0;
+        while (count < SPI_TLV_BATCH &&
+               spsc_peek_tlv_at(&spi_to_bus_queue, offset, &device, &len)) {
+            if (device == 0) {
+                // Handled in order: deliver the batch before it first.
+                if (count > 0) break;
+                spsc_read_at(&spi_to_bus_queue, 2, buf, len);
+                spsc_consume(&spi_to_bus_queue, 2u + len);
+                zero_control_rx(buf, len);
+                uint8_t target = ztlv_device(buf, len);
+                if (target != 0) {
+                    __dmb();
+                    xcore_delivered[target] += (uint16_t)(buf[2] | buf[3] << 8);
+                }
+                continue;
+            }
+            if (used + len > sizeof(buf)) break;
+            spsc_read_at(&spi_to_bus_queue, offset + 2, &buf[used], len);
+            batch[count++] = (bus_tlv_t){ &buf[used], device, len };
+            used += len;
+            offset += 2u + len;
+        }
+        if (count == 0) return;
+
+        spi_to_bus_writev(batch, count);
+        __dmb();
+        for (uint i = 0; i < count; i++) {
+            xcore_delivered[batch[i].device] += batch[i].len;
+        }
+        spsc_consume(&spi_to_bus_queue, offset);
+#if BRIDGE_LATENCY_STATS
+        lat_settle(&spi_to_bus_lat_marks, LAT_SPI_TO_BUS, spi_to_bus_queue.tail);
+#endif
+    }
+}
+
+// Core 1: move TLVs written by the 6502 into the SPI TX queue.  Packets
+// that don't fit yet stay in the cross-core queue until a READ frees room.
+static void drain_bus_to_spi(void) {
+    uint8_t device, len;
+    uint8_t buf[255];
+    while (spsc_peek_tlv(&bus_to_spi_queue, &device, &len)) {
+        if (spi_slave_tx_queue_free(device) < (uint)len + 2) break;
+        spsc_pop_tlv(&bus_to_spi_queue, buf, len);
+        spi_slave_tx_queue_tlv(device, buf, len);
+    }
+}
+
+#if BRIDGE_EVENT_LOOP
+// Core 1: true if drain_bus_to_spi() could move a TLV right now.  One that
+// doesn't fit waits for a READ, whose CS edge wakes the core anyway.
+static bool bus_to_spi_ready(void) {
+    uint8_t device, len;
+    return spsc_peek_tlv(&bus_to_spi_queue, &device, &len) &&
+           spi_slave_tx_queue_free(device) >= (uint)len + 2;
+}
+#endif
+
+// BUF estimate for the Zero: bytes still sitting in spi_to_bus_queue will
+// land in some device buffer shortly, so count them as already used.
+static uint16_t device_buf_free(uint8_t device) {
+    uint16_t free_bytes = bus_device_tx_free(device);
+    uint32_t in_flight = spsc_count(&spi_to_bus_queue);
+    return (free_bytes > in_flight) ? (uint16_t)(free_bytes - in_flight) : 0;
+}
+
+// Core 1 entry point.  The SPI slave's DMA and CS-edge interrupts are
+// delivered to the core that enables them, so initializing here keeps
+// every piece of SPI slave state local to core 1.
+static void core1_main(void) {
+#if BRIDGE_EVENT_LOOP
+    event_loop_init_core();
+#endif
+#if BRIDGE_NETBOOT_CACHE
+    // Let core 0 park this core while it writes the netboot cache.
+    flash_safe_execute_core_init();
+#endif
+    gpio_set_irq_callback(spi_slave_gpio_irq);
+    irq_set_enabled(IO_IRQ_BANK0, true);
+
+    if (!spi_slave_init()) {
+        printf("ERROR: spi_slave_init failed\n");
+        for (;;) tight_loop_contents();
+    }
+    spi_slave_set_rx_callback(spi_rx_callback);
+    spi_slave_set_rx_loss_callback(spi_rx_loss_callback);
+    spi_slave_set_buf_free_fn(device_buf_free);
+    spi_slave_set_freed_fn(device_freed);
+    core1_ready = true;
+
+    while (1) {
+        drain_bus_to_spi();
+        spi_slave_task();
+        tlv_nak_flush();
+        reu_crc_service();
+#if BRIDGE_EVENT_LOOP
+        if (spi_slave_idle() && !bus_to_spi_ready() && !reu_crc_busy) {
+            event_loop_sleep();
+        }
+#endif
+    }
+}
+#endif
+
 // ============================================================================
 // 6502 IRQ management
 // ============================================================================
 
 static bool irq_6502_asserted = false;
 
+// time_us_32() when each device's buffer last went from empty to not,
+// and which devices have data waiting on that clock.
+static uint32_t irq_pending_since[BUS_MAX_DEVICES];
+static uint8_t irq_pending_mask = 0;
+
+// Level-triggered, with hysteresis: asserted once any device enabled in
+// irq_6502_mask reaches its coalescing threshold, then held low while any
+// of them has bytes buffered, so the 6502 handler drains the whole batch
+// and just reads until the line releases.
 static void update_6502_irq(void) {
+    uint8_t mask = irq_6502_mask;
+    uint32_t now = time_us_32();
     bool any_data = false;
+    bool due = false;
     for (uint8_t i = 1; i < BUS_MAX_DEVICES; i++) {
-        if (bus_device_tx_count(i) > 0) {
-            any_data = true;
-            break;
+        uint8_t bit = 1u << i;
+        uint16_t count = (mask & bit) ? bus_device_tx_count(i) : 0;
+        if (count == 0) {
+            irq_pending_mask &= ~bit;
+            continue;
+        }
+        any_data = true;
+        if (!(irq_pending_mask & bit)) {
+            irq_pending_mask |= bit;
+            irq_pending_since[i] = now;
+        }
+        if (count >= irq_coalesce[i].bytes ||
+            now - irq_pending_since[i] >= irq_coalesce[i].us) {
+            due = true;
         }
     }
 
-    if (any_data && !irq_6502_asserted) {
+    if (due && !irq_6502_asserted) {
         gpio_put(PIN_6502_IRQ, 0);
         gpio_set_dir(PIN_6502_IRQ, GPIO_OUT);  // Drive low
         irq_6502_asserted = true;
@@ -147,33 +1339,6 @@ static void update_6502_irq(void) {
     }
 }
 
-// ============================================================================
-// 6502 Clock management
-// ============================================================================
-
-static void setup_6502_clock(void) {
-    gpio_set_function(PIN_6502_OSC, GPIO_FUNC_PWM);
-    uint slice_num = pwm_gpio_to_slice_num(PIN_6502_OSC);
-
-    // Calculate the wrap value for the target frequency.
-    // Assuming divider = 1.0: wrap = (f_sys / f_pwm) - 1
-    uint32_t f_sys = clock_get_hz(clk_sys);
-    uint32_t wrap = (f_sys / CLK_SPEED_6502) - 1;
-    assert(wrap <= 0xffff);  // Wrap is 16 bits, so max PWM frequency is f_sys / 65536
-
-    // Configure the PWM slice
-    pwm_config config = pwm_get_default_config();
-    pwm_config_set_clkdiv(&config, 1.0f); // Fixed 1.0 divider for zero jitter
-    pwm_config_set_wrap(&config, (uint16_t)wrap);
-    pwm_init(slice_num, &config, /*start=*/false);
-
-    // Set a 50% duty cycle
-    uint32_t level = (wrap + 1) / 2;
-    pwm_set_gpio_level(PIN_6502_OSC, level);
-
-    pwm_set_enabled(slice_num, true);
-}
-
 // ============================================================================
 // RESB management
 // ============================================================================
@@ -186,7 +1351,39 @@ static void bridge_gpio_irq_callback(uint gpio, uint32_t events) {
     spi_slave_gpio_irq(gpio, events);
 }
 
-static void bridge_reset(void) {
+#if BRIDGE_WARM_RESET
+// Put back what a reboot would for the next 6502 program: the bus and its
+// buffers, the IRQ line and settings, the 1 MHz clock and any device 0
+// reply still pending.  The expansion RAM keeps its contents either way.
+static void reset_6502_state(void) {
+#if BRIDGE_DUAL_CORE
+    // What the Zero sent before it read the notification lands first, so
+    // it is cleared with the rest and credited back.
+    drain_spi_to_bus();
+#endif
+    bus_reset();
+
+    irq_6502_mask = 0;
+    memcpy(irq_coalesce, irq_coalesce_defaults, sizeof(irq_coalesce));
+    irq_pending_mask = 0;
+    gpio_set_dir(PIN_6502_IRQ, GPIO_IN);   // Tristate (external pull-up)
+    irq_6502_asserted = false;
+    change_6502_clock(CLK_SPEED_6502 / 1000000u);
+
+    loopback_len = -1;
+    reu_fetch_len = -1;
+    reu_crc_wait();
+    reu_crc_pending = false;
+    math_len = -1;
+#if BRIDGE_LATENCY_STATS
+    lat_select = -1;
+#endif
+    rx_data_lost = false;
+}
+#endif
+
+// |reboot| restarts the Pico too, even in a BRIDGE_WARM_RESET build.
+static void bridge_reset(bool reboot) {
     printf("Reset requested.\n");
 
     // Drive RESB low (may already be low if external reset).
@@ -195,20 +1392,57 @@ static void bridge_reset(void) {
     gpio_set_dir(PIN_6502_RESB, GPIO_OUT);  // Drive low
 
     // Notify Zero via SPI (SPI is still running).
-    uint8_t reset_msg[] = { 0x01, 0x01, 'R' };  // Device 1 (system), len 1, 'R'
-    spi_slave_tx_queue(reset_msg, sizeof(reset_msg));
+    bool warm = BRIDGE_WARM_RESET && !reboot;
+    uint8_t reset_msg[] = { warm ? 'W' : 'R' };  // Device 1 (system), len 1
+#if BRIDGE_DUAL_CORE
+    // Core 1 keeps servicing SPI; just hand it the notification.
+    spsc_push_tlv(&bus_to_spi_queue, 0x01, reset_msg, sizeof(reset_msg));
+#else
+    // Device 1 has a lane of its own, so this goes out with the next READ.
+    spi_slave_tx_queue_tlv(0x01, reset_msg, sizeof(reset_msg));
+#endif
 
     // Keep running the SPI slave task until the Zero has read the
     // notification (TX queue drains), or timeout after 1s.
     uint32_t deadline = to_ms_since_boot(get_absolute_time()) + 1000;
+#if BRIDGE_DUAL_CORE
+    while (spsc_count(&bus_to_spi_queue) > 0 || spi_slave_tx_queue_len() > 0) {
+#else
     while (spi_slave_tx_queue_len() > 0) {
         spi_slave_task();
+#endif
         if (to_ms_since_boot(get_absolute_time()) > deadline) {
             printf("Reset: Zero did not read notification (timeout).\n");
             break;
         }
     }
 
+#if BRIDGE_NETBOOT_CACHE
+    // The 6502 is held in reset, so nothing is lost while flash is busy.
+    nbc_abort();
+    nbc_persist();
+#endif
+
+#if BRIDGE_WARM_RESET
+    if (warm) {
+        bus_stop();
+        reset_6502_state();
+        bus_start();
+        reset_requested = false;
+
+        // The W65C02S needs RESB low for two clocks; the notification
+        // round trip is usually far longer.
+        busy_wait_us(RESET_PULSE_US);
+        gpio_set_dir(PIN_6502_RESB, GPIO_IN);  // Release
+        // Our own drive latched a falling edge; a button still held keeps
+        // RESB low until it is let go, which is not another reset.
+        gpio_acknowledge_irq(PIN_6502_RESB, GPIO_IRQ_EDGE_FALL);
+        gpio_set_irq_enabled(PIN_6502_RESB, GPIO_IRQ_EDGE_FALL, true);
+        printf("Reset: 6502 restarted.\n");
+        return;
+    }
+#endif
+
     // Reboot via watchdog.
     // GPIO pins go to input/high-Z during boot (~50ms). The external
     // pull-up will try to release RESB, but main() drives it low again
@@ -240,14 +1474,23 @@ int main(void) {
     gpio_put(PIN_6502_IRQ, 0);  // Latch low so asserting only needs dir change
     gpio_set_dir(PIN_6502_IRQ, GPIO_IN);  // Tristate until data arrives
 
+#if BRIDGE_LATENCY_STATS
+    lat_init();
+#endif
+
     // --- Bus interface ---
     if (!bus_init()) {
         printf("ERROR: bus_init failed\n");
         return 1;
     }
+#if BRIDGE_BUS_CAPTURE
+    cap_init();
+#endif
 
     // Device 0: local status register (reads handled by TX callback)
     bus_register_tx_callback(0, device0_tx_callback);
+    bus_set_rx_loss_callback(bus_rx_loss_callback);
+    bus_register_rx_callback(0, device0_rx_callback);
 
     // Device 1: system control (handled locally)
     bus_register_rx_callback(1, device1_rx_callback);
@@ -256,6 +1499,10 @@ int main(void) {
     for (uint8_t d = 2; d < BUS_MAX_DEVICES; d++) {
         bus_register_rx_callback(d, bus_to_spi_callback);
     }
+#if BRIDGE_NETBOOT_CACHE
+    nbc_init();
+    bus_register_rx_callback(3, netboot_rx_callback);
+#endif
 
     bus_start();
 
@@ -265,11 +1512,23 @@ int main(void) {
     irq_set_enabled(IO_IRQ_BANK0, true);
 
     // --- SPI slave ---
+#if BRIDGE_DUAL_CORE
+    spsc_init(&bus_to_spi_queue, bus_to_spi_storage, sizeof(bus_to_spi_storage));
+    spsc_init(&spi_to_bus_queue, spi_to_bus_storage, sizeof(spi_to_bus_storage));
+#if BRIDGE_LATENCY_STATS
+    lat_marks_init(&spi_to_bus_lat_marks);
+#endif
+    multicore_launch_core1(core1_main);
+    while (!core1_ready) tight_loop_contents();
+#else
     if (!spi_slave_init()) {
         printf("ERROR: spi_slave_init failed\n");
         return 1;
     }
     spi_slave_set_rx_callback(spi_rx_callback);
+    spi_slave_set_rx_loss_callback(spi_rx_loss_callback);
+    spi_slave_set_freed_fn(device_freed);
+#endif
 
     // --- Release RESB: 6502 can now start its reset sequence ---
     gpio_set_dir(PIN_6502_RESB, GPIO_IN);  // Tristate = release (external pull-up)
@@ -277,19 +1536,37 @@ int main(void) {
     // --- RESB falling-edge interrupt for external resets ---
     gpio_set_irq_enabled(PIN_6502_RESB, GPIO_IRQ_EDGE_FALL, true);
 
+#if BRIDGE_EVENT_LOOP
+    event_loop_init_core();
+    stdio_set_chars_available_callback(usb_chars_available_callback, NULL);
+#endif
+
     uint32_t boot_time = to_ms_since_boot(get_absolute_time());
     uint32_t last_stats = boot_time;
+#if BRIDGE_NETBOOT_CACHE
+    uint32_t last_bus_bytes = 0;
+#endif
 
+    bool reboot_requested = false;
     while (1) {
         if (reset_requested) {
-            bridge_reset();
-            // Not reached — watchdog reboots
+            // Returns only from a warm reset; otherwise the watchdog reboots
+            bridge_reset(reboot_requested);
         }
 
         // Poll USB serial for 'R' → reboot (debug aid)
+#if BRIDGE_EVENT_LOOP
+        int ch = PICO_ERROR_TIMEOUT;
+        if (usb_chars_available) {
+            ch = getchar_timeout_us(0);
+            if (ch == PICO_ERROR_TIMEOUT) usb_chars_available = false;
+        }
+#else
         int ch = getchar_timeout_us(0);
+#endif
         if (ch == 'R') {
             printf("Reboot requested via USB\n");
+            reboot_requested = true;
             reset_requested = true;
         } else if (ch == 'S') {
             printf("Simulating SPI TX data for device 2\n");
@@ -299,9 +1576,25 @@ int main(void) {
         }
 
         bus_task();
+#if BRIDGE_DUAL_CORE
+        drain_spi_to_bus();
+#else
         spi_slave_task();
-        // Disabled - 6502 doesn't have a good IRQ handler yet.
-        // update_6502_irq();
+        tlv_nak_flush();
+#endif
+#if BRIDGE_NETBOOT_CACHE
+        nbc_task();
+#endif
+#if BRIDGE_BUS_CAPTURE
+        send_capture();
+#endif
+#if BRIDGE_EVENT_TRACE
+        send_events();
+#endif
+        update_6502_irq();
+#if BRIDGE_STATUS_PORT
+        bus_set_status(device_avail_mask());
+#endif
 
         // Periodic stats
         uint32_t now = to_ms_since_boot(get_absolute_time());
@@ -323,27 +1616,53 @@ int main(void) {
             bus_stats_t bs = bus_get_stats();
             spi_slave_stats_t ss = spi_slave_get_stats();
 
-            printf("[%lus] 6502->Z: %lu msgs (%lu B) | Z->6502: %lu msgs (%lu B, %lu drops)\n",
+            printf("[%lus] 6502->Z: %lu msgs (%lu B, %lu drops) | Z->6502: %lu msgs (%lu B, %lu drops, %lu naked)\n",
                    (unsigned long)(now / 1000),
                    (unsigned long)bus_to_spi_msgs,
                    (unsigned long)bus_to_spi_bytes,
+                   (unsigned long)bus_to_spi_drops,
                    (unsigned long)spi_to_bus_msgs,
                    (unsigned long)spi_to_bus_bytes,
-                   (unsigned long)spi_to_bus_drops);
+#if BRIDGE_DUAL_CORE
+                   (unsigned long)(spi_to_bus_drops + xcore_drops),
+#else
+                   (unsigned long)spi_to_bus_drops,
+#endif
+                   (unsigned long)spi_to_bus_refused);
 
-            printf("       bus: rx=%lu tx=%lu overruns=%lu bankrupt=%lu empty_reads=%lu\n",
+            printf("       bus: rx=%lu tx=%lu overruns=%lu bankrupt=%lu lost=%lu empty_reads=%lu\n",
                    (unsigned long)bs.rx_bytes,
                    (unsigned long)bs.tx_bytes,
                    (unsigned long)bs.rx_dma_overruns,
                    (unsigned long)bs.rx_bankruptcies,
+                   (unsigned long)bs.rx_bytes_lost,
                    (unsigned long)bs.tx_empty_reads);
 
-            printf("       spi: wr=%lu rd=%lu req=%lu proto_err=%lu irq=%lu\n",
+            printf("       spi: wr=%lu rd=%lu req=%lu proto_err=%lu overruns=%lu bankrupt=%lu irq=%lu\n",
                    (unsigned long)ss.rx_writes,
                    (unsigned long)ss.tx_reads,
                    (unsigned long)ss.requests,
                    (unsigned long)ss.proto_errors,
+                   (unsigned long)ss.rx_dma_overruns,
+                   (unsigned long)ss.rx_bankruptcies,
                    (unsigned long)ss.irq);
+            printf("       crc: wr_bad=%lu wr_seq_drop=%lu rd_nak=%lu\n",
+                   (unsigned long)ss.rx_crc_errors,
+                   (unsigned long)ss.rx_seq_drops,
+                   (unsigned long)ss.tx_naks);
+
+            print_ring_stats(&bs, &ss);
+            send_telemetry(now);
+#if BRIDGE_NETBOOT_CACHE
+            // A bus that moved nothing all interval can spare the flash
+            // writes; a busy one waits for the next reset.
+            uint32_t bus_bytes = bs.rx_bytes + bs.tx_bytes;
+            if (bus_bytes == last_bus_bytes) nbc_persist();
+            last_bus_bytes = bus_bytes;
+#endif
+#if BRIDGE_LATENCY_STATS
+            report_latency();
+#endif
 
 #if BRIDGE_DEBUG
             bus_diagnose();
@@ -351,5 +1670,19 @@ int main(void) {
 
             last_stats = now;
         }
+
+#if BRIDGE_EVENT_LOOP
+        // Arm the bus wakeup before checking for work, so a 6502 write
+        // landing in between still ends the sleep.
+        bus_arm_wakeup();
+#if BRIDGE_DUAL_CORE
+        bool idle = bus_idle() && spsc_count(&spi_to_bus_queue) == 0;
+#else
+        bool idle = bus_idle() && spi_slave_idle();
+#endif
+        if (idle && !usb_chars_available && !reset_requested) {
+            event_loop_sleep();
+        }
+#endif
     }
 }
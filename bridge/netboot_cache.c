@@ -0,0 +1,281 @@
+/*
+ * Netboot image cache in spare QSPI flash.  See netboot_cache.h.
+ */
+
+#include "netboot_cache.h"
+
+#if BRIDGE_NETBOOT_CACHE
+
+#include <string.h>
+
+#include "hardware/flash.h"
+#include "pico/flash.h"
+#include "bus_interface.h"
+
+#define NBC_MAGIC           0x3142424eu         // "NBB1"
+#define NBC_STREAM_OFFSET   FLASH_PAGE_SIZE     // Header page, then the stream
+#define NBC_STREAM_MAX      (NETBOOT_CACHE_SLOT_SIZE - NBC_STREAM_OFFSET)
+#define NBC_REGION          (PICO_FLASH_SIZE_BYTES - \
+                             NETBOOT_CACHE_SLOTS * NETBOOT_CACHE_SLOT_SIZE)
+#define NBC_DEVICE          3
+#define NBC_FLASH_TIMEOUT_MS 100
+
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;       // Write order: the oldest slot is reused first
+    uint32_t hash;      // FNV-1a of the stream
+    uint32_t len;       // Stream bytes, length prefix included
+    uint8_t name_len;
+    uint8_t name[NETBOOT_CACHE_NAME_MAX];
+} nbc_header_t;
+
+_Static_assert(sizeof(nbc_header_t) <= FLASH_PAGE_SIZE,
+               "the slot header must fit its page");
+_Static_assert(NETBOOT_CACHE_SLOT_SIZE % FLASH_SECTOR_SIZE == 0,
+               "slots must be whole flash sectors");
+
+// Slots whose stream matched its hash (bit n = slot n), and the next seq
+static uint32_t valid_slots;
+static uint32_t next_seq;
+
+static enum {
+    NBC_IDLE,
+    NBC_AWAIT,      // Request forwarded, waiting for the Zero's 'N'
+    NBC_SERVE,      // Feeding a slot to the device 3 buffer
+    NBC_CAPTURE,    // Copying the Zero's device 3 stream
+} state;
+
+// The request being answered, and the slot holding that name (-1 if none)
+static uint8_t req_name[NETBOOT_CACHE_NAME_MAX];
+static uint8_t req_len;
+static int req_slot;
+
+// NBC_SERVE: position in the slot's stream
+static int serve_slot;
+static uint32_t serve_pos;
+
+// NBC_CAPTURE fills capture[]; a complete stream that matched its hash
+// waits there (store_len > 0) for nbc_persist().  Whole pages, so the
+// last one can be programmed straight from it.
+static uint8_t capture[NBC_STREAM_MAX];
+static uint32_t capture_len;
+static uint32_t capture_hash;
+static uint32_t store_len;
+static uint8_t store_name[NETBOOT_CACHE_NAME_MAX];
+static uint8_t store_name_len;
+
+static uint32_t fnv1a(const uint8_t *p, uint32_t len) {
+    uint32_t h = 2166136261u;
+    while (len--) {
+        h ^= *p++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static uint32_t slot_offset(uint slot) {
+    return NBC_REGION + slot * NETBOOT_CACHE_SLOT_SIZE;
+}
+
+static const nbc_header_t *slot_header(uint slot) {
+    return (const nbc_header_t *)(XIP_BASE + slot_offset(slot));
+}
+
+static const uint8_t *slot_stream(uint slot) {
+    return (const uint8_t *)(XIP_BASE + slot_offset(slot) + NBC_STREAM_OFFSET);
+}
+
+static int find_slot(const uint8_t *name, uint8_t len) {
+    for (uint i = 0; i < NETBOOT_CACHE_SLOTS; i++) {
+        const nbc_header_t *h = slot_header(i);
+        if ((valid_slots & (1u << i)) && h->name_len == len &&
+            memcmp(h->name, name, len) == 0) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+void nbc_init(void) {
+    for (uint i = 0; i < NETBOOT_CACHE_SLOTS; i++) {
+        const nbc_header_t *h = slot_header(i);
+        if (h->magic != NBC_MAGIC || h->len < 2 || h->len > NBC_STREAM_MAX ||
+            h->name_len == 0 || h->name_len > NETBOOT_CACHE_NAME_MAX) {
+            continue;
+        }
+        if (fnv1a(slot_stream(i), h->len) != h->hash) continue;
+        valid_slots |= 1u << i;
+        if ((int32_t)(h->seq - next_seq) >= 0) next_seq = h->seq + 1;
+    }
+}
+
+bool nbc_has_images(void) {
+    return valid_slots != 0;
+}
+
+static void start_serving(int slot) {
+    state = NBC_SERVE;
+    serve_slot = slot;
+    serve_pos = 0;
+}
+
+bool nbc_request(const uint8_t *name, uint16_t len, bool zero_connected,
+                 uint8_t *fwd, uint16_t *fwd_len) {
+    state = NBC_IDLE;       // A new request abandons the last one
+    memcpy(fwd, name, len);
+    *fwd_len = len;
+    if (len == 0 || len > NETBOOT_CACHE_NAME_MAX) return false;
+
+    int slot = find_slot(name, (uint8_t)len);
+    if (slot >= 0 && !zero_connected) {
+        start_serving(slot);
+        return true;
+    }
+
+    uint32_t hash = slot >= 0 ? slot_header(slot)->hash : 0;
+    fwd[len] = 0x00;
+    fwd[len + 1] = (uint8_t)hash;
+    fwd[len + 2] = (uint8_t)(hash >> 8);
+    fwd[len + 3] = (uint8_t)(hash >> 16);
+    fwd[len + 4] = (uint8_t)(hash >> 24);
+    *fwd_len = len + 5;
+
+    memcpy(req_name, name, len);
+    req_len = (uint8_t)len;
+    req_slot = slot;
+    state = NBC_AWAIT;
+    return false;
+}
+
+void nbc_reply(const uint8_t *data, uint16_t len) {
+    if (state != NBC_AWAIT || len < 6) return;
+    uint32_t hash = data[2] | data[3] << 8 | data[4] << 16 | (uint32_t)data[5] << 24;
+    if (data[1] && req_slot >= 0 && slot_header(req_slot)->hash == hash) {
+        start_serving(req_slot);
+        return;
+    }
+    // The image follows on device 3; capture it over any stream still
+    // waiting to be stored, which is older.
+    state = NBC_CAPTURE;
+    capture_len = 0;
+    capture_hash = hash;
+    store_len = 0;
+}
+
+void nbc_capture(const uint8_t *data, uint16_t len, bool ok) {
+    if (state != NBC_CAPTURE) return;
+    if (!ok || len > NBC_STREAM_MAX - capture_len) {
+        state = NBC_IDLE;
+        return;
+    }
+    memcpy(&capture[capture_len], data, len);
+    capture_len += len;
+    if (capture_len < 2) return;
+
+    uint32_t total = 2u + (capture[0] << 8 | capture[1]);
+    if (total == 2 || total > NBC_STREAM_MAX || capture_len > total) {
+        state = NBC_IDLE;   // Not found, too big to keep, or not one stream
+        return;
+    }
+    if (capture_len < total) return;
+
+    state = NBC_IDLE;
+    if (fnv1a(capture, total) != capture_hash) return;
+    store_len = total;
+    memcpy(store_name, req_name, req_len);
+    store_name_len = req_len;
+}
+
+void nbc_task(void) {
+    if (state != NBC_SERVE) return;
+    const nbc_header_t *h = slot_header(serve_slot);
+    const uint8_t *stream = slot_stream(serve_slot);
+    while (serve_pos < h->len) {
+        uint32_t n = h->len - serve_pos;
+        if (n > NETBOOT_CACHE_TLV) n = NETBOOT_CACHE_TLV;
+        if (bus_device_tx_free(NBC_DEVICE) < n) return;
+        bus_device_write(NBC_DEVICE, &stream[serve_pos], (uint16_t)n);
+        serve_pos += n;
+    }
+    state = NBC_IDLE;
+}
+
+void nbc_abort(void) {
+    state = NBC_IDLE;
+}
+
+// ============================================================================
+// Flash writes
+// ============================================================================
+
+typedef struct {
+    uint32_t offset;
+    const uint8_t *data;    // NULL to erase
+    uint32_t len;
+} flash_op_t;
+
+static void do_flash_op(void *param) {
+    const flash_op_t *op = param;
+    if (op->data) {
+        flash_range_program(op->offset, op->data, op->len);
+    } else {
+        flash_range_erase(op->offset, op->len);
+    }
+}
+
+// One erase or program, with the other core parked while XIP is off
+static bool flash_op(uint32_t offset, const uint8_t *data, uint32_t len) {
+    flash_op_t op = { offset, data, len };
+    return flash_safe_execute(do_flash_op, &op, NBC_FLASH_TIMEOUT_MS) == PICO_OK;
+}
+
+// The slot to overwrite: the one with this name, else an empty one, else
+// the oldest.
+static uint pick_slot(void) {
+    int slot = find_slot(store_name, store_name_len);
+    if (slot >= 0) return (uint)slot;
+    uint oldest = 0;
+    for (uint i = 0; i < NETBOOT_CACHE_SLOTS; i++) {
+        if (!(valid_slots & (1u << i))) return i;
+        if ((int32_t)(slot_header(i)->seq - slot_header(oldest)->seq) < 0) oldest = i;
+    }
+    return oldest;
+}
+
+void nbc_persist(void) {
+    // A slot being served or vouched for must stay as it is.
+    if (store_len == 0 || state == NBC_AWAIT || state == NBC_SERVE) return;
+
+    uint slot = pick_slot();
+    uint32_t base = slot_offset(slot);
+    uint32_t span = NBC_STREAM_OFFSET + store_len;
+    valid_slots &= ~(1u << slot);
+
+    // A sector at a time, so interrupts run again in between.
+    for (uint32_t off = 0; off < span; off += FLASH_SECTOR_SIZE) {
+        if (!flash_op(base + off, NULL, FLASH_SECTOR_SIZE)) return;
+    }
+    for (uint32_t off = 0; off < store_len; off += FLASH_SECTOR_SIZE) {
+        uint32_t n = store_len - off;
+        if (n > FLASH_SECTOR_SIZE) n = FLASH_SECTOR_SIZE;
+        n = (n + FLASH_PAGE_SIZE - 1) & ~(FLASH_PAGE_SIZE - 1);
+        if (!flash_op(base + NBC_STREAM_OFFSET + off, &capture[off], n)) return;
+    }
+
+    // The header goes last: until it is programmed the slot reads as empty.
+    static uint8_t page[FLASH_PAGE_SIZE];
+    memset(page, 0xff, sizeof(page));
+    nbc_header_t *h = (nbc_header_t *)page;
+    h->magic = NBC_MAGIC;
+    h->seq = next_seq++;
+    h->hash = capture_hash;
+    h->len = store_len;
+    h->name_len = store_name_len;
+    memcpy(h->name, store_name, store_name_len);
+    if (!flash_op(base, page, sizeof(page))) return;
+
+    valid_slots |= 1u << slot;
+    store_len = 0;
+}
+
+#endif // BRIDGE_NETBOOT_CACHE
@@ -0,0 +1,62 @@
+/*
+ * Netboot image cache in spare QSPI flash (BRIDGE_NETBOOT_CACHE builds only).
+ *
+ * The top NETBOOT_CACHE_SLOTS * NETBOOT_CACHE_SLOT_SIZE bytes of flash hold
+ * the device 3 streams ([len_hi][len_lo][data...]) of recently booted
+ * images, keyed by name and checked by an FNV-1a hash of the stream.  A
+ * slot is one header page followed by the stream:
+ *
+ *   [magic][seq][hash][len][name_len][name...]   page 0
+ *   [len_hi][len_lo][data...]                    from byte 256
+ *
+ * The header is programmed last, so a slot whose write was cut short reads
+ * as empty.  When the Zero is connected it has the final say: the request is
+ * forwarded with the cached hash, and the Zero either confirms it (the Pico
+ * serves the image) or sends the image as usual, which is captured in RAM
+ * and written to flash once the bus has gone quiet or the 6502 is next held
+ * in reset.  Without the Zero, a cached image is served as it is.
+ *
+ * Everything here runs on core 0.
+ */
+
+#ifndef NETBOOT_CACHE_H
+#define NETBOOT_CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "bridge_defs.h"
+
+// Scan the flash slots, dropping any whose stream doesn't match its hash.
+void nbc_init(void);
+
+// True if any image is cached (device 0 status byte 1, bit 2).
+bool nbc_has_images(void);
+
+// The 6502 wrote |name| to device 3.  Returns true if the image is being
+// served from flash and nothing goes to the Zero.  Otherwise fills |fwd|
+// (at least len + 5 bytes) with the request to forward and sets |fwd_len|:
+// the name, then [0x00][hash LE32] (hash 0 when nothing is cached) unless
+// the name is too long to cache.
+bool nbc_request(const uint8_t *name, uint16_t len, bool zero_connected,
+                 uint8_t *fwd, uint16_t *fwd_len);
+
+// Device 0 ['N', hit, hash LE32] from the Zero, answering the last request.
+void nbc_reply(const uint8_t *data, uint16_t len);
+
+// Device 3 bytes the Zero delivered into the bus buffer (|ok| false when
+// they were dropped instead).
+void nbc_capture(const uint8_t *data, uint16_t len, bool ok);
+
+// Main loop: feed an image being served from flash to the device 3 buffer.
+void nbc_task(void);
+
+// The 6502 was reset: drop the request being answered or served.  A
+// captured image still waiting for nbc_persist() is kept.
+void nbc_abort(void);
+
+// Write a captured image to flash.  Interrupts are off for each sector
+// erased or programmed, so call only while the bus is quiet.
+void nbc_persist(void);
+
+#endif // NETBOOT_CACHE_H
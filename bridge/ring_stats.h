@@ -0,0 +1,56 @@
+/*
+ * Ring buffer occupancy tracking.
+ *
+ * Each ring keeps its peak fill level and the total time it has spent at
+ * or above RING_HIGH_PCT percent full.  Owners call ring_stats_sample()
+ * wherever they already know the fill level (after a push, after a pop),
+ * so the only extra cost is a compare and, on a threshold crossing, one
+ * timer read.  The numbers are meant for sizing the rings from real
+ * workloads; see the stats output.
+ */
+
+#ifndef RING_STATS_H
+#define RING_STATS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "bridge_defs.h"
+#include "pico/time.h"
+
+typedef struct {
+    uint32_t size;          // Ring capacity (bytes)
+    uint32_t peak;          // Highest fill level seen (bytes)
+    uint32_t above_us;      // Completed time spent at or above the threshold
+    uint32_t above_since;   // time_us_32() of the last upward crossing
+    bool above;             // Currently at or above the threshold
+} ring_stats_t;
+
+static inline void ring_stats_init(ring_stats_t *r, uint32_t size) {
+    r->size = size;
+    r->peak = 0;
+    r->above_us = 0;
+    r->above_since = 0;
+    r->above = false;
+}
+
+static inline void ring_stats_sample(ring_stats_t *r, uint32_t level) {
+    if (level > r->peak) r->peak = level;
+
+    bool high = level * 100 >= r->size * RING_HIGH_PCT;
+    if (high == r->above) return;
+    uint32_t now = time_us_32();
+    if (high) {
+        r->above_since = now;
+    } else {
+        r->above_us += now - r->above_since;
+    }
+    r->above = high;
+}
+
+// Time at or above the threshold, including an interval still in progress.
+static inline uint32_t ring_stats_above_us(const ring_stats_t *r) {
+    return r->above_us + (r->above ? time_us_32() - r->above_since : 0);
+}
+
+#endif // RING_STATS_H
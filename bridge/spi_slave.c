@@ -8,15 +8,30 @@
  *     A GPIO interrupt on CS rising edge signals end-of-transaction.
  *     spi_slave_task() then parses the received data and delivers WRITE
  *     payloads directly to the application via a registered callback.
+ *     A transaction whose size is known but isn't all in yet is skipped
+ *     until the DMA count reaches its end.
  *
- *   - TX path: When a REQUEST is received, the Pico prepares a READ_SIZE
- *     staging buffer, configures TX DMA, and asserts READY. The Zero then
- *     sends a READ to clock out the data. After CS rises, READY is
- *     deasserted.
+ *   - TX path: When a REQUEST is received, the Pico builds a short list
+ *     of DMA control blocks (10-byte header, one or two spans straight
+ *     out of the TX queue ring, shared zero padding), starts the chained
+ *     TX DMA, and asserts READY. The Zero then sends a READ to clock out
+ *     the data. After CS rises, READY is deasserted; the queued bytes are
+ *     only released once the READ has been consumed from the RX ring.
+ *
+ *   - Framing: v1 READs are always SPI_SLAVE_READ_SIZE bytes (zero padded).
+ *     Once the Zero negotiates v2 (SET_VERSION, acked with a Device 1
+ *     ['V', version] TLV), a READ is the 10-byte header followed by a
+ *     second transaction of exactly LEN bytes, with no padding.
  *
  *   - Flow control: The READ response includes per-device buffer free
- *     space (8 bytes, in 16-byte units), so the Zero knows how much it
- *     can WRITE per device.
+ *     space (8 bytes, in 16-byte units, 64-byte from v4), so the Zero
+ *     knows how much it can WRITE per device.
+ *
+ *   - Integrity (v6): every frame carries a CRC-32, computed by the DMA
+ *     sniffer on a memory-to-memory pass over the frame's spans.  A READ is
+ *     only released by the Zero's next command, so a NAK can have it sent
+ *     again; WRITEs are numbered and the Zero resends from the first one
+ *     the Pico drops.
  *
  *   - No race conditions: the REQUEST/READY handshake guarantees the master
  *     won't start a READ until TX DMA is fully loaded.
@@ -36,6 +51,14 @@
 #include "hardware/irq.h"
 #include "hardware/sync.h"
 
+#if BRIDGE_LATENCY_STATS
+#include "latency.h"
+#endif
+
+#if BRIDGE_EVENT_TRACE
+#include "events.h"
+#endif
+
 #include <stdio.h>
 #include <string.h>
 
@@ -43,9 +66,16 @@
 // State
 // ============================================================================
 
-// DMA channels
+// DMA channels.  dma_tx_ctrl_chan feeds a frame's blocks into dma_tx_chan's
+// alias-3 registers, one control block per chained data transfer.
 static int dma_rx_chan = -1;
 static int dma_tx_chan = -1;
+static int dma_tx_ctrl_chan = -1;
+
+// v6 CRCs: a memory-to-memory channel the DMA sniffer watches.  It reads a
+// span and writes every byte to crc_sink, so the sniffer sees each once.
+static int dma_crc_chan = -1;
+static uint32_t crc_sink;
 
 // RX ring buffer (DMA writes here continuously)
 static uint8_t __attribute__((aligned(SPI_SLAVE_RX_RING_SIZE)))
@@ -61,20 +91,109 @@ static volatile uint32_t dma_rx_epoch = 0;
 // Total bytes consumed by software (for overrun detection)
 static uint32_t dma_rx_total_read = 0;
 
-// TX staging buffer (single buffer -- no double-buffering needed since
-// we only prepare it in the safe window between REQUEST and READ)
-static uint8_t tx_buf[SPI_SLAVE_READ_SIZE];
+// Incremental parse state: the DMA total the transaction at rx_read_idx
+// needs before it can make progress.  It starts one byte past the read
+// position and grows to the frame's end once its header is parsed, so a
+// WRITE still arriving costs the task one compare instead of a re-parse,
+// and spi_slave_idle() can sleep through it.
+static uint32_t rx_need_total = 1;
+
+// Shared zero padding for the unused tail of v1 READ frames
+static uint8_t tx_zero_pad[SPI_SLAVE_MAX_PAYLOAD];
+
+// DMA control block, laid out to match the alias-3 register pair
+// {al3_transfer_count, al3_read_addr_trig}.  Writing the read address
+// triggers the data channel; a NULL read address is a null trigger
+// that ends the chain.
+typedef struct {
+    uint32_t len;
+    const void *read_addr;
+} tx_dma_block_t;
+
+// One staged READ frame.  Only the header is built here; the payload is
+// sent straight from the TX lanes.  Frames are staged in the safe window
+// between REQUEST and READ, or (pipelined, v3) while the previous READ
+// is still being clocked out, hence two of them.
+typedef struct {
+    uint8_t hdr[SPI_SLAVE_READ_HDR_SIZE + SPI_SLAVE_CRC_SIZE];  // [BUF x8][LEN x2][CRC x4, v6]
+    uint8_t credit[SPI_CREDIT_TLV_LEN];     // v5 credit TLV, sent ahead of the payload
+    uint16_t credit_freed[BUS_MAX_DEVICES]; // Counts the credit TLV carries
+    uint16_t lane_len[BUS_MAX_DEVICES];     // Bytes sent from each TX lane
+    // Header, credits, up to two ring spans per lane, padding, terminator
+    tx_dma_block_t blocks[2 * BUS_MAX_DEVICES + 4];
+    uint credit_len;            // 0 if the frame carries no credit TLV
+    uint payload_len;           // TX lane bytes this frame sends
+    uint read_size;             // Size of the READ transaction that clocks it out
+    uint cs_edges;              // CS rising edges that READ spans
+    bool more;                  // A pipelined follow-up frame was promised
+} tx_frame_t;
+
+static tx_frame_t tx_frames[2];
+static uint tx_frame_active = 0;    // Frame most recently loaded into DMA
+static uint tx_frame_release = 0;   // Oldest frame whose READ isn't parsed yet
+static bool tx_frame_next_staged = false;
+// v6: the READ of tx_frame_release was parsed, but it is only released by
+// the Zero's next command -- unless that command is a NAK.
+static bool tx_read_unacked = false;
+
+// TX queue: data waiting to be sent to Zero (Pico -> Zero direction), one
+// lane per device carved out of tx_queue (sizes in bridge_defs.h).  TLVs
+// of one device keep their order; a frame takes the control lanes first
+// and then one TLV from each other lane in turn, so neither a reset
+// notice nor a quiet device waits behind 4 KB of another device's data.
+typedef struct {
+    uint8_t *data;
+    uint size;          // Power of two
+    uint head;
+    uint tail;
+    uint len;
+    // Bytes at the head claimed by staged READ frames.  They stay in the
+    // lane until the READ that sends them has been consumed.
+    uint inflight;
+#if BRIDGE_LATENCY_STATS
+    // Free-running byte counts of everything queued and released, the
+    // positions the LAT_BUS_TO_SPI marks are keyed by.
+    uint32_t pushed;
+    uint32_t released;
+    lat_marks_t lat_marks;
+#endif
+} tx_lane_t;
 
-// TX queue: data waiting to be sent to Zero (Pico -> Zero direction).
 static uint8_t tx_queue[SPI_TX_QUEUE_SIZE];
-static uint tx_queue_head = 0;
-static uint tx_queue_tail = 0;
-static uint tx_queue_len = 0;
+static tx_lane_t tx_lanes[BUS_MAX_DEVICES];
+static uint tx_queue_len = 0;       // Bytes in all lanes
+static uint tx_queue_inflight = 0;  // Of which claimed by staged frames
+static uint8_t tx_lane_next = SPI_TX_CTRL_LANES;    // First bulk lane of the next frame
+
+// v5 credits: the bytes-freed counts (bus_device_tx_freed()) of the last
+// READ the Zero consumed, and of the last frame staged.  A frame carries a
+// credit TLV whenever the counts moved past the consumed ones, so one lost
+// with a dropped frame is simply sent again.
+static uint16_t credit_acked[BUS_MAX_DEVICES];
+static uint16_t credit_staged[BUS_MAX_DEVICES];
+static bool credit_resync = true;   // Send credits even if unchanged (new v5 link)
+
+// v6 WRITE sequencing.  After a dropped WRITE one ['N', expected] TLV is
+// queued; until a READ has carried it to the Zero, later drops are frames
+// the Zero sent before it knew, and need no NAK of their own.
+static uint8_t write_seq_expected = 0;
+static bool write_nak_needed = false;   // A drop is waiting for queue room to NAK
+static bool write_nak_queued = false;
+static uint write_nak_offset = 0;       // Device 1 lane bytes up to the end of the NAK
 
 // RX callback for WRITE payloads
 static spi_slave_rx_callback_t rx_callback = NULL;
 
-// Temp buffer for copying WRITE payloads out of the DMA ring
+// Told about bytes dropped by an RX resync
+static spi_slave_rx_loss_callback_t rx_loss_callback = NULL;
+
+// Source of the per-device BUF estimates
+static spi_slave_buf_free_fn_t buf_free_fn = bus_device_tx_free;
+
+// Source of the v5 credit counts
+static spi_slave_freed_fn_t freed_fn = bus_device_tx_freed;
+
+// Temp buffer for WRITE payloads that wrap around the DMA ring
 static uint8_t rx_temp[SPI_SLAVE_MAX_PAYLOAD];
 
 // Protocol state
@@ -82,10 +201,21 @@ typedef enum {
     STATE_IDLE,         // Waiting for WRITE or REQUEST
     STATE_REQUESTED,    // REQUEST received, preparing response
     STATE_READY,        // READY asserted, waiting for READ
+    STATE_PIPELINED,    // READ done, follow-up frame promised (v3, no REQUEST)
 } slave_state_t;
 
 static volatile slave_state_t state = STATE_IDLE;
 
+// Framing of READ responses.  A requested switch takes effect once the
+// READ carrying the 'V' ack has been consumed, so both sides flip on the
+// same frame boundary.
+static uint8_t proto_version = SPI_PROTO_V1;
+static uint8_t proto_version_pending = 0;
+static uint proto_version_ack_offset = 0;   // Device 1 lane bytes up to end of the ack
+
+// CS rising edges left before the active READ is complete
+static volatile uint tx_read_cs_remaining = 0;
+
 // Stats
 static spi_slave_stats_t stats = {0};
 
@@ -141,19 +271,176 @@ static inline void ready_pin_deassert(void) {
     gpio_put(SPI_SLAVE_PIN_READY, 1);  // Idle high
 }
 
-static inline uint8_t tx_queue_peek(uint offset) {
-    return tx_queue[(tx_queue_head + offset) & (SPI_TX_QUEUE_SIZE - 1)];
+// Size of the complete TLV starting |offset| bytes past a lane's head,
+// or 0 if there is none.
+static uint tx_lane_tlv_at(const tx_lane_t *l, uint offset) {
+    if (l->len - offset < 2) return 0;
+    uint total = 2u + l->data[(l->head + offset + 1) & (l->size - 1)];
+    return (total <= l->len - offset) ? total : 0;
+}
+
+// True if some lane has a complete TLV no staged frame has claimed.
+static bool tx_queue_has_tlv(void) {
+    for (uint8_t d = 0; d < BUS_MAX_DEVICES; d++) {
+        if (tx_lane_tlv_at(&tx_lanes[d], tx_lanes[d].inflight)) return true;
+    }
+    return false;
+}
+
+// Hand every claimed byte back to its lane: the frames that claimed them
+// are dropped and the bytes go out again.
+static void tx_queue_unclaim(void) {
+    for (uint8_t d = 0; d < BUS_MAX_DEVICES; d++) {
+        tx_lanes[d].inflight = 0;
+    }
+    tx_queue_inflight = 0;
+}
+
+// Release the bytes sent by the oldest outstanding READ frame.
+static void tx_queue_release_frame(void) {
+    const tx_frame_t *f = &tx_frames[tx_frame_release];
+    if (f->credit_len) {
+        memcpy(credit_acked, f->credit_freed, sizeof(credit_acked));
+        credit_resync = false;
+    }
+    tx_frame_release ^= 1;
+
+    for (uint8_t d = 0; d < BUS_MAX_DEVICES; d++) {
+        tx_lane_t *l = &tx_lanes[d];
+        uint n = f->lane_len[d];
+        l->head = (l->head + n) & (l->size - 1);
+        l->len -= n;
+        l->inflight -= n;
+#if BRIDGE_LATENCY_STATS
+        l->released += n;
+        lat_settle(&l->lat_marks, LAT_BUS_TO_SPI, l->released);
+#endif
+    }
+    tx_queue_len -= f->payload_len;
+    tx_queue_inflight -= f->payload_len;
+    ring_stats_sample(&stats.tx_queue, tx_queue_len);
+
+    // The version ack and WRITE NAK travel on Device 1.
+    uint sent = f->lane_len[0x01];
+
+    // Switch framing once the Zero has been sent the version ack.
+    if (proto_version_pending) {
+        if (sent >= proto_version_ack_offset) {
+            proto_version = proto_version_pending;
+            proto_version_pending = 0;
+            credit_resync = true;
+            write_seq_expected = 0;
+        } else {
+            proto_version_ack_offset -= sent;
+        }
+    }
+
+    // WRITEs arriving from here on were sent after the Zero saw the NAK.
+    if (write_nak_queued) {
+        if (sent >= write_nak_offset) {
+            write_nak_queued = false;
+        } else {
+            write_nak_offset -= sent;
+        }
+    }
 }
 
-// Drain exactly |count| bytes from tx_queue into dst.
-static void tx_queue_drain(uint8_t *dst, uint count) {
-    uint head = tx_queue_head;
-    for (uint i = 0; i < count; i++) {
-        dst[i] = tx_queue[head];
-        head = (head + 1) & (SPI_TX_QUEUE_SIZE - 1);
+// Release the frame whose READ was parsed last, if it is still held (v6).
+static void tx_read_ack(void) {
+    if (tx_read_unacked) {
+        tx_read_unacked = false;
+        tx_queue_release_frame();
     }
-    tx_queue_head = head;
-    tx_queue_len -= count;
+}
+
+// ============================================================================
+// CRC-32 (v6) via the DMA sniffer
+// ============================================================================
+
+// The sniffer runs CRC-32 over bit-reversed data and reads back reversed
+// and inverted, which is the reflected IEEE CRC-32 zlib computes.  A span
+// of the 1542-byte maximum takes about 10us at one byte per clk_sys cycle.
+
+static inline void crc32_begin(void) {
+    dma_sniffer_set_data_accumulator(0xFFFFFFFFu);
+}
+
+static void crc32_update(const volatile void *data, uint len) {
+    if (len == 0) return;
+    dma_channel_set_read_addr(dma_crc_chan, data, false);
+    dma_channel_set_trans_count(dma_crc_chan, len, true);
+    dma_channel_wait_for_finish_blocking(dma_crc_chan);
+}
+
+static inline uint32_t crc32_end(void) {
+    return dma_sniffer_get_data_accumulator();
+}
+
+uint32_t spi_slave_crc32(const void *a, uint a_len, const void *b, uint b_len) {
+    crc32_begin();
+    crc32_update(a, a_len);
+    crc32_update(b, b_len);
+    return crc32_end();
+}
+
+// Feed |len| RX ring bytes starting at |idx| (which may wrap).
+static void crc32_update_ring(uint idx, uint len) {
+    uint first = SPI_SLAVE_RX_RING_SIZE - idx;
+    if (first >= len) {
+        crc32_update(&rx_ring[idx], len);
+    } else {
+        crc32_update(&rx_ring[idx], first);
+        crc32_update(rx_ring, len - first);
+    }
+}
+
+static inline uint8_t rx_ring_at(uint idx) {
+    return rx_ring[idx & (SPI_SLAVE_RX_RING_SIZE - 1)];
+}
+
+// Queue the NAK for a dropped WRITE, unless one is already on its way.
+static void write_nak_send(void) {
+    if (write_nak_queued) {
+        write_nak_needed = false;
+        return;
+    }
+    uint8_t nak[2] = { 'N', write_seq_expected };
+    write_nak_needed = !spi_slave_tx_queue_tlv(0x01, nak, sizeof(nak));
+    if (!write_nak_needed) {
+        write_nak_queued = true;
+        write_nak_offset = tx_lanes[0x01].len;
+    }
+}
+
+// Check a v6 WRITE of |payload_len| bytes whose command byte is at |rd|.
+// Returns false if it must be dropped.
+static bool write_frame_ok(uint rd, uint16_t payload_len) {
+    crc32_begin();
+    crc32_update_ring((rd + 1) & (SPI_SLAVE_RX_RING_SIZE - 1), 3 + payload_len);
+    uint32_t crc = crc32_end();
+
+    uint at = rd + 4 + payload_len;
+    uint32_t sent = (uint32_t)rx_ring_at(at) |
+                    ((uint32_t)rx_ring_at(at + 1) << 8) |
+                    ((uint32_t)rx_ring_at(at + 2) << 16) |
+                    ((uint32_t)rx_ring_at(at + 3) << 24);
+    if (crc != sent) {
+        stats.rx_crc_errors++;
+        write_nak_send();
+        return false;
+    }
+
+    uint8_t seq = rx_ring_at(rd + 3);
+    if (seq != write_seq_expected) {
+        // Behind: a resend the Pico already has.  Ahead: one went missing.
+        stats.rx_seq_drops++;
+        if ((int8_t)(seq - write_seq_expected) > 0) {
+            write_nak_send();
+        }
+        return false;
+    }
+    write_seq_expected++;
+    return true;
 }
 
 // ============================================================================
@@ -164,73 +451,177 @@ void spi_slave_gpio_irq(uint gpio, uint32_t events) {
     if (gpio == SPI_SLAVE_PIN_CSN &&
         (events & GPIO_IRQ_EDGE_RISE) &&
         state == STATE_READY) {
-        // READ just completed. Deassert READY.
+        // A v2 READ with payload spans two transactions; only the last
+        // one completes the READ.
+        if (tx_read_cs_remaining > 1) {
+            tx_read_cs_remaining--;
+            return;
+        }
+        // READ just completed. Deassert READY; if the frame promised a
+        // follow-up, the task loads it without waiting for a REQUEST.
+        tx_read_cs_remaining = 0;
         ready_pin_deassert();
-        state = STATE_IDLE;
+        state = tx_frames[tx_frame_active].more ? STATE_PIPELINED : STATE_IDLE;
+#if BRIDGE_EVENT_TRACE
+        const uint8_t *hdr = tx_frames[tx_frame_active].hdr;
+        evt_record(&evt_spi, EVT_SPI_READ, 0xFF,
+                   (uint16_t)((hdr[8] & ~SPI_READ_LEN_MORE) << 8 | hdr[9]));
+#endif
     }
 }
 
 // ============================================================================
-// Prepare TX staging buffer and load DMA (called from task after REQUEST)
+// Stage READ frames and load DMA (called from task)
 // ============================================================================
 
-static void prepare_and_load_tx(void) {
+// Stage tx_frames[idx] from the TX lane bytes no earlier frame has claimed.
+static void stage_tx_frame(uint idx) {
+    tx_frame_t *f = &tx_frames[idx];
+
     // --- Per-device buffer estimates (bytes 0..7) ---
+    uint unit = (proto_version >= SPI_PROTO_V4) ? SPI_BUF_UNIT_V4 : SPI_BUF_UNIT;
     for (uint8_t d = 0; d < BUS_MAX_DEVICES; d++) {
-        uint16_t free_bytes = bus_device_tx_free(d);
-        uint units = free_bytes / 16;
-        tx_buf[d] = (units > 255) ? 255 : (uint8_t)units;
+        uint16_t free_bytes = buf_free_fn(d);
+        uint units = free_bytes / unit;
+        f->hdr[d] = (units > 255) ? 255 : (uint8_t)units;
+    }
+
+    // --- v5 credits, sampled after BUF so they never count a byte twice ---
+    f->credit_len = 0;
+    if (proto_version >= SPI_PROTO_V5) {
+        bool changed = credit_resync;
+        for (uint8_t d = 0; d < BUS_MAX_DEVICES; d++) {
+            f->credit_freed[d] = freed_fn(d);
+            changed |= f->credit_freed[d] != credit_acked[d];
+        }
+        if (changed) {
+            f->credit[0] = 0x01;
+            f->credit[1] = SPI_CREDIT_TLV_LEN - 2;
+            f->credit[2] = 'K';
+            for (uint8_t d = 0; d < BUS_MAX_DEVICES; d++) {
+                f->credit[3 + 2 * d] = (uint8_t)f->credit_freed[d];
+                f->credit[4 + 2 * d] = (uint8_t)(f->credit_freed[d] >> 8);
+            }
+            f->credit_len = SPI_CREDIT_TLV_LEN;
+            memcpy(credit_staged, f->credit_freed, sizeof(credit_staged));
+        }
     }
 
-    // --- Payload: pack complete TLV packets only (bytes 10+) ---
-    uint8_t *payload = &tx_buf[10];
+    // --- Payload: complete TLV packets only, sent from the lanes ---
+    uint room = SPI_SLAVE_MAX_PAYLOAD - f->credit_len;
     uint payload_len = 0;
 
-    while (tx_queue_len >= 2) {
-        uint8_t tlv_len = tx_queue_peek(1);
-        uint tlv_total = 2 + tlv_len;
+    memset(f->lane_len, 0, sizeof(f->lane_len));
 
-        if (tlv_total > tx_queue_len) {
-            // Incomplete TLV in queue (shouldn't happen, but be safe)
-            break;
+    // Control lanes first, as much as fits
+    for (uint8_t d = 0; d < SPI_TX_CTRL_LANES; d++) {
+        const tx_lane_t *l = &tx_lanes[d];
+        uint tlv_total;
+        while ((tlv_total = tx_lane_tlv_at(l, l->inflight + f->lane_len[d])) != 0 &&
+               payload_len + tlv_total <= room) {
+            f->lane_len[d] += tlv_total;
+            payload_len += tlv_total;
         }
+    }
 
-        if (payload_len + tlv_total > SPI_SLAVE_MAX_PAYLOAD) {
-            // Won't fit in this frame
-            break;
+    // Then one TLV per bulk lane in turn, until a full round adds nothing.
+    // The next frame starts at the lane after the last one served.
+    uint8_t d = tx_lane_next;
+    for (uint idle = 0; idle < BUS_MAX_DEVICES - SPI_TX_CTRL_LANES; ) {
+        const tx_lane_t *l = &tx_lanes[d];
+        uint8_t lane = d;
+        uint tlv_total = tx_lane_tlv_at(l, l->inflight + f->lane_len[lane]);
+        d = (d + 1 < BUS_MAX_DEVICES) ? d + 1 : SPI_TX_CTRL_LANES;
+        if (tlv_total == 0 || payload_len + tlv_total > room) {
+            idle++;
+            continue;
         }
-
-        // Drain this complete TLV into the payload
-        tx_queue_drain(&payload[payload_len], tlv_total);
+        f->lane_len[lane] += tlv_total;
         payload_len += tlv_total;
+        tx_lane_next = d;
+        idle = 0;
     }
 
+    f->payload_len = payload_len;
+    for (d = 0; d < BUS_MAX_DEVICES; d++) {
+        tx_lanes[d].inflight += f->lane_len[d];
+    }
+    tx_queue_inflight += payload_len;
+
     // --- Length field (bytes 8..9, big-endian) ---
-    tx_buf[8] = (uint8_t)(payload_len >> 8);
-    tx_buf[9] = (uint8_t)(payload_len & 0xFF);
+    uint frame_len = f->credit_len + payload_len;
+    f->hdr[8] = (uint8_t)(frame_len >> 8);
+    f->hdr[9] = (uint8_t)(frame_len & 0xFF);
+    uint hdr_len = SPI_SLAVE_READ_HDR_SIZE;
+
+    // v3: promise a follow-up frame if a complete TLV is left over.  Never
+    // while a version switch is pending, since the follow-up would be
+    // staged before the switch takes effect.
+    f->more = proto_version >= SPI_PROTO_V3 && !proto_version_pending &&
+              tx_queue_has_tlv();
+    if (f->more) {
+        f->hdr[8] |= SPI_READ_LEN_MORE;
+    }
 
-    // Zero-pad remainder
-    if (payload_len < SPI_SLAVE_MAX_PAYLOAD) {
-        memset(&payload[payload_len], 0, SPI_SLAVE_MAX_PAYLOAD - payload_len);
+    // --- Control blocks: header, credits, lane span(s), zero padding ---
+    uint n = 0;
+    f->blocks[n++] = (tx_dma_block_t){ 0, f->hdr };     // Length set below
+    if (f->credit_len) {
+        f->blocks[n++] = (tx_dma_block_t){ f->credit_len, f->credit };
+    }
+    for (d = 0; d < BUS_MAX_DEVICES; d++) {
+        const tx_lane_t *l = &tx_lanes[d];
+        uint len = f->lane_len[d];
+        if (len == 0) continue;
+        uint pos = (l->head + l->inflight - len) & (l->size - 1);
+        uint first = l->size - pos;
+        if (first > len) first = len;
+        f->blocks[n++] = (tx_dma_block_t){ first, &l->data[pos] };
+        if (len > first) {
+            f->blocks[n++] = (tx_dma_block_t){ len - first, l->data };
+        }
     }
 
+    // --- v6 CRC (bytes 10..13, little-endian) over header and payload ---
+    if (proto_version >= SPI_PROTO_V6) {
+        crc32_begin();
+        crc32_update(f->hdr, SPI_SLAVE_READ_HDR_SIZE);
+        for (uint i = 1; i < n; i++) {
+            crc32_update(f->blocks[i].read_addr, f->blocks[i].len);
+        }
+        uint32_t crc = crc32_end();
+        for (uint i = 0; i < SPI_SLAVE_CRC_SIZE; i++) {
+            f->hdr[SPI_SLAVE_READ_HDR_SIZE + i] = (uint8_t)(crc >> (8 * i));
+        }
+        hdr_len += SPI_SLAVE_CRC_SIZE;
+    }
+    f->blocks[0].len = hdr_len;
+
     stats.tx_bytes += payload_len;
 
-    // Configure one-shot TX DMA: staging buffer -> SPI TX FIFO
-    dma_channel_config tx_config = dma_channel_get_default_config(dma_tx_chan);
-    channel_config_set_transfer_data_size(&tx_config, DMA_SIZE_8);
-    channel_config_set_read_increment(&tx_config, true);
-    channel_config_set_write_increment(&tx_config, false);
-    channel_config_set_dreq(&tx_config, spi_get_dreq(SPI_SLAVE_SPI, true));
+    if (proto_version == SPI_PROTO_V1) {
+        if (frame_len < SPI_SLAVE_MAX_PAYLOAD) {
+            f->blocks[n++] = (tx_dma_block_t){ SPI_SLAVE_MAX_PAYLOAD - frame_len, tx_zero_pad };
+        }
+        f->read_size = SPI_SLAVE_READ_SIZE;
+        f->cs_edges = 1;
+    } else {
+        // v2+: the Zero clocks exactly header + LEN bytes, no padding.
+        f->read_size = hdr_len + frame_len;
+        f->cs_edges = (frame_len > 0) ? 2 : 1;
+    }
+    f->blocks[n] = (tx_dma_block_t){ 0, NULL };
+}
 
-    dma_channel_configure(
-        dma_tx_chan,
-        &tx_config,
-        &spi_get_hw(SPI_SLAVE_SPI)->dr,
-        tx_buf,
-        SPI_SLAVE_READ_SIZE,
-        true  // Start immediately -- FIFO will fill, DMA stalls on DREQ
-    );
+// Load a staged frame into the TX DMA and assert READY.
+static void start_tx_frame(uint idx) {
+    tx_frame_active = idx;
+    tx_read_cs_remaining = tx_frames[idx].cs_edges;
+
+    // Start the control channel from the first block.  Each block it
+    // writes re-triggers dma_tx_chan, which chains back to it when done;
+    // the data channel stalls on the SPI TX DREQ until the Zero clocks.
+    dma_channel_set_read_addr(dma_tx_ctrl_chan, tx_frames[idx].blocks, true);
 
     // DMA is loaded. Assert READY -- master may now send READ.
     // Disable interrupts to prevent cs_rise_handler from seeing STATE_READY
@@ -241,35 +632,93 @@ static void prepare_and_load_tx(void) {
     restore_interrupts(saved);
 }
 
+// Reset the SPI block into slave mode.  spi_init() resets it first, which
+// is also the only way to empty the PL022's TX FIFO.
+static void spi_slave_hw_setup(void) {
+    // --- SPI slave mode, Mode 3 (CPOL=1, CPHA=1) ---
+    // PL022 slave in Mode 0 only processes 1 frame per CS assertion.
+    // Mode 3 allows continuous multi-byte transfers with CS held low.
+    spi_init(SPI_SLAVE_SPI, 75 * 1000 * 1000);  // Max internal clock for slave
+    spi_set_slave(SPI_SLAVE_SPI, true);
+    spi_set_format(SPI_SLAVE_SPI, 8, SPI_CPOL_1, SPI_CPHA_1, SPI_MSB_FIRST);
+}
+
+// Throw away whatever READ frame the TX DMA holds, including the bytes it
+// already pushed into the SPI TX FIFO, so the next frame starts clean.
+// Only safe between transactions (the Zero waits for READY).
+static void tx_dma_flush(void) {
+    dma_channel_abort(dma_tx_ctrl_chan);
+    dma_channel_abort(dma_tx_chan);
+    spi_slave_hw_setup();
+}
+
+// Resync to the DMA write position, like a protocol error, after |dropped|
+// bytes were lost to an overrun.  A READ lost in the span leaves its frame
+// unreleased; the Zero's next REQUEST drops it and the bytes are resent.
+static void resync_rx(uint32_t total_written, uint32_t dropped) {
+    dma_rx_total_read = total_written;
+    rx_read_idx = total_written & (SPI_SLAVE_RX_RING_SIZE - 1);
+    rx_need_total = total_written + 1;
+
+    static const char msg[] = "SPI RX overrun, data lost";
+    spi_slave_tx_queue_tlv(0x00, (const uint8_t *)msg, sizeof(msg) - 1);
+    if (rx_loss_callback) {
+        rx_loss_callback(dropped);
+    }
+}
+
 // ============================================================================
 // Process one complete transaction from the RX ring buffer.
 // Uses unread-byte accounting from the DMA epoch/counter pair, so a full
 // ring cannot be mistaken for empty when write_idx == read_idx.
 // Returns true if a transaction was consumed (caller should loop).
-// Returns false if no complete transaction is available yet.
+// Returns false if no complete transaction is available yet, having set
+// rx_need_total to the bytes it is waiting for.
 // ============================================================================
 
+// Consume |n| bytes at the read position and parse afresh after them.
+static inline void rx_consume(uint n) {
+    dma_rx_total_read += n;
+    rx_read_idx = (rx_read_idx + n) & (SPI_SLAVE_RX_RING_SIZE - 1);
+    rx_need_total = dma_rx_total_read + 1;
+}
+
+// Wait for the transaction at the read position to reach |n| bytes.
+static inline bool rx_wait_for(uint n) {
+    rx_need_total = dma_rx_total_read + n;
+    return false;
+}
+
 static bool process_transaction(void) {
     uint32_t total_written = get_dma_rx_total_written();
     uint32_t unread = total_written - dma_rx_total_read;
 
     if (unread > SPI_SLAVE_RX_RING_SIZE) {
-        printf("!!! FATAL: SPI RX DMA OVERRUN: %lu bytes lost\n",
-               (unsigned long)(unread - SPI_SLAVE_RX_RING_SIZE));
-        for (;;) tight_loop_contents();
+        printf("!!! SPI RX DMA OVERRUN: resynced, %lu bytes dropped\n",
+               (unsigned long)unread);
+        stats.rx_dma_overruns++;
+        resync_rx(total_written, unread);
+        return true;
     }
+    ring_stats_sample(&stats.rx_ring, unread);
+
+    // Still short of what the last call was waiting for
+    if ((int32_t)(total_written - rx_need_total) < 0) return false;
 
     uint rd = rx_read_idx;
     uint avail = (uint)unread;
 
-    if (avail == 0) return false;
-
     uint8_t cmd = rx_ring[rd];
 
+    // v6: the Zero moved on without a NAK, so it took the last READ.
+    if (cmd != SPI_CMD_NAK) {
+        tx_read_ack();
+    }
+
     switch (cmd) {
         case SPI_CMD_WRITE: {
             // Need at least 3 bytes (cmd + 2-byte length) to determine size.
-            if (avail < 3) return false;
+            if (avail < 3) return rx_wait_for(3);
 
             uint8_t len_hi = rx_ring[(rd + 1) & (SPI_SLAVE_RX_RING_SIZE - 1)];
             uint8_t len_lo = rx_ring[(rd + 2) & (SPI_SLAVE_RX_RING_SIZE - 1)];
@@ -277,60 +726,139 @@ static bool process_transaction(void) {
 
             if (payload_len > SPI_SLAVE_MAX_PAYLOAD) {
                 stats.proto_errors++;
-                dma_rx_total_read += avail;
-                rx_read_idx = (rd + avail) & (SPI_SLAVE_RX_RING_SIZE - 1);
+                rx_consume(avail);
                 return true;
             }
 
+            // v6 adds SEQ ahead of the payload and a CRC after it.
+            bool checked = proto_version >= SPI_PROTO_V6;
+            uint hdr_len = checked ? 4 : 3;
+            uint frame_len = hdr_len + payload_len + (checked ? SPI_SLAVE_CRC_SIZE : 0);
+
             // Wait until all payload bytes have been written by DMA.
-            if (avail < 3 + (uint)payload_len) return false;
+            if (avail < frame_len) return rx_wait_for(frame_len);
+
+            if (checked && !write_frame_ok(rd, payload_len)) {
+                rx_consume(frame_len);
+                return true;
+            }
 
-            rd = (rd + 3) & (SPI_SLAVE_RX_RING_SIZE - 1);  // Skip cmd + len
+            rd = (rd + hdr_len) & (SPI_SLAVE_RX_RING_SIZE - 1);  // Skip cmd + len (+ seq)
 
             stats.rx_writes++;
             stats.rx_bytes += payload_len;
+#if BRIDGE_EVENT_TRACE
+            evt_record(&evt_spi, EVT_SPI_WRITE, 0xFF, payload_len);
+#endif
 
             if (rx_callback && payload_len > 0) {
-                // Copy in up to two chunks (handles ring wrap)
-                uint16_t first = SPI_SLAVE_RX_RING_SIZE - rd;
-                if (first > payload_len) first = payload_len;
-                memcpy(rx_temp, &rx_ring[rd], first);
-                if (payload_len > first) {
+                const uint8_t *data;
+                if (rd + payload_len <= SPI_SLAVE_RX_RING_SIZE) {
+                    // Contiguous in the ring - point directly into DMA buffer
+                    data = &rx_ring[rd];
+                } else {
+                    // Wraps around the ring boundary - assemble contiguous copy
+                    uint16_t first = SPI_SLAVE_RX_RING_SIZE - rd;
+                    memcpy(rx_temp, &rx_ring[rd], first);
                     memcpy(rx_temp + first, rx_ring, payload_len - first);
+                    data = rx_temp;
+                }
+                rx_callback(data, payload_len);
+
+                // If DMA has lapped the payload while the callback read it,
+                // the bytes it saw may have been overwritten mid-read.  They
+                // can't be taken back; resync past them.
+                uint32_t written_now = get_dma_rx_total_written();
+                if (written_now - (dma_rx_total_read + hdr_len) > SPI_SLAVE_RX_RING_SIZE) {
+                    printf("!!! SPI RX BANKRUPTCY: DMA overran data during "
+                           "callback (%u bytes)\n", payload_len);
+                    stats.rx_bankruptcies++;
+                    resync_rx(written_now, written_now - dma_rx_total_read);
+                    return true;
                 }
-                rx_callback(rx_temp, payload_len);
             }
 
-            dma_rx_total_read += 3 + payload_len;
-            rx_read_idx = (rd + payload_len) & (SPI_SLAVE_RX_RING_SIZE - 1);
+            rx_consume(frame_len);
             return true;
         }
 
         case SPI_CMD_REQUEST: {
             stats.requests++;
+#if BRIDGE_EVENT_TRACE
+            evt_record(&evt_spi, EVT_SPI_REQUEST, 0xFF, 0);
+#endif
+            // Every earlier READ has been parsed by now, so no frame should
+            // be outstanding.  If one is (a READ never completed), drop it
+            // and resend its bytes.
+            tx_queue_unclaim();
+            tx_frame_next_staged = false;
             state = STATE_REQUESTED;
             irq_pin_deassert();
-            dma_rx_total_read += 1;
-            rx_read_idx = (rd + 1) & (SPI_SLAVE_RX_RING_SIZE - 1);
+            rx_consume(1);
+            return true;
+        }
+
+        case SPI_CMD_NAK: {
+            // v6: the last READ failed the Zero's CRC check.  Keep its bytes,
+            // drop anything staged after them and start over as if this
+            // were a REQUEST.  READY drops first, so a frame loaded for a
+            // pipelined READ can't be mistaken for the resend.
+            stats.tx_naks++;
+            ready_pin_deassert();
+            tx_read_cs_remaining = 0;
+            tx_read_unacked = false;
+            tx_queue_unclaim();
+            tx_frame_next_staged = false;
+            tx_dma_flush();
+            state = STATE_REQUESTED;
+            irq_pin_deassert();
+            rx_consume(1);
+            return true;
+        }
+
+        case SPI_CMD_SET_VERSION: {
+            if (avail < 2) return rx_wait_for(2);
+            uint8_t version = rx_ring[(rd + 1) & (SPI_SLAVE_RX_RING_SIZE - 1)];
+            rx_consume(2);
+
+            if (version == 0) {
+                stats.proto_errors++;
+                return true;
+            }
+            // Settle on the highest version both sides understand.
+            if (version > SPI_PROTO_MAX) version = SPI_PROTO_MAX;
+
+            // Ack on Device 1; the switch happens when the ack leaves the queue.
+            uint8_t ack[2] = { 'V', version };
+            if (spi_slave_tx_queue_tlv(0x01, ack, sizeof(ack))) {
+                proto_version_pending = version;
+                proto_version_ack_offset = tx_lanes[0x01].len;
+            }
             return true;
         }
 
         case SPI_CMD_READ: {
-            // READ is a fixed-size transaction. Wait until all bytes are in
-            // the ring before consuming, so the bytes don't bleed into the
-            // next transaction's parsing.
-            if (avail < SPI_SLAVE_READ_SIZE) return false;
+            // READ size is fixed by the framing of the prepared frame. Wait
+            // until all bytes are in the ring before consuming, so the bytes
+            // don't bleed into the next transaction's parsing.
+            uint read_size = tx_frames[tx_frame_release].read_size;
+            if (avail < read_size) return rx_wait_for(read_size);
             // CS rise handler already deasserted READY and set state=IDLE.
+            // The frame has been clocked out, so its TLVs can leave the queue
+            // -- from v6, once the Zero's next command shows it arrived intact.
+            if (proto_version >= SPI_PROTO_V6) {
+                tx_read_unacked = true;
+            } else {
+                tx_queue_release_frame();
+            }
             stats.tx_reads++;
-            dma_rx_total_read += SPI_SLAVE_READ_SIZE;
-            rx_read_idx = (rd + SPI_SLAVE_READ_SIZE) & (SPI_SLAVE_RX_RING_SIZE - 1);
+            rx_consume(read_size);
             return true;
         }
 
         default: {
             stats.proto_errors++;
-            dma_rx_total_read += avail;
-            rx_read_idx = (rd + avail) & (SPI_SLAVE_RX_RING_SIZE - 1);
+            rx_consume(avail);
             return true;
         }
     }
@@ -351,12 +879,7 @@ bool spi_slave_init(void) {
     gpio_set_dir(SPI_SLAVE_PIN_READY, GPIO_OUT);
     ready_pin_deassert();
 
-    // --- SPI slave mode, Mode 3 (CPOL=1, CPHA=1) ---
-    // PL022 slave in Mode 0 only processes 1 frame per CS assertion.
-    // Mode 3 allows continuous multi-byte transfers with CS held low.
-    spi_init(SPI_SLAVE_SPI, 75 * 1000 * 1000);  // Max internal clock for slave
-    spi_set_slave(SPI_SLAVE_SPI, true);
-    spi_set_format(SPI_SLAVE_SPI, 8, SPI_CPOL_1, SPI_CPHA_1, SPI_MSB_FIRST);
+    spi_slave_hw_setup();
 
     gpio_set_function(SPI_SLAVE_PIN_RX,  GPIO_FUNC_SPI);
     gpio_set_function(SPI_SLAVE_PIN_CSN, GPIO_FUNC_SPI);
@@ -392,20 +915,98 @@ bool spi_slave_init(void) {
     irq_set_exclusive_handler(DMA_IRQ_1, spi_dma_rx_irq_handler);
     irq_set_enabled(DMA_IRQ_1, true);
 
-    // --- DMA: TX channel (configured per-REQUEST, not started yet) ---
+    // --- DMA: TX data + control channels (scatter-gather, per-REQUEST) ---
     dma_tx_chan = dma_claim_unused_channel(true);
+    dma_tx_ctrl_chan = dma_claim_unused_channel(true);
+
+    // Data channel: bytes -> SPI TX FIFO, paced by DREQ.  Read address and
+    // count come from each control block; chains back to the control
+    // channel to fetch the next one.
+    dma_channel_config tx_config = dma_channel_get_default_config(dma_tx_chan);
+    channel_config_set_transfer_data_size(&tx_config, DMA_SIZE_8);
+    channel_config_set_read_increment(&tx_config, true);
+    channel_config_set_write_increment(&tx_config, false);
+    channel_config_set_dreq(&tx_config, spi_get_dreq(SPI_SLAVE_SPI, true));
+    channel_config_set_chain_to(&tx_config, dma_tx_ctrl_chan);
+
+    dma_channel_configure(
+        dma_tx_chan,
+        &tx_config,
+        &spi_get_hw(SPI_SLAVE_SPI)->dr,
+        NULL,
+        0,
+        false
+    );
+
+    // Control channel: copies one 8-byte tx_dma_block_t into the data
+    // channel's {al3_transfer_count, al3_read_addr_trig} pair per trigger.
+    // The write ring wraps the destination over exactly those two words.
+    dma_channel_config ctrl_config = dma_channel_get_default_config(dma_tx_ctrl_chan);
+    channel_config_set_transfer_data_size(&ctrl_config, DMA_SIZE_32);
+    channel_config_set_read_increment(&ctrl_config, true);
+    channel_config_set_write_increment(&ctrl_config, true);
+    channel_config_set_ring(&ctrl_config, true, 3);  // 1 << 3 = 8 bytes
+
+    dma_channel_configure(
+        dma_tx_ctrl_chan,
+        &ctrl_config,
+        &dma_channel_hw_addr(dma_tx_chan)->al3_transfer_count,
+        tx_frames[0].blocks,
+        2,
+        false
+    );
+
+    // --- DMA: CRC channel (memory -> sink, watched by the sniffer) ---
+    dma_crc_chan = dma_claim_unused_channel(true);
+
+    dma_channel_config crc_config = dma_channel_get_default_config(dma_crc_chan);
+    channel_config_set_transfer_data_size(&crc_config, DMA_SIZE_8);
+    channel_config_set_read_increment(&crc_config, true);
+    channel_config_set_write_increment(&crc_config, false);
+    channel_config_set_sniff_enable(&crc_config, true);
+
+    dma_channel_configure(dma_crc_chan, &crc_config, &crc_sink, NULL, 0, false);
+
+    dma_sniffer_enable(dma_crc_chan, DMA_SNIFF_CTRL_CALC_VALUE_CRC32R, true);
+    dma_sniffer_set_output_reverse_enabled(true);
+    dma_sniffer_set_output_invert_enabled(true);
 
     // --- CS pin interrupt: rising edge (end of transaction) ---
     gpio_set_irq_enabled(SPI_SLAVE_PIN_CSN, GPIO_IRQ_EDGE_RISE, true);
 
     // --- Init state ---
-    memset(&stats, 0, sizeof(stats));
+    spi_slave_clear_stats();
     dma_rx_epoch = 0;
     dma_rx_total_read = 0;
     rx_read_idx = 0;
-    tx_queue_head = 0;
-    tx_queue_tail = 0;
+    rx_need_total = 1;
+    static const uint8_t lane_bits[BUS_MAX_DEVICES] = SPI_TX_LANE_BITS;
+    uint8_t *lane_data = tx_queue;
+    for (uint8_t d = 0; d < BUS_MAX_DEVICES; d++) {
+        tx_lane_t *l = &tx_lanes[d];
+        memset(l, 0, sizeof(*l));
+        l->data = lane_data;
+        l->size = 1u << lane_bits[d];
+        lane_data += l->size;
+#if BRIDGE_LATENCY_STATS
+        lat_marks_init(&l->lat_marks);
+#endif
+    }
     tx_queue_len = 0;
+    tx_queue_inflight = 0;
+    tx_lane_next = SPI_TX_CTRL_LANES;
+    proto_version = SPI_PROTO_V1;
+    proto_version_pending = 0;
+    tx_read_unacked = false;
+    write_seq_expected = 0;
+    write_nak_needed = false;
+    write_nak_queued = false;
+    memset(tx_frames, 0, sizeof(tx_frames));
+    tx_frames[0].read_size = tx_frames[1].read_size = SPI_SLAVE_READ_SIZE;
+    tx_frame_active = 0;
+    tx_frame_release = 0;
+    tx_frame_next_staged = false;
+    tx_read_cs_remaining = 0;
     rx_callback = NULL;
     state = STATE_IDLE;
 
@@ -419,33 +1020,65 @@ void spi_slave_set_rx_callback(spi_slave_rx_callback_t cb) {
     rx_callback = cb;
 }
 
-uint spi_slave_tx_queue_free(void) {
-    return SPI_TX_QUEUE_SIZE - tx_queue_len;
+void spi_slave_set_rx_loss_callback(spi_slave_rx_loss_callback_t cb) {
+    rx_loss_callback = cb;
+}
+
+void spi_slave_set_buf_free_fn(spi_slave_buf_free_fn_t fn) {
+    buf_free_fn = fn ? fn : bus_device_tx_free;
+}
+
+void spi_slave_set_freed_fn(spi_slave_freed_fn_t fn) {
+    freed_fn = fn ? fn : bus_device_tx_freed;
+}
+
+uint8_t spi_slave_proto_version(void) {
+    return proto_version;
+}
+
+uint spi_slave_tx_queue_free(uint8_t device) {
+    if (device >= BUS_MAX_DEVICES) return 0;
+    return tx_lanes[device].size - tx_lanes[device].len;
 }
 
 uint spi_slave_tx_queue_len(void) {
     return tx_queue_len;
 }
 
-bool spi_slave_tx_queue(const uint8_t *data, uint16_t len) {
-    if (len == 0) return true;
-    if (len > SPI_TX_QUEUE_SIZE - tx_queue_len) return false;
+// Append |len| bytes to a lane that has room for them.
+static void tx_lane_push(tx_lane_t *l, const uint8_t *data, uint len) {
+    uint first = l->size - l->tail;
+    if (first > len) first = len;
+    memcpy(&l->data[l->tail], data, first);
+    memcpy(l->data, data + first, len - first);
+    l->tail = (l->tail + len) & (l->size - 1);
+    l->len += len;
+}
 
-    uint tail = tx_queue_tail;
-    for (uint16_t i = 0; i < len; i++) {
-        tx_queue[tail] = data[i];
-        tail = (tail + 1) & (SPI_TX_QUEUE_SIZE - 1);
-    }
-    tx_queue_tail = tail;
-    tx_queue_len += len;
+bool spi_slave_tx_queue_tlv(uint8_t device, const uint8_t *data, uint8_t len) {
+    uint8_t header[2] = { device, len };
+#if BRIDGE_LATENCY_STATS
+    uint32_t stamp = lat_now();
+#endif
+
+    if (spi_slave_tx_queue_free(device) < (uint)len + sizeof(header)) return false;
+    tx_lane_t *l = &tx_lanes[device];
+    tx_lane_push(l, header, sizeof(header));
+    tx_lane_push(l, data, len);
+    tx_queue_len += sizeof(header) + len;
+    ring_stats_sample(&stats.tx_queue, tx_queue_len);
+#if BRIDGE_LATENCY_STATS
+    l->pushed += sizeof(header) + len;
+    lat_mark(&l->lat_marks, l->pushed, device, stamp);
+#endif
 
     // Assert IRQ if not already in a REQUEST/READ cycle.
     // Read state with interrupts disabled to avoid racing with cs_rise_handler.
     uint32_t saved = save_and_disable_interrupts();
     bool should_assert = (state == STATE_IDLE);
     restore_interrupts(saved);
-    DBG_PRINTF("spi_enqueue: +%d total=%d state=%d irq=%d\n",
-           len, tx_queue_len, (int)state, (int)should_assert);
+    DBG_PRINTF("spi_enqueue: dev=%d +%d total=%d state=%d irq=%d\n",
+           device, len + 2, tx_queue_len, (int)state, (int)should_assert);
     if (should_assert) {
         irq_pin_assert();
     }
@@ -453,29 +1086,72 @@ bool spi_slave_tx_queue(const uint8_t *data, uint16_t len) {
     return true;
 }
 
-bool spi_slave_tx_queue_tlv(uint8_t device, const uint8_t *data, uint8_t len) {
-    uint8_t header[2] = { device, len };
-
-    if (spi_slave_tx_queue_free() < (uint)len + sizeof(header)) return false;
-    if (!spi_slave_tx_queue(header, sizeof(header))) return false;
-    return spi_slave_tx_queue(data, len);
+// True if some device has freed SPI_CREDIT_IRQ_BYTES since the last frame
+// that carried credits.
+static bool credits_due(void) {
+    for (uint8_t d = 0; d < BUS_MAX_DEVICES; d++) {
+        if ((uint16_t)(freed_fn(d) - credit_staged[d]) >= SPI_CREDIT_IRQ_BYTES) {
+            return true;
+        }
+    }
+    return false;
 }
 
 void spi_slave_task(void) {
     // Drain all complete transactions from the RX ring.
     while (process_transaction());
 
+    // A WRITE NAK that found the queue full
+    if (write_nak_needed) {
+        write_nak_send();
+    }
+
     // If REQUEST was received, prepare TX and assert READY
     if (state == STATE_REQUESTED) {
-        prepare_and_load_tx();
+        stage_tx_frame(tx_frame_release);
+        start_tx_frame(tx_frame_release);
+    }
+
+    // Pipelined (v3): stage the promised follow-up while the current READ
+    // is still being clocked, then load it as soon as that READ ends.  In
+    // v6 the follow-up reuses the slot of the READ before, which stays
+    // unacked until the Zero's next command, so wait for that first.
+    if (state == STATE_READY && tx_frames[tx_frame_active].more &&
+        !tx_frame_next_staged && !tx_read_unacked) {
+        stage_tx_frame(tx_frame_active ^ 1);
+        tx_frame_next_staged = true;
+    }
+    if (state == STATE_PIPELINED) {
+        if (!tx_frame_next_staged) {
+            stage_tx_frame(tx_frame_active ^ 1);
+        }
+        tx_frame_next_staged = false;
+        start_tx_frame(tx_frame_active ^ 1);
     }
 
     // After a READ completes (state returned to IDLE), check if more data
     // is queued and re-assert IRQ if so
-    if (state == STATE_IDLE && tx_queue_len > 0) {
+    if (state == STATE_IDLE && tx_queue_len > tx_queue_inflight) {
         DBG_PRINTF("spi_task: re-assert IRQ, queue=%d\n", tx_queue_len);
         irq_pin_assert();
     }
+
+    // v5: a big drain is worth a READ of its own, so the Zero can refill
+    if (state == STATE_IDLE && proto_version >= SPI_PROTO_V5 && credits_due()) {
+        irq_pin_assert();
+    }
+}
+
+bool spi_slave_idle(void) {
+    // A partial transaction is idle until the rest arrives; its closing CS
+    // edge IRQ is the wakeup.  That can beat the DMA draining the SPI RX
+    // FIFO, so FIFO bytes still count as work.
+    if ((int32_t)(get_dma_rx_total_written() - rx_need_total) >= 0) return false;
+    if (spi_is_readable(SPI_SLAVE_SPI)) return false;
+    if (state == STATE_REQUESTED || state == STATE_PIPELINED) return false;
+    if (state == STATE_READY && tx_frames[tx_frame_active].more &&
+        !tx_frame_next_staged) return false;
+    return true;
 }
 
 bool spi_slave_is_connected(void) {
@@ -488,4 +1164,6 @@ spi_slave_stats_t spi_slave_get_stats(void) {
 
 void spi_slave_clear_stats(void) {
     memset(&stats, 0, sizeof(stats));
+    ring_stats_init(&stats.rx_ring, SPI_SLAVE_RX_RING_SIZE);
+    ring_stats_init(&stats.tx_queue, SPI_TX_QUEUE_SIZE);
 }
@@ -3,8 +3,9 @@
  *
  * Protocol: see pico_zero_interface/README.md
  *
- * Three commands: WRITE (Zero->Pico), REQUEST (ask Pico to prepare),
- * READ (fetch Pico's response after READY).
+ * Five commands: WRITE (Zero->Pico), REQUEST (ask Pico to prepare),
+ * READ (fetch Pico's response after READY), SET_VERSION (negotiate
+ * READ framing), NAK (v6: resend the last READ, it failed its CRC).
  *
  * Pin assignments (SPI0, chosen to avoid 6502 bus GPIOs 0-13):
  *   GPIO 16 = SPI0 RX  (MOSI from Zero)
@@ -22,16 +23,61 @@
 #include <stdbool.h>
 
 #include "bridge_defs.h"
+#include "ring_stats.h"
 
 // --- Protocol constants (must match Zero side) ---
 
 #define SPI_SLAVE_MAX_PAYLOAD   1542    // 257*6: room for 6 max-size TLV packets
 #define SPI_SLAVE_READ_SIZE     (SPI_SLAVE_MAX_PAYLOAD + 10)  // 8 buf + 2 len + payload
+#define SPI_SLAVE_READ_HDR_SIZE 10                            // 8 buf + 2 len
+#define SPI_SLAVE_CRC_SIZE      4                             // v6 CRC-32, little-endian
+
+// Protocol versions.  v1: every READ is exactly SPI_SLAVE_READ_SIZE bytes.
+// v2: a READ is the 10-byte header, then (if LEN > 0) a second transaction
+// of exactly LEN bytes.  The Zero negotiates v2 with SET_VERSION.
+// v3: v2 framing plus pipelining -- a READ whose LEN_HI has
+// SPI_READ_LEN_MORE set is followed by another frame without a REQUEST.
+// v4: v3 with BUF fields in SPI_BUF_UNIT_V4 units, so buffers larger than
+// 4 KB (bridge_defs.h) can be reported.
+// v5: v4 plus credits -- a READ frame whose bytes-freed counts changed since
+// the Zero last saw them starts with a Device 1 ['K', freed u16 LE x8] TLV.
+// v6: v5 plus CRC-32 (IEEE, as zlib) on every frame.  The READ header grows
+// to [BUF x8][LEN x2][CRC x4], the CRC covering header and payload, and a
+// bad READ is NAKed.  A WRITE becomes [0x01][LEN x2][SEQ][payload][CRC x4]
+// over LEN..payload; one that fails, or skips a SEQ, is dropped and answered
+// with a Device 1 ['N', expected SEQ] TLV so the Zero resends from there.
+// v7: v6 framing; the Zero may also send compressed device data as Device 0
+// ['Z'] TLVs (main.c), which an older Pico would drop.
+// v8: v7 plus TLV NAKs -- a TLV whose device buffer has no room is answered
+// with a Device 1 ['D', device, seq, epoch] TLV, for the Zero to resend
+// from, instead of being dropped quietly (main.c).
+#define SPI_PROTO_V1    1
+#define SPI_PROTO_V2    2
+#define SPI_PROTO_V3    3
+#define SPI_PROTO_V4    4
+#define SPI_PROTO_V5    5
+#define SPI_PROTO_V6    6
+#define SPI_PROTO_V7    7
+#define SPI_PROTO_V8    8
+#define SPI_PROTO_MAX   SPI_PROTO_V8
+
+#define SPI_BUF_UNIT        16      // Bytes per BUF count, v1-v3
+#define SPI_BUF_UNIT_V4     64      // Bytes per BUF count, v4
+
+#define SPI_READ_LEN_MORE   0x80    // LEN_HI flag (v3): next frame is pipelined
+
+#define SPI_CREDIT_TLV_LEN  (2 + 1 + 2 * BUS_MAX_DEVICES)  // [0x01][17]['K'][freed x8]
+// v5: raise IRQ for a credit-only READ once a device has freed this many
+// bytes the Zero hasn't been told about, so it can refill without polling.
+#define SPI_CREDIT_IRQ_BYTES 1024
 
 // Command bytes (first byte of MOSI)
 #define SPI_CMD_WRITE   0x01
 #define SPI_CMD_REQUEST 0x02
 #define SPI_CMD_READ    0x03
+#define SPI_CMD_SET_VERSION 0x04    // [0x04][version]; acked by a Device 1 'V' TLV
+                                    // carrying the version actually adopted
+#define SPI_CMD_NAK     0x05        // v6: the last READ failed its CRC, send it again
 
 // --- Pin assignments ---
 
@@ -56,20 +102,17 @@ _Static_assert((SPI_SLAVE_RX_RING_SIZE & (SPI_SLAVE_RX_RING_SIZE - 1)) == 0,
 // Initialize SPI slave hardware, DMA, and GPIO.
 bool spi_slave_init(void);
 
-// Returns the number of free bytes in the TX queue.
-uint spi_slave_tx_queue_free(void);
+// Returns the number of free bytes in |device|'s TX lane (sizes in
+// bridge_defs.h).
+uint spi_slave_tx_queue_free(uint8_t device);
 
-// Returns the number of bytes currently in the TX queue.
+// Returns the number of bytes currently queued in all TX lanes.
 uint spi_slave_tx_queue_len(void);
 
-// Queue data for the Zero to READ. Copies data into internal TX queue.
-// Returns false if the TX queue is full.
+// Queue one complete TLV packet for the Zero to READ, copied into the
+// device's TX lane.  Returns false if the lane does not have room for
+// the header and payload together.
 // If IRQ is not already asserted, this will assert it.
-bool spi_slave_tx_queue(const uint8_t *data, uint16_t len);
-
-// Queue one complete TLV packet for the Zero to READ.
-// Returns false if the internal TX queue does not have room for the
-// header and payload together.
 bool spi_slave_tx_queue_tlv(uint8_t device, const uint8_t *data, uint8_t len);
 
 // Call regularly from main loop. Processes completed RX transactions,
@@ -77,12 +120,38 @@ bool spi_slave_tx_queue_tlv(uint8_t device, const uint8_t *data, uint8_t len);
 // manages IRQ/READY state after READ completes.
 void spi_slave_task(void);
 
+// Returns true when spi_slave_task() has nothing left to do until the next
+// SPI event (CS edge).  Unparsed RX bytes count as work, so a transaction
+// whose tail the DMA hadn't landed yet at CS rise can't be missed.
+bool spi_slave_idle(void);
+
 // RX callback: called when a WRITE payload is received from the Zero.
 // |data| points to a contiguous buffer containing the complete payload;
 // it is only valid for the duration of the callback.
 typedef void (*spi_slave_rx_callback_t)(const uint8_t *data, uint16_t len);
 void spi_slave_set_rx_callback(spi_slave_rx_callback_t cb);
 
+// RX loss callback: called after the RX DMA ring overran the parser and
+// spi_slave_task() resynchronized by dropping |bytes_lost| bytes, which
+// may have included WRITE payloads.  A Device 0 error string is queued
+// for the Zero either way.
+typedef void (*spi_slave_rx_loss_callback_t)(uint32_t bytes_lost);
+void spi_slave_set_rx_loss_callback(spi_slave_rx_loss_callback_t cb);
+
+// Per-device free-space query used to fill the BUF fields of each READ
+// response.  Defaults to bus_device_tx_free(); the dual-core build
+// overrides it to also account for bytes still in flight between cores.
+typedef uint16_t (*spi_slave_buf_free_fn_t)(uint8_t device);
+void spi_slave_set_buf_free_fn(spi_slave_buf_free_fn_t fn);
+
+// Per-device bytes-freed count used for the v5 credits.  Defaults to
+// bus_device_tx_freed(); main.c adds the bytes of TLVs it refused (v8).
+typedef uint16_t (*spi_slave_freed_fn_t)(uint8_t device);
+void spi_slave_set_freed_fn(spi_slave_freed_fn_t fn);
+
+// The READ framing in use, an SPI_PROTO_* version.
+uint8_t spi_slave_proto_version(void);
+
 // Handle GPIO IRQs owned by the SPI slave.
 // Call this from the bridge's shared GPIO IRQ callback.
 void spi_slave_gpio_irq(uint gpio, uint32_t events);
@@ -90,6 +159,11 @@ void spi_slave_gpio_irq(uint gpio, uint32_t events);
 // Returns true if at least one SPI command has been received from the Zero.
 bool spi_slave_is_connected(void);
 
+// CRC-32 (IEEE, as zlib) of |a| followed by |b|, either of which may be
+// empty, on the DMA sniffer that checks v6 frames.  The sniffer has one
+// accumulator, so call only from the context that runs spi_slave_task().
+uint32_t spi_slave_crc32(const void *a, uint a_len, const void *b, uint b_len);
+
 // --- Stats ---
 
 typedef struct {
@@ -100,6 +174,12 @@ typedef struct {
     uint32_t requests;          // REQUEST commands handled
     uint32_t proto_errors;      // Protocol errors (bad CMD, etc.)
     uint32_t rx_dma_overruns;   // RX DMA ring overruns (data lost)
+    uint32_t rx_bankruptcies;   // DMA overran a WRITE during its callback
+    uint32_t rx_crc_errors;     // v6 WRITEs dropped for a bad CRC
+    uint32_t rx_seq_drops;      // v6 WRITEs dropped for an out-of-order SEQ
+    uint32_t tx_naks;           // v6 READs the Zero NAKed (and got again)
+    ring_stats_t rx_ring;       // RX DMA ring: unparsed bytes
+    ring_stats_t tx_queue;      // TX queue fill (bytes)
     bool     irq;               // Is IRQ currently asserted (for debugging)
 } spi_slave_stats_t;
 
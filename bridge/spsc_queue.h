@@ -0,0 +1,125 @@
+/*
+ * Lock-free single-producer / single-consumer byte queue.
+ *
+ * Used to hand TLV packets between the two RP2350 cores when the bridge
+ * is built with BRIDGE_DUAL_CORE.  The producer only ever writes |head|
+ * and the consumer only ever writes |tail|; both are free-running
+ * 32-bit counters, so the fill level is simply head - tail and a full
+ * queue is never confused with an empty one.
+ *
+ * A data memory barrier orders the payload stores before the index
+ * publish (producer) and the index load before the payload loads
+ * (consumer), which is all the Cortex-M33 needs across cores.
+ */
+
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "hardware/sync.h"
+
+typedef struct {
+    uint8_t *data;
+    uint32_t mask;              // size - 1 (size must be a power of two)
+    volatile uint32_t head;     // Written by producer only
+    volatile uint32_t tail;     // Written by consumer only
+} spsc_queue_t;
+
+static inline void spsc_init(spsc_queue_t *q, uint8_t *storage, uint32_t size) {
+    q->data = storage;
+    q->mask = size - 1;
+    q->head = 0;
+    q->tail = 0;
+}
+
+// Bytes currently queued.  Exact from the consumer's side, a lower bound
+// from the producer's side.
+static inline uint32_t spsc_count(const spsc_queue_t *q) {
+    return q->head - q->tail;
+}
+
+// Free space.  Exact from the producer's side, a lower bound from the
+// consumer's side.
+static inline uint32_t spsc_free(const spsc_queue_t *q) {
+    return (q->mask + 1) - (q->head - q->tail);
+}
+
+// Copy |len| bytes in at |head + offset| without publishing them.
+static inline void spsc_write_at(spsc_queue_t *q, uint32_t offset,
+                                 const uint8_t *src, uint32_t len) {
+    uint32_t pos = (q->head + offset) & q->mask;
+    uint32_t first = (q->mask + 1) - pos;
+    if (first > len) first = len;
+    memcpy(&q->data[pos], src, first);
+    if (len > first) {
+        memcpy(q->data, src + first, len - first);
+    }
+}
+
+// Queue one complete TLV packet.  The header and payload become visible
+// to the consumer together, so it never observes a partial packet.
+// Returns false (and queues nothing) if there is not enough room.
+static inline bool spsc_push_tlv(spsc_queue_t *q, uint8_t device,
+                                 const uint8_t *data, uint8_t len) {
+    if (spsc_free(q) < (uint32_t)len + 2) return false;
+
+    uint8_t header[2] = { device, len };
+    spsc_write_at(q, 0, header, sizeof(header));
+    spsc_write_at(q, 2, data, len);
+
+    __dmb();
+    q->head += 2 + len;
+    __sev();    // Wake a consumer sleeping in __wfe()
+    return true;
+}
+
+// Peek at the TLV packet starting |offset| bytes past the tail (0, or the
+// end of a packet already peeked) without consuming it.  Returns false if
+// no complete packet is queued there.
+static inline bool spsc_peek_tlv_at(const spsc_queue_t *q, uint32_t offset,
+                                    uint8_t *device, uint8_t *len) {
+    uint32_t count = spsc_count(q);
+    if (count < offset + 2) return false;
+    __dmb();
+
+    uint8_t tlv_len = q->data[(q->tail + offset + 1) & q->mask];
+    if (count < offset + 2u + tlv_len) return false;
+
+    *device = q->data[(q->tail + offset) & q->mask];
+    *len = tlv_len;
+    return true;
+}
+
+static inline bool spsc_peek_tlv(const spsc_queue_t *q, uint8_t *device, uint8_t *len) {
+    return spsc_peek_tlv_at(q, 0, device, len);
+}
+
+// Copy |len| queued bytes starting |offset| bytes past the tail into |dst|.
+static inline void spsc_read_at(const spsc_queue_t *q, uint32_t offset,
+                                uint8_t *dst, uint32_t len) {
+    uint32_t pos = (q->tail + offset) & q->mask;
+    uint32_t first = (q->mask + 1) - pos;
+    if (first > len) first = len;
+    memcpy(dst, &q->data[pos], first);
+    if (len > first) {
+        memcpy(dst + first, q->data, len - first);
+    }
+}
+
+// Release |n| bytes at the tail back to the producer.
+static inline void spsc_consume(spsc_queue_t *q, uint32_t n) {
+    __dmb();
+    q->tail += n;
+}
+
+// Consume the TLV packet last returned by spsc_peek_tlv, copying its
+// payload (|len| bytes) into |dst|.
+static inline void spsc_pop_tlv(spsc_queue_t *q, uint8_t *dst, uint8_t len) {
+    spsc_read_at(q, 2, dst, len);
+    spsc_consume(q, 2u + len);
+}
+
+#endif // SPSC_QUEUE_H
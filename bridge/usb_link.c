@@ -0,0 +1,353 @@
+/*
+ * USB link: the spi_slave.h API over the USB serial port, for bench
+ * setups without a Zero (BRIDGE_USB_LINK builds, which compile this in
+ * place of spi_slave.c).  main.c routes TLVs through it exactly as it
+ * does over SPI.
+ *
+ * Each way the stream is TLVs back to back, the [device][len][data] that
+ * WRITE and READ payloads carry, and there is no REQUEST/READY handshake:
+ * queued TLVs go out as fast as the CDC FIFO takes them.  Credits (a
+ * Device 1 ['K', freed x8] TLV, as in SPI v5) keep the host's estimates of
+ * the device buffers up to date.  Should the host overrun one anyway, the
+ * TLV waits here, and USB flow control holds the host off behind it until
+ * the 6502 makes room; nothing is dropped.
+ *
+ * The port belongs to the link, so stdio is switched off it.  The USB
+ * stack itself still runs from pico_stdio_usb's background task.
+ */
+
+#include "spi_slave.h"
+
+#include <string.h>
+
+#include "bus_interface.h"
+#include "hardware/dma.h"
+#include "pico/stdio.h"
+#include "pico/stdio_usb.h"
+#include "pico/stdlib.h"
+#include "tusb.h"
+
+// Longest changed credits wait for SPI_CREDIT_IRQ_BYTES to build up
+#define USB_CREDIT_US   1000
+
+// TX: one lane per device, as in spi_slave.c, sent a whole TLV at a time
+// (control lanes first, then the others in turn) but in as many pieces as
+// the CDC FIFO needs.
+typedef struct {
+    uint8_t *data;
+    uint size;          // Power of two
+    uint head;
+    uint tail;
+    uint len;
+} tx_lane_t;
+
+static uint8_t tx_queue[SPI_TX_QUEUE_SIZE];
+static tx_lane_t tx_lanes[BUS_MAX_DEVICES];
+static uint tx_queue_len = 0;
+static uint8_t tx_lane_next = SPI_TX_CTRL_LANES;
+static int tx_current = -1;         // Lane of the TLV going out, or -1
+static uint tx_current_left;        // Bytes of it still to send
+
+// RX: complete TLVs for the callback, then the one still arriving
+static uint8_t rx_buf[SPI_SLAVE_MAX_PAYLOAD];
+static uint rx_len = 0;             // Bytes in rx_buf
+static uint rx_tlv = 0;             // Where the incomplete TLV starts
+static uint16_t rx_batch[BUS_MAX_DEVICES];  // Data bytes per device in rx_buf[0, rx_tlv)
+
+// Credits: the bytes-freed counts last sent, and since when newer ones wait
+static uint16_t credit_sent[BUS_MAX_DEVICES];
+static bool credit_resync = true;   // Send credits even if unchanged (new session)
+static bool credit_waiting = false;
+static uint32_t credit_since;
+
+static bool was_connected = false;
+static int dma_crc_chan = -1;
+static uint8_t crc_sink;
+
+static spi_slave_rx_callback_t rx_callback = NULL;
+static spi_slave_buf_free_fn_t buf_free_fn = bus_device_tx_free;
+static spi_slave_freed_fn_t freed_fn = bus_device_tx_freed;
+static spi_slave_stats_t stats;
+
+// ============================================================================
+// CRC
+// ============================================================================
+
+// As spi_slave.c: the DMA sniffer's CRC-32 over bit-reversed data, read
+// back reversed and inverted, which is the reflected IEEE CRC-32.
+
+static void crc32_update(const void *data, uint len) {
+    if (len == 0) return;
+    dma_channel_set_read_addr(dma_crc_chan, data, false);
+    dma_channel_set_trans_count(dma_crc_chan, len, true);
+    dma_channel_wait_for_finish_blocking(dma_crc_chan);
+}
+
+uint32_t spi_slave_crc32(const void *a, uint a_len, const void *b, uint b_len) {
+    dma_sniffer_set_data_accumulator(0xFFFFFFFFu);
+    crc32_update(a, a_len);
+    crc32_update(b, b_len);
+    return dma_sniffer_get_data_accumulator();
+}
+
+// ============================================================================
+// Zero -> 6502
+// ============================================================================
+
+// Hand the complete TLVs to the callback, keeping the one still arriving.
+static void rx_deliver(void) {
+    if (rx_tlv == 0) return;
+    if (rx_callback) rx_callback(rx_buf, (uint16_t)rx_tlv);
+    memmove(rx_buf, &rx_buf[rx_tlv], rx_len - rx_tlv);
+    rx_len -= rx_tlv;
+    rx_tlv = 0;
+    memset(rx_batch, 0, sizeof(rx_batch));
+}
+
+// Read the port a TLV at a time, never past the end of the current one,
+// so a TLV whose device has no room leaves the rest of the stream in USB.
+static void rx_task(void) {
+    for (;;) {
+        uint have = rx_len - rx_tlv;
+        uint need = 2 + (have >= 2 ? rx_buf[rx_tlv + 1] : 0);
+        if (have < need) {
+            int n = stdio_usb.in_chars((char *)&rx_buf[rx_len], (int)(need - have));
+            if (n <= 0) break;
+            rx_len += (uint)n;
+            stats.rx_bytes += (uint)n;
+            ring_stats_sample(&stats.rx_ring, rx_len);
+            continue;
+        }
+
+        // Devices 2-7 go into bus buffers, which must have room for it
+        // after the TLVs before it
+        uint8_t device = rx_buf[rx_tlv];
+        uint8_t len = rx_buf[rx_tlv + 1];
+        if (device >= 2 && device < BUS_MAX_DEVICES &&
+            buf_free_fn(device) < (uint)rx_batch[device] + len) {
+            if (rx_tlv == 0) break;
+            rx_deliver();
+            continue;
+        }
+        if (device < BUS_MAX_DEVICES) rx_batch[device] += len;
+        rx_tlv += need;
+        stats.rx_writes++;
+        if (rx_tlv + 2 + 255 > sizeof(rx_buf)) rx_deliver();
+    }
+    rx_deliver();
+}
+
+// ============================================================================
+// 6502 -> Zero
+// ============================================================================
+
+static void tx_start(uint8_t device) {
+    tx_lane_t *l = &tx_lanes[device];
+    tx_current = device;
+    tx_current_left = 2 + l->data[(l->head + 1) & (l->size - 1)];
+}
+
+// Pick the next TLV to send.  Returns false if every lane is empty.
+static bool tx_next_tlv(void) {
+    for (uint8_t d = 0; d < SPI_TX_CTRL_LANES; d++) {
+        if (tx_lanes[d].len) {
+            tx_start(d);
+            return true;
+        }
+    }
+    const uint bulk = BUS_MAX_DEVICES - SPI_TX_CTRL_LANES;
+    for (uint i = 0; i < bulk; i++) {
+        uint8_t d = (uint8_t)(SPI_TX_CTRL_LANES + (tx_lane_next - SPI_TX_CTRL_LANES + i) % bulk);
+        if (tx_lanes[d].len) {
+            tx_lane_next = (uint8_t)(SPI_TX_CTRL_LANES + (d - SPI_TX_CTRL_LANES + 1) % bulk);
+            tx_start(d);
+            return true;
+        }
+    }
+    return false;
+}
+
+static void tx_task(void) {
+    for (;;) {
+        if (tx_current < 0 && !tx_next_tlv()) return;
+        uint room = tud_cdc_write_available();
+        if (room == 0) return;
+
+        tx_lane_t *l = &tx_lanes[tx_current];
+        uint n = tx_current_left < room ? tx_current_left : room;
+        uint first = l->size - l->head;
+        if (first > n) first = n;
+        stdio_usb.out_chars((const char *)&l->data[l->head], (int)first);
+        if (n > first) stdio_usb.out_chars((const char *)l->data, (int)(n - first));
+        l->head = (l->head + n) & (l->size - 1);
+        l->len -= n;
+        tx_queue_len -= n;
+        stats.tx_bytes += n;
+        ring_stats_sample(&stats.tx_queue, tx_queue_len);
+
+        tx_current_left -= n;
+        if (tx_current_left == 0) {
+            tx_current = -1;
+            stats.tx_reads++;
+        }
+    }
+}
+
+// Queue credits once the freed counts have moved SPI_CREDIT_IRQ_BYTES or
+// waited USB_CREDIT_US, so a trickle of reads doesn't cost a TLV each.
+static void credit_task(void) {
+    uint16_t freed[BUS_MAX_DEVICES];
+    bool changed = credit_resync, due = credit_resync;
+    for (uint8_t d = 0; d < BUS_MAX_DEVICES; d++) {
+        freed[d] = freed_fn(d);
+        uint16_t moved = (uint16_t)(freed[d] - credit_sent[d]);
+        changed |= moved != 0;
+        due |= moved >= SPI_CREDIT_IRQ_BYTES;
+    }
+    if (!changed) return;
+    uint32_t now = time_us_32();
+    if (!credit_waiting) {
+        credit_waiting = true;
+        credit_since = now;
+    }
+    if (!due && now - credit_since < USB_CREDIT_US) return;
+
+    uint8_t msg[SPI_CREDIT_TLV_LEN - 2];
+    msg[0] = 'K';
+    for (uint8_t d = 0; d < BUS_MAX_DEVICES; d++) {
+        msg[1 + 2 * d] = (uint8_t)freed[d];
+        msg[2 + 2 * d] = (uint8_t)(freed[d] >> 8);
+    }
+    if (!spi_slave_tx_queue_tlv(0x01, msg, sizeof(msg))) return;
+    memcpy(credit_sent, freed, sizeof(credit_sent));
+    credit_resync = false;
+    credit_waiting = false;
+}
+
+// ============================================================================
+// API
+// ============================================================================
+
+bool spi_slave_init(void) {
+    stdio_set_driver_enabled(&stdio_usb, false);
+
+    dma_crc_chan = dma_claim_unused_channel(true);
+    dma_channel_config crc_config = dma_channel_get_default_config(dma_crc_chan);
+    channel_config_set_transfer_data_size(&crc_config, DMA_SIZE_8);
+    channel_config_set_read_increment(&crc_config, true);
+    channel_config_set_write_increment(&crc_config, false);
+    channel_config_set_sniff_enable(&crc_config, true);
+    dma_channel_configure(dma_crc_chan, &crc_config, &crc_sink, NULL, 0, false);
+    dma_sniffer_enable(dma_crc_chan, DMA_SNIFF_CTRL_CALC_VALUE_CRC32R, true);
+    dma_sniffer_set_output_reverse_enabled(true);
+    dma_sniffer_set_output_invert_enabled(true);
+
+    spi_slave_clear_stats();
+    static const uint8_t lane_bits[BUS_MAX_DEVICES] = SPI_TX_LANE_BITS;
+    uint8_t *lane_data = tx_queue;
+    for (uint8_t d = 0; d < BUS_MAX_DEVICES; d++) {
+        tx_lane_t *l = &tx_lanes[d];
+        memset(l, 0, sizeof(*l));
+        l->data = lane_data;
+        l->size = 1u << lane_bits[d];
+        lane_data += l->size;
+    }
+    tx_queue_len = 0;
+    tx_lane_next = SPI_TX_CTRL_LANES;
+    tx_current = -1;
+    rx_len = 0;
+    rx_tlv = 0;
+    memset(rx_batch, 0, sizeof(rx_batch));
+    credit_resync = true;
+    credit_waiting = false;
+    was_connected = false;
+    rx_callback = NULL;
+    return true;
+}
+
+void spi_slave_set_rx_callback(spi_slave_rx_callback_t cb) {
+    rx_callback = cb;
+}
+
+// The CDC stream can't overrun, so there is no loss to report.
+void spi_slave_set_rx_loss_callback(spi_slave_rx_loss_callback_t cb) {
+    (void)cb;
+}
+
+void spi_slave_set_buf_free_fn(spi_slave_buf_free_fn_t fn) {
+    buf_free_fn = fn ? fn : bus_device_tx_free;
+}
+
+void spi_slave_set_freed_fn(spi_slave_freed_fn_t fn) {
+    freed_fn = fn ? fn : bus_device_tx_freed;
+}
+
+// The stream's one framing has v7's TLVs and credits.  A TLV without room
+// waits in USB rather than being dropped, so v8's NAKs never come up.
+uint8_t spi_slave_proto_version(void) {
+    return SPI_PROTO_V7;
+}
+
+uint spi_slave_tx_queue_free(uint8_t device) {
+    if (device >= BUS_MAX_DEVICES) return 0;
+    return tx_lanes[device].size - tx_lanes[device].len;
+}
+
+uint spi_slave_tx_queue_len(void) {
+    return tx_queue_len;
+}
+
+bool spi_slave_tx_queue_tlv(uint8_t device, const uint8_t *data, uint8_t len) {
+    if (spi_slave_tx_queue_free(device) < (uint)len + 2) return false;
+    tx_lane_t *l = &tx_lanes[device];
+    const uint8_t header[2] = { device, len };
+    for (uint i = 0; i < 2u + len; i++) {
+        l->data[l->tail] = i < 2 ? header[i] : data[i - 2];
+        l->tail = (l->tail + 1) & (l->size - 1);
+    }
+    l->len += 2u + len;
+    tx_queue_len += 2u + len;
+    ring_stats_sample(&stats.tx_queue, tx_queue_len);
+    return true;
+}
+
+void spi_slave_task(void) {
+    // A host that has just opened the port starts its estimates afresh
+    bool connected = stdio_usb_connected();
+    if (connected && !was_connected) credit_resync = true;
+    was_connected = connected;
+
+    rx_task();
+    if (!connected) return;
+    credit_task();
+    tx_task();
+}
+
+bool spi_slave_idle(void) {
+    if (rx_len - rx_tlv < 2u + (rx_len - rx_tlv >= 2 ? rx_buf[rx_tlv + 1] : 0) &&
+        tud_cdc_available()) {
+        return false;
+    }
+    if (!stdio_usb_connected()) return true;
+    if (tx_queue_len && tud_cdc_write_available()) return false;
+    return !credit_waiting;
+}
+
+void spi_slave_gpio_irq(uint gpio, uint32_t events) {
+    (void)gpio;
+    (void)events;
+}
+
+bool spi_slave_is_connected(void) {
+    return stdio_usb_connected();
+}
+
+spi_slave_stats_t spi_slave_get_stats(void) {
+    return stats;
+}
+
+void spi_slave_clear_stats(void) {
+    memset(&stats, 0, sizeof(stats));
+    ring_stats_init(&stats.rx_ring, sizeof(rx_buf));
+    ring_stats_init(&stats.tx_queue, SPI_TX_QUEUE_SIZE);
+}
@@ -0,0 +1,17 @@
+// Builds the C 65C02 core for the `c-core` feature (see src/cpu.rs). For
+// wasm32 this needs a clang that targets it and a libc sysroot for the
+// headers fake65c02.h includes, e.g.
+//   CC_wasm32_unknown_unknown=clang CFLAGS_wasm32_unknown_unknown=--sysroot=/opt/wasi-sysroot
+fn main() {
+    #[cfg(feature = "c-core")]
+    {
+        println!("cargo:rerun-if-changed=csrc/core65c02.c");
+        println!("cargo:rerun-if-changed=../../TaliForth2/tools/c65/fake65c02.h");
+        cc::Build::new()
+            .file("csrc/core65c02.c")
+            .include("../../TaliForth2/tools/c65")
+            .opt_level(2)
+            .warnings(false)
+            .compile("core65c02");
+    }
+}
@@ -0,0 +1,128 @@
+/*
+ * 65C02 core for the c-core feature (see src/cpu.rs): fake65c02.h from the
+ * c65 tool, in instance mode with the switch dispatcher, its memory going
+ * back to MattbrewBus through emu_bus_read and emu_bus_write, which are
+ * told the cycle each access happens on.
+ *
+ * A run checks the breakpoint bitmap (bit pc & 7 of byte pc >> 3, or
+ * none) after each instruction, as the mos6502 version does, and a hit
+ * ends it by moving the tick goal to now. So do a WAI, a bus write that
+ * moves the next interrupt event, and, while IRQ is held but masked, an
+ * instruction that unmasks it: the caller takes it from there.
+ */
+
+#define FAKE6502_INSTANCE 1
+#define FAKE6502_SWITCH_CORE 1
+#include "fake65c02.h"
+
+typedef struct core65 {
+    cpu6502 cpu;                    /* first, so a cpu6502 * is a core65 * */
+    unsigned long long base;        /* the caller's cycle count at tick 0 */
+    const uint8 *breakpoints;
+    uint8 irq_masked;
+    uint8 hit;
+} core65;
+
+extern uint8 emu_bus_read(void *bus, ushort address, unsigned long long now);
+extern uint8 emu_bus_write(void *bus, ushort address, uint8 value, unsigned long long now);
+
+static uint8 core65_read(cpu6502 *cpu, ushort address) {
+    core65 *core = (core65 *)cpu;
+
+    return emu_bus_read(cpu->user, address, core->base + cpu->clockticks6502);
+}
+
+static void core65_write(cpu6502 *cpu, ushort address, uint8 value) {
+    core65 *core = (core65 *)cpu;
+
+    if (emu_bus_write(cpu->user, address, value, core->base + cpu->clockticks6502))
+        cpu->clockgoal6502 = cpu->clockticks6502;
+}
+
+static void core65_hook(cpu6502 *cpu) {
+    core65 *core = (core65 *)cpu;
+
+    if (core->breakpoints && (core->breakpoints[cpu->pc >> 3] & (1 << (cpu->pc & 7)))) {
+        core->hit = 1;
+        cpu->clockgoal6502 = cpu->clockticks6502;
+    }
+    if (cpu->waiting6502 || (core->irq_masked && !(cpu->status & FLAG_INTERRUPT)))
+        cpu->clockgoal6502 = cpu->clockticks6502;
+}
+
+unsigned long core65_size(void) {
+    return sizeof(core65);
+}
+
+void core65_init(core65 *core, void *bus) {
+    cpu6502_init(&core->cpu, core65_read, core65_write, bus);
+    core->base = 0;
+    core->breakpoints = 0;
+    core->irq_masked = 0;
+    core->hit = 0;
+}
+
+void core65_reset(core65 *core) {
+    cpu6502_reset(&core->cpu);
+}
+
+/* IRQ: vectors unless I is set, and ends a WAI either way */
+void core65_irq(core65 *core) {
+    cpu6502_irq(&core->cpu);
+    core->cpu.waiting6502 = 0;
+}
+
+/* one instruction at cycle now, returning its ticks, or 0 if the CPU is waiting */
+uint32 core65_step(core65 *core, unsigned long long now) {
+    if (core->cpu.waiting6502) return 0;
+    core->base = now;
+    return cpu6502_step(&core->cpu);
+}
+
+/* run from cycle now for at least budget ticks, or until one of the stops
+   above; waiting in WAI, the whole budget passes at once */
+uint32 core65_run(core65 *core, uint32 budget, unsigned long long now,
+                  const uint8 *breakpoints, uint8 irq_masked, uint8 *hit) {
+    uint32 ticks;
+
+    core->base = now;
+    core->breakpoints = breakpoints;
+    core->irq_masked = irq_masked;
+    core->hit = 0;
+    core->cpu.hook = core65_hook;
+    ticks = cpu6502_exec(&core->cpu, budget);
+    core->cpu.hook = 0;
+    *hit = core->hit;
+    return ticks;
+}
+
+ushort core65_pc(const core65 *core) {
+    return core->cpu.pc;
+}
+
+void core65_set_pc(core65 *core, ushort pc) {
+    core->cpu.pc = pc;
+}
+
+/* registers by number: 0 a, 1 x, 2 y, 3 sp, 4 status, 5 waiting in WAI */
+uint8 core65_reg(const core65 *core, int r) {
+    switch (r) {
+    case 0: return core->cpu.a;
+    case 1: return core->cpu.x;
+    case 2: return core->cpu.y;
+    case 3: return core->cpu.sp;
+    case 5: return core->cpu.waiting6502;
+    default: return core->cpu.status;
+    }
+}
+
+void core65_set_reg(core65 *core, int r, uint8 value) {
+    switch (r) {
+    case 0: core->cpu.a = value; break;
+    case 1: core->cpu.x = value; break;
+    case 2: core->cpu.y = value; break;
+    case 3: core->cpu.sp = value; break;
+    case 5: core->cpu.waiting6502 = value; break;
+    default: core->cpu.status = value; break;
+    }
+}
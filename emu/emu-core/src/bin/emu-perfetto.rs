@@ -0,0 +1,60 @@
+//! Merge device traces into one Chrome trace-event JSON timeline, to open
+//! in ui.perfetto.dev or chrome://tracing:
+//!
+//!     cargo run --release --bin emu-perfetto -- OUT.json TRACE... [--mhz F]
+//!
+//! A shein trace from a bridge built with BRIDGE_EVENT_TRACE has the
+//! Pico's events in it too, lined up with the Zero's clock. MHZ (default
+//! 1) is the 6502 clock an emulator trace's cycles are shown at.
+
+use std::process::ExitCode;
+
+use emu_core::{perfetto, trace};
+
+fn main() -> ExitCode {
+    let mut args = std::env::args().skip(1);
+    let mut paths = Vec::new();
+    let mut mhz = 1.0;
+    while let Some(arg) = args.next() {
+        if arg == "--mhz" {
+            match args.next().map(|v| v.parse::<f64>()) {
+                Some(Ok(v)) if v > 0.0 => mhz = v,
+                _ => {
+                    eprintln!("emu-perfetto: bad --mhz");
+                    return ExitCode::from(2);
+                }
+            }
+        } else {
+            paths.push(arg);
+        }
+    }
+    if paths.len() < 2 {
+        eprintln!("usage: emu-perfetto OUT.json TRACE... [--mhz F]");
+        return ExitCode::from(2);
+    }
+    let out = paths.remove(0);
+
+    let mut traces = Vec::new();
+    for path in paths {
+        let parsed = std::fs::read(&path)
+            .map_err(|e| e.to_string())
+            .and_then(|bytes| trace::parse(&bytes));
+        match parsed {
+            Ok(t) => traces.push((path, t)),
+            Err(e) => {
+                eprintln!("emu-perfetto: {path}: {e}");
+                return ExitCode::FAILURE;
+            }
+        }
+    }
+
+    let export = perfetto::export(&traces, mhz);
+    for note in &export.notes {
+        println!("{note}");
+    }
+    if let Err(e) = std::fs::write(&out, export.json) {
+        eprintln!("emu-perfetto: {out}: {e}");
+        return ExitCode::FAILURE;
+    }
+    ExitCode::SUCCESS
+}
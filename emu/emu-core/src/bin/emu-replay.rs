@@ -0,0 +1,63 @@
+//! Play a device trace back into a ROM at full speed, nothing rendered, so
+//! a slowdown caught on the real machine can be rerun and profiled:
+//!
+//!     cargo run --release --bin emu-replay -- ROM TRACE [MHZ]
+//!
+//! MHZ (default 1) is the 6502 clock a trace timed in microseconds (from
+//! shein) was recorded at.
+
+use std::process::ExitCode;
+use std::time::Instant;
+
+use emu_core::trace::{self, Replay};
+
+fn main() -> ExitCode {
+    let args: Vec<String> = std::env::args().collect();
+    if args.len() < 3 || args.len() > 4 {
+        eprintln!("usage: emu-replay ROM TRACE [MHZ]");
+        return ExitCode::from(2);
+    }
+    let read = |path: &str| {
+        std::fs::read(path).map_err(|e| eprintln!("emu-replay: {path}: {e}"))
+    };
+    let (Ok(rom), Ok(bytes)) = (read(&args[1]), read(&args[2])) else {
+        return ExitCode::FAILURE;
+    };
+    let trace = match trace::parse(&bytes) {
+        Ok(trace) => trace,
+        Err(e) => {
+            eprintln!("emu-replay: {}: {e}", args[2]);
+            return ExitCode::FAILURE;
+        }
+    };
+    let mhz = match args.get(3).map(|s| s.parse::<u64>()) {
+        None => 1,
+        Some(Ok(mhz)) if mhz > 0 => mhz,
+        Some(_) => {
+            eprintln!("emu-replay: bad MHZ {}", args[3]);
+            return ExitCode::from(2);
+        }
+    };
+
+    let mut replay = Replay::new(&rom, &trace, mhz);
+    let start = Instant::now();
+    let cycles = replay.run();
+    let secs = start.elapsed().as_secs_f64();
+
+    let stats = replay.stats();
+    println!(
+        "{} records, {cycles} cycles in {secs:.3} s ({:.1} MHz)",
+        trace.records.len(),
+        cycles as f64 / secs.max(1e-9) / 1e6
+    );
+    println!(
+        "writes {} ({} mismatched), reads {}, host bytes {}",
+        stats.writes, stats.mismatched, stats.reads, stats.host_bytes
+    );
+    if replay.done() {
+        ExitCode::SUCCESS
+    } else {
+        println!("trace not used up, PC={:#06X}", replay.pc());
+        ExitCode::FAILURE
+    }
+}
@@ -0,0 +1,152 @@
+//! Run the Mattbrew machine headless, as fast as it goes, for benchmarks
+//! and CI:
+//!
+//!     cargo run --release --bin emu-run -- ROM [--netboot DIR]
+//!         [--cycles N] [--until-output PATTERN] [--input TEXT]
+//!
+//! Every file in DIR can be netbooted or block loaded by its name, or by
+//! its name less the extension as the web UI uploads them. Device 2 output
+//! goes to stderr as it comes, and a JSON line of stats to stdout at the
+//! end. The run stops after N cycles (default 100M, 100 s at 1 MHz), once
+//! PATTERN has been output (exit 1 if it never is), or when the CPU stops.
+
+use std::io::Write;
+use std::process::ExitCode;
+use std::time::Instant;
+
+use emu_core::Emulator;
+
+const DEFAULT_CYCLES: u64 = 100_000_000;
+/// Cycles per run_for_cycles call, between output checks.
+const BATCH: u32 = 100_000;
+
+struct Args {
+    rom: String,
+    netboot: Option<String>,
+    cycles: u64,
+    until: Option<Vec<u8>>,
+    input: Vec<u8>,
+}
+
+fn parse_args() -> Result<Args, String> {
+    let mut args = std::env::args().skip(1);
+    let mut rom = None;
+    let mut parsed = Args {
+        rom: String::new(),
+        netboot: None,
+        cycles: DEFAULT_CYCLES,
+        until: None,
+        input: Vec::new(),
+    };
+    while let Some(arg) = args.next() {
+        let mut value = || args.next().ok_or(format!("{arg} needs a value"));
+        match arg.as_str() {
+            "--netboot" => parsed.netboot = Some(value()?),
+            "--cycles" => {
+                let v = value()?;
+                parsed.cycles = v.parse().map_err(|_| format!("bad --cycles {v}"))?;
+            }
+            "--until-output" => parsed.until = Some(value()?.into_bytes()),
+            "--input" => parsed.input = value()?.into_bytes(),
+            _ if arg.starts_with("--") => return Err(format!("unknown option {arg}")),
+            _ if rom.is_none() => rom = Some(arg),
+            _ => return Err(format!("unexpected argument {arg}")),
+        }
+    }
+    parsed.rom = rom.ok_or("no ROM given")?;
+    Ok(parsed)
+}
+
+fn load_netboot_dir(emu: &mut Emulator, dir: &str) -> std::io::Result<usize> {
+    let mut count = 0;
+    for entry in std::fs::read_dir(dir)? {
+        let path = entry?.path();
+        if !path.is_file() {
+            continue;
+        }
+        let data = std::fs::read(&path)?;
+        if let Some(name) = path.file_name().and_then(|n| n.to_str()) {
+            emu.upload_file(name, &data);
+        }
+        if let Some(stem) = path.file_stem().and_then(|n| n.to_str()) {
+            emu.upload_file(stem, &data);
+        }
+        count += 1;
+    }
+    Ok(count)
+}
+
+fn main() -> ExitCode {
+    let args = match parse_args() {
+        Ok(args) => args,
+        Err(e) => {
+            eprintln!("emu-run: {e}");
+            eprintln!(
+                "usage: emu-run ROM [--netboot DIR] [--cycles N] [--until-output PATTERN] [--input TEXT]"
+            );
+            return ExitCode::from(2);
+        }
+    };
+    let rom = match std::fs::read(&args.rom) {
+        Ok(rom) => rom,
+        Err(e) => {
+            eprintln!("emu-run: {}: {e}", args.rom);
+            return ExitCode::FAILURE;
+        }
+    };
+
+    let mut emu = Emulator::new();
+    if let Some(dir) = &args.netboot {
+        if let Err(e) = load_netboot_dir(&mut emu, dir) {
+            eprintln!("emu-run: {dir}: {e}");
+            return ExitCode::FAILURE;
+        }
+    }
+    emu.load_rom(&rom);
+    emu.capture_output(true);
+    emu.set_packet_log(false);
+    if !args.input.is_empty() {
+        emu.send_keyboard_input(&args.input);
+    }
+
+    // Output seen so far, far enough back to find PATTERN across batches
+    let mut window: Vec<u8> = Vec::new();
+    let mut matched = false;
+    let mut stderr = std::io::stderr();
+    let start = Instant::now();
+    let mut cycles = 0u64;
+    while cycles < args.cycles && !matched {
+        let budget = (args.cycles - cycles).min(BATCH as u64) as u32;
+        let ran = emu.run_for_cycles(budget);
+        cycles += ran as u64;
+
+        let output = emu.take_output();
+        let _ = stderr.write_all(&output);
+        if let Some(pattern) = &args.until {
+            window.extend_from_slice(&output);
+            matched = window.windows(pattern.len().max(1)).any(|w| w == &pattern[..]);
+            let keep = pattern.len().saturating_sub(1);
+            window.drain(..window.len().saturating_sub(keep));
+        }
+        if ran == 0 {
+            break;
+        }
+    }
+    let secs = start.elapsed().as_secs_f64();
+
+    let transactions = emu.bridge_transactions() as u64;
+    println!(
+        "{{\"cycles\":{cycles},\"seconds\":{secs:.6},\"mhz\":{:.3},\
+         \"bridge_transactions\":{transactions},\"cycles_per_transaction\":{:.1},\
+         \"matched\":{},\"pc\":{}}}",
+        cycles as f64 / secs.max(1e-9) / 1e6,
+        if transactions > 0 { cycles as f64 / transactions as f64 } else { 0.0 },
+        args.until.is_none() || matched,
+        emu.pc(),
+    );
+    if args.until.is_some() && !matched {
+        ExitCode::FAILURE
+    } else {
+        ExitCode::SUCCESS
+    }
+}
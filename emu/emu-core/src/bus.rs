@@ -1,5 +1,7 @@
 use std::collections::{HashMap, VecDeque};
 
+use crate::state::{Result, StateReader, StateWriter};
+use crate::trace::{KIND_READ, KIND_WRITE, TraceWriter};
 use crate::via::Via6522;
 use mos6502::memory::Bus;
 
@@ -8,12 +10,15 @@ pub(crate) const ROM_SIZE: usize = 0x1F00;
 const ROM_START: u16 = 0xE100;
 
 const TERM_COLS: usize = 40;
-const TERM_ROWS: usize = 25;
+pub(crate) const TERM_ROWS: usize = 25;
+const ALL_ROWS: u32 = (1 << TERM_ROWS) - 1;
 
 pub struct TextGrid {
     cells: [u8; TERM_COLS * TERM_ROWS],
     cursor_row: usize,
     cursor_col: usize,
+    /// Rows changed since `take_dirty_rows`, bit n for row n.
+    dirty_rows: u32,
 }
 
 impl TextGrid {
@@ -22,6 +27,7 @@ impl TextGrid {
             cells: [b' '; TERM_COLS * TERM_ROWS],
             cursor_row: 0,
             cursor_col: 0,
+            dirty_rows: ALL_ROWS,
         }
     }
 
@@ -29,6 +35,21 @@ impl TextGrid {
         self.cells.fill(b' ');
         self.cursor_row = 0;
         self.cursor_col = 0;
+        self.dirty_rows = ALL_ROWS;
+    }
+
+    pub fn is_dirty(&self) -> bool {
+        self.dirty_rows != 0
+    }
+
+    /// Rows changed since the last call, bit n for row n.
+    pub fn take_dirty_rows(&mut self) -> u32 {
+        std::mem::take(&mut self.dirty_rows)
+    }
+
+    /// The grid, one byte per cell, row by row.
+    pub fn cells_ptr(&self) -> *const u8 {
+        self.cells.as_ptr()
     }
 
     fn put_char(&mut self, c: u8) {
@@ -38,6 +59,7 @@ impl TextGrid {
                 if self.cursor_col > 0 {
                     self.cursor_col -= 1;
                     self.cells[self.cursor_row * TERM_COLS + self.cursor_col] = b' ';
+                    self.dirty_rows |= 1 << self.cursor_row;
                 }
             }
             0x0A | 0x0D => {
@@ -50,6 +72,7 @@ impl TextGrid {
             }
             _ => {
                 self.cells[self.cursor_row * TERM_COLS + self.cursor_col] = c;
+                self.dirty_rows |= 1 << self.cursor_row;
                 self.cursor_col += 1;
                 if self.cursor_col >= TERM_COLS {
                     self.cursor_col = 0;
@@ -62,10 +85,96 @@ impl TextGrid {
         }
     }
 
+    /// Apply a screen packet, the bytes after its 0x00 marker, as shein's
+    /// Terminal does (protocol.md, "Screen packets"). There are no styles,
+    /// so 'A' is skipped.
+    fn apply_screen(&mut self, mut cmds: &[u8]) {
+        while let Some((&cmd, rest)) = cmds.split_first() {
+            let args = match cmd {
+                b'G' => 2,
+                b'A' => 3,
+                b'W' => 1 + rest.first().map_or(0, |&n| n as usize),
+                b'F' => 2,
+                b'R' => 5,
+                b'C' => 6,
+                _ => return,
+            };
+            let Some(a) = rest.get(..args) else { return };
+            cmds = &rest[args..];
+            match cmd {
+                b'G' => {
+                    self.cursor_row = (a[0] as usize).min(TERM_ROWS - 1);
+                    self.cursor_col = (a[1] as usize).min(TERM_COLS - 1);
+                }
+                b'A' => {}
+                b'W' => {
+                    for &c in &a[1..] {
+                        if !self.put_cell(c) {
+                            break;
+                        }
+                    }
+                }
+                b'F' => {
+                    for _ in 0..a[0] {
+                        if !self.put_cell(a[1]) {
+                            break;
+                        }
+                    }
+                }
+                b'R' => {
+                    let (row, col) = (a[0] as usize, a[1] as usize);
+                    let end = (col + a[3] as usize).min(TERM_COLS);
+                    for r in row..(row + a[2] as usize).min(TERM_ROWS) {
+                        if col < end {
+                            self.cells[r * TERM_COLS + col..r * TERM_COLS + end].fill(a[4]);
+                            self.dirty_rows |= 1 << r;
+                        }
+                    }
+                }
+                _ => {
+                    let (row, col, to_row, to_col) =
+                        (a[0] as usize, a[1] as usize, a[4] as usize, a[5] as usize);
+                    let h = (a[2] as usize)
+                        .min(TERM_ROWS.saturating_sub(row))
+                        .min(TERM_ROWS.saturating_sub(to_row));
+                    let w = (a[3] as usize)
+                        .min(TERM_COLS.saturating_sub(col))
+                        .min(TERM_COLS.saturating_sub(to_col));
+                    if w == 0 {
+                        continue;
+                    }
+                    let rows: Vec<usize> = if to_row > row { (0..h).rev().collect() } else { (0..h).collect() };
+                    for i in rows {
+                        let from = (row + i) * TERM_COLS + col;
+                        self.cells.copy_within(from..from + w, (to_row + i) * TERM_COLS + to_col);
+                        self.dirty_rows |= 1 << (to_row + i);
+                    }
+                }
+            }
+        }
+    }
+
+    /// put_char for screen packets: no control characters and no scrolling,
+    /// false once the bottom right cell is written.
+    fn put_cell(&mut self, c: u8) -> bool {
+        self.cells[self.cursor_row * TERM_COLS + self.cursor_col] = c;
+        self.dirty_rows |= 1 << self.cursor_row;
+        if self.cursor_col + 1 < TERM_COLS {
+            self.cursor_col += 1;
+        } else if self.cursor_row + 1 < TERM_ROWS {
+            self.cursor_col = 0;
+            self.cursor_row += 1;
+        } else {
+            return false;
+        }
+        true
+    }
+
     fn scroll_up(&mut self) {
         self.cells.copy_within(TERM_COLS.., 0);
         self.cells[TERM_COLS * (TERM_ROWS - 1)..].fill(b' ');
         self.cursor_row = TERM_ROWS - 1;
+        self.dirty_rows = ALL_ROWS;
     }
 
     /// Return the grid as a string with newlines between rows, trailing spaces trimmed.
@@ -75,25 +184,118 @@ impl TextGrid {
             if row > 0 {
                 s.push('\n');
             }
-            let start = row * TERM_COLS;
-            let line = &self.cells[start..start + TERM_COLS];
-            let trimmed = match line.iter().rposition(|&b| b != b' ') {
-                Some(last) => &line[..=last],
-                None => &[],
-            };
-            // Safe: all bytes are ASCII printable or space
-            for &b in trimmed {
-                s.push(b as char);
-            }
+            s.push_str(&self.row_string(row));
         }
         s
     }
+
+    /// Return one row, trailing spaces trimmed.
+    pub fn row_string(&self, row: usize) -> String {
+        let start = row * TERM_COLS;
+        let line = &self.cells[start..start + TERM_COLS];
+        let trimmed = match line.iter().rposition(|&b| b != b' ') {
+            Some(last) => &line[..=last],
+            None => &[],
+        };
+        // Safe: all bytes are ASCII printable or space
+        trimmed.iter().map(|&b| b as char).collect()
+    }
+
+    fn save(&self, w: &mut StateWriter) {
+        w.packed(&self.cells);
+        w.u8(self.cursor_row as u8);
+        w.u8(self.cursor_col as u8);
+    }
+
+    /// Every row counts as changed afterwards.
+    fn load(&mut self, r: &mut StateReader) -> Result<()> {
+        r.packed(&mut self.cells)?;
+        self.cursor_row = r.u8()? as usize;
+        self.cursor_col = r.u8()? as usize;
+        if self.cursor_row >= TERM_ROWS || self.cursor_col >= TERM_COLS {
+            return Err("terminal cursor off the grid".to_string());
+        }
+        self.dirty_rows = ALL_ROWS;
+        Ok(())
+    }
 }
 
-pub struct PacketEntry {
-    pub direction: u8, // 0 = write (CPU→bridge), 1 = read (bridge→CPU)
-    pub device: u8,
-    pub data: Vec<u8>,
+/// Packets the log keeps; a power of two, so slots stay put when `seq` wraps.
+pub(crate) const PACKET_SLOTS: usize = 1024;
+/// Bytes per slot: every TLV payload fits.
+pub(crate) const PACKET_SLOT_SIZE: usize = 256;
+
+/// The last PACKET_SLOTS bridge packets, for the packet inspector. Each has
+/// a fixed slot in one arena, so logging never allocates, and JS reads the
+/// arena and the metadata in place (see `Emulator::packet_data_ptr`).
+pub struct PacketLog {
+    /// Slot n's payload at n * PACKET_SLOT_SIZE.
+    data: Box<[u8]>,
+    /// Slot n's [direction, device, len, 0]; direction 0 is a write
+    /// (CPU→bridge), 1 a read (bridge→CPU).
+    meta: Box<[[u8; 4]]>,
+    /// Packets logged so far (wrapping); the next goes in slot seq % PACKET_SLOTS.
+    seq: u32,
+    /// Slots holding packets, up to PACKET_SLOTS.
+    len: usize,
+    pub enabled: bool,
+}
+
+impl PacketLog {
+    fn new() -> Self {
+        Self {
+            data: vec![0; PACKET_SLOTS * PACKET_SLOT_SIZE].into_boxed_slice(),
+            meta: vec![[0; 4]; PACKET_SLOTS].into_boxed_slice(),
+            seq: 0,
+            len: 0,
+            enabled: true,
+        }
+    }
+
+    fn push(&mut self, direction: u8, device: u8, payload: &[u8]) {
+        if !self.enabled {
+            return;
+        }
+        let slot = self.seq as usize % PACKET_SLOTS;
+        let n = payload.len().min(PACKET_SLOT_SIZE - 1);
+        let start = slot * PACKET_SLOT_SIZE;
+        self.data[start..start + n].copy_from_slice(&payload[..n]);
+        self.meta[slot] = [direction, device, n as u8, 0];
+        self.seq = self.seq.wrapping_add(1);
+        self.len = (self.len + 1).min(PACKET_SLOTS);
+    }
+
+    /// Forget the packets, keeping `seq` going so readers see them gone.
+    pub fn clear(&mut self) {
+        self.len = 0;
+    }
+
+    pub fn seq(&self) -> u32 {
+        self.seq
+    }
+
+    pub fn len(&self) -> usize {
+        self.len
+    }
+
+    pub fn data_ptr(&self) -> *const u8 {
+        self.data.as_ptr()
+    }
+
+    pub fn meta_ptr(&self) -> *const u8 {
+        self.meta.as_ptr() as *const u8
+    }
+
+    /// The packets held, oldest first, as (direction, device, payload).
+    pub fn iter(&self) -> impl Iterator<Item = (u8, u8, &[u8])> + '_ {
+        let first = self.seq.wrapping_sub(self.len as u32);
+        (0..self.len as u32).map(move |i| {
+            let slot = first.wrapping_add(i) as usize % PACKET_SLOTS;
+            let [direction, device, n, _] = self.meta[slot];
+            let start = slot * PACKET_SLOT_SIZE;
+            (direction, device, &self.data[start..start + n as usize])
+        })
+    }
 }
 
 /// Fixed-size buffer for bridge I/O — zero heap allocation on the hot path.
@@ -105,7 +307,7 @@ pub(crate) struct BridgeBuf {
 }
 
 impl BridgeBuf {
-    const fn new() -> Self {
+    pub(crate) const fn new() -> Self {
         Self {
             data: [0; BRIDGE_BUF_CAP],
             len: 0,
@@ -119,9 +321,17 @@ impl BridgeBuf {
         }
     }
 
-    fn as_slice(&self) -> &[u8] {
+    pub(crate) fn as_slice(&self) -> &[u8] {
         &self.data[..self.len as usize]
     }
+
+    fn from_slice(data: &[u8]) -> Self {
+        let mut buf = Self::new();
+        for &b in data {
+            buf.push(b);
+        }
+        buf
+    }
 }
 
 enum PortState {
@@ -138,8 +348,31 @@ enum PortState {
         buf: BridgeBuf,
         pos: u8,
     },
+    ReadAnyMask,
+    ReadBlockDevice,
+    ReadBlockLen {
+        device: u8,
+    },
+    /// A read-block response held back (reads see 0xFF) until `len` bytes
+    /// have been gathered.
+    ReadBlockWait {
+        device: u8,
+        len: u8,
+        data: Vec<u8>,
+    },
 }
 
+/// Read-any command: `[0x80 | READ_ANY][mask]` (see protocol.md).
+const READ_ANY: u8 = 0x0F;
+/// Read-block command: `[0x80 | READ_BLOCK][device][len]` (see protocol.md).
+const READ_BLOCK: u8 = 0x0E;
+/// Devices whose leftover response bytes can be carried over.
+const CARRY_DEVICES: usize = 8;
+/// Largest read response, in data bytes.
+pub(crate) const MAX_READ: usize = 254;
+/// Device 0 expansion RAM (BRIDGE_REU_SIZE in the bridge firmware).
+const REU_SIZE: usize = 256 * 1024;
+
 // ---------------------------------------------------------------------------
 // DeviceHandler trait — the seam between real devices and mocks
 // ---------------------------------------------------------------------------
@@ -148,6 +381,11 @@ pub(crate) trait DeviceHandler {
     fn dispatch_write(&mut self, device: u8, data: &[u8]);
     fn prepare_read(&mut self, device: u8, buf: &mut BridgeBuf);
     fn clear(&mut self);
+    /// Devices with data (bit n = device n): the status port, and the first
+    /// byte of a device 0 read.
+    fn status(&self) -> u8 {
+        0
+    }
 }
 
 // ---------------------------------------------------------------------------
@@ -157,7 +395,16 @@ pub(crate) trait DeviceHandler {
 pub struct TlvBridge<H: DeviceHandler> {
     state: PortState,
     pub handler: H,
-    pub(crate) packet_log: Vec<PacketEntry>,
+    pub packet_log: PacketLog,
+    /// What the handler was given and gave back, while recording a trace.
+    pub trace: Option<TraceWriter>,
+    /// 6502 cycles, for trace times; MattbrewBus keeps it up.
+    pub now: u64,
+    /// Reads and writes the 6502 has made.
+    pub transactions: u64,
+    /// Bytes a read-any or read-block response took from a device but had
+    /// no room for; served ahead of that device's next response.
+    carry: [Vec<u8>; CARRY_DEVICES],
 }
 
 impl<H: DeviceHandler> TlvBridge<H> {
@@ -165,7 +412,11 @@ impl<H: DeviceHandler> TlvBridge<H> {
         Self {
             state: PortState::Idle,
             handler,
-            packet_log: Vec::new(),
+            packet_log: PacketLog::new(),
+            trace: None,
+            now: 0,
+            transactions: 0,
+            carry: Default::default(),
         }
     }
 
@@ -173,21 +424,12 @@ impl<H: DeviceHandler> TlvBridge<H> {
         self.state = PortState::Idle;
         self.handler.clear();
         self.packet_log.clear();
-    }
-
-    pub fn drain_packets(&mut self) -> Vec<PacketEntry> {
-        std::mem::take(&mut self.packet_log)
+        self.carry = Default::default();
     }
 
     fn write_byte(&mut self, value: u8) {
         self.state = match std::mem::replace(&mut self.state, PortState::Idle) {
-            PortState::Idle => {
-                if value & 0x80 != 0 {
-                    self.start_read(value & 0x7F)
-                } else {
-                    PortState::WriteLen { device: value }
-                }
-            }
+            PortState::Idle => self.start_transaction(value),
             PortState::WriteLen { device } => {
                 if value == 0 {
                     self.do_write(device, &[]);
@@ -217,13 +459,11 @@ impl<H: DeviceHandler> TlvBridge<H> {
                     }
                 }
             }
-            PortState::ReadData { .. } => {
-                if value & 0x80 != 0 {
-                    self.start_read(value & 0x7F)
-                } else {
-                    PortState::WriteLen { device: value }
-                }
-            }
+            PortState::ReadData { .. } => self.start_transaction(value),
+            PortState::ReadAnyMask => self.start_read_any(value),
+            PortState::ReadBlockDevice => PortState::ReadBlockLen { device: value },
+            PortState::ReadBlockLen { device } => self.start_read_block(device, value),
+            PortState::ReadBlockWait { .. } => self.start_transaction(value),
         };
     }
 
@@ -243,33 +483,163 @@ impl<H: DeviceHandler> TlvBridge<H> {
                     0xFF
                 }
             }
+            PortState::ReadBlockWait { .. } => {
+                let PortState::ReadBlockWait { device, len, data } =
+                    std::mem::replace(&mut self.state, PortState::Idle)
+                else {
+                    unreachable!()
+                };
+                self.state = self.fill_read_block(device, len, data);
+                match &mut self.state {
+                    PortState::ReadData { buf, pos } => {
+                        *pos = 1;
+                        buf.data[0]
+                    }
+                    _ => 0xFF,
+                }
+            }
             _ => 0xFF,
         }
     }
 
-    fn start_read(&mut self, device: u8) -> PortState {
+    fn start_transaction(&mut self, value: u8) -> PortState {
+        if value == 0x80 | READ_ANY {
+            PortState::ReadAnyMask
+        } else if value == 0x80 | READ_BLOCK {
+            PortState::ReadBlockDevice
+        } else if value & 0x80 != 0 {
+            self.start_read(value & 0x7F)
+        } else {
+            PortState::WriteLen { device: value }
+        }
+    }
+
+    /// Next response data for `device`: carried-over bytes first, then the
+    /// handler's.
+    fn take_device_data(&mut self, device: u8) -> Vec<u8> {
+        if let Some(carry) = self.carry.get_mut(device as usize) {
+            if !carry.is_empty() {
+                let mut data = std::mem::take(carry);
+                if data.len() > MAX_READ {
+                    *carry = data.split_off(MAX_READ);
+                }
+                return data;
+            }
+        }
         let mut buf = BridgeBuf::new();
-        self.handler.prepare_read(device, &mut buf);
-        // Log the read response (skip the length byte at position 0)
-        let payload = if buf.len > 1 {
+        self.handler_read(device, &mut buf);
+        if buf.len > 1 {
             buf.data[1..buf.len as usize].to_vec()
         } else {
             Vec::new()
-        };
-        self.packet_log.push(PacketEntry {
-            direction: 1,
-            device,
-            data: payload,
-        });
+        }
+    }
+
+    /// Return bytes taken from `device` to the front of its next response.
+    fn carry_back(&mut self, device: u8, mut data: Vec<u8>) {
+        if let Some(carry) = self.carry.get_mut(device as usize) {
+            data.append(carry);
+            *carry = data;
+        }
+    }
+
+    fn start_read(&mut self, device: u8) -> PortState {
+        let mut buf = BridgeBuf::new();
+        if self.carry.get(device as usize).is_some_and(|c| !c.is_empty()) {
+            let data = self.take_device_data(device);
+            buf.push(data.len() as u8);
+            for b in data {
+                buf.push(b);
+            }
+        } else {
+            self.handler_read(device, &mut buf);
+        }
+        // Log the read response (skip the length byte at position 0)
+        let payload: &[u8] = if buf.len > 1 { &buf.data[1..buf.len as usize] } else { &[] };
+        self.log_packet(1, device, payload);
+        PortState::ReadData { buf, pos: 0 }
+    }
+
+    /// One `[device][len][data]` record per device in `mask` with data, in
+    /// device order, within MAX_READ bytes in total.
+    fn start_read_any(&mut self, mask: u8) -> PortState {
+        let mut records = Vec::new();
+        for device in 1..8u8 {
+            if mask & (1 << device) == 0 {
+                continue;
+            }
+            if records.len() + 3 > MAX_READ {
+                break;
+            }
+            let mut data = self.take_device_data(device);
+            if data.is_empty() {
+                continue;
+            }
+            let room = MAX_READ - records.len() - 2;
+            if data.len() > room {
+                let rest = data.split_off(room);
+                self.carry_back(device, rest);
+            }
+            records.push(device);
+            records.push(data.len() as u8);
+            records.extend_from_slice(&data);
+        }
+
+        let mut buf = BridgeBuf::new();
+        buf.push(records.len() as u8);
+        for &b in &records {
+            buf.push(b);
+        }
+        self.log_packet(1, READ_ANY, &records);
         PortState::ReadData { buf, pos: 0 }
     }
 
+    /// Exactly `len` bytes of `device` (at most MAX_READ), once they are
+    /// all available.
+    fn start_read_block(&mut self, device: u8, len: u8) -> PortState {
+        let len = len.min(MAX_READ as u8);
+        self.fill_read_block(device, len, Vec::new())
+    }
+
+    fn fill_read_block(&mut self, device: u8, len: u8, mut data: Vec<u8>) -> PortState {
+        while data.len() < len as usize {
+            let more = self.take_device_data(device);
+            if more.is_empty() {
+                return PortState::ReadBlockWait { device, len, data };
+            }
+            data.extend(more);
+        }
+        let rest = data.split_off(len as usize);
+        self.carry_back(device, rest);
+
+        let mut buf = BridgeBuf::new();
+        buf.push(len);
+        for &b in &data {
+            buf.push(b);
+        }
+        self.log_packet(1, device, &data);
+        PortState::ReadData { buf, pos: 0 }
+    }
+
+    fn log_packet(&mut self, direction: u8, device: u8, payload: &[u8]) {
+        self.transactions += 1;
+        self.packet_log.push(direction, device, payload);
+    }
+
+    /// Ask the handler for `device`'s next response, tracing it.
+    fn handler_read(&mut self, device: u8, buf: &mut BridgeBuf) {
+        self.handler.prepare_read(device, buf);
+        if let Some(trace) = &mut self.trace {
+            let data: &[u8] = if buf.len > 1 { &buf.data[1..buf.len as usize] } else { &[] };
+            trace.record(self.now, KIND_READ, device, data);
+        }
+    }
+
     fn do_write(&mut self, device: u8, data: &[u8]) {
-        self.packet_log.push(PacketEntry {
-            direction: 0,
-            device,
-            data: data.to_vec(),
-        });
+        self.log_packet(0, device, data);
+        if let Some(trace) = &mut self.trace {
+            trace.record(self.now, KIND_WRITE, device, data);
+        }
         self.handler.dispatch_write(device, data);
     }
 }
@@ -278,6 +648,208 @@ impl<H: DeviceHandler> TlvBridge<H> {
 // RealDevices — the production device handler (terminal, keyboard, etc.)
 // ---------------------------------------------------------------------------
 
+/// The CRC-32 (IEEE, as zlib) that a Device 0 ['C'] read returns.
+fn crc32(bytes: impl Iterator<Item = u8>) -> u32 {
+    !bytes.fold(!0u32, |mut c, b| {
+        c ^= b as u32;
+        for _ in 0..8 {
+            c = if c & 1 != 0 { 0xEDB8_8320 ^ (c >> 1) } else { c >> 1 };
+        }
+        c
+    })
+}
+
+/// Run a Device 0 ['M'] batch of math coprocessor records, `[op][operands]`
+/// each, as the bridge does (protocol.md, "Math Coprocessor"), and return
+/// the results back to back. The batch stops at an unknown op, a short
+/// record or a result that would overflow the read.
+fn run_math(mut records: &[u8]) -> Vec<u8> {
+    let mut out = Vec::new();
+    while let Some((&op, rest)) = records.split_first() {
+        let (inb, outb) = match op {
+            0x01 | 0x02 | 0x04 | 0x05 => (4, 4),
+            0x03 | 0x08..=0x0B => (8, 4),
+            0x06 | 0x07 => (8, 8),
+            0x0C => (4, 4),
+            0x0D | 0x0E => (2, 2),
+            _ => break,
+        };
+        let Some(a) = rest.get(..inb) else { break };
+        if out.len() + outb > MAX_READ {
+            break;
+        }
+        records = &rest[inb..];
+        let u16_at = |i: usize| u16::from_le_bytes([a[i], a[i + 1]]);
+        let u32_at = |i: usize| u32::from_le_bytes([a[i], a[i + 1], a[i + 2], a[i + 3]]);
+        let f32_at = |i: usize| f32::from_bits(u32_at(i));
+        match op {
+            0x01 => out.extend((u16_at(0) as u32 * u16_at(2) as u32).to_le_bytes()),
+            0x02 => out.extend((u16_at(0) as i16 as i32 * u16_at(2) as i16 as i32).to_le_bytes()),
+            0x03 => out.extend(u32_at(0).wrapping_mul(u32_at(4)).to_le_bytes()),
+            // Dividing by zero gives all ones and the dividend; MIN / -1
+            // wraps to MIN with no remainder.
+            0x04 => {
+                let (n, d) = (u16_at(0), u16_at(2));
+                out.extend(n.checked_div(d).unwrap_or(0xFFFF).to_le_bytes());
+                out.extend(n.checked_rem(d).unwrap_or(n).to_le_bytes());
+            }
+            0x05 => {
+                let (n, d) = (u16_at(0) as i16, u16_at(2) as i16);
+                out.extend(if d == 0 { -1 } else { n.wrapping_div(d) }.to_le_bytes());
+                out.extend(if d == 0 { n } else { n.wrapping_rem(d) }.to_le_bytes());
+            }
+            0x06 => {
+                let (n, d) = (u32_at(0), u32_at(4));
+                out.extend(n.checked_div(d).unwrap_or(u32::MAX).to_le_bytes());
+                out.extend(n.checked_rem(d).unwrap_or(n).to_le_bytes());
+            }
+            0x07 => {
+                let (n, d) = (u32_at(0) as i32, u32_at(4) as i32);
+                out.extend(if d == 0 { -1 } else { n.wrapping_div(d) }.to_le_bytes());
+                out.extend(if d == 0 { n } else { n.wrapping_rem(d) }.to_le_bytes());
+            }
+            0x08 => out.extend((f32_at(0) + f32_at(4)).to_le_bytes()),
+            0x09 => out.extend((f32_at(0) - f32_at(4)).to_le_bytes()),
+            0x0A => out.extend((f32_at(0) * f32_at(4)).to_le_bytes()),
+            0x0B => out.extend((f32_at(0) / f32_at(4)).to_le_bytes()),
+            0x0C => out.extend(f32_at(0).sqrt().to_le_bytes()),
+            _ => {
+                // Angles in 65536ths of a turn, results with 1.0 = 0x4000
+                let rad = u16_at(0) as f32 * (std::f32::consts::TAU / 65536.0);
+                let v = if op == 0x0D { rad.sin() } else { rad.cos() };
+                out.extend(((v * 16384.0).round() as i16).to_le_bytes());
+            }
+        }
+    }
+    out
+}
+
+/// Split a loadable executable (see binary_format.md) into device 5 blocks:
+/// `[addr_lo][addr_hi][bank][kind][data...]`, ending with a data-less block
+/// whose address is the entry point. Compressed sections stay compressed
+/// (kind 1 starts the stream, kind 2 continues it). With a `page`,
+/// relocatable sections move so that the first starts there, each followed
+/// by kind 3 blocks of `[delta][bitmap...]`. A zero-fill section is one kind
+/// 4 block of its length. A bad image yields just an end block at 0.
+fn build_load_blocks(image: &[u8], page: Option<u8>) -> VecDeque<Vec<u8>> {
+    const MAX_BLOCK_DATA: usize = 250;
+    let fail = || VecDeque::from([vec![0x00, 0x00, 0xFF, 0x00]]);
+
+    if image.len() < 6 || image[0] != 0x45 || image[1] != 0x69 || !(1..=4).contains(&image[2]) {
+        return fail();
+    }
+    let version = image[2];
+    let hdr_len = if version >= 2 { 6 } else { 5 };
+
+    // (addr, bank, len, first block kind, stream, bitmap) per section.
+    let mut sections = Vec::new();
+    let mut pos = 6;
+    for _ in 0..image[5] {
+        if pos + hdr_len > image.len() {
+            return fail();
+        }
+        let addr = u16::from_le_bytes([image[pos], image[pos + 1]]) as usize;
+        let bank = image[pos + 2];
+        let len = u16::from_le_bytes([image[pos + 3], image[pos + 4]]) as usize;
+        let flags = if version >= 2 { image[pos + 5] } else { 0 };
+        let compressed = flags & 0x01 != 0;
+        let relocatable = version >= 3 && flags & 0x02 != 0;
+        let zero = version >= 4 && flags & 0x04 != 0;
+        pos += hdr_len;
+
+        let (stream, stored_len) = if zero {
+            ((len as u16).to_le_bytes().to_vec(), 0)
+        } else if compressed {
+            if pos + 2 > image.len() {
+                return fail();
+            }
+            let packed_len = u16::from_le_bytes([image[pos], image[pos + 1]]) as usize;
+            pos += 2;
+            if pos + packed_len > image.len() {
+                return fail();
+            }
+            let mut stream = (len as u16).to_le_bytes().to_vec();
+            stream.extend_from_slice(&image[pos..pos + packed_len]);
+            (stream, packed_len)
+        } else {
+            if pos + len > image.len() {
+                return fail();
+            }
+            (image[pos..pos + len].to_vec(), len)
+        };
+        pos += stored_len;
+        let bitmap = if relocatable && zero {
+            Some(Vec::new())
+        } else if relocatable {
+            let bitmap_len = len.div_ceil(8);
+            if pos + bitmap_len > image.len() {
+                return fail();
+            }
+            pos += bitmap_len;
+            Some(image[pos - bitmap_len..pos].to_vec())
+        } else {
+            None
+        };
+        let kind = if zero { 4 } else if compressed { 1 } else { 0 };
+        sections.push((addr, bank, len, kind, stream, bitmap));
+    }
+
+    let delta = match (page, sections.iter().find(|s| s.5.is_some())) {
+        (Some(page), Some(first)) => page.wrapping_sub((first.0 >> 8) as u8),
+        _ => 0,
+    };
+    let moved = |addr: usize| (addr + ((delta as usize) << 8)) & 0xFFFF;
+    let entrypoint = u16::from_le_bytes([image[3], image[4]]) as usize;
+    let mut entry = entrypoint;
+
+    let mut blocks = VecDeque::new();
+    for (link_addr, bank, len, kind, stream, bitmap) in sections {
+        let addr = if bitmap.is_some() { moved(link_addr) } else { link_addr };
+        if addr < 0x0400 || addr + len > 0xdfff {
+            return fail();
+        }
+        if bitmap.is_some() && (link_addr..link_addr + len).contains(&entrypoint) {
+            entry = moved(entrypoint);
+        }
+
+        for (i, chunk) in stream.chunks(MAX_BLOCK_DATA).enumerate() {
+            let (block_addr, kind) = match (kind, i) {
+                (0, _) => (addr + i * MAX_BLOCK_DATA, 0),
+                (1, 0) => (addr, 1),
+                (1, _) => (addr, 2),
+                _ => (addr, kind),
+            };
+            let mut block = (block_addr as u16).to_le_bytes().to_vec();
+            block.push(bank);
+            block.push(kind);
+            block.extend_from_slice(chunk);
+            blocks.push_back(block);
+        }
+        if let Some(bitmap) = bitmap.filter(|_| delta != 0) {
+            for (i, chunk) in bitmap.chunks(MAX_BLOCK_DATA - 1).enumerate() {
+                let block_addr = addr + i * (MAX_BLOCK_DATA - 1) * 8;
+                let mut block = (block_addr as u16).to_le_bytes().to_vec();
+                block.push(bank);
+                block.push(3);
+                block.push(delta);
+                block.extend_from_slice(chunk);
+                blocks.push_back(block);
+            }
+        }
+    }
+    blocks.push_back(vec![entry as u8, (entry >> 8) as u8, 0xFF, 0x00]);
+    blocks
+}
+
+fn save_queue(w: &mut StateWriter, q: &VecDeque<u8>) {
+    let (front, back) = q.as_slices();
+    w.bytes(&[front, back].concat());
+}
+
+fn load_queue(r: &mut StateReader) -> Result<VecDeque<u8>> {
+    Ok(VecDeque::from(r.bytes()?))
+}
+
 struct NetbootState {
     data: Vec<u8>, // 2-byte BE length prefix + file contents
     offset: usize,
@@ -288,9 +860,21 @@ pub struct RealDevices {
     pub keyboard_in: VecDeque<u8>,
     pub echo: VecDeque<u8>,
     pub reset_requested: bool,
-    pub terminal_dirty: bool,
     pub uploaded_files: HashMap<String, Vec<u8>>,
     netboot: Option<NetbootState>,
+    blockload: VecDeque<Vec<u8>>,
+    /// Device 6 replies not yet read: exactly the bytes asked for.
+    file_read: VecDeque<u8>,
+    /// Device 4 socket events not yet read, a TLV each.
+    net: VecDeque<Vec<u8>>,
+    /// Device 0 ['T', bytes...] self-test data, or the bytes an ['F'] fetch or
+    /// ['M'] math batch returns, for the next Device 0 read.
+    loopback: Option<Vec<u8>>,
+    /// Device 0 ['A'|'S'|'F'] expansion RAM and its address, kept over resets.
+    reu: Vec<u8>,
+    reu_addr: usize,
+    /// Device 2 bytes written since last taken, while capturing.
+    pub output: Option<Vec<u8>>,
 }
 
 impl RealDevices {
@@ -300,24 +884,133 @@ impl RealDevices {
             keyboard_in: VecDeque::new(),
             echo: VecDeque::new(),
             reset_requested: false,
-            terminal_dirty: false,
             uploaded_files: HashMap::new(),
             netboot: None,
+            blockload: VecDeque::new(),
+            file_read: VecDeque::new(),
+            net: VecDeque::new(),
+            loopback: None,
+            reu: vec![0; REU_SIZE],
+            reu_addr: 0,
+            output: None,
+        }
+    }
+
+    /// Everything but `output`, which is the UI's to turn on and off.
+    fn save(&self, w: &mut StateWriter) {
+        self.terminal.save(w);
+        save_queue(w, &self.keyboard_in);
+        save_queue(w, &self.echo);
+        w.bool(self.reset_requested);
+        let mut names: Vec<&String> = self.uploaded_files.keys().collect();
+        names.sort();
+        w.u32(names.len() as u32);
+        for name in names {
+            w.bytes(name.as_bytes());
+            w.bytes(&self.uploaded_files[name]);
+        }
+        w.opt_bytes(self.netboot.as_ref().map(|nb| &nb.data[..]));
+        w.u32(self.netboot.as_ref().map_or(0, |nb| nb.offset as u32));
+        w.u32(self.blockload.len() as u32);
+        for block in &self.blockload {
+            w.bytes(block);
+        }
+        save_queue(w, &self.file_read);
+        w.u32(self.net.len() as u32);
+        for event in &self.net {
+            w.bytes(event);
+        }
+        w.opt_bytes(self.loopback.as_deref());
+        w.packed(&self.reu);
+        w.u32(self.reu_addr as u32);
+    }
+
+    fn load(&mut self, r: &mut StateReader) -> Result<()> {
+        self.terminal.load(r)?;
+        self.keyboard_in = load_queue(r)?;
+        self.echo = load_queue(r)?;
+        self.reset_requested = r.bool()?;
+        self.uploaded_files.clear();
+        for _ in 0..r.u32()? {
+            let name = String::from_utf8_lossy(&r.bytes()?).to_string();
+            self.uploaded_files.insert(name, r.bytes()?);
+        }
+        let netboot = r.opt_bytes()?;
+        let offset = r.u32()? as usize;
+        self.netboot = match netboot {
+            Some(data) if offset <= data.len() => Some(NetbootState { data, offset }),
+            Some(_) => return Err("netboot offset past its image".to_string()),
+            None => None,
+        };
+        self.blockload.clear();
+        for _ in 0..r.u32()? {
+            self.blockload.push_back(r.bytes()?);
+        }
+        self.file_read = load_queue(r)?;
+        self.net.clear();
+        for _ in 0..r.u32()? {
+            self.net.push_back(r.bytes()?);
+        }
+        self.loopback = r.opt_bytes()?;
+        r.packed(&mut self.reu)?;
+        self.reu_addr = r.u32()? as usize;
+        if self.reu_addr >= REU_SIZE {
+            return Err("expansion RAM address out of range".to_string());
         }
+        Ok(())
     }
 }
 
 impl DeviceHandler for RealDevices {
     fn dispatch_write(&mut self, device: u8, data: &[u8]) {
         match device {
+            0 if data.first() == Some(&b'T') => {
+                self.loopback = Some(data[1..].to_vec());
+            }
+            0 => match data {
+                [b'A', a0, a1, a2, ..] => {
+                    self.reu_addr = u32::from_le_bytes([*a0, *a1, *a2, 0]) as usize % REU_SIZE;
+                }
+                [b'S', bytes @ ..] => {
+                    for &b in bytes {
+                        self.reu[self.reu_addr] = b;
+                        self.reu_addr = (self.reu_addr + 1) % REU_SIZE;
+                    }
+                }
+                // The fetched bytes stand in for the status, as a loopback's do
+                [b'F', n, ..] => {
+                    let n = (*n as usize).min(MAX_READ);
+                    let bytes = (0..n).map(|i| self.reu[(self.reu_addr + i) % REU_SIZE]).collect();
+                    self.reu_addr = (self.reu_addr + n) % REU_SIZE;
+                    self.loopback = Some(bytes);
+                }
+                [b'M', records @ ..] => self.loopback = Some(run_math(records)),
+                [b'C', l0, l1, l2, ..] => {
+                    let n = (u32::from_le_bytes([*l0, *l1, *l2, 0]) as usize).min(REU_SIZE);
+                    let bytes = (0..n).map(|i| self.reu[(self.reu_addr + i) % REU_SIZE]);
+                    self.loopback = Some(crc32(bytes).to_le_bytes().to_vec());
+                }
+                _ => {}
+            },
+            // ['I', mask, ...] and ['Q', ...] configure the 6502 IRQ and ['C',
+            // mhz] the 6502 clock, none of which is emulated. ['E', mask] asks
+            // the Pico to echo devices itself, which Echo here already does.
+            1 if matches!(data.first(), Some(b'I' | b'Q' | b'C' | b'E')) => {}
             1 => {
                 self.reset_requested = true;
             }
+            2 if data.first() == Some(&0x00) => self.terminal.apply_screen(&data[1..]),
+            // Pixel packets: there's no framebuffer here, but they aren't text
+            2 if data.first() == Some(&0x01) => {}
+            // Keyboard packets: keys here are always characters
+            2 if data.first() == Some(&0x02) => {}
             2 => {
                 for &c in data {
                     self.terminal.put_char(c);
                 }
-                self.terminal_dirty = true;
+                if let Some(output) = &mut self.output {
+                    output.extend_from_slice(data);
+                }
             }
             3 => {
                 let name = String::from_utf8_lossy(data).to_string();
@@ -333,6 +1026,37 @@ impl DeviceHandler for RealDevices {
                     });
                 }
             }
+            // [filename...], optionally followed by [0x00][page] to place
+            // the relocatable sections.
+            5 => {
+                let (name, page) = match data.iter().position(|&b| b == 0) {
+                    Some(nul) => (&data[..nul], data.get(nul + 1).copied()),
+                    None => (data, None),
+                };
+                let name = String::from_utf8_lossy(name).to_string();
+                self.blockload = match self.uploaded_files.get(&name) {
+                    Some(file_data) => build_load_blocks(file_data, page),
+                    None => build_load_blocks(&[], None),
+                };
+            }
+            // [offset: 3 bytes LE] [count: 2 bytes LE] [filename...]; past the
+            // end of the file, or of no file at all, reads as zeros.
+            // Sockets: there's no network here, so opens fail and a close
+            // is acknowledged, as the Zero does when it can't reach a host.
+            4 => match data {
+                [b'C' | b'L', sock, ..] => self.net.push_back(vec![*sock, b'O', 0]),
+                [b'X', sock] => self.net.push_back(vec![*sock, b'X']),
+                _ => {}
+            },
+            6 if data.len() >= 6 => {
+                let offset = u32::from_le_bytes([data[0], data[1], data[2], 0]) as usize;
+                let count = u16::from_le_bytes([data[3], data[4]]) as usize;
+                let name = String::from_utf8_lossy(&data[5..]).to_string();
+                let file_data = self.uploaded_files.get(&name).map_or(&[][..], |f| &f[..]);
+                self.file_read.extend(
+                    (offset..offset + count).map(|i| file_data.get(i).copied().unwrap_or(0)),
+                );
+            }
             7 => {
                 self.echo.extend(data);
             }
@@ -342,13 +1066,16 @@ impl DeviceHandler for RealDevices {
 
     fn prepare_read(&mut self, device: u8, buf: &mut BridgeBuf) {
         match device {
-            0 => {
-                let mut status: u8 = 0;
-                if !self.keyboard_in.is_empty() {
-                    status |= 1 << 2;
+            0 if self.loopback.is_some() => {
+                let data = self.loopback.take().unwrap_or_default();
+                buf.push(data.len() as u8);
+                for b in data {
+                    buf.push(b);
                 }
+            }
+            0 => {
                 buf.push(2);
-                buf.push(status);
+                buf.push(self.status());
                 buf.push(1);
             }
             2 => {
@@ -376,6 +1103,32 @@ impl DeviceHandler for RealDevices {
                     buf.push(0);
                 }
             }
+            4 => {
+                let event = self.net.pop_front().unwrap_or_default();
+                buf.push(event.len() as u8);
+                for b in event {
+                    buf.push(b);
+                }
+            }
+            5 => {
+                if let Some(block) = self.blockload.pop_front() {
+                    buf.push(block.len() as u8);
+                    for b in block {
+                        buf.push(b);
+                    }
+                } else {
+                    buf.push(0);
+                }
+            }
+            6 => {
+                let available = self.file_read.len().min(128);
+                buf.push(available as u8);
+                for _ in 0..available {
+                    if let Some(b) = self.file_read.pop_front() {
+                        buf.push(b);
+                    }
+                }
+            }
             7 => {
                 let echo_available = self.echo.len().min(254);
                 buf.push(echo_available as u8);
@@ -395,8 +1148,21 @@ impl DeviceHandler for RealDevices {
         self.terminal.clear();
         self.keyboard_in.clear();
         self.reset_requested = false;
-        self.terminal_dirty = false;
         self.netboot = None;
+        self.blockload.clear();
+        self.file_read.clear();
+        self.loopback = None;
+    }
+
+    fn status(&self) -> u8 {
+        let mut status: u8 = 0;
+        if !self.keyboard_in.is_empty() {
+            status |= 1 << 2;
+        }
+        if !self.net.is_empty() {
+            status |= 1 << 4;
+        }
+        status
     }
 }
 
@@ -411,6 +1177,12 @@ impl TlvBridge<RealDevices> {
             PortState::ReadData { buf, pos } => {
                 format!("ReadData({}/{})", pos, buf.len)
             }
+            PortState::ReadAnyMask => "ReadAnyMask".to_string(),
+            PortState::ReadBlockDevice => "ReadBlockDevice".to_string(),
+            PortState::ReadBlockLen { device } => format!("ReadBlockLen(dev={})", device),
+            PortState::ReadBlockWait { device, len, data } => {
+                format!("ReadBlockWait(dev={}, {}/{})", device, data.len(), len)
+            }
         };
         let nb = match &self.handler.netboot {
             Some(nb) => format!("{}/{}", nb.offset, nb.data.len()),
@@ -421,6 +1193,74 @@ impl TlvBridge<RealDevices> {
             state, self.handler.keyboard_in.len(), self.handler.echo.len(), nb
         )
     }
+
+    /// The port state machine, carried-over bytes and devices, as they are
+    /// mid-transaction if need be. The packet log and any trace aren't
+    /// part of it.
+    fn save(&self, w: &mut StateWriter) {
+        match &self.state {
+            PortState::Idle => w.u8(0),
+            PortState::WriteLen { device } => {
+                w.u8(1);
+                w.u8(*device);
+            }
+            PortState::WriteData { device, remaining, buf } => {
+                w.u8(2);
+                w.u8(*device);
+                w.u8(*remaining);
+                w.bytes(buf.as_slice());
+            }
+            PortState::ReadData { buf, pos } => {
+                w.u8(3);
+                w.bytes(buf.as_slice());
+                w.u8(*pos);
+            }
+            PortState::ReadAnyMask => w.u8(4),
+            PortState::ReadBlockDevice => w.u8(5),
+            PortState::ReadBlockLen { device } => {
+                w.u8(6);
+                w.u8(*device);
+            }
+            PortState::ReadBlockWait { device, len, data } => {
+                w.u8(7);
+                w.u8(*device);
+                w.u8(*len);
+                w.bytes(data);
+            }
+        }
+        w.u64(self.now);
+        w.u64(self.transactions);
+        for carry in &self.carry {
+            w.bytes(carry);
+        }
+        self.handler.save(w);
+    }
+
+    fn load(&mut self, r: &mut StateReader) -> Result<()> {
+        self.state = match r.u8()? {
+            0 => PortState::Idle,
+            1 => PortState::WriteLen { device: r.u8()? },
+            2 => PortState::WriteData {
+                device: r.u8()?,
+                remaining: r.u8()?,
+                buf: BridgeBuf::from_slice(&r.bytes()?),
+            },
+            3 => PortState::ReadData { buf: BridgeBuf::from_slice(&r.bytes()?), pos: r.u8()? },
+            4 => PortState::ReadAnyMask,
+            5 => PortState::ReadBlockDevice,
+            6 => PortState::ReadBlockLen { device: r.u8()? },
+            7 => PortState::ReadBlockWait { device: r.u8()?, len: r.u8()?, data: r.bytes()? },
+            tag => return Err(format!("bad bridge port state {tag}")),
+        };
+        self.now = r.u64()?;
+        self.transactions = r.u64()?;
+        for carry in &mut self.carry {
+            *carry = r.bytes()?;
+        }
+        self.handler.load(r)?;
+        self.packet_log.clear();
+        Ok(())
+    }
 }
 
 // ---------------------------------------------------------------------------
@@ -432,6 +1272,12 @@ pub struct MattbrewBus<H: DeviceHandler> {
     rom: [u8; ROM_SIZE],
     pub via: Via6522,
     pub bridge: TlvBridge<H>,
+    /// 6502 cycles at the instruction running, for the VIA's timers and
+    /// trace times; whoever runs the CPU keeps it up.
+    pub now: u64,
+    /// RAM pages written since `take_written_pages`, bit n & 63 of word
+    /// n >> 6 for page n; all set when RAM or ROM is replaced wholesale.
+    written: [u64; 4],
 }
 
 impl<H: DeviceHandler> MattbrewBus<H> {
@@ -441,6 +1287,8 @@ impl<H: DeviceHandler> MattbrewBus<H> {
             rom: [0xFF; ROM_SIZE],
             via: Via6522::new(),
             bridge: TlvBridge::new(handler),
+            now: 0,
+            written: [!0; 4],
         }
     }
 
@@ -448,8 +1296,9 @@ impl<H: DeviceHandler> MattbrewBus<H> {
     pub fn peek(&self, address: u16) -> u8 {
         match address {
             0x0000..=0x9FFF => self.ram[address as usize],
-            0xE000..=0xE03F => self.via.read((address & 0x0F) as u8),
+            0xE000..=0xE03F => self.via.peek((address & 0x0F) as u8, self.now),
             0xE040..=0xE07F => 0x00,
+            0xE0C0..=0xE0DF => self.bridge.handler.status(),
             0xE100..=0xFFFF => self.rom[(address - ROM_START) as usize],
             _ => 0xFF,
         }
@@ -461,10 +1310,50 @@ impl<H: DeviceHandler> MattbrewBus<H> {
         self.rom.fill(0xFF);
         let len = data.len().min(ROM_SIZE);
         self.rom[..len].copy_from_slice(&data[..len]);
+        self.written = [!0; 4];
     }
 
     pub fn clear_ram(&mut self) {
         self.ram.fill(0);
+        self.written = [!0; 4];
+    }
+
+    /// The cycle the CPU loop next has to stop at for the IRQ line (see
+    /// `Via6522::next_event`): one compare an instruction.
+    #[inline]
+    pub fn next_event(&self) -> u64 {
+        self.via.next_event()
+    }
+
+    /// Bring the interrupt sources up to `now` and say whether IRQ is held.
+    pub fn irq(&mut self) -> bool {
+        self.via.update(self.now);
+        self.via.irq()
+    }
+
+    /// Pages written since the last call, as in `written`.
+    pub fn take_written_pages(&mut self) -> [u64; 4] {
+        std::mem::take(&mut self.written)
+    }
+}
+
+impl MattbrewBus<RealDevices> {
+    /// Memory, the VIA and the bridge, for `Emulator::save_state`.
+    pub fn save(&self, w: &mut StateWriter) {
+        w.packed(&self.ram);
+        w.packed(&self.rom);
+        w.u64(self.now);
+        self.via.save(w);
+        self.bridge.save(w);
+    }
+
+    pub fn load(&mut self, r: &mut StateReader) -> Result<()> {
+        r.packed(&mut self.ram)?;
+        r.packed(&mut self.rom)?;
+        self.written = [!0; 4];
+        self.now = r.u64()?;
+        self.via.load(r)?;
+        self.bridge.load(r)
     }
 }
 
@@ -472,8 +1361,12 @@ impl<H: DeviceHandler> Bus for MattbrewBus<H> {
     fn get_byte(&mut self, address: u16) -> u8 {
         match address {
             0x0000..=0x9FFF => self.ram[address as usize],
-            0xE000..=0xE03F => self.via.read((address & 0x0F) as u8),
-            0xE040..=0xE07F => self.bridge.read_byte(),
+            0xE000..=0xE03F => self.via.read((address & 0x0F) as u8, self.now),
+            0xE040..=0xE07F => {
+                self.bridge.now = self.now;
+                self.bridge.read_byte()
+            }
+            0xE0C0..=0xE0DF => self.bridge.handler.status(),
             0xE100..=0xFFFF => self.rom[(address - ROM_START) as usize],
             _ => 0xFF,
         }
@@ -481,9 +1374,15 @@ impl<H: DeviceHandler> Bus for MattbrewBus<H> {
 
     fn set_byte(&mut self, address: u16, value: u8) {
         match address {
-            0x0000..=0x9FFF => self.ram[address as usize] = value,
-            0xE000..=0xE03F => self.via.write((address & 0x0F) as u8, value),
-            0xE040..=0xE07F => self.bridge.write_byte(value),
+            0x0000..=0x9FFF => {
+                self.ram[address as usize] = value;
+                self.written[address as usize >> 14] |= 1 << (address >> 8 & 63);
+            }
+            0xE000..=0xE03F => self.via.write((address & 0x0F) as u8, value, self.now),
+            0xE040..=0xE07F => {
+                self.bridge.now = self.now;
+                self.bridge.write_byte(value)
+            }
             _ => {}
         }
     }
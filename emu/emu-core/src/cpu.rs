@@ -0,0 +1,425 @@
+//! The 65C02 the emulator runs on. By default that's the `mos6502` crate,
+//! stepped one instruction at a time; with the `c-core` feature it's the
+//! switch-dispatched fake65c02 core from the c65 tool (csrc/core65c02.c),
+//! which runs a whole cycle budget in one call and checks breakpoints
+//! itself.
+//!
+//! Either way, all they look at for interrupts is the bus's `next_event`
+//! cycle: until then nothing can raise IRQ, so there is nothing to check,
+//! and a CPU parked in WAI skips straight to it.
+
+use mos6502::cpu::CPU;
+use mos6502::instruction::Cmos6502;
+
+use crate::bus::{DeviceHandler, MattbrewBus};
+use crate::state::{Result, StateReader, StateWriter};
+
+const WAI: u8 = 0xCB;
+const FLAG_I: u8 = 0x04;
+
+/// One step of the mos6502 crate's CPU, which doesn't decode WAI or take
+/// interrupts itself: take the IRQ if one is due, then run an instruction,
+/// or, parked in WAI, move the clock on to the next event or `limit`.
+/// False if the CPU can't get on: an opcode it doesn't know, or WAI with
+/// nothing due before `limit`.
+pub(crate) fn step_mos<H: DeviceHandler>(cpu: &mut CPU<MattbrewBus<H>, Cmos6502>, limit: u64) -> bool {
+    cpu.memory.now = cpu.cycles;
+    if cpu.cycles >= cpu.memory.next_event() && cpu.memory.irq() {
+        // IRQ ends a WAI whether or not it is masked
+        let pc = cpu.registers.program_counter;
+        if cpu.memory.peek(pc) == WAI {
+            cpu.registers.program_counter = pc.wrapping_add(1);
+        }
+        if cpu.registers.status.bits() & FLAG_I == 0 {
+            cpu.irq();
+        }
+    }
+    if cpu.single_step() {
+        return true;
+    }
+    if cpu.memory.peek(cpu.registers.program_counter) != WAI {
+        return false;
+    }
+    let next = cpu.memory.next_event().min(limit);
+    if next <= cpu.cycles {
+        return false;
+    }
+    cpu.cycles = next;
+    true
+}
+
+/// PC breakpoints as a bitmap over the 64 KB address space, bit `addr & 7`
+/// of byte `addr >> 3`, so checking one costs a load and a mask.
+pub struct Breakpoints {
+    bits: Box<[u8; 0x2000]>,
+    count: usize,
+}
+
+impl Breakpoints {
+    pub fn new() -> Self {
+        Breakpoints { bits: Box::new([0; 0x2000]), count: 0 }
+    }
+
+    pub fn insert(&mut self, addr: u16) {
+        if !self.contains(addr) {
+            self.bits[addr as usize >> 3] |= 1 << (addr & 7);
+            self.count += 1;
+        }
+    }
+
+    pub fn remove(&mut self, addr: u16) {
+        if self.contains(addr) {
+            self.bits[addr as usize >> 3] &= !(1 << (addr & 7));
+            self.count -= 1;
+        }
+    }
+
+    #[inline]
+    pub fn contains(&self, addr: u16) -> bool {
+        self.bits[addr as usize >> 3] & (1 << (addr & 7)) != 0
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.count == 0
+    }
+
+    /// Set addresses, lowest first.
+    pub fn iter(&self) -> impl Iterator<Item = u16> + '_ {
+        (0..=0xFFFFu16).filter(|&addr| self.contains(addr))
+    }
+}
+
+#[cfg(not(feature = "c-core"))]
+mod imp {
+    use mos6502::cpu::CPU;
+    use mos6502::instruction::Cmos6502;
+    use mos6502::registers::{StackPointer, Status};
+
+    use super::{Breakpoints, step_mos};
+    use crate::bus::{MattbrewBus, RealDevices};
+
+    pub struct Cpu {
+        cpu: CPU<MattbrewBus<RealDevices>, Cmos6502>,
+    }
+
+    impl Cpu {
+        pub fn new(bus: MattbrewBus<RealDevices>) -> Self {
+            Cpu { cpu: CPU::new(bus, Cmos6502) }
+        }
+
+        pub fn bus(&self) -> &MattbrewBus<RealDevices> {
+            &self.cpu.memory
+        }
+
+        pub fn bus_mut(&mut self) -> &mut MattbrewBus<RealDevices> {
+            &mut self.cpu.memory
+        }
+
+        pub fn reset(&mut self) {
+            self.cpu.reset();
+        }
+
+        pub fn step(&mut self) -> bool {
+            step_mos(&mut self.cpu, u64::MAX)
+        }
+
+        /// Run until `budget` cycles have passed or a breakpoint is reached.
+        /// Returns the cycles run and whether a breakpoint stopped it.
+        pub fn run(&mut self, budget: u32, breakpoints: &Breakpoints) -> (u32, bool) {
+            let start = self.cpu.cycles;
+            let target = start + budget as u64;
+            let mut hit = false;
+            while self.cpu.cycles < target {
+                if !step_mos(&mut self.cpu, target) {
+                    break;
+                }
+                if !breakpoints.is_empty()
+                    && breakpoints.contains(self.cpu.registers.program_counter)
+                {
+                    hit = true;
+                    break;
+                }
+            }
+            ((self.cpu.cycles - start) as u32, hit)
+        }
+
+        pub fn pc(&self) -> u16 {
+            self.cpu.registers.program_counter
+        }
+
+        pub fn sp(&self) -> u8 {
+            self.cpu.registers.stack_pointer.0
+        }
+
+        pub fn a(&self) -> u8 {
+            self.cpu.registers.accumulator
+        }
+
+        pub fn x(&self) -> u8 {
+            self.cpu.registers.index_x
+        }
+
+        pub fn y(&self) -> u8 {
+            self.cpu.registers.index_y
+        }
+
+        pub fn status(&self) -> u8 {
+            self.cpu.registers.status.bits()
+        }
+
+        pub fn cycles(&self) -> u64 {
+            self.cpu.cycles
+        }
+
+        /// Parked in WAI, which this core only knows by the PC.
+        pub fn waiting(&self) -> bool {
+            false
+        }
+
+        /// `regs` are SP, A, X, Y and P, as `Cpu::save` writes them.
+        pub fn set_registers(&mut self, pc: u16, regs: [u8; 5], _waiting: bool, cycles: u64) {
+            let r = &mut self.cpu.registers;
+            r.program_counter = pc;
+            r.stack_pointer = StackPointer(regs[0]);
+            r.accumulator = regs[1];
+            r.index_x = regs[2];
+            r.index_y = regs[3];
+            r.status = Status::from_bits_truncate(regs[4]);
+            self.cpu.cycles = cycles;
+        }
+    }
+}
+
+#[cfg(feature = "c-core")]
+mod imp {
+    use std::ffi::c_void;
+    use std::ptr;
+
+    use super::{Breakpoints, FLAG_I};
+    use crate::bus::{MattbrewBus, RealDevices};
+
+    unsafe extern "C" {
+        fn core65_size() -> usize;
+        fn core65_init(core: *mut c_void, bus: *mut c_void);
+        fn core65_reset(core: *mut c_void);
+        fn core65_irq(core: *mut c_void);
+        fn core65_step(core: *mut c_void, now: u64) -> u32;
+        fn core65_run(
+            core: *mut c_void,
+            budget: u32,
+            now: u64,
+            breakpoints: *const u8,
+            irq_masked: u8,
+            hit: *mut u8,
+        ) -> u32;
+        fn core65_pc(core: *const c_void) -> u16;
+        fn core65_reg(core: *const c_void, r: i32) -> u8;
+        fn core65_set_pc(core: *mut c_void, pc: u16);
+        fn core65_set_reg(core: *mut c_void, r: i32, value: u8);
+    }
+
+    #[unsafe(no_mangle)]
+    extern "C" fn emu_bus_read(bus: *mut c_void, address: u16, now: u64) -> u8 {
+        use mos6502::memory::Bus;
+        // SAFETY: `bus` is the Box'd bus the core was set up with, and only
+        // the core touches it while it runs.
+        let bus = unsafe { &mut *(bus as *mut MattbrewBus<RealDevices>) };
+        bus.now = now;
+        bus.get_byte(address)
+    }
+
+    /// Returns 1 if the write moved the next event, which ends the run
+    /// there so that `Cpu::run` can set a new goal.
+    #[unsafe(no_mangle)]
+    extern "C" fn emu_bus_write(bus: *mut c_void, address: u16, value: u8, now: u64) -> u8 {
+        use mos6502::memory::Bus;
+        // SAFETY: as for emu_bus_read.
+        let bus = unsafe { &mut *(bus as *mut MattbrewBus<RealDevices>) };
+        let next = bus.next_event();
+        bus.now = now;
+        bus.set_byte(address, value);
+        (bus.next_event() != next) as u8
+    }
+
+    pub struct Cpu {
+        /// The C core65 state, sized by core65_size().
+        core: Box<[u64]>,
+        /// Boxed so the core's pointer to it stays put.
+        bus: Box<MattbrewBus<RealDevices>>,
+        cycles: u64,
+    }
+
+    impl Cpu {
+        pub fn new(bus: MattbrewBus<RealDevices>) -> Self {
+            // SAFETY: core65_size() bytes of 8-byte-aligned storage, and a
+            // bus pointer that lives as long as the core.
+            let words = unsafe { core65_size() }.div_ceil(8);
+            let mut cpu = Cpu {
+                core: vec![0u64; words].into_boxed_slice(),
+                bus: Box::new(bus),
+                cycles: 0,
+            };
+            unsafe { core65_init(cpu.core_ptr(), cpu.bus_ptr()) };
+            cpu
+        }
+
+        fn core_ptr(&mut self) -> *mut c_void {
+            self.core.as_mut_ptr() as *mut c_void
+        }
+
+        fn bus_ptr(&mut self) -> *mut c_void {
+            &mut *self.bus as *mut MattbrewBus<RealDevices> as *mut c_void
+        }
+
+        pub fn bus(&self) -> &MattbrewBus<RealDevices> {
+            &self.bus
+        }
+
+        pub fn bus_mut(&mut self) -> &mut MattbrewBus<RealDevices> {
+            &mut self.bus
+        }
+
+        pub fn reset(&mut self) {
+            unsafe { core65_reset(self.core_ptr()) }
+        }
+
+        /// Take the IRQ if one is due (core65_irq also ends a WAI). Returns
+        /// whether IRQ is still held with I set, for the run to stop as soon
+        /// as an instruction clears it.
+        fn interrupt(&mut self) -> bool {
+            if self.cycles < self.bus.next_event() {
+                return false;
+            }
+            self.bus.now = self.cycles;
+            if !self.bus.irq() {
+                return false;
+            }
+            unsafe { core65_irq(self.core_ptr()) };
+            self.status() & FLAG_I != 0
+        }
+
+        pub fn step(&mut self) -> bool {
+            self.interrupt();
+            let mut ticks = unsafe { core65_step(self.core_ptr(), self.cycles) };
+            if ticks == 0 {
+                // Parked in WAI: on to whatever ends it, if anything will
+                let next = self.bus.next_event();
+                if next == u64::MAX {
+                    return false;
+                }
+                self.cycles = self.cycles.max(next);
+                self.interrupt();
+                ticks = unsafe { core65_step(self.core_ptr(), self.cycles) };
+            }
+            self.cycles += ticks as u64;
+            ticks != 0
+        }
+
+        /// As the mos6502 version, but a call into the C core at a time,
+        /// each up to the next event. Parked in WAI, a call returns its
+        /// whole budget at once.
+        pub fn run(&mut self, budget: u32, breakpoints: &Breakpoints) -> (u32, bool) {
+            let start = self.cycles;
+            let target = start + budget as u64;
+            let bits = if breakpoints.is_empty() {
+                ptr::null()
+            } else {
+                breakpoints.bits.as_ptr()
+            };
+            let mut hit = 0u8;
+            while self.cycles < target && hit == 0 {
+                let masked = self.interrupt();
+                // While IRQ is held the core stops itself once it's unmasked
+                let goal = if masked {
+                    target
+                } else {
+                    self.bus.next_event().clamp(self.cycles + 1, target)
+                };
+                let ticks = unsafe {
+                    core65_run(
+                        self.core_ptr(),
+                        (goal - self.cycles) as u32,
+                        self.cycles,
+                        bits,
+                        masked as u8,
+                        &mut hit,
+                    )
+                };
+                self.cycles += ticks as u64;
+            }
+            ((self.cycles - start) as u32, hit != 0)
+        }
+
+        fn reg(&self, r: i32) -> u8 {
+            unsafe { core65_reg(self.core.as_ptr() as *const c_void, r) }
+        }
+
+        pub fn pc(&self) -> u16 {
+            unsafe { core65_pc(self.core.as_ptr() as *const c_void) }
+        }
+
+        pub fn sp(&self) -> u8 {
+            self.reg(3)
+        }
+
+        pub fn a(&self) -> u8 {
+            self.reg(0)
+        }
+
+        pub fn x(&self) -> u8 {
+            self.reg(1)
+        }
+
+        pub fn y(&self) -> u8 {
+            self.reg(2)
+        }
+
+        pub fn status(&self) -> u8 {
+            self.reg(4)
+        }
+
+        pub fn cycles(&self) -> u64 {
+            self.cycles
+        }
+
+        pub fn waiting(&self) -> bool {
+            self.reg(5) != 0
+        }
+
+        /// `regs` are SP, A, X, Y and P, as `Cpu::save` writes them.
+        pub fn set_registers(&mut self, pc: u16, regs: [u8; 5], waiting: bool, cycles: u64) {
+            unsafe {
+                core65_set_pc(self.core_ptr(), pc);
+                for (r, v) in [3, 0, 1, 2, 4].into_iter().zip(regs) {
+                    core65_set_reg(self.core_ptr(), r, v);
+                }
+                core65_set_reg(self.core_ptr(), 5, waiting as u8);
+            }
+            self.cycles = cycles;
+        }
+    }
+}
+
+impl Cpu {
+    /// Registers and the cycle count, then the bus.
+    pub fn save(&self, w: &mut StateWriter) {
+        w.u16(self.pc());
+        for v in [self.sp(), self.a(), self.x(), self.y(), self.status()] {
+            w.u8(v);
+        }
+        w.bool(self.waiting());
+        w.u64(self.cycles());
+        self.bus().save(w);
+    }
+
+    pub fn load(&mut self, r: &mut StateReader) -> Result<()> {
+        let pc = r.u16()?;
+        let regs = [r.u8()?, r.u8()?, r.u8()?, r.u8()?, r.u8()?];
+        let waiting = r.bool()?;
+        let cycles = r.u64()?;
+        self.set_registers(pc, regs, waiting, cycles);
+        self.bus_mut().load(r)
+    }
+}
+
+pub use imp::Cpu;
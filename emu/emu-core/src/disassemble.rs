@@ -1,4 +1,4 @@
-use core::fmt::Write;
+use std::collections::HashMap;
 
 use mos6502::Variant;
 use mos6502::instruction::{AddressingMode, Cmos6502, Instruction};
@@ -165,37 +165,90 @@ fn format_operand<H: DeviceHandler>(mode: AddressingMode, bus: &MattbrewBus<H>,
     }
 }
 
-/// Disassemble `lines` instructions starting at `start_addr`.
-/// Returns a multi-line string with one instruction per line.
-pub fn disassemble<H: DeviceHandler>(bus: &MattbrewBus<H>, start_addr: u16, lines: u32) -> String {
-    let mut result = String::new();
-    let mut addr = start_addr;
+/// One instruction at `addr` as text, and the address after it.
+fn line<H: DeviceHandler>(bus: &MattbrewBus<H>, addr: u16) -> (String, u16) {
+    let opcode = bus.peek(addr);
+    match Cmos6502::decode(opcode) {
+        Some((instr, mode)) => {
+            let mnemonic = format_mnemonic(instr);
+            let operand = format_operand(mode, bus, addr);
+            let text = if operand.is_empty() {
+                format!("{:04X}  {}", addr, mnemonic)
+            } else {
+                format!("{:04X}  {} {}", addr, mnemonic, operand)
+            };
+            (text, addr.wrapping_add(1 + mode.extra_bytes()))
+        }
+        None => (format!("{:04X}  .byte ${:02X}", addr, opcode), addr.wrapping_add(1)),
+    }
+}
 
-    for i in 0..lines {
-        let opcode = bus.peek(addr);
-        let decoded = Cmos6502::decode(opcode);
+/// Decoded lines by address, each kept until the bus reports a write to a
+/// page it reads, so a debugger redrawing the same code every frame
+/// decodes it once. Lines reading the IO page change without writes and
+/// are never kept.
+pub struct DisasmCache {
+    lines: HashMap<u16, (String, u16)>,
+}
 
-        if i > 0 {
-            result.push('\n');
-        }
+impl DisasmCache {
+    pub fn new() -> Self {
+        Self { lines: HashMap::new() }
+    }
 
-        match decoded {
-            Some((instr, mode)) => {
-                let mnemonic = format_mnemonic(instr);
-                let operand = format_operand(mode, bus, addr);
-                if operand.is_empty() {
-                    let _ = write!(result, "{:04X}  {}", addr, mnemonic);
-                } else {
-                    let _ = write!(result, "{:04X}  {} {}", addr, mnemonic, operand);
+    /// Disassemble `lines` instructions starting at `start_addr`, one per
+    /// line, decoding only those not already kept.
+    pub fn disassemble<H: DeviceHandler>(
+        &mut self,
+        bus: &mut MattbrewBus<H>,
+        start_addr: u16,
+        lines: u32,
+    ) -> String {
+        self.invalidate(bus.take_written_pages());
+        let mut result = String::new();
+        let mut addr = start_addr;
+        for i in 0..lines {
+            if i > 0 {
+                result.push('\n');
+            }
+            let next = match self.lines.get(&addr) {
+                Some((text, next)) => {
+                    result.push_str(text);
+                    *next
                 }
-                addr = addr.wrapping_add(1 + mode.extra_bytes());
+                None => {
+                    let (text, next) = line(bus, addr);
+                    result.push_str(&text);
+                    let len = next.wrapping_sub(addr);
+                    if (0..len).all(|i| addr.wrapping_add(i) >> 8 != 0xE0) {
+                        self.lines.insert(addr, (text, next));
+                    }
+                    next
+                }
+            };
+            addr = next;
+        }
+        result
+    }
+
+    /// Drop lines that read a written page: those starting in it, or in
+    /// the two bytes before it.
+    fn invalidate(&mut self, pages: [u64; 4]) {
+        if pages == [0; 4] || self.lines.is_empty() {
+            return;
+        }
+        if pages == [!0; 4] {
+            self.lines.clear();
+            return;
+        }
+        for page in 0..256u16 {
+            if pages[page as usize >> 6] & 1 << (page & 63) == 0 {
+                continue;
             }
-            None => {
-                let _ = write!(result, "{:04X}  .byte ${:02X}", addr, opcode);
-                addr = addr.wrapping_add(1);
+            let first = (page << 8).wrapping_sub(2);
+            for i in 0..258u16 {
+                self.lines.remove(&first.wrapping_add(i));
             }
         }
     }
-
-    result
 }
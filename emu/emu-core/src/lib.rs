@@ -1,5 +1,9 @@
 mod bus;
+mod cpu;
 mod disassemble;
+pub mod perfetto;
+mod state;
+pub mod trace;
 mod via;
 
 #[cfg(test)]
@@ -7,18 +11,19 @@ mod test_harness;
 #[cfg(test)]
 mod tests;
 
-use std::collections::HashSet;
-
 use bus::{MattbrewBus, RealDevices};
-use mos6502::cpu::CPU;
-use mos6502::instruction::Cmos6502;
+use cpu::{Breakpoints, Cpu};
+use disassemble::DisasmCache;
+use state::{StateReader, StateWriter};
+use trace::{TraceWriter, UNIT_CYCLES};
 use wasm_bindgen::prelude::*;
 
 #[wasm_bindgen]
 pub struct Emulator {
-    cpu: CPU<MattbrewBus<RealDevices>, Cmos6502>,
-    breakpoints: HashSet<u16>,
+    cpu: Cpu,
+    breakpoints: Breakpoints,
     breakpoint_hit: bool,
+    disasm: DisasmCache,
 }
 
 #[wasm_bindgen]
@@ -26,85 +31,103 @@ impl Emulator {
     #[wasm_bindgen(constructor)]
     pub fn new() -> Emulator {
         console_error_panic_hook::set_once();
-        let mut cpu = CPU::new(MattbrewBus::new(RealDevices::new()), Cmos6502);
+        let mut cpu = Cpu::new(MattbrewBus::new(RealDevices::new()));
         cpu.reset();
-        Emulator { cpu, breakpoints: HashSet::new(), breakpoint_hit: false }
+        Emulator {
+            cpu,
+            breakpoints: Breakpoints::new(),
+            breakpoint_hit: false,
+            disasm: DisasmCache::new(),
+        }
     }
 
     pub fn reset(&mut self) {
-        self.cpu.memory.clear_ram();
-        self.cpu.memory.bridge.clear();
-        self.cpu.memory.via.reset();
+        self.cpu.bus_mut().clear_ram();
+        self.cpu.bus_mut().bridge.clear();
+        self.cpu.bus_mut().via.reset();
         self.cpu.reset();
     }
 
     /// Execute a single instruction. Returns true if the CPU executed
     /// (false if halted/waiting).
     pub fn step(&mut self) -> bool {
-        self.cpu.single_step()
+        self.cpu.step()
     }
 
-    /// Execute instructions until the cycle budget is exhausted,
-    /// a terminal write occurs, or a breakpoint is hit.
+    /// Execute instructions until the cycle budget is exhausted or a
+    /// breakpoint is hit. Terminal writes don't stop it: they collect in
+    /// the grid's changed rows (`terminal_changed_rows`) for the next frame.
     /// Returns the number of cycles actually consumed.
     pub fn run_for_cycles(&mut self, budget: u32) -> u32 {
-        self.cpu.memory.bridge.handler.terminal_dirty = false;
-        self.breakpoint_hit = false;
-        let start = self.cpu.cycles;
-        let target = start + budget as u64;
-        while self.cpu.cycles < target {
-            if !self.cpu.single_step() {
-                break;
-            }
-            if self.cpu.memory.bridge.handler.terminal_dirty {
-                break;
-            }
-            if !self.breakpoints.is_empty()
-                && self.breakpoints.contains(&self.cpu.registers.program_counter)
-            {
-                self.breakpoint_hit = true;
-                break;
-            }
-        }
-        (self.cpu.cycles - start) as u32
+        let (cycles, hit) = self.cpu.run(budget, &self.breakpoints);
+        self.breakpoint_hit = hit;
+        cycles
     }
 
     /// Load a ROM (max $1F00 / 7936 bytes) and reset the CPU.
     pub fn load_rom(&mut self, data: &[u8]) {
-        self.cpu.memory.load_rom(data);
-        self.cpu.memory.clear_ram();
+        self.cpu.bus_mut().load_rom(data);
+        self.cpu.bus_mut().clear_ram();
         self.cpu.reset();
     }
 
+    // --- Save states ---
+
+    /// The machine as it is now: CPU registers and cycle count, RAM and
+    /// ROM, the VIA and the bridge, mid-transaction or not, with its
+    /// devices and uploaded files. The LCD, packet log, trace and
+    /// breakpoints aren't included.
+    pub fn save_state(&self) -> Vec<u8> {
+        let mut w = StateWriter::new();
+        self.cpu.save(&mut w);
+        w.into_bytes()
+    }
+
+    /// Carry on from a `save_state`. A state that doesn't load leaves the
+    /// machine as it was.
+    pub fn load_state(&mut self, data: &[u8]) -> Result<(), String> {
+        let backup = self.save_state();
+        let loaded = StateReader::new(data).and_then(|mut r| {
+            self.cpu.load(&mut r)?;
+            r.finish()
+        });
+        if loaded.is_err() {
+            let mut r = StateReader::new(&backup).expect("own save state");
+            self.cpu.load(&mut r).expect("own save state");
+        }
+        self.breakpoint_hit = false;
+        loaded
+    }
+
     // --- Register accessors ---
 
     pub fn pc(&self) -> u16 {
-        self.cpu.registers.program_counter
+        self.cpu.pc()
     }
 
     pub fn sp(&self) -> u8 {
-        self.cpu.registers.stack_pointer.0
+        self.cpu.sp()
     }
 
     pub fn a(&self) -> u8 {
-        self.cpu.registers.accumulator
+        self.cpu.a()
     }
 
     pub fn x(&self) -> u8 {
-        self.cpu.registers.index_x
+        self.cpu.x()
     }
 
     pub fn y(&self) -> u8 {
-        self.cpu.registers.index_y
+        self.cpu.y()
     }
 
     pub fn status(&self) -> u8 {
-        self.cpu.registers.status.bits()
+        self.cpu.status()
     }
 
     /// Cycle count as f64 (u64 not supported in wasm-bindgen; safe up to 2^53).
     pub fn cycles(&self) -> f64 {
-        self.cpu.cycles as f64
+        self.cpu.cycles() as f64
     }
 
     // --- Memory ---
@@ -113,7 +136,7 @@ impl Emulator {
     pub fn read_page(&self, page: u8) -> Vec<u8> {
         let base = (page as u16) << 8;
         (0..256u16)
-            .map(|offset| self.cpu.memory.peek(base.wrapping_add(offset)))
+            .map(|offset| self.cpu.bus().peek(base.wrapping_add(offset)))
             .collect()
     }
 
@@ -121,12 +144,46 @@ impl Emulator {
 
     /// Return the 40×25 terminal grid as a string.
     pub fn terminal_text(&self) -> String {
-        self.cpu.memory.bridge.handler.terminal.as_string()
+        self.cpu.bus().bridge.handler.terminal.as_string()
+    }
+
+    /// Whether the terminal changed since `terminal_changed_rows` was last called.
+    pub fn terminal_dirty(&self) -> bool {
+        self.cpu.bus().bridge.handler.terminal.is_dirty()
+    }
+
+    /// Rows changed since the last call, bit n for row n, and clear them.
+    pub fn terminal_changed_rows(&mut self) -> u32 {
+        self.cpu.bus_mut().bridge.handler.terminal.take_dirty_rows()
+    }
+
+    /// One terminal row, trailing spaces trimmed.
+    pub fn terminal_row(&self, row: usize) -> String {
+        if row >= bus::TERM_ROWS {
+            return String::new();
+        }
+        self.cpu.bus().bridge.handler.terminal.row_string(row)
+    }
+
+    /// Address in wasm memory of the 40×25 grid, one byte per cell, row by
+    /// row. It stays put for the emulator's life.
+    pub fn terminal_cells_ptr(&self) -> usize {
+        self.cpu.bus().bridge.handler.terminal.cells_ptr() as usize
+    }
+
+    /// Keep (or stop keeping) a copy of device 2 output for `take_output`.
+    pub fn capture_output(&mut self, on: bool) {
+        self.cpu.bus_mut().bridge.handler.output = on.then(Vec::new);
+    }
+
+    /// Device 2 bytes written since the last call, while capturing.
+    pub fn take_output(&mut self) -> Vec<u8> {
+        self.cpu.bus_mut().bridge.handler.output.as_mut().map_or(Vec::new(), std::mem::take)
     }
 
     /// Push keyboard input bytes for 6502 to read from device 2.
     pub fn send_keyboard_input(&mut self, data: &[u8]) {
-        self.cpu.memory.bridge.handler.keyboard_in.extend(data);
+        self.cpu.bus_mut().bridge.handler.keyboard_in.extend(data);
     }
 
     // --- Netboot (device 3) ---
@@ -134,7 +191,7 @@ impl Emulator {
     /// Upload a named binary file for netboot.
     pub fn upload_file(&mut self, name: &str, data: &[u8]) {
         self.cpu
-            .memory
+            .bus_mut()
             .bridge
             .handler
             .uploaded_files
@@ -145,45 +202,95 @@ impl Emulator {
 
     /// Get LCD pixel buffer. Each byte: 0=off, 1=on, 255=background.
     pub fn lcd_pixels(&mut self, now_ms: f64) -> Vec<u8> {
-        self.cpu.memory.via.lcd_pixels(now_ms as u128).to_vec()
+        self.cpu.bus_mut().via.lcd_pixels(now_ms as u128).to_vec()
+    }
+
+    /// `lcd_pixels` read in place: bring the pixels up to `now_ms` and
+    /// return their address in wasm memory, lcd_width() × lcd_height() bytes.
+    pub fn lcd_pixels_ptr(&mut self, now_ms: f64) -> usize {
+        self.cpu.bus_mut().via.lcd_pixels(now_ms as u128).as_ptr() as usize
     }
 
     pub fn lcd_width(&self) -> usize {
-        self.cpu.memory.via.lcd_width()
+        self.cpu.bus().via.lcd_width()
     }
 
     pub fn lcd_height(&self) -> usize {
-        self.cpu.memory.via.lcd_height()
+        self.cpu.bus().via.lcd_height()
     }
 
     // --- Packet inspector ---
 
-    /// Drain captured TLV packets as a flat byte buffer.
-    /// Format per entry: [direction: 1] [device: 1] [len: 1] [data: len bytes]
-    pub fn drain_packets(&mut self) -> Vec<u8> {
-        let entries = self.cpu.memory.bridge.drain_packets();
-        let mut out = Vec::new();
-        for e in entries {
-            out.push(e.direction);
-            out.push(e.device);
-            let len = e.data.len().min(255) as u8;
-            out.push(len);
-            out.extend_from_slice(&e.data[..len as usize]);
-        }
-        out
+    /// Packets logged so far, wrapping at 2^32. The newest is in slot
+    /// `(packet_seq() - 1) % packet_slots()`, and the `packet_count()` before
+    /// it are still held.
+    pub fn packet_seq(&self) -> u32 {
+        self.cpu.bus().bridge.packet_log.seq()
+    }
+
+    pub fn packet_count(&self) -> usize {
+        self.cpu.bus().bridge.packet_log.len()
+    }
+
+    pub fn packet_slots(&self) -> usize {
+        bus::PACKET_SLOTS
+    }
+
+    pub fn packet_slot_size(&self) -> usize {
+        bus::PACKET_SLOT_SIZE
+    }
+
+    /// Address in wasm memory of the packet payloads, slot n at
+    /// n * packet_slot_size(). The arena stays put for the emulator's life.
+    pub fn packet_data_ptr(&self) -> usize {
+        self.cpu.bus().bridge.packet_log.data_ptr() as usize
+    }
+
+    /// Address in wasm memory of the packet metadata, 4 bytes per slot:
+    /// [direction: 1] [device: 1] [len: 1] [0].
+    pub fn packet_meta_ptr(&self) -> usize {
+        self.cpu.bus().bridge.packet_log.meta_ptr() as usize
+    }
+
+    /// Turn packet logging on or off, e.g. while the inspector is hidden.
+    pub fn set_packet_log(&mut self, enabled: bool) {
+        self.cpu.bus_mut().bridge.packet_log.enabled = enabled;
+    }
+
+    // --- Device trace ---
+
+    /// Start recording a device trace (see protocol.md), dropping any
+    /// recording not yet taken.
+    pub fn start_trace(&mut self) {
+        self.cpu.bus_mut().bridge.trace = Some(TraceWriter::new(UNIT_CYCLES));
+    }
+
+    /// Stop recording and return the trace, empty if none was recording.
+    pub fn stop_trace(&mut self) -> Vec<u8> {
+        self.cpu.bus_mut().bridge.trace.take().map_or(Vec::new(), TraceWriter::into_bytes)
+    }
+
+    pub fn tracing(&self) -> bool {
+        self.cpu.bus().bridge.trace.is_some()
     }
 
     // --- Disassembly ---
 
-    /// Disassemble `lines` instructions starting at `addr`.
-    pub fn disassemble_at(&self, addr: u16, lines: u32) -> String {
-        disassemble::disassemble(&self.cpu.memory, addr, lines)
+    /// Disassemble `lines` instructions starting at `addr`. Lines are
+    /// decoded once and kept until their bytes are written.
+    pub fn disassemble_at(&mut self, addr: u16, lines: u32) -> String {
+        self.disasm.disassemble(self.cpu.bus_mut(), addr, lines)
     }
 
     // --- Bridge status ---
 
     pub fn bridge_status(&self) -> String {
-        self.cpu.memory.bridge.status_summary()
+        self.cpu.bus().bridge.status_summary()
+    }
+
+    /// Bridge reads and writes so far, as f64 like `cycles`.
+    pub fn bridge_transactions(&self) -> f64 {
+        self.cpu.bus().bridge.transactions as f64
     }
 
     // --- Breakpoints ---
@@ -193,11 +300,11 @@ impl Emulator {
     }
 
     pub fn remove_breakpoint(&mut self, addr: u16) {
-        self.breakpoints.remove(&addr);
+        self.breakpoints.remove(addr);
     }
 
     pub fn breakpoints(&self) -> Vec<u16> {
-        self.breakpoints.iter().copied().collect()
+        self.breakpoints.iter().collect()
     }
 
     pub fn breakpoint_hit(&self) -> bool {
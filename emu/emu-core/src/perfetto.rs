@@ -0,0 +1,331 @@
+//! Device traces merged into one timeline for Perfetto (ui.perfetto.dev)
+//! or chrome://tracing, as Chrome trace-event JSON.
+//!
+//! A shein trace brings two clocks. Its own records are in the Zero's
+//! microseconds; the Pico's events (KIND_BRIDGE_EVENTS, from a bridge built
+//! with BRIDGE_EVENT_TRACE) are in the Pico's `time_us_32()`, which wraps.
+//! Both sides note the end of every SPI READ along with its LEN, so the
+//! Pico clock is lined up by finding the offset that puts the most Pico
+//! READs on a Zero READ of the same LEN, then taking the median of their
+//! differences. An emulator trace, in cycles, goes on its own timeline
+//! from 0 at the given clock.
+//!
+//! On the timeline, the 6502 process has a span per bridge read (request
+//! to response, as the Pico saw it) and an instant per write; the Pico has
+//! its SPI transactions, REQUEST to READ as a span; the Zero has its own
+//! SPI transactions as spans and the TLVs as instants.
+
+use std::collections::HashMap;
+use std::fmt::Write;
+
+use crate::trace::{KIND_BRIDGE_EVENTS, KIND_EVENT, KIND_HOST, KIND_READ, KIND_WRITE, Trace, UNIT_MICROS};
+
+/// Events, numbered as bridge/events.h has them.
+pub const EVT_BUS_READ: u8 = 0;
+pub const EVT_BUS_RESPONSE: u8 = 1;
+pub const EVT_BUS_WRITE: u8 = 2;
+pub const EVT_SPI_WRITE: u8 = 3;
+pub const EVT_SPI_REQUEST: u8 = 4;
+pub const EVT_SPI_READ: u8 = 5;
+
+/// How far apart the two ends of one READ may be once lined up, in us.
+const MATCH_US: i64 = 500;
+/// READs each side tries offsets from.
+const ALIGN_ZERO_READS: usize = 32;
+const ALIGN_PICO_READS: usize = 256;
+/// Zero READs an offset is scored on while searching.
+const SCORE_READS: usize = 1024;
+
+/// A Pico event on the Pico's clock, unwrapped.
+struct PicoEvent {
+    us: i64,
+    kind: u8,
+    device: u8,
+    arg: u16,
+    /// Events the Pico dropped just before this batch (first event only).
+    dropped: u16,
+}
+
+/// How a trace's Pico clock was lined up with its Zero clock.
+struct Alignment {
+    /// Add to a Pico time for the Zero's.
+    offset_us: i64,
+    /// Zero READs with a Pico READ at the offset, of those there are.
+    matched: usize,
+    reads: usize,
+}
+
+pub struct Export {
+    pub json: String,
+    /// Per trace given, what was found in it, for the user.
+    pub notes: Vec<String>,
+}
+
+/// The Pico events of a shein trace, oldest batch first, with
+/// `time_us_32()` unwrapped. The bus and SPI rings share a batch, so
+/// times within one needn't be in order; each is taken as the nearest to
+/// the one before.
+fn pico_events(trace: &Trace) -> Vec<PicoEvent> {
+    let mut events = Vec::new();
+    let mut last: Option<i64> = None;
+    for r in trace.records.iter().filter(|r| r.kind == KIND_BRIDGE_EVENTS) {
+        let Some((dropped, body)) = r.data.split_first_chunk::<2>() else {
+            continue;
+        };
+        let mut dropped = u16::from_le_bytes(*dropped);
+        for e in body.chunks_exact(8) {
+            let raw = u32::from_le_bytes([e[0], e[1], e[2], e[3]]);
+            let us = match last {
+                Some(last) => last + raw.wrapping_sub(last as u32) as i32 as i64,
+                None => raw as i64,
+            };
+            last = Some(us);
+            events.push(PicoEvent {
+                us,
+                kind: e[4],
+                device: e[5],
+                arg: u16::from_le_bytes([e[6], e[7]]),
+                dropped: std::mem::take(&mut dropped),
+            });
+        }
+    }
+    events
+}
+
+/// The end time and LEN of each Zero READ in a shein trace.
+fn zero_reads(trace: &Trace) -> Vec<(i64, u16)> {
+    trace
+        .records
+        .iter()
+        .filter(|r| r.kind == KIND_EVENT && r.data.len() >= 3 && r.data[0] == EVT_SPI_READ)
+        .map(|r| (r.time as i64, u16::from_le_bytes([r.data[1], r.data[2]])))
+        .collect()
+}
+
+/// Line the Pico's READs up with the Zero's. None if no offset puts even
+/// two of them together.
+fn align(zero: &[(i64, u16)], pico: &[(i64, u16)]) -> Option<Alignment> {
+    let mut by_len: HashMap<u16, Vec<i64>> = HashMap::new();
+    for &(us, len) in pico {
+        by_len.entry(len).or_default().push(us);
+    }
+    for times in by_len.values_mut() {
+        times.sort_unstable();
+    }
+    // (Zero time - Pico time) for each Zero READ with a Pico READ of its
+    // LEN within MATCH_US at `offset`
+    let matches = |zero: &[(i64, u16)], offset: i64| -> Vec<i64> {
+        let mut diffs = Vec::new();
+        for &(z, len) in zero {
+            let Some(times) = by_len.get(&len) else { continue };
+            let want = z - offset;
+            let i = times.partition_point(|&p| p < want - MATCH_US);
+            if let Some(&p) = times.get(i).filter(|&&p| p <= want + MATCH_US) {
+                diffs.push(z - p);
+            }
+        }
+        diffs
+    };
+
+    let mut best: Option<(usize, i64)> = None;
+    for &(z, zlen) in zero.iter().take(ALIGN_ZERO_READS) {
+        for &(p, plen) in pico.iter().take(ALIGN_PICO_READS) {
+            if zlen != plen {
+                continue;
+            }
+            let n = matches(&zero[..zero.len().min(SCORE_READS)], z - p).len();
+            if best.is_none_or(|(most, _)| n > most) {
+                best = Some((n, z - p));
+            }
+        }
+    }
+    let (n, offset) = best?;
+    if n < 2 {
+        return None;
+    }
+    let mut diffs = matches(zero, offset);
+    diffs.sort_unstable();
+    let offset = diffs[diffs.len() / 2];
+    Some(Alignment { offset_us: offset, matched: matches(zero, offset).len(), reads: zero.len() })
+}
+
+/// Chrome trace-event JSON, an event at a time.
+struct Json {
+    out: String,
+    events: usize,
+}
+
+impl Json {
+    fn event(&mut self, fields: std::fmt::Arguments) {
+        self.out.push_str(if self.events == 0 { "\n" } else { ",\n" });
+        let _ = write!(self.out, "{{{fields}}}");
+        self.events += 1;
+    }
+
+    fn process(&mut self, pid: usize, name: &str) {
+        self.event(format_args!(
+            r#""ph":"M","pid":{pid},"tid":0,"name":"process_name","args":{{"name":"{}"}}"#,
+            escape(name)
+        ));
+    }
+
+    fn thread(&mut self, pid: usize, tid: u32, name: &str) {
+        self.event(format_args!(
+            r#""ph":"M","pid":{pid},"tid":{tid},"name":"thread_name","args":{{"name":"{}"}}"#,
+            escape(name)
+        ));
+    }
+
+    fn span(&mut self, pid: usize, tid: u32, name: &str, ts: f64, dur: f64, arg: (&str, u64)) {
+        self.event(format_args!(
+            r#""ph":"X","pid":{pid},"tid":{tid},"name":"{name}","ts":{ts:.3},"dur":{dur:.3},"args":{{"{}":{}}}"#,
+            arg.0, arg.1
+        ));
+    }
+
+    fn instant(&mut self, pid: usize, tid: u32, name: &str, ts: f64, arg: (&str, u64)) {
+        self.event(format_args!(
+            r#""ph":"i","s":"t","pid":{pid},"tid":{tid},"name":"{name}","ts":{ts:.3},"args":{{"{}":{}}}"#,
+            arg.0, arg.1
+        ));
+    }
+}
+
+fn escape(s: &str) -> String {
+    let mut out = String::with_capacity(s.len());
+    for c in s.chars() {
+        match c {
+            '"' => out.push_str("\\\""),
+            '\\' => out.push_str("\\\\"),
+            c if (c as u32) < 0x20 => {
+                let _ = write!(out, "\\u{:04x}", c as u32);
+            }
+            c => out.push(c),
+        }
+    }
+    out
+}
+
+/// Threads: one per device, and one for the SPI link.
+const TID_SPI: u32 = 100;
+
+fn device_thread(device: u8) -> u32 {
+    if device == 0xFF { TID_SPI } else { device as u32 }
+}
+
+/// The Pico events of a shein trace, moved onto the Zero's clock.
+fn pico_timeline(json: &mut Json, pid_6502: usize, pid_pico: usize, events: &[PicoEvent], offset: i64) {
+    let mut reads: HashMap<u8, f64> = HashMap::new();
+    let mut request: Option<f64> = None;
+    for e in events {
+        let ts = (e.us + offset) as f64;
+        if e.dropped != 0 {
+            // The spans under way may have lost their ends
+            json.instant(pid_pico, 0, "events dropped", ts, ("count", e.dropped as u64));
+            reads.clear();
+            request = None;
+        }
+        let arg = e.arg as u64;
+        let tid = device_thread(e.device);
+        match e.kind {
+            EVT_BUS_READ => {
+                reads.insert(e.device, ts);
+            }
+            EVT_BUS_RESPONSE => match reads.remove(&e.device) {
+                Some(start) => json.span(pid_6502, tid, "read", start, ts - start, ("len", arg)),
+                None => json.instant(pid_6502, tid, "response", ts, ("len", arg)),
+            },
+            EVT_BUS_WRITE => json.instant(pid_6502, tid, "write", ts, ("len", arg)),
+            EVT_SPI_WRITE => json.instant(pid_pico, TID_SPI, "WRITE", ts, ("len", arg)),
+            EVT_SPI_REQUEST => request = Some(ts),
+            EVT_SPI_READ => match request.take() {
+                Some(start) => json.span(pid_pico, TID_SPI, "REQUEST..READ", start, ts - start, ("len", arg)),
+                None => json.instant(pid_pico, TID_SPI, "READ", ts, ("len", arg)),
+            },
+            _ => {}
+        }
+    }
+}
+
+/// Merge `traces` (each with the name to show it by) into one timeline.
+/// `mhz` is the clock an emulator trace's cycles are shown at.
+pub fn export(traces: &[(String, Trace)], mhz: f64) -> Export {
+    let mut json = Json { out: String::from("{\"traceEvents\":["), events: 0 };
+    let mut notes = Vec::new();
+    let mut pid = 0;
+    for (name, trace) in traces {
+        if trace.unit != UNIT_MICROS {
+            pid += 1;
+            json.process(pid, &format!("Emulator ({name})"));
+            let scale = 1.0 / mhz;
+            for r in &trace.records {
+                let ts = r.time as f64 * scale;
+                let len = ("len", r.data.len() as u64);
+                match r.kind {
+                    KIND_WRITE => json.instant(pid, r.device as u32, "write", ts, len),
+                    KIND_READ => json.instant(pid, r.device as u32, "read", ts, len),
+                    KIND_HOST => json.instant(pid, r.device as u32, "host data", ts, len),
+                    _ => {}
+                }
+            }
+            notes.push(format!("{name}: emulator trace, {} records at {mhz} MHz", trace.records.len()));
+            continue;
+        }
+
+        let (pid_6502, pid_pico, pid_zero) = (pid + 1, pid + 2, pid + 3);
+        pid += 3;
+        json.process(pid_zero, &format!("Zero ({name})"));
+        json.thread(pid_zero, TID_SPI, "SPI");
+        for r in &trace.records {
+            let ts = r.time as f64;
+            let len = ("len", r.data.len() as u64);
+            match r.kind {
+                KIND_WRITE => json.instant(pid_zero, r.device as u32, "from 6502", ts, len),
+                KIND_HOST => json.instant(pid_zero, r.device as u32, "to 6502", ts, len),
+                KIND_EVENT if r.data.len() >= 7 => {
+                    let name = match r.data[0] {
+                        EVT_SPI_WRITE => "WRITE",
+                        EVT_SPI_REQUEST => "REQUEST",
+                        EVT_SPI_READ => "READ",
+                        _ => continue,
+                    };
+                    let arg = u16::from_le_bytes([r.data[1], r.data[2]]) as u64;
+                    let dur = u32::from_le_bytes([r.data[3], r.data[4], r.data[5], r.data[6]]) as f64;
+                    json.span(pid_zero, device_thread(r.device), name, ts - dur, dur, ("len", arg));
+                }
+                _ => {}
+            }
+        }
+
+        let events = pico_events(trace);
+        if events.is_empty() {
+            notes.push(format!("{name}: no Pico events (bridge built without BRIDGE_EVENT_TRACE?)"));
+            continue;
+        }
+        let zero = zero_reads(trace);
+        let pico: Vec<(i64, u16)> =
+            events.iter().filter(|e| e.kind == EVT_SPI_READ).map(|e| (e.us, e.arg)).collect();
+        let offset = match align(&zero, &pico) {
+            Some(a) => {
+                notes.push(format!(
+                    "{name}: {} Pico events, clock lined up on {} of {} READs",
+                    events.len(),
+                    a.matched,
+                    a.reads
+                ));
+                a.offset_us
+            }
+            None => {
+                // Start the Pico's timeline with the trace's
+                notes.push(format!("{name}: {} Pico events, READs don't line up; Pico clock not aligned", events.len()));
+                trace.records.first().map_or(0, |r| r.time as i64) - events[0].us
+            }
+        };
+        json.process(pid_6502, &format!("6502 ({name})"));
+        json.process(pid_pico, &format!("Pico bridge ({name})"));
+        json.thread(pid_pico, TID_SPI, "SPI");
+        pico_timeline(&mut json, pid_6502, pid_pico, &events, offset);
+    }
+    json.out.push_str("\n],\"displayTimeUnit\":\"ns\"}\n");
+    Export { json: json.out, notes }
+}
@@ -0,0 +1,182 @@
+//! Save states (`Emulator::save_state`): the CPU, memory, VIA and bridge as
+//! one byte array, for the UI to keep and load again later. Each part
+//! writes its fields in a fixed order, after a magic and version; the big
+//! memories are packed, as most of each is runs of one byte.
+
+pub(crate) type Result<T> = std::result::Result<T, String>;
+
+const MAGIC: &[u8; 4] = b"MBST";
+const VERSION: u8 = 1;
+/// Shortest run of one byte that `packed` stores as a run.
+const MIN_RUN: usize = 8;
+
+pub(crate) struct StateWriter {
+    out: Vec<u8>,
+}
+
+impl StateWriter {
+    pub fn new() -> Self {
+        let mut out = MAGIC.to_vec();
+        out.push(VERSION);
+        Self { out }
+    }
+
+    pub fn into_bytes(self) -> Vec<u8> {
+        self.out
+    }
+
+    pub fn u8(&mut self, v: u8) {
+        self.out.push(v);
+    }
+
+    pub fn bool(&mut self, v: bool) {
+        self.out.push(v as u8);
+    }
+
+    pub fn u16(&mut self, v: u16) {
+        self.out.extend(v.to_le_bytes());
+    }
+
+    pub fn u32(&mut self, v: u32) {
+        self.out.extend(v.to_le_bytes());
+    }
+
+    pub fn u64(&mut self, v: u64) {
+        self.out.extend(v.to_le_bytes());
+    }
+
+    /// A length, then the bytes.
+    pub fn bytes(&mut self, data: &[u8]) {
+        self.u32(data.len() as u32);
+        self.out.extend_from_slice(data);
+    }
+
+    pub fn opt_bytes(&mut self, data: Option<&[u8]>) {
+        self.bool(data.is_some());
+        if let Some(data) = data {
+            self.bytes(data);
+        }
+    }
+
+    /// Memory of a size the reader knows, as records of `[literals: 2]
+    /// [literals...] [run: 2] ([byte])`: some bytes as they are, then a
+    /// run of one byte.
+    pub fn packed(&mut self, data: &[u8]) {
+        let mut literals = 0;
+        let mut i = 0;
+        while i < data.len() {
+            let run = data[i..].iter().take(u16::MAX as usize).take_while(|&&b| b == data[i]).count();
+            if run >= MIN_RUN {
+                self.packed_record(&data[literals..i], run, data[i]);
+                i += run;
+                literals = i;
+            } else {
+                i += 1;
+                if i - literals == u16::MAX as usize {
+                    self.packed_record(&data[literals..i], 0, 0);
+                    literals = i;
+                }
+            }
+        }
+        if literals < data.len() {
+            self.packed_record(&data[literals..], 0, 0);
+        }
+    }
+
+    fn packed_record(&mut self, literals: &[u8], run: usize, byte: u8) {
+        self.u16(literals.len() as u16);
+        self.out.extend_from_slice(literals);
+        self.u16(run as u16);
+        if run > 0 {
+            self.u8(byte);
+        }
+    }
+}
+
+pub(crate) struct StateReader<'a> {
+    data: &'a [u8],
+    pos: usize,
+}
+
+impl<'a> StateReader<'a> {
+    /// Check the header, for the parts to be read after it.
+    pub fn new(data: &'a [u8]) -> Result<Self> {
+        if data.len() < 5 || &data[..4] != MAGIC {
+            return Err("not a save state".to_string());
+        }
+        if data[4] != VERSION {
+            return Err(format!("save state version {} (expected {VERSION})", data[4]));
+        }
+        Ok(Self { data, pos: 5 })
+    }
+
+    /// Everything has been read.
+    pub fn finish(&self) -> Result<()> {
+        if self.pos != self.data.len() {
+            return Err(format!("{} bytes left over", self.data.len() - self.pos));
+        }
+        Ok(())
+    }
+
+    fn take(&mut self, n: usize) -> Result<&'a [u8]> {
+        if n > self.data.len() - self.pos {
+            return Err("save state cut short".to_string());
+        }
+        self.pos += n;
+        Ok(&self.data[self.pos - n..self.pos])
+    }
+
+    fn array<const N: usize>(&mut self) -> Result<[u8; N]> {
+        Ok(self.take(N)?.try_into().unwrap())
+    }
+
+    pub fn u8(&mut self) -> Result<u8> {
+        Ok(self.take(1)?[0])
+    }
+
+    pub fn bool(&mut self) -> Result<bool> {
+        Ok(self.u8()? != 0)
+    }
+
+    pub fn u16(&mut self) -> Result<u16> {
+        Ok(u16::from_le_bytes(self.array()?))
+    }
+
+    pub fn u32(&mut self) -> Result<u32> {
+        Ok(u32::from_le_bytes(self.array()?))
+    }
+
+    pub fn u64(&mut self) -> Result<u64> {
+        Ok(u64::from_le_bytes(self.array()?))
+    }
+
+    pub fn bytes(&mut self) -> Result<Vec<u8>> {
+        let len = self.u32()? as usize;
+        Ok(self.take(len)?.to_vec())
+    }
+
+    pub fn opt_bytes(&mut self) -> Result<Option<Vec<u8>>> {
+        Ok(if self.bool()? { Some(self.bytes()?) } else { None })
+    }
+
+    /// Fill `out` from `StateWriter::packed`.
+    pub fn packed(&mut self, out: &mut [u8]) -> Result<()> {
+        let overrun = || "packed memory overruns its size".to_string();
+        let mut pos = 0;
+        while pos < out.len() {
+            let literals = self.u16()? as usize;
+            let dest = out.get_mut(pos..pos + literals).ok_or_else(overrun)?;
+            dest.copy_from_slice(self.take(literals)?);
+            pos += literals;
+            let run = self.u16()? as usize;
+            if run > 0 {
+                let byte = self.u8()?;
+                out.get_mut(pos..pos + run).ok_or_else(overrun)?.fill(byte);
+                pos += run;
+            } else if literals == 0 {
+                return Err("empty packed record".to_string());
+            }
+        }
+        Ok(())
+    }
+}
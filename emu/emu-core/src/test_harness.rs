@@ -6,25 +6,35 @@ use mos6502::cpu::CPU;
 use mos6502::instruction::Cmos6502;
 use mos6502::memory::Bus;
 
-use crate::bus::{BridgeBuf, DeviceHandler, MattbrewBus, PacketEntry, ROM_SIZE};
+use crate::bus::{BridgeBuf, DeviceHandler, MattbrewBus, ROM_SIZE};
+use crate::cpu::step_mos;
+
+pub struct PacketEntry {
+    pub direction: u8, // 0 = write (CPU→bridge), 1 = read (bridge→CPU)
+    pub device: u8,
+    pub data: Vec<u8>,
+}
 
 /// Mock device handler for testing — queues pre-programmed responses
-/// and captures all writes via the TlvBridge packet log.
+/// and captures all writes. The TlvBridge packet log only keeps the last
+/// PACKET_SLOTS packets, so a long run would lose the early ones.
 pub struct MockDevices {
     responses: HashMap<u8, VecDeque<Vec<u8>>>,
+    writes: Vec<(u8, Vec<u8>)>,
 }
 
 impl MockDevices {
     fn new() -> Self {
         Self {
             responses: HashMap::new(),
+            writes: Vec::new(),
         }
     }
 }
 
 impl DeviceHandler for MockDevices {
-    fn dispatch_write(&mut self, _device: u8, _data: &[u8]) {
-        // No-op — writes are captured by TlvBridge::packet_log
+    fn dispatch_write(&mut self, device: u8, data: &[u8]) {
+        self.writes.push((device, data.to_vec()));
     }
 
     fn prepare_read(&mut self, device: u8, buf: &mut BridgeBuf) {
@@ -43,6 +53,14 @@ impl DeviceHandler for MockDevices {
 
     fn clear(&mut self) {
         self.responses.clear();
+        self.writes.clear();
+    }
+
+    fn status(&self) -> u8 {
+        self.responses
+            .iter()
+            .filter(|(_, queue)| !queue.is_empty())
+            .fold(0, |status, (&device, _)| status | 1 << device)
     }
 }
 
@@ -105,7 +123,7 @@ impl TestHarness {
         let start = self.cpu.cycles;
         let target = start + max_cycles;
         while self.cpu.cycles < target {
-            if !self.cpu.single_step() {
+            if !step_mos(&mut self.cpu, target) {
                 break;
             }
         }
@@ -121,7 +139,7 @@ impl TestHarness {
             if self.cpu.registers.program_counter == addr {
                 return;
             }
-            if !self.cpu.single_step() {
+            if !step_mos(&mut self.cpu, target) {
                 panic!(
                     "CPU halted at PC={:#06X} after {} cycles (waiting for PC={:#06X})",
                     self.cpu.registers.program_counter,
@@ -140,19 +158,31 @@ impl TestHarness {
 
     /// Execute a single instruction. Returns true if the CPU executed.
     pub fn step(&mut self) -> bool {
-        self.cpu.single_step()
+        step_mos(&mut self.cpu, u64::MAX)
     }
 
     // --- Inspection ---
 
-    /// Get all captured packet log entries (non-draining).
-    pub fn packets(&self) -> &[PacketEntry] {
-        &self.cpu.memory.bridge.packet_log
+    /// Get the packet log entries still held (non-draining).
+    pub fn packets(&self) -> Vec<PacketEntry> {
+        self.cpu
+            .memory
+            .bridge
+            .packet_log
+            .iter()
+            .map(|(direction, device, data)| PacketEntry {
+                direction,
+                device,
+                data: data.to_vec(),
+            })
+            .collect()
     }
 
-    /// Drain all captured packet log entries.
+    /// Drain the packet log entries still held.
     pub fn drain_packets(&mut self) -> Vec<PacketEntry> {
-        self.cpu.memory.bridge.drain_packets()
+        let packets = self.packets();
+        self.cpu.memory.bridge.packet_log.clear();
+        packets
     }
 
     /// Get the data payloads of all writes to a specific device.
@@ -160,10 +190,11 @@ impl TestHarness {
         self.cpu
             .memory
             .bridge
-            .packet_log
+            .handler
+            .writes
             .iter()
-            .filter(|e| e.direction == 0 && e.device == device)
-            .map(|e| e.data.as_slice())
+            .filter(|(d, _)| *d == device)
+            .map(|(_, data)| data.as_slice())
             .collect()
     }
 
@@ -71,6 +71,31 @@ fn mock_device_read() {
     assert_eq!(h.peek(0x12), 0xAD);
 }
 
+#[test]
+fn status_port_shows_pending_devices() {
+    let mut h = TestHarness::new();
+    h.mock_device_read(5, vec![0xDE, 0xAD]);
+
+    h.load_program(&[
+        0xAD, 0xC0, 0xE0, // LDA $E0C0     ; status port
+        0x85, 0x10,       // STA $10
+        // Read device 5, which empties its queue
+        0xA9, 0x85,       // LDA #$85
+        0x8D, 0x40, 0xE0, // STA $E040
+        0xA2, 0x00,       // LDX #0
+        0xBD, 0x40, 0xE0, // LDA $E040,X   ; length
+        0xBD, 0x40, 0xE0, // LDA $E040,X   ; byte 1
+        0xBD, 0x40, 0xE0, // LDA $E040,X   ; byte 2
+        0xAD, 0xC0, 0xE0, // LDA $E0C0
+        0x85, 0x11,       // STA $11
+        0xDB,             // STP
+    ]);
+    h.run(1000);
+
+    assert_eq!(h.peek(0x10), 1 << 5, "device 5 pending");
+    assert_eq!(h.peek(0x11), 0, "nothing pending once read");
+}
+
 #[test]
 fn device_write_capture() {
     let mut h = TestHarness::new();
@@ -219,3 +244,408 @@ fn multiple_mock_responses_fifo() {
     assert_eq!(h.peek(0x11), 0x02, "second response");
     assert_eq!(h.peek(0x12), 0x00, "third read should return length 0");
 }
+
+#[test]
+fn read_any_collects_devices() {
+    let mut h = TestHarness::new();
+
+    h.mock_device_read(2, vec![0x41]);
+    h.mock_device_read(7, vec![0x42, 0x43]);
+
+    h.load_program(&[
+        // Read any: [0x8F] [mask = devices 2 and 7]
+        0xA9, 0x8F,       // LDA #$8F
+        0x8D, 0x40, 0xE0, // STA $E040
+        0xA9, 0x84,       // LDA #$84
+        0x8D, 0x40, 0xE0, // STA $E040
+        0xAD, 0x40, 0xE0, // LDA $E040     ; total length
+        0x85, 0x10,       // STA $10
+        0xA2, 0x00,       // LDX #$00
+        0xAD, 0x40, 0xE0, // LDA $E040     ; loop: record bytes
+        0x95, 0x11,       // STA $11,X
+        0xE8,             // INX
+        0xE0, 0x07,       // CPX #$07
+        0xD0, 0xF6,       // BNE loop
+        0xDB,             // STP
+    ]);
+    h.run(1000);
+
+    assert_eq!(h.peek(0x10), 7, "two records");
+    let records: Vec<u8> = (0x11..0x18).map(|a| h.peek(a)).collect();
+    assert_eq!(records, [2, 1, 0x41, 7, 2, 0x42, 0x43]);
+}
+
+#[test]
+fn read_block_gathers_exact_length() {
+    let mut h = TestHarness::new();
+
+    h.mock_device_read(3, vec![0x01, 0x02, 0x03]);
+    h.mock_device_read(3, vec![0x04, 0x05, 0x06]);
+
+    h.load_program(&[
+        // Read block: [0x8E] [device 3] [len 4]
+        0xA9, 0x8E,       // LDA #$8E
+        0x8D, 0x40, 0xE0, // STA $E040
+        0xA9, 0x03,       // LDA #$03
+        0x8D, 0x40, 0xE0, // STA $E040
+        0xA9, 0x04,       // LDA #$04
+        0x8D, 0x40, 0xE0, // STA $E040
+        0xAD, 0x40, 0xE0, // LDA $E040     ; length
+        0x85, 0x10,       // STA $10
+        0xA2, 0x00,       // LDX #$00
+        0xAD, 0x40, 0xE0, // LDA $E040     ; loop: data bytes
+        0x95, 0x11,       // STA $11,X
+        0xE8,             // INX
+        0xE0, 0x04,       // CPX #$04
+        0xD0, 0xF6,       // BNE loop
+        // The rest stays buffered for an ordinary read of device 3
+        0xA9, 0x83,       // LDA #$83
+        0x8D, 0x40, 0xE0, // STA $E040
+        0xAD, 0x40, 0xE0, // LDA $E040     ; length
+        0x85, 0x18,       // STA $18
+        0xAD, 0x40, 0xE0, // LDA $E040     ; byte 1
+        0x85, 0x19,       // STA $19
+        0xAD, 0x40, 0xE0, // LDA $E040     ; byte 2
+        0x85, 0x1A,       // STA $1A
+        0xDB,             // STP
+    ]);
+    h.run(1000);
+
+    assert_eq!(h.peek(0x10), 4, "exact block length");
+    let block: Vec<u8> = (0x11..0x15).map(|a| h.peek(a)).collect();
+    assert_eq!(block, [0x01, 0x02, 0x03, 0x04]);
+    assert_eq!(h.peek(0x18), 2, "leftover bytes");
+    assert_eq!(h.peek(0x19), 0x05);
+    assert_eq!(h.peek(0x1A), 0x06);
+}
+
+#[test]
+fn breakpoint_bitmap() {
+    let mut bp = crate::cpu::Breakpoints::new();
+    assert!(bp.is_empty());
+    bp.insert(0xFFFF);
+    bp.insert(0x1000);
+    bp.insert(0x1000);
+    assert!(bp.contains(0x1000));
+    assert!(!bp.contains(0x1001));
+    assert_eq!(bp.iter().collect::<Vec<_>>(), vec![0x1000, 0xFFFF]);
+    bp.remove(0x1000);
+    bp.remove(0x1000);
+    bp.remove(0xFFFF);
+    assert!(bp.is_empty());
+}
+
+#[test]
+fn terminal_rows_changed() {
+    use crate::bus::{DeviceHandler, RealDevices};
+
+    let mut d = RealDevices::new();
+    d.terminal.take_dirty_rows();
+    d.dispatch_write(2, b"A\nB");
+    assert!(d.terminal.is_dirty());
+    assert_eq!(d.terminal.take_dirty_rows(), 0b11);
+    assert!(!d.terminal.is_dirty());
+    assert_eq!(d.terminal.row_string(1), "B");
+}
+
+#[test]
+fn terminal_screen_packet() {
+    use crate::bus::{DeviceHandler, RealDevices};
+
+    let mut d = RealDevices::new();
+    d.dispatch_write(2, b"one\ntwo");
+    d.terminal.take_dirty_rows();
+    // Scroll rows 0-1 down one, blank row 0, then write over "two"
+    d.dispatch_write(2, b"\0C\x00\x00\x02\x28\x01\x00R\x00\x00\x01\x28 G\x02\x00W\x02TW");
+    assert_eq!(d.terminal.take_dirty_rows(), 0b111);
+    assert_eq!(d.terminal.row_string(0), "");
+    assert_eq!(d.terminal.row_string(1), "one");
+    assert_eq!(d.terminal.row_string(2), "TWo");
+}
+
+#[test]
+fn reu_stash_and_fetch_wrap() {
+    use crate::bus::{BridgeBuf, DeviceHandler, RealDevices};
+
+    let mut d = RealDevices::new();
+    // Two bytes before the end of the 256 KB, so the stash wraps to 0
+    d.dispatch_write(0, b"A\xFE\xFF\x03");
+    d.dispatch_write(0, b"Sabcd");
+    d.dispatch_write(0, b"A\0\0\0");
+    d.dispatch_write(0, b"F\x03");
+    let mut buf = BridgeBuf::new();
+    d.prepare_read(0, &mut buf);
+    assert_eq!(buf.as_slice(), b"\x03cd\0");
+    // The fetch replaced one status read only
+    let mut buf = BridgeBuf::new();
+    d.prepare_read(0, &mut buf);
+    assert_eq!(buf.as_slice()[0], 2);
+}
+
+#[test]
+fn math_batch_results_in_order() {
+    use crate::bus::{BridgeBuf, DeviceHandler, RealDevices};
+
+    let mut d = RealDevices::new();
+    let mut batch = vec![b'M'];
+    batch.extend([0x01, 0xFF, 0xFF, 0xFF, 0xFF]); // MULU16 65535 * 65535
+    batch.extend([0x07, 0x00, 0x00, 0x00, 0x80, 0xFF, 0xFF, 0xFF, 0xFF]); // DIVS32 MIN / -1
+    batch.extend([0x04, 0x07, 0x00, 0x00, 0x00]); // DIVU16 7 / 0
+    batch.push(0x0C); // FSQRT 4.0
+    batch.extend(4.0f32.to_le_bytes());
+    batch.extend([0x0E, 0x00, 0x80]); // COS half a turn
+    batch.extend([0xFF, 0x00]); // Unknown op: the batch stops here
+    d.dispatch_write(0, &batch);
+    let mut buf = BridgeBuf::new();
+    d.prepare_read(0, &mut buf);
+    let mut want = vec![22, 0x01, 0x00, 0xFE, 0xFF, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00];
+    want.extend([0xFF, 0xFF, 0x07, 0x00]);
+    want.extend(2.0f32.to_le_bytes());
+    want.extend((-0x4000i16).to_le_bytes());
+    assert_eq!(buf.as_slice(), &want[..]);
+}
+
+#[test]
+fn reu_crc32_wraps_and_keeps_address() {
+    use crate::bus::{BridgeBuf, DeviceHandler, RealDevices};
+
+    let mut d = RealDevices::new();
+    d.dispatch_write(0, b"A\xFC\xFF\x03");
+    d.dispatch_write(0, b"S12345678");
+    d.dispatch_write(0, b"A\xFC\xFF\x03");
+    // Over the wrap, and one byte past what was stored
+    d.dispatch_write(0, b"C\x09\0\0");
+    let mut buf = BridgeBuf::new();
+    d.prepare_read(0, &mut buf);
+    let mut want = vec![4];
+    want.extend(0x94F1_B12Eu32.to_le_bytes()); // zlib.crc32(b"12345678\0")
+    assert_eq!(buf.as_slice(), &want[..]);
+    // The address didn't move: a fetch starts at the same '1'
+    d.dispatch_write(0, b"F\x01");
+    let mut buf = BridgeBuf::new();
+    d.prepare_read(0, &mut buf);
+    assert_eq!(buf.as_slice(), b"\x01\x31");
+}
+
+/// Read one byte from device 7, polling until there is one, and write it
+/// back to device 7; as a whole ROM image, vectors included.
+fn echo_one_rom() -> Vec<u8> {
+    let code = [
+        0xA9, 0x87,       // LDA #$87      ; read device 7
+        0x8D, 0x40, 0xE0, // STA $E040
+        0xAD, 0x40, 0xE0, // LDA $E040     ; length
+        0xF0, 0xF6,       // BEQ $E100     ; none yet
+        0xAD, 0x40, 0xE0, // LDA $E040     ; byte 1
+        0x85, 0x11,       // STA $11
+        0xA9, 0x07,       // LDA #$07      ; write [7] [1] [byte]
+        0x8D, 0x40, 0xE0, // STA $E040
+        0xA9, 0x01,       // LDA #$01
+        0x8D, 0x40, 0xE0, // STA $E040
+        0xA5, 0x11,       // LDA $11
+        0x8D, 0x40, 0xE0, // STA $E040
+        0xDB,             // STP
+    ];
+    let mut rom = vec![0xFF; 0x2000];
+    rom[0x100..0x100 + code.len()].copy_from_slice(&code);
+    rom[0x1FFC] = 0x00; // reset vector → $E100
+    rom[0x1FFD] = 0xE1;
+    rom
+}
+
+#[test]
+fn trace_record_and_replay() {
+    use crate::trace::{self, KIND_HOST, KIND_READ, KIND_WRITE, Replay, TraceWriter, UNIT_CYCLES, UNIT_MICROS};
+
+    // Record a run against a mock, then replay it with the mock gone
+    let rom = echo_one_rom();
+    let mut h = TestHarness::new();
+    h.load_rom(&rom);
+    h.mock_device_read(7, vec![b'Z']);
+    h.cpu.memory.bridge.trace = Some(TraceWriter::new(UNIT_CYCLES));
+    h.run(1000);
+    let bytes = h.cpu.memory.bridge.trace.take().unwrap().into_bytes();
+
+    let recorded = trace::parse(&bytes).unwrap();
+    let kinds: Vec<(u8, u8, Vec<u8>)> =
+        recorded.records.iter().map(|r| (r.kind, r.device, r.data.clone())).collect();
+    assert_eq!(kinds, vec![(KIND_READ, 7, vec![b'Z']), (KIND_WRITE, 7, vec![b'Z'])]);
+
+    let mut replay = Replay::new(&rom, &recorded, 1);
+    replay.run();
+    assert!(replay.done());
+    assert_eq!(replay.stats().reads, 1);
+    assert_eq!(replay.stats().mismatched, 0);
+
+    // Host data, as shein records it, only arrives at its time: the
+    // program polls until then
+    let mut w = TraceWriter::new(UNIT_MICROS);
+    w.record(100, KIND_HOST, 7, b"Q");
+    w.record(150, KIND_WRITE, 7, b"Q");
+    let host = trace::parse(&w.into_bytes()).unwrap();
+    let mut replay = Replay::new(&rom, &host, 2);
+    let cycles = replay.run();
+    assert!(replay.done());
+    assert!(cycles >= 200, "host data arrived after {cycles} cycles");
+    assert_eq!(replay.stats().host_bytes, 1);
+    assert_eq!(replay.stats().mismatched, 0);
+
+    // A cut-short record is dropped, and a bad header refused
+    let mut w = TraceWriter::new(UNIT_CYCLES);
+    w.record(300, KIND_WRITE, 2, b"hello");
+    let mut bytes = w.into_bytes();
+    bytes.pop();
+    assert!(trace::parse(&bytes).unwrap().records.is_empty());
+    assert!(trace::parse(b"MBTX\x01\x00").is_err());
+}
+
+#[test]
+fn disassembly_cache_follows_writes() {
+    use crate::disassemble::DisasmCache;
+
+    let mut h = TestHarness::new();
+    let mut cache = DisasmCache::new();
+    // LDA #$12 at $0200, the operand at the start of the next page for a
+    // JMP ending on $02FE
+    h.poke(0x0200, 0xA9);
+    h.poke(0x0201, 0x12);
+    h.poke(0x02FE, 0x4C);
+    h.poke(0x0300, 0x34);
+    assert_eq!(cache.disassemble(&mut h.cpu.memory, 0x0200, 1), "0200  LDA #$12");
+    assert_eq!(cache.disassemble(&mut h.cpu.memory, 0x02FE, 1), "02FE  JMP $3400");
+
+    // A write to the operand, in either page, shows on the next call
+    h.poke(0x0201, 0x56);
+    h.poke(0x0300, 0x78);
+    assert_eq!(cache.disassemble(&mut h.cpu.memory, 0x0200, 1), "0200  LDA #$56");
+    assert_eq!(cache.disassemble(&mut h.cpu.memory, 0x02FE, 1), "02FE  JMP $7800");
+}
+
+#[test]
+fn via_t2_interrupt_ends_wai() {
+    // Arm a 1000-cycle T2 one-shot with its interrupt on, then WAI: the
+    // clock should jump to the expiry, the ISR run, then the code after WAI
+    let code = [
+        0xA9, 0xA0,       // LDA #$A0      ; IER: enable T2
+        0x8D, 0x0E, 0xE0, // STA $E00E
+        0xA9, 0xE8,       // LDA #<1000
+        0x8D, 0x08, 0xE0, // STA $E008     ; T2CL
+        0xA9, 0x03,       // LDA #>1000
+        0x8D, 0x09, 0xE0, // STA $E009     ; T2CH: start
+        0x58,             // CLI
+        0xCB,             // WAI           ; $E110
+        0xE6, 0x10,       // INC $10
+        0xDB,             // STP
+        0xAD, 0x08, 0xE0, // LDA $E008     ; $E114: ISR, clears the T2 flag
+        0xE6, 0x11,       // INC $11
+        0x40,             // RTI
+    ];
+    let mut rom = vec![0xFF; 0x2000];
+    rom[0x100..0x100 + code.len()].copy_from_slice(&code);
+    rom[0x1FFC] = 0x00; // reset vector → $E100
+    rom[0x1FFD] = 0xE1;
+    rom[0x1FFE] = 0x14; // IRQ vector → $E114
+    rom[0x1FFF] = 0xE1;
+
+    let mut h = TestHarness::new();
+    h.load_rom(&rom);
+    let cycles = h.run(100_000);
+    assert_eq!(h.peek(0x11), 1, "ISR ran once");
+    assert_eq!(h.peek(0x10), 1, "WAI returned");
+    assert!((1000..1100).contains(&cycles), "stopped after {cycles} cycles");
+    // The flag is clear, and the one-shot counts on past zero
+    let now = h.cpu.cycles;
+    assert_eq!(h.cpu.memory.via.peek(0x0D, now), 0);
+    assert_eq!(h.cpu.memory.via.peek(0x09, now), 0xFF);
+}
+
+#[test]
+fn save_state_round_trip() {
+    use crate::Emulator;
+
+    // Polling device 7 in the echo ROM, with a file uploaded and a key
+    // waiting to be read
+    let mut a = Emulator::new();
+    a.load_rom(&echo_one_rom());
+    a.upload_file("hello.bin", b"hello");
+    a.send_keyboard_input(b"k");
+    a.run_for_cycles(500);
+    let state = a.save_state();
+    assert!(state.len() < 2048, "state is {} bytes", state.len());
+
+    let mut b = Emulator::new();
+    b.load_state(&state).unwrap();
+    assert_eq!((b.pc(), b.a(), b.sp(), b.cycles()), (a.pc(), a.a(), a.sp(), a.cycles()));
+    assert_eq!(b.save_state(), state);
+    // Both carry on alike
+    a.run_for_cycles(1000);
+    b.run_for_cycles(1000);
+    assert_eq!(b.save_state(), a.save_state());
+
+    // A state cut short, or not a state, is refused and changes nothing
+    assert!(b.load_state(&state[..state.len() - 1]).is_err());
+    assert!(b.load_state(b"MBTR\x01").is_err());
+    assert_eq!(b.save_state(), a.save_state());
+}
+
+#[test]
+fn save_state_packing() {
+    use crate::state::{StateReader, StateWriter};
+
+    // Runs at the ends, one just long enough, and literals longer than a
+    // record holds
+    let mut data = vec![0u8; 100];
+    data.extend([7; 8]);
+    data.extend((0..70_000u32).map(|i| (i * 7 % 251) as u8));
+    data.extend([0xFF; 70_000]);
+    let mut w = StateWriter::new();
+    w.packed(&data);
+    w.u8(0x5A);
+    let bytes = w.into_bytes();
+    assert!(bytes.len() < 70_100);
+
+    let mut r = StateReader::new(&bytes).unwrap();
+    let mut out = vec![1u8; data.len()];
+    r.packed(&mut out).unwrap();
+    assert_eq!(out, data);
+    assert_eq!(r.u8(), Ok(0x5A));
+    r.finish().unwrap();
+
+    // Too small a destination is an error, not a panic
+    let mut r = StateReader::new(&bytes).unwrap();
+    assert!(r.packed(&mut [0u8; 50]).is_err());
+}
+
+#[test]
+fn perfetto_lines_up_pico_clock() {
+    use crate::perfetto::{self, EVT_BUS_READ, EVT_BUS_RESPONSE, EVT_SPI_READ};
+    use crate::trace::{self, KIND_BRIDGE_EVENTS, KIND_EVENT, TraceWriter, UNIT_MICROS};
+
+    // The Pico's clock runs 0xFFFF_F000 - 100 us behind the Zero's and
+    // wraps part way through
+    let pico = |zero_us: u32| 0xFFFF_F000u32.wrapping_add(zero_us - 100);
+    let reads = [(1000u32, 10u16), (3000, 0), (5000, 20), (9000, 10)];
+
+    let mut w = TraceWriter::new(UNIT_MICROS);
+    let mut batch = vec![0, 0];
+    for (us, kind, device, arg) in [(2000, EVT_BUS_READ, 3, 0), (2030, EVT_BUS_RESPONSE, 3, 5)] {
+        batch.extend_from_slice(&pico(us).to_le_bytes());
+        batch.extend_from_slice(&[kind, device]);
+        batch.extend_from_slice(&u16::to_le_bytes(arg));
+    }
+    for &(us, len) in &reads {
+        let mut event = vec![EVT_SPI_READ];
+        event.extend_from_slice(&len.to_le_bytes());
+        event.extend_from_slice(&50u32.to_le_bytes());
+        w.record(us as u64, KIND_EVENT, 0xFF, &event);
+        batch.extend_from_slice(&pico(us).to_le_bytes());
+        batch.extend_from_slice(&[EVT_SPI_READ, 0xFF]);
+        batch.extend_from_slice(&len.to_le_bytes());
+    }
+    w.record(9500, KIND_BRIDGE_EVENTS, 1, &batch);
+    let shein = trace::parse(&w.into_bytes()).unwrap();
+
+    let export = perfetto::export(&[("t.mbtr".to_string(), shein)], 1.0);
+    assert_eq!(export.notes, vec!["t.mbtr: 6 Pico events, clock lined up on 4 of 4 READs".to_string()]);
+    assert!(export.json.contains(r#""tid":3,"name":"read","ts":2000.000,"dur":30.000,"args":{"len":5}"#));
+    assert!(export.json.contains(r#""name":"READ","ts":8950.000,"dur":50.000"#));
+}
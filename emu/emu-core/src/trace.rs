@@ -0,0 +1,282 @@
+//! Device traces: the TLVs that crossed the device seam, with the time of
+//! each, in the format protocol.md describes under "Device traces". The
+//! emulator records what its handler saw (`TraceWriter` on the bridge),
+//! shein records what crossed SPI, and `Replay` plays either back into a
+//! ROM at full speed with nothing rendered, for profiling. The timing
+//! records shein adds are for the perfetto module, and a replay skips them.
+
+use std::collections::VecDeque;
+
+use mos6502::cpu::CPU;
+use mos6502::instruction::Cmos6502;
+
+use crate::bus::{BridgeBuf, DeviceHandler, MAX_READ, MattbrewBus};
+use crate::cpu::step_mos;
+
+pub const TRACE_MAGIC: &[u8; 4] = b"MBTR";
+pub const TRACE_VERSION: u8 = 1;
+
+/// Header unit byte: what record times count.
+pub const UNIT_CYCLES: u8 = 0;
+pub const UNIT_MICROS: u8 = 1;
+
+/// Record kinds.
+pub const KIND_WRITE: u8 = 0; // 6502 wrote a TLV
+pub const KIND_READ: u8 = 1; // A read response the 6502 got
+pub const KIND_HOST: u8 = 2; // The host queued data for a device
+pub const KIND_EVENT: u8 = 3; // shein: an SPI transaction, [event][arg LE16][us LE32]
+pub const KIND_BRIDGE_EVENTS: u8 = 4; // shein: a Pico ['T'] event batch, less the 'T'
+
+const DEVICES: usize = 8;
+/// Cycles a replay keeps running past the last record before giving up on
+/// the program catching up with the trace (10 s at 1 MHz).
+const IDLE_LIMIT: u64 = 10_000_000;
+
+pub struct TraceWriter {
+    bytes: Vec<u8>,
+    last: u64,
+}
+
+impl TraceWriter {
+    pub fn new(unit: u8) -> Self {
+        let mut bytes = TRACE_MAGIC.to_vec();
+        bytes.push(TRACE_VERSION);
+        bytes.push(unit);
+        Self { bytes, last: 0 }
+    }
+
+    /// Append a record at `time`. Times never go backwards: an earlier one
+    /// is recorded as a delta of 0.
+    pub fn record(&mut self, time: u64, kind: u8, device: u8, data: &[u8]) {
+        let mut delta = time.saturating_sub(self.last);
+        self.last = self.last.max(time);
+        while delta >= 0x80 {
+            self.bytes.push(delta as u8 | 0x80);
+            delta >>= 7;
+        }
+        self.bytes.push(delta as u8);
+        let len = data.len().min(255);
+        self.bytes.extend_from_slice(&[kind, device, len as u8]);
+        self.bytes.extend_from_slice(&data[..len]);
+    }
+
+    pub fn into_bytes(self) -> Vec<u8> {
+        self.bytes
+    }
+}
+
+pub struct TraceRecord {
+    pub time: u64,
+    pub kind: u8,
+    pub device: u8,
+    pub data: Vec<u8>,
+}
+
+pub struct Trace {
+    pub unit: u8,
+    pub records: Vec<TraceRecord>,
+}
+
+/// Parse a trace file. A record cut short at the end (a recorder stopped
+/// mid-write) is dropped.
+pub fn parse(bytes: &[u8]) -> Result<Trace, String> {
+    if bytes.len() < 6 || &bytes[..4] != TRACE_MAGIC {
+        return Err("not a device trace".to_string());
+    }
+    if bytes[4] != TRACE_VERSION {
+        return Err(format!("trace version {} unsupported", bytes[4]));
+    }
+    let unit = bytes[5];
+    let mut records = Vec::new();
+    let mut time = 0u64;
+    let mut pos = 6;
+    'records: while pos < bytes.len() {
+        let mut delta = 0u64;
+        let mut shift = 0;
+        loop {
+            let Some(&b) = bytes.get(pos) else { break 'records };
+            pos += 1;
+            delta |= ((b & 0x7F) as u64).checked_shl(shift).unwrap_or(0);
+            shift += 7;
+            if b & 0x80 == 0 {
+                break;
+            }
+        }
+        let Some(&[kind, device, len]) = bytes.get(pos..pos + 3) else { break };
+        let Some(data) = bytes.get(pos + 3..pos + 3 + len as usize) else { break };
+        pos += 3 + len as usize;
+        time += delta;
+        records.push(TraceRecord { time, kind, device, data: data.to_vec() });
+    }
+    Ok(Trace { unit, records })
+}
+
+#[derive(Default)]
+pub struct ReplayStats {
+    /// 6502 writes, and those that differed from the trace's next one.
+    pub writes: u64,
+    pub mismatched: u64,
+    /// Recorded read responses served, and host bytes delivered.
+    pub reads: u64,
+    pub host_bytes: u64,
+}
+
+/// Device handler answering from a trace. A device's recorded read
+/// responses (an emulator trace) are served in order whenever it is read;
+/// host data (a shein trace) lands in the device's buffer once the clock
+/// reaches it, and reads take up to MAX_READ bytes of that, as the bridge
+/// would. Writes are checked against the recorded ones, so a program that
+/// strays from the trace shows up in `mismatched`.
+pub struct ReplayDevices {
+    reads: [VecDeque<Vec<u8>>; DEVICES],
+    host: VecDeque<TraceRecord>,
+    pending: [VecDeque<u8>; DEVICES],
+    writes: VecDeque<(u8, Vec<u8>)>,
+    /// Records not used up yet.
+    remaining: usize,
+    /// 6502 cycles now, kept up by the replay loop.
+    pub now: u64,
+    pub stats: ReplayStats,
+}
+
+impl ReplayDevices {
+    /// `cycles_per_tick` scales record times to 6502 cycles: 1 for a trace
+    /// in cycles, the 6502's MHz for one in microseconds.
+    pub fn new(trace: &Trace, cycles_per_tick: u64) -> Self {
+        let mut devices = Self {
+            reads: Default::default(),
+            host: VecDeque::new(),
+            pending: Default::default(),
+            writes: VecDeque::new(),
+            remaining: 0,
+            now: 0,
+            stats: ReplayStats::default(),
+        };
+        for r in &trace.records {
+            let d = r.device as usize;
+            match r.kind {
+                KIND_WRITE => devices.writes.push_back((r.device, r.data.clone())),
+                KIND_READ if d < DEVICES => devices.reads[d].push_back(r.data.clone()),
+                KIND_HOST if d < DEVICES => devices.host.push_back(TraceRecord {
+                    time: r.time * cycles_per_tick,
+                    kind: r.kind,
+                    device: r.device,
+                    data: r.data.clone(),
+                }),
+                _ => continue,
+            }
+            devices.remaining += 1;
+        }
+        devices
+    }
+
+    /// Whether every record has been used.
+    pub fn done(&self) -> bool {
+        self.remaining == 0
+    }
+
+    /// Move host data that is due into the device buffers.
+    fn deliver(&mut self) {
+        while self.host.front().is_some_and(|r| r.time <= self.now) {
+            let r = self.host.pop_front().unwrap();
+            self.stats.host_bytes += r.data.len() as u64;
+            self.pending[r.device as usize].extend(r.data);
+            self.remaining -= 1;
+        }
+    }
+}
+
+impl DeviceHandler for ReplayDevices {
+    fn dispatch_write(&mut self, device: u8, data: &[u8]) {
+        self.stats.writes += 1;
+        match self.writes.pop_front() {
+            Some((d, expected)) => {
+                self.remaining -= 1;
+                if d != device || expected != data {
+                    self.stats.mismatched += 1;
+                }
+            }
+            None => self.stats.mismatched += 1,
+        }
+    }
+
+    fn prepare_read(&mut self, device: u8, buf: &mut BridgeBuf) {
+        self.deliver();
+        let d = device as usize;
+        if d >= DEVICES {
+            buf.push(0);
+            return;
+        }
+        if let Some(data) = self.reads[d].pop_front() {
+            self.remaining -= 1;
+            self.stats.reads += 1;
+            buf.push(data.len() as u8);
+            for b in data {
+                buf.push(b);
+            }
+        } else if d == 0 {
+            // Status: the devices with data, and the Zero connected
+            let mask = (1..DEVICES)
+                .filter(|&i| !self.pending[i].is_empty())
+                .fold(0u8, |mask, i| mask | 1 << i);
+            buf.push(2);
+            buf.push(mask);
+            buf.push(1);
+        } else {
+            let n = self.pending[d].len().min(MAX_READ);
+            buf.push(n as u8);
+            for b in self.pending[d].drain(..n) {
+                buf.push(b);
+            }
+        }
+    }
+
+    fn clear(&mut self) {
+        // A replay plays the whole trace, through any resets in it.
+    }
+}
+
+/// A ROM running against a trace.
+pub struct Replay {
+    cpu: CPU<MattbrewBus<ReplayDevices>, Cmos6502>,
+    /// Time of the last record, in cycles.
+    end: u64,
+}
+
+impl Replay {
+    pub fn new(rom: &[u8], trace: &Trace, cycles_per_tick: u64) -> Self {
+        let scale = if trace.unit == UNIT_MICROS { cycles_per_tick } else { 1 };
+        let end = trace.records.last().map_or(0, |r| r.time * scale);
+        let mut bus = MattbrewBus::new(ReplayDevices::new(trace, scale));
+        bus.load_rom(rom);
+        let mut cpu = CPU::new(bus, Cmos6502);
+        cpu.reset();
+        Self { cpu, end }
+    }
+
+    /// Run until the trace is used up, the CPU stops, or IDLE_LIMIT cycles
+    /// past the last record. Returns the cycles run.
+    pub fn run(&mut self) -> u64 {
+        let start = self.cpu.cycles;
+        let limit = self.end.saturating_add(IDLE_LIMIT);
+        while !self.cpu.memory.bridge.handler.done() && self.cpu.cycles < limit {
+            self.cpu.memory.bridge.handler.now = self.cpu.cycles;
+            if !step_mos(&mut self.cpu, limit) {
+                break;
+            }
+        }
+        self.cpu.cycles - start
+    }
+
+    pub fn done(&self) -> bool {
+        self.cpu.memory.bridge.handler.done()
+    }
+
+    pub fn stats(&self) -> &ReplayStats {
+        &self.cpu.memory.bridge.handler.stats
+    }
+
+    pub fn pc(&self) -> u16 {
+        self.cpu.registers.program_counter
+    }
+}
@@ -1,9 +1,52 @@
 use vr_emu_lcd::{CharacterRom, VrEmuLcd};
 
+use crate::state::{Result, StateReader, StateWriter};
+
 const RS_BIT: u8 = 0x20; // Port A bit 5
 const RW_BIT: u8 = 0x40; // Port A bit 6
 const E_BIT: u8 = 0x80; // Port A bit 7
 
+// Interrupt flag and enable bits
+const IRQ_T2: u8 = 0x20;
+const IRQ_T1: u8 = 0x40;
+const IRQ_ANY: u8 = 0x80;
+const ACR_T1_FREE_RUN: u8 = 0x40;
+
+/// A timer as the cycle it was last loaded: it counts down from `count`
+/// at `base`, one a cycle, and its flag goes up the cycle after it passes
+/// zero. Nothing is stepped; everything is worked out from the clock.
+#[derive(Clone, Copy, Default)]
+struct Timer {
+    base: u64,
+    count: u16,
+    /// Whether the next zero raises the flag (a one-shot fires once a load).
+    armed: bool,
+}
+
+impl Timer {
+    fn load(&mut self, count: u16, now: u64) {
+        *self = Timer { base: now, count, armed: true };
+    }
+
+    fn value(&self, now: u64) -> u16 {
+        self.count.wrapping_sub(now.saturating_sub(self.base) as u16)
+    }
+
+    fn expiry(&self) -> u64 {
+        self.base + self.count as u64 + 1
+    }
+
+    fn save_state(&self, w: &mut StateWriter) {
+        w.u64(self.base);
+        w.u16(self.count);
+        w.bool(self.armed);
+    }
+
+    fn read_state(r: &mut StateReader) -> Result<Self> {
+        Ok(Timer { base: r.u64()?, count: r.u16()?, armed: r.bool()? })
+    }
+}
+
 pub struct Via6522 {
     port_b_out: u8,
     port_a_out: u8,
@@ -11,6 +54,17 @@ pub struct Via6522 {
     ddr_a: u8,
     lcd: VrEmuLcd,
     lcd_read_latch: u8,
+    t1: Timer,
+    t1_latch: u16,
+    t2: Timer,
+    t2_latch_lo: u8,
+    sr: u8,
+    acr: u8,
+    pcr: u8,
+    ifr: u8,
+    ier: u8,
+    /// When the IRQ line next needs looking at; see `next_event`.
+    next_event: u64,
 }
 
 impl Via6522 {
@@ -22,6 +76,16 @@ impl Via6522 {
             ddr_a: 0,
             lcd: VrEmuLcd::new(16, 2, CharacterRom::A00),
             lcd_read_latch: 0,
+            t1: Timer::default(),
+            t1_latch: 0,
+            t2: Timer::default(),
+            t2_latch_lo: 0,
+            sr: 0,
+            acr: 0,
+            pcr: 0,
+            ifr: 0,
+            ier: 0,
+            next_event: u64::MAX,
         }
     }
 
@@ -31,10 +95,79 @@ impl Via6522 {
         self.ddr_b = 0;
         self.ddr_a = 0;
         self.lcd_read_latch = 0;
+        // Timers stop; the latches and counters keep what they had
+        self.t1.armed = false;
+        self.t2.armed = false;
+        self.sr = 0;
+        self.acr = 0;
+        self.pcr = 0;
+        self.ifr = 0;
+        self.ier = 0;
+        self.next_event = u64::MAX;
         // LCD retains state on VIA reset (matching real hardware)
     }
 
-    pub fn read(&self, reg: u8) -> u8 {
+    /// The cycle the CPU loop next has to look at the IRQ line: when a
+    /// timer raises an enabled interrupt, 0 while the line is held, or
+    /// u64::MAX when nothing is coming.
+    pub fn next_event(&self) -> u64 {
+        self.next_event
+    }
+
+    /// Whether IRQ is held, as of the last `update`.
+    pub fn irq(&self) -> bool {
+        self.ifr & self.ier & !IRQ_ANY != 0
+    }
+
+    /// Raise the flags of timers that ran out by `now`.
+    pub fn update(&mut self, now: u64) {
+        let due = self.due_flags(now);
+        if due == 0 {
+            return;
+        }
+        self.ifr |= due;
+        if due & IRQ_T1 != 0 {
+            if self.acr & ACR_T1_FREE_RUN != 0 {
+                // Reloaded from the latch the cycle after each expiry
+                let first = self.t1.expiry();
+                let period = self.t1_latch as u64 + 2;
+                self.t1.base = first + 1 + (now - first) / period * period;
+                self.t1.count = self.t1_latch;
+            } else {
+                self.t1.armed = false;
+            }
+        }
+        if due & IRQ_T2 != 0 {
+            self.t2.armed = false;
+        }
+        self.reschedule();
+    }
+
+    // Timers with their interrupt off aren't in next_event, but their
+    // flags still go up, for a poll of IFR to see.
+    fn due_flags(&self, now: u64) -> u8 {
+        let due = |t: &Timer, flag| if t.armed && now >= t.expiry() { flag } else { 0 };
+        due(&self.t1, IRQ_T1) | due(&self.t2, IRQ_T2)
+    }
+
+    fn reschedule(&mut self) {
+        self.next_event = if self.irq() {
+            0
+        } else {
+            let mut next = u64::MAX;
+            if self.t1.armed && self.ier & IRQ_T1 != 0 {
+                next = next.min(self.t1.expiry());
+            }
+            if self.t2.armed && self.ier & IRQ_T2 != 0 {
+                next = next.min(self.t2.expiry());
+            }
+            next
+        };
+    }
+
+    /// A register as the CPU would read it at `now`, without the read's
+    /// side effects, for the memory inspector.
+    pub fn peek(&self, reg: u8, now: u64) -> u8 {
         match reg & 0x0F {
             // ORB: output bits where DDR=1, LCD read latch where DDR=0
             0x00 => (self.port_b_out & self.ddr_b) | (self.lcd_read_latch & !self.ddr_b),
@@ -44,12 +177,46 @@ impl Via6522 {
             0x02 => self.ddr_b,
             // DDRA
             0x03 => self.ddr_a,
-            // All other registers (timers, shift, IRQ) — unimplemented
-            _ => 0,
+            // T1 counter and latch
+            0x04 => self.t1.value(now) as u8,
+            0x05 => (self.t1.value(now) >> 8) as u8,
+            0x06 => self.t1_latch as u8,
+            0x07 => (self.t1_latch >> 8) as u8,
+            // T2 counter
+            0x08 => self.t2.value(now) as u8,
+            0x09 => (self.t2.value(now) >> 8) as u8,
+            0x0A => self.sr,
+            0x0B => self.acr,
+            0x0C => self.pcr,
+            // IFR: bit 7 is set while any enabled flag is
+            0x0D => {
+                let ifr = self.ifr | self.due_flags(now);
+                if ifr & self.ier != 0 { ifr | IRQ_ANY } else { ifr }
+            }
+            // IER reads back with bit 7 set
+            _ => self.ier | IRQ_ANY,
+        }
+    }
+
+    pub fn read(&mut self, reg: u8, now: u64) -> u8 {
+        self.update(now);
+        let value = self.peek(reg, now);
+        // Reading a timer's low counter byte clears its flag
+        match reg & 0x0F {
+            0x04 => self.clear_flags(IRQ_T1),
+            0x08 => self.clear_flags(IRQ_T2),
+            _ => {}
         }
+        value
+    }
+
+    fn clear_flags(&mut self, flags: u8) {
+        self.ifr &= !flags;
+        self.reschedule();
     }
 
-    pub fn write(&mut self, reg: u8, value: u8) {
+    pub fn write(&mut self, reg: u8, value: u8, now: u64) {
+        self.update(now);
         match reg & 0x0F {
             // ORB
             0x00 => {
@@ -69,9 +236,55 @@ impl Via6522 {
             0x03 => {
                 self.ddr_a = value;
             }
-            // All other registers — ignored
+            // T1 latch low
+            0x04 | 0x06 => {
+                self.t1_latch = (self.t1_latch & 0xFF00) | value as u16;
+            }
+            // T1 counter high: load the counter from the latch and start
+            0x05 => {
+                self.t1_latch = (self.t1_latch & 0x00FF) | (value as u16) << 8;
+                self.t1.load(self.t1_latch, now);
+                self.ifr &= !IRQ_T1;
+            }
+            // T1 latch high
+            0x07 => {
+                self.t1_latch = (self.t1_latch & 0x00FF) | (value as u16) << 8;
+                self.ifr &= !IRQ_T1;
+            }
+            // T2 latch low
+            0x08 => {
+                self.t2_latch_lo = value;
+            }
+            // T2 counter high: load and start the one-shot
+            0x09 => {
+                self.t2.load((value as u16) << 8 | self.t2_latch_lo as u16, now);
+                self.ifr &= !IRQ_T2;
+            }
+            0x0A => {
+                self.sr = value;
+            }
+            // ACR. T2 counting PB6 pulses isn't emulated; it counts cycles.
+            0x0B => {
+                self.acr = value;
+            }
+            0x0C => {
+                self.pcr = value;
+            }
+            // IFR: writing 1s clears those flags
+            0x0D => {
+                self.ifr &= !value;
+            }
+            // IER: bit 7 says whether the other 1s set or clear
+            0x0E => {
+                if value & IRQ_ANY != 0 {
+                    self.ier |= value & !IRQ_ANY;
+                } else {
+                    self.ier &= !value;
+                }
+            }
             _ => {}
         }
+        self.reschedule();
     }
 
     fn handle_lcd_strobe(&mut self, old: u8, new: u8) {
@@ -99,6 +312,40 @@ impl Via6522 {
         }
     }
 
+    /// Registers and timers for a save state. The LCD controller's state
+    /// is the vrEmuLcd library's own and isn't saved: it carries on with
+    /// whatever it shows, as it does over a VIA reset.
+    pub fn save(&self, w: &mut StateWriter) {
+        for v in [self.port_b_out, self.port_a_out, self.ddr_b, self.ddr_a, self.lcd_read_latch] {
+            w.u8(v);
+        }
+        self.t1.save_state(w);
+        w.u16(self.t1_latch);
+        self.t2.save_state(w);
+        for v in [self.t2_latch_lo, self.sr, self.acr, self.pcr, self.ifr, self.ier] {
+            w.u8(v);
+        }
+    }
+
+    pub fn load(&mut self, r: &mut StateReader) -> Result<()> {
+        self.port_b_out = r.u8()?;
+        self.port_a_out = r.u8()?;
+        self.ddr_b = r.u8()?;
+        self.ddr_a = r.u8()?;
+        self.lcd_read_latch = r.u8()?;
+        self.t1 = Timer::read_state(r)?;
+        self.t1_latch = r.u16()?;
+        self.t2 = Timer::read_state(r)?;
+        self.t2_latch_lo = r.u8()?;
+        self.sr = r.u8()?;
+        self.acr = r.u8()?;
+        self.pcr = r.u8()?;
+        self.ifr = r.u8()?;
+        self.ier = r.u8()?;
+        self.reschedule();
+        Ok(())
+    }
+
     pub fn lcd_pixels(&mut self, now_ms: u128) -> &[u8] {
         self.lcd.update_pixels(now_ms);
         self.lcd.pixels()
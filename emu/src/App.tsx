@@ -1,6 +1,9 @@
 import "./App.css";
-import { useState, useEffect, useRef, useCallback } from "react";
-import init, { Emulator } from "../emu-core/pkg/emu_core.js";
+import { useState, useEffect, useRef } from "react";
+import {
+  TERM_ROWS, pushKeys, readSnapshot, sharedViews, terminalRow,
+  type FromWorker, type Packet, type Registers, type SharedViews, type Snapshot, type ToWorker,
+} from "./emuShared";
 
 function hex8(n: number): string {
   return n.toString(16).padStart(2, "0").toUpperCase();
@@ -10,127 +13,133 @@ function hex16(n: number): string {
   return n.toString(16).padStart(4, "0").toUpperCase();
 }
 
+// Most packets the inspector shows; older ones scroll off.
+const MAX_PACKETS = 200;
+
+interface Session {
+  worker: Worker;
+  views: SharedViews;
+  lcdWidth: number;
+  lcdHeight: number;
+}
+
+// The emulator runs in emu.worker.ts. Each mount gets its own worker (and
+// wasm instance), so StrictMode's second effect simply terminates the first.
 function App() {
-  const [emu, setEmu] = useState<Emulator | null>(null);
+  const [session, setSession] = useState<Session | null>(null);
   const [error, setError] = useState<string | null>(null);
+  const isolated = typeof SharedArrayBuffer !== "undefined";
 
-  // The `cancelled` guard is critical here: React StrictMode double-fires effects,
-  // causing two separate WASM instances to be loaded (the `init()` idempotency check
-  // races). Emulators created on different instances live on different WASM heaps, so
-  // when GC frees the orphaned one via FinalizationRegistry, it calls `__wbg_emulator_free`
-  // with a pointer from heap A on heap B — a cross-heap free that corrupts dlmalloc.
   useEffect(() => {
-    let cancelled = false;
-    init().then(() => {
-      if (!cancelled) setEmu(new Emulator());
-    }).catch((e) => {
-      if (!cancelled) setError(String(e));
+    if (!isolated) return;
+    const worker = new Worker(new URL("./emu.worker.ts", import.meta.url), { type: "module" });
+    worker.addEventListener("message", (e: MessageEvent<FromWorker>) => {
+      const msg = e.data;
+      if (msg.type === "ready") {
+        setSession({
+          worker,
+          views: sharedViews(msg.lcdWidth, msg.lcdHeight, msg.buffer),
+          lcdWidth: msg.lcdWidth,
+          lcdHeight: msg.lcdHeight,
+        });
+      } else if (msg.type === "error") {
+        setError(msg.message);
+      }
     });
-    return () => { cancelled = true; };
-  }, []);
+    return () => worker.terminate();
+  }, [isolated]);
 
+  // SharedArrayBuffer needs the COOP/COEP headers vite.config.ts sends
+  if (!isolated) return <div className="app">This page isn't cross-origin isolated</div>;
   if (error) return <div className="app">Failed to load WASM: {error}</div>;
-  if (!emu) return <div className="app">Loading…</div>;
+  if (!session) return <div className="app">Loading…</div>;
 
-  return <EmulatorUI emu={emu} />;
+  return <EmulatorUI session={session} />;
 }
 
-function EmulatorUI({ emu }: { emu: Emulator }) {
+function EmulatorUI({ session }: { session: Session }) {
+  const { worker, views } = session;
   const [running, setRunning] = useState(false);
-  const [, setTick] = useState(0);
-  const [cyclesPerSec, setCyclesPerSec] = useState<number | null>(null);
-  const perfRef = useRef({ lastTime: 0, lastCycles: 0 });
+  const [maxSpeed, setMaxSpeed] = useState(false);
+  const [snap, setSnap] = useState<Snapshot | null>(null);
 
   const terminalRef = useRef<HTMLPreElement>(null);
-  const [lcdPixels, setLcdPixels] = useState<Uint8Array | null>(null);
+  const [termRows, setTermRows] = useState<string[]>(() => Array(TERM_ROWS).fill(""));
   const [uploadedFiles, setUploadedFiles] = useState<string[]>([]);
   const [packets, setPackets] = useState<Packet[]>([]);
+  const [showPackets, setShowPackets] = useState(true);
   const [breakpoints, setBreakpoints] = useState<Set<number>>(new Set());
+  const [tracing, setTracing] = useState(false);
 
-  const refresh = useCallback(() => {
-    setLcdPixels(emu.lcd_pixels(Date.now()));
-    const raw = emu.drain_packets();
-    if (raw.length > 0) {
-      const newPackets = parsePackets(raw);
-      setPackets((prev) => {
-        const merged = prev.length > 0 ? [...prev] : [];
-        for (const p of newPackets) {
-          const last = merged[merged.length - 1];
-          if (
-            last &&
-            last.direction === p.direction &&
-            last.device === p.device &&
-            last.data.length === p.data.length &&
-            last.data.every((b, i) => b === p.data[i])
-          ) {
-            last.count++;
-          } else {
-            merged.push(p);
-          }
-        }
-        return merged.length > 200 ? merged.slice(merged.length - 200) : merged;
-      });
-    }
-    setTick((t) => t + 1);
-  }, [emu]);
+  function send(msg: ToWorker, transfer: Transferable[] = []) {
+    worker.postMessage(msg, transfer);
+  }
 
+  // Take up whatever the worker published since the last animation frame.
+  // Only rows the 6502 wrote since then are decoded.
   useEffect(() => {
-    if (running) {
-      perfRef.current = { lastTime: performance.now(), lastCycles: emu.cycles() };
-      let timerId: number | null = null;
-      let lastFrame = performance.now();
-      const CPU_HZ = 1_000_000; // 1 MHz
-      const frame = () => {
-        const now = performance.now();
-        const dt = now - lastFrame;
-        lastFrame = now;
-        // Budget cycles proportional to elapsed wall-clock time at 1 MHz
-        let remaining = Math.round((dt / 1000) * CPU_HZ);
-        while (remaining > 0) {
-          const used = emu.run_for_cycles(remaining);
-          remaining -= used;
-          if (used === 0) break; // CPU halted
-          if (emu.breakpoint_hit()) {
-            refresh();
-            setRunning(false);
-            setCyclesPerSec(null);
-            return;
-          }
-          if (remaining > 0) {
-            // Broke out early (terminal write) — refresh mid-frame
-            refresh();
-          }
+    let frameId = 0;
+    let lastSeq = -1;
+    const frame = () => {
+      const next = readSnapshot(views, lastSeq);
+      if (next) {
+        lastSeq = next.seq;
+        if (next.changedRows) {
+          setTermRows((prev) =>
+            prev.map((row, i) => (next.changedRows & (1 << i) ? terminalRow(next.cells, i) : row)));
         }
-        const elapsed = now - perfRef.current.lastTime;
-        if (elapsed >= 1000) {
-          const dc = emu.cycles() - perfRef.current.lastCycles;
-          setCyclesPerSec(dc / (elapsed / 1000));
-          perfRef.current = { lastTime: now, lastCycles: emu.cycles() };
-        }
-        refresh();
-        const frameTime = performance.now() - now;
-        timerId = window.setTimeout(frame, Math.max(0, 10 - frameTime));
-      };
-      timerId = window.setTimeout(frame, 0);
-      return () => {
-        if (timerId !== null) window.clearTimeout(timerId);
-      };
-    }
-  }, [running, emu, refresh]);
+        setSnap(next);
+      }
+      frameId = window.requestAnimationFrame(frame);
+    };
+    frameId = window.requestAnimationFrame(frame);
+    return () => window.cancelAnimationFrame(frameId);
+  }, [views]);
 
-  function start() { setRunning(true); }
-  function stop() { setRunning(false); setCyclesPerSec(null); }
+  useEffect(() => {
+    const onMessage = (e: MessageEvent<FromWorker>) => {
+      const msg = e.data;
+      switch (msg.type) {
+        case "stopped":
+          setRunning(false);
+          break;
+        case "packets":
+          setPackets((prev) => mergePackets(prev, msg.packets));
+          break;
+        case "trace":
+          saveTrace(msg.data);
+          break;
+      }
+    };
+    worker.addEventListener("message", onMessage);
+    return () => worker.removeEventListener("message", onMessage);
+  }, [worker]);
 
-  function cycle() {
-    emu.step();
-    refresh();
-  }
+  // Nothing is logged while the inspector is hidden
+  useEffect(() => {
+    worker.postMessage({ type: "packetLog", on: showPackets } satisfies ToWorker);
+  }, [worker, showPackets]);
+
+  function start() { setRunning(true); send({ type: "start" }); }
+  function stop() { setRunning(false); send({ type: "stop" }); }
+  function cycle() { send({ type: "step" }); }
 
   function reset() {
     setRunning(false);
-    emu.reset();
+    send({ type: "reset" });
     setPackets([]);
-    refresh();
+  }
+
+  function toggleMaxSpeed() {
+    send({ type: "maxSpeed", on: !maxSpeed });
+    setMaxSpeed(!maxSpeed);
+  }
+
+  // Device trace (protocol.md, "Device Traces"); the worker posts it back
+  // when stopped.
+  function toggleTrace() {
+    send({ type: "trace", on: !tracing });
+    setTracing(!tracing);
   }
 
   function handleRomUpload(e: React.ChangeEvent<HTMLInputElement>) {
@@ -139,8 +148,7 @@ function EmulatorUI({ emu }: { emu: Emulator }) {
     const reader = new FileReader();
     reader.onload = (ev) => {
       const data = new Uint8Array(ev.target!.result as ArrayBuffer);
-      emu.load_rom(data);
-      refresh();
+      send({ type: "loadRom", data }, [data.buffer]);
     };
     reader.readAsArrayBuffer(file);
     e.target.value = "";
@@ -153,16 +161,28 @@ function EmulatorUI({ emu }: { emu: Emulator }) {
     reader.onload = (ev) => {
       const data = new Uint8Array(ev.target!.result as ArrayBuffer);
       const name = file.name.replace(/\.[^.]+$/, "");
-      emu.upload_file(name, data);
+      send({ type: "uploadFile", name, data }, [data.buffer]);
       setUploadedFiles((prev) => [...prev.filter((n) => n !== name), name]);
     };
     reader.readAsArrayBuffer(file);
     e.target.value = "";
   }
 
-  const pc = emu.pc();
-  const sp = emu.sp();
-  const disasm = emu.disassemble_at(pc, 20);
+  function setBreakpoint(addr: number, set: boolean) {
+    send({ type: "breakpoint", addr, set });
+    setBreakpoints((prev) => {
+      const next = new Set(prev);
+      if (set) {
+        next.add(addr);
+      } else {
+        next.delete(addr);
+      }
+      return next;
+    });
+  }
+
+  if (!snap) return <div className="app">Loading…</div>;
+  const { regs, cyclesPerSec } = snap;
 
   return (
     <div className="app">
@@ -176,6 +196,8 @@ function EmulatorUI({ emu }: { emu: Emulator }) {
             <button onClick={cycle}>Cycle</button>
           </>
         )}
+        <button onClick={toggleMaxSpeed}>{maxSpeed ? "1 MHz" : "Max speed"}</button>
+        <button onClick={toggleTrace}>{tracing ? "Save trace" : "Record trace"}</button>
         <label className="rom-upload-btn">
           Upload ROM
           <input type="file" accept=".bin,.rom" onChange={handleRomUpload} />
@@ -189,7 +211,7 @@ function EmulatorUI({ emu }: { emu: Emulator }) {
             Programs: {uploadedFiles.join(", ")}
           </span>
         )}
-        {cyclesPerSec !== null && (
+        {running && cyclesPerSec > 0 && (
           <span className="perf-counter">
             {cyclesPerSec >= 1_000_000
               ? (cyclesPerSec / 1_000_000).toFixed(2) + " MHz"
@@ -202,44 +224,77 @@ function EmulatorUI({ emu }: { emu: Emulator }) {
       <div className="main-layout">
         <div className="col-left">
           <TerminalWidget
-            text={emu.terminal_text()}
+            rows={termRows}
             terminalRef={terminalRef}
-            onKey={(data) => emu.send_keyboard_input(data)}
+            onKey={(data) => pushKeys(views, data)}
           />
-          <LcdWidget emu={emu} pixels={lcdPixels} />
+          <LcdWidget width={session.lcdWidth} height={session.lcdHeight} pixels={snap.lcd} />
         </div>
         <div className="col-mid">
-          <CpuWidget
-            pc={pc} sp={sp}
-            a={emu.a()} x={emu.x()} y={emu.y()}
-            status={emu.status()}
-          />
-          <BridgeStatusWidget emu={emu} />
-          <BreakpointWidget
-            emu={emu}
-            breakpoints={breakpoints}
-            setBreakpoints={setBreakpoints}
-          />
+          <CpuWidget regs={regs} />
+          <BridgeStatusWidget raw={snap.bridgeStatus} />
+          <BreakpointWidget breakpoints={breakpoints} setBreakpoint={setBreakpoint} />
         </div>
         <div className="col-right">
-          <DisassemblyWidget disasm={disasm} breakpoints={breakpoints} />
-          <PacketInspector packets={packets} onClear={() => setPackets([])} />
+          <DisassemblyWidget disasm={snap.disasm} breakpoints={breakpoints} />
+          {showPackets ? (
+            <PacketInspector
+              packets={packets}
+              onClear={() => setPackets([])}
+              onHide={() => { setShowPackets(false); setPackets([]); }}
+            />
+          ) : (
+            <button onClick={() => setShowPackets(true)}>Show packets</button>
+          )}
         </div>
       </div>
       <div className="memory-panels">
-        <PageBrowser emu={emu} sp={sp} />
-        <StackDisplay emu={emu} sp={sp} />
+        <PageBrowser
+          page={snap.page}
+          data={snap.pageData}
+          sp={regs.sp}
+          onPage={(page) => send({ type: "viewPage", page })}
+        />
+        <StackDisplay data={snap.stack} sp={regs.sp} />
       </div>
     </div>
   );
 }
 
+function saveTrace(data: Uint8Array) {
+  const blob = new Blob([data as Uint8Array<ArrayBuffer>], { type: "application/octet-stream" });
+  const url = URL.createObjectURL(blob);
+  const a = document.createElement("a");
+  a.href = url;
+  a.download = "emu-trace.mbtr";
+  a.click();
+  URL.revokeObjectURL(url);
+}
+
+// Append `added`, folding repeats of the last packet into its count
+function mergePackets(prev: Packet[], added: Packet[]): Packet[] {
+  const merged = prev.length > 0 ? [...prev] : [];
+  for (const p of added) {
+    const last = merged[merged.length - 1];
+    if (
+      last &&
+      last.direction === p.direction &&
+      last.device === p.device &&
+      last.data.length === p.data.length &&
+      last.data.every((b, i) => b === p.data[i])
+    ) {
+      merged[merged.length - 1] = { ...last, count: last.count + 1 };
+    } else {
+      merged.push(p);
+    }
+  }
+  return merged.length > MAX_PACKETS ? merged.slice(merged.length - MAX_PACKETS) : merged;
+}
+
 const STATUS_FLAGS = ["N", "V", "-", "B", "D", "I", "Z", "C"] as const;
 
-function CpuWidget({ pc, sp, a, x, y, status }: {
-  pc: number; sp: number; a: number; x: number; y: number;
-  status: number;
-}) {
+function CpuWidget({ regs }: { regs: Registers }) {
+  const { pc, sp, a, x, y, status } = regs;
   return (
     <div className="cpu-widget">
       <h2>CPU</h2>
@@ -283,31 +338,20 @@ function DisassemblyWidget({ disasm, breakpoints }: {
   );
 }
 
-function BreakpointWidget({ emu, breakpoints, setBreakpoints }: {
-  emu: Emulator;
+function BreakpointWidget({ breakpoints, setBreakpoint }: {
   breakpoints: Set<number>;
-  setBreakpoints: React.Dispatch<React.SetStateAction<Set<number>>>;
+  setBreakpoint: (addr: number, set: boolean) => void;
 }) {
   const [inputVal, setInputVal] = useState("");
 
   function handleAdd() {
     const addr = parseInt(inputVal, 16);
     if (!isNaN(addr) && addr >= 0 && addr <= 0xFFFF) {
-      emu.add_breakpoint(addr);
-      setBreakpoints((prev) => new Set(prev).add(addr));
+      setBreakpoint(addr, true);
       setInputVal("");
     }
   }
 
-  function handleRemove(addr: number) {
-    emu.remove_breakpoint(addr);
-    setBreakpoints((prev) => {
-      const next = new Set(prev);
-      next.delete(addr);
-      return next;
-    });
-  }
-
   const sorted = [...breakpoints].sort((a, b) => a - b);
 
   return (
@@ -330,7 +374,7 @@ function BreakpointWidget({ emu, breakpoints, setBreakpoints }: {
         {sorted.map((addr) => (
           <div key={addr} className="bp-row">
             <span className="bp-addr">${hex16(addr)}</span>
-            <button className="bp-remove" onClick={() => handleRemove(addr)}>&times;</button>
+            <button className="bp-remove" onClick={() => setBreakpoint(addr, false)}>&times;</button>
           </div>
         ))}
       </div>
@@ -338,8 +382,7 @@ function BreakpointWidget({ emu, breakpoints, setBreakpoints }: {
   );
 }
 
-function BridgeStatusWidget({ emu }: { emu: Emulator }) {
-  const raw = emu.bridge_status();
+function BridgeStatusWidget({ raw }: { raw: string }) {
   let info: { state: string; keyboard: number; echo: number; netboot: string };
   try {
     info = JSON.parse(raw);
@@ -403,23 +446,25 @@ function PageDisplay({ data, baseAddress, marker }: {
   );
 }
 
-function PageBrowser({ emu, sp }: { emu: Emulator; sp: number }) {
-  const [page, setPage] = useState(0);
+// `page` and `data` are what the worker last published; a new page shows
+// once it has read it.
+function PageBrowser({ page, data, sp, onPage }: {
+  page: number; data: Uint8Array; sp: number;
+  onPage: (page: number) => void;
+}) {
   const [inputVal, setInputVal] = useState("00");
 
   function handleInput(e: React.ChangeEvent<HTMLInputElement>) {
     const raw = e.target.value.toUpperCase().replace(/[^0-9A-F]/g, "").slice(0, 2);
     setInputVal(raw);
     const v = parseInt(raw, 16);
-    if (!isNaN(v)) setPage(Math.max(0, Math.min(255, v)));
+    if (!isNaN(v)) onPage(Math.max(0, Math.min(255, v)));
   }
 
   function handleBlur() {
     setInputVal(page.toString(16).padStart(2, "0").toUpperCase());
   }
 
-  const data = emu.read_page(page);
-
   return (
     <div>
       <h3>
@@ -441,11 +486,12 @@ function PageBrowser({ emu, sp }: { emu: Emulator; sp: number }) {
   );
 }
 
-function TerminalWidget({ text, terminalRef, onKey }: {
-  text: string;
+function TerminalWidget({ rows, terminalRef, onKey }: {
+  rows: string[];
   terminalRef: React.RefObject<HTMLPreElement | null>;
   onKey: (data: Uint8Array) => void;
 }) {
+  const text = rows.join("\n");
   useEffect(() => {
     if (terminalRef.current) {
       terminalRef.current.scrollTop = terminalRef.current.scrollHeight;
@@ -495,10 +541,10 @@ const LCD_COLOR_ON = [0x33, 0xFF, 0x33];
 const LCD_COLOR_OFF = [0x0A, 0x2A, 0x0A];
 const LCD_COLOR_BG = [0x05, 0x15, 0x05];
 
-function LcdWidget({ emu, pixels }: { emu: Emulator; pixels: Uint8Array | null }) {
+function LcdWidget({ width: w, height: h, pixels }: {
+  width: number; height: number; pixels: Uint8Array | null;
+}) {
   const canvasRef = useRef<HTMLCanvasElement>(null);
-  const w = emu.lcd_width();
-  const h = emu.lcd_height();
 
   useEffect(() => {
     const canvas = canvasRef.current;
@@ -542,33 +588,10 @@ const DEVICE_NAMES: Record<number, string> = {
   7: "Echo",
 };
 
-interface Packet {
-  direction: number;
-  device: number;
-  data: number[];
-  count: number;
-}
-
-function parsePackets(buf: Uint8Array): Packet[] {
-  const packets: Packet[] = [];
-  let i = 0;
-  while (i + 2 < buf.length) {
-    const direction = buf[i];
-    const device = buf[i + 1];
-    const len = buf[i + 2];
-    i += 3;
-    const data: number[] = [];
-    for (let j = 0; j < len && i < buf.length; j++, i++) {
-      data.push(buf[i]);
-    }
-    packets.push({ direction, device, data, count: 1 });
-  }
-  return packets;
-}
-
-function PacketInspector({ packets, onClear }: {
+function PacketInspector({ packets, onClear, onHide }: {
   packets: Packet[];
   onClear: () => void;
+  onHide: () => void;
 }) {
   const listRef = useRef<HTMLDivElement>(null);
 
@@ -583,6 +606,7 @@ function PacketInspector({ packets, onClear }: {
       <div className="packet-header">
         <h2>Packets</h2>
         <button onClick={onClear}>Clear</button>
+        <button onClick={onHide}>Hide</button>
       </div>
       <div className="packet-list" ref={listRef}>
         {packets.length === 0 && <div className="packet-empty">No packets captured</div>}
@@ -606,8 +630,7 @@ function PacketInspector({ packets, onClear }: {
   );
 }
 
-function StackDisplay({ emu, sp }: { emu: Emulator; sp: number }) {
-  const data = emu.read_page(1);
+function StackDisplay({ data, sp }: { data: Uint8Array; sp: number }) {
   return (
     <div>
       <h3>Stack (SP=${hex8(sp)})</h3>
@@ -0,0 +1,229 @@
+// The emulation thread: owns the Emulator, runs it in time slices paced to
+// 1 MHz (or flat out), and publishes its state for the UI. See emuShared.ts.
+import init, { Emulator } from "../emu-core/pkg/emu_core.js";
+import {
+  A, CHANGED_ROWS, CYCLES, CYCLES_PER_SEC, DISASM_LEN, DISASM_LINES, P, PAGE, PC, SEQ,
+  SP, STATUS_LEN, TERM_COLS, TERM_ROWS, X, Y,
+  sharedViews, takeKeys,
+  type FromWorker, type Packet, type SharedViews, type ToWorker,
+} from "./emuShared";
+
+const CPU_HZ = 1_000_000; // 1 MHz
+// Longest wall-clock gap one slice catches up on, so a throttled worker
+// doesn't come back to a multi-second batch.
+const MAX_SLICE_MS = 100;
+// Cycles per slice running flat out: a few ms, so commands still get in
+const MAX_SPEED_SLICE = 200_000;
+// Publish at about display rate while running
+const PUBLISH_MS = 16;
+// Most packets posted per publish; the inspector keeps no more anyway
+const MAX_PACKETS = 200;
+
+let emu: Emulator;
+let memory: WebAssembly.Memory;
+let views: SharedViews;
+let seq = 0;
+let packetSeq = 0;
+let viewPage = 0;
+
+let running = false;
+let maxSpeed = false;
+let lastSlice = 0;
+let lastPublish = 0;
+let scheduled = false;
+let perf = { time: 0, cycles: 0 };
+
+const encoder = new TextEncoder();
+
+function post(msg: FromWorker, transfer: Transferable[] = []) {
+  self.postMessage(msg, { transfer });
+}
+
+function writeText(region: Uint8Array, slot: number, text: string) {
+  views.ints[slot] = encoder.encodeInto(text, region).written;
+}
+
+// Copy the emulator's state into the shared buffer under the seqlock
+function publish(now: number) {
+  lastPublish = now;
+  const { ints, floats } = views;
+  Atomics.store(ints, SEQ, ++seq);
+
+  // Views of wasm memory go stale when it grows, so take fresh ones
+  const changed = emu.terminal_changed_rows();
+  if (changed) {
+    views.cells.set(new Uint8Array(memory.buffer, emu.terminal_cells_ptr(), TERM_COLS * TERM_ROWS));
+    Atomics.or(ints, CHANGED_ROWS, changed);
+  }
+  views.lcd.set(new Uint8Array(memory.buffer, emu.lcd_pixels_ptr(Date.now()), views.lcd.length));
+
+  const pc = emu.pc();
+  ints[PC] = pc;
+  ints[SP] = emu.sp();
+  ints[A] = emu.a();
+  ints[X] = emu.x();
+  ints[Y] = emu.y();
+  ints[P] = emu.status();
+  floats[CYCLES] = emu.cycles();
+  ints[PAGE] = viewPage;
+  views.page.set(emu.read_page(viewPage));
+  views.stack.set(emu.read_page(1));
+  writeText(views.disasm, DISASM_LEN, emu.disassemble_at(pc, DISASM_LINES));
+  writeText(views.status, STATUS_LEN, emu.bridge_status());
+
+  Atomics.store(ints, SEQ, ++seq);
+
+  const packets = readPackets();
+  if (packets.length > 0) post({ type: "packets", packets });
+}
+
+// Packets logged since the last call (at most MAX_PACKETS of them), read in
+// place from the emulator's packet ring.
+function readPackets(): Packet[] {
+  const next = emu.packet_seq();
+  const n = Math.min((next - packetSeq) >>> 0, emu.packet_count(), MAX_PACKETS);
+  packetSeq = next;
+  if (n === 0) return [];
+  const slots = emu.packet_slots();
+  const size = emu.packet_slot_size();
+  const meta = new Uint8Array(memory.buffer, emu.packet_meta_ptr(), slots * 4);
+  const data = new Uint8Array(memory.buffer, emu.packet_data_ptr(), slots * size);
+  const packets: Packet[] = [];
+  for (let k = n; k > 0; k--) {
+    const slot = ((next - k) >>> 0) % slots;
+    const start = slot * size;
+    packets.push({
+      direction: meta[slot * 4],
+      device: meta[slot * 4 + 1],
+      data: Array.from(data.subarray(start, start + meta[slot * 4 + 2])),
+      count: 1,
+    });
+  }
+  return packets;
+}
+
+function feedKeys() {
+  const keys = takeKeys(views);
+  if (keys) emu.send_keyboard_input(keys);
+}
+
+// Flat out, slices follow each other through a message rather than a
+// timer, which browsers clamp to 4 ms. Only one is ever pending, however
+// often the emulator is stopped and started.
+const yielder = new MessageChannel();
+yielder.port1.onmessage = slice;
+
+function schedule() {
+  if (scheduled) return;
+  scheduled = true;
+  if (maxSpeed) {
+    yielder.port2.postMessage(null);
+  } else {
+    setTimeout(slice, 1);
+  }
+}
+
+function slice() {
+  scheduled = false;
+  if (!running) return;
+  const now = performance.now();
+  const dt = Math.min(now - lastSlice, MAX_SLICE_MS);
+  lastSlice = now;
+  feedKeys();
+  // Budget cycles proportional to elapsed wall-clock time at 1 MHz
+  const budget = maxSpeed ? MAX_SPEED_SLICE : Math.round((dt / 1000) * CPU_HZ);
+  if (budget > 0) {
+    emu.run_for_cycles(budget);
+    if (emu.breakpoint_hit()) {
+      stop();
+      post({ type: "stopped" });
+      return;
+    }
+  }
+  const elapsed = now - perf.time;
+  if (elapsed >= 1000) {
+    views.floats[CYCLES_PER_SEC] = (emu.cycles() - perf.cycles) / (elapsed / 1000);
+    perf = { time: now, cycles: emu.cycles() };
+  }
+  if (now - lastPublish >= PUBLISH_MS) publish(now);
+  schedule();
+}
+
+function stop() {
+  running = false;
+  views.floats[CYCLES_PER_SEC] = 0;
+  publish(performance.now());
+}
+
+function handle(msg: ToWorker) {
+  switch (msg.type) {
+    case "start":
+      if (running) return;
+      running = true;
+      lastSlice = performance.now();
+      perf = { time: lastSlice, cycles: emu.cycles() };
+      schedule();
+      return;
+    case "stop":
+      if (running) stop();
+      return;
+    case "step":
+      feedKeys();
+      emu.step();
+      break;
+    case "reset":
+      running = false;
+      views.floats[CYCLES_PER_SEC] = 0;
+      emu.reset();
+      packetSeq = emu.packet_seq();
+      break;
+    case "maxSpeed":
+      maxSpeed = msg.on;
+      return;
+    case "loadRom":
+      emu.load_rom(msg.data);
+      break;
+    case "uploadFile":
+      emu.upload_file(msg.name, msg.data);
+      return;
+    case "breakpoint":
+      if (msg.set) {
+        emu.add_breakpoint(msg.addr);
+      } else {
+        emu.remove_breakpoint(msg.addr);
+      }
+      return;
+    case "viewPage":
+      viewPage = msg.page;
+      break;
+    case "packetLog":
+      // Nothing is logged while the inspector is hidden
+      emu.set_packet_log(msg.on);
+      packetSeq = emu.packet_seq();
+      return;
+    case "trace":
+      // Device trace (protocol.md, "Device Traces"), saved for emu-replay
+      if (msg.on) {
+        emu.start_trace();
+      } else {
+        const data = emu.stop_trace();
+        post({ type: "trace", data }, [data.buffer as ArrayBuffer]);
+      }
+      return;
+  }
+  // Whatever changed shows now, running or not
+  publish(performance.now());
+}
+
+init().then((wasm) => {
+  memory = wasm.memory;
+  emu = new Emulator();
+  const lcdWidth = emu.lcd_width();
+  const lcdHeight = emu.lcd_height();
+  views = sharedViews(lcdWidth, lcdHeight);
+  self.onmessage = (e: MessageEvent<ToWorker>) => handle(e.data);
+  publish(performance.now());
+  post({ type: "ready", buffer: views.buffer, lcdWidth, lcdHeight });
+}).catch((e) => {
+  post({ type: "error", message: String(e) });
+});
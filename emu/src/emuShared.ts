@@ -0,0 +1,201 @@
+// What the UI and the emulation worker (emu.worker.ts) share. The worker
+// owns the Emulator and publishes its state into one SharedArrayBuffer,
+// which the UI reads once per animation frame; commands go over
+// postMessage, and keystrokes through a lock-free ring in the same buffer.
+//
+// Wasm memory itself isn't shared, so the worker copies into the buffer:
+// a seqlock (SEQ odd while it writes) lets the UI tell a torn copy from a
+// whole one without either side ever waiting.
+
+export const TERM_COLS = 40;
+export const TERM_ROWS = 25;
+
+// Keyboard ring bytes, a power of two
+const KEY_RING_SIZE = 1024;
+// Room for disassemble_at(pc, DISASM_LINES) and bridge_status()
+export const DISASM_LINES = 20;
+const DISASM_MAX = 2048;
+const STATUS_MAX = 512;
+
+// Int32 slots
+export const SEQ = 0;           // Bumped to odd before a publish, to even after
+export const CHANGED_ROWS = 1;  // Terminal rows changed, or'd in by the worker, taken by the UI
+export const PC = 2;
+export const SP = 3;
+export const A = 4;
+export const X = 5;
+export const Y = 6;
+export const P = 7;
+export const PAGE = 8;          // Page whose bytes are in page[]
+export const DISASM_LEN = 9;
+export const STATUS_LEN = 10;
+export const KEY_HEAD = 11;     // Written by the UI only
+export const KEY_TAIL = 12;     // Written by the worker only
+const INT_SLOTS = 16;
+
+// Float64 slots
+export const CYCLES = 0;
+export const CYCLES_PER_SEC = 1; // 0 while stopped
+const FLOAT_SLOTS = 2;
+
+export interface SharedViews {
+  buffer: SharedArrayBuffer;
+  ints: Int32Array;
+  floats: Float64Array;
+  cells: Uint8Array;
+  lcd: Uint8Array;
+  page: Uint8Array;
+  stack: Uint8Array;
+  disasm: Uint8Array;
+  status: Uint8Array;
+  keys: Uint8Array;
+}
+
+// Carve the views out of `buffer` (a fresh one when not given), byte
+// regions after the Int32 and Float64 slots.
+export function sharedViews(
+  lcdWidth: number,
+  lcdHeight: number,
+  buffer?: SharedArrayBuffer,
+): SharedViews {
+  const sizes = {
+    cells: TERM_COLS * TERM_ROWS,
+    lcd: lcdWidth * lcdHeight,
+    page: 256,
+    stack: 256,
+    disasm: DISASM_MAX,
+    status: STATUS_MAX,
+    keys: KEY_RING_SIZE,
+  };
+  const bytesStart = INT_SLOTS * 4 + FLOAT_SLOTS * 8;
+  const total = bytesStart + Object.values(sizes).reduce((a, b) => a + b, 0);
+  const buf = buffer ?? new SharedArrayBuffer(total);
+  let offset = bytesStart;
+  const take = (n: number) => {
+    const view = new Uint8Array(buf, offset, n);
+    offset += n;
+    return view;
+  };
+  return {
+    buffer: buf,
+    ints: new Int32Array(buf, 0, INT_SLOTS),
+    floats: new Float64Array(buf, INT_SLOTS * 4, FLOAT_SLOTS),
+    cells: take(sizes.cells),
+    lcd: take(sizes.lcd),
+    page: take(sizes.page),
+    stack: take(sizes.stack),
+    disasm: take(sizes.disasm),
+    status: take(sizes.status),
+    keys: take(sizes.keys),
+  };
+}
+
+// UI side: queue keystrokes for the worker. False if the ring is full.
+export function pushKeys(v: SharedViews, data: Uint8Array): boolean {
+  const head = Atomics.load(v.ints, KEY_HEAD);
+  const tail = Atomics.load(v.ints, KEY_TAIL);
+  if (KEY_RING_SIZE - ((head - tail) | 0) < data.length) return false;
+  for (let i = 0; i < data.length; i++) {
+    v.keys[(head + i) & (KEY_RING_SIZE - 1)] = data[i];
+  }
+  Atomics.store(v.ints, KEY_HEAD, (head + data.length) | 0);
+  return true;
+}
+
+// Worker side: everything queued since the last call, or null.
+export function takeKeys(v: SharedViews): Uint8Array | null {
+  const head = Atomics.load(v.ints, KEY_HEAD);
+  const tail = Atomics.load(v.ints, KEY_TAIL);
+  const n = (head - tail) | 0;
+  if (n === 0) return null;
+  const out = new Uint8Array(n);
+  for (let i = 0; i < n; i++) {
+    out[i] = v.keys[(tail + i) & (KEY_RING_SIZE - 1)];
+  }
+  Atomics.store(v.ints, KEY_TAIL, head);
+  return out;
+}
+
+export interface Registers {
+  pc: number; sp: number; a: number; x: number; y: number; status: number;
+}
+
+export interface Snapshot {
+  seq: number;
+  regs: Registers;
+  cycles: number;
+  cyclesPerSec: number;
+  changedRows: number;
+  cells: Uint8Array;
+  lcd: Uint8Array;
+  page: number;
+  pageData: Uint8Array;
+  stack: Uint8Array;
+  disasm: string;
+  bridgeStatus: string;
+}
+
+const decoder = new TextDecoder();
+
+// UI side: copy out the last publish if it is newer than `lastSeq`, or
+// null when there is none or the worker is mid-write (try next frame).
+// Changed terminal rows are taken, and handed back if the copy tore.
+export function readSnapshot(v: SharedViews, lastSeq: number): Snapshot | null {
+  const seq = Atomics.load(v.ints, SEQ);
+  if (seq === lastSeq || seq & 1) return null;
+  const changedRows = Atomics.exchange(v.ints, CHANGED_ROWS, 0);
+  // slice() copies into ordinary buffers, which TextDecoder also needs
+  const { ints, floats } = v;
+  const snap: Snapshot = {
+    seq,
+    regs: { pc: ints[PC], sp: ints[SP], a: ints[A], x: ints[X], y: ints[Y], status: ints[P] },
+    cycles: floats[CYCLES],
+    cyclesPerSec: floats[CYCLES_PER_SEC],
+    changedRows,
+    cells: v.cells.slice(),
+    lcd: v.lcd.slice(),
+    page: ints[PAGE],
+    pageData: v.page.slice(),
+    stack: v.stack.slice(),
+    disasm: decoder.decode(v.disasm.slice(0, ints[DISASM_LEN])),
+    bridgeStatus: decoder.decode(v.status.slice(0, ints[STATUS_LEN])),
+  };
+  if (Atomics.load(v.ints, SEQ) !== seq) {
+    Atomics.or(v.ints, CHANGED_ROWS, changedRows);
+    return null;
+  }
+  return snap;
+}
+
+// One terminal row from a copy of the cells, trailing spaces trimmed
+export function terminalRow(cells: Uint8Array, row: number): string {
+  const start = row * TERM_COLS;
+  return String.fromCharCode(...cells.subarray(start, start + TERM_COLS)).replace(/ +$/, "");
+}
+
+export interface Packet {
+  direction: number;
+  device: number;
+  data: number[];
+  count: number;
+}
+
+export type ToWorker =
+  | { type: "start" }
+  | { type: "stop" }
+  | { type: "step" }
+  | { type: "reset" }
+  | { type: "maxSpeed"; on: boolean }        // Run flat out instead of at 1 MHz
+  | { type: "loadRom"; data: Uint8Array }
+  | { type: "uploadFile"; name: string; data: Uint8Array }
+  | { type: "breakpoint"; addr: number; set: boolean }
+  | { type: "viewPage"; page: number }
+  | { type: "packetLog"; on: boolean }
+  | { type: "trace"; on: boolean };          // Off posts the trace back
+
+export type FromWorker =
+  | { type: "ready"; buffer: SharedArrayBuffer; lcdWidth: number; lcdHeight: number }
+  | { type: "error"; message: string }
+  | { type: "stopped" }                      // At a breakpoint
+  | { type: "packets"; packets: Packet[] }
+  | { type: "trace"; data: Uint8Array };
@@ -2,7 +2,21 @@ import { defineConfig } from 'vite'
 import react from '@vitejs/plugin-react'
 import wasm from 'vite-plugin-wasm'
 
+// The emulator worker shares a SharedArrayBuffer with the page, which
+// browsers allow only once it is cross-origin isolated. Wherever the build
+// is hosted must send these too.
+const isolation = {
+  'Cross-Origin-Opener-Policy': 'same-origin',
+  'Cross-Origin-Embedder-Policy': 'require-corp',
+}
+
 // https://vite.dev/config/
 export default defineConfig({
   plugins: [react(), wasm()],
+  worker: {
+    format: 'es',
+    plugins: () => [wasm()],
+  },
+  server: { headers: isolation },
+  preview: { headers: isolation },
 })
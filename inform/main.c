@@ -16,6 +16,10 @@
 #include <stdint.h>
 #include <time.h>
 
+#ifdef __mattbrew__
+#include <mattbrew.h>
+#endif
+
 #define MOJOZORK_DEBUGGING 0
 
 static inline void dbg(const char *fmt, ...)
@@ -63,8 +67,16 @@ typedef struct
 {
     const char *name;
     OpcodeFn fn;
+    uint8 operand_types;  // pre-decoded, laid out as a VAR form's type byte; OPERANDS_VAR if that's still to be read.
 } Opcode;
 
+#define OPERANDS_VAR 0x00  // four large constants, which only a VAR form's own type byte can ask for.
+
+// 2OP: bits 6 and 5 pick small constant (01) or variable (10) for each operand.
+#define OPERANDS_2OP(op) ((uint8) ((((op) & (1<<6)) ? 0x80 : 0x40) | (((op) & (1<<5)) ? 0x20 : 0x10) | 0x0F))
+// 1OP, or 0OP when bits 5-4 say "omitted".
+#define OPERANDS_1OP(op) ((uint8) (((((op) >> 4) & 0x3) << 6) | 0x3F))
+
 typedef struct ZHeader
 {
     uint8 version;
@@ -87,20 +99,27 @@ typedef struct ZHeader
 
 typedef struct ZMachineState
 {
+    // the interpreter's registers come first, so a 6502 reaching them through
+    //  GState stays within an 8-bit (zp),y offset of it.
+    uint32 pc;  // program counter, as an offset into the story
+    uint16 *sp;  // stack pointer
+    uint16 bp;  // base pointer
+    uint16 *locals;  // stack + bp: the current frame's locals, kept with bp by setFrame().
+    uint8 *globals;  // story + header.globals_addr.
+    uint16 operands[8];
+    uint8 operand_count;
     uint32 instructions_run;
     uint8 *story;
     uintptr story_len;
+    #ifdef MULTIZORK
+    struct SharedStory *shared_story;  // static and high memory, which every session playing the story shares.
+    #endif
     ZHeader header;
     uint32 logical_pc;
-    const uint8 *pc;  // program counter
-    uint16 *sp;  // stack pointer
-    uint16 bp;  // base pointer
     uint16 calculated_checksum;
     int quit;
     int step_completed;  // possibly time to break out of the Z-Machine simulation loop.
     uint16 stack[2048];  // !!! FIXME: make this dynamic?
-    uint16 operands[8];
-    uint8 operand_count;
     char alphabet_table[78];
     const char *startup_script;
     char *story_filename;
@@ -111,6 +130,7 @@ typedef struct ZMachineState
     uint16 current_window;
     uint16 upper_window_line_count;  // if 0, there is no window split.
 
+    #ifndef MOJOZORK_STATIC_STATE  // that build uses the const v3_opcodes table instead.
     // this is kinda wasteful (we could pack the 89 opcodes in their various forms
     //  into separate arrays and strip off the metadata bits) but it simplifies
     //  some things to just have a big linear array.
@@ -118,6 +138,7 @@ typedef struct ZMachineState
 
     // The extended ones, however, only have one form, so we pack that tight.
     Opcode extended_opcodes[30];
+    #endif
 
     void (*split_window)(const uint16 oldval, const uint16 newval);
     void (*set_window)(const uint16 oldval, const uint16 newval);
@@ -130,32 +151,315 @@ typedef struct ZMachineState
     #endif
 } ZMachineState;
 
+// MOJOZORK_STATIC_STATE builds a single-story interpreter around one
+//  statically allocated ZMachineState, so every GState->field is an
+//  address the linker fixes rather than a load through a pointer: on the
+//  6502, that's an absolute LDA/STA instead of setting up a (zp),y access.
+//  It also only runs version 3 stories, from a const opcode table in ROM.
+#ifdef MOJOZORK_STATIC_STATE
+#if defined(MULTIZORK) || defined(MOJOZORK_LIBRETRO)
+#error MOJOZORK_STATIC_STATE is for the standalone interpreter only.
+#endif
+static ZMachineState GStateStorage;
+#define GState (&GStateStorage)
+static const Opcode v3_opcodes[256];
+#else
 static ZMachineState *GState = NULL;
+#endif
 
 
 static uint8 *get_virtualized_mem_ptr(const uint16 offset);
 static uint16 remap_objectid(const uint16 objid);
 
 #ifndef MULTIZORK
+#ifndef MOJOZORK_PAGED
 static uint8 *get_virtualized_mem_ptr(const uint16 offset) { return GState->story + offset; }
+#else
+static uint8 *get_virtualized_mem_ptr(const uint16 offset)
+{
+    if (offset >= GState->header.staticmem_addr) {  // only dynamic memory is in RAM, and only it is writable.
+        GState->die("Access to static memory through a dynamic memory pointer (%X)", (unsigned int) offset);
+    }
+    return GState->story + offset;
+}
+#endif
 static uint16 remap_objectid(const uint16 objid) { return objid; }
 #endif
 
+// Text output. The opcodes print a character or a word at a time, so it's
+//  gathered here and handed to GState->writestr in pieces of up to
+//  MOJOZORK_OUTPUT_BUFFER_SIZE bytes: on the 6502, every writestr is a
+//  bridge transaction. It goes out when the buffer fills, before input is
+//  read, before the window changes and at quit.
+#ifdef MULTIZORK  // players take turns on one interpreter, so each one's text goes straight out.
+static void flushOutput(void) {}
+static void writeOutput(const char *str, const uintptr slen) { GState->writestr(str, slen); }
+#else
+#ifndef MOJOZORK_OUTPUT_BUFFER_SIZE
+#define MOJOZORK_OUTPUT_BUFFER_SIZE 255  // the most one bridge write carries.
+#endif
+#if (MOJOZORK_OUTPUT_BUFFER_SIZE < 1) || (MOJOZORK_OUTPUT_BUFFER_SIZE > 255)
+#error MOJOZORK_OUTPUT_BUFFER_SIZE must be between 1 and 255.
+#endif
+
+static char output_buffer[MOJOZORK_OUTPUT_BUFFER_SIZE];
+static uint8 output_len = 0;
+
+static void flushOutput(void)
+{
+    if (output_len) {
+        const uint8 len = output_len;
+        output_len = 0;  // first, in case writestr dies and die flushes again.
+        GState->writestr(output_buffer, len);
+    }
+}
+
+static void writeOutput(const char *str, uintptr slen)
+{
+    while (slen) {
+        const uintptr avail = MOJOZORK_OUTPUT_BUFFER_SIZE - output_len;
+        const uintptr cpy = (slen < avail) ? slen : avail;
+        memcpy(output_buffer + output_len, str, cpy);
+        output_len += (uint8) cpy;
+        str += cpy;
+        slen -= cpy;
+        if (output_len == MOJOZORK_OUTPUT_BUFFER_SIZE) {
+            flushOutput();
+        }
+    }
+}
+#endif
+
+// Story memory. Dynamic memory (everything below staticmem_addr) always lives
+//  in GState->story, and the interpreter reads the rest -- static and high
+//  memory, which the game can't write -- only through readStory8(), by
+//  address. A MOJOZORK_PAGED build uses that to keep just dynamic memory in
+//  RAM, and reads the rest of the story a page at a time, on demand, into a
+//  small LRU cache: on the 6502, a v3 story is far bigger than the machine.
+//  MULTIZORK loads each story once, read-only, for every session playing it,
+//  and gives each session just its own copy of dynamic memory: a few KB,
+//  rather than the whole file, so one host can run hundreds of them.
+#ifdef MOJOZORK_PAGED
+static uint8 readPagedStory8(const uint32 addr);
+#endif
+
+#ifdef MULTIZORK
+typedef struct SharedStory
+{
+    char *filename;
+    uint8 *data;  // the whole file, as it shipped; sessions never write to it.
+    uint32 len;
+    uint32 refcount;  // sessions playing it.
+    struct SharedStory *next;
+} SharedStory;
+#endif
+
+static inline uint8 readStory8(const uint32 addr)
+{
+#ifdef MOJOZORK_PAGED
+    if (addr >= GState->header.staticmem_addr) {
+        return readPagedStory8(addr);
+    }
+#elif defined(MULTIZORK)
+    if (addr >= GState->header.staticmem_addr) {
+        return GState->shared_story->data[addr];
+    }
+#endif
+    return GState->story[addr];
+}
+
+static inline uint16 readStory16(const uint32 addr)
+{
+    return (((uint16) readStory8(addr)) << 8) | ((uint16) readStory8(addr + 1));
+}
+
+static inline uint8 readPC8(void)
+{
+    return readStory8(GState->pc++);
+}
+
+static inline uint16 readPC16(void)
+{
+    const uint16 val = readStory16(GState->pc);
+    GState->pc += sizeof (uint16);
+    return val;
+}
+
+// memory as loadw/loadb see it: virtualized below static memory, the story itself above.
+static uint8 readMemory8(const uint16 offset)
+{
+    return (offset < GState->header.staticmem_addr) ? *get_virtualized_mem_ptr(offset) : readStory8(offset);
+}
+
+#ifdef MOJOZORK_PAGED
+#ifdef MULTIZORK
+#error MOJOZORK_PAGED is for a single story on a small machine, not MULTIZORK.
+#endif
+
+#ifndef MOJOZORK_PAGE_SHIFT
+#define MOJOZORK_PAGE_SHIFT 8  // 256-byte pages; 9 for 512.
+#endif
+#ifndef MOJOZORK_CACHE_PAGES
+#define MOJOZORK_CACHE_PAGES 32
+#endif
+#define MOJOZORK_PAGE_SIZE (1 << MOJOZORK_PAGE_SHIFT)
+#define MOJOZORK_STORY_PAGES ((128 * 1024) >> MOJOZORK_PAGE_SHIFT)  // a v3 story is at most 128K.
+
+#if (MOJOZORK_CACHE_PAGES < 2) || (MOJOZORK_CACHE_PAGES > 255)
+#error MOJOZORK_CACHE_PAGES must be between 2 and 255.
+#endif
+
+static uint8 page_cache[MOJOZORK_CACHE_PAGES][MOJOZORK_PAGE_SIZE];
+static uint16 page_cache_page[MOJOZORK_CACHE_PAGES];  // story page in each slot, 0xFFFF if none.
+static uint8 page_cache_prev[MOJOZORK_CACHE_PAGES];  // LRU list of slots, most recently used first.
+static uint8 page_cache_next[MOJOZORK_CACHE_PAGES];
+static uint8 page_cache_head = 0;
+static uint8 page_cache_tail = 0;
+static uint8 page_slot[MOJOZORK_STORY_PAGES];  // 1 + the slot holding each story page, 0 if not cached.
+static uint16 current_page = 0xFFFF;  // the page the last read hit, which the next one almost always does.
+static const uint8 *current_page_data = NULL;
+static int static_checksum_pending = 0;  // the checksum still needs the static and high memory added in.
+
+// fill buf with MOJOZORK_PAGE_SIZE bytes of the story from page, zeros past the end of the file.
+static void fetchStoryPage(const char *fname, const uint16 page, uint8 *buf);
+
+#ifdef __mattbrew__
+// on the 6502, the Zero serves the story over the bridge's File read device (see protocol.md).
+#define FILE_READ_DEVICE 6
+#define FILE_READ_CHUNK 128  // the Zero sends the reply 128 bytes to a TLV.
+
+static void openStoryFile(const char *fname)
+{
+    if (strlen(fname) > 250) {
+        GState->die("Story filename '%s' is too long", fname);
+    }
+}
+
+static void fetchStoryPage(const char *fname, const uint16 page, uint8 *buf)
+{
+    const uint32 offset = ((uint32) page) << MOJOZORK_PAGE_SHIFT;
+    const uint8 namelen = (uint8) strlen(fname);
+    static uint8 request[5 + 250];  // static: the 6502's stack is small.
+    request[0] = (uint8) (offset & 0xFF);
+    request[1] = (uint8) ((offset >> 8) & 0xFF);
+    request[2] = (uint8) ((offset >> 16) & 0xFF);
+    request[3] = (uint8) (MOJOZORK_PAGE_SIZE & 0xFF);
+    request[4] = (uint8) ((MOJOZORK_PAGE_SIZE >> 8) & 0xFF);
+    memcpy(request + 5, fname, namelen);
+    io_write(FILE_READ_DEVICE, request, 5 + namelen);
+
+    uint16 i;
+    for (i = 0; i < MOJOZORK_PAGE_SIZE; i += FILE_READ_CHUNK) {
+        io_read_block(FILE_READ_DEVICE, buf + i, FILE_READ_CHUNK);
+    }
+}
+#else
+static FILE *story_io = NULL;
+
+static void openStoryFile(const char *fname)
+{
+    if (story_io) {
+        fclose(story_io);
+    }
+    if ((story_io = fopen(fname, "rb")) == NULL) {
+        GState->die("Failed to open '%s'", fname);
+    }
+}
+
+static void fetchStoryPage(const char *fname, const uint16 page, uint8 *buf)
+{
+    (void) fname;
+    size_t br = 0;
+    if (fseek(story_io, ((long) page) << MOJOZORK_PAGE_SHIFT, SEEK_SET) == 0) {
+        br = fread(buf, 1, MOJOZORK_PAGE_SIZE, story_io);
+    }
+    memset(buf + br, '\0', MOJOZORK_PAGE_SIZE - br);
+}
+#endif
+
+static void resetPageCache(void)
+{
+    uint8 i;
+    for (i = 0; i < MOJOZORK_CACHE_PAGES; i++) {
+        page_cache_page[i] = 0xFFFF;
+        page_cache_prev[i] = i - 1;
+        page_cache_next[i] = i + 1;
+    }
+    page_cache_head = 0;
+    page_cache_tail = MOJOZORK_CACHE_PAGES - 1;
+    memset(page_slot, '\0', sizeof (page_slot));
+    current_page = 0xFFFF;
+    current_page_data = NULL;
+}
+
+// make page the current one, fetching it into the least recently used slot if it isn't cached.
+static void selectStoryPage(const uint32 page)
+{
+    if (page >= MOJOZORK_STORY_PAGES) {
+        GState->die("Story address out of range (page %u)", (unsigned int) page);
+    }
+
+    uint8 slot;
+    if (page_slot[page]) {
+        slot = page_slot[page] - 1;
+    } else {
+        slot = page_cache_tail;
+        if (page_cache_page[slot] != 0xFFFF) {
+            page_slot[page_cache_page[slot]] = 0;
+        }
+        fetchStoryPage(GState->story_filename, (uint16) page, page_cache[slot]);
+        page_cache_page[slot] = (uint16) page;
+        page_slot[page] = slot + 1;
+    }
+
+    if (slot != page_cache_head) {  // move it to the front of the LRU list.
+        if (slot == page_cache_tail) {
+            page_cache_tail = page_cache_prev[slot];
+        } else {
+            page_cache_prev[page_cache_next[slot]] = page_cache_prev[slot];
+        }
+        page_cache_next[page_cache_prev[slot]] = page_cache_next[slot];
+        page_cache_next[slot] = page_cache_head;
+        page_cache_prev[page_cache_head] = slot;
+        page_cache_head = slot;
+    }
+
+    current_page = (uint16) page;
+    current_page_data = page_cache[slot];
+}
+
+static uint8 readPagedStory8(const uint32 addr)
+{
+    const uint32 page = addr >> MOJOZORK_PAGE_SHIFT;
+    if (page != current_page) {
+        selectStoryPage(page);
+    }
+    return current_page_data[addr & (MOJOZORK_PAGE_SIZE - 1)];
+}
+#endif
+
 // The Z-Machine can't directly address 32-bits, but this needs to expand past 16 bits when we multiply by 2, 4, or 8, etc.
-static uint8 *unpackAddress(const uint32 addr)
+static uint32 unpackAddress(const uint32 addr)
 {
     if (GState->header.version <= 3) {
-        return (GState->story + (addr * 2));
+        return addr * 2;
     } else if (GState->header.version <= 5) {
-        return (GState->story + (addr * 4));
+        return addr * 4;
     } else if (GState->header.version <= 6) {
         GState->die("write me");  //   4P + 8R_O    Versions 6 and 7, for routine calls ... or 4P + 8S_O    Versions 6 and 7, for print_paddr
     } else if (GState->header.version <= 8) {
-        return (GState->story + (addr * 8));
+        return addr * 8;
     }
 
     GState->die("FIXME Unsupported version for packed addressing");
-    return NULL;
+    return 0;
+}
+
+// every change to bp goes through here, so locals always points at the frame's first local.
+static inline void setFrame(const uint16 bp)
+{
+    GState->bp = bp;
+    GState->locals = GState->stack + bp;
 }
 
 static uint8 *varAddress(const uint8 var, const int writing, const int indirect)
@@ -185,30 +489,45 @@ static uint8 *varAddress(const uint8 var, const int writing, const int indirect)
             return (uint8 *) --GState->sp;
         }
     } else if ((var >= 0x1) && (var <= 0xF)) {  // local var.
-        if (GState->stack[GState->bp-1] <= (var-1)) {
-            GState->die("referenced unallocated local var #%u (%u available)", (unsigned int) (var-1), (unsigned int) GState->stack[GState->bp-1]);
+        if (GState->locals[-1] <= (var-1)) {  // the frame's numlocals.
+            GState->die("referenced unallocated local var #%u (%u available)", (unsigned int) (var-1), (unsigned int) GState->locals[-1]);
         }
-        return (uint8 *) &GState->stack[GState->bp + (var-1)];
+        return (uint8 *) (GState->locals + (var-1));
     }
 
     // else, global var
     FIXME("check for overflow, etc");
-    return (GState->story + GState->header.globals_addr) + ((var-0x10) * sizeof (uint16));
+    return GState->globals + ((var-0x10) * sizeof (uint16));
+}
+
+// Stores an instruction's result. Globals and locals, which nearly all of
+//  them are, are written in place here; only the stack needs varAddress.
+static inline void storeVariable(const uint8 var, const uint16 val)
+{
+    uint8 *ptr;
+    if (var >= 0x10) {
+        ptr = GState->globals + ((var-0x10) * sizeof (uint16));
+    } else if ((var != 0) && (GState->locals[-1] >= var)) {
+        ptr = (uint8 *) (GState->locals + (var-1));
+    } else {  // the stack, or an unallocated local, which dies.
+        ptr = varAddress(var, 1, 0);
+    }
+    ptr[0] = (uint8) (val >> 8);
+    ptr[1] = (uint8) (val & 0xFF);
 }
 
 static void opcode_call(void)
 {
     uint8 args = GState->operand_count;
     const uint16 *operands = GState->operands;
-    const uint8 storeid = *(GState->pc++);
+    const uint8 storeid = readPC8();
     // no idea if args==0 should be the same as calling addr 0...
     if ((args == 0) || (operands[0] == 0)) {  // legal no-op; store 0 to return value and bounce.
-        uint8 *store = varAddress(storeid, 1, 0);
-        WRITEUI16(store, 0);
+        storeVariable(storeid, 0);
     } else {
-        const uint8 *routine = unpackAddress(operands[0]);
-        GState->logical_pc = (uint32) (routine - GState->story);
-        const uint8 numlocals = *(routine++);
+        uint32 routine = unpackAddress(operands[0]);
+        GState->logical_pc = routine;
+        const uint8 numlocals = readStory8(routine++);
         if (numlocals > 15) {
             GState->die("Routine has too many local variables (%u)", numlocals);
         }
@@ -218,19 +537,20 @@ static void opcode_call(void)
         *(GState->sp++) = (uint16) storeid;  // save where we should store the call's result.
 
         // next instruction to run upon return.
-        const uint32 pcoffset = (uint32) (GState->pc - GState->story);
+        const uint32 pcoffset = GState->pc;
         *(GState->sp++) = (pcoffset & 0xFFFF);
         *(GState->sp++) = ((pcoffset >> 16) & 0xFFFF);
 
         *(GState->sp++) = GState->bp;  // current base pointer before the call.
         *(GState->sp++) = numlocals;  // number of locals we're allocating.
 
-        GState->bp = (uint16) (GState->sp-GState->stack);
+        setFrame((uint16) (GState->sp-GState->stack));
 
         sint8 i;
         if (GState->header.version <= 4) {
             for (i = 0; i < numlocals; i++, routine += sizeof (uint16)) {
-                *(GState->sp++) = *((uint16 *) routine);  // leave it byteswapped when moving to the stack.
+                uint8 *local = (uint8 *) GState->sp++;
+                WRITEUI16(local, readStory16(routine));  // the stack holds everything bigendian, like the story.
             }
         } else {
             for (i = 0; i < numlocals; i++) {
@@ -244,7 +564,7 @@ static void opcode_call(void)
         }
 
         const uint16 *src = operands + 1;
-        uint8 *dst = (uint8 *) (GState->stack + GState->bp);
+        uint8 *dst = (uint8 *) GState->locals;
         for (i = 0; i < args; i++) {
             WRITEUI16(dst, src[i]);
         }
@@ -261,22 +581,21 @@ static void doReturn(const uint16 val)
         GState->die("Stack underflow in return operation");
 
     dbg("popping stack for return\n");
-    dbg("returning: initial pc=%X, bp=%u, sp=%u\n", (unsigned int) (GState->pc-GState->story), (unsigned int) GState->bp, (unsigned int) (GState->sp-GState->stack));
+    dbg("returning: initial pc=%X, bp=%u, sp=%u\n", (unsigned int) GState->pc, (unsigned int) GState->bp, (unsigned int) (GState->sp-GState->stack));
 
     GState->sp = GState->stack + GState->bp;  // this dumps all the locals and data pushed on the stack during the routine.
     GState->sp--;  // dump our copy of numlocals
-    GState->bp = *(--GState->sp);  // restore previous frame's base pointer, dump it from the stack.
+    setFrame(*(--GState->sp));  // restore previous frame's base pointer, dump it from the stack.
 
     GState->sp -= 2;  // point to start of our saved program counter.
     const uint32 pcoffset = ((uint32) GState->sp[0]) | (((uint32) GState->sp[1]) << 16);
 
-    GState->pc = GState->story + pcoffset;  // next instruction is one following our original call.
+    GState->pc = pcoffset;  // next instruction is one following our original call.
 
     const uint8 storeid = (uint8) *(--GState->sp);  // pop the result storage location.
 
-    dbg("returning: new pc=%X, bp=%u, sp=%u\n", (unsigned int) (GState->pc-GState->story), (unsigned int) GState->bp, (unsigned int) (GState->sp-GState->stack));
-    uint8 *store = varAddress(storeid, 1, 0);  // and store the routine result.
-    WRITEUI16(store, val);
+    dbg("returning: new pc=%X, bp=%u, sp=%u\n", (unsigned int) GState->pc, (unsigned int) GState->bp, (unsigned int) (GState->sp-GState->stack));
+    storeVariable(storeid, val);  // and store the routine result.
 }
 
 static void opcode_ret(void)
@@ -329,25 +648,23 @@ static void opcode_show_status(void)
 
 static void opcode_add(void)
 {
-    uint8 *store = varAddress(*(GState->pc++), 1, 0);
     const sint16 result = ((sint16) GState->operands[0]) + ((sint16) GState->operands[1]);
-    WRITEUI16(store, result);
+    storeVariable(readPC8(), result);
 }
 
 static void opcode_sub(void)
 {
-    uint8 *store = varAddress(*(GState->pc++), 1, 0);
     const sint16 result = ((sint16) GState->operands[0]) - ((sint16) GState->operands[1]);
-    WRITEUI16(store, result);
+    storeVariable(readPC8(), result);
 }
 
 static void doBranch(int truth)
 {
-    const uint8 branch = *(GState->pc++);
+    const uint8 branch = readPC8();
     const int farjump = (branch & (1<<6)) == 0;
     const int onTruth = (branch & (1<<7)) ? 1 : 0;
 
-    const uint8 byte2 = farjump ? *(GState->pc++) : 0;
+    const uint8 byte2 = farjump ? readPC8() : 0;
 
     if (truth == onTruth) {  // take the branch?
         sint16 offset = (sint16) (branch & 0x3F);
@@ -410,50 +727,44 @@ static void opcode_jump(void)
 
 static void opcode_div(void)
 {
-    uint8 *store = varAddress(*(GState->pc++), 1, 0);
     if (GState->operands[1] == 0) {
         GState->die("Division by zero");
     }
     const uint16 result = (uint16) (((sint16) GState->operands[0]) / ((sint16) GState->operands[1]));
-    WRITEUI16(store, result);
+    storeVariable(readPC8(), result);
 }
 
 static void opcode_mod(void)
 {
-    uint8 *store = varAddress(*(GState->pc++), 1, 0);
     if (GState->operands[1] == 0) {
         GState->die("Division by zero");
     }
     const uint16 result = (uint16) (((sint16) GState->operands[0]) % ((sint16) GState->operands[1]));
-    WRITEUI16(store, result);
+    storeVariable(readPC8(), result);
 }
 
 static void opcode_mul(void)
 {
-    uint8 *store = varAddress(*(GState->pc++), 1, 0);
     const uint16 result = (uint16) (((sint16) GState->operands[0]) * ((sint16) GState->operands[1]));
-    WRITEUI16(store, result);
+    storeVariable(readPC8(), result);
 }
 
 static void opcode_or(void)
 {
-    uint8 *store = varAddress(*(GState->pc++), 1, 0);
     const uint16 result = (GState->operands[0] | GState->operands[1]);
-    WRITEUI16(store, result);
+    storeVariable(readPC8(), result);
 }
 
 static void opcode_and(void)
 {
-    uint8 *store = varAddress(*(GState->pc++), 1, 0);
     const uint16 result = (GState->operands[0] & GState->operands[1]);
-    WRITEUI16(store, result);
+    storeVariable(readPC8(), result);
 }
 
 static void opcode_not(void)
 {
-    uint8 *store = varAddress(*(GState->pc++), 1, 0);
     const uint16 result = ~GState->operands[0];
-    WRITEUI16(store, result);
+    storeVariable(readPC8(), result);
 }
 
 static void opcode_inc_chk(void)
@@ -498,31 +809,30 @@ static void opcode_load(void)
 {
     const uint8 *valptr = varAddress((uint8) (GState->operands[0] & 0xFF), 0, 1);
     const uint16 val = READUI16(valptr);
-    uint8 *store = varAddress(*(GState->pc++), 1, 0);
-    WRITEUI16(store, val);
+    storeVariable(readPC8(), val);
 }
 
 static void opcode_loadw(void)
 {
-    uint16 *store = (uint16 *) varAddress(*(GState->pc++), 1, 0);
     FIXME("can only read from dynamic or static memory (not highmem).");
     FIXME("how does overflow work here? Do these wrap around?");
     const uint16 offset = (GState->operands[0] + (GState->operands[1] * 2));
-    const uint16 *src = (const uint16 *) get_virtualized_mem_ptr(offset);
-    *store = *src;  // copy from bigendian to bigendian: no byteswap.
+    const uint16 value = (((uint16) readMemory8(offset)) << 8) | ((uint16) readMemory8(offset + 1));
+    storeVariable(readPC8(), value);
 }
 
 static void opcode_loadb(void)
 {
-    uint8 *store = varAddress(*(GState->pc++), 1, 0);
     FIXME("can only read from dynamic or static memory (not highmem).");
     FIXME("how does overflow work here? Do these wrap around?");
     const uint16 offset = (GState->operands[0] + GState->operands[1]);
-    const uint8 *src = get_virtualized_mem_ptr(offset);
-    const uint16 value = *src;  // expand out to 16-bit before storing.
-    WRITEUI16(store, value);
+    const uint16 value = readMemory8(offset);  // expand out to 16-bit before storing.
+    storeVariable(readPC8(), value);
 }
 
+static void forgetShortNames(const uint32 addr, const uint32 len);
+static void forgetObjectLayoutWrite(const uint32 addr, const uint32 len);
+
 static void opcode_storew(void)
 {
     FIXME("can only write to dynamic memory.");
@@ -531,6 +841,8 @@ static void opcode_storew(void)
     uint8 *dst = get_virtualized_mem_ptr(offset);
     const uint16 src = GState->operands[2];
     WRITEUI16(dst, src);
+    forgetShortNames(offset, 2);
+    forgetObjectLayoutWrite(offset, 2);
 }
 
 static void opcode_storeb(void)
@@ -541,6 +853,8 @@ static void opcode_storeb(void)
     uint8 *dst = get_virtualized_mem_ptr(offset);
     const uint8 src = (uint8) GState->operands[2];
     *dst = src;
+    forgetShortNames(offset, 1);
+    forgetObjectLayoutWrite(offset, 1);
 }
 
 static void opcode_store(void)
@@ -550,8 +864,81 @@ static void opcode_store(void)
     WRITEUI16(store, src);
 }
 
+// Objects. Scope loops run test_attr, jin, get_sibling and get_prop on the
+//  same few objects over and over, so every object's entry offset is worked
+//  out once when the story loads, not with a multiply each time, and where
+//  an object's properties start is kept the first time it's asked for, as is
+//  where each property it's asked for lives (or that it has none) in a small
+//  direct-mapped cache: a repeated get_prop is then one probe, not a walk.
+//  Moving objects and put_prop change none of that, so the caches only forget
+//  when storew or storeb write over the bytes they were worked out from, or
+//  a restore overwrites everything.
+#ifndef MOJOZORK_PROP_CACHE_ENTRIES
+#define MOJOZORK_PROP_CACHE_ENTRIES 64
+#endif
+
+#if (MOJOZORK_PROP_CACHE_ENTRIES < 1) || (MOJOZORK_PROP_CACHE_ENTRIES > 256) || (MOJOZORK_PROP_CACHE_ENTRIES & (MOJOZORK_PROP_CACHE_ENTRIES - 1))
+#error MOJOZORK_PROP_CACHE_ENTRIES must be a power of two, up to 256.
+#endif
+
 static uint8 *getObjectPtr(const uint16 objid);
-#ifndef MULTIZORK
+#ifdef MULTIZORK  // the host remaps objects, per player.
+static void initObjectTable(void) {}
+static void forgetObjectLayout(void) {}
+static void forgetObjectLayoutWrite(const uint32 addr, const uint32 len) { (void) addr; (void) len; }
+#else
+typedef struct
+{
+    uint8 objid;  // 0 if the slot is empty.
+    uint8 propid;
+    uint8 size;  // 0 if the object has no such property.
+    uint16 offset;  // story offset of the property's data.
+} PropCacheEntry;
+
+static uint16 object_offset[256];  // story offset of each object's entry, by id.
+static uint16 object_props[256];  // story offset of each object's first property, 0 if not looked up yet.
+static PropCacheEntry prop_cache[MOJOZORK_PROP_CACHE_ENTRIES];
+static uint16 object_layout_start = 0xFFFF;  // the story bytes the caches were worked out from, if any.
+static uint16 object_layout_end = 0;
+
+static void forgetObjectLayout(void)
+{
+    memset(object_props, '\0', sizeof (object_props));
+    memset(prop_cache, '\0', sizeof (prop_cache));
+    object_layout_start = 0xFFFF;
+    object_layout_end = 0;
+}
+
+static void initObjectTable(void)
+{
+    uint16 offset = GState->header.objtab_addr + (31 * sizeof (uint16));  // skip properties defaults table
+    uint16 i;
+    for (i = 1; i < 256; i++) {
+        object_offset[i] = offset;
+        offset += 9;
+    }
+    forgetObjectLayout();
+}
+
+// the caches now depend on len bytes of story at addr.
+static void noteObjectLayout(const uint16 addr, const uint16 len)
+{
+    if (addr < object_layout_start) {
+        object_layout_start = addr;
+    }
+    if ((addr + len) > object_layout_end) {
+        object_layout_end = addr + len;
+    }
+}
+
+// forget the caches if a write of len bytes at addr could change what they hold.
+static void forgetObjectLayoutWrite(const uint32 addr, const uint32 len)
+{
+    if ((addr < object_layout_end) && (object_layout_start < (addr + len))) {
+        forgetObjectLayout();
+    }
+}
+
 static uint8 *getObjectPtr(const uint16 objid)
 {
     if (objid == 0) {
@@ -562,10 +949,7 @@ static uint8 *getObjectPtr(const uint16 objid)
         GState->die("Invalid object id referenced");
     }
 
-    uint8 *ptr = GState->story + GState->header.objtab_addr;
-    ptr += 31 * sizeof (uint16);  // skip properties defaults table
-    ptr += 9 * (objid-1);  // find object in object table
-    return ptr;
+    return GState->story + object_offset[objid];
 }
 #endif
 
@@ -678,53 +1062,100 @@ static void opcode_remove_obj(void)
 
 static uint8 *getObjectProperty(const uint16 objid, const uint32 propid, uint8 *_size);
 #ifndef MULTIZORK
+// story offset of the first of an object's properties, past its name.
+static uint16 getObjectProperties(const uint16 objid)
+{
+    uint16 props = object_props[objid];
+    if (!props) {
+        const uint16 entry = object_offset[objid];
+        const uint8 *ptr = GState->story + entry + 7;  // skip to properties address field.
+        const uint16 addr = READUI16(ptr);
+        props = addr + (GState->story[addr] * 2) + 1;  // skip object name to start of properties.
+        noteObjectLayout(entry + 7, 2);
+        noteObjectLayout(addr, 1);
+        object_props[objid] = props;
+    }
+    return props;
+}
+
 static uint8 *getObjectProperty(const uint16 objid, const uint32 propid, uint8 *_size)
 {
-    uint8 *ptr = getObjectPtr(objid);
+    getObjectPtr(objid);  // just to check objid.
 
-    if (GState->header.version <= 3) {
-        ptr += 7;  // skip to properties address field.
-        const uint16 addr = READUI16(ptr);
-        ptr = GState->story + addr;
-        ptr += (*ptr * 2) + 1;  // skip object name to start of properties.
-        while (1) {
-            const uint8 info = *(ptr++);
-            const uint16 num = (info & 0x1F);  // 5 bits for the prop id.
-            const uint8 size = ((info >> 5) & 0x7) + 1; // 3 bits for prop size.
-            // these go in descending numeric order, and should fail
-            //  the interpreter if missing. We use 0xFFFFFFFF internally to mean "first property".
-            if ((num == propid) || (propid == 0xFFFFFFFF)) {  // found it?
-                if (_size) {
-                    *_size = size;
-                }
-                return ptr;
-            } else if (num < propid) {  // we're past it.
-                break;
+    if (GState->header.version > 3) {
+        GState->die("write me");
+        return NULL;
+    }
+
+    const uint16 props = getObjectProperties(objid);
+    uint8 *ptr = GState->story + props;
+    if (propid == 0xFFFFFFFF) {  // We use 0xFFFFFFFF internally to mean "first property".
+        if (_size) {
+            *_size = ((*ptr >> 5) & 0x7) + 1;
+        }
+        return ptr + 1;
+    }
+
+    PropCacheEntry *cached = NULL;
+    if (propid <= 0x1F) {  // v3 properties are 1 to 31.
+        cached = &prop_cache[((objid << 2) ^ propid) & (MOJOZORK_PROP_CACHE_ENTRIES - 1)];
+        if ((cached->objid == objid) && (cached->propid == propid)) {
+            if (!cached->size) {
+                return NULL;
+            } else if (_size) {
+                *_size = cached->size;
             }
+            return GState->story + cached->offset;
+        }
+    }
 
-            ptr += size;  // try the next property.
+    uint8 *found = NULL;
+    uint8 size = 0;
+    while (1) {
+        const uint8 info = *(ptr++);
+        const uint16 num = (info & 0x1F);  // 5 bits for the prop id.
+        size = ((info >> 5) & 0x7) + 1; // 3 bits for prop size.
+        // these go in descending numeric order, and should fail
+        //  the interpreter if missing.
+        if (num == propid) {  // found it?
+            found = ptr;
+            break;
+        } else if (num < propid) {  // we're past it.
+            size = 0;
+            break;
         }
-    } else {
-        GState->die("write me");
+
+        ptr += size;  // try the next property.
+    }
+
+    noteObjectLayout(props, (uint16) (ptr - (GState->story + props)));
+    if (cached) {
+        cached->objid = (uint8) objid;
+        cached->propid = (uint8) propid;
+        cached->size = size;
+        cached->offset = found ? (uint16) (found - GState->story) : 0;
     }
 
-    return NULL;
+    if (found && _size) {
+        *_size = size;
+    }
+    return found;
 }
 #endif
 
-// this returns the zscii string for the object!
-static const uint8 *getObjectShortName(const uint16 objid)
+// this returns the address of the zscii string for the object!
+static uint32 getObjectShortName(const uint16 objid)
 {
     const uint8 *ptr = getObjectPtr(objid);
     if (GState->header.version <= 3) {
         ptr += 7;  // skip to properties address field.
         const uint16 addr = READUI16(ptr);
-        return GState->story + addr + 1;  // +1 to skip z-char count.
+        return ((uint32) addr) + 1;  // +1 to skip z-char count.
     } else {
         GState->die("write me");
     }
 
-    return NULL;
+    return 0;
 }
 
 static void opcode_put_prop(void)
@@ -737,7 +1168,10 @@ static void opcode_put_prop(void)
 
     if (!ptr) {
         GState->die("Lookup on missing object property (obj=%X, prop=%X)", (unsigned int) objid, (unsigned int) propid);
-    } else if (size == 1) {
+    }
+
+    forgetShortNames((uint32) (ptr - GState->story), size);
+    if (size == 1) {
         *ptr = (value & 0xFF);
     } else {
         WRITEUI16(ptr, value);
@@ -760,7 +1194,6 @@ static uint16 getDefaultObjectProperty(const uint16 propid)
 
 static void opcode_get_prop(void)
 {
-    uint8 *store = varAddress(*(GState->pc++), 1, 0);
     const uint16 objid = GState->operands[0];
     const uint16 propid = GState->operands[1];
     uint16 result = 0;
@@ -775,22 +1208,20 @@ static void opcode_get_prop(void)
         result = READUI16(ptr);
     }
 
-    WRITEUI16(store, result);
+    storeVariable(readPC8(), result);
 }
 
 static void opcode_get_prop_addr(void)
 {
-    uint8 *store = varAddress(*(GState->pc++), 1, 0);
     const uint16 objid = GState->operands[0];
     const uint16 propid = GState->operands[1];
     uint8 *ptr = getObjectProperty(objid, propid, NULL);
     const uint16 result = ptr ? ((uint16) (ptr-GState->story)) : 0;
-    WRITEUI16(store, result);
+    storeVariable(readPC8(), result);
 }
 
 static void opcode_get_prop_len(void)
 {
-    uint8 *store = varAddress(*(GState->pc++), 1, 0);
     uint16 result;
 
     if (GState->operands[0] == 0) {
@@ -804,12 +1235,11 @@ static void opcode_get_prop_len(void)
         GState->die("write me");
     }
 
-    WRITEUI16(store, result);
+    storeVariable(readPC8(), result);
 }
 
 static void opcode_get_next_prop(void)
 {
-    uint8 *store = varAddress(*(GState->pc++), 1, 0);
     const uint16 objid = GState->operands[0];
     const int firstProp = (GState->operands[1] == 0);
     uint16 result = 0;
@@ -823,7 +1253,7 @@ static void opcode_get_next_prop(void)
     } else {
         GState->die("write me");
     }
-    WRITEUI16(store, result);
+    storeVariable(readPC8(), result);
 }
 
 static void opcode_jin(void)
@@ -857,30 +1287,27 @@ static uint16 getObjectRelationship(const uint16 objid, const uint8 relationship
 
 static void opcode_get_parent(void)
 {
-    uint8 *store = varAddress(*(GState->pc++), 1, 0);
     const uint16 result = getObjectRelationship(GState->operands[0], 4);
-    WRITEUI16(store, result);
+    storeVariable(readPC8(), result);
 }
 
 static void opcode_get_sibling(void)
 {
-    uint8 *store = varAddress(*(GState->pc++), 1, 0);
     const uint16 result = getObjectRelationship(GState->operands[0], 5);
-    WRITEUI16(store, result);
+    storeVariable(readPC8(), result);
     doBranch((result != 0) ? 1: 0);
 }
 
 static void opcode_get_child(void)
 {
-    uint8 *store = varAddress(*(GState->pc++), 1, 0);
     const uint16 result = getObjectRelationship(GState->operands[0], 6);
-    WRITEUI16(store, result);
+    storeVariable(readPC8(), result);
     doBranch((result != 0) ? 1: 0);
 }
 
 static void opcode_new_line(void)
 {
-    GState->writestr("\n", 1);
+    writeOutput("\n", 1);
 }
 
 static char decode_zscii_char(const uint16 val)
@@ -904,12 +1331,105 @@ static char decode_zscii_char(const uint16 val)
     return ch;
 }
 
-static uintptr decode_zscii(const uint8 *_str, const int abbr, char *buf, uintptr *_buflen)
+// Decoded-string caches. Abbreviations, which common words are made of, are
+//  decoded once, the first time they come up, into a pool of
+//  MOJOZORK_ABBR_CACHE_BYTES, and copied out from there afterwards. Object
+//  short names, which print_obj prints over and over, are kept in a few slots
+//  as they come up. The names live in dynamic memory, so storew, storeb and
+//  put_prop drop any slot they write over, and restore drops them all.
+#ifndef MOJOZORK_ABBR_CACHE_BYTES
+#define MOJOZORK_ABBR_CACHE_BYTES 1024
+#endif
+#ifndef MOJOZORK_NAME_CACHE_ENTRIES
+#define MOJOZORK_NAME_CACHE_ENTRIES 8
+#endif
+#define NAME_CACHE_CHARS 31  // longer names are decoded every time.
+
+#if (MOJOZORK_NAME_CACHE_ENTRIES < 1) || (MOJOZORK_NAME_CACHE_ENTRIES > 255)
+#error MOJOZORK_NAME_CACHE_ENTRIES must be between 1 and 255.
+#endif
+
+#define ABBR_UNSEEN 0xFFFF  // not decoded yet.
+#define ABBR_UNCACHED 0xFFFE  // didn't fit in the pool; decoded every time.
+
+static char abbr_cache[MOJOZORK_ABBR_CACHE_BYTES];
+static uint16 abbr_cache_used = 0;
+static uint16 abbr_cache_offset[96];  // where each abbreviation starts in abbr_cache, or ABBR_UNSEEN/ABBR_UNCACHED.
+static uint8 abbr_cache_len[96];
+
+typedef struct
+{
+    uint16 addr;  // story address of the encoded name, 0 if the slot is empty.
+    uint8 encoded_len;  // bytes of story it was decoded from.
+    uint8 len;
+    char str[NAME_CACHE_CHARS];
+} ShortNameCacheEntry;
+
+static ShortNameCacheEntry name_cache[MOJOZORK_NAME_CACHE_ENTRIES];
+static uint8 name_cache_next = 0;  // the slot the next new name replaces, round robin.
+
+static void resetShortNameCache(void)
+{
+    memset(name_cache, '\0', sizeof (name_cache));
+    name_cache_next = 0;
+}
+
+static void resetZsciiCache(void)
+{
+    uint8 i;
+    for (i = 0; i < 96; i++) {
+        abbr_cache_offset[i] = ABBR_UNSEEN;
+    }
+    abbr_cache_used = 0;
+    resetShortNameCache();
+}
+
+// drop any cached name a write of len bytes at addr changes.
+static void forgetShortNames(const uint32 addr, const uint32 len)
+{
+    uint8 i;
+    for (i = 0; i < MOJOZORK_NAME_CACHE_ENTRIES; i++) {
+        ShortNameCacheEntry *entry = &name_cache[i];
+        if (entry->addr && (addr < (((uint32) entry->addr) + entry->encoded_len)) && (entry->addr < (addr + len))) {
+            entry->addr = 0;
+        }
+    }
+}
+
+static uintptr decode_zscii(const uint32 _str, const int abbr, char *buf, uintptr *_buflen);
+
+// decode abbreviation index as decode_zscii would, through the cache.
+static void decodeAbbreviation(const uintptr index, char *buf, uintptr *_buflen)
+{
+    const uint32 addr = ((uint32) readStory16(GState->header.abbrtab_addr + (index * sizeof (uint16)))) * sizeof (uint16);
+
+    if (abbr_cache_offset[index] == ABBR_UNSEEN) {
+        uintptr decoded_chars = MOJOZORK_ABBR_CACHE_BYTES - abbr_cache_used;
+        decode_zscii(addr, 1, abbr_cache + abbr_cache_used, &decoded_chars);
+        if ((decoded_chars <= (uintptr) (MOJOZORK_ABBR_CACHE_BYTES - abbr_cache_used)) && (decoded_chars <= 255)) {
+            abbr_cache_offset[index] = abbr_cache_used;
+            abbr_cache_len[index] = (uint8) decoded_chars;
+            abbr_cache_used += (uint16) decoded_chars;
+        } else {
+            abbr_cache_offset[index] = ABBR_UNCACHED;
+        }
+    }
+
+    if (abbr_cache_offset[index] == ABBR_UNCACHED) {
+        decode_zscii(addr, 1, buf, _buflen);
+    } else {
+        const uintptr len = abbr_cache_len[index];
+        memcpy(buf, abbr_cache + abbr_cache_offset[index], (*_buflen < len) ? *_buflen : len);
+        *_buflen = len;
+    }
+}
+
+static uintptr decode_zscii(const uint32 _str, const int abbr, char *buf, uintptr *_buflen)
 {
     // ZCSII encoding is so nasty.
     uintptr buflen = *_buflen;
     uintptr decoded_chars = 0;
-    const uint8 *str = _str;
+    uint32 str = _str;
     uint16 code = 0;
     uint8 alphabet = 0;
     uint8 useAbbrTable = 0;
@@ -917,7 +1437,8 @@ static uintptr decode_zscii(const uint8 *_str, const int abbr, char *buf, uintpt
     uint16 zscii_code = 0;
 
     do {
-        code = READUI16(str);
+        code = readStory16(str);
+        str += sizeof (uint16);
 
         // characters are 5 bits each, packed three to a 16-bit word.
         sint8 i;
@@ -953,10 +1474,8 @@ static uintptr decode_zscii(const uint8 *_str, const int abbr, char *buf, uintpt
                 }
                 //FIXME("Make sure offset is sane");
                 const uintptr index = ((32 * (((uintptr) useAbbrTable) - 1)) + (uintptr) ch);
-                const uint8 *ptr = (GState->story + GState->header.abbrtab_addr) + (index * sizeof (uint16));
-                const uint16 abbraddr = READUI16(ptr);
                 uintptr abbr_decoded_chars = buflen;
-                decode_zscii(GState->story + (abbraddr * sizeof (uint16)), 1, buf, &abbr_decoded_chars);
+                decodeAbbreviation(index, buf, &abbr_decoded_chars);
                 decoded_chars += abbr_decoded_chars;
                 buf += (buflen < abbr_decoded_chars) ? buflen : abbr_decoded_chars;
                 buflen = (buflen < abbr_decoded_chars) ? 0 : (buflen - abbr_decoded_chars);
@@ -1023,10 +1542,10 @@ static uintptr decode_zscii(const uint8 *_str, const int abbr, char *buf, uintpt
     } while ((code & (1<<15)) == 0);
 
     *_buflen = decoded_chars;
-    return str - _str;
+    return (uintptr) (str - _str);
 }
 
-static uintptr print_zscii(const uint8 *_str, const int abbr)
+static uintptr print_zscii(const uint32 _str, const int abbr)
 {
     char buf[512];
     char *ptr = buf;
@@ -1040,7 +1559,7 @@ static uintptr print_zscii(const uint8 *_str, const int abbr)
         retval = decode_zscii(_str, abbr, ptr, &decoded_chars);
     }
 
-    GState->writestr(ptr, decoded_chars);
+    writeOutput(ptr, decoded_chars);
 
     if (ptr != buf) {
         free(ptr);
@@ -1049,6 +1568,35 @@ static uintptr print_zscii(const uint8 *_str, const int abbr)
     return retval;
 }
 
+#ifndef MULTIZORK  // each player's dynamic memory, names included, is their own, so no cache.
+// print_zscii for an object's short name at addr, through the name cache.
+static void printShortName(const uint32 addr)
+{
+    uint8 i;
+    for (i = 0; i < MOJOZORK_NAME_CACHE_ENTRIES; i++) {
+        if (name_cache[i].addr == addr) {
+            writeOutput(name_cache[i].str, name_cache[i].len);
+            return;
+        }
+    }
+
+    ShortNameCacheEntry *entry = &name_cache[name_cache_next];
+    uintptr decoded_chars = sizeof (entry->str);
+    const uintptr encoded_len = decode_zscii(addr, 0, entry->str, &decoded_chars);
+    if ((decoded_chars > sizeof (entry->str)) || (encoded_len > 255)) {
+        entry->addr = 0;  // too long to keep.
+        print_zscii(addr, 0);
+        return;
+    }
+
+    entry->addr = (uint16) addr;
+    entry->encoded_len = (uint8) encoded_len;
+    entry->len = (uint8) decoded_chars;
+    name_cache_next = (name_cache_next + 1) % MOJOZORK_NAME_CACHE_ENTRIES;
+    writeOutput(entry->str, entry->len);
+}
+#endif
+
 static void opcode_print(void)
 {
     GState->pc += print_zscii(GState->pc, 0);
@@ -1058,21 +1606,21 @@ static void opcode_print_num(void)
 {
     char buf[32];
     const int slen = (int) snprintf(buf, sizeof (buf), "%d", (int) ((sint16) GState->operands[0]));
-    GState->writestr(buf, slen);
+    writeOutput(buf, slen);
 }
 
 static void opcode_print_char(void)
 {
     const char ch = decode_zscii_char(GState->operands[0]);
     if (ch) {
-        GState->writestr(&ch, 1);
+        writeOutput(&ch, 1);
     }
 }
 
 static void opcode_print_ret(void)
 {
     GState->pc += print_zscii(GState->pc, 0);
-    GState->writestr("\n", 1);
+    writeOutput("\n", 1);
     doReturn(1);
 }
 
@@ -1082,7 +1630,11 @@ static void opcode_print_obj(void)
     if (GState->header.version <= 3) {
         ptr += 7;  // skip to properties field.
         const uint16 addr = READUI16(ptr);  // dereference to get to property table.
-        print_zscii(GState->story + addr + 1, 0);
+        #ifdef MULTIZORK
+        print_zscii(((uint32) addr) + 1, 0);
+        #else
+        printShortName(((uint32) addr) + 1);
+        #endif
     } else {
         GState->die("write me");
     }
@@ -1090,7 +1642,7 @@ static void opcode_print_obj(void)
 
 static void opcode_print_addr(void)
 {
-    print_zscii(GState->story + GState->operands[0], 0);
+    print_zscii(GState->operands[0], 0);
 }
 
 static void opcode_print_paddr(void)
@@ -1125,10 +1677,22 @@ static uint16 doRandom(const sint16 range)
 
 static void opcode_random(void)
 {
-    uint8 *store = varAddress(*(GState->pc++), 1, 0);
     const sint16 range = (sint16) GState->operands[0];
     const uint16 result = doRandom(range);
-    WRITEUI16(store, result);
+    storeVariable(readPC8(), result);
+}
+
+// compare an encoded word to a dictionary entry's: <0, 0 or >0, as the word sorts before, the same as or after it.
+static int compareDictionaryEntry(const uint16 *encoded, const uint8 numwords, const uint32 entry)
+{
+    uint8 i;
+    for (i = 0; i < numwords; i++) {
+        const uint16 zscii = readStory16(entry + (i * sizeof (uint16)));
+        if (encoded[i] != zscii) {
+            return (encoded[i] < zscii) ? -1 : 1;
+        }
+    }
+    return 0;
 }
 
 static void tokenizeUserInput(void)
@@ -1139,11 +1703,11 @@ static void tokenizeUserInput(void)
     const uint8 *input = GState->story + GState->operands[0];
     uint8 *parse = GState->story + GState->operands[1];
     const uint8 parselen = *(parse++);
-    const uint8 *seps = GState->story + GState->header.dict_addr;
-    const uint8 numseps = *(seps++);
-    const uint8 *dict = seps + numseps;
-    const uint8 entrylen = *(dict++);
-    const uint16 numentries = READUI16(dict);
+    const uint8 numseps = readStory8(GState->header.dict_addr);
+    const uint32 seps = GState->header.dict_addr + 1;
+    const uint8 entrylen = readStory8(seps + numseps);
+    const uint16 numentries = readStory16(seps + numseps + 1);
+    const uint32 dict = seps + numseps + 3;
     uint8 numtoks = 0;
 
     input++;  // skip over inputlen byte; we checked this and capped input elsewhere.
@@ -1160,7 +1724,7 @@ static void tokenizeUserInput(void)
             uint8 i;
             for (i = 0; i < numseps; i++)
             {
-                if (ch == seps[i])
+                if (ch == readStory8(seps + i))
                 {
                     isSep = 1;
                     break;
@@ -1205,46 +1769,49 @@ static void tokenizeUserInput(void)
             encoded[1] |= ((pos < zchidx) ? zchars[pos++] : 5) << 5;
             encoded[1] |= ((pos < zchidx) ? zchars[pos++] : 5) << 0;
 
-            FIXME("this can binary search, since we know how many equal-sized records there are.");
-            const uint8 *dictptr = dict;
-            uint16 i;
+            uint8 numwords = 2;
             if (GState->header.version <= 3) {
                 encoded[1] |= 0x8000;
-
-                FIXME("byteswap 'encoded' and just memcmp here.");
-                for (i = 0; i < numentries; i++) {
-                    const uint16 zscii1 = READUI16(dictptr);
-                    const uint16 zscii2 = READUI16(dictptr);
-                    if ((encoded[0] == zscii1) && (encoded[1] == zscii2)) {
-                        dictptr -= sizeof (uint16) * 2;
-                        break;
-                    }
-                    dictptr += (entrylen - 4);
-                }
             } else {
                 encoded[2] |= ((pos < zchidx) ? zchars[pos++] : 5) << 10;
                 encoded[2] |= ((pos < zchidx) ? zchars[pos++] : 5) << 5;
                 encoded[2] |= ((pos < zchidx) ? zchars[pos++] : 5) << 0;
                 encoded[2] |= 0x8000;
+                numwords = 3;
+            }
 
-                FIXME("byteswap 'encoded' and just memcmp here.");
-                for (i = 0; i < numentries; i++) {
-                    const uint16 zscii1 = READUI16(dictptr);
-                    const uint16 zscii2 = READUI16(dictptr);
-                    const uint16 zscii3 = READUI16(dictptr);
-                    if ((encoded[0] == zscii1) && (encoded[1] == zscii2) && (encoded[2] == zscii3)) {
-                        dictptr -= sizeof (uint16) * 3;
+            uint32 dictptr = 0;  // not found.
+            if (((sint16) numentries) > 0) {
+                // the entries are sorted by their encoded words, read as unsigned numbers, so binary search
+                //  for the first one that isn't less than ours; a few games list a word twice, and we want
+                //  the first.
+                uint16 lo = 0;
+                uint16 hi = numentries;
+                while (lo < hi) {
+                    const uint16 mid = lo + ((hi - lo) / 2);
+                    if (compareDictionaryEntry(encoded, numwords, dict + (((uint32) mid) * entrylen)) > 0) {
+                        lo = mid + 1;
+                    } else {
+                        hi = mid;
+                    }
+                }
+                const uint32 entry = dict + (((uint32) lo) * entrylen);
+                if ((lo < numentries) && (compareDictionaryEntry(encoded, numwords, entry) == 0)) {
+                    dictptr = entry;
+                }
+            } else {  // a negative count means -count entries, unsorted.
+                const uint16 count = (uint16) -((sint16) numentries);
+                uint32 entry = dict;
+                uint16 i;
+                for (i = 0; i < count; i++, entry += entrylen) {
+                    if (compareDictionaryEntry(encoded, numwords, entry) == 0) {
+                        dictptr = entry;
                         break;
                     }
-                    dictptr += (entrylen - 6);
                 }
             }
 
-            if (i == numentries) {
-                dictptr = NULL;  // not found.
-            }
-
-            const uint16 dictaddr = dictptr ? ((unsigned int) (dictptr - GState->story)) : 0;
+            const uint16 dictaddr = (uint16) dictptr;
 
             //dbg("Tokenized dictindex=%X, tokenlen=%u, strpos=%u\n", (unsigned int) dictaddr, (unsigned int) toklen, (unsigned int) ((uint8) (strstart-input)));
 
@@ -1271,6 +1838,11 @@ static void tokenizeUserInput(void)
     *(GState->story + GState->operands[1] + 1) = numtoks;
 }
 
+#ifdef MOJOZORK_BENCHMARK
+static void benchmarkEndCommand(void);
+static void benchmarkStartCommand(const int command);
+#endif
+
 static void opcode_read(void)
 {
     static char *script = NULL;
@@ -1292,9 +1864,14 @@ static void opcode_read(void)
         GState->die("parse buffer is too small for reading");  // happens on buffer overflow.
     }
 
+    flushOutput();  // the prompt, and everything before it.
     updateStatusBar();
 
-    if (GState->startup_script != NULL) {
+    #ifdef MOJOZORK_BENCHMARK
+    benchmarkEndCommand();
+    #endif
+
+    if (GState->startup_script != NULL) {
         snprintf((char *) input, inputlen-1, "#script %s\n", GState->startup_script);
         input[inputlen-1] = '\0';
         GState->startup_script = NULL;
@@ -1302,7 +1879,12 @@ static void opcode_read(void)
     } else if (script == NULL) {
         FIXME("fgets isn't really the right solution here.");
         if (!fgets((char *) input, inputlen, stdin)) {
+            #ifdef MOJOZORK_BENCHMARK
+            GState->quit = 1;  // the end of the transcript.
+            return;
+            #else
             GState->die("EOF or error on stdin during read");
+            #endif
         }
     } else {
         uint8 i;
@@ -1333,6 +1915,10 @@ static void opcode_read(void)
         }
     }
 
+    #ifdef MOJOZORK_BENCHMARK
+    benchmarkStartCommand(1);
+    #endif
+
     dbg("input string from user is '%s'\n", (const char *) input);
     {
         char *ptr;
@@ -1379,6 +1965,16 @@ static void opcode_read(void)
 
 static void opcode_verify(void)
 {
+#ifdef MOJOZORK_PAGED
+    if (static_checksum_pending) {  // initStory could only sum up dynamic memory; do the rest now.
+        const uint32 total = (uint32) GState->story_len;
+        uint32 i;
+        for (i = (GState->header.staticmem_addr > 0x40) ? GState->header.staticmem_addr : 0x40; i < total; i++) {
+            GState->calculated_checksum += readPagedStory8(i);
+        }
+        static_checksum_pending = 0;
+    }
+#endif
     doBranch((GState->calculated_checksum == GState->header.story_checksum) ? 1 : 0);
 }
 
@@ -1391,6 +1987,7 @@ static void opcode_split_window(void)
         GState->die("split_window called but implementation doesn't support it!");
     }
 
+    flushOutput();  // text so far belongs to the old layout.
     const uint16 oldval = GState->upper_window_line_count;
     GState->upper_window_line_count = GState->operands[0];
     if (GState->split_window) {
@@ -1406,6 +2003,7 @@ static void opcode_set_window(void)
     if ((GState->header.flags1 & (1<<5)) == 0) {
         GState->die("set_window called but implementation doesn't support it!");
     }
+    flushOutput();  // text so far belongs to the old window.
     const uint16 oldval = GState->current_window;
     GState->current_window = GState->operands[0];
     if (GState->set_window) {
@@ -1420,59 +2018,348 @@ static void opcode_restart(void)
     loadStory(GState->story_filename);
 }
 
+// Saved games are Quetzal files (the Z-Machine community's standard format):
+//  an IFF FORM of type IFZS holding the story's identity and the save
+//  instruction's pc (IFhd), dynamic memory XORed against the original story
+//  and run-length compressed (CMem), and just the live part of the stack, a
+//  call frame at a time (Stks). Play only changes a little of dynamic memory,
+//  so a save is a few hundred bytes rather than all of it.
+#define QUETZAL_STACK_WORDS (sizeof (GState->stack) / sizeof (GState->stack[0]))
+
+// CMem is diffed against the story as it shipped, read back a byte at a time
+//  from the start: the demand-paged build pages it in, MULTIZORK has it
+//  shared, and others reread the file.
+#ifdef MOJOZORK_PAGED
+static uint32 original_story_addr = 0;
+static int openOriginalStory(void) { original_story_addr = 0; return 1; }
+static uint8 readOriginalStory8(void) { return readPagedStory8(original_story_addr++); }
+static void closeOriginalStory(void) {}
+#elif defined(MULTIZORK)
+static uint32 original_story_addr = 0;
+static int openOriginalStory(void) { original_story_addr = 0; return 1; }
+static uint8 readOriginalStory8(void)
+{
+    const SharedStory *shared = GState->shared_story;
+    return (original_story_addr < shared->len) ? shared->data[original_story_addr++] : 0;
+}
+static void closeOriginalStory(void) {}
+#else
+static FILE *original_story_io = NULL;
+static int openOriginalStory(void)
+{
+    return (original_story_io = fopen(GState->story_filename, "rb")) != NULL;
+}
+
+static uint8 readOriginalStory8(void)
+{
+    const int ch = fgetc(original_story_io);
+    return (ch == EOF) ? 0 : (uint8) ch;
+}
+
+static void closeOriginalStory(void)
+{
+    fclose(original_story_io);
+    original_story_io = NULL;
+}
+#endif
+
+static int writeBE(FILE *io, uint32 val, const int bytes)
+{
+    uint8 buf[4];
+    int i;
+    for (i = bytes - 1; i >= 0; i--, val >>= 8) {
+        buf[i] = (uint8) (val & 0xFF);
+    }
+    return fwrite(buf, bytes, 1, io) == 1;
+}
+
+static int readBE(FILE *io, uint32 *val, const int bytes)
+{
+    uint8 buf[4];
+    int i;
+    if (fread(buf, bytes, 1, io) != 1) {
+        return 0;
+    }
+    for (*val = 0, i = 0; i < bytes; i++) {
+        *val = (*val << 8) | buf[i];
+    }
+    return 1;
+}
+
+// returns the file offset of the chunk's length, to be filled in by endChunk, or -1 on error.
+static long beginChunk(FILE *io, const char *id)
+{
+    if (fwrite(id, 4, 1, io) != 1) {
+        return -1;
+    }
+    const long pos = ftell(io);
+    return writeBE(io, 0, 4) ? pos : -1;
+}
+
+static int endChunk(FILE *io, const long pos)
+{
+    const long end = ftell(io);
+    if ((pos < 0) || (end < 0)) {
+        return 0;
+    }
+    const uint32 len = (uint32) (end - pos - 4);
+    int okay = (fseek(io, pos, SEEK_SET) == 0) && writeBE(io, len, 4) && (fseek(io, end, SEEK_SET) == 0);
+    if (okay && (len & 1)) {
+        okay = (fputc(0, io) != EOF);  // IFF pads chunks to an even length.
+    }
+    return okay;
+}
+
+// a zero byte in CMem, then a count, stands for 1 to 256 unchanged bytes.
+static int writeUnchangedRun(FILE *io, uint32 count)
+{
+    while (count) {
+        const uint32 run = (count > 256) ? 256 : count;
+        if ((fputc(0, io) == EOF) || (fputc((int) (run - 1), io) == EOF)) {
+            return 0;
+        }
+        count -= run;
+    }
+    return 1;
+}
+
+static int writeCMem(FILE *io)
+{
+    const uint32 dynamic_len = GState->header.staticmem_addr;
+    const long pos = beginChunk(io, "CMem");
+    uint32 unchanged = 0;
+    uint32 i;
+
+    if ((pos < 0) || !openOriginalStory()) {
+        return 0;
+    }
+
+    int okay = 1;
+    for (i = 0; okay && (i < dynamic_len); i++) {
+        const uint8 diff = GState->story[i] ^ readOriginalStory8();
+        if (!diff) {
+            unchanged++;
+        } else {
+            okay = writeUnchangedRun(io, unchanged) && (fputc(diff, io) != EOF);
+            unchanged = 0;
+        }
+    }
+    closeOriginalStory();
+    return okay && endChunk(io, pos);  // a trailing unchanged run is implied.
+}
+
+// the frame called from the one at bp, or 0 if bp's is the innermost.
+static uint16 calledFrame(const uint16 bp)
+{
+    uint16 callee = 0;
+    uint16 frame = GState->bp;
+    while (frame != bp) {
+        callee = frame;
+        frame = GState->stack[frame - 2];  // the caller's bp.
+    }
+    return callee;
+}
+
+static int writeStks(FILE *io)
+{
+    const uint16 *stack = GState->stack;
+    const long pos = beginChunk(io, "Stks");
+    int okay = (pos >= 0);
+    uint16 bp = 0;  // the bottom frame is Quetzal's dummy frame, holding just the top level's evaluation stack.
+
+    do {
+        // a frame's five words of call state sit just below its bp, then its locals start at bp.
+        const uint16 callee = calledFrame(bp);
+        const uint16 end = callee ? (callee - 5) : (uint16) (GState->sp - stack);
+        const uint16 numlocals = bp ? stack[bp - 1] : 0;
+        const uint32 pc = bp ? (((uint32) stack[bp - 4]) | (((uint32) stack[bp - 3]) << 16)) : 0;
+        const uint16 words = end - bp;
+        okay = okay && writeBE(io, pc, 3);
+        okay = okay && writeBE(io, numlocals, 1);  // flags: v3 calls always store their result.
+        okay = okay && writeBE(io, bp ? stack[bp - 5] : 0, 1);
+        okay = okay && writeBE(io, 0, 1);  // arguments supplied, which only check_arg_count (v5+) asks about.
+        okay = okay && writeBE(io, words - numlocals, 2);
+        // locals and evaluation stack are already bigendian, like the story.
+        okay = okay && (!words || (fwrite(stack + bp, sizeof (uint16), words, io) == words));
+        bp = callee;
+    } while (okay && bp);
+
+    return okay && endChunk(io, pos);
+}
+
 static void opcode_save(void)
 {
-    FIXME("this should write Quetzal format; this is temporary.");
-    const uint32 addr = (uint32) (GState->pc-GState->story);
-    const uint32 sp = (uint32) (GState->sp-GState->stack);
     FILE *io = fopen("save.dat", "wb");
+    long form = -1;
+    long pos = -1;
     int okay = 1;
+
     okay &= io != NULL;
-    okay &= fwrite("MOJOZORK0\n", 10, 1, io) == 1;
-    okay &= fwrite(GState->story, GState->header.staticmem_addr, 1, io) == 1;
-    okay &= fwrite(&addr, sizeof (addr), 1, io) == 1;
-    okay &= fwrite(&sp, sizeof (sp), 1, io) == 1;
-    okay &= fwrite(GState->stack, sizeof (GState->stack), 1, io) == 1;
-    okay &= fwrite(&GState->bp, sizeof (GState->bp), 1, io) == 1;
+    okay = okay && ((form = beginChunk(io, "FORM")) >= 0);
+    okay = okay && (fwrite("IFZS", 4, 1, io) == 1);
+    okay = okay && ((pos = beginChunk(io, "IFhd")) >= 0);
+    okay = okay && writeBE(io, GState->header.release, 2);
+    okay = okay && (fwrite(GState->header.serial_code, 6, 1, io) == 1);
+    okay = okay && writeBE(io, GState->header.story_checksum, 2);
+    okay = okay && writeBE(io, GState->pc, 3);  // v3 restores by branching from save's branch data.
+    okay = okay && endChunk(io, pos);
+    okay = okay && writeCMem(io);
+    okay = okay && writeStks(io);
+    okay = okay && endChunk(io, form);
     if (io) {
-        fclose(io);
+        okay &= (fclose(io) == 0);
     }
     doBranch(okay ? 1 : 0);
 }
 
+static int readCMem(FILE *io, uint32 len)
+{
+    const uint32 dynamic_len = GState->header.staticmem_addr;
+    uint8 *story = GState->story;
+    uint32 i = 0;
+    int okay = 1;
+
+    if (!openOriginalStory()) {
+        return 0;
+    }
+
+    while (okay && len--) {
+        const int ch = fgetc(io);
+        if (ch > 0) {  // a changed byte.
+            okay = (i < dynamic_len);
+            if (okay) {
+                story[i] = readOriginalStory8() ^ (uint8) ch;
+                i++;
+            }
+        } else {  // a run of unchanged ones.
+            const int run = (ch == 0) && len ? fgetc(io) : EOF;
+            len--;
+            okay = (run != EOF) && ((i + run + 1) <= dynamic_len);
+            if (okay) {
+                const uint32 runend = i + run + 1;
+                for (; i < runend; i++) {
+                    story[i] = readOriginalStory8();
+                }
+            }
+        }
+    }
+
+    for (; okay && (i < dynamic_len); i++) {
+        story[i] = readOriginalStory8();
+    }
+
+    closeOriginalStory();
+    return okay;
+}
+
+static int readStks(FILE *io, uint32 len)
+{
+    uint16 *stack = GState->stack;
+    uint16 sp = 0;
+    uint16 bp = 0;
+    int first = 1;
+
+    while (len) {
+        uint32 pc, flags, storeid, args, evalcount;
+        if ((len < 8) || !readBE(io, &pc, 3) || !readBE(io, &flags, 1) || !readBE(io, &storeid, 1) || !readBE(io, &args, 1) || !readBE(io, &evalcount, 2)) {
+            return 0;
+        }
+        len -= 8;
+
+        const uint16 numlocals = (uint16) (flags & 0xF);
+        const uint32 words = numlocals + evalcount;
+        if ((len < (words * 2)) || ((sp + (first ? 0 : 5) + words) > QUETZAL_STACK_WORDS)) {
+            return 0;
+        }
+
+        if (!first) {  // the dummy frame has no call state, its stack is the bottom of ours.
+            stack[sp++] = (uint16) storeid;
+            stack[sp++] = (uint16) (pc & 0xFFFF);
+            stack[sp++] = (uint16) ((pc >> 16) & 0xFFFF);
+            stack[sp++] = bp;
+            stack[sp++] = numlocals;
+            bp = sp;
+        } else if (numlocals) {
+            return 0;  // not a dummy frame; a v3 story's main routine can't have locals.
+        }
+
+        if (words && (fread(stack + sp, sizeof (uint16), words, io) != words)) {
+            return 0;
+        }
+        sp += (uint16) words;
+        len -= words * 2;
+        first = 0;
+    }
+
+    GState->sp = stack + sp;
+    setFrame(bp);
+    return 1;
+}
+
 static void opcode_restore(void)
 {
-    FIXME("this should read Quetzal format; this is temporary.");
     FILE *io = fopen("save.dat", "rb");
-    int okay = 1;
+    uint32 formlen = 0;
+    uint32 len = 0;
     uint32 x = 0;
+    uint32 pc = 0;
+    char id[4];
+    uint8 serial[6];
+    int okay = 1;
+    int loaded_mem = 0;
+    int loaded_stack = 0;
 
+    // a save that's missing or from some other story fails the restore; nothing has changed yet.
     okay &= io != NULL;
+    okay = okay && (fread(id, 4, 1, io) == 1) && (memcmp(id, "FORM", 4) == 0) && readBE(io, &formlen, 4);
+    okay = okay && (fread(id, 4, 1, io) == 1) && (memcmp(id, "IFZS", 4) == 0);
+    okay = okay && (fread(id, 4, 1, io) == 1) && (memcmp(id, "IFhd", 4) == 0) && readBE(io, &len, 4) && (len == 13);
+    okay = okay && readBE(io, &x, 2) && (x == GState->header.release);
+    okay = okay && (fread(serial, 6, 1, io) == 1) && (memcmp(serial, GState->header.serial_code, 6) == 0);
+    okay = okay && readBE(io, &x, 2) && (x == GState->header.story_checksum);
+    okay = okay && readBE(io, &pc, 3) && (fseek(io, 1, SEEK_CUR) == 0);  // skip IFhd's pad byte.
+    if (!okay) {
+        if (io) {
+            fclose(io);
+        }
+        doBranch(0);
+        return;
+    }
 
-    char header[10];
-    okay &= io != NULL;
-    okay &= fread(header, 10, 1, io) == 1;
-    if (okay && (memcmp(header, "MOJOZORK0\n", 10) != 0)) {
-        rewind(io);  // might be an older MojoZork savegame with no identifier...?
-    }
-    okay &= fread(GState->story, GState->header.staticmem_addr, 1, io) == 1;
-    okay &= fread(&x, sizeof (x), 1, io) == 1;
-    GState->logical_pc = x;
-    GState->pc = GState->story + x;
-    okay &= fread(&x, sizeof (x), 1, io) == 1;
-    GState->sp = GState->stack + x;
-    okay &= fread(GState->stack, sizeof (GState->stack), 1, io) == 1;
-    okay &= fread(&GState->bp, sizeof (GState->bp), 1, io) == 1;
-    if (io) {
-        fclose(io);
+    for (formlen = (formlen < 26) ? 0 : (formlen - 26); okay && (formlen >= 8); ) {
+        okay = (fread(id, 4, 1, io) == 1) && readBE(io, &len, 4) && ((len + 8) <= formlen);
+        if (!okay) {
+            break;
+        }
+        formlen -= 8 + len + (len & 1);
+        const long next = ftell(io) + (long) (len + (len & 1));
+        if (memcmp(id, "CMem", 4) == 0) {
+            okay = readCMem(io, len);
+            loaded_mem = 1;
+        } else if (memcmp(id, "UMem", 4) == 0) {  // uncompressed, which some interpreters write.
+            okay = (len == GState->header.staticmem_addr) && (fread(GState->story, len, 1, io) == 1);
+            loaded_mem = 1;
+        } else if (memcmp(id, "Stks", 4) == 0) {
+            okay = readStks(io, len);
+            loaded_stack = 1;
+        }
+        okay = okay && (fseek(io, next, SEEK_SET) == 0);  // skipping other chunks, too.
     }
+    fclose(io);
 
-    if (!okay) {
+    // we may have overwritten memory and the stack by now, so there's no going back.
+    if (!okay || !loaded_mem || !loaded_stack) {
         GState->die("Failed to restore.");
     }
 
+    resetShortNameCache();
+    forgetObjectLayout();
+    GState->logical_pc = pc;
+    GState->pc = pc;
+
     // 8.6.1.3: Following a "restore" of the game, the interpreter should automatically collapse the upper window to size 0.
     if (okay && GState->split_window) {
+        flushOutput();
         const uint16 oldval = GState->upper_window_line_count;
         GState->upper_window_line_count = 0;
         GState->split_window(oldval, 0);
@@ -1483,6 +2370,7 @@ static void opcode_restore(void)
 
 static void opcode_quit(void)
 {
+    flushOutput();
     GState->quit = 1;
     GState->step_completed = 1;  // possibly time to break out of the Z-Machine simulation loop.
 }
@@ -1492,32 +2380,38 @@ static void opcode_nop(void)
     // that's all, folks.
 }
 
+// a variable operand's value, reading globals and locals straight out of memory.
+static inline uint16 readVariable(const uint8 var)
+{
+    const uint8 *ptr;
+    if (var >= 0x10) {
+        ptr = GState->globals + ((var-0x10) * sizeof (uint16));
+    } else if ((var != 0) && (GState->locals[-1] >= var)) {
+        ptr = (const uint8 *) (GState->locals + (var-1));
+    } else {  // the stack, or an unallocated local, which dies.
+        ptr = varAddress(var, 0, 0);
+    }
+    return (((uint16) ptr[0]) << 8) | ((uint16) ptr[1]);
+}
+
 static int parseOperand(const uint8 optype, uint16 *operand)
 {
     switch (optype) {
-        case 0: *operand = (uint16) READUI16(GState->pc); return 1;  // large constant (uint16)
-        case 1: *operand = *(GState->pc++); return 1;  // small constant (uint8)
-        case 2: { // variable
-            const uint8 *addr = varAddress(*(GState->pc++), 0, 0);
-            *operand = READUI16(addr);
-            return 1;
-        }
+        case 0: *operand = readPC16(); return 1;  // large constant (uint16)
+        case 1: *operand = readPC8(); return 1;  // small constant (uint8)
+        case 2: *operand = readVariable(readPC8()); return 1;  // variable
         case 3: break;  // omitted altogether, we're done.
     }
 
     return 0;
 }
 
-static uint8 parseVarOperands(uint16 *operands)
+static uint8 parseOperandTypes(uint8 operandTypes, uint16 *operands)
 {
-    const uint8 operandTypes = *(GState->pc++);
-    uint8 shifter = 6;
     uint8 i;
 
-    for (i = 0; i < 4; i++) {
-        const uint8 optype = (operandTypes >> shifter) & 0x3;
-        shifter -= 2;
-        if (!parseOperand(optype, operands + i)) {
+    for (i = 0; i < 4; i++, operandTypes <<= 2) {
+        if (!parseOperand(operandTypes >> 6, operands + i)) {
             break;
         }
     }
@@ -1525,6 +2419,12 @@ static uint8 parseVarOperands(uint16 *operands)
     return i;
 }
 
+static uint8 parseVarOperands(uint16 *operands)
+{
+    return parseOperandTypes(readPC8(), operands);
+}
+
+
 static void calculateStatusBar(char *buf, uint8 *highlight, size_t buflen)
 {
     // if not a score game, then it's a time game.
@@ -1533,7 +2433,7 @@ static void calculateStatusBar(char *buf, uint8 *highlight, size_t buflen)
     const uint16 objid = READUI16(addr);
     const uint16 scoreval = READUI16(addr);
     const uint16 movesval = READUI16(addr);
-    const uint8 *objzstr = getObjectShortName(objid);
+    const uint32 objzstr = getObjectShortName(objid);
     const int short_score = (buflen < 50);  // this is a hack to make the C-64 UI in the libretro code look like the original.
 
     char objstr[64];
@@ -1608,35 +2508,201 @@ static void updateStatusBar(void)
     }
 }
 
+#ifdef MOJOZORK_BENCHMARK
+// MOJOZORK_BENCHMARK builds time the interpreter while it replays a
+//  transcript: ticks per Z-instruction, per command and per opcode, with a
+//  report on stderr after each command and when the game quits or the
+//  transcript runs out. Input waits aren't counted. Under mos-sim a tick is
+//  a 6502 cycle, from the simulator's counter at $FFF0; on the host, it's a
+//  clock() tick, so the per-opcode split is a sampled estimate.
+#ifdef MULTIZORK
+#error MOJOZORK_BENCHMARK is for the standalone interpreter.
+#endif
+
+#if defined(__mos__)
+#ifdef __mattbrew__
+#error MOJOZORK_BENCHMARK on the 6502 runs under mos-sim.
+#endif
+#define BENCHMARK_TICKS "cycles"
+static uint32 benchmarkClock(void)
+{
+    volatile const uint8 *counter = (volatile const uint8 *) 0xFFF0;
+    uint32 ticks = 0;
+    uint8 i;
+    for (i = 0; i < 4; i++) {  // reading the first byte latches all four.
+        ticks |= ((uint32) counter[i]) << (i * 8);
+    }
+    return ticks;
+}
+#else
+#define BENCHMARK_TICKS "ticks"
+static uint32 benchmarkClock(void) { return (uint32) clock(); }
+#endif
+
+#define BENCHMARK_OPCODES (256 + 30)  // then the extended ones.
+static uint32 bench_opcode_count[BENCHMARK_OPCODES];
+static unsigned long long bench_opcode_ticks[BENCHMARK_OPCODES];
+static uint16 bench_order[BENCHMARK_OPCODES];
+static uint16 bench_opcode = BENCHMARK_OPCODES;  // the one running now, to charge its ticks to.
+static uint32 bench_clock = 0;
+static unsigned long long bench_command_ticks = 0;
+static unsigned long long bench_startup_ticks = 0;  // loading and the banner, before the first read.
+static unsigned long long bench_total_ticks = 0;  // after that.
+static uint32 bench_command_instructions = 0;  // instructions_run when the command started.
+static uint32 bench_commands = 0;
+static int bench_in_command = 0;
+static uint32 bench_startup_instructions = 0;
+
+static const Opcode *benchmarkOpcode(const uint16 index)
+{
+    #ifdef MOJOZORK_STATIC_STATE
+    return &v3_opcodes[index];
+    #else
+    return (index < 256) ? &GState->opcodes[index] : &GState->extended_opcodes[index - 256];
+    #endif
+}
+
+// charge the ticks since the last call to whatever opcode was running.
+static void benchmarkCharge(void)
+{
+    const uint32 now = benchmarkClock();
+    const uint32 ticks = now - bench_clock;
+    bench_clock = now;
+    if (bench_opcode < BENCHMARK_OPCODES) {
+        bench_opcode_ticks[bench_opcode] += ticks;
+    }
+    bench_command_ticks += ticks;
+}
+
+static void benchmarkInstruction(const uint16 index)
+{
+    benchmarkCharge();
+    bench_opcode = index;
+    bench_opcode_count[index]++;
+}
+
+// a read is waiting for input: the command before it is done.
+static void benchmarkEndCommand(void)
+{
+    benchmarkCharge();
+    const uint32 instructions = GState->instructions_run - bench_command_instructions;
+    if (bench_in_command) {
+        bench_commands++;
+        bench_total_ticks += bench_command_ticks;
+        fprintf(stderr, "benchmark: command %u:", (unsigned int) bench_commands);
+    } else {
+        bench_startup_ticks = bench_command_ticks;
+        bench_startup_instructions = instructions;
+        fprintf(stderr, "benchmark: startup:");
+    }
+    fprintf(stderr, " %u instructions, %llu " BENCHMARK_TICKS ", %llu per instruction\n",
+            (unsigned int) instructions, bench_command_ticks,
+            instructions ? (bench_command_ticks / instructions) : 0);
+    bench_in_command = 0;
+}
+
+// input is in: the next command starts now.
+static void benchmarkStartCommand(const int command)
+{
+    bench_in_command = command;
+    bench_command_ticks = 0;
+    bench_command_instructions = GState->instructions_run;
+    bench_clock = benchmarkClock();
+}
+
+static int compareBenchmarkOpcodes(const void *a, const void *b)
+{
+    const unsigned long long x = bench_opcode_ticks[*(const uint16 *) a];
+    const unsigned long long y = bench_opcode_ticks[*(const uint16 *) b];
+    return (x < y) ? 1 : ((x > y) ? -1 : 0);
+}
+
+static void benchmarkReport(void)
+{
+    uint16 count = 0;
+    uint16 i, j;
+
+    if (bench_in_command) {  // quit, rather than running out of transcript.
+        benchmarkEndCommand();
+    }
+
+    const uint32 instructions = GState->instructions_run - bench_startup_instructions;
+
+    // fold each opcode's forms (je has five) in under its name.
+    for (i = 0; i < BENCHMARK_OPCODES; i++) {
+        if (!bench_opcode_count[i]) {
+            continue;
+        }
+        for (j = 0; j < count; j++) {
+            if (strcmp(benchmarkOpcode(bench_order[j])->name, benchmarkOpcode(i)->name) == 0) {
+                break;
+            }
+        }
+        if (j == count) {
+            bench_order[count++] = i;
+        } else {
+            bench_opcode_count[bench_order[j]] += bench_opcode_count[i];
+            bench_opcode_ticks[bench_order[j]] += bench_opcode_ticks[i];
+        }
+    }
+    qsort(bench_order, count, sizeof (bench_order[0]), compareBenchmarkOpcodes);
+
+    fprintf(stderr, "benchmark: startup took %llu " BENCHMARK_TICKS "; then %u commands, %u instructions, %llu " BENCHMARK_TICKS "\n",
+            bench_startup_ticks, (unsigned int) bench_commands, (unsigned int) instructions, bench_total_ticks);
+    fprintf(stderr, "benchmark: %llu " BENCHMARK_TICKS " per instruction, %llu per command\n",
+            instructions ? (bench_total_ticks / instructions) : 0,
+            bench_commands ? (bench_total_ticks / bench_commands) : 0);
+    const unsigned long long all_ticks = bench_startup_ticks + bench_total_ticks;  // opcodes count from the start.
+    fprintf(stderr, "benchmark: %-16s %10s %14s %6s %8s\n", "opcode", "count", BENCHMARK_TICKS, "%", "each");
+    for (i = 0; i < count; i++) {
+        const uint16 op = bench_order[i];
+        const unsigned long long permille = all_ticks ? ((bench_opcode_ticks[op] * 1000) / all_ticks) : 0;
+        fprintf(stderr, "benchmark: %-16s %10u %14llu %4u.%u %8llu\n", benchmarkOpcode(op)->name,
+                (unsigned int) bench_opcode_count[op], bench_opcode_ticks[op],
+                (unsigned int) (permille / 10), (unsigned int) (permille % 10),
+                bench_opcode_ticks[op] / bench_opcode_count[op]);
+    }
+}
+#endif
+
 static void runInstruction(void)
 {
     FIXME("verify PC is sane");
 
-    GState->logical_pc = (uint32) (GState->pc - GState->story);
-    uint8 opcode = *(GState->pc++);
+    GState->logical_pc = GState->pc;
+    uint8 opcode = readPC8();
 
     const Opcode *op = NULL;
 
+    #ifdef MOJOZORK_STATIC_STATE
+    const int extended = 0;  // only version 3 runs here, and extended opcodes are ver5+.
+    #else
     const int extended = ((opcode == 190) && (GState->header.version >= 5)) ? 1 : 0;
     if (extended) {
-        opcode = *(GState->pc++);
+        opcode = readPC8();
         if (opcode >= (sizeof (GState->extended_opcodes) / sizeof (GState->extended_opcodes[0]))) {
             GState->die("Unsupported or unknown extended opcode #%u", (unsigned int) opcode);
         }
         GState->operand_count = parseVarOperands(GState->operands);
         op = &GState->extended_opcodes[opcode];
-    } else {
-        if (opcode <= 127) {   // 2OP
+    } else
+    #endif
+    {
+        #ifdef MOJOZORK_STATIC_STATE
+        op = &v3_opcodes[opcode];
+        #else
+        op = &GState->opcodes[opcode];
+        #endif
+        uint16 *operands = GState->operands;
+        if (opcode <= 127) {   // 2OP, by far the most common: each operand is a small constant or a variable.
             GState->operand_count = 2;
-            parseOperand(((opcode >> 6) & 0x1) ? 2 : 1, GState->operands + 0);
-            parseOperand(((opcode >> 5) & 0x1) ? 2 : 1, GState->operands + 1);
-        } else if (opcode <= 175) {  // 1OP
-            GState->operand_count = 1;
-            const uint8 optype = (opcode >> 4) & 0x3;
-            parseOperand(optype, GState->operands);  // 1OP or 0OP
-        } else if (opcode <= 191) {  // 0OP
-            GState->operand_count = 0;
-        } else if (opcode > 191) {  // VAR
+            const uint8 a = readPC8();
+            operands[0] = (opcode & (1<<6)) ? readVariable(a) : a;
+            const uint8 b = readPC8();
+            operands[1] = (opcode & (1<<5)) ? readVariable(b) : b;
+        } else if (op->operand_types != OPERANDS_VAR) {  // 1OP or 0OP
+            GState->operand_count = parseOperandTypes(op->operand_types, operands);
+        } else {  // VAR
             const int takes8 = ((opcode == 236) || (opcode == 250));  // call_vs2 and call_vn2 take up to EIGHT arguments!
             if (!takes8) {
                 GState->operand_count = parseVarOperands(GState->operands);
@@ -1649,8 +2715,6 @@ static void runInstruction(void)
                 }
             }
         }
-
-        op = &GState->opcodes[opcode];
     }
 
     if (!op->name) {
@@ -1658,6 +2722,10 @@ static void runInstruction(void)
     } else if (!op->fn) {
         GState->die("Unimplemented %sopcode #%d ('%s')", extended ? "extended " : "", (unsigned int) opcode, op->name);
     } else {
+        #ifdef MOJOZORK_BENCHMARK
+        benchmarkInstruction(extended ? (256 + opcode) : opcode);
+        #endif
+
         #if MOJOZORK_DEBUGGING
         dbg("pc=%X %sopcode=%u ('%s') [", (unsigned int) GState->logical_pc, extended ? "ext " : "", opcode, op->name);
         if (GState->operand_count)
@@ -1723,6 +2791,53 @@ static void initAlphabetTable(void)
     *(ptr++) = ')';
 }
 
+#ifdef MOJOZORK_STATIC_STATE
+// the table initOpcodeTable builds for a version 3 story, as constant data.
+#define V3_OP(num, opname, types) [num] = { #opname, opcode_##opname, types }
+#define V3_OP_WRITEME(num, opname) [num] = { #opname, NULL, OPERANDS_VAR }
+#define V3_2OP(num, opname) \
+    V3_OP(num, opname, OPERANDS_2OP(num)), V3_OP(num + 32, opname, OPERANDS_2OP(num + 32)), \
+    V3_OP(num + 64, opname, OPERANDS_2OP(num + 64)), V3_OP(num + 96, opname, OPERANDS_2OP(num + 96)), \
+    V3_OP(num + 192, opname, OPERANDS_VAR)
+#define V3_1OP(num, opname) \
+    V3_OP(num, opname, OPERANDS_1OP(num)), V3_OP(num + 16, opname, OPERANDS_1OP(num + 16)), \
+    V3_OP(num + 32, opname, OPERANDS_1OP(num + 32))
+#define V3_0OP(num, opname) V3_OP(num, opname, OPERANDS_1OP(num))
+#define V3_VAROP(num, opname) V3_OP(num, opname, OPERANDS_VAR)
+
+static const Opcode v3_opcodes[256] = {
+    V3_2OP(1, je), V3_2OP(2, jl), V3_2OP(3, jg), V3_2OP(4, dec_chk),
+    V3_2OP(5, inc_chk), V3_2OP(6, jin), V3_2OP(7, test), V3_2OP(8, or),
+    V3_2OP(9, and), V3_2OP(10, test_attr), V3_2OP(11, set_attr), V3_2OP(12, clear_attr),
+    V3_2OP(13, store), V3_2OP(14, insert_obj), V3_2OP(15, loadw), V3_2OP(16, loadb),
+    V3_2OP(17, get_prop), V3_2OP(18, get_prop_addr), V3_2OP(19, get_next_prop), V3_2OP(20, add),
+    V3_2OP(21, sub), V3_2OP(22, mul), V3_2OP(23, div), V3_2OP(24, mod),
+
+    V3_1OP(128, jz), V3_1OP(129, get_sibling), V3_1OP(130, get_child), V3_1OP(131, get_parent),
+    V3_1OP(132, get_prop_len), V3_1OP(133, inc), V3_1OP(134, dec), V3_1OP(135, print_addr),
+    V3_1OP(137, remove_obj), V3_1OP(138, print_obj), V3_1OP(139, ret), V3_1OP(140, jump),
+    V3_1OP(141, print_paddr), V3_1OP(142, load), V3_1OP(143, not),
+
+    V3_0OP(176, rtrue), V3_0OP(177, rfalse), V3_0OP(178, print), V3_0OP(179, print_ret),
+    V3_0OP(180, nop), V3_0OP(181, save), V3_0OP(182, restore), V3_0OP(183, restart),
+    V3_0OP(184, ret_popped), V3_0OP(185, pop), V3_0OP(186, quit), V3_0OP(187, new_line),
+    V3_0OP(188, show_status), V3_0OP(189, verify),
+
+    V3_VAROP(224, call), V3_VAROP(225, storew), V3_VAROP(226, storeb), V3_VAROP(227, put_prop),
+    V3_VAROP(228, read), V3_VAROP(229, print_char), V3_VAROP(230, print_num), V3_VAROP(231, random),
+    V3_VAROP(232, push), V3_VAROP(233, pull), V3_VAROP(234, split_window), V3_VAROP(235, set_window),
+    V3_OP_WRITEME(243, output_stream), V3_OP_WRITEME(244, input_stream), V3_OP_WRITEME(245, sound_effect),
+};
+
+#undef V3_OP
+#undef V3_OP_WRITEME
+#undef V3_2OP
+#undef V3_1OP
+#undef V3_0OP
+#undef V3_VAROP
+
+static void initOpcodeTable(void) {}
+#else
 static void inititialOpcodeTableSetup(void)
 {
     FIXME("lots of missing instructions here.  :)");
@@ -1941,7 +3056,19 @@ static void initOpcodeTable(void)
     for (uint8 i = 192; i <= 223; i++) {  // 2OP opcodes repeating with VAR operand forms.
         opcodes[i] = opcodes[i % 32];
     }
+
+    // pre-decode the operand types each opcode byte implies, so runInstruction doesn't work out the form every time.
+    for (int i = 0; i <= 255; i++) {
+        if (i <= 127) {
+            opcodes[i].operand_types = OPERANDS_2OP(i);
+        } else if (i <= 191) {
+            opcodes[i].operand_types = OPERANDS_1OP(i);
+        } else {  // VAR: the types follow in the instruction.
+            opcodes[i].operand_types = OPERANDS_VAR;
+        }
+    }
 }
+#endif
 
 // call this before we make any changes to GState->story.
 static void calculateActualChecksum(void)
@@ -1958,7 +3085,22 @@ static void calculateActualChecksum(void)
         total *= 8;
     }
 
+    #ifdef MOJOZORK_PAGED
+    // only dynamic memory is loaded; opcode_verify adds in the rest if the game ever asks.
+    static_checksum_pending = (total > GState->header.staticmem_addr);
+    if (static_checksum_pending) {
+        total = GState->header.staticmem_addr;
+    }
+    #endif
+
+    #ifdef MULTIZORK
+    const uint8 *ptr = GState->shared_story->data;  // the session's copy of dynamic memory is too short.
+    if (total > GState->shared_story->len) {
+        total = GState->shared_story->len;
+    }
+    #else
     const uint8 *ptr = GState->story;
+    #endif
     for (uint32 i = 0x40; i < total; i++) {
         checksum += ptr[i];
     }
@@ -1989,7 +3131,8 @@ static void initStory(const char *fname, uint8 *story, const uint32 storylen)
     memset(GState->operands, '\0', sizeof (GState->operands));
     GState->operand_count = 0;
     GState->sp = NULL;  // stack pointer
-    GState->bp = 0;  // base pointer
+    setFrame(0);  // base pointer
+    GState->globals = NULL;
 
     memset(&GState->header, '\0', sizeof (GState->header));
 
@@ -2035,6 +3178,7 @@ static void initStory(const char *fname, uint8 *story, const uint32 storylen)
     GState->header.abbrtab_addr = READUI16(ptr);
     GState->header.story_len = READUI16(ptr);
     GState->header.story_checksum = READUI16(ptr);
+    GState->globals = GState->story + GState->header.globals_addr;
 
     dbg("Story '%s' header:\n", fname);
     dbg(" - version %u\n", (unsigned int) GState->header.version);
@@ -2058,21 +3202,182 @@ static void initStory(const char *fname, uint8 *story, const uint32 storylen)
 
     calculateActualChecksum();
     initAlphabetTable();
+    resetZsciiCache();
+    initObjectTable();
     initOpcodeTable();
 
     FIXME("in ver6+, this is the address of a main() routine, not a raw instruction address.");
-    GState->pc = GState->story + GState->header.pc_start;
+    GState->pc = GState->header.pc_start;
     GState->logical_pc = (uint32) GState->header.pc_start;
-    GState->bp = 0;
+    setFrame(0);
     GState->sp = GState->stack;
 }
 
+#ifdef MOJOZORK_PAGED
+// load just dynamic memory; the rest of the story is read as the game needs it.
 static void loadStory(const char *fname)
 {
     uint8 *story;
+    uint8 *page = page_cache[0];  // nothing's cached yet, use it for scratch.
+
+    if (!fname) {
+        GState->die("USAGE: mojozork <story_file>");
+    }
+
+    openStoryFile(fname);
+    fetchStoryPage(fname, 0, page);
+    const uint16 dynamic_len = (((uint16) page[0xE]) << 8) | ((uint16) page[0xF]);
+    const uint32 len = ((((uint32) page[0x1A]) << 8) | ((uint32) page[0x1B])) * 2;  // v3 stories count 2-byte words.
+    if (page[0] != 3) {
+        GState->die("FIXME: only version 3 is supported right now, '%s' is %d", fname, (int) page[0]);
+    } else if ((dynamic_len < 64) || (len < dynamic_len)) {
+        GState->die("'%s' doesn't look like a story file", fname);
+    } else if ((story = (uint8 *) malloc(dynamic_len)) == NULL) {
+        GState->die("Out of memory");
+    }
+
+    uint32 offset;
+    for (offset = 0; offset < dynamic_len; offset += MOJOZORK_PAGE_SIZE) {
+        const uint32 avail = dynamic_len - offset;
+        if (offset) {
+            fetchStoryPage(fname, (uint16) (offset >> MOJOZORK_PAGE_SHIFT), page);
+        }
+        memcpy(story + offset, page, (avail < MOJOZORK_PAGE_SIZE) ? avail : MOJOZORK_PAGE_SIZE);
+    }
+
+    resetPageCache();
+    initStory(fname, story, len);
+}
+#elif defined(MULTIZORK)
+static SharedStory *shared_stories = NULL;
+
+// the shared copy of a story, loaded the first time a session asks for it.
+static SharedStory *acquireSharedStory(const char *fname)
+{
+    SharedStory *shared;
+    uint8 *data;
     FILE *io;
     long len;
 
+    for (shared = shared_stories; shared; shared = shared->next) {
+        if (strcmp(shared->filename, fname) == 0) {
+            shared->refcount++;
+            return shared;
+        }
+    }
+
+    if ((io = fopen(fname, "rb")) == NULL) {
+        GState->die("Failed to open '%s'", fname);
+    } else if ((fseek(io, 0, SEEK_END) == -1) || ((len = ftell(io)) == -1)) {
+        GState->die("Failed to determine size of '%s'", fname);
+    } else if ((data = (uint8 *) malloc(len)) == NULL) {
+        GState->die("Out of memory");
+    } else if ((fseek(io, 0, SEEK_SET) == -1) || (fread(data, len, 1, io) != 1)) {
+        GState->die("Failed to read '%s'", fname);
+    }
+
+    fclose(io);
+
+    const uint16 dynamic_len = (len < 64) ? 0 : ((((uint16) data[0xE]) << 8) | ((uint16) data[0xF]));
+    if ((dynamic_len < 64) || (dynamic_len > len)) {
+        free(data);
+        GState->die("'%s' doesn't look like a story file", fname);
+    } else if ((shared = (SharedStory *) calloc(1, sizeof (SharedStory))) == NULL) {
+        free(data);
+        GState->die("Out of memory");
+    } else if ((shared->filename = strdup(fname)) == NULL) {
+        free(shared);
+        free(data);
+        GState->die("Out of memory");
+    }
+
+    shared->data = data;
+    shared->len = (uint32) len;
+    shared->refcount = 1;
+    shared->next = shared_stories;
+    shared_stories = shared;
+    return shared;
+}
+
+// a story is freed when the last session playing it lets go.
+static void releaseSharedStory(SharedStory *shared)
+{
+    if (shared && (--shared->refcount == 0)) {
+        SharedStory **prev = &shared_stories;
+        while (*prev != shared) {
+            prev = &(*prev)->next;
+        }
+        *prev = shared->next;
+        free(shared->data);
+        free(shared->filename);
+        free(shared);
+    }
+}
+
+// copy just dynamic memory out of the shared story; the rest is read from there.
+static void loadStory(const char *fname)
+{
+    uint8 *story;
+
+    if (!fname) {
+        GState->die("USAGE: mojozork <story_file>");
+    }
+
+    // taken before the old one is let go, so a restart doesn't reload the file.
+    SharedStory *shared = acquireSharedStory(fname);
+    const uint16 dynamic_len = (((uint16) shared->data[0xE]) << 8) | ((uint16) shared->data[0xF]);
+    if ((story = (uint8 *) malloc(dynamic_len)) == NULL) {
+        releaseSharedStory(shared);
+        GState->die("Out of memory");
+    }
+
+    memcpy(story, shared->data, dynamic_len);
+    releaseSharedStory(GState->shared_story);
+    GState->shared_story = shared;
+    initStory(fname, story, shared->len);
+}
+#else
+// a story named "-" comes from stdin, as long as its header says, and the
+//  rest of stdin is left for commands. That's how a benchmark gets its story
+//  into mos-sim, which has no files.
+static uint8 *readStoryFromStdin(uint32 *_len)
+{
+    uint8 header[64];
+    uint8 *story;
+    uint32 len;
+
+    if (GState->story) {
+        GState->die("Can't reload a story that was read from stdin");
+    } else if (fread(header, sizeof (header), 1, stdin) != 1) {
+        GState->die("Failed to read a story from stdin");
+    } else if (header[0] != 3) {
+        GState->die("FIXME: only version 3 is supported right now, stdin's story is %d", (int) header[0]);
+    } else if ((len = ((((uint32) header[0x1A]) << 8) | ((uint32) header[0x1B])) * 2) < sizeof (header)) {  // v3 stories count 2-byte words.
+        GState->die("stdin doesn't look like a story file");
+    } else if ((story = (uint8 *) malloc(len)) == NULL) {
+        GState->die("Out of memory");
+    } else if (fread(story + sizeof (header), len - sizeof (header), 1, stdin) != 1) {
+        GState->die("Failed to read a story from stdin");
+    }
+
+    memcpy(story, header, sizeof (header));
+    *_len = len;
+    return story;
+}
+
+static void loadStory(const char *fname)
+{
+    uint8 *story;
+    FILE *io;
+    long len;
+
+    if (fname && (strcmp(fname, "-") == 0)) {
+        uint32 stdinlen = 0;
+        story = readStoryFromStdin(&stdinlen);
+        initStory(fname, story, stdinlen);
+        return;
+    }
+
     if (!fname) {
         GState->die("USAGE: mojozork <story_file>");
     } else if ((io = fopen(fname, "rb")) == NULL) {
@@ -2089,6 +3394,20 @@ static void loadStory(const char *fname)
 
     initStory(fname, story, (uint32) len);
 }
+#endif
+
+// free a session's story, when it's done playing.
+static void unloadStory(void)
+{
+    free(GState->story);
+    GState->story = NULL;
+    free(GState->story_filename);
+    GState->story_filename = NULL;
+    #ifdef MULTIZORK
+    releaseSharedStory(GState->shared_story);
+    GState->shared_story = NULL;
+    #endif
+}
 
 
 #if !defined(MULTIZORK) && !defined(MOJOZORK_LIBRETRO)
@@ -2103,6 +3422,7 @@ static void die(const char *fmt, ...)
 {
     va_list ap;
 
+    flushOutput();  // whatever the game printed before it went wrong.
     fprintf(stderr, "\nERROR: ");
     va_start(ap, fmt);
     vfprintf(stderr, fmt, ap);
@@ -2124,29 +3444,61 @@ static void writestr_stdio(const char *str, const uintptr slen)
     }
 }
 
+#ifdef __mattbrew__
+// straight to the bridge terminal: the text is already gathered into big
+//  writes, so stdout's line buffer would only split them up again.
+static void writestr_bridge(const char *str, uintptr slen)
+{
+    term_flush();  // anything printf'd goes out first.
+    while (slen) {
+        const uint8 len = (slen < 255) ? (uint8) slen : 255;
+        io_write(TERM_DEVICE, (const uint8 *) str, len);
+        str += len;
+        slen -= len;
+    }
+}
+#endif
+
 
 int main(int argc, char **argv)
 {
-    static ZMachineState zmachine_state;
+    #ifdef MOJOZORK_BENCHMARK
+    const char *fname = (argc >= 2) ? argv[1] : "-";  // mos-sim passes no arguments.
+    #else
     const char *fname = (argc >= 2) ? argv[1] : "zork1.dat";
+    #endif
 
+    #ifndef MOJOZORK_STATIC_STATE
+    static ZMachineState zmachine_state;
     GState = &zmachine_state;
+    #endif
     GState->startup_script = (argc >= 3) ? argv[2] : NULL;
     GState->die = die;
+    #ifdef __mattbrew__
+    GState->writestr = writestr_bridge;
+    #else
     GState->writestr = writestr_stdio;
+    #endif
 
     random_seed = (int) time(NULL);
 
+    #ifdef MOJOZORK_BENCHMARK
+    benchmarkStartCommand(0);  // startup, until the first read.
+    #endif
+
     loadStory(fname);
 
     while (!GState->quit) {
         runInstruction();
     }
 
+    #ifdef MOJOZORK_BENCHMARK
+    benchmarkReport();
+    #endif
+
     dbg("ok.\n");
 
-    free(GState->story);
-    free(GState->story_filename);
+    unloadStory();
 
     return 0;
 }
@@ -1 +1,2 @@
 set(CMAKE_TOOLCHAIN_FILE ${CMAKE_CURRENT_LIST_DIR}/llvm-mos-toolchain.cmake)
+include(${CMAKE_CURRENT_LIST_DIR}/famitone2.cmake)
@@ -1,6 +1,7 @@
 #undef NDEBUG
 #include <assert.h>
 #include <fixed_point.h>
+#include <string.h>
 
 // This file is an example of how to use the high level fixed point
 // library in fixed_point.h. The fixedpoint::Value class provides a
@@ -58,5 +59,32 @@ int main() {
   // Since its unsigned, it will be treated as a positive value instead
   assert ( unsigned_number > 200 );
 
+  // For 8.8 numbers in inner loops, the fixedpoint namespace has table-driven
+  // versions of the slow operations. mul gives the same result as operator*
+  // with four table lookups instead of a software multiply.
+  f8_8 scale = -1.5_8_8;
+  assert( fixedpoint::mul(scale, 2.25_8_8) == scale * 2.25_8_8 );
+
+  // div is approximate, within 1/256 of the quotient, but exact here.
+  f8_8 quotient = fixedpoint::div(10.0_8_8, 4.0_8_8);
+  assert( quotient == 2.5_8_8 );
+
+  // Angles are in 256ths of a turn, so 64 is a right angle. The template
+  // parameter sets the table size: samples per quarter turn, up to 64.
+  assert( fixedpoint::sin(64) == 1 );
+  assert( fixedpoint::cos<16>(128) == -1 );
+  // sqrt is also from a table, good to about half a percent by default.
+  assert( fixedpoint::sqrt(6.25_u8_8).as_i() == 2 );
+
+  // to_chars prints in decimal with integer arithmetic only, so printing
+  // needs no conversion to double and none of the float library. chars()
+  // gives the buffer size for a number of fractional digits.
+  char text[f8_8::chars(2)];
+  (-1.75_8_8).to_chars(text, 2);
+  assert( strcmp(text, "-1.75") == 0 );
+  // The last digit is rounded, with halves going away from zero.
+  (2.125_8_8).to_chars(text, 2);
+  assert( strcmp(text, "2.13") == 0 );
+
   return 0;
 }
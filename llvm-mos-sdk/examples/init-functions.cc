@@ -1,3 +1,4 @@
+#include <rom.h>
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -15,13 +16,26 @@ struct FunctionStaticClass {
 void InitStatic() { static FunctionStaticClass nontrivial; }
 
 void C_AtExit() { puts("C-STYLE ATEXIT FUNCTION CALLED"); }
+
+// A table computed entirely at compile time. Declared __rom, it's placed
+// directly in ROM, and no constructor runs for it above.
+struct SquaresTable {
+  constexpr SquaresTable() {
+    for (unsigned char I = 0; I < 16; ++I)
+      Squares[I] = I * I;
+  }
+  unsigned char Squares[16] = {};
+};
 } // namespace
 
 GlobalClass nontrivial;
+__rom SquaresTable squares;
 
 int main() {
   puts("IN MAIN");
 
+  printf("SQUARE OF 9 FROM ROM: %d\n", squares.Squares[9]);
+
   InitStatic();
 
   ::atexit(C_AtExit);
@@ -0,0 +1,39 @@
+#include <cstdio>
+#include <pool.h>
+
+// This file shows the fixed-size object pool and bump-pointer arena in
+// mos-platform/common/include/pool.h.
+
+struct Node {
+  Node *Next;
+  int Value;
+};
+
+// Statically placed, so the compiler knows where the storage lives.
+static Pool<Node, 8> Nodes;
+static Arena<64> Scratch;
+
+int main() {
+  // Build a list out of pool nodes.
+  Node *Head = nullptr;
+  for (int I = 0; I < 8; ++I)
+    Head = Nodes.create(Node{Head, I});
+  printf("pool full: %d\n", Nodes.allocate() == nullptr);
+
+  // Freeing a node makes its slot the next one allocated.
+  Node *Second = Head->Next;
+  Head->Next = Second->Next;
+  Nodes.destroy(Second);
+  printf("slot reused: %d\n", Nodes.allocate() == Second);
+
+  // Everything allocated from an arena inside a Scope is freed when it ends.
+  {
+    Arena<64>::Scope S(Scratch);
+    char *Line = static_cast<char *>(Scratch.allocate(40));
+    snprintf(Line, 40, "head value: %d", Head->Value);
+    puts(Line);
+    printf("arena left: %u\n", (unsigned)Scratch.available());
+  }
+  printf("arena left: %u\n", (unsigned)Scratch.available());
+  return 0;
+}
@@ -123,6 +123,44 @@ int main() {
   printf("%d\n", DerivedStructArray[0]->c());
   printf("%d\n", DerivedStructArray[0]->d());
 
+  // soa::Vector is a variable-length array with fixed capacity, laid out the
+  // same way.
+  static soa::Vector<int, 10> IntVector;
+  IntVector.push_back(51);
+  IntVector.push_back(52);
+  for (int I : IntVector)
+    printf("%d\n", I);
+  IntVector.pop_back();
+  printf("%d\n", IntVector.size());
+
+  // soa::RingBuffer is a FIFO queue whose capacity is a power of two, so its
+  // indices wrap with a mask. One side may push while the other pops, e.g.,
+  // from an interrupt handler.
+  static soa::RingBuffer<int, 8> IntQueue;
+  IntQueue.push(53);
+  IntQueue.push(54);
+  int Popped;
+  while (IntQueue.pop(Popped))
+    printf("%d\n", Popped);
+
+  // field() gives a view of one member of every element, which can be
+  // indexed and iterated like the array itself, but only ever touches that
+  // member's bytes. fill() and for_each_index() are loops over the whole
+  // array; with constant-bound indices, their bodies stay absolute indexed.
+  struct Entity {
+    char X, Y;
+    signed char DX;
+  };
+  static soa::Array<Entity, 10> Entities;
+  Entities.fill({0, 0, 1});
+  auto X = Entities.field<&Entity::X>();
+  auto DX = Entities.field<&Entity::DX>();
+  Entities.for_each_index([&](uint8_t I) { X[I] += DX[I]; });
+  for (char EntityX : Entities.field<&Entity::X>())
+    printf("%d\n", EntityX);
+  Entities.field<&Entity::Y>().fill(55);
+  printf("%d\n", Entities[9]->Y);
+
   return 0;
 }
 
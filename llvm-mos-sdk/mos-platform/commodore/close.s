@@ -38,6 +38,14 @@ close:
         and     #LFN_OPEN
         beq     invalidfd
 
+; A file the fast loader opened is closed through it
+
+        lda     fdtab,x
+        and     #LFN_FAST
+        beq     1f
+        jmp     __cbm_fast_close
+1:
+
 ; Valid lfn, close it. The close call is always error free, at least as far
 ; as the kernal is involved
 
@@ -60,8 +68,11 @@ close:
         pla                     ; Get the error code from the disk
         jmp     __mappederrno  ; Set __oserror and _errno, return 0/-1
 
-; Error entry: The given file descriptor is not valid or not open
+; Error entry: The given file descriptor is not valid or not open. Without
+; the fast loader, no file is ever fast.
 
+.weak __cbm_fast_close
+__cbm_fast_close:
 invalidfd:
         lda     #EBADF
         jmp     __directerrno  ; Set _errno, clear __oserror, return -1
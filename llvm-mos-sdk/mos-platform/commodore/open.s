@@ -111,9 +111,18 @@ closeandexit:
 
 oserror:jmp     __mappederrno
 
-; Read bit is set. Add an 'R' to the name
+; Read bit is set. Let the fast loader take the file if it can, else add an
+; 'R' to the name
+
+doread: jsr     __cbm_fast_open ; Carry clear if taken, error code in A
+        bcs     1f
+        cmp     #$00
+        bne     oserror
+        lda     #(LFN_READ | LFN_FAST)
+        sta     __rc12
+        jmp     opened
 
-doread: lda     #'R'
+1:      lda     #'R'
         jsr     fnaddmode       ; Add the mode to the name
         lda     #LFN_READ
         bne     common          ; Branch always
@@ -175,7 +184,7 @@ nofile:                         ; ... else use SA=0 (read)
 
 ; File is open. Mark it as open in the table
 
-        ldx     __rc11
+opened: ldx     __rc11
         lda     __rc12
         sta     fdtab,x
         lda     fnunit
@@ -187,3 +196,11 @@ nofile:                         ; ... else use SA=0 (read)
         ldx     #0
         stx     __oserror      ; Clear __oserror
         rts
+
+;--------------------------------------------------------------------------
+; Without the fast loader (c64 fastload.o), the KERNAL opens every file
+
+.weak __cbm_fast_open
+__cbm_fast_open:
+        sec
+        rts
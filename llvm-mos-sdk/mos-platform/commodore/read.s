@@ -58,6 +58,13 @@ read:
         tya                     ; Get flags again
         bmi     eof
 
+; A file the fast loader opened is read through it
+
+        and     #LFN_FAST
+        beq     kernal
+        jmp     __cbm_fast_read
+kernal:
+
 ; Remember the device number.
 
         ldy     unittab-LFN_OFFS,x
@@ -138,8 +145,11 @@ devnotpresent:
         lda     #ENODEV
         .byte   $2C             ; Skip next opcode via BIT <abs>
 
-; Error entry: The given file descriptor is not valid or not open
+; Error entry: The given file descriptor is not valid or not open. Without
+; the fast loader, no file is ever fast.
 
+.weak __cbm_fast_read
+__cbm_fast_read:
 invalidfd:
         lda     #EBADF
         jmp     __directerrno   ; Sets _errno, clears __oserror, returns -1
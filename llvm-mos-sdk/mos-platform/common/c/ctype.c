@@ -1,71 +1,61 @@
 #include <ctype.h>
 
-int isalnum(int c) { return isalpha(c) || isdigit(c); }
-
-int isalpha(int c) {
-  char ch = (char)c;
-  return ((ch >= 'A') && (ch <= 'Z')) || ((ch >= 'a') && (ch <= 'z'));
-}
-
-int isblank(int c) {
-  char ch = (char)c;
-  return ch == ' ' || ch == '\t';
-}
-
-int iscntrl(int c) {
-  char ch = (char)c;
-  return ch < ' ';
-}
-
-int isdigit(int c) {
-  char ch = (char)c;
-  return ch >= '0' && ch <= '9';
-}
-
-int isgraph(int c) {
-  char ch = (char)c;
-  return isprint(c) && (c != ' ');
-}
-
-int islower(int c) {
-  char ch = (char)c;
-  return ch >= 'a' && ch <= 'z';
-}
-
-int isprint(int c) {
-  char ch = (char)c;
-  return ch > 0x1f && ch < 0x7f /*DEL*/;
-}
-
-int ispunct(int c) { return isprint(c) && !isspace(c) && !isalnum(c); }
-
-int isspace(int c) {
-  char ch = c;
-  return (ch == ' ') || (ch == '\t') || (ch == '\n') || (ch == '\f') ||
-         (ch == '\r') || (ch == '\v');
-}
-
-int isupper(int c) {
-  char ch = (char)c;
-  return ch >= 'A' && ch <= 'Z';
-}
-
-int isxdigit(int c) {
-  char ch = (char)c;
-  return ((ch >= '0') && (ch <= '9')) || ((ch >= 'a') && (ch <= 'f')) ||
-         ((ch >= 'A') && (ch <= 'F'));
-}
-
-int tolower(int c) {
-  char ch = (char)c;
-  if ((ch >= 'A') && (ch <= 'Z'))
-    ch |= 0x20;
-  return ch;
-}
-
-int toupper(int c) {
-  char ch = (char)c;
-  if ((ch >= 'a') && (ch <= 'z'))
-    ch &= ~0x20;
-  return ch;
-}
+#define U __CT_UPPER
+#define L __CT_LOWER
+#define D __CT_DIGIT
+#define S __CT_SPACE
+#define P __CT_PUNCT
+#define C __CT_CNTRL
+#define X __CT_HEX
+#define B __CT_BLANK
+
+// Only ASCII is classified; the rest of the table is zero.
+const unsigned char __ctype[256] = {
+    // 0x00
+    C, C, C, C, C, C, C, C, C, C | S, C | S, C | S, C | S, C | S, C, C,
+    // 0x10
+    C, C, C, C, C, C, C, C, C, C, C, C, C, C, C, C,
+    // 0x20  !"#$%&'()*+,-./
+    S | B, P, P, P, P, P, P, P, P, P, P, P, P, P, P, P,
+    // 0x30 0-9:;<=>?
+    D, D, D, D, D, D, D, D, D, D, P, P, P, P, P, P,
+    // 0x40 @A-O
+    P, U | X, U | X, U | X, U | X, U | X, U | X, U, U, U, U, U, U, U, U, U,
+    // 0x50 P-Z[\]^_
+    U, U, U, U, U, U, U, U, U, U, U, P, P, P, P, P,
+    // 0x60 `a-o
+    P, L | X, L | X, L | X, L | X, L | X, L | X, L, L, L, L, L, L, L, L, L,
+    // 0x70 p-z{|}~ DEL
+    L, L, L, L, L, L, L, L, L, L, L, P, P, P, P, C,
+};
+
+// The header's macros stand in for these in C; the parentheses keep them
+// from expanding here.
+
+int(isalnum)(int c) { return __ctype_is(c, U | L | D); }
+
+int(isalpha)(int c) { return __ctype_is(c, U | L); }
+
+int(isblank)(int c) { return c == ' ' || c == '\t'; }
+
+int(iscntrl)(int c) { return __ctype_is(c, C); }
+
+int(isdigit)(int c) { return __ctype_is(c, D); }
+
+int(isgraph)(int c) { return __ctype_is(c, U | L | D | P); }
+
+int(islower)(int c) { return __ctype_is(c, L); }
+
+int(isprint)(int c) { return __ctype_is(c, U | L | D | P | B); }
+
+int(ispunct)(int c) { return __ctype_is(c, P); }
+
+int(isspace)(int c) { return __ctype_is(c, S); }
+
+int(isupper)(int c) { return __ctype_is(c, U); }
+
+int(isxdigit)(int c) { return __ctype_is(c, D | X); }
+
+int(tolower)(int c) { return __ctype_is(c, U) ? c | 0x20 : c; }
+
+int(toupper)(int c) { return __ctype_is(c, L) ? c & ~0x20 : c; }
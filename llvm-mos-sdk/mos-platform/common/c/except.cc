@@ -0,0 +1,34 @@
+#include <except.h>
+
+#include <exception>
+
+namespace except {
+
+Frame *Top;
+Cleanup *Cleanups;
+
+Cleanup::Cleanup(void (*Fn)(void *), void *Arg)
+    : Prev(Cleanups), Fn(Fn), Arg(Arg) {
+  Cleanups = this;
+}
+
+// Cleanups leave scope in the reverse of the order they entered, so on a
+// normal exit this one is the newest.
+Cleanup::~Cleanup() { Cleanups = Prev; }
+
+void raise(int Code) {
+  Frame *F = Top;
+  if (!F)
+    std::terminate();
+  // Each is popped before it runs, so one that raises carries on from the
+  // next rather than running again.
+  while (Cleanups != F->Cleanups) {
+    Cleanup *C = Cleanups;
+    Cleanups = C->Prev;
+    C->Fn(C->Arg);
+  }
+  Top = F->Prev;
+  longjmp(F->Env, Code ? Code : 1);
+}
+
+} // namespace except
@@ -78,12 +78,55 @@ Chunk *heap_end() {
   return reinterpret_cast<Chunk *>(&__heap_start + heap_limit);
 }
 
-// The sum total available size on the free list.
+// The sum total available size on the free lists.
 size_t free_size;
 
-// A circularly-linked list of free chunks ordered by decreasing age. nullptr if
-// empty.
-FreeChunk *free_list;
+#ifdef _MALLOC_STATS
+// Kept only by the instrumented build, libmalloc_stats.
+size_t peak_used;
+unsigned long allocations[__HEAP_SIZE_CLASSES];
+
+void note_allocation(size_t size) {
+  char size_class = 0;
+  for (size >>= 1; size; size >>= 1)
+    ++size_class;
+  ++allocations[size_class];
+}
+
+void note_peak() {
+  size_t used = heap_limit - free_size;
+  if (used > peak_used)
+    peak_used = used;
+}
+#else
+void note_allocation(size_t) {}
+void note_peak() {}
+#endif
+
+// Free chunks are segregated by size into bins: one per size below
+// EXACT_BIN_LIMIT, then one per power of two. An allocation only considers
+// bins that can hold it, so it needn't walk past every small free chunk in the
+// heap to reach a big one.
+constexpr size_t EXACT_BIN_LIMIT = 32;
+static_assert(MIN_CHUNK_SIZE <= EXACT_BIN_LIMIT);
+constexpr unsigned NUM_EXACT_BINS = (EXACT_BIN_LIMIT - MIN_CHUNK_SIZE) / 2;
+// Chunk sizes are less than 2^16: one bin for each of [32, 64) to
+// [32768, 65536).
+constexpr unsigned NUM_BINS = NUM_EXACT_BINS + 11;
+
+// Each bin is a circularly-linked list of free chunks ordered by decreasing
+// age. nullptr if empty.
+FreeChunk *free_lists[NUM_BINS];
+
+// Returns the bin holding free chunks of the given size.
+unsigned bin_for(size_t size) {
+  if (size < EXACT_BIN_LIMIT)
+    return (size - MIN_CHUNK_SIZE) / 2;
+  unsigned bin = NUM_EXACT_BINS;
+  for (size /= 2 * EXACT_BIN_LIMIT; size; size >>= 1)
+    ++bin;
+  return bin;
+}
 
 // Free-ness is tracked by the next chunk's prev_free field, but the last chunk
 // has no next chunk.
@@ -120,6 +163,7 @@ void FreeChunk::remove() {
 
   free_size -= avail_size();
 
+  FreeChunk *&free_list = free_lists[bin_for(size())];
   if (free_list_next == this) {
     TRACE("Free list emptied.\n");
     free_list = nullptr;
@@ -140,6 +184,7 @@ FreeChunk *FreeChunk::insert(void *begin, size_t size) {
   chunk->trailing_size() = size;
   free_size += chunk->avail_size();
 
+  FreeChunk *&free_list = free_lists[bin_for(chunk->size())];
   if (!free_list) {
     free_list = chunk->free_list_next = chunk->free_list_prev = chunk;
     return chunk;
@@ -154,24 +199,31 @@ FreeChunk *FreeChunk::insert(void *begin, size_t size) {
   return chunk;
 }
 
-// Find the first chunk in the free list that can successfully fit a new chunk
-// of the given size.
+// Find a free chunk that can successfully fit a new chunk of the given size:
+// the first fit in the size's own bin, or else the oldest chunk in the next
+// non-empty bin, all of whose chunks fit.
 FreeChunk *find_fit(size_t size) {
   TRACE("find_fit(%u)\n", size);
 
-  if (!free_list) {
-    TRACE("Free list empty.\n");
-    return nullptr;
-  }
+  unsigned bin = bin_for(size);
+  if (FreeChunk *free_list = free_lists[bin]) {
+    bool first = true;
+    for (FreeChunk *chunk = free_list; first || chunk != free_list;
+         chunk = chunk->free_list_next, first = false) {
+      TRACE("Considering free chunk @ %p size %u\n", chunk, chunk->size());
 
-  bool first = true;
-  for (FreeChunk *chunk = free_list; first || chunk != free_list;
-       chunk = chunk->free_list_next, first = false) {
-    TRACE("Considering free chunk @ %p size %u\n", chunk, chunk->size());
+      if (size <= chunk->size()) {
+        TRACE("Selected.\n");
+        return chunk;
+      }
+    }
+  }
 
-    if (size <= chunk->size()) {
-      TRACE("Selected.\n");
-      return chunk;
+  for (++bin; bin < NUM_BINS; ++bin) {
+    if (free_lists[bin]) {
+      TRACE("Selected free chunk @ %p size %u from bin %u\n", free_lists[bin],
+            free_lists[bin]->size(), bin);
+      return free_lists[bin];
     }
   }
 
@@ -247,10 +299,10 @@ void __set_heap_limit(size_t new_limit) {
     FreeChunk *last = heap_end()->prev();
     TRACE("Last chunk free; size %u\n", last->size());
     size_t new_size = last->size() + grow;
-    last->set_size(new_size);
-    last->trailing_size() = new_size;
+    // Growing may move the chunk to another bin.
+    last->remove();
+    FreeChunk::insert(last, new_size);
     TRACE("Expanded to %u\n", new_size);
-    free_size += grow;
   } else {
     TRACE("Last chunk not free.\n");
     if (grow < MIN_CHUNK_SIZE) {
@@ -269,6 +321,40 @@ size_t __heap_bytes_used() { return heap_limit - free_size; }
 
 size_t __heap_bytes_free() { return free_size; }
 
+void __heap_stats(struct __heap_stats *stats) {
+  if (!initialized)
+    init();
+
+  stats->bytes_used = __heap_bytes_used();
+  stats->bytes_free = free_size;
+
+  // Bins only grow in size, so the largest free chunk is in the last
+  // non-empty one.
+  size_t largest = 0;
+  for (unsigned bin = NUM_BINS; bin--;) {
+    if (FreeChunk *free_list = free_lists[bin]) {
+      FreeChunk *chunk = free_list;
+      do {
+        if (chunk->avail_size() > largest)
+          largest = chunk->avail_size();
+        chunk = chunk->free_list_next;
+      } while (chunk != free_list);
+      break;
+    }
+  }
+  stats->largest_free = largest;
+  stats->fragmentation =
+      free_size ? (unsigned long)(free_size - largest) * 100 / free_size : 0;
+
+#ifdef _MALLOC_STATS
+  stats->peak_bytes_used = peak_used;
+  memcpy(stats->allocations, allocations, sizeof(allocations));
+#else
+  stats->peak_bytes_used = 0;
+  memset(stats->allocations, 0, sizeof(stats->allocations));
+#endif
+}
+
 // Return the size of chunk needed to hold a malloc request, or zero if
 // impossible.
 size_t chunk_size_for_malloc(size_t size) {
@@ -295,6 +381,7 @@ void *aligned_alloc(size_t alignment, size_t size) {
 
   if (!size)
     return nullptr;
+  note_allocation(size);
 
   // Only power of two alignments are valid.
   if (alignment & (alignment - 1))
@@ -304,23 +391,24 @@ void *aligned_alloc(size_t alignment, size_t size) {
   if (!size)
     return nullptr;
 
-  // The region before the aligned chunk needs to be large enough to fit a freereallocated chunk should not be free");
+  // The region before the aligned chunk needs to be large enough to fit a free
   // chunk.
-  if (__builtin_add_overflow(size, MIN_CHUNK_SIZE, &size))
+  size_t fit_size;
+  if (__builtin_add_overflow(size, MIN_CHUNK_SIZE, &fit_size))
     return nullptr;
 
   // Up to alignment-1 additional bytes may be needed to align the chunk start.
-  if (__builtin_add_overflow(size, alignment - 1, &size))
+  if (__builtin_add_overflow(fit_size, alignment - 1, &fit_size))
     return nullptr;
 
   if (!initialized)
     init();
 
-  FreeChunk *chunk = find_fit(size);
+  FreeChunk *chunk = find_fit(fit_size);
   if (!chunk)
     return nullptr;
 
-  void *aligned_ptr = (char *)chunk + MIN_CHUNK_SIZE;
+  void *aligned_ptr = (char *)chunk + MIN_CHUNK_SIZE + sizeof(Chunk);
   TRACE("Initial alignment point: %p\n", aligned_ptr);
 
   // alignment is a power of two, so alignment-1 is a mask that selects the
@@ -340,6 +428,7 @@ void *aligned_alloc(size_t alignment, size_t size) {
   size_t prev_chunk_size = (char *)aligned_chunk_begin - (char *)chunk;
 
   TRACE("Inserting free chunk before aligned.\n");
+  chunk->remove();
   FreeChunk::insert(chunk, prev_chunk_size); // prev_free remains unchanged.
 
   TRACE("Temporarily inserting aligned free chunk.\n");
@@ -348,7 +437,9 @@ void *aligned_alloc(size_t alignment, size_t size) {
   aligned_chunk->prev_free = true;
 
   TRACE("Allocating from aligned free chunk.\n");
-  return allocate_free_chunk(aligned_chunk, size);
+  void *ptr = allocate_free_chunk(aligned_chunk, size);
+  note_peak();
+  return ptr;
 }
 
 void *calloc(size_t num, size_t size) {
@@ -412,6 +503,7 @@ void *malloc(size_t size) {
     return nullptr;
 
   TRACE("malloc(%u)\n", size);
+  note_allocation(size);
 
   size = chunk_size_for_malloc(size);
   if (!size)
@@ -424,7 +516,9 @@ void *malloc(size_t size) {
   if (!chunk)
     return nullptr;
 
-  return allocate_free_chunk(chunk, size);
+  void *ptr = allocate_free_chunk(chunk, size);
+  note_peak();
+  return ptr;
 }
 
 void *realloc(void *ptr, size_t size) {
@@ -447,15 +541,15 @@ void *realloc(void *ptr, size_t size) {
   TRACE("Old size: %u\n", old_size);
 
   if (size < old_size) {
-    size_t shrink = size - old_size;
+    size_t shrink = old_size - size;
     TRACE("Shrinking by %u\n", shrink);
     Chunk *next = chunk->next();
-    chunk->set_size(size);
 
     if (next && next->free()) {
       size_t next_size = next->size();
       TRACE("Next free chunk %p size %u\n", next, next_size);
       // Coalesce.
+      chunk->set_size(size);
       static_cast<FreeChunk *>(next)->remove();
       FreeChunk::insert(chunk->end(), shrink + next_size)->prev_free = false;
       return ptr;
@@ -467,6 +561,7 @@ void *realloc(void *ptr, size_t size) {
       return ptr;
     }
 
+    chunk->set_size(size);
     FreeChunk *after = FreeChunk::insert(chunk->end(), shrink);
     TRACE("Allocated remainder %p of size %u\n", after, after->size());
     after->prev_free = false;
@@ -497,15 +592,48 @@ void *realloc(void *ptr, size_t size) {
         FreeChunk::insert(chunk->end(), next_size - grow);
       }
       chunk->set_free(false);
+      note_peak();
       return ptr;
     }
   }
 
+  // Failing that, the previous chunk, together with the next if it's free
+  // too, may have room. The contents slide down into it, which still beats
+  // finding and fragmenting a fresh chunk elsewhere.
+  if (chunk->prev_free) {
+    FreeChunk *prev = chunk->prev();
+    bool next_free = next && next->free();
+    size_t total = prev->size() + old_size;
+    if (next_free)
+      total += next->size();
+    if (size <= total) {
+      TRACE("Sliding down into previous chunk %p size %u\n", prev,
+            prev->size());
+      prev->remove();
+      if (next_free)
+        static_cast<FreeChunk *>(next)->remove();
+
+      // prev keeps its header, and with it prev_free.
+      char *new_ptr = (char *)prev + sizeof(Chunk);
+      memmove(new_ptr, ptr, old_size - sizeof(Chunk));
+
+      if (total - size < MIN_CHUNK_SIZE) {
+        prev->set_size(total);
+      } else {
+        prev->set_size(size);
+        FreeChunk::insert(prev->end(), total - size)->set_free(true);
+      }
+      prev->set_free(false);
+      note_peak();
+      return new_ptr;
+    }
+  }
+
   TRACE("Reallocating by copy.\n");
   void *new_ptr = malloc(malloc_size);
   if (!new_ptr)
     return nullptr;
-  memcpy(new_ptr, ptr, old_size);
+  memcpy(new_ptr, ptr, old_size - sizeof(Chunk));
   free(ptr);
   return new_ptr;
 }
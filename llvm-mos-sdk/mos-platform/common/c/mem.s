@@ -0,0 +1,149 @@
+.include "imag.inc"
+
+; Block copy and fill. Each copies whole 256-byte pages with an 8-bit Y index
+; off a zero-page pointer, bumping only the pointer's high byte per page, then
+; finishes with a tail of under 256 bytes. Requests under a page skip the page
+; loop entirely. All symbols are weak so targets can supply their own (e.g.,
+; using DMA).
+
+; void *memcpy(void *restrict s1, const void *restrict s2, size_t n)
+;
+; Copies upwards, which memmove relies on.
+.section .text.memcpy
+.weak memcpy
+memcpy:
+  ; Tail length.
+  sta __rc8
+
+  ; Walk the destination with __rc6/7, leaving s1 in __rc2/3 to return.
+  lda __rc2
+  sta __rc6
+  lda __rc3
+  sta __rc7
+
+  ldy #0
+  cpx #0
+  beq .Lmemcpy_tail
+.Lmemcpy_page:
+  lda (__rc4),y
+  sta (__rc6),y
+  iny
+  bne .Lmemcpy_page
+  inc __rc5
+  inc __rc7
+  dex
+  bne .Lmemcpy_page
+
+.Lmemcpy_tail:
+  cpy __rc8
+  beq .Lmemcpy_done
+.Lmemcpy_tail_loop:
+  lda (__rc4),y
+  sta (__rc6),y
+  iny
+  cpy __rc8
+  bne .Lmemcpy_tail_loop
+.Lmemcpy_done:
+  rts
+
+; void *memmove(void *s1, const void *s2, size_t n)
+.section .text.memmove
+.weak memmove
+memmove:
+  ; If s1 < s2, copying upwards never overwrites a byte before it's read.
+  sta __rc8
+  lda __rc2
+  cmp __rc4
+  lda __rc3
+  sbc __rc5
+  lda __rc8
+  bcs .Lmemmove_down
+  jmp memcpy
+
+  ; Otherwise, copy downwards from the end: first the tail, which lies in
+  ; the page after the last whole one, then the pages, last first. __rc4/5
+  ; and __rc6/7 point to the start of the page being copied.
+.Lmemmove_down:
+  lda __rc2
+  sta __rc6
+  txa
+  clc
+  adc __rc3
+  sta __rc7
+  txa
+  clc
+  adc __rc5
+  sta __rc5
+
+  ldy __rc8
+  beq .Lmemmove_pages
+.Lmemmove_tail:
+  dey
+  lda (__rc4),y
+  sta (__rc6),y
+  cpy #0
+  bne .Lmemmove_tail
+
+.Lmemmove_pages:
+  ; Y is zero, so the first dey below wraps it to 255.
+  cpx #0
+  beq .Lmemmove_done
+.Lmemmove_page:
+  dec __rc5
+  dec __rc7
+.Lmemmove_page_loop:
+  dey
+  lda (__rc4),y
+  sta (__rc6),y
+  cpy #0
+  bne .Lmemmove_page_loop
+  dex
+  bne .Lmemmove_page
+.Lmemmove_done:
+  rts
+
+; void *memset(void *ptr, int value, size_t num)
+;
+; Shuffles its arguments into __memset's and falls through to it; __memset
+; leaves ptr in __rc2/3 to return.
+.section .text.memset
+.weak memset
+memset:
+  ldx __rc4
+  ldy __rc5
+  sty __rc4
+  ; Fall through.
+
+; void __memset(char *ptr, char value, size_t num)
+.weak __memset
+__memset:
+  ; Tail length.
+  stx __rc5
+
+  ldy __rc2
+  sty __rc6
+  ldy __rc3
+  sty __rc7
+
+  ldy #0
+  ldx __rc4
+  beq .Lmemset_tail
+.Lmemset_page:
+  sta (__rc6),y
+  iny
+  bne .Lmemset_page
+  inc __rc7
+  dex
+  bne .Lmemset_page
+
+  ; Order doesn't matter, so fill the tail downwards and let dey set the
+  ; flags.
+.Lmemset_tail:
+  ldy __rc5
+  beq .Lmemset_done
+.Lmemset_tail_loop:
+  dey
+  sta (__rc6),y
+  bne .Lmemset_tail_loop
+.Lmemset_done:
+  rts
@@ -0,0 +1,47 @@
+// Integer conversions for print.h.
+
+#include <print.h>
+
+namespace {
+
+// Decimal by repeated subtraction of each power of ten: at most nine
+// subtractions a digit, against the shifting and BCD carries of printf's
+// general conversion.
+template <class U, size_t N>
+char print_digits(U value, char *buf, const U (&powers)[N]) {
+  uint8_t len = 0;
+  for (const U power : powers) {
+    char digit = '0';
+    while (value >= power) {
+      value -= power;
+      ++digit;
+    }
+    if (len || digit != '0')
+      buf[len++] = digit;
+  }
+  buf[len++] = '0' + value;
+  return len;
+}
+
+const uint8_t powers8[] = {100, 10};
+const uint16_t powers16[] = {10000, 1000, 100, 10};
+const uint32_t powers32[] = {1000000000, 100000000, 10000000, 1000000, 100000,
+                             10000,      1000,      100,      10};
+
+} // namespace
+
+extern "C" {
+
+char __print_u8(uint8_t value, char *buf) {
+  return print_digits(value, buf, powers8);
+}
+
+char __print_u16(uint16_t value, char *buf) {
+  return print_digits(value, buf, powers16);
+}
+
+char __print_u32(uint32_t value, char *buf) {
+  return print_digits(value, buf, powers32);
+}
+
+} // extern "C"
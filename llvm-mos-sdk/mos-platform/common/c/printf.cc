@@ -17,15 +17,39 @@
 
 namespace {
 
-void put(char c, Status *status) {
-  if (status->i < status->n) {
-    if (status->stream)
-      putc(c, status->stream);
-    else
+// Output sinks. Each formatting routine is instantiated per sink, so the
+// *sprintf family stores straight into its buffer, without testing per
+// character whether there's a stream to write instead.
+
+struct BufferSink {
+  static void put(char c, Status *status) {
+    if (status->i < status->n)
       status->s[status->i] = c;
+    ++status->i;
   }
-  ++status->i;
-}
+
+  // One bounds check for the lot.
+  static void write(const char *s, size_t len, Status *status) {
+    if (status->i < status->n) {
+      size_t room = status->n - status->i;
+      memcpy(status->s + status->i, s, len < room ? len : room);
+    }
+    status->i += len;
+  }
+};
+
+struct StreamSink {
+  static void put(char c, Status *status) {
+    if (status->i < status->n)
+      putc(c, status->stream);
+    ++status->i;
+  }
+
+  static void write(const char *s, size_t len, Status *status) {
+    while (len--)
+      put(*s++, status);
+  }
+};
 
 #define E_minus (INT32_C(1) << 0)
 #define E_plus (INT32_C(1) << 1)
@@ -42,15 +66,17 @@ void put(char c, Status *status) {
 #define E_exponent (INT32_C(1) << 9)
 #define E_generic (INT32_C(1) << 10)
 
+template <class Sink>
 void print_string_padding(size_t prec, Status *status) {
   if (status->width <= prec)
     return;
 
   size_t padding = status->width - prec;
   while (padding--)
-    put(' ', status);
+    Sink::put(' ', status);
 }
 
+template <class Sink>
 void print_string(const char *s, Status *status) {
   size_t prec = status->prec < 0 ? SIZE_MAX : status->prec;
   for (size_t i = 0; i < prec; ++i) {
@@ -61,13 +87,12 @@ void print_string(const char *s, Status *status) {
   }
 
   if (!(status->flags & E_minus))
-    print_string_padding(prec, status);
+    print_string_padding<Sink>(prec, status);
 
-  while (prec-- > 0)
-    put(*s++, status);
+  Sink::write(s, prec, status);
 
   if (status->flags & E_minus)
-    print_string_padding(prec, status);
+    print_string_padding<Sink>(prec, status);
 }
 
 using namespace __impl;
@@ -98,6 +123,9 @@ public:
 
   BcdVarInt &operator++();
 
+  // Append a new most significant digit.
+  void push(char digit) { bytes()[size_++] = digit; }
+
   void mul2();
   void mul5_in_base_10();
   void div_pow_base(Size pow);
@@ -178,6 +206,7 @@ char bcd_to_char(char bcd, bool lower) {
   return (lower ? 'a' : 'A') + (bcd - 10);
 }
 
+template <class Sink>
 void print_bcd_int(BcdVarInt &value, bool negative, Status *status) {
   size_t prec = status->prec < 0 ? 1 : status->prec;
   if (status->flags & E_alt && status->base == 8 && prec < value.size() + 1)
@@ -212,38 +241,75 @@ void print_bcd_int(BcdVarInt &value, bool negative, Status *status) {
 
   if (!(status->flags & (E_minus | E_zero)))
     for (; padding; --padding)
-      put(' ', status);
+      Sink::put(' ', status);
 
   if (prefix_width)
-    put(prefix[0], status);
+    Sink::put(prefix[0], status);
   if (prefix_width == 2)
-    put(prefix[1], status);
+    Sink::put(prefix[1], status);
 
   if (status->flags & E_zero && !(status->flags & E_minus))
     for (; padding; --padding)
-      put('0', status);
+      Sink::put('0', status);
 
   while (prec-- > value.size())
-    put('0', status);
+    Sink::put('0', status);
 
   if (value.size()) {
     for (char i = value.size() - 1; i != 0; i--)
-      put(bcd_to_char(value.bytes()[i], status->flags & E_lower), status);
-    put(bcd_to_char(value.bytes()[0], status->flags & E_lower), status);
+      Sink::put(bcd_to_char(value.bytes()[i], status->flags & E_lower), status);
+    Sink::put(bcd_to_char(value.bytes()[0], status->flags & E_lower), status);
   }
 
   if (status->flags & E_minus)
     for (; padding; --padding)
-      put(' ', status);
+      Sink::put(' ', status);
 }
 
+// Most integers printed are 32 bits or less, usually 16 or less, and for
+// those, double dabble's full pass over the BCD digits for every bit is
+// wasted. Instead, decimal goes through print.cc's fixed-width
+// subtract-powers-of-ten routines, and octal and hex peel off digits by
+// shifting.
+template <typename T>
+void fixed_int_to_bcd(T value, BcdVarInt &bcd, char base) {
+  // Zero has no digits, as from int_to_bcd.
+  if (!value)
+    return;
+  if (base == 10) {
+    char digits[10];
+    char len;
+    if constexpr (sizeof(T) == 1)
+      len = __print_u8(value, digits);
+    else if constexpr (sizeof(T) == 2)
+      len = __print_u16(value, digits);
+    else
+      len = __print_u32(value, digits);
+    while (len)
+      bcd.push(digits[--len] - '0');
+    return;
+  }
+  const char shift = base == 16 ? 4 : 3;
+  for (; value; value >>= shift)
+    bcd.push(value & (base - 1));
+}
+
+template <class Sink>
 void print_int(VarInt &value, bool negative, Status *status) {
   BcdBigInt<sizeof("18446744073709551615")> bcd(status->base);
-  int_to_bcd(value, bcd);
-  print_bcd_int(bcd, negative, status);
+  if (value.size() == sizeof(uint8_t))
+    fixed_int_to_bcd<uint8_t>(value, bcd, status->base);
+  else if (value.size() == sizeof(uint16_t))
+    fixed_int_to_bcd<uint16_t>(value, bcd, status->base);
+  else if (value.size() == sizeof(uint32_t))
+    fixed_int_to_bcd<uint32_t>(value, bcd, status->base);
+  else
+    int_to_bcd(value, bcd);
+  print_bcd_int<Sink>(bcd, negative, status);
 }
 
 #ifdef _PRINTF_FLOAT
+template <class Sink>
 void print_double(double value, Status *status) {
   size_t prec;
   if (status->prec < 0)
@@ -275,7 +341,7 @@ void print_double(double value, Status *status) {
     if (!(status->flags & E_lower))
       for (char *s = str; *s; s++)
         *s = toupper(*s);
-    print_string(str, status);
+    print_string<Sink>(str, status);
     return;
   }
 
@@ -459,79 +525,81 @@ void print_double(double value, Status *status) {
 
   if (!(status->flags & (E_zero | E_minus)))
     while (padding--)
-      put(' ', status);
+      Sink::put(' ', status);
 
   if (val_repr.repr.sign)
-    put('-', status);
+    Sink::put('-', status);
   else if (status->flags & E_plus)
-    put('+', status);
+    Sink::put('+', status);
   else if (status->flags & E_space)
-    put(' ', status);
+    Sink::put(' ', status);
 
   if (status->base == 16) {
-    put('0', status);
-    put(status->flags & E_lower ? 'x' : 'X', status);
+    Sink::put('0', status);
+    Sink::put(status->flags & E_lower ? 'x' : 'X', status);
   }
 
   if (status->flags & E_zero)
     while (padding--)
-      put('0', status);
+      Sink::put('0', status);
 
   // Print the whole part of the number
   if (ones_idx < bcd.size()) {
     // ones_idx may be zero.
     for (BcdVarInt::Size i = bcd.size() - 1; i > ones_idx; --i) {
-      put(bcd_to_char(bcd.bytes()[i], status), status);
+      Sink::put(bcd_to_char(bcd.bytes()[i], status), status);
     }
-    put(bcd_to_char(bcd.bytes()[ones_idx], status), status);
+    Sink::put(bcd_to_char(bcd.bytes()[ones_idx], status), status);
   } else {
-    put('0', status);
+    Sink::put('0', status);
   }
 
   if (has_period)
-    put('.', status);
+    Sink::put('.', status);
 
   // Print the fractional part of the number.
   for (int i = (int)ones_idx - 1; prec--; --i) {
     if (i >= 0 && i < bcd.size()) {
-      put(bcd_to_char(bcd.bytes()[i], status), status);
+      Sink::put(bcd_to_char(bcd.bytes()[i], status), status);
     } else {
-      put('0', status);
+      Sink::put('0', status);
     }
   }
 
   if (status->flags & E_exponent) {
     if (status->base == 16)
-      put(status->flags & E_lower ? 'p' : 'P', status);
+      Sink::put(status->flags & E_lower ? 'p' : 'P', status);
     else
-      put(status->flags & E_lower ? 'e' : 'E', status);
-    put(exp_neg ? '-' : '+', status);
+      Sink::put(status->flags & E_lower ? 'e' : 'E', status);
+    Sink::put(exp_neg ? '-' : '+', status);
     for (char i = status->base == 16 ? 1 : 2; i > exp_bcd.size(); --i)
-      put('0', status);
+      Sink::put('0', status);
     if (exp_bcd.size()) {
       for (char i = exp_bcd.size() - 1; i > 0; --i)
-        put('0' + exp_bcd.bytes()[i], status);
-      put('0' + exp_bcd.bytes()[0], status);
+        Sink::put('0' + exp_bcd.bytes()[i], status);
+      Sink::put('0' + exp_bcd.bytes()[0], status);
     }
   }
 
   if (status->flags & E_minus)
     while (padding--)
-      put(' ', status);
+      Sink::put(' ', status);
 }
 
+template <class Sink>
 void print_ldouble(long double value, Status *status) {
-  print_double(value, status);
+  print_double<Sink>(value, status);
 }
 
 #endif
 
+template <class Sink>
 const char *print(const char *spec, Status *status) {
   const char *orig_spec = spec;
 
   if (*(++spec) == '%') {
     /* %% -> print single '%' */
-    put(*spec, status);
+    Sink::put(*spec, status);
     return ++spec;
   }
 
@@ -762,13 +830,13 @@ flags_done:;
     char c_str[2];
     c_str[0] = (char)va_arg(status->arg, int);
     c_str[1] = '\0';
-    print_string(c_str, status);
+    print_string<Sink>(c_str, status);
     return ++spec;
   }
 
   case 's':
     /* TODO: wide chars. */
-    print_string(va_arg(status->arg, char *), status);
+    print_string<Sink>(va_arg(status->arg, char *), status);
     return ++spec;
 
   case 'p':
@@ -795,10 +863,10 @@ flags_done:;
       /* Floating Point conversions */
       if (status->flags & E_ldouble) {
         long double value = va_arg(status->arg, long double);
-        print_ldouble(value, status);
+        print_ldouble<Sink>(value, status);
       } else {
         double value = va_arg(status->arg, double);
-        print_double(value, status);
+        print_double<Sink>(value, status);
       }
     } else
 #endif // _PRINTF_FLOAT
@@ -812,21 +880,18 @@ flags_done:;
       bool negative = !(status->flags & E_unsigned) && value.negative();
       if (negative)
         value.negate();
-      print_int(value, negative, status);
+      print_int<Sink>(value, negative, status);
     }
 
 #if 0
     if (status->flags & E_minus) {
       /* Left-aligned filling */
       while (status->current < status->width) {
-        put(' ', status);
+        Sink::put(' ', status);
         ++(status->current);
       }
     }
 #endif
-
-    if (status->i >= status->n && status->n > 0)
-      status->s[status->n - 1] = '\0';
   }
 
   return ++spec;
@@ -890,7 +955,8 @@ __attribute__((weak)) int vfprintf(FILE *__restrict__ stream,
   while (*format != '\0') {
     const char *rc;
 
-    if ((*format != '%') || ((rc = print(format, &status)) == format)) {
+    if ((*format != '%') ||
+        ((rc = print<StreamSink>(format, &status)) == format)) {
       /* No conversion specifier, print verbatim */
       if (putc(*format++, stream) == EOF)
         return EOF;
@@ -925,22 +991,26 @@ __attribute__((weak)) int vsnprintf(char *__restrict__ s, size_t n,
   while (*format != '\0') {
     const char *rc;
 
-    if ((*format != '%') || ((rc = print(format, &status)) == format)) {
+    if (*format != '%') {
+      /* Copy the run of verbatim text up to the next conversion at once */
+      const char *end = format;
+      while (*end != '\0' && *end != '%')
+        ++end;
+      BufferSink::write(format, end - format, &status);
+      format = end;
+    } else if ((rc = print<BufferSink>(format, &status)) == format) {
       /* No conversion specifier, print verbatim */
-      if (status.i < n)
-        s[status.i] = *format;
-
-      status.i++;
-      format++;
+      BufferSink::put(*format++, &status);
     } else {
       /* Continue parsing after conversion specifier */
       format = rc;
     }
   }
 
-  if (status.i < n) {
+  if (status.i < n)
     s[status.i] = '\0';
-  }
+  else if (n)
+    s[n - 1] = '\0';
 
   va_end(status.arg);
   return status.i;
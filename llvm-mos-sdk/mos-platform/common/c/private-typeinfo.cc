@@ -10,6 +10,7 @@
 
 #include <cstddef>
 
+#include <stdint.h>
 #include <string.h>
 
 #ifdef _LIBCXXABI_FORGIVING_DYNAMIC_CAST
@@ -191,6 +192,21 @@ void __class_type_info::process_found_base_class(
 //    (static_ptr, static_type), then return dynamic_ptr.
 // Else return nullptr.
 
+// Recent __dynamic_cast results, direct-mapped on (dynamic_type, dst_type).
+// The complete object's type and the static subobject's place in it fix the
+// answer, so it's kept as the destination's offset from dynamic_ptr and a hit
+// skips the DAG search -- the bulk of a cast's cost on a 6502.
+struct __dynamic_cast_cache_entry {
+  const __class_type_info *dynamic_type; // 0 if unused
+  const __class_type_info *static_type;
+  const __class_type_info *dst_type;
+  ptrdiff_t offset_to_derived;
+  ptrdiff_t dst_offset; // -1 (never a valid offset) if the cast fails
+};
+
+static constexpr unsigned dynamic_cast_cache_size = 8;
+static __dynamic_cast_cache_entry dynamic_cast_cache[dynamic_cast_cache_size];
+
 extern "C" _LIBCXXABI_FUNC_VIS void *
 __dynamic_cast(const void *static_ptr, const __class_type_info *static_type,
                const __class_type_info *dst_type,
@@ -205,6 +221,20 @@ __dynamic_cast(const void *static_ptr, const __class_type_info *static_type,
   const __class_type_info *dynamic_type =
       static_cast<const __class_type_info *>(vtable[-1]);
 
+  __dynamic_cast_cache_entry &cached =
+      dynamic_cast_cache[((reinterpret_cast<uintptr_t>(dynamic_type) ^
+                           reinterpret_cast<uintptr_t>(dst_type)) >>
+                          1) %
+                         dynamic_cast_cache_size];
+  if (cached.dynamic_type == dynamic_type &&
+      cached.static_type == static_type && cached.dst_type == dst_type &&
+      cached.offset_to_derived == offset_to_derived) {
+    if (cached.dst_offset < 0)
+      return nullptr;
+    return const_cast<char *>(static_cast<const char *>(dynamic_ptr) +
+                              cached.dst_offset);
+  }
+
   // Initialize answer to nullptr.  This will be changed from the search
   //    results if a non-null answer is found.  Regardless, this is what will
   //    be returned.
@@ -261,6 +291,15 @@ __dynamic_cast(const void *static_ptr, const __class_type_info *static_type,
       break;
     }
   }
+
+  cached.dynamic_type = dynamic_type;
+  cached.static_type = static_type;
+  cached.dst_type = dst_type;
+  cached.offset_to_derived = offset_to_derived;
+  cached.dst_offset =
+      dst_ptr ? static_cast<const char *>(dst_ptr) -
+                    static_cast<const char *>(dynamic_ptr)
+              : -1;
   return const_cast<void *>(dst_ptr);
 }
 
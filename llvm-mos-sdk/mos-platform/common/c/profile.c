@@ -0,0 +1,77 @@
+#define MOS_PROFILE
+#include <6502-profile.h>
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#define RING_SIZE 64
+
+// mos-sim reads the ring from memory, at the address sim's library tells it, so
+// this layout is fixed: size, next, wrapped, then size 7-byte records.
+typedef struct {
+  const char *name;
+  uint8_t exit;
+  uint32_t time;
+} Record;
+
+struct {
+  uint8_t size;
+  uint8_t next;
+  uint8_t wrapped;
+  Record records[RING_SIZE];
+} __mos_profile_ring = {.size = RING_SIZE};
+
+static Record *next_record(void) {
+  Record *r = &__mos_profile_ring.records[__mos_profile_ring.next];
+  if (++__mos_profile_ring.next == RING_SIZE) {
+    __mos_profile_ring.next = 0;
+    __mos_profile_ring.wrapped = 1;
+  }
+  return r;
+}
+
+// Entry takes its time last and exit first, so a scope counts as little of
+// the bookkeeping as possible.
+const char *__mos_profile_enter(const char *name) {
+  Record *r = next_record();
+  r->name = name;
+  r->exit = 0;
+  r->time = __mos_profile_clock();
+  return name;
+}
+
+void __mos_profile_exit(const char *const *name) {
+  const uint32_t time = __mos_profile_clock();
+  Record *r = next_record();
+  r->name = *name;
+  r->exit = 1;
+  r->time = time;
+}
+
+void mos_profile_dump(void) {
+  // Entries of the scopes open at each point, oldest first.
+  static uint8_t open[RING_SIZE];
+  uint8_t depth = 0;
+
+  const bool wrapped = __mos_profile_ring.wrapped;
+  uint8_t i = wrapped ? __mos_profile_ring.next : 0;
+  uint8_t left = wrapped ? RING_SIZE : __mos_profile_ring.next;
+  for (; left; --left, i = (i + 1) % RING_SIZE) {
+    const Record *r = &__mos_profile_ring.records[i];
+    if (!r->exit) {
+      open[depth++] = i;
+      continue;
+    }
+    // A scope left by longjmp never records its exit; skip past it.
+    uint8_t d = depth;
+    while (d && __mos_profile_ring.records[open[d - 1]].name != r->name)
+      --d;
+    // Otherwise, the entry is older than the ring.
+    if (!d)
+      continue;
+    depth = d - 1;
+    const Record *entry = &__mos_profile_ring.records[open[depth]];
+    printf("%*s%s %lu\n", depth * 2, "", r->name,
+           (unsigned long)(r->time - entry->time));
+  }
+}
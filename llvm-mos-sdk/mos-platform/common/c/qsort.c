@@ -4,6 +4,7 @@
 // See https://github.com/llvm-mos/llvm-mos-sdk/blob/main/LICENSE for license
 // information.
 
+#include <stdint.h>
 #include <stdlib.h>
 
 // Originally from the Public Domain C Library (PDCLib).
@@ -18,6 +19,19 @@
 
 static void memswp(char *i, char *j, size_t size) {
   char tmp;
+  // Elements are nearly always under a page, so an 8-bit index off fixed i
+  // and j, (zp),y on the 6502, can replace bumping both pointers and a 16-bit
+  // count per byte.
+  if (size < 0x100) {
+    const uint8_t n = size;
+    uint8_t k = 0;
+    do {
+      tmp = i[k];
+      i[k] = j[k];
+      j[k] = tmp;
+    } while (++k != n);
+    return;
+  }
   do {
     tmp = *i;
     *i++ = *j;
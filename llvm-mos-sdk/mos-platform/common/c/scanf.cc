@@ -377,6 +377,9 @@ const char *scan(const char *spec, Status *status) {
 
     VarInt &value = VarInt::make(space, size);
     value.zero();
+    // Values of up to 32 bits accumulate in a native integer instead.
+    uint16_t narrow = 0;
+    uint32_t wide = 0;
 
     bool prefix_parsed = false;
     signed char sign = 0;
@@ -460,8 +463,14 @@ const char *scan(const char *spec, Status *status) {
               break;
             }
 
-            value *= status->base;
-            value += digit;
+            if (size <= sizeof(narrow))
+              narrow = __mul_add(narrow, status->base, digit);
+            else if (size <= sizeof(wide))
+              wide = __mul_add(wide, status->base, digit);
+            else {
+              value *= status->base;
+              value += digit;
+            }
             value_parsed = true;
           }
         }
@@ -481,11 +490,22 @@ const char *scan(const char *spec, Status *status) {
 
     /* convert value to target type and assign to parameter */
     if (!(status->flags & E_suppressed)) {
-      if (sign == -1)
-        value.negate();
       // Undefined behavior, but should be fine; we're the compiler.
       void *dst = va_arg(status->arg, void *);
-      memcpy(dst, value.bytes(), value.size());
+      // Only the low size bytes are copied out, little-endian.
+      if (size <= sizeof(narrow)) {
+        if (sign == -1)
+          narrow = -narrow;
+        memcpy(dst, &narrow, size);
+      } else if (size <= sizeof(wide)) {
+        if (sign == -1)
+          wide = -wide;
+        memcpy(dst, &wide, size);
+      } else {
+        if (sign == -1)
+          value.negate();
+        memcpy(dst, value.bytes(), value.size());
+      }
       ++status->n;
     }
 
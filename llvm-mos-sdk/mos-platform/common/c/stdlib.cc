@@ -192,6 +192,62 @@ void strtox(const char *__restrict__ nptr, char **__restrict endptr, int base,
   return;
 }
 
+// For 8- and 16-bit results, the magnitude accumulates in a native integer
+// twice as wide, so one comparison against the limit catches overflow.
+template <typename T>
+T strtox_fixed(const char *__restrict__ nptr, char **__restrict endptr,
+               int base) {
+  static_assert(sizeof(T) <= 2);
+  using U = std::make_unsigned_t<T>;
+  using W = std::conditional_t<sizeof(T) == 1, uint16_t, uint32_t>;
+
+  if (base && (base < 2 || base > 36))
+    return 0;
+
+  char sign = '+';
+  char cbase = base;
+  const char *p = strtox_prelim(nptr, &sign, &cbase);
+  if (!cbase)
+    return 0;
+  bool negative = sign == '-';
+
+  W limit = std::numeric_limits<U>::max();
+  if constexpr (std::is_signed_v<T>)
+    limit = negative ? W(std::numeric_limits<T>::max()) + 1
+                     : std::numeric_limits<T>::max();
+
+  signed char digit = __parse_digit(*p, cbase);
+  if (digit < 0) {
+    if (endptr != NULL)
+      *endptr = (char *)nptr;
+    return 0;
+  }
+
+  W value = 0;
+  do {
+    value = __mul_add(value, cbase, digit);
+    if (value > limit) {
+      errno = ERANGE;
+      while (__parse_digit(*p, cbase) != -1)
+        ++p;
+      if (endptr != NULL)
+        *endptr = (char *)p;
+      if constexpr (std::is_signed_v<T>)
+        return negative ? std::numeric_limits<T>::min()
+                        : std::numeric_limits<T>::max();
+      return std::numeric_limits<T>::max();
+    }
+    ++p;
+  } while ((digit = __parse_digit(*p, cbase)) >= 0);
+
+  if (endptr != NULL)
+    *endptr = (char *)p;
+  U rc = value;
+  if (negative)
+    rc = -rc;
+  return rc;
+}
+
 } // namespace
 
 extern "C" {
@@ -226,30 +282,22 @@ strtoull(const char *__restrict__ nptr, char **__restrict__ endptr, int base) {
 
 __attribute__((weak)) signed char _strtosc(const char *__restrict__ nptr,
                                            char **__restrict endptr, int base) {
-  BigInt<sizeof(signed char)> rc;
-  strtox(nptr, endptr, base, /*is_signed=*/true, rc);
-  return rc;
+  return strtox_fixed<signed char>(nptr, endptr, base);
 }
 
 __attribute__((weak)) unsigned char
 _strtouc(const char *__restrict__ nptr, char **__restrict__ endptr, int base) {
-  BigInt<sizeof(unsigned char)> rc;
-  strtox(nptr, endptr, base, /*is_signed=*/false, rc);
-  return rc;
+  return strtox_fixed<unsigned char>(nptr, endptr, base);
 }
 
 __attribute__((weak)) int _strtoi(const char *__restrict__ nptr,
                                   char **__restrict endptr, int base) {
-  BigInt<sizeof(int)> rc;
-  strtox(nptr, endptr, base, /*is_signed=*/true, rc);
-  return rc;
+  return strtox_fixed<int>(nptr, endptr, base);
 }
 
 __attribute__((weak)) unsigned int
 _strtoui(const char *__restrict__ nptr, char **__restrict__ endptr, int base) {
-  BigInt<sizeof(unsigned int)> rc;
-  strtox(nptr, endptr, base, /*is_signed=*/false, rc);
-  return rc;
+  return strtox_fixed<unsigned int>(nptr, endptr, base);
 }
 
 } // extern "C"
@@ -0,0 +1,155 @@
+.include "imag.inc"
+
+; String scans and copies. Each walks its strings with an 8-bit Y index off
+; zero-page pointers, bumping only the pointers' high bytes when Y wraps to
+; start the next 256-byte window, so the inner loops are a handful of
+; instructions a byte. All symbols are weak so targets can supply their own.
+
+; size_t strlen(const char *s)
+.section .text.strlen
+.weak strlen
+strlen:
+  ; The length's high byte is the number of windows crossed.
+  lda __rc3
+  sta __rc4
+
+  ldy #0
+.Lstrlen_loop:
+  lda (__rc2),y
+  beq .Lstrlen_done
+  iny
+  bne .Lstrlen_loop
+  inc __rc3
+  jmp .Lstrlen_loop
+
+.Lstrlen_done:
+  sec
+  lda __rc3
+  sbc __rc4
+  tax
+  tya
+  rts
+
+; strcat shares strcpy's copy loop, so they share a section.
+.section .text.strcpy
+
+; char *strcpy(char *restrict s1, const char *restrict s2)
+.weak strcpy
+strcpy:
+  ; Walk the destination with __rc6/7, leaving s1 in __rc2/3 to return.
+  lda __rc2
+  sta __rc6
+  lda __rc3
+  sta __rc7
+
+.Lstrcpy_start:
+  ldy #0
+.Lstrcpy_loop:
+  lda (__rc4),y
+  sta (__rc6),y
+  beq .Lstrcpy_done
+  iny
+  bne .Lstrcpy_loop
+  inc __rc5
+  inc __rc7
+  jmp .Lstrcpy_loop
+.Lstrcpy_done:
+  rts
+
+; char *strcat(char *restrict s1, const char *restrict s2)
+;
+; Finds the end of s1, then copies s2 there in the same call, never
+; revisiting s1.
+.weak strcat
+strcat:
+  lda __rc2
+  sta __rc6
+  lda __rc3
+  sta __rc7
+
+  ldy #0
+.Lstrcat_scan:
+  lda (__rc6),y
+  beq .Lstrcat_end
+  iny
+  bne .Lstrcat_scan
+  inc __rc7
+  jmp .Lstrcat_scan
+
+  ; Point __rc6/7 at the terminator, and copy over it.
+.Lstrcat_end:
+  tya
+  clc
+  adc __rc6
+  sta __rc6
+  bcc .Lstrcpy_start
+  inc __rc7
+  jmp .Lstrcpy_start
+
+; int strcmp(const char *s1, const char *s2)
+;
+; Returns -1, 0 or 1, comparing as unsigned char.
+.section .text.strcmp
+.weak strcmp
+strcmp:
+  ldy #0
+.Lstrcmp_loop:
+  lda (__rc2),y
+  cmp (__rc4),y
+  bne .Lstrcmp_differ
+  ; Equal; stop if both end here. This leaves 0 in X, and A.
+  tax
+  beq .Lstrcmp_done
+  iny
+  bne .Lstrcmp_loop
+  inc __rc3
+  inc __rc5
+  jmp .Lstrcmp_loop
+
+  ; A string that ends first has the smaller byte, its NUL.
+.Lstrcmp_differ:
+  bcc .Lstrcmp_less
+  lda #1
+  ldx #0
+  rts
+.Lstrcmp_less:
+  lda #$ff
+  tax
+.Lstrcmp_done:
+  rts
+
+; char *strchr(const char *s, int c)
+.section .text.strchr
+.weak strchr
+strchr:
+  sta __rc4
+
+  ldy #0
+.Lstrchr_loop:
+  lda (__rc2),y
+  beq .Lstrchr_end
+  cmp __rc4
+  beq .Lstrchr_found
+  iny
+  bne .Lstrchr_loop
+  inc __rc3
+  jmp .Lstrchr_loop
+
+  ; The terminator counts as part of the string, so it's found if c is 0.
+.Lstrchr_end:
+  lda __rc4
+  beq .Lstrchr_found
+  lda #0
+  sta __rc2
+  sta __rc3
+  rts
+
+.Lstrchr_found:
+  tya
+  clc
+  adc __rc2
+  sta __rc2
+  bcc .Lstrchr_done
+  inc __rc3
+.Lstrchr_done:
+  rts
@@ -6,16 +6,9 @@
 
 #include <string.h>
 
-// Copying functions
+// strcpy, strcat, strcmp, strchr and strlen are in str.s.
 
-__attribute__((weak)) char *strcpy(char *restrict s1, const char *restrict s2) {
-  char *ret = s1;
-  for (;; ++s1, ++s2) {
-    *s1 = *s2;
-    if (!*s1)
-      return ret;
-  }
-}
+// Copying functions
 
 __attribute__((weak)) char *strncpy(char *restrict s1, const char *restrict s2,
                                     size_t n) {
@@ -33,32 +26,17 @@ __attribute__((weak)) char *strncpy(char *restrict s1, const char *restrict s2,
 
 // Concatenation functions
 
-__attribute__((weak)) char *strcat(char *restrict s1, const char *restrict s2) {
-  size_t len = strlen(s1);
-  strcpy(s1 + len, s2);
-  return s1;
-}
-
 __attribute__((weak)) char *strncat(char *restrict s1, const char *restrict s2,
                                     size_t n) {
-  size_t len = strlen(s1);
-  if (strlen(s2) < n) {
-    strcpy(s1 + len, s2);
-  } else {
-    strncpy(s1 + len, s2, n);
-  }
+  char *end = s1 + strlen(s1);
+  for (; n && *s2; --n)
+    *end++ = *s2++;
+  *end = '\0';
   return s1;
 }
 
 // Comparison functions
 
-__attribute__((weak)) int strcmp(const char *s1, const char *s2) {
-  for (;; ++s1, ++s2) {
-    if (!*s1 || !*s2 || *s1 != *s2)
-      return *s1 - *s2;
-  }
-}
-
 __attribute__((weak)) int strncmp(const char *s1, const char *s2, size_t n) {
   for (;; ++s1, ++s2, --n) {
     if (!n)
@@ -70,16 +48,6 @@ __attribute__((weak)) int strncmp(const char *s1, const char *s2, size_t n) {
 
 // Search functions
 
-__attribute__((weak)) char *strchr(const char *s, int c) {
-  char ch = (char)c;
-  for (;; ++s) {
-    if (*s == ch)
-      return (char *)s;
-    if (!*s)
-      return NULL;
-  }
-}
-
 // Originally from the Public Domain C Library (PDCLib).
 __attribute__((weak)) size_t strcspn(const char *s1, const char *s2) {
   size_t len = 0;
@@ -143,13 +111,6 @@ char *strstr(const char *s1, const char *s2) {
 
 // Miscellaneous functions
 
-__attribute__((weak)) size_t strlen(const char *s) {
-  size_t len = 0;
-  for (; *s; ++s)
-    ++len;
-  return len;
-}
-
 __attribute__((weak)) char *_strrev(char *str) {
   size_t len = strlen((const char *)str);
   for (size_t i = 0, j = len - 1; i < j; i++, j--) {
@@ -3,13 +3,13 @@
 #include <ctype.h>
 
 signed char __parse_digit(char c, char base) {
-  if (!isalnum(c))
+  signed char val;
+  if (__ctype_is(c, __CT_DIGIT))
+    val = c - '0';
+  else if (__ctype_is(c, __CT_UPPER | __CT_LOWER))
+    val = (c | 0x20) - 'a' + 10;
+  else
     return -1;
-  if (isdigit(c)) {
-    signed char val = c - '0';
-    return val < base ? val : -1;
-  }
-  signed char val = tolower(c) - 'a' + 10;
   return val < base ? val : -1;
 }
 
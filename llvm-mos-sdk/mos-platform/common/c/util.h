@@ -41,8 +41,33 @@ signed char __parse_digit(char c, char base);
 unsigned __simple_strtoui(const char *__restrict__ nptr,
                           char **__restrict endptr);
 
+// Write the decimal digits of value to buf, most significant first, with no
+// terminator, and return how many there were. Defined in print.cc.
+char __print_u8(uint8_t value, char *buf);
+char __print_u16(uint16_t value, char *buf);
+char __print_u32(uint32_t value, char *buf);
+
 #ifdef __cplusplus
 }
+
+// value * base + digit, with the multiply done as shifts for the usual bases.
+template <typename T> T __mul_add(T value, char base, char digit) {
+  switch (base) {
+  case 8:
+    value <<= 3;
+    break;
+  case 10:
+    value = (value << 3) + (value << 1);
+    break;
+  case 16:
+    value <<= 4;
+    break;
+  default:
+    value *= base;
+    break;
+  }
+  return value + digit;
+}
 #endif
 
 #endif // _UTIL_H
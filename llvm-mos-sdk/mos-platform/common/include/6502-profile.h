@@ -0,0 +1,61 @@
+#ifndef _6502_PROFILE_H
+#define _6502_PROFILE_H
+
+// Scoped cycle timers.
+//
+//   void draw_sprites(void) {
+//     MOS_PROFILE_SCOPE("draw_sprites");
+//     ...
+//   }
+//
+// Unless MOS_PROFILE is defined, MOS_PROFILE_SCOPE expands to nothing and
+// costs nothing. With -DMOS_PROFILE, it records the cycle count on entry to
+// the enclosing block and on leaving it, by any path but longjmp, into a ring
+// of the last 64 such events. At exit, each scope whose entry is still in the
+// ring is printed with the cycles it took, inner scopes indented under outer
+// ones:
+//
+//   sim:      mos-sim prints the ring to stderr, even if the program aborts.
+//   mattbrew: the ring is printed to the terminal. Cycles come from VIA T1,
+//             which profile builds run free; gaps over 65536 cycles between
+//             events lose whole multiples of it.
+//
+// Each event costs a call and a clock read, a couple of hundred cycles, which
+// shows in the times of the scopes around it. Events are not interrupt-safe.
+
+#ifdef MOS_PROFILE
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+const char *__mos_profile_enter(const char *name);
+void __mos_profile_exit(const char *const *name);
+
+// The platform's cycle counter.
+uint32_t __mos_profile_clock(void);
+
+// Print the completed scopes in the ring to stdout, for platforms that don't
+// do so at exit.
+void mos_profile_dump(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define __MOS_PROFILE_CAT2(a, b) a##b
+#define __MOS_PROFILE_CAT(a, b) __MOS_PROFILE_CAT2(a, b)
+#define MOS_PROFILE_SCOPE(name)                                                \
+  const char *__MOS_PROFILE_CAT(__mos_profile_scope_, __COUNTER__)             \
+      __attribute__((cleanup(__mos_profile_exit), unused)) =                   \
+          __mos_profile_enter(name)
+
+#else
+
+#define MOS_PROFILE_SCOPE(name)
+
+#endif // MOS_PROFILE
+
+#endif // not _6502_PROFILE_H
@@ -20,6 +20,39 @@ int isxdigit(int c);
 int tolower(int c);
 int toupper(int c);
 
+// Class flags for each unsigned char value, defined in ctype.c. Everything
+// outside ASCII, and EOF, is in no class.
+extern const unsigned char __ctype[256];
+
+#define __CT_UPPER 0x01  // A-Z
+#define __CT_LOWER 0x02  // a-z
+#define __CT_DIGIT 0x04  // 0-9
+#define __CT_SPACE 0x08  // \t \n \v \f \r and space
+#define __CT_PUNCT 0x10  // graphic, but not alphanumeric
+#define __CT_CNTRL 0x20  // 0x00-0x1f and DEL
+#define __CT_HEX 0x40    // a-f A-F
+#define __CT_BLANK 0x80  // space alone; printable, but not graphic
+
+#define __ctype_is(c, mask) (__ctype[(unsigned char)(c)] & (mask))
+
+#ifndef __cplusplus
+// Each test is a table load and a mask. C++ keeps the functions, for
+// std::isalpha and friends; LTO inlines them anyway.
+#define isalnum(c) __ctype_is(c, __CT_UPPER | __CT_LOWER | __CT_DIGIT)
+#define isalpha(c) __ctype_is(c, __CT_UPPER | __CT_LOWER)
+#define iscntrl(c) __ctype_is(c, __CT_CNTRL)
+#define isdigit(c) __ctype_is(c, __CT_DIGIT)
+#define isgraph(c)                                                             \
+  __ctype_is(c, __CT_UPPER | __CT_LOWER | __CT_DIGIT | __CT_PUNCT)
+#define islower(c) __ctype_is(c, __CT_LOWER)
+#define isprint(c)                                                             \
+  __ctype_is(c, __CT_UPPER | __CT_LOWER | __CT_DIGIT | __CT_PUNCT | __CT_BLANK)
+#define ispunct(c) __ctype_is(c, __CT_PUNCT)
+#define isspace(c) __ctype_is(c, __CT_SPACE)
+#define isupper(c) __ctype_is(c, __CT_UPPER)
+#define isxdigit(c) __ctype_is(c, __CT_DIGIT | __CT_HEX)
+#endif
+
 #ifdef __cplusplus
 }
 #endif
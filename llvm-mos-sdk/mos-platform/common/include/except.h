@@ -0,0 +1,86 @@
+#ifndef _EXCEPT_H
+#define _EXCEPT_H
+
+#include <setjmp.h>
+
+/// Error unwinding for code that would otherwise use C++ exceptions.
+///
+/// llvm-mos has no unwinder, so `throw` is unavailable. This is the setjmp
+/// model instead: attempt() records a frame with setjmp, and raise() jumps
+/// back to the innermost one. Nothing is spent on calls between the two, so
+/// code that doesn't fail pays only for entering attempt(), about what a
+/// setjmp costs, and raise() costs a longjmp plus the cleanups it runs.
+///
+/// longjmp skips destructors, so whatever must be undone on the way out,
+/// such as a file to close or a buffer to free, is registered with a
+/// Cleanup (or made one with except::on_raise()). Each function's cleanups
+/// live in its own frame, six bytes apiece, chained from the most recent;
+/// raise() runs those newer than the frame it returns to, then drops them.
+///
+///   int code = except::attempt([&] {
+///     except::Cleanup close_it([](void *f) { fclose((FILE *)f); }, f);
+///     parse(f);              // may except::raise(ERR_SYNTAX) at any depth
+///   });
+///
+/// A raise() outside any attempt() calls std::terminate().
+namespace except {
+
+/// Unwind to the innermost attempt(), which returns |Code| (nonzero).
+[[noreturn]] void raise(int Code);
+
+/// Undo work if a raise() leaves its scope; does nothing on a normal exit.
+class Cleanup {
+public:
+  Cleanup(void (*Fn)(void *), void *Arg);
+  ~Cleanup();
+  Cleanup(const Cleanup &) = delete;
+  Cleanup &operator=(const Cleanup &) = delete;
+
+private:
+  friend void raise(int Code);
+  Cleanup *Prev;
+  void (*Fn)(void *);
+  void *Arg;
+};
+
+/// Where raise() returns to, kept by attempt().
+struct Frame {
+  jmp_buf Env;
+  Frame *Prev;
+  Cleanup *Cleanups;
+};
+
+extern Frame *Top;
+extern Cleanup *Cleanups;
+
+/// Call |F|. Returns 0 if it returns, or the code given to raise() if it
+/// raises. Locals of the caller changed inside |F| should be volatile.
+template <typename F> int attempt(F &&Fn) {
+  Frame Here;
+  Here.Prev = Top;
+  Here.Cleanups = Cleanups;
+  Top = &Here;
+  if (int Code = setjmp(Here.Env))
+    return Code; // raise() has already popped the frame.
+  Fn();
+  Top = Here.Prev;
+  return 0;
+}
+
+/// A Cleanup that calls |Fn| (any callable) if a raise() leaves its scope.
+template <typename F> class OnRaise {
+public:
+  explicit OnRaise(F Fn)
+      : Fn(Fn), Registered([](void *Self) { static_cast<OnRaise *>(Self)->Fn(); },
+                           this) {}
+
+private:
+  F Fn;
+  Cleanup Registered;
+};
+
+template <typename F> OnRaise<F> on_raise(F Fn) { return OnRaise<F>(Fn); }
+
+} // namespace except
+
+#endif // not _EXCEPT_H
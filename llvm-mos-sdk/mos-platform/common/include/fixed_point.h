@@ -152,6 +152,88 @@ public:
     return FracSize;
   }
 
+  // Formatting
+
+  /// The most characters to_chars writes for Digits fractional digits,
+  /// counting the NUL: a sign, the integral digits, a point and the digits.
+  static constexpr uint8_t chars(uint8_t Digits) {
+    return Signed + (IntSize * 1233 >> 12) + 1 + (Digits ? Digits + 1 : 0) + 1;
+  }
+
+  /// Writes the value to Buf in decimal, rounded to Digits fractional digits
+  /// (halves away from zero), then a NUL, and returns a pointer to the NUL.
+  /// Buf must hold chars(Digits) characters.
+  ///
+  /// Printing through a conversion to double links the soft float library
+  /// and printf's float formatting. This takes one division by 10 per
+  /// integral digit and one multiply by 10 per fractional digit, all on
+  /// integers. Each fractional bit adds a decimal digit, so FracSize digits
+  /// show the value exactly.
+  char *to_chars(char *Buf, uint8_t Digits) const {
+    using UIntType = unsigned _BitInt(IntSize);
+    // Room for the integral digit that each multiply by 10 carries out.
+    using DigitsType = unsigned _BitInt(FracSize + 4);
+    constexpr DigitsType One = (DigitsType)1 << FracSize;
+
+    UIntType Int = i;
+    DigitsType Frac = f;
+    char *P = Buf;
+    if constexpr (Signed) {
+      // i is the floor, so a fraction takes the magnitude down from it.
+      if (i < 0) {
+        *P++ = '-';
+        Int = -Int;
+        if (Frac) {
+          --Int;
+          Frac = One - Frac;
+        }
+      }
+    }
+
+    char *Start = P;
+    do {
+      *P++ = '0' + (uint8_t)(Int % 10);
+      Int /= 10;
+    } while (Int);
+    for (char *L = Start, *R = P - 1; L < R; ++L, --R) {
+      char C = *L;
+      *L = *R;
+      *R = C;
+    }
+
+    if (Digits)
+      *P++ = '.';
+    for (uint8_t D = 0; D < Digits; ++D) {
+      Frac *= 10;
+      *P++ = '0' + (uint8_t)(Frac >> FracSize);
+      Frac &= One - 1;
+    }
+    *P = '\0';
+
+    // Round up by carrying into the digits written, nines becoming zeros. A
+    // carry out of the first adds a digit in front.
+    if (Frac >= One / 2) {
+      for (char *Q = P;;) {
+        if (Q == Start) {
+          for (char *R = P + 1; R > Start; --R)
+            *R = R[-1];
+          *Start = '1';
+          ++P;
+          break;
+        }
+        --Q;
+        if (*Q == '.')
+          continue;
+        if (*Q != '9') {
+          ++*Q;
+          break;
+        }
+        *Q = '0';
+      }
+    }
+    return P;
+  }
+
   // Operator overloads
 
   // Unary operators
@@ -573,4 +655,272 @@ operator""_24_8(long double fixed) {
 }
 } // namespace fixedpoint_literals
 
+/// Table-driven kernels for the common fixed point operations.
+///
+/// The 6502 has no multiply or divide instructions, so the operators above
+/// fall back on the compiler's shift-and-add routines, which loop once per
+/// bit. These trade a little memory for speed: each table is built at compile
+/// time, and is only linked in if its kernel is used.
+///
+/// using namespace fixedpoint_literals;
+/// f8_8 area = fixedpoint::mul(width, height);  // exact, like operator*
+/// f8_8 slope = fixedpoint::div(dy, dx);        // approximate; see div()
+/// f8_8 x = fixedpoint::cos(angle) * radius;    // angle is 256ths of a turn
+/// fu8_8 length = fixedpoint::sqrt(squared);
+namespace fixedpoint {
+
+namespace __impl {
+
+// Tables are split into low and high bytes, so that each lookup is a single
+// indexed load.
+
+// Quarter squares: floor(n^2 / 4), for n in [0, 510].
+struct QuarterSquares {
+  uint8_t lo[511], hi[511];
+  constexpr QuarterSquares() : lo(), hi() {
+    for (uint16_t n = 0; n < 511; ++n) {
+      const uint16_t q = (uint32_t)n * n / 4;
+      lo[n] = q;
+      hi[n] = q >> 8;
+    }
+  }
+};
+inline constexpr QuarterSquares quarter_squares{};
+
+// a * b = floor((a + b)^2 / 4) - floor((a - b)^2 / 4). The fractions dropped
+// by the floors are equal, since a + b and a - b are both odd or both even.
+[[clang::always_inline]] constexpr uint16_t mul8(uint8_t a, uint8_t b) {
+  const uint16_t s = a + b;
+  const uint8_t d = a < b ? b - a : a - b;
+  const auto &t = quarter_squares;
+  return (uint16_t)(t.hi[s] << 8 | t.lo[s]) -
+         (uint16_t)(t.hi[d] << 8 | t.lo[d]);
+}
+
+[[clang::always_inline]] constexpr uint32_t mul16(uint16_t a, uint16_t b) {
+  const uint8_t al = a, ah = a >> 8, bl = b, bh = b >> 8;
+  return mul8(al, bl) + ((uint32_t)mul8(al, bh) << 8) +
+         ((uint32_t)mul8(ah, bl) << 8) + ((uint32_t)mul8(ah, bh) << 16);
+}
+
+// Bits 8-23 of the 32-bit product a * b, which is the 8.8 product. Only the
+// high byte of al * bl and the low byte of ah * bh reach those bits. A
+// negative operand is its unsigned value less 2^16, which takes the other
+// operand times 2^16 off the product: here, its low byte off the high byte.
+template <bool Signed>
+constexpr uint16_t mul8_8(uint16_t a, uint16_t b) {
+  const uint8_t al = a, ah = a >> 8, bl = b, bh = b >> 8;
+  uint16_t r = (mul8(al, bl) >> 8) + mul8(al, bh) + mul8(ah, bl) +
+               (uint16_t)((uint8_t)mul8(ah, bh) << 8);
+  if constexpr (Signed) {
+    if (ah & 0x80)
+      r -= (uint16_t)(bl << 8);
+    if (bh & 0x80)
+      r -= (uint16_t)(al << 8);
+  }
+  return r;
+}
+
+// Reciprocals: 2^23 / m, rounded up, for m in [256, 511]. Rounding up makes
+// quotients that come out whole exact, rather than just under and truncated.
+struct Reciprocals {
+  uint8_t lo[256], hi[256];
+  constexpr Reciprocals() : lo(), hi() {
+    for (uint16_t i = 0; i < 256; ++i) {
+      const uint32_t m = 256 + i;
+      const uint16_t r = (((uint32_t)1 << 23) + m - 1) / m;
+      lo[i] = r;
+      hi[i] = r >> 8;
+    }
+  }
+};
+inline constexpr Reciprocals reciprocals{};
+
+// b is 9 significant bits m, times 2^e. Then a / b in 8.8 is
+// a * 2^8 / (m * 2^e) = a * (2^23 / m) / 2^(15 + e).
+constexpr uint16_t udiv8_8(uint16_t a, uint16_t b) {
+  int8_t e = 0;
+  while (b >= 512) {
+    b >>= 1;
+    ++e;
+  }
+  while (b < 256) {
+    b <<= 1;
+    --e;
+  }
+  const auto &t = reciprocals;
+  const uint8_t i = b - 256;
+  const uint32_t p = mul16(a, t.hi[i] << 8 | t.lo[i]);
+  if (e > 0)
+    return (uint16_t)(p >> 16) >> (e - 1);
+  // Rounding up can carry a quotient just under 2^16 over it.
+  const uint32_t q = (p >> 7) >> (8 + e);
+  return q > 0xffff ? 0xffff : q;
+}
+
+template <bool Signed>
+constexpr uint16_t div8_8(uint16_t a, uint16_t b) {
+  if constexpr (Signed) {
+    const bool negative = (a ^ b) & 0x8000;
+    const uint16_t q = udiv8_8(a & 0x8000 ? -a : a, b & 0x8000 ? -b : b);
+    return negative ? -q : q;
+  } else {
+    return udiv8_8(a, b);
+  }
+}
+
+// Series for sin(x), for x in [0, pi/2], to well past double precision.
+constexpr double sine(double x) {
+  double term = x, sum = x;
+  for (int n = 1; n < 12; ++n) {
+    term *= -x * x / ((2 * n) * (2 * n + 1));
+    sum += term;
+  }
+  return sum;
+}
+
+// The first quarter of a sine wave in 8.8: Steps + 1 samples, from 0 to 1.0
+// inclusive.
+template <uint8_t Steps> struct SineTable {
+  uint8_t lo[Steps + 1], hi[Steps + 1];
+  constexpr SineTable() : lo(), hi() {
+    for (uint8_t i = 0; i <= Steps; ++i) {
+      const uint16_t v = sine(i * 1.5707963267948966 / Steps) * 256 + 0.5;
+      lo[i] = v;
+      hi[i] = v >> 8;
+    }
+  }
+};
+template <uint8_t Steps> inline constexpr SineTable<Steps> sine_table{};
+
+template <uint8_t Steps> constexpr uint16_t sin8_8(uint8_t angle) {
+  static_assert(Steps && Steps <= 64 && !(Steps & (Steps - 1)),
+                "Steps must be a power of two, at most 64");
+  constexpr uint8_t shift = Steps == 64   ? 0
+                            : Steps == 32 ? 1
+                            : Steps == 16 ? 2
+                            : Steps == 8  ? 3
+                            : Steps == 4  ? 4
+                            : Steps == 2  ? 5
+                                          : 6;
+  // The angle into its quarter, from the nearest zero crossing.
+  uint8_t w = angle & 63;
+  if (angle & 64)
+    w = 64 - w;
+  const uint8_t i = (w + ((1 << shift) >> 1)) >> shift;
+  const auto &t = sine_table<Steps>;
+  const uint16_t v = t.hi[i] << 8 | t.lo[i];
+  return angle & 128 ? -v : v;
+}
+
+// Square roots: for an 8.8 value v scaled to [2^14, 2^16), whose top Bits
+// bits are 01 to 11, the 8.8 root of the middle of each run of values sharing
+// those bits. Since an 8.8 value v stands for v / 2^8, its root in 8.8 is
+// sqrt(v / 2^8) * 2^8 = 16 * sqrt(v).
+constexpr uint32_t isqrt(uint32_t n) {
+  uint32_t r = 0;
+  for (uint32_t bit = (uint32_t)1 << 30; bit; bit >>= 2) {
+    if (n >= r + bit) {
+      n -= r + bit;
+      r = (r >> 1) + bit;
+    } else {
+      r >>= 1;
+    }
+  }
+  return r;
+}
+
+template <uint8_t Bits> struct SqrtTable {
+  static constexpr uint16_t size = 3 << (Bits - 2);
+  uint8_t lo[size], hi[size];
+  constexpr SqrtTable() : lo(), hi() {
+    for (uint16_t i = 0; i < size; ++i) {
+      const uint32_t v = ((uint32_t)(i + (1 << (Bits - 2))) << (16 - Bits)) +
+                         ((uint32_t)1 << (15 - Bits));
+      // Round 16 * sqrt(v), which is sqrt(256 * v).
+      uint32_t r = isqrt(256 * v);
+      if (256 * v - r * r > r)
+        ++r;
+      lo[i] = r;
+      hi[i] = r >> 8;
+    }
+  }
+};
+template <uint8_t Bits> inline constexpr SqrtTable<Bits> sqrt_table{};
+
+// Scaling v by 4^k scales its root by 2^k, which is then rounded back out.
+template <uint8_t Bits> constexpr uint16_t sqrt8_8(uint16_t v) {
+  static_assert(Bits >= 3 && Bits <= 12, "Bits must be in [3, 12]");
+  if (!v)
+    return 0;
+  uint8_t k = 0;
+  while (v < 0x4000) {
+    v <<= 2;
+    ++k;
+  }
+  const auto &t = sqrt_table<Bits>;
+  const uint16_t i = (v >> (16 - Bits)) - (1 << (Bits - 2));
+  const uint16_t r = t.hi[i] << 8 | t.lo[i];
+  return (r + ((1 << k) >> 1)) >> k;
+}
+
+} // namespace __impl
+
+/// 8.8 multiply by quarter squares: four table lookups in place of a 16-bit
+/// shift-and-add multiply. Gives exactly the result of operator*.
+template <bool Signed>
+[[clang::always_inline]] constexpr FixedPoint<8, 8, Signed>
+mul(FixedPoint<8, 8, Signed> a, FixedPoint<8, 8, Signed> b) {
+  FixedPoint<8, 8, Signed> r{0};
+  r.set(__impl::mul8_8<Signed>(a.get(), b.get()));
+  return r;
+}
+
+/// 8.8 divide by reciprocal: b is rounded down to nine significant bits and
+/// its reciprocal looked up, then multiplied by a. The result is within 1/256
+/// of the true quotient in either direction, relative to its size, or one unit
+/// in the last place for results below 1.0. It is not simply truncated: its
+/// magnitude is never below the truncated quotient's, but the rounded-up
+/// reciprocal can put it above the true quotient, e.g., raw 4 / 1026 gives 1
+/// where the true quotient is 0.998 units. Whole quotients below 64.0 are
+/// exact if b has at most nine significant bits. b must not be zero.
+template <bool Signed>
+[[clang::always_inline]] constexpr FixedPoint<8, 8, Signed>
+div(FixedPoint<8, 8, Signed> a, FixedPoint<8, 8, Signed> b) {
+  FixedPoint<8, 8, Signed> r{0};
+  r.set(__impl::div8_8<Signed>(a.get(), b.get()));
+  return r;
+}
+
+/// Sine of an angle in 256ths of a turn, from a table of Steps samples per
+/// quarter turn (2 to 64; fewer is smaller and coarser). Symmetry supplies the
+/// other three quarters.
+template <uint8_t Steps = 64>
+[[clang::always_inline]] constexpr fixedpoint_literals::fs8_8
+sin(uint8_t angle) {
+  fixedpoint_literals::fs8_8 r{0};
+  r.set(__impl::sin8_8<Steps>(angle));
+  return r;
+}
+
+/// Cosine of an angle in 256ths of a turn; see sin().
+template <uint8_t Steps = 64>
+[[clang::always_inline]] constexpr fixedpoint_literals::fs8_8
+cos(uint8_t angle) {
+  return sin<Steps>(angle + 64);
+}
+
+/// Square root from a table indexed by the top Bits significant bits of x,
+/// holding 3/4 * 2^Bits entries of two bytes each. The default of 8 is good to
+/// about half a percent of the root; each extra bit roughly halves that.
+template <uint8_t Bits = 8>
+[[clang::always_inline]] constexpr fixedpoint_literals::fu8_8
+sqrt(fixedpoint_literals::fu8_8 x) {
+  fixedpoint_literals::fu8_8 r{0};
+  r.set(__impl::sqrt8_8<Bits>(x.get()));
+  return r;
+}
+
+} // namespace fixedpoint
+
 #endif // _FIXED_POINT_H
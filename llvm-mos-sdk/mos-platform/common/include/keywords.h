@@ -0,0 +1,176 @@
+#ifndef _KEYWORDS_H
+#define _KEYWORDS_H
+
+#include <cstdint>
+
+// Named so that the compiler's complaint about calling them in a constant
+// expression says what went wrong. Never defined.
+void keyword_table_has_duplicate_keywords();
+void keyword_table_found_no_perfect_hash();
+
+/// A perfect hash of N keywords, found by the compiler, for telling which
+/// one a word is (a command name, a monitor command, an opcode mnemonic).
+///
+/// Matching a word against a chain of string compares costs one compare per
+/// keyword before it. Here the word is hashed in one pass, a byte at a time,
+/// into two 8-bit values: a bucket and a slot. A per-bucket displacement is
+/// XORed into the slot, which picks the one keyword the word could be, and
+/// one compare against that keyword settles it. That's two table reads and
+/// one compare whatever N is.
+///
+/// The hash mixes with adds, XORs and 8-bit rotates, which the 6502 does in a
+/// couple of instructions each. The table has Slots slots, the next power of
+/// two at or above N (or Size, if that's larger), so that a slot number is
+/// just masked into range rather than taken modulo N, which would need a
+/// division. It's minimal when N is a power of two, and never more than twice
+/// N otherwise.
+///
+/// The constructor searches for the hash seed and displacements, so build it
+/// as a constant from a static array of the keywords, whose order gives each
+/// its index:
+///
+///   static constexpr const char *CommandNames[] = {"load", "peek", "poke"};
+///   static constexpr KeywordTable Commands(CommandNames);
+///   ...
+///   switch (Commands.lookup(Word, Len)) { ... }
+///
+/// If the keywords include the same word twice, or no seed gives a perfect
+/// hash (a larger Size might), the constant won't compile.
+template <uint8_t N, uint8_t Size = 1> class KeywordTable {
+  static constexpr uint8_t pow2AtLeast(uint8_t V, uint8_t P) {
+    return P >= V ? P : pow2AtLeast(V, P * 2);
+  }
+
+public:
+  static constexpr uint8_t Slots = pow2AtLeast(N, Size);
+  /// What lookup returns for a word that isn't a keyword.
+  static constexpr uint8_t None = 0xff;
+
+private:
+  static_assert(N && N <= 128, "N must be between 1 and 128");
+  static_assert(Size && !(Size & (Size - 1)), "Size must be a power of two");
+
+  static constexpr uint8_t Mask = Slots - 1;
+
+  struct Hash {
+    uint8_t Bucket = 0;
+    uint8_t Slot = 0;
+  };
+
+  static constexpr uint8_t rotl(uint8_t V) { return V << 1 | V >> 7; }
+
+  static constexpr Hash hash(const char *S, uint8_t Len, uint8_t Seed) {
+    Hash H;
+    H.Slot = Seed;
+    for (uint8_t I = 0; I < Len; ++I) {
+      uint8_t C = S[I];
+      H.Bucket = rotl(H.Bucket) ^ C;
+      H.Slot = rotl(H.Slot + C) ^ Seed;
+    }
+    return H;
+  }
+
+  static constexpr uint8_t length(const char *S) {
+    uint8_t Len = 0;
+    while (S[Len])
+      ++Len;
+    return Len;
+  }
+
+  static constexpr bool equal(const char *A, const char *B, uint8_t Len) {
+    for (uint8_t I = 0; I < Len; ++I)
+      if (A[I] != B[I])
+        return false;
+    return !A[Len];
+  }
+
+  // Finds displacements that put every keyword in a slot of its own under
+  // Seed. Buckets go in order of size, largest first, while the most slots
+  // are free.
+  constexpr bool place(uint8_t Seed) {
+    Hash H[N] = {};
+    uint8_t Count[Slots] = {};
+    uint8_t Biggest = 0;
+    for (uint8_t K = 0; K < N; ++K) {
+      H[K] = hash(Words[K], length(Words[K]), Seed);
+      uint8_t C = ++Count[H[K].Bucket & Mask];
+      if (C > Biggest)
+        Biggest = C;
+    }
+    for (uint8_t I = 0; I < Slots; ++I) {
+      Displace[I] = 0;
+      Index[I] = None;
+    }
+
+    for (uint8_t C = Biggest; C; --C) {
+      for (uint8_t B = 0; B < Slots; ++B) {
+        if (Count[B] != C)
+          continue;
+        bool Placed = false;
+        for (uint8_t D = 0; D < Slots && !Placed; ++D) {
+          Placed = true;
+          for (uint8_t K = 0; K < N && Placed; ++K) {
+            if ((H[K].Bucket & Mask) != B)
+              continue;
+            uint8_t S = (H[K].Slot ^ D) & Mask;
+            if (Index[S] != None)
+              Placed = false;
+            else
+              Index[S] = K;
+          }
+          if (!Placed) {
+            for (uint8_t S = 0; S < Slots; ++S)
+              if (Index[S] != None && (H[Index[S]].Bucket & Mask) == B)
+                Index[S] = None;
+          } else {
+            Displace[B] = D;
+          }
+        }
+        if (!Placed)
+          return false;
+      }
+    }
+    return true;
+  }
+
+  const char *const *Words;
+  uint8_t Seed = 0;
+  uint8_t Displace[Slots] = {};
+  // The keyword in each slot, or None.
+  uint8_t Index[Slots] = {};
+
+public:
+  /// Keywords must outlive the table; a static array does.
+  constexpr KeywordTable(const char *const (&Keywords)[N]) : Words(Keywords) {
+    for (uint8_t A = 0; A < N; ++A)
+      for (uint8_t B = A + 1; B < N; ++B)
+        if (equal(Words[A], Words[B], length(Words[B])))
+          keyword_table_has_duplicate_keywords();
+    for (unsigned S = 0;; ++S) {
+      if (S > 0xff)
+        keyword_table_found_no_perfect_hash();
+      if (place(S)) {
+        Seed = S;
+        break;
+      }
+    }
+  }
+
+  /// The index in Keywords of the Len characters at Word, or None.
+  constexpr uint8_t lookup(const char *Word, uint8_t Len) const {
+    Hash H = hash(Word, Len, Seed);
+    uint8_t K = Index[(H.Slot ^ Displace[H.Bucket & Mask]) & Mask];
+    if (K == None || !equal(Words[K], Word, Len))
+      return None;
+    return K;
+  }
+
+  /// The index in Keywords of the NUL-terminated Word, or None.
+  constexpr uint8_t lookup(const char *Word) const {
+    return lookup(Word, length(Word));
+  }
+
+  static constexpr uint8_t size() { return N; }
+};
+
+#endif // _KEYWORDS_H
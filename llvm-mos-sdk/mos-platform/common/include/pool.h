@@ -0,0 +1,134 @@
+#ifndef _POOL_H
+#define _POOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/// A pool of up to N objects of type T.
+///
+/// malloc must find a free chunk that fits, split it, and coalesce it with its
+/// neighbors when freed. When many objects of one type come and go (list
+/// nodes, tree nodes, packet buffers), a pool does much less: every slot is the
+/// same size, so allocating pops the most recently freed slot off a list, and
+/// freeing pushes it back. Both take constant time, and slots carry no header.
+///
+/// The free list is threaded through the free slots themselves: a free slot
+/// holds a pointer to the next one. Turning an object pointer back into a slot
+/// number would need a division by the slot size, and the 6502 has no divide;
+/// following the pointer needs none. (The same argument is why the links
+/// aren't kept in a separate soa::Array.) Slots that have never been used are
+/// handed out in order once the free list runs dry, so the pool needs no
+/// initialization loop to build the list.
+///
+/// To let the compiler use absolute indexed addressing for the pool's
+/// bookkeeping and storage, give it static storage duration, e.g.,
+/// `static Pool<Node, 32> Nodes;`. Since it's then zero-initialized, it costs
+/// no startup time.
+template <typename T, size_t N> class Pool {
+  union Slot {
+    Slot *NextFree;
+    alignas(T) char Bytes[sizeof(T)];
+  };
+
+  Slot Slots[N] = {};
+  Slot *FreeList = nullptr;
+  // The number of slots at the start of Slots that have ever been allocated.
+  size_t Used = 0;
+
+public:
+  /// Returns uninitialized storage for a T, or nullptr if the pool is full.
+  T *allocate() {
+    Slot *S = FreeList;
+    if (S)
+      FreeList = S->NextFree;
+    else if (Used < N)
+      S = &Slots[Used++];
+    else
+      return nullptr;
+    return reinterpret_cast<T *>(S->Bytes);
+  }
+
+  /// Returns storage previously returned by allocate() to the pool.
+  void deallocate(T *Ptr) {
+    Slot *S = reinterpret_cast<Slot *>(Ptr);
+    S->NextFree = FreeList;
+    FreeList = S;
+  }
+
+  /// Allocates and constructs a T, or returns nullptr if the pool is full.
+  template <typename... ArgsT> T *create(ArgsT &&...Args) {
+    T *Ptr = allocate();
+    return Ptr ? new (Ptr) T(std::forward<ArgsT>(Args)...) : nullptr;
+  }
+
+  /// Destroys and deallocates a T made by create().
+  void destroy(T *Ptr) {
+    Ptr->~T();
+    deallocate(Ptr);
+  }
+
+  /// Returns whether Ptr points into this pool's storage.
+  bool owns(const T *Ptr) const {
+    const char *P = reinterpret_cast<const char *>(Ptr);
+    return P >= Slots[0].Bytes && P < Slots[N - 1].Bytes + sizeof(Slot);
+  }
+};
+
+/// A bump allocator over N bytes of storage.
+///
+/// Allocation just advances a high-water mark; nothing is freed individually.
+/// Instead, the arena is reset, all at once, back to a mark taken earlier,
+/// either explicitly or by a Scope going out of scope. This suits data that
+/// lives exactly as long as some phase of a program: parsing a command,
+/// drawing a frame, or handling a packet.
+///
+/// No destructors are ever run, so only trivially destructible types may be
+/// created. As with Pool, give the arena static storage duration.
+template <size_t N> class Arena {
+  char Storage[N] = {};
+  size_t Used = 0;
+
+public:
+  /// Returns Size bytes of storage aligned to Align (a power of two), or
+  /// nullptr if there isn't enough left.
+  void *allocate(size_t Size, size_t Align = 1) {
+    size_t Pad = -reinterpret_cast<uintptr_t>(Storage + Used) & (Align - 1);
+    if (Pad > N - Used || Size > N - Used - Pad)
+      return nullptr;
+    size_t Begin = Used + Pad;
+    Used = Begin + Size;
+    return Storage + Begin;
+  }
+
+  /// Allocates and constructs a T, or returns nullptr if the arena is full.
+  template <typename T, typename... ArgsT> T *create(ArgsT &&...Args) {
+    static_assert(std::is_trivially_destructible_v<T>,
+                  "arenas never run destructors");
+    void *Ptr = allocate(sizeof(T), alignof(T));
+    return Ptr ? new (Ptr) T(std::forward<ArgsT>(Args)...) : nullptr;
+  }
+
+  /// The number of bytes allocated so far; pass it to reset() to free
+  /// everything allocated after this point.
+  size_t mark() const { return Used; }
+  void reset(size_t Mark = 0) { Used = Mark; }
+
+  size_t available() const { return N - Used; }
+
+  /// Frees everything allocated from the arena during its lifetime.
+  class Scope {
+    Arena &A;
+    size_t Mark;
+
+  public:
+    explicit Scope(Arena &A) : A(A), Mark(A.mark()) {}
+    ~Scope() { A.reset(Mark); }
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+  };
+};
+
+#endif // _POOL_H
@@ -0,0 +1,344 @@
+#ifndef _PRINT_H
+#define _PRINT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <type_traits>
+
+#if __cplusplus < 202002L
+#error "print.h requires C++20 (-std=c++20)"
+#endif
+
+extern "C" {
+// Write the decimal digits of value to buf, most significant first, with no
+// terminator, and return how many there were. buf must hold 3, 5, or 10
+// characters respectively.
+char __print_u8(uint8_t value, char *buf);
+char __print_u16(uint16_t value, char *buf);
+char __print_u32(uint32_t value, char *buf);
+}
+
+/// printf, with the format string parsed at compile time.
+///
+/// printf parses its format string anew on every call, and converts integers
+/// to decimal through a general-purpose arbitrary-width BCD routine. Here, the
+/// format string is a template argument instead:
+///
+///   print::printf<"HP %3u/%3u  $%04x\n">(hp, max_hp, addr);
+///
+/// This compiles to the literal text, then one direct call per conversion,
+/// picked by the argument's real width: an 8-bit value needs only a
+/// hundreds-tens-ones subtraction, and a 16-bit one five digits of it. Field
+/// width and flags are constants folded into the call site, none of the printf
+/// machinery is linked in, and a mismatched argument count is a compile error.
+///
+/// Supported: %%, %c, %s, and %d %i %u %x %X with the flags - 0 + space #, a
+/// constant field width, and the length modifiers hh h l. Anything else
+/// (precision, * widths, floating point, long long, %n) fails to compile;
+/// use printf for those.
+namespace print {
+
+template <size_t N> struct String {
+  char data[N];
+  constexpr String(const char (&s)[N]) {
+    for (size_t i = 0; i < N; ++i)
+      data[i] = s[i];
+  }
+};
+
+namespace __impl {
+
+// Called only from constant evaluation, where calling a non-constexpr
+// function is an error that points here.
+void unsupported_format_use_printf();
+
+struct Spec {
+  char conv = 0;   // 0 for none: the end of the string.
+  char length = 0; // 0, 'H' for hh, 'h', or 'l'.
+  bool minus = false, zero = false, plus = false, space = false, alt = false;
+  uint8_t width = 0;
+};
+
+// A run of literal text, [begin, end), followed by a conversion, which ends
+// at next.
+struct Piece {
+  size_t begin, end;
+  Spec spec;
+  size_t next;
+};
+
+template <size_t N> constexpr Piece parse(const String<N> &f, size_t pos) {
+  Piece p = {pos, pos, {}, pos};
+  const char *s = f.data;
+  for (;;) {
+    while (s[pos] && s[pos] != '%')
+      ++pos;
+    p.end = pos;
+    if (!s[pos] || s[pos + 1] != '%')
+      break;
+    // %%: the text carries on, with one of the two signs.
+    if (p.end != p.begin) {
+      p.next = pos;
+      return p;
+    }
+    p.begin = pos + 1;
+    pos += 2;
+  }
+  if (!s[pos]) {
+    p.next = pos;
+    return p;
+  }
+
+  ++pos;
+  Spec &spec = p.spec;
+  for (;; ++pos) {
+    if (s[pos] == '-')
+      spec.minus = true;
+    else if (s[pos] == '0')
+      spec.zero = true;
+    else if (s[pos] == '+')
+      spec.plus = true;
+    else if (s[pos] == ' ')
+      spec.space = true;
+    else if (s[pos] == '#')
+      spec.alt = true;
+    else
+      break;
+  }
+  unsigned width = 0;
+  for (; s[pos] >= '0' && s[pos] <= '9'; ++pos)
+    width = width * 10 + (s[pos] - '0');
+  if (width > 255)
+    unsupported_format_use_printf();
+  spec.width = width;
+
+  if (s[pos] == 'h' && s[pos + 1] == 'h') {
+    spec.length = 'H';
+    pos += 2;
+  } else if (s[pos] == 'h' || s[pos] == 'l') {
+    spec.length = s[pos++];
+  }
+
+  switch (s[pos]) {
+  case 'd':
+  case 'i':
+  case 'u':
+  case 'x':
+  case 'X':
+    break;
+  case 'c':
+  case 's':
+    if (!spec.length)
+      break;
+    [[fallthrough]];
+  default:
+    unsupported_format_use_printf();
+  }
+  spec.conv = s[pos];
+  p.next = pos + 1;
+  return p;
+}
+
+struct StdoutSink {
+  size_t count = 0;
+  void put(char c) {
+    putchar(c);
+    ++count;
+  }
+};
+
+struct BufferSink {
+  char *s;
+  size_t n;
+  size_t count = 0;
+  void put(char c) {
+    if (count < n)
+      s[count] = c;
+    ++count;
+  }
+};
+
+template <class Sink> void pad(Sink &sink, char c, uint8_t n) {
+  for (; n; --n)
+    sink.put(c);
+}
+
+template <Spec S, class Sink> void print_text(Sink &sink, const char *s) {
+  if constexpr (!S.width) {
+    for (; *s; ++s)
+      sink.put(*s);
+  } else {
+    uint8_t len = 0;
+    while (len < S.width && s[len])
+      ++len;
+    if constexpr (!S.minus)
+      pad(sink, ' ', S.width - len);
+    for (; *s; ++s)
+      sink.put(*s);
+    if constexpr (S.minus)
+      pad(sink, ' ', S.width - len);
+  }
+}
+
+// The unsigned type a conversion reads its argument as.
+template <char Length>
+using Unsigned = std::conditional_t<
+    Length == 'H', unsigned char,
+    std::conditional_t<
+        Length == 'h', unsigned short,
+        std::conditional_t<Length == 'l', unsigned long, unsigned>>>;
+
+// What an integer argument is read as. A narrower argument than the
+// conversion's is read at its own width, so a uint8_t gets the 8-bit
+// routine, whenever that prints the same thing printf would: when the
+// argument and the conversion are both signed or both unsigned. Otherwise
+// it is read at the conversion's width, so a uint8_t 200 printed with %d
+// stays 200 and an int8_t -1 printed with %x is ffff.
+template <Spec S, class T>
+using ReadAs = std::conditional_t<
+    (sizeof(T) < sizeof(Unsigned<S.length>) &&
+     std::is_signed_v<T> == (S.conv == 'd' || S.conv == 'i')),
+    std::make_unsigned_t<std::conditional_t<std::is_same_v<T, bool>,
+                                            unsigned char, T>>,
+    Unsigned<S.length>>;
+
+template <class U> char to_decimal(U value, char *buf) {
+  if constexpr (sizeof(U) == 1)
+    return __print_u8(value, buf);
+  else if constexpr (sizeof(U) == 2)
+    return __print_u16(value, buf);
+  else
+    return __print_u32(value, buf);
+}
+
+template <bool Upper, class U> char to_hex(U value, char *buf) {
+  const char *digits = Upper ? "0123456789ABCDEF" : "0123456789abcdef";
+  uint8_t len = 0;
+  for (int shift = sizeof(U) * 8 - 4; shift >= 0; shift -= 4) {
+    const uint8_t digit = (value >> shift) & 0xf;
+    if (digit || len || !shift)
+      buf[len++] = digits[digit];
+  }
+  return len;
+}
+
+template <Spec S, class Sink, class T> void print_int(Sink &sink, T arg) {
+  using U = ReadAs<S, T>;
+  // hh and h narrow an int, as in printf; otherwise, bits would be lost.
+  static_assert(S.length == 'H' || S.length == 'h' || sizeof(T) <= sizeof(U),
+                "argument wider than its conversion; use the l modifier");
+  U value = static_cast<U>(arg);
+  char prefix[2];
+  uint8_t prefix_len = 0;
+  constexpr bool is_signed = S.conv == 'd' || S.conv == 'i';
+  if constexpr (is_signed) {
+    if (static_cast<std::make_signed_t<U>>(value) < 0) {
+      value = static_cast<U>(-value);
+      prefix[prefix_len++] = '-';
+    } else if constexpr (S.plus) {
+      prefix[prefix_len++] = '+';
+    } else if constexpr (S.space) {
+      prefix[prefix_len++] = ' ';
+    }
+  } else if constexpr (S.alt && (S.conv == 'x' || S.conv == 'X')) {
+    if (value) {
+      prefix[0] = '0';
+      prefix[1] = S.conv;
+      prefix_len = 2;
+    }
+  }
+
+  char digits[sizeof(U) == 1 ? 3 : sizeof(U) == 2 ? 5 : 10];
+  uint8_t len;
+  if constexpr (S.conv == 'x' || S.conv == 'X')
+    len = to_hex<S.conv == 'X'>(value, digits);
+  else
+    len = to_decimal(value, digits);
+
+  uint8_t padding = 0;
+  if constexpr (S.width > 0)
+    if (S.width > len + prefix_len)
+      padding = S.width - len - prefix_len;
+  if constexpr (!S.minus && !S.zero)
+    pad(sink, ' ', padding);
+  for (uint8_t i = 0; i < prefix_len; ++i)
+    sink.put(prefix[i]);
+  if constexpr (S.zero && !S.minus)
+    pad(sink, '0', padding);
+  for (uint8_t i = 0; i < len; ++i)
+    sink.put(digits[i]);
+  if constexpr (S.minus)
+    pad(sink, ' ', padding);
+}
+
+template <Spec S, class Sink, class T> void print_arg(Sink &sink, T arg) {
+  if constexpr (S.conv == 's') {
+    static_assert(std::is_convertible_v<T, const char *>,
+                  "%s needs a string");
+    print_text<S>(sink, arg);
+  } else if constexpr (S.conv == 'c') {
+    static_assert(std::is_integral_v<T>, "%c needs a character");
+    const char s[2] = {static_cast<char>(arg), 0};
+    if constexpr (!S.width)
+      sink.put(s[0]);
+    else
+      print_text<S>(sink, s);
+  } else {
+    static_assert(std::is_integral_v<T>, "integer conversions need an integer");
+    print_int<S>(sink, arg);
+  }
+}
+
+template <String F, size_t Pos, class Sink, class... Args>
+void print_from(Sink &sink, Args... args);
+
+template <String F, size_t Pos, class Sink, class T, class... Rest>
+void print_conversion(Sink &sink, T arg, Rest... rest) {
+  constexpr Piece P = parse(F, Pos);
+  print_arg<P.spec>(sink, arg);
+  print_from<F, P.next>(sink, rest...);
+}
+
+template <String F, size_t Pos, class Sink, class... Args>
+void print_from(Sink &sink, Args... args) {
+  constexpr Piece P = parse(F, Pos);
+  for (size_t i = P.begin; i < P.end; ++i)
+    sink.put(F.data[i]);
+  if constexpr (!P.spec.conv) {
+    // Either the end, or a %% that split the text.
+    if constexpr (F.data[P.next])
+      print_from<F, P.next>(sink, args...);
+    else
+      static_assert(sizeof...(Args) == 0,
+                    "more arguments than the format string uses");
+  } else {
+    static_assert(sizeof...(Args) > 0,
+                  "fewer arguments than the format string uses");
+    print_conversion<F, Pos>(sink, args...);
+  }
+}
+
+} // namespace __impl
+
+/// Print to stdout. Returns the number of characters printed.
+template <String F, class... Args> int printf(Args... args) {
+  __impl::StdoutSink sink;
+  __impl::print_from<F, 0>(sink, args...);
+  return sink.count;
+}
+
+/// Print to s, writing at most n characters including the terminating NUL.
+/// Returns the length of the whole output, as snprintf does.
+template <String F, class... Args>
+int snprintf(char *s, size_t n, Args... args) {
+  __impl::BufferSink sink = {s, n};
+  __impl::print_from<F, 0>(sink, args...);
+  if (n)
+    s[sink.count < n ? sink.count : n - 1] = '\0';
+  return sink.count;
+}
+
+} // namespace print
+
+#endif // _PRINT_H
@@ -0,0 +1,32 @@
+#ifndef _ROM_H
+#define _ROM_H
+
+// Places a global with a constant initializer in read-only memory, after the
+// program's .rodata, even if its type isn't const, e.g., a class with a
+// constexpr constructor whose members aren't const-qualified. In C++, this
+// implies constinit, so the compiler rejects any initializer that would need
+// a constructor to run at startup, and the object costs neither init time
+// nor RAM. The object must never be written, since it may be in ROM, and
+// its type should be trivially destructible, or a destructor will still be
+// registered at startup.
+//
+// Each use gets its own .romdata section, so the linker still discards
+// unreferenced objects, as it does rodata.
+//
+// Example:
+//   struct Palette { constexpr Palette(char Base); char Colors[16]; };
+//   __rom Palette Title{0x10};
+
+#define __ROM_SECTION_(N) __attribute__((section(".romdata." #N)))
+#define __ROM_SECTION(N) __ROM_SECTION_(N)
+
+#if __cplusplus >= 202002L
+#define __rom constinit __ROM_SECTION(__COUNTER__)
+#elif defined(__cplusplus)
+#define __rom                                                                  \
+  __attribute__((require_constant_initialization)) __ROM_SECTION(__COUNTER__)
+#else
+#define __rom __ROM_SECTION(__COUNTER__)
+#endif
+
+#endif // not _ROM_H
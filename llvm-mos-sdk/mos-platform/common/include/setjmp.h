@@ -10,9 +10,17 @@ struct __jmp_buf_tag {
 
 typedef struct __jmp_buf_tag jmp_buf[1];
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 // Using preserve-none means that setjmp is only responsible for saving reserved
 // registers: FP, SP, and S.
 __attribute__((preserve_none, leaf)) int setjmp(jmp_buf src);
 void longjmp(jmp_buf dst, int arg);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif // not _SETJMP_H_
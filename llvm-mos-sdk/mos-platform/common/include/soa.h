@@ -44,6 +44,7 @@ namespace soa {
 /// types with standard layouts are supported (think C-style types). It must
 /// have an alignment requirment of 1 byte, and it must not be volatile.
 template <typename T, uint8_t N> class Array;
+template <typename T, uint8_t N> class Vector;
 
 /// Pointer to an array element.
 ///
@@ -283,8 +284,105 @@ public:
   Ptr<T> operator[](uint8_t Idx) { return ptrs()[Idx]; }
 };
 
+template <typename M> struct __Member;
+template <typename C, typename F> struct __Member<F C::*> {
+  using Class = C;
+  using Field = F;
+};
+
+/// The offset of member M within T. There's no constant expression for this
+/// given only a member pointer, but it folds to a constant all the same, and
+/// that's all absolute indexed addressing needs.
+template <typename T, auto M>
+[[clang::always_inline]] uint8_t __member_offset() {
+  static_assert(std::is_base_of_v<typename __Member<decltype(M)>::Class, T>,
+                "not a member of the element type");
+  return reinterpret_cast<uintptr_t>(&(static_cast<const T *>(nullptr)->*M));
+}
+
+template <typename F, uint8_t N> class FieldView;
+
+template <typename F, uint8_t N> class FieldIterator {
+  const FieldView<F, N> &V;
+  uint8_t Idx;
+
+public:
+  [[clang::always_inline]] FieldIterator(const FieldView<F, N> &V,
+                                         uint8_t Idx)
+      : V(V), Idx(Idx) {}
+
+  [[clang::always_inline]] Ptr<F> operator*() const { return V[Idx]; }
+
+  [[clang::always_inline]] FieldIterator &operator++() {
+    ++Idx;
+    return *this;
+  }
+
+  bool operator==(const FieldIterator &Other) const {
+    return Idx == Other.Idx;
+  }
+  bool operator!=(const FieldIterator &Other) const {
+    return !(*this == Other);
+  }
+};
+
+/// One field of every element of a soa::Array or soa::Vector, as returned by
+/// their field() members; e.g., `Entities.field<&Entity::X>()`.
+///
+/// The field's bytes are just a subset of the element's byte arrays, so
+/// indexing and iterating the view touch only those arrays, not the rest of
+/// each element. Like Ptr, views are meant to be used on the spot, not
+/// stored.
+template <typename F, uint8_t N> class FieldView {
+  using Byte = std::conditional_t<std::is_const_v<F>, const uint8_t, uint8_t>;
+
+  Byte (*ByteArrays)[N];
+  uint8_t Size;
+
+public:
+  [[clang::always_inline]] FieldView(Byte (*ByteArrays)[N], uint8_t Size)
+      : ByteArrays(ByteArrays), Size(Size) {}
+
+  [[clang::always_inline]] Ptr<F> operator[](uint8_t Idx) const {
+    return {ByteArrays, Idx};
+  }
+
+  [[clang::always_inline]] FieldIterator<F, N> begin() const {
+    return {*this, 0};
+  }
+  [[clang::always_inline]] FieldIterator<F, N> end() const {
+    return {*this, Size};
+  }
+
+  /// Sets the field of every element to Val, one byte array at a time.
+  template <typename Q = F>
+  [[clang::always_inline]] std::enable_if_t<!std::is_const_v<Q>>
+  fill(const F &Val) const {
+    const auto Bytes = __bit_cast<std::array<uint8_t, sizeof(F)>>(Val);
+#pragma unroll
+    for (uint8_t ByteIdx = 0; ByteIdx < sizeof(F); ++ByteIdx)
+      for (uint8_t Idx = 0; Idx < Size; ++Idx)
+        ByteArrays[ByteIdx][Idx] = Bytes[ByteIdx];
+  }
+
+  /// Calls Fn with each index in turn, from 0 up.
+  template <typename FnT>
+  [[clang::always_inline]] void for_each_index(FnT Fn) const {
+    for (uint8_t Idx = 0; Idx < Size; ++Idx)
+      Fn(Idx);
+  }
+
+  /// The view of only the first Count elements.
+  [[clang::always_inline]] FieldView first(uint8_t Count) const {
+    return {ByteArrays, Count};
+  }
+
+  [[clang::always_inline]] uint8_t size() const { return Size; }
+};
+
 template <typename T, uint8_t N> class ArrayConstIterator {
   friend class Array<T, N>;
+  friend class Vector<T, N>;
 
 protected:
   const Array<T, N> &A;
@@ -312,6 +410,7 @@ public:
 template <typename T, uint8_t N>
 class ArrayIterator : public ArrayConstIterator<T, N> {
   friend class Array<T, N>;
+  friend class Vector<T, N>;
 
   using ArrayConstIterator<T, N>::A;
   using ArrayConstIterator<T, N>::Idx;
@@ -385,9 +484,194 @@ public:
     return {*this, size()};
   }
 
+  /// A view of member M of every element.
+  template <auto M>
+  [[clang::always_inline]] FieldView<typename __Member<decltype(M)>::Field,
+                                     N>
+  field() {
+    return {ByteArrays + __member_offset<T, M>(), N};
+  }
+  template <auto M>
+  [[clang::always_inline]] FieldView<
+      const typename __Member<decltype(M)>::Field, N>
+  field() const {
+    return {ByteArrays + __member_offset<T, M>(), N};
+  }
+
+  /// Sets every element to Val, one byte array at a time.
+  [[clang::always_inline]] void fill(const T &Val) {
+    const auto Bytes = __bit_cast<std::array<uint8_t, sizeof(T)>>(Val);
+#pragma unroll
+    for (uint8_t ByteIdx = 0; ByteIdx < sizeof(T); ++ByteIdx)
+      for (uint8_t Idx = 0; Idx < N; ++Idx)
+        ByteArrays[ByteIdx][Idx] = Bytes[ByteIdx];
+  }
+
+  /// Calls Fn with each index in turn, from 0 up. Indexing the array, or
+  /// one of its field views, with it inside Fn keeps to absolute indexed
+  /// addressing.
+  template <typename FnT>
+  [[clang::always_inline]] void for_each_index(FnT Fn) const {
+    for (uint8_t Idx = 0; Idx < N; ++Idx)
+      Fn(Idx);
+  }
+
   [[clang::always_inline]] constexpr uint8_t size() const { return N; }
 };
 
+/// A variable-length array of at most N elements, stored as a soa::Array.
+///
+/// Like std::vector, but the storage is fixed, so as with soa::Array, giving
+/// the vector static storage duration keeps element access to absolute
+/// indexed addressing. Elements past size() are left as they were.
+template <typename T, uint8_t N> class Vector {
+  Array<T, N> Elems;
+  uint8_t Size = 0;
+
+public:
+  [[clang::always_inline]] constexpr Vector() = default;
+
+  [[clang::always_inline]] constexpr Ptr<T> operator[](uint8_t Idx) {
+    return Elems[Idx];
+  }
+  [[clang::always_inline]] constexpr Ptr<const T>
+  operator[](uint8_t Idx) const {
+    return Elems[Idx];
+  }
+
+  [[clang::always_inline]] constexpr Ptr<T> back() { return Elems[Size - 1]; }
+  [[clang::always_inline]] constexpr Ptr<const T> back() const {
+    return Elems[Size - 1];
+  }
+
+  /// Appends Val; returns false, changing nothing, if the vector is full.
+  [[clang::always_inline]] bool push_back(const T &Val) {
+    if (Size == N)
+      return false;
+    Elems[Size++] = Val;
+    return true;
+  }
+  [[clang::always_inline]] void pop_back() { --Size; }
+  [[clang::always_inline]] void clear() { Size = 0; }
+
+  [[clang::always_inline]] constexpr ArrayConstIterator<T, N> begin() const {
+    return {Elems, 0};
+  }
+  [[clang::always_inline]] constexpr ArrayConstIterator<T, N> end() const {
+    return {Elems, Size};
+  }
+  [[clang::always_inline]] constexpr ArrayIterator<T, N> begin() {
+    return {Elems, 0};
+  }
+  [[clang::always_inline]] constexpr ArrayIterator<T, N> end() {
+    return {Elems, Size};
+  }
+
+  /// A view of member M of the first size() elements.
+  template <auto M>
+  [[clang::always_inline]] FieldView<typename __Member<decltype(M)>::Field,
+                                     N>
+  field() {
+    return Elems.template field<M>().first(Size);
+  }
+  template <auto M>
+  [[clang::always_inline]] FieldView<
+      const typename __Member<decltype(M)>::Field, N>
+  field() const {
+    return Elems.template field<M>().first(Size);
+  }
+
+  /// Calls Fn with each index below size() in turn, from 0 up.
+  template <typename FnT>
+  [[clang::always_inline]] void for_each_index(FnT Fn) const {
+    for (uint8_t Idx = 0; Idx < Size; ++Idx)
+      Fn(Idx);
+  }
+
+  [[clang::always_inline]] constexpr uint8_t size() const { return Size; }
+  [[clang::always_inline]] constexpr bool empty() const { return !Size; }
+  [[clang::always_inline]] constexpr bool full() const { return Size == N; }
+  [[clang::always_inline]] constexpr uint8_t capacity() const { return N; }
+};
+
+/// A FIFO queue of at most N elements, stored as a soa::Array.
+///
+/// N must be a power of two, at most 128. The head and tail are free-running
+/// 8-bit counters: an element's slot is its counter masked by N - 1, which is
+/// a single AND, and the number of elements is their 8-bit difference, with
+/// no wraparound checks anywhere. As with soa::Array, give the queue static
+/// storage duration.
+///
+/// One producer and one consumer may use the queue concurrently, e.g., an
+/// interrupt handler pushing and the main program popping: each counter is
+/// written by only one side, a byte store is atomic on the 6502, and an
+/// element is always written before the counter that publishes it, and read
+/// only after the check of that counter.
+template <typename T, uint8_t N> class RingBuffer {
+  static_assert(N && N <= 128 && !(N & (N - 1)),
+                "ring buffer capacity must be a power of two up to 128");
+
+  Array<T, N> Elems{}; // Value-initialized, so a static queue is constinit.
+  volatile uint8_t Head = 0; // Written only by push.
+  volatile uint8_t Tail = 0; // Written only by pop.
+
+  [[clang::always_inline]] static void barrier() {
+    asm volatile("" ::: "memory");
+  }
+
+public:
+  [[clang::always_inline]] constexpr RingBuffer() = default;
+
+  /// Appends Val; returns false, changing nothing, if the queue is full.
+  [[clang::always_inline]] bool push(const T &Val) {
+    uint8_t Pos = Head;
+    if (uint8_t(Pos - Tail) == N)
+      return false;
+    Elems[Pos & (N - 1)] = Val;
+    barrier();
+    Head = Pos + 1;
+    return true;
+  }
+
+  /// The oldest element. The queue must not be empty.
+  [[clang::always_inline]] Ptr<T> front() {
+    // Keep the slot read after the check of Head that said it was filled.
+    barrier();
+    return Elems[Tail & (N - 1)];
+  }
+
+  /// Removes the oldest element. The queue must not be empty.
+  [[clang::always_inline]] void pop() {
+    barrier();
+    Tail = Tail + 1;
+  }
+
+  /// Removes the oldest element into Val; returns false if the queue is
+  /// empty.
+  [[clang::always_inline]] bool pop(T &Val) {
+    uint8_t Pos = Tail;
+    if (Pos == Head)
+      return false;
+    barrier();
+    Val = Elems[Pos & (N - 1)];
+    barrier();
+    Tail = Pos + 1;
+    return true;
+  }
+
+  /// Discards every element. Only the consumer may call this.
+  [[clang::always_inline]] void clear() { Tail = Head; }
+
+  /// Either side may call these. From the producer, size() may only be an
+  /// overestimate, and from the consumer an underestimate.
+  [[clang::always_inline]] uint8_t size() const { return Head - Tail; }
+  [[clang::always_inline]] bool empty() const { return Head == Tail; }
+  [[clang::always_inline]] bool full() const {
+    return uint8_t(Head - Tail) == N;
+  }
+  [[clang::always_inline]] constexpr uint8_t capacity() const { return N; }
+};
+
 } // namespace soa
 
 #endif // _SOA_H
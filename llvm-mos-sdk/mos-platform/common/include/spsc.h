@@ -0,0 +1,21 @@
+#ifndef _SPSC_H
+#define _SPSC_H
+
+#include <soa.h>
+
+/// A queue of up to N Ts between one producer and one consumer, typically an
+/// interrupt handler and main code, that needs no SEI/CLI around either end.
+///
+/// This is soa::RingBuffer, which already has that contract: N is a power of
+/// two up to 128, each end owns one free-running 8-bit volatile index, and
+/// compiler barriers keep a slot's contents on the right side of the index
+/// store that hands it over. The 6502 has nothing that reorders memory
+/// accesses itself.
+///
+/// Give the queue static storage duration, e.g., `static SPSCQueue<char, 16>
+/// KeyBuffer;`, so the slots have a link-time constant address and are
+/// reached with absolute indexed addressing. It's then constant-initialized
+/// and costs no startup time.
+template <typename T, uint8_t N> using SPSCQueue = soa::RingBuffer<T, N>;
+
+#endif // _SPSC_H
@@ -162,6 +162,28 @@ size_t __heap_bytes_used();
    allocations are made.*/
 size_t __heap_bytes_free();
 
+#define __HEAP_SIZE_CLASSES 16
+
+struct __heap_stats {
+  size_t bytes_used;      /* As __heap_bytes_used(). */
+  size_t bytes_free;      /* As __heap_bytes_free(). */
+  size_t largest_free;    /* The largest allocation that would now succeed. */
+  unsigned char fragmentation; /* Percent of bytes_free outside largest_free. */
+
+  /* Kept only when linked with -lmalloc_stats, an instrumented build of the
+     heap; zero otherwise. */
+  size_t peak_bytes_used; /* The most bytes_used has ever been. */
+  /* Allocation requests by size: requests of 1 byte are in allocations[0],
+     2-3 bytes in [1], 4-7 in [2], and so on. Counts malloc, calloc,
+     aligned_alloc, and each realloc that couldn't resize in place. */
+  unsigned long allocations[__HEAP_SIZE_CLASSES];
+};
+
+/* Fill in statistics on the heap. This walks the largest free chunks, but
+   otherwise costs nothing until called. Like __set_heap_limit, this
+   implicitly allocates the heap. */
+void __heap_stats(struct __heap_stats *stats);
+
 #ifdef _MOS_SOURCE
 
 #define heap_limit __heap_limit
@@ -0,0 +1,363 @@
+/* POSIX file calls over the BDOS, for stdio's FILE streams.
+ *
+ * The BDOS moves one 128-byte record per call, so each descriptor keeps a
+ * cache of CACHE_RECORDS consecutive records. A read that misses loads as
+ * many records from there on as fit, up to the end of the file, with one
+ * BDOS call each but no calls at all for the reads that follow. Writes go
+ * into the cache and are only written back when the cache moves to other
+ * records, on syncfs() and on close(). A write that covers a whole record
+ * doesn't read it first.
+ *
+ * CP/M keeps file sizes in whole records. A file reopened ends at the end of
+ * its last record, and the part of it after the last byte written is padded
+ * with ^Z, the CP/M end-of-file mark.
+ *
+ * The BDOS transfers through the DMA address. These calls move it, so code
+ * that also makes its own BDOS file calls must set it again.
+ *
+ * Descriptors 0-2 are the console.
+ *
+ * This file is part of the llvm-mos-sdk project and is redistributable under
+ * the terms of the Apache 2.0 license with the LLVM exceptions. See the LICENSE
+ * file in the project root for the full text.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "cpm.h"
+
+// Descriptors 0-2 and 5 of these: stdio's FOPEN_MAX.
+#define OPEN_FILES (FOPEN_MAX - 3)
+
+#define RECORD_SIZE 128
+// 1 KiB per open file.
+#define CACHE_RECORDS 8
+// The random record number is 16 bits, so files end at 8 MiB.
+#define MAX_SIZE (65536L * RECORD_SIZE)
+
+#define CPM_EOF 0x1a
+
+typedef struct {
+  FCB fcb;
+  uint8_t *cache; // NULL if the descriptor is free
+  uint8_t flags;  // O_* from open()
+  bool written;   // the directory entry needs updating
+  uint16_t first; // the record in cache[0]
+  uint8_t count;  // records cached
+  // Cached records [dirty_lo, dirty_hi) hold writes not yet written back.
+  uint8_t dirty_lo, dirty_hi;
+  uint32_t pos;
+  uint32_t size;
+} File;
+
+static File files[OPEN_FILES];
+
+static File *lookup(int fd) {
+  if (fd < 3 || fd >= 3 + OPEN_FILES || !files[fd - 3].cache) {
+    errno = EBADF;
+    return NULL;
+  }
+  return &files[fd - 3];
+}
+
+static void clear_fcb(FCB *fcb) {
+  memset(&fcb->ex, 0, sizeof(FCB) - offsetof(FCB, ex));
+}
+
+// Read record |r| into |p|. Records never written in a sparse file read as
+// zeros. Returns false on error.
+static bool read_record(File *f, uint16_t r, uint8_t *p) {
+  f->fcb.r = r;
+  cpm_set_dma(p);
+  if (!cpm_read_random(&f->fcb))
+    return true;
+  if (cpm_errno == CPME_NOBLOCK || cpm_errno == CPME_NOEXTENT) {
+    memset(p, 0, RECORD_SIZE);
+    return true;
+  }
+  errno = EIO;
+  return false;
+}
+
+// Write back the dirty records. Returns -1 on error.
+static int flush_cache(File *f) {
+  for (; f->dirty_lo < f->dirty_hi; ++f->dirty_lo) {
+    f->fcb.r = f->first + f->dirty_lo;
+    cpm_set_dma(f->cache + f->dirty_lo * RECORD_SIZE);
+    if (cpm_write_random(&f->fcb)) {
+      errno = cpm_errno == CPME_DISKFULL || cpm_errno == CPME_DIRFULL
+                  ? ENOSPC
+                  : EIO;
+      return -1;
+    }
+    f->written = true;
+  }
+  f->dirty_lo = f->dirty_hi = 0;
+  return 0;
+}
+
+// Return record |r| in the cache, loading it first if needed, or NULL on
+// error. If |overwrite|, the caller is about to replace all of it.
+static uint8_t *cache_record(File *f, uint16_t r, bool overwrite) {
+  uint16_t i = r - f->first;
+  if (i < f->count)
+    return f->cache + i * RECORD_SIZE;
+
+  // Records are only added to the end of the cached run; anything else
+  // starts a new one.
+  if (i != f->count || f->count == CACHE_RECORDS) {
+    if (flush_cache(f) == -1)
+      return NULL;
+    f->first = r;
+    f->count = 0;
+    i = 0;
+  }
+
+  // Read ahead as far as the cache and the file go. Past the end of the
+  // file, only the record asked for is added.
+  uint32_t records = (f->size + RECORD_SIZE - 1) / RECORD_SIZE;
+  do {
+    uint8_t *p = f->cache + f->count * RECORD_SIZE;
+    uint16_t next = f->first + f->count;
+    if (overwrite || next >= records) {
+      if (f->count != i)
+        break;
+      memset(p, CPM_EOF, RECORD_SIZE);
+    } else if (!read_record(f, next, p)) {
+      return NULL;
+    }
+    ++f->count;
+  } while (!overwrite && f->count < CACHE_RECORDS);
+  return f->cache + i * RECORD_SIZE;
+}
+
+int open(const char *name, int flags, ...) {
+  File *f = NULL;
+  for (uint8_t i = 0; i < OPEN_FILES; i++) {
+    if (!files[i].cache) {
+      f = &files[i];
+      break;
+    }
+  }
+  if (!f) {
+    errno = EMFILE;
+    return -1;
+  }
+
+  // Parsing a name fills in the FCB at the DMA address.
+  memset(&f->fcb, 0, sizeof(FCB));
+  cpm_set_dma(&f->fcb);
+  if (!cpm_parse_filename(name)) {
+    errno = EINVAL;
+    return -1;
+  }
+  clear_fcb(&f->fcb);
+
+  bool exists = !cpm_open_file(&f->fcb);
+  if (exists && (flags & O_CREAT) && (flags & O_EXCL)) {
+    errno = EEXIST;
+    return -1;
+  }
+  if (!exists && !(flags & O_CREAT)) {
+    errno = ENOENT;
+    return -1;
+  }
+  if (exists && (flags & O_TRUNC)) {
+    clear_fcb(&f->fcb);
+    if (cpm_delete_file(&f->fcb)) {
+      errno = EACCES;
+      return -1;
+    }
+    exists = false;
+  }
+  if (!exists) {
+    clear_fcb(&f->fcb);
+    if (cpm_make_file(&f->fcb)) {
+      errno = ENOSPC;
+      return -1;
+    }
+  }
+
+  f->cache = malloc(CACHE_RECORDS * RECORD_SIZE);
+  if (!f->cache) {
+    if (!exists)
+      cpm_close_file(&f->fcb);
+    errno = ENOMEM;
+    return -1;
+  }
+  f->flags = flags;
+  f->written = !exists;
+  f->first = 0;
+  f->count = 0;
+  f->dirty_lo = f->dirty_hi = 0;
+  f->pos = 0;
+  f->size = 0;
+  if (exists) {
+    cpm_seek_to_end(&f->fcb);
+    f->size = f->fcb.r2 ? MAX_SIZE : (uint32_t)f->fcb.r * RECORD_SIZE;
+  }
+  return f - files + 3;
+}
+
+int syncfs(int fd) {
+  if (fd < 3)
+    return 0;
+  File *f = lookup(fd);
+  if (!f)
+    return -1;
+  if (flush_cache(f) == -1)
+    return -1;
+  // Closing writes the directory entry; the FCB stays usable after.
+  if (f->written) {
+    if (cpm_close_file(&f->fcb)) {
+      errno = EIO;
+      return -1;
+    }
+    f->written = false;
+  }
+  return 0;
+}
+
+int close(int fd) {
+  if (fd < 3)
+    return 0;
+  int rc = syncfs(fd);
+  File *f = lookup(fd);
+  if (!f)
+    return -1;
+  free(f->cache);
+  f->cache = NULL;
+  return rc;
+}
+
+// Console input comes a line at a time, as from a cooked tty.
+static int read_console(uint8_t *buf, unsigned count) {
+  unsigned n = 0;
+  while (n < count) {
+    uint8_t c = cpm_conin();
+    if (c == '\r') {
+      cpm_conout('\n');
+      c = '\n';
+    }
+    buf[n++] = c;
+    if (c == '\n')
+      break;
+  }
+  return n;
+}
+
+int read(int fd, void *buf, unsigned count) {
+  if (fd == STDIN_FILENO)
+    return read_console(buf, count);
+  File *f = lookup(fd);
+  if (!f)
+    return -1;
+  if (!(f->flags & O_RDONLY)) {
+    errno = EBADF;
+    return -1;
+  }
+
+  if (f->pos >= f->size)
+    return 0;
+  if (count > f->size - f->pos)
+    count = f->size - f->pos;
+
+  uint8_t *p = buf;
+  unsigned done = 0;
+  while (done < count) {
+    const uint8_t *record = cache_record(f, f->pos / RECORD_SIZE, false);
+    if (!record)
+      return done ? (int)done : -1;
+    uint8_t offset = f->pos % RECORD_SIZE;
+    unsigned len = RECORD_SIZE - offset;
+    if (len > count - done)
+      len = count - done;
+    memcpy(p + done, record + offset, len);
+    f->pos += len;
+    done += len;
+  }
+  return done;
+}
+
+int write(int fd, const void *buf, unsigned count) {
+  const uint8_t *p = buf;
+  if (fd < 3) {
+    for (unsigned i = 0; i < count; i++)
+      cpm_conout(p[i]);
+    return count;
+  }
+  File *f = lookup(fd);
+  if (!f)
+    return -1;
+  if (!(f->flags & O_WRONLY)) {
+    errno = EBADF;
+    return -1;
+  }
+
+  if (f->flags & O_APPEND)
+    f->pos = f->size;
+  if (count > MAX_SIZE - f->pos)
+    count = MAX_SIZE - f->pos;
+
+  unsigned done = 0;
+  while (done < count) {
+    uint8_t offset = f->pos % RECORD_SIZE;
+    unsigned len = RECORD_SIZE - offset;
+    if (len > count - done)
+      len = count - done;
+    uint8_t *record =
+        cache_record(f, f->pos / RECORD_SIZE, len == RECORD_SIZE);
+    if (!record)
+      return done ? (int)done : -1;
+    memcpy(record + offset, p + done, len);
+
+    uint8_t i = (record - f->cache) / RECORD_SIZE;
+    if (f->dirty_lo == f->dirty_hi) {
+      f->dirty_lo = i;
+      f->dirty_hi = i + 1;
+    } else if (i < f->dirty_lo) {
+      f->dirty_lo = i;
+    } else if (i >= f->dirty_hi) {
+      f->dirty_hi = i + 1;
+    }
+
+    f->pos += len;
+    done += len;
+    if (f->pos > f->size)
+      f->size = f->pos;
+  }
+  return done;
+}
+
+off_t lseek(int fd, off_t offset, int whence) {
+  File *f = lookup(fd);
+  if (!f)
+    return -1;
+  switch (whence) {
+  case SEEK_CUR:
+    offset += f->pos;
+    break;
+  case SEEK_END:
+    offset += f->size;
+    break;
+  case SEEK_SET:
+    break;
+  default:
+    errno = EINVAL;
+    return -1;
+  }
+  if (offset < 0 || offset > MAX_SIZE) {
+    errno = EINVAL;
+    return -1;
+  }
+  f->pos = offset;
+  return offset;
+}
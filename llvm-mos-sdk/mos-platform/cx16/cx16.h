@@ -598,6 +598,25 @@ unsigned char vpeek(unsigned long addr) __attribute__((leaf));    // read byte f
 */
 void vpoke(unsigned char data, unsigned long addr) __attribute__((leaf)); // write byte value to VERA VRAM address
 
+/* Copy num_bytes from RAM into VERA's address space at addr, through data
+** port 0's auto-increment.  As with vpoke, bits 16-23 of addr are written to
+** ADDR0_H, so a VERA_INC_xx or VERA_DEC_xx step may be or'ed in shifted left
+** 16; with none, the step is 1.  Much faster than a vpoke per byte.
+*/
+void vram_copy(unsigned long addr, const void *source, unsigned int num_bytes) __attribute__((leaf)); // copy RAM to VERA VRAM
+
+/* Write num_bytes copies of value into VERA's address space at addr, stepping
+** as vram_copy does.
+*/
+void vram_fill(unsigned long addr, unsigned char value, unsigned int num_bytes) __attribute__((leaf)); // fill VERA VRAM with a byte value
+
+/* Copy num_bytes within VERA's address space, reading source through data
+** port 1 and writing target through data port 0, each stepping as vram_copy
+** does.  Overlapping areas copy correctly only when target is below source
+** (or, with VERA_DEC_xx steps, above it).  Leaves ADDRSEL at 0.
+*/
+void vram_vcopy(unsigned long target, unsigned long source, unsigned int num_bytes) __attribute__((leaf)); // copy VERA VRAM to VERA VRAM
+
 void waitvsync(void);  // wait for the vertical blank interrupt
 
 #ifdef __cplusplus
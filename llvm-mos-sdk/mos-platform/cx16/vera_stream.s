@@ -0,0 +1,159 @@
+.include "imag.inc"
+.include "cx16.inc"
+.text
+
+;
+; Inner loops of vram_copy, vram_fill and vram_vcopy (vram.c), which set up
+; VERA's address ports first. Each streams num_bytes through the data ports'
+; auto-increment, unrolled 8 bytes at a time.
+;
+; Source bytes are read with (zp),y rather than abs,y: the latter would need
+; the loop patched with each source address, and library code stays pure.
+;
+
+;
+; void __vera_stream_out(const void *source, unsigned int num_bytes);  // RAM to DATA0
+; llvm-mos:                         rc2/3                  A/X
+;
+.global __vera_stream_out
+.section .text.__vera_stream_out,"ax",@progbits
+__vera_stream_out:
+        sta     __rc4                   ; bytes past the whole pages
+        ldy     #0
+        cpx     #0
+        beq     .Lout_partial
+.Lout_page:
+        .rept   8
+        lda     (__rc2),y
+        sta     VERA_DATA0
+        iny
+        .endr
+        bne     .Lout_page
+        inc     __rc3
+        dex
+        bne     .Lout_page
+.Lout_partial:
+        lda     __rc4
+        and     #7
+        beq     .Lout_groups
+        tax
+.Lout_byte:
+        lda     (__rc2),y
+        sta     VERA_DATA0
+        iny
+        dex
+        bne     .Lout_byte
+.Lout_groups:
+        lda     __rc4
+        lsr
+        lsr
+        lsr
+        beq     .Lout_done
+        tax
+.Lout_group:
+        .rept   8
+        lda     (__rc2),y
+        sta     VERA_DATA0
+        iny
+        .endr
+        dex
+        bne     .Lout_group
+.Lout_done:
+        rts
+
+;
+; void __vera_stream_fill(unsigned int num_bytes, unsigned char value);  // value to DATA0
+; llvm-mos:                            A/X                     rc2
+;
+.global __vera_stream_fill
+.section .text.__vera_stream_fill,"ax",@progbits
+__vera_stream_fill:
+        sta     __rc3                   ; bytes past the whole pages
+        lda     __rc2
+        cpx     #0
+        beq     .Lfill_partial
+.Lfill_page:
+        ldy     #256/8
+.Lfill_page_group:
+        .rept   8
+        sta     VERA_DATA0
+        .endr
+        dey
+        bne     .Lfill_page_group
+        dex
+        bne     .Lfill_page
+.Lfill_partial:
+        lda     __rc3
+        and     #7
+        tax
+        lda     __rc3
+        lsr
+        lsr
+        lsr
+        tay
+        lda     __rc2
+        cpx     #0
+        beq     .Lfill_groups
+.Lfill_byte:
+        sta     VERA_DATA0
+        dex
+        bne     .Lfill_byte
+.Lfill_groups:
+        cpy     #0
+        beq     .Lfill_done
+.Lfill_group:
+        .rept   8
+        sta     VERA_DATA0
+        .endr
+        dey
+        bne     .Lfill_group
+.Lfill_done:
+        rts
+
+;
+; void __vera_stream_copy(unsigned int num_bytes);   // DATA1 to DATA0
+; llvm-mos:                            A/X
+;
+.global __vera_stream_copy
+.section .text.__vera_stream_copy,"ax",@progbits
+__vera_stream_copy:
+        sta     __rc2                   ; bytes past the whole pages
+        cpx     #0
+        beq     .Lcopy_partial
+.Lcopy_page:
+        ldy     #256/8
+.Lcopy_page_group:
+        .rept   8
+        lda     VERA_DATA1
+        sta     VERA_DATA0
+        .endr
+        dey
+        bne     .Lcopy_page_group
+        dex
+        bne     .Lcopy_page
+.Lcopy_partial:
+        lda     __rc2
+        and     #7
+        beq     .Lcopy_groups
+        tax
+.Lcopy_byte:
+        lda     VERA_DATA1
+        sta     VERA_DATA0
+        dex
+        bne     .Lcopy_byte
+.Lcopy_groups:
+        lda     __rc2
+        lsr
+        lsr
+        lsr
+        beq     .Lcopy_done
+        tay
+.Lcopy_group:
+        .rept   8
+        lda     VERA_DATA1
+        sta     VERA_DATA0
+        .endr
+        dey
+        bne     .Lcopy_group
+.Lcopy_done:
+        rts
@@ -0,0 +1,39 @@
+#include <cx16.h>
+
+// Inner loops, in vera_stream.s.
+__attribute__((leaf)) void __vera_stream_out(const void *source,
+                                             unsigned int num_bytes);
+__attribute__((leaf)) void __vera_stream_fill(unsigned int num_bytes,
+                                              unsigned char value);
+__attribute__((leaf)) void __vera_stream_copy(unsigned int num_bytes);
+
+// Point the data port selected by addrsel at addr. Bits 16-23 go to ADDRx_H
+// as in vpoke, so they may carry a VERA_INC_* or VERA_DEC_* step; with none,
+// the step is 1.
+static void vera_address(unsigned char addrsel, unsigned long addr) {
+  unsigned char hi = addr >> 16;
+  if (!(hi & 0xf0))
+    hi |= VERA_INC_1;
+  VERA.control = addrsel;
+  VERA.address = addr;
+  VERA.address_hi = hi;
+}
+
+void vram_copy(unsigned long addr, const void *source,
+               unsigned int num_bytes) {
+  vera_address(0, addr);
+  __vera_stream_out(source, num_bytes);
+}
+
+void vram_fill(unsigned long addr, unsigned char value,
+               unsigned int num_bytes) {
+  vera_address(0, addr);
+  __vera_stream_fill(num_bytes, value);
+}
+
+void vram_vcopy(unsigned long target, unsigned long source,
+                unsigned int num_bytes) {
+  vera_address(1, source);
+  vera_address(0, target);
+  __vera_stream_copy(num_bytes);
+}
@@ -0,0 +1,138 @@
+/*
+ * Math coprocessor on the bridge: mul/div/float/trig batches the Pico runs
+ * itself, answering through device 0 (see protocol.md).
+ *
+ * Licensed under the Apache License, Version 2.0 with LLVM Exceptions,
+ * See https://github.com/llvm-mos/llvm-mos-sdk/blob/main/LICENSE for license
+ * information.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "mattbrew.h"
+
+// ['M'] and as many records as a device write takes.
+#define COP_BATCH_MAX 254
+
+// Operand and result bytes per op, indexed by op.
+static const uint8_t cop_in[] = {0, 4, 4, 8, 4, 4, 8, 8, 8, 8, 8, 8, 4, 2, 2};
+static const uint8_t cop_out[] = {0, 4, 4, 4, 4, 4, 8, 8, 4, 4, 4, 4, 4, 2, 2};
+
+static uint8_t cop_cmd[1 + COP_BATCH_MAX] = {'M'};
+static uint8_t cop_len;
+static uint8_t cop_results;
+
+void cop_begin(void) {
+  cop_len = 0;
+  cop_results = 0;
+}
+
+bool cop_op(uint8_t op, const void *args) {
+  if (op == 0 || op >= sizeof(cop_in))
+    return false;
+  uint8_t in = cop_in[op];
+  if (cop_len + 1 + in > COP_BATCH_MAX ||
+      cop_results + cop_out[op] > COP_RESULT_MAX)
+    return false;
+  cop_cmd[1 + cop_len] = op;
+  memcpy(cop_cmd + 2 + cop_len, args, in);
+  cop_len += 1 + in;
+  cop_results += cop_out[op];
+  return true;
+}
+
+uint8_t cop_run(void *results) {
+  io_write(0, cop_cmd, 1 + cop_len);
+  cop_begin();
+  return io_read(0, results);
+}
+
+static void cop_one(uint8_t op, const void *args, void *result) {
+  cop_begin();
+  cop_op(op, args);
+  cop_run(result);
+}
+
+uint32_t cop_mulu16(uint16_t a, uint16_t b) {
+  const uint16_t args[2] = {a, b};
+  uint32_t r;
+  cop_one(COP_MULU16, args, &r);
+  return r;
+}
+
+int32_t cop_muls16(int16_t a, int16_t b) {
+  const int16_t args[2] = {a, b};
+  int32_t r;
+  cop_one(COP_MULS16, args, &r);
+  return r;
+}
+
+uint32_t cop_mul32(uint32_t a, uint32_t b) {
+  const uint32_t args[2] = {a, b};
+  uint32_t r;
+  cop_one(COP_MUL32, args, &r);
+  return r;
+}
+
+uint16_t cop_divu16(uint16_t n, uint16_t d, uint16_t *rem) {
+  const uint16_t args[2] = {n, d};
+  uint16_t r[2];
+  cop_one(COP_DIVU16, args, r);
+  if (rem)
+    *rem = r[1];
+  return r[0];
+}
+
+int16_t cop_divs16(int16_t n, int16_t d, int16_t *rem) {
+  const int16_t args[2] = {n, d};
+  int16_t r[2];
+  cop_one(COP_DIVS16, args, r);
+  if (rem)
+    *rem = r[1];
+  return r[0];
+}
+
+uint32_t cop_divu32(uint32_t n, uint32_t d, uint32_t *rem) {
+  const uint32_t args[2] = {n, d};
+  uint32_t r[2];
+  cop_one(COP_DIVU32, args, r);
+  if (rem)
+    *rem = r[1];
+  return r[0];
+}
+
+int32_t cop_divs32(int32_t n, int32_t d, int32_t *rem) {
+  const int32_t args[2] = {n, d};
+  int32_t r[2];
+  cop_one(COP_DIVS32, args, r);
+  if (rem)
+    *rem = r[1];
+  return r[0];
+}
+
+static float cop_float(uint8_t op, float a, float b) {
+  const float args[2] = {a, b};
+  float r;
+  cop_one(op, args, &r);
+  return r;
+}
+
+float cop_fadd(float a, float b) { return cop_float(COP_FADD, a, b); }
+float cop_fsub(float a, float b) { return cop_float(COP_FSUB, a, b); }
+float cop_fmul(float a, float b) { return cop_float(COP_FMUL, a, b); }
+float cop_fdiv(float a, float b) { return cop_float(COP_FDIV, a, b); }
+float cop_fsqrt(float a) { return cop_float(COP_FSQRT, a, 0); }
+
+int16_t cop_sin(uint16_t angle) {
+  int16_t r;
+  cop_one(COP_SIN, &angle, &r);
+  return r;
+}
+
+int16_t cop_cos(uint16_t angle) {
+  int16_t r;
+  cop_one(COP_COS, &angle, &r);
+  return r;
+}
@@ -6,13 +6,28 @@
  * information.
  */
 
-extern unsigned long millis(void);
+#include <mattbrew.h>
 
-void delay(unsigned ms)
+// Incremented by the systick ISR (crt0/systick.S).
+extern volatile uint32_t __systick_value;
+
+uint8_t wait_until(unsigned long deadline, uint8_t event_mask)
 {
-    if (ms) {
-        unsigned long start = millis();
-        while ((millis() - start) < ms)
-            ; /* do nothing */
+    for (;;) {
+        // With I set, WAI still wakes on IRQ but leaves the handler for
+        // the cli, so one landing after the checks can't be slept through.
+        asm volatile("sei" : : : "memory");
+        uint8_t ready = io_irq_pending() & event_mask;
+        if (ready || (long)(__systick_value - deadline) >= 0) {
+            asm volatile("cli" : : : "memory");
+            return ready;
+        }
+        asm volatile("wai\n cli" : : : "memory");
     }
 }
+
+void delay(unsigned ms)
+{
+    if (ms)
+        wait_until(millis() + ms, 0);
+}
@@ -0,0 +1,251 @@
+/*
+ * POSIX file calls over the bridge, for stdio's FILE streams.
+ *
+ * Files live on the Zero and are reached through device 6 (see
+ * protocol.md): reads are ordinary File read ranges, and stats, writes and
+ * truncations are its zero-count commands, each answered with the file's
+ * size.  The Zero keeps no state, so a descriptor is just the name, the
+ * position and the last size seen.  stdio's buffer does the read-ahead and
+ * write-behind: each read() or write() it makes fetches or stores the whole
+ * buffer with one request per packet.
+ *
+ * Descriptors 0-2 are the bridge terminal.
+ *
+ * Licensed under the Apache License, Version 2.0 with LLVM Exceptions,
+ * See https://github.com/llvm-mos/llvm-mos-sdk/blob/main/LICENSE for license
+ * information.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "mattbrew.h"
+
+// Descriptors 0-2 and 3 of these: stdio's FOPEN_MAX.
+#define OPEN_FILES (FOPEN_MAX - 3)
+
+// The longest name that leaves a write packet room for some data.
+#define FILE_NAME_MAX 128
+
+// A request is [off x 3][count x 2][name...]; a command, [off x 3][0 0][op]
+// [name_len][name...][data...].
+#define COMMAND_HEADER 7
+
+typedef struct {
+    char *name;         // NULL if the descriptor is free
+    uint8_t name_len;
+    uint8_t flags;      // O_* from open()
+    uint32_t pos;
+    uint32_t size;
+} File;
+
+static File files[OPEN_FILES];
+
+// One bridge packet; static, as the 6502's stack is small.
+static uint8_t packet[255];
+
+static File *lookup(int fd) {
+    if (fd < 3 || fd >= 3 + OPEN_FILES || !files[fd - 3].name) {
+        errno = EBADF;
+        return NULL;
+    }
+    return &files[fd - 3];
+}
+
+static void put_offset(uint32_t offset) {
+    packet[0] = (uint8_t)offset;
+    packet[1] = (uint8_t)(offset >> 8);
+    packet[2] = (uint8_t)(offset >> 16);
+}
+
+// Send command |op| for |f| at |offset| with |len| bytes of |data|, and
+// update f->size from the answer.  Returns false if the Zero refused.
+static bool command(File *f, uint8_t op, uint32_t offset, const uint8_t *data,
+                    uint8_t len) {
+    put_offset(offset);
+    packet[3] = 0;
+    packet[4] = 0;
+    packet[5] = op;
+    packet[6] = f->name_len;
+    memcpy(packet + COMMAND_HEADER, f->name, f->name_len);
+    memcpy(packet + COMMAND_HEADER + f->name_len, data, len);
+    io_write(FILE_DEVICE, packet, COMMAND_HEADER + f->name_len + len);
+
+    uint8_t reply[4];
+    io_read_block(FILE_DEVICE, reply, sizeof(reply));
+    if (!reply[0])
+        return false;
+    f->size = reply[1] | (uint16_t)reply[2] << 8 | (uint32_t)reply[3] << 16;
+    return true;
+}
+
+int open(const char *name, int flags, ...) {
+    size_t name_len = strlen(name);
+    if (name_len > FILE_NAME_MAX) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    File *f = NULL;
+    for (uint8_t i = 0; i < OPEN_FILES; i++) {
+        if (!files[i].name) {
+            f = &files[i];
+            break;
+        }
+    }
+    if (!f) {
+        errno = EMFILE;
+        return -1;
+    }
+    f->name = malloc(name_len);
+    if (!f->name) {
+        errno = ENOMEM;
+        return -1;
+    }
+    memcpy(f->name, name, name_len);
+    f->name_len = name_len;
+    f->flags = flags;
+    f->pos = 0;
+
+    bool exists = command(f, 'S', 0, NULL, 0);
+    int error = 0;
+    if (!exists && !(flags & O_CREAT))
+        error = ENOENT;
+    else if (exists && (flags & O_CREAT) && (flags & O_EXCL))
+        error = EEXIST;
+    else if ((!exists || (flags & O_TRUNC)) && !command(f, 'T', 0, NULL, 0))
+        error = EIO;
+    if (error) {
+        free(f->name);
+        f->name = NULL;
+        errno = error;
+        return -1;
+    }
+    return f - files + 3;
+}
+
+int close(int fd) {
+    if (fd < 3)
+        return 0;
+    File *f = lookup(fd);
+    if (!f)
+        return -1;
+    free(f->name);
+    f->name = NULL;
+    return 0;
+}
+
+// Terminal input comes a line at a time, as from a cooked tty.
+static int read_terminal(uint8_t *buf, unsigned count) {
+    unsigned n = 0;
+    while (n < count) {
+        int c = __getchar();
+        buf[n++] = c;
+        if (c == '\n')
+            break;
+    }
+    return n;
+}
+
+int read(int fd, void *buf, unsigned count) {
+    if (fd == STDIN_FILENO)
+        return read_terminal(buf, count);
+    File *f = lookup(fd);
+    if (!f)
+        return -1;
+    if ((f->flags & O_RDWR) == O_WRONLY) {
+        errno = EBADF;
+        return -1;
+    }
+
+    // The request must stop at the end of the file, since the Zero pads
+    // past it with zeros.
+    if (f->pos >= f->size)
+        return 0;
+    if (count > f->size - f->pos)
+        count = f->size - f->pos;
+
+    put_offset(f->pos);
+    packet[3] = (uint8_t)count;
+    packet[4] = (uint8_t)(count >> 8);
+    memcpy(packet + 5, f->name, f->name_len);
+    io_write(FILE_DEVICE, packet, 5 + f->name_len);
+
+    // The whole reply streams in behind one request; io_read_block() takes
+    // as much of it as the read limit allows each time.
+    uint8_t *p = buf;
+    for (unsigned left = count; left;)
+        left -= io_read_block(FILE_DEVICE, p + (count - left),
+                              left > 254 ? 254 : left);
+    f->pos += count;
+    return count;
+}
+
+int write(int fd, const void *buf, unsigned count) {
+    const uint8_t *p = buf;
+    if (fd < 3) {
+        term_flush();
+        for (unsigned left = count; left;) {
+            uint8_t len = left > 255 ? 255 : left;
+            io_write(TERM_DEVICE, p, len);
+            p += len;
+            left -= len;
+        }
+        return count;
+    }
+    File *f = lookup(fd);
+    if (!f)
+        return -1;
+    if ((f->flags & O_RDWR) == O_RDONLY) {
+        errno = EBADF;
+        return -1;
+    }
+
+    if (f->flags & O_APPEND)
+        f->pos = f->size;
+    const uint8_t room = sizeof(packet) - COMMAND_HEADER - f->name_len;
+    unsigned written = 0;
+    while (written < count) {
+        uint8_t len = count - written > room ? room : count - written;
+        if (!command(f, 'W', f->pos, p + written, len)) {
+            if (written)
+                break;
+            errno = EIO;
+            return -1;
+        }
+        f->pos += len;
+        written += len;
+    }
+    return written;
+}
+
+off_t lseek(int fd, off_t offset, int whence) {
+    File *f = lookup(fd);
+    if (!f)
+        return -1;
+    switch (whence) {
+    case SEEK_CUR:
+        offset += f->pos;
+        break;
+    case SEEK_END:
+        offset += f->size;
+        break;
+    case SEEK_SET:
+        break;
+    default:
+        errno = EINVAL;
+        return -1;
+    }
+    // Offsets travel as 24 bits.
+    if (offset < 0 || offset > 0xFFFFFFL) {
+        errno = EINVAL;
+        return -1;
+    }
+    f->pos = offset;
+    return offset;
+}
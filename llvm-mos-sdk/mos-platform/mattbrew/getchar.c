@@ -1,11 +1,32 @@
 /*
- * Stub for standard input (no input device available).
+ * Read standard input from the bridge keyboard (device 2).
+ *
+ * A device 2 read returns everything the bridge has buffered, up to 254
+ * bytes, so input is fetched in bulk into a full-size buffer and handed
+ * out one character at a time.  Pending output is flushed first, so a
+ * prompt is visible before the program waits on the keyboard.
  *
  * Licensed under the Apache License, Version 2.0 with LLVM Exceptions,
  * See https://github.com/llvm-mos/llvm-mos-sdk/blob/main/LICENSE for license
  * information.
  */
 
+#include <stdint.h>
 #include <stdio.h>
 
-int __getchar(void) { return EOF; }
+#include "mattbrew.h"
+
+static uint8_t stdin_buf[255];
+static uint8_t stdin_len;
+static uint8_t stdin_pos;
+
+int __getchar(void) {
+  if (stdin_pos == stdin_len) {
+    term_flush();
+    do {
+      stdin_len = io_read(TERM_DEVICE, stdin_buf);
+    } while (stdin_len == 0);
+    stdin_pos = 0;
+  }
+  return stdin_buf[stdin_pos++];
+}
@@ -3,31 +3,192 @@
 
 #define IO_PORT (*(volatile uint8_t *)RPI_BASE)
 
-// Core read — returns bytes read (0 = no data)
-uint8_t io_read(uint8_t device_id, uint8_t *buf) {
-    IO_PORT = device_id | 0x80;
+// State shared with __bridge_isr (crt0/bridge_irq.S): the devices the
+// program asked for, those enabled at the bridge (less any whose ring is too
+// full to take another read), and each device's ring.
+extern uint8_t __bridge_irq_devices;
+extern volatile uint8_t __bridge_irq_armed;
+extern uint8_t __bridge_ring_lo[8];
+extern uint8_t __bridge_ring_hi[8];
+extern volatile uint8_t __bridge_ring_head[8];
+extern volatile uint8_t __bridge_ring_tail[8];
 
-    uint8_t len;
-    while ((len = IO_PORT) == 0xFF);
+// Millisecond tick length in 6502 cycles, less the ISR's own (crt0/systick.S).
+extern volatile uint16_t __systick_reload;
 
-    for (uint8_t i = 0; i < len; i++) {
-        buf[i] = IO_PORT;
-    }
-    return len;
+// Bridge transactions are multi-byte, so keep the IRQ handler (which does
+// its own) from landing in the middle of one.
+static inline uint8_t irq_save(void) {
+    uint8_t p;
+    asm volatile("php\n pla\n sei" : "=a"(p) : : "memory");
+    return p;
 }
 
-// Core write
-void io_write(uint8_t device_id, const uint8_t *buf, uint8_t len) {
-    IO_PORT = device_id;
-    IO_PORT = len;
-    for (uint8_t i = 0; i < len; i++) {
-        IO_PORT = buf[i];
-    }
+static inline void irq_restore(uint8_t p) {
+    if (!(p & 0x04)) asm volatile("cli" : : : "memory");
 }
 
+// io_read(), io_write() and io_read_any() are in bridge_io.S.
+
 // Convenience: write a single byte
 void io_write1(uint8_t device_id, uint8_t data) {
+    uint8_t p = irq_save();
     IO_PORT = device_id;
     IO_PORT = 1;
     IO_PORT = data;
-}
\ No newline at end of file
+    irq_restore(p);
+}
+
+// Device 1 ['I', mask, limit]: the bridge raises IRQ for |mask| and caps
+// each read-any response at the ring's chunk size.
+static void irq_arm(uint8_t mask) {
+    const uint8_t cmd[3] = { 'I', mask, IO_IRQ_CHUNK };
+    __bridge_irq_armed = mask;
+    io_write(1, cmd, sizeof(cmd));
+}
+
+void io_irq_start(uint8_t mask, uint8_t rings[][256]) {
+    uint8_t p = irq_save();
+    mask &= 0xFE;
+    for (uint8_t d = 0; d < 8; d++) {
+        __bridge_ring_head[d] = 0;
+        __bridge_ring_tail[d] = 0;
+        if (mask & (1 << d)) {
+            __bridge_ring_lo[d] = (uint8_t)(uintptr_t)*rings;
+            __bridge_ring_hi[d] = (uint8_t)((uintptr_t)*rings >> 8);
+            rings++;
+        }
+    }
+    __bridge_irq_devices = mask;
+    irq_arm(mask);
+    irq_restore(p);
+}
+
+void io_irq_stop(void) {
+    const uint8_t cmd[2] = { 'I', 0 };
+    uint8_t p = irq_save();
+    __bridge_irq_devices = 0;
+    __bridge_irq_armed = 0;
+    io_write(1, cmd, sizeof(cmd));
+    irq_restore(p);
+}
+
+// Device 1 ['Q', device, bytes (LE16), us (LE16)]
+void io_irq_coalesce(uint8_t device_id, uint16_t bytes, uint16_t us) {
+    const uint8_t cmd[6] = {
+        'Q', device_id, (uint8_t)bytes, (uint8_t)(bytes >> 8),
+        (uint8_t)us, (uint8_t)(us >> 8),
+    };
+    io_write(1, cmd, sizeof(cmd));
+}
+
+// Take up to |max| bytes of |device_id|'s ring into |buf|, and re-enable
+// the bridge IRQ for it once a full chunk fits again.
+static uint8_t ring_take(uint8_t device_id, uint8_t *buf, uint8_t max) {
+    const uint8_t *ring = (const uint8_t *)(uintptr_t)(__bridge_ring_lo[device_id] |
+                                                       __bridge_ring_hi[device_id] << 8);
+    uint8_t t = __bridge_ring_tail[device_id];
+    uint8_t n = __bridge_ring_head[device_id] - t;
+    if (n > max) n = max;
+    for (uint8_t i = 0; i < n; i++) {
+        buf[i] = ring[t++];
+    }
+    __bridge_ring_tail[device_id] = t;
+
+    uint8_t bit = 1 << device_id;
+    if ((__bridge_irq_devices & bit) && !(__bridge_irq_armed & bit)) {
+        uint8_t p = irq_save();
+        if ((uint8_t)(t - __bridge_ring_head[device_id] - 1) >= IO_IRQ_CHUNK) {
+            irq_arm(__bridge_irq_armed | bit);
+        }
+        irq_restore(p);
+    }
+    return n;
+}
+
+// io_read() and io_read_block() of a device given to io_irq_start()
+// (bridge_io.S jumps here).
+uint8_t __io_ring_read(uint8_t device_id, uint8_t *buf) {
+    return ring_take(device_id, buf, 254);
+}
+
+uint8_t __io_ring_read_block(uint8_t device_id, uint8_t *buf, uint8_t len) {
+    if (len == 0) return ring_take(device_id, buf, 254);
+    if (len > IO_IRQ_CHUNK) len = IO_IRQ_CHUNK;
+    while ((uint8_t)(__bridge_ring_head[device_id] -
+                     __bridge_ring_tail[device_id]) < len) {
+    }
+    return ring_take(device_id, buf, len);
+}
+
+uint8_t io_irq_read(uint8_t *device_id, uint8_t *buf) {
+    for (uint8_t d = 1; d < 8; d++) {
+        if (__bridge_ring_head[d] != __bridge_ring_tail[d]) {
+            *device_id = d;
+            return ring_take(d, buf, IO_IRQ_CHUNK);
+        }
+    }
+    return 0;
+}
+
+uint8_t io_irq_pending(void) {
+    uint8_t ready = 0;
+    for (uint8_t d = 1; d < 8; d++) {
+        if (__bridge_ring_head[d] != __bridge_ring_tail[d]) ready |= 1 << d;
+    }
+    return ready;
+}
+
+// Device 1 ['C', mhz] switches the 6502 clock; the VIA counts 6502 cycles,
+// so the tick is rescaled to stay 1 ms.
+static void clock_switch(uint8_t mhz) {
+    const uint8_t cmd[2] = { 'C', mhz };
+    uint8_t p = irq_save();
+    io_write(1, cmd, sizeof(cmd));
+    __systick_reload = 1000u * mhz - 24;
+    irq_restore(p);
+}
+
+// Round-trip a pattern through the Device 0 loopback.  It is compared as it
+// streams in, so a garbled length can't overrun a buffer, and the poll gives
+// up rather than hang if the bridge never answers.
+static bool clock_test(void) {
+    static const uint8_t pattern[] = {
+        0x00, 0xFF, 0x55, 0xAA, 0x01, 0x02, 0x04, 0x08,
+        0x10, 0x20, 0x40, 0x80, 0xFE, 0xFD, 0xFB, 0xF7,
+        0xEF, 0xDF, 0xBF, 0x7F,
+    };
+    uint8_t p = irq_save();
+    IO_PORT = 0;
+    IO_PORT = sizeof(pattern) + 1;
+    IO_PORT = 'T';
+    for (uint8_t i = 0; i < sizeof(pattern); i++) {
+        IO_PORT = pattern[i];
+    }
+
+    IO_PORT = 0x80;
+    uint8_t len;
+    uint8_t tries = 255;
+    while ((len = IO_PORT) == 0xFF) {
+        if (--tries == 0) {
+            irq_restore(p);
+            return false;
+        }
+    }
+    bool ok = len == sizeof(pattern);
+    for (uint8_t i = 0; i < len; i++) {
+        uint8_t b = IO_PORT;
+        if (i >= sizeof(pattern) || b != pattern[i]) ok = false;
+    }
+    irq_restore(p);
+    return ok;
+}
+
+bool io_set_clock(uint8_t mhz) {
+    // The bridge's CLK_6502_SPEEDS
+    if (mhz != 1 && mhz != 2 && mhz != 4) return false;
+    clock_switch(mhz);
+    if (clock_test()) return true;
+    clock_switch(1);
+    return false;
+}
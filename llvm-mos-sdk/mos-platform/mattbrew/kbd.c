@@ -0,0 +1,73 @@
+/*
+ * Raw key events from the bridge keyboard (device 2).
+ *
+ * Records come in bulk as getchar.c's characters do, and one may straddle
+ * two reads, so a leftover byte moves to the front for the next.  Each
+ * event sets or clears its code's bit in a bitmap of the keys held down;
+ * the bit masks come from a table rather than a variable shift, which the
+ * 6502 can only do a bit at a time.
+ *
+ * Licensed under the Apache License, Version 2.0 with LLVM Exceptions,
+ * See https://github.com/llvm-mos/llvm-mos-sdk/blob/main/LICENSE for license
+ * information.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "mattbrew.h"
+
+static uint8_t kbd_buf[256];
+static uint8_t kbd_len;
+static uint8_t kbd_pos;
+static uint8_t held[256 / 8];
+
+static const uint8_t bit[8] = {0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80};
+
+// What shift makes of ' ' to '~', US layout.
+static const char shifted[0x7F - ' '] =
+    " !\"#$%&\"()*+<_>?)!@#$%^&*(::<+>?"
+    "@ABCDEFGHIJKLMNOPQRSTUVWXYZ{|}^_"
+    "~ABCDEFGHIJKLMNOPQRSTUVWXYZ{|}~";
+
+void kbd_raw(bool on) {
+  uint8_t packet[3] = {0x02, 'R', on};
+  term_flush();
+  io_write(TERM_DEVICE, packet, sizeof(packet));
+  memset(held, 0, sizeof(held));
+  kbd_len = kbd_pos = 0;
+}
+
+bool kbd_event(uint8_t *code, uint8_t *flags) {
+  if ((uint8_t)(kbd_len - kbd_pos) < 2) {
+    uint8_t left = kbd_len - kbd_pos;
+    if (left)
+      kbd_buf[0] = kbd_buf[kbd_pos];
+    kbd_len = left + io_read(TERM_DEVICE, kbd_buf + left);
+    kbd_pos = 0;
+    if (kbd_len < 2)
+      return false;
+  }
+  uint8_t c = kbd_buf[kbd_pos++];
+  uint8_t f = kbd_buf[kbd_pos++];
+  if (f & KEY_RELEASED)
+    held[c >> 3] &= ~bit[c & 7];
+  else
+    held[c >> 3] |= bit[c & 7];
+  *code = c;
+  *flags = f;
+  return true;
+}
+
+bool kbd_held(uint8_t code) { return held[code >> 3] & bit[code & 7]; }
+
+char kbd_char(uint8_t code, uint8_t flags) {
+  if (code >= 0x7F)
+    return 0;
+  if (code < ' ')
+    return (char)code;
+  if ((flags & KEY_MOD_CTRL) && code >= 'a' && code <= 'z')
+    return (char)(code - 'a' + 1);
+  return (flags & KEY_MOD_SHIFT) ? shifted[code - ' '] : (char)code;
+}
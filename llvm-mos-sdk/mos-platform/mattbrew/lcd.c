@@ -4,15 +4,18 @@
  *   PORTB (VIA_BASE+0): 8-bit data bus
  *   PORTA (VIA_BASE+1): control signals (E=0x80, RW=0x40, RS=0x20)
  *
+ * Instructions and characters go on a queue that __lcd_drain
+ * (crt0/lcd_queue.S) sends from the systick ISR once the LCD's busy flag
+ * clears, so callers don't wait out the LCD's execution time.
+ *
  * Licensed under the Apache License, Version 2.0 with LLVM Exceptions,
  * See https://github.com/llvm-mos/llvm-mos-sdk/blob/main/LICENSE for license
  * information.
  */
 
+#include <stdint.h>
 #include <mattbrew.h>
 
-#define VIA_PORTB   (*((volatile unsigned char *)(VIA_BASE + 0x00)))
-#define VIA_PORTA   (*((volatile unsigned char *)(VIA_BASE + 0x01)))
 #define VIA_DDRB    (*((volatile unsigned char *)(VIA_BASE + 0x02)))
 #define VIA_DDRA    (*((volatile unsigned char *)(VIA_BASE + 0x03)))
 
@@ -36,42 +39,43 @@ void lcd_init(void)
     lcd_instruction(LCD_I_CLEAR);
 }
 
-// Wait for the LCD to not be busy.
-static void lcd_wait(void)
-{
-    unsigned char status;
+// The queue, shared with __lcd_drain.
+extern volatile uint8_t __lcd_queue_head;
+extern volatile uint8_t __lcd_queue_tail;
+extern uint8_t __lcd_queue_data[LCD_QUEUE_SIZE];
+extern uint8_t __lcd_queue_ctrl[LCD_QUEUE_SIZE];
+void __lcd_drain(void);
 
-    // Convert PORTB data pins to inputs.
-    VIA_DDRB = 0x00;
+// Send what the LCD will take now, with the systick ISR kept out; for when
+// waiting on it won't do, as interrupts may be masked.
+static void lcd_drain(void)
+{
+    uint8_t p;
+    asm volatile("php\n pla\n sei" : "=a"(p) : : "memory");
+    __lcd_drain();
+    if (!(p & 0x04)) asm volatile("cli" : : : "memory");
+}
 
-    // Wait until the LCD reports that it is not busy.
-    do {
-        VIA_PORTA = LCD_RW;
-        VIA_PORTA = LCD_RW | LCD_E;
-        status = VIA_PORTB;
-        VIA_PORTA = LCD_RW;
-    } while ((status & 0x80) != 0);
+static void lcd_queue(unsigned char c, unsigned char ctrl)
+{
+    uint8_t head = __lcd_queue_head;
+    uint8_t next = (head + 1) & (LCD_QUEUE_SIZE - 1);
 
-    // Return PORTB data pins to outputs.
-    VIA_DDRB = 0xFF;
+    while (next == __lcd_queue_tail)
+        lcd_drain();
+    __lcd_queue_data[head] = c;
+    __lcd_queue_ctrl[head] = ctrl;
+    __lcd_queue_head = next;
 }
 
 void lcd_instruction(unsigned char insn)
 {
-    lcd_wait();
-    VIA_PORTB = insn;
-    VIA_PORTA = 0;
-    VIA_PORTA = LCD_E;
-    VIA_PORTA = 0;
+    lcd_queue(insn, 0);
 }
 
 void lcd_putchar(unsigned char c)
 {
-    lcd_wait();
-    VIA_PORTB = c;
-    VIA_PORTA = LCD_RS;
-    VIA_PORTA = LCD_RS | LCD_E;
-    VIA_PORTA = LCD_RS;
+    lcd_queue(c, LCD_RS);
 }
 
 void lcd_puts(const char *str)
@@ -80,3 +84,9 @@ void lcd_puts(const char *str)
     while ((c = *str++) != '\0')
         lcd_putchar((unsigned char)c);
 }
+
+void lcd_flush(void)
+{
+    while (__lcd_queue_tail != __lcd_queue_head)
+        lcd_drain();
+}
@@ -15,9 +15,33 @@ extern "C" {
 // Get the value of the system millisecond tick counter.
 unsigned long millis(void);
 
-// Wait for a specific number of milliseconds.
+// Wait for a specific number of milliseconds, sleeping (WAI) between
+// interrupts.
 void delay(unsigned ms);
 
+// Sleep (WAI) until millis() reaches |deadline| or a device in |event_mask|
+// has data in its io_irq_start() ring, whichever comes first. Returns those
+// devices of |event_mask| with data; 0 means the deadline passed.
+// Interrupts must be enabled.
+uint8_t wait_until(unsigned long deadline, uint8_t event_mask);
+
+// Timers: up to TIMERS_MAX callbacks run by timer_run() from the main
+// loop (never from an interrupt), so they may do anything.
+#define TIMERS_MAX 8
+
+// Run |fn| in |ms| milliseconds, then every |period| ms unless that is 0.
+// Returns the timer's id, or -1 if all are in use.
+int8_t timer_start(unsigned ms, unsigned period, void (*fn)(void));
+
+// Stop a timer; an id of -1 is ignored.
+void timer_stop(int8_t id);
+
+// Run the timers that are due. If none were, sleep until one is or a device
+// in |event_mask| has ring data, and run any then due. Returns the devices
+// of |event_mask| with data, as wait_until() does:
+//   for (;;) { if (timer_run(1 << TERM_DEVICE)) handle_input(); }
+uint8_t timer_run(uint8_t event_mask);
+
 // LCD instructions.
 #define LCD_I_CLEAR     0x01    // Clear the display.
 #define LCD_I_HOME      0x02    // Move the cursor to the home position.
@@ -32,30 +56,331 @@ void delay(unsigned ms);
 #define LCD_I_CGRAM     0x40    // Set CGRAM address (offset in low bits).
 #define LCD_I_DDRAM     0x80    // Set DDRAM address (offset in low bits).
 
+// LCD output queue entries. The systick ISR sends them whenever the LCD
+// isn't busy, so writes return without waiting on it. Also update
+// crt0/lcd_queue.S if this changes.
+#define LCD_QUEUE_SIZE  32
+
 // Initialize the LCD in 8-bit mode, 2 lines, 5x8 font and clear the display.
 void lcd_init(void);
 
-// Send an instruction to the LCD.
+// Queue an instruction for the LCD.
 void lcd_instruction(unsigned char insn);
 
-// Put a character to the LCD.
+// Queue a character for the LCD.
 void lcd_putchar(unsigned char c);
 
-// Put a string to the LCD.
+// Queue a string for the LCD.
 void lcd_puts(const char *str);
 
+// Wait until everything queued has reached the LCD.
+void lcd_flush(void);
+
 // Address of the Pi Pico bridge.
 #define RPI_BASE 0xE040
 
+// Bridge status port (CPLD/chipsel_fast.pld boards only): bit n is set
+// while device n has data, read without a bridge transaction.
+#define RPI_STATUS 0xE0C0
+#define IO_STATUS (*(volatile uint8_t *)RPI_STATUS)
+
 // Core read — returns bytes read (0 = no data)
 uint8_t io_read(uint8_t device_id, uint8_t *buf);
 
+// Read exactly |len| bytes of a device into |buf|, waiting until the bridge
+// has them all — for payloads whose length is known, such as the rest of a
+// netboot image. Returns |len| (capped at 254, or IO_IRQ_CHUNK while
+// interrupt input runs); a |len| of 0 reads like io_read().
+uint8_t io_read_block(uint8_t device_id, uint8_t *buf, uint8_t len);
+
 // Core write
 void io_write(uint8_t device_id, const uint8_t *buf, uint8_t len);
 
 // Write a single byte
 void io_write1(uint8_t device_id, uint8_t data);
 
+// Pseudo-device for io_read_any(). Also update crt0/bridge_irq.S.
+#define IO_READ_ANY 0x0F
+
+// Read every device in |mask| (bit n = device n) that has data in one
+// handshake. |buf| (255 bytes) gets [device][len][data...] records, in
+// device order; returns their total length (0 = no data).
+uint8_t io_read_any(uint8_t mask, uint8_t *buf);
+
+// Bridge terminal: device 2 writes are output, reads are keyboard input.
+// stdout/stdin (putchar.c, getchar.c) go through it.
+#define TERM_DEVICE 2
+
+// Bridge files: device 6 reads any byte range of a file on the Zero, and
+// takes commands that stat, write and truncate one.  open(), read(),
+// write(), lseek() and close() (file.c) go through it, and so fopen() and
+// the rest of stdio.
+#define FILE_DEVICE 6
+
+// Bridge sockets: device 4 carries TCP connections that the Zero makes
+// and takes (see protocol.md), NET_SOCKETS at once, numbered by the program.
+// The Zero answers each with events, read with net_poll().
+#define NET_DEVICE 4
+#define NET_SOCKETS 8
+
+// net_poll() events, in the second byte of each record.
+#define NET_EV_OPEN     'O'   // ok in the third: connected or listening
+#define NET_EV_ACCEPT   'A'   // A listening socket took a connection
+#define NET_EV_DATA     'D'   // Received data from the third byte on
+#define NET_EV_CLOSED   'X'   // Closed by either end; the number is free
+
+// Connect |sock| to |host| (a name or dotted address) on |port|.
+void net_connect(uint8_t sock, const char *host, uint16_t port);
+
+// Have |sock| take the next connection to |port| on the Zero.
+void net_listen(uint8_t sock, uint16_t port);
+
+// Send |len| bytes on a connected |sock|.
+void net_send(uint8_t sock, const uint8_t *data, uint16_t len);
+
+// Close |sock|; NET_EV_CLOSED follows any data still on its way.
+void net_close(uint8_t sock);
+
+// Read the next event into |buf| (255 bytes): [sock][event][data...].
+// Returns its length, or 0 if there is none yet. Data comes as it arrives,
+// for every socket in turn; leaving it unread holds them all up.
+uint8_t net_poll(uint8_t *buf);
+
+// Send any buffered stdout text to the terminal now. Newlines, full
+// buffers, input reads and exit flush automatically.
+void term_flush(void);
+
+// Raw key events (see protocol.md): in place of characters, device 2 reads
+// bring a [code][flags] record for each key going down or up. Codes below
+// 0x80 are the key's character, letters always lower case; the rest are
+// below. Terminals that can't report key-up send each key straight back up.
+#define KEY_BACKSPACE   0x08
+#define KEY_TAB         0x09
+#define KEY_ENTER       0x0A
+#define KEY_ESCAPE      0x1B
+#define KEY_UP          0x80
+#define KEY_DOWN        0x81
+#define KEY_RIGHT       0x82
+#define KEY_LEFT        0x83
+#define KEY_HOME        0x84
+#define KEY_END         0x85
+#define KEY_PAGE_UP     0x86
+#define KEY_PAGE_DOWN   0x87
+#define KEY_INSERT      0x88
+#define KEY_DELETE      0x89
+#define KEY_F(n)        (0x90 + (n))  // F5 to F12 only
+#define KEY_LSHIFT      0xA0
+#define KEY_RSHIFT      0xA1
+#define KEY_LCTRL       0xA2
+#define KEY_RCTRL       0xA3
+#define KEY_LALT        0xA4
+#define KEY_RALT        0xA5
+#define KEY_LSUPER      0xA6
+#define KEY_RSUPER      0xA7
+
+// Record flags.
+#define KEY_MOD_SHIFT   0x01
+#define KEY_MOD_CTRL    0x02
+#define KEY_MOD_ALT     0x04
+#define KEY_MOD_SUPER   0x08
+#define KEY_RELEASED    0x80
+
+// Switch to raw key events (true) or back to characters. Either way no key
+// is held to begin with; a reset switches back by itself.
+void kbd_raw(bool on);
+
+// Take the next event without waiting: returns false if there is none.
+bool kbd_event(uint8_t *code, uint8_t *flags);
+
+// Whether |code| is down, going by the events taken so far.
+bool kbd_held(uint8_t code);
+
+// The character a key going down with |flags| types (US layout, Ctrl
+// making control codes of letters), or 0 for keys with none.
+char kbd_char(uint8_t code, uint8_t flags);
+
+// Bridge pixel mode: a framebuffer on the Zero of PIX_WIDTH x PIX_HEIGHT
+// palette indexes (16 colors), drawn by device 2 pixel packets (see
+// protocol.md) and shown in place of the terminal while pix_mode() is on.
+// Draws land in a back buffer; pix_present() shows the region drawn since
+// the last one. Each call queues a command, sent when the queue is full, at
+// pix_present() or at pix_flush(). Packed pixels are |bpp| = 1, 2 or 4 bits
+// each, leftmost in the high bits.
+#define PIX_WIDTH   320
+#define PIX_HEIGHT  200
+#define PIX_TILE    8         // Tiles are PIX_TILE pixels square
+#define PIX_TILES_MAX 250     // Most tiles one pix_tiles() call takes
+
+// Show the framebuffer (true) or the terminal.
+void pix_mode(bool on);
+
+// Set |count| palette entries from |first|, 3 bytes (R, G, B) each. The
+// change shows at once, present or not.
+void pix_palette(uint8_t first, uint8_t count, const uint8_t *rgb);
+
+// Define |tile| (0-255) from PIX_TILE packed rows of PIX_TILE pixels.
+void pix_tile(uint8_t tile, uint8_t bpp, const uint8_t *data);
+
+// Draw |count| tiles on the grid of tiles from (|col|, |row|), going on to
+// the next row at the end of one.
+void pix_tiles(uint8_t col, uint8_t row, uint8_t count, const uint8_t *tiles);
+
+// Draw |width| packed pixels from (|x|, |y|).
+void pix_row(uint16_t x, uint8_t y, uint16_t width, uint8_t bpp,
+             const uint8_t *data);
+
+// Fill a |w| x |h| rectangle at (|x|, |y|) with |color|.
+void pix_fill(uint16_t x, uint8_t y, uint16_t w, uint8_t h, uint8_t color);
+
+// Copy a |w| x |h| rectangle at (|x|, |y|) to (|to_x|, |to_y|); the two
+// may overlap, so this scrolls.
+void pix_copy(uint16_t x, uint8_t y, uint16_t w, uint8_t h, uint16_t to_x,
+              uint8_t to_y);
+
+// Show what was drawn since the last present, and send the queue.
+void pix_present(void);
+
+// Send the queued commands now.
+void pix_flush(void);
+
+// Largest read-any response the IRQ handler asks of the bridge (this also
+// caps io_read_any() while interrupt input runs). Also update
+// crt0/bridge_irq.S if this changes.
+#define IO_IRQ_CHUNK 64
+
+// Start interrupt-driven input: the bridge raises IRQ while any device in
+// |mask| (bit n = device n, 1-7) has data, and the IRQ handler drains each
+// into its own ring of |rings|, one per set bit in device order. From then
+// on io_read(), io_read_block() and getchar() of those devices read their
+// ring, and io_read_any() leaves them out. A device whose ring is full
+// waits in the bridge until it's read.
+void io_irq_start(uint8_t mask, uint8_t rings[][256]);
+
+// Stop interrupt-driven input: the devices are read from the bridge again.
+// Unread ring data stays for io_irq_read().
+void io_irq_stop(void);
+
+// Have the bridge hold off the IRQ for |device| until it has |bytes|
+// buffered or its oldest byte has waited |us| microseconds, so a stream
+// (such as the network) is taken in batches. bytes = 1 is immediate, the
+// default for all but the network. Lasts until the bridge reboots.
+void io_irq_coalesce(uint8_t device_id, uint16_t bytes, uint16_t us);
+
+// Take what the rings hold of the lowest device with data into |buf| (at
+// most IO_IRQ_CHUNK bytes) — returns its length and sets |device_id|, or
+// returns 0 if every ring is empty.
+uint8_t io_irq_read(uint8_t *device_id, uint8_t *buf);
+
+// The devices (bit n = device n) whose rings hold data.
+uint8_t io_irq_pending(void);
+
+// Bank select register (readable) and the banked RAM window it maps. Also
+// update bank.S if this changes.
+#define BANK_SEL            0xE080
+#define BANK_WINDOW         0xA000
+#define BANK_WINDOW_SIZE    0x4000
+#define BANK_COUNT          32
+
+// Get and set the bank mapped into the window.
+uint8_t get_bank(void);
+void set_bank(uint8_t bank);
+
+// Call |fn| with |bank| mapped, then map the caller's bank again.
+__attribute__((leaf, callback(2))) void banked_call(uint8_t bank,
+                                                    void (*fn)(void));
+
+// Overlays are sections linked to run in the window (see overlay.ld), fetched
+// through netboot the first time they are called and kept in a cache of
+// banks, the least recently used of which is reused when a new one is needed.
+#define OVERLAY_COUNT 16
+
+// Cache overlays in banks |first_bank| to |first_bank| + |banks| - 1 (banks
+// the program doesn't use otherwise), fetching overlay N from the Zero file
+// named |prefix| followed by N in decimal ("zork.ov3"). |prefix| must stay
+// valid. Forgets anything cached before.
+void overlay_init(const char *prefix, uint8_t first_bank, uint8_t banks);
+
+// Call |fn| in |overlay|, fetching the overlay first if it isn't cached, then
+// map the caller's bank again. Returns false, without calling |fn|, if the
+// Zero doesn't have the overlay, it doesn't fit in the window, or every cache
+// bank holds an overlay still running further up the stack. Pointers passed
+// to |fn| must not point into the caller's own window.
+__attribute__((leaf, callback(2))) bool overlay_call(uint8_t overlay,
+                                                     void (*fn)(void));
+
+// Fetch |overlay| now, if it isn't cached, so that a later call won't wait.
+// The window's mapping is left unchanged. Returns false as overlay_call() does.
+bool overlay_load(uint8_t overlay);
+
+// Expansion RAM: REU_SIZE bytes of paged storage kept by the bridge itself,
+// with no Zero round trip. Stashes and fetches start at the address set by
+// reu_seek() and advance it, wrapping at the end. The contents outlast a
+// reset but not a power cycle.
+#define REU_SIZE        0x40000UL
+#define REU_FETCH_MAX   254
+
+void reu_seek(uint32_t addr);
+void reu_stash(const void *buf, uint16_t len);
+void reu_fetch(void *buf, uint16_t len);
+
+// CRC-32 (IEEE, as zlib) of |len| bytes of expansion RAM from the current
+// address, wrapping; the address is left where it is. The bridge runs it on
+// its DMA hardware, about 2ms for the whole REU_SIZE.
+uint32_t reu_crc32(uint32_t len);
+
+// Math coprocessor: the bridge's Cortex-M33 does the arithmetic (see
+// protocol.md). cop_op() adds an operation, its operands packed
+// little-endian in |args|, to the batch begun by cop_begin(); it returns
+// false, adding nothing, once the batch is full. cop_run() sends the batch
+// and copies the results back to back into |results|, returning their
+// length. The wrappers below run one operation each as a batch of its own,
+// so they must not be called while building one. A single operation costs
+// two bus transactions, which beats the software routines for 32-bit
+// division and floats; a batch of anything does better still. Angles are in
+// 65536ths of a turn and sines come back with 1.0 = 0x4000.
+#define COP_MULU16      0x01
+#define COP_MULS16      0x02
+#define COP_MUL32       0x03
+#define COP_DIVU16      0x04
+#define COP_DIVS16      0x05
+#define COP_DIVU32      0x06
+#define COP_DIVS32      0x07
+#define COP_FADD        0x08
+#define COP_FSUB        0x09
+#define COP_FMUL        0x0A
+#define COP_FDIV        0x0B
+#define COP_FSQRT       0x0C
+#define COP_SIN         0x0D
+#define COP_COS         0x0E
+#define COP_RESULT_MAX  254
+
+void cop_begin(void);
+bool cop_op(uint8_t op, const void *args);
+uint8_t cop_run(void *results);
+
+uint32_t cop_mulu16(uint16_t a, uint16_t b);
+int32_t cop_muls16(int16_t a, int16_t b);
+uint32_t cop_mul32(uint32_t a, uint32_t b);
+// Quotients, with the remainder stored through |rem| unless it is NULL.
+// Dividing by zero gives all ones (-1) and the dividend as the remainder.
+uint16_t cop_divu16(uint16_t n, uint16_t d, uint16_t *rem);
+int16_t cop_divs16(int16_t n, int16_t d, int16_t *rem);
+uint32_t cop_divu32(uint32_t n, uint32_t d, uint32_t *rem);
+int32_t cop_divs32(int32_t n, int32_t d, int32_t *rem);
+float cop_fadd(float a, float b);
+float cop_fsub(float a, float b);
+float cop_fmul(float a, float b);
+float cop_fdiv(float a, float b);
+float cop_fsqrt(float a);
+int16_t cop_sin(uint16_t angle);
+int16_t cop_cos(uint16_t angle);
+
+// Switch the 6502 clock to |mhz| (1, 2 or 4) and check the bridge bus with
+// a loopback pattern. If the test fails the clock goes back to 1 MHz and
+// this returns false (as it does, changing nothing, for other speeds).
+// millis() and delay() stay in milliseconds either way.
+bool io_set_clock(uint8_t mhz);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,62 @@
+/*
+ * TCP sockets over the bridge.
+ *
+ * The Zero runs the connections (device 4, see protocol.md): each call here
+ * is a single command write, and received data and events come back as
+ * device 4 records that net_poll() reads straight into the caller's buffer.
+ *
+ * Licensed under the Apache License, Version 2.0 with LLVM Exceptions,
+ * See https://github.com/llvm-mos/llvm-mos-sdk/blob/main/LICENSE for license
+ * information.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "mattbrew.h"
+
+// A command is [op][sock][args...], in one device write.
+#define NET_COMMAND_MAX 255
+#define NET_SEND_MAX (NET_COMMAND_MAX - 2)
+
+static uint8_t net_cmd[NET_COMMAND_MAX];
+
+static void net_open(uint8_t op, uint8_t sock, uint16_t port, const char *host,
+                     uint8_t host_len) {
+  net_cmd[0] = op;
+  net_cmd[1] = sock;
+  net_cmd[2] = (uint8_t)port;
+  net_cmd[3] = (uint8_t)(port >> 8);
+  memcpy(net_cmd + 4, host, host_len);
+  io_write(NET_DEVICE, net_cmd, 4 + host_len);
+}
+
+void net_connect(uint8_t sock, const char *host, uint16_t port) {
+  size_t len = strlen(host);
+  net_open('C', sock, port, host,
+           len > NET_COMMAND_MAX - 4 ? NET_COMMAND_MAX - 4 : (uint8_t)len);
+}
+
+void net_listen(uint8_t sock, uint16_t port) {
+  net_open('L', sock, port, "", 0);
+}
+
+void net_send(uint8_t sock, const uint8_t *data, uint16_t len) {
+  net_cmd[0] = 'S';
+  net_cmd[1] = sock;
+  while (len) {
+    uint8_t n = len > NET_SEND_MAX ? NET_SEND_MAX : (uint8_t)len;
+    memcpy(net_cmd + 2, data, n);
+    io_write(NET_DEVICE, net_cmd, 2 + n);
+    data += n;
+    len -= n;
+  }
+}
+
+void net_close(uint8_t sock) {
+  net_cmd[0] = 'X';
+  net_cmd[1] = sock;
+  io_write(NET_DEVICE, net_cmd, 2);
+}
+
+uint8_t net_poll(uint8_t *buf) { return io_read(NET_DEVICE, buf); }
@@ -0,0 +1,155 @@
+/*
+ * Overlay manager: overlays (overlay.ld) cached in banks of the window.
+ *
+ * A cache bank either holds one overlay or is free.  The banks are kept in
+ * use order, most recent first; a missing overlay goes into a free bank if
+ * there is one, or else the least recently used bank that nothing on the
+ * call stack is running in, and is fetched into it through netboot (device
+ * 3, see protocol.md).  That reads a 2-byte big-endian length, then the
+ * file's contents in chunks of up to 128 bytes, which go straight to the
+ * window.
+ *
+ * Licensed under the Apache License, Version 2.0 with LLVM Exceptions,
+ * See https://github.com/llvm-mos/llvm-mos-sdk/blob/main/LICENSE for license
+ * information.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "mattbrew.h"
+
+#define NETBOOT_DEVICE 3
+
+#define NONE 0xFF
+
+// Longest prefix used; the name adds up to two digits.
+#define NAME_MAX 32
+
+static const char *prefix;
+static uint8_t first_bank;
+static uint8_t bank_count;
+
+// Per overlay: its cache bank, less first_bank, or NONE.
+static uint8_t slot_of[OVERLAY_COUNT];
+
+// Per cache bank: the overlay it holds (or NONE), and how many calls into
+// it are still running.
+static uint8_t held[BANK_COUNT];
+static uint8_t pins[BANK_COUNT];
+
+// Cache banks, less first_bank, most recently used first.
+static uint8_t order[BANK_COUNT];
+
+void overlay_init(const char *name, uint8_t first, uint8_t banks) {
+    prefix = name;
+    first_bank = first;
+    bank_count = banks > BANK_COUNT ? BANK_COUNT : banks;
+    memset(slot_of, NONE, sizeof(slot_of));
+    for (uint8_t i = 0; i < bank_count; i++) {
+        held[i] = NONE;
+        pins[i] = 0;
+        order[i] = i;
+    }
+}
+
+// Move |slot| to the front of the use order.
+static void touch(uint8_t slot) {
+    uint8_t i = 0;
+    while (order[i] != slot) i++;
+    for (; i > 0; i--) order[i] = order[i - 1];
+    order[0] = slot;
+}
+
+// The cache bank to fetch into: a free one, or the least recently used one
+// that isn't pinned. Returns NONE if every bank is pinned.
+static uint8_t victim(void) {
+    for (uint8_t i = 0; i < bank_count; i++) {
+        if (held[i] == NONE) return i;
+    }
+    for (uint8_t i = bank_count; i > 0; i--) {
+        uint8_t slot = order[i - 1];
+        if (!pins[slot]) return slot;
+    }
+    return NONE;
+}
+
+// Read netboot chunks until |len| bytes have arrived, storing them from
+// |dst| on, or over and over at |dst| if |keep| is false.
+static void receive(uint8_t *dst, uint16_t len, bool keep) {
+    while (len > 0) {
+        uint8_t n = io_read(NETBOOT_DEVICE, dst);
+        if (keep) dst += n;
+        len -= n;
+    }
+}
+
+// Fetch |overlay| into the window, whose bank is already mapped.
+static bool fetch(uint8_t overlay) {
+    char name[NAME_MAX + 2];
+    uint8_t len = strlen(prefix);
+    if (len > NAME_MAX) len = NAME_MAX;
+    memcpy(name, prefix, len);
+    if (overlay >= 10) name[len++] = '0' + overlay / 10;
+    name[len++] = '0' + overlay % 10;
+    io_write(NETBOOT_DEVICE, (const uint8_t *)name, len);
+
+    // The first chunk starts with the length; it goes to the window too, and
+    // the data after it is moved down.
+    uint8_t *window = (uint8_t *)BANK_WINDOW;
+    uint8_t n;
+    while ((n = io_read(NETBOOT_DEVICE, window)) == 0) {
+    }
+    uint16_t size = (uint16_t)window[0] << 8 | window[1];
+    if (size == 0) return false;
+    n -= 2;
+    if (size > BANK_WINDOW_SIZE) {
+        receive(window, size - n, false);
+        return false;
+    }
+    memmove(window, window + 2, n);
+    receive(window + n, size - n, true);
+    return true;
+}
+
+// Map |overlay|, fetching it if needed. Returns its cache bank, or NONE.
+static uint8_t map(uint8_t overlay) {
+    if (overlay >= OVERLAY_COUNT) return NONE;
+    uint8_t slot = slot_of[overlay];
+    if (slot == NONE) {
+        slot = victim();
+        if (slot == NONE) return NONE;
+        if (held[slot] != NONE) slot_of[held[slot]] = NONE;
+        held[slot] = NONE;
+        set_bank(first_bank + slot);
+        if (!fetch(overlay)) return NONE;
+        held[slot] = overlay;
+        slot_of[overlay] = slot;
+    } else {
+        set_bank(first_bank + slot);
+    }
+    touch(slot);
+    return slot;
+}
+
+bool overlay_load(uint8_t overlay) {
+    const uint8_t caller = get_bank();
+    const bool ok = map(overlay) != NONE;
+    set_bank(caller);
+    return ok;
+}
+
+bool overlay_call(uint8_t overlay, void (*fn)(void)) {
+    const uint8_t caller = get_bank();
+    const uint8_t slot = map(overlay);
+    if (slot == NONE) {
+        set_bank(caller);
+        return false;
+    }
+    pins[slot]++;
+    fn();
+    pins[slot]--;
+    set_bank(caller);
+    return true;
+}
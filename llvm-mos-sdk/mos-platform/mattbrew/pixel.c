@@ -0,0 +1,119 @@
+/*
+ * Bridge pixel mode: drawing on the Zero's framebuffer.
+ *
+ * Commands go out as device 2 pixel packets (see protocol.md), collected
+ * here until the next one doesn't fit, pix_present() or pix_flush(), so a
+ * frame's worth of small draws costs a few bridge writes rather than one
+ * each.
+ *
+ * Licensed under the Apache License, Version 2.0 with LLVM Exceptions,
+ * See https://github.com/llvm-mos/llvm-mos-sdk/blob/main/LICENSE for license
+ * information.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "mattbrew.h"
+
+// The 0x01 marker and as many commands as a device 2 write takes.
+#define PIX_PACKET_SIZE 255
+
+static uint8_t pix_buf[PIX_PACKET_SIZE];
+static uint8_t pix_len;
+
+void pix_flush(void) {
+  if (pix_len > 1)
+    io_write(TERM_DEVICE, pix_buf, pix_len);
+  pix_len = 0;
+}
+
+// Room for a |len| byte command in the packet, sending what the packet
+// holds first if it doesn't fit.
+static uint8_t *pix_cmd(uint8_t len) {
+  if (pix_len + len > PIX_PACKET_SIZE)
+    pix_flush();
+  if (!pix_len) {
+    pix_buf[0] = 0x01;
+    pix_len = 1;
+  }
+  uint8_t *cmd = pix_buf + pix_len;
+  pix_len += len;
+  return cmd;
+}
+
+static uint8_t *put16(uint8_t *p, uint16_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  return p + 2;
+}
+
+void pix_mode(bool on) {
+  uint8_t *p = pix_cmd(2);
+  p[0] = 'M';
+  p[1] = on;
+}
+
+void pix_palette(uint8_t first, uint8_t count, const uint8_t *rgb) {
+  uint8_t *p = pix_cmd(3 + 3 * count);
+  p[0] = 'P';
+  p[1] = first;
+  p[2] = count;
+  memcpy(p + 3, rgb, 3 * count);
+}
+
+void pix_tile(uint8_t tile, uint8_t bpp, const uint8_t *data) {
+  uint8_t *p = pix_cmd(3 + PIX_TILE * bpp);
+  p[0] = 'D';
+  p[1] = tile;
+  p[2] = bpp;
+  memcpy(p + 3, data, PIX_TILE * bpp);
+}
+
+void pix_tiles(uint8_t col, uint8_t row, uint8_t count, const uint8_t *tiles) {
+  uint8_t *p = pix_cmd(4 + count);
+  p[0] = 'T';
+  p[1] = col;
+  p[2] = row;
+  p[3] = count;
+  memcpy(p + 4, tiles, count);
+}
+
+void pix_row(uint16_t x, uint8_t y, uint16_t width, uint8_t bpp,
+             const uint8_t *data) {
+  uint8_t len = (width * bpp + 7) / 8;
+  uint8_t *p = pix_cmd(7 + len);
+  p[0] = 'B';
+  p = put16(p + 1, x);
+  *p++ = y;
+  p = put16(p, width);
+  *p++ = bpp;
+  memcpy(p, data, len);
+}
+
+void pix_fill(uint16_t x, uint8_t y, uint16_t w, uint8_t h, uint8_t color) {
+  uint8_t *p = pix_cmd(8);
+  p[0] = 'R';
+  p = put16(p + 1, x);
+  *p++ = y;
+  p = put16(p, w);
+  p[0] = h;
+  p[1] = color;
+}
+
+void pix_copy(uint16_t x, uint8_t y, uint16_t w, uint8_t h, uint16_t to_x,
+              uint8_t to_y) {
+  uint8_t *p = pix_cmd(10);
+  p[0] = 'C';
+  p = put16(p + 1, x);
+  *p++ = y;
+  p = put16(p, w);
+  *p++ = h;
+  p = put16(p, to_x);
+  p[0] = to_y;
+}
+
+void pix_present(void) {
+  *pix_cmd(1) = 'S';
+  pix_flush();
+}
@@ -0,0 +1,49 @@
+/*
+ * Cycle counter for 6502-profile.h: VIA T1, free-running.
+ *
+ * T1 counts down once per cycle and reloads from its latch; a latch of
+ * $FFFE makes the period exactly 65536 cycles, so the count's complement
+ * is the cycle count mod 2^16.  Its wraps are counted in software, each
+ * time a reading comes out below the last.
+ *
+ * Licensed under the Apache License, Version 2.0 with LLVM Exceptions,
+ * See https://github.com/llvm-mos/llvm-mos-sdk/blob/main/LICENSE for license
+ * information.
+ */
+
+#define MOS_PROFILE
+#include <6502-profile.h>
+
+#include "mattbrew.h"
+
+#define VIA_T1CL (*(volatile uint8_t *)(VIA_BASE + 0x04))
+#define VIA_T1CH (*(volatile uint8_t *)(VIA_BASE + 0x05))
+#define VIA_ACR  (*(volatile uint8_t *)(VIA_BASE + 0x0b))
+
+static uint16_t last, wraps;
+
+uint32_t __mos_profile_clock(void) {
+    // The low byte can borrow from the high between the two reads.
+    uint8_t hi, lo;
+    do {
+        hi = VIA_T1CH;
+        lo = VIA_T1CL;
+    } while (hi != VIA_T1CH);
+
+    const uint16_t now = ~(hi << 8 | lo);
+    if (now < last)
+        ++wraps;
+    last = now;
+    return (uint32_t)wraps << 16 | now;
+}
+
+// Runs after crt0's systick init, which sets T2's bits of the ACR.
+__attribute__((constructor)) static void start_clock(void) {
+    VIA_ACR = (VIA_ACR & 0x3f) | 0x40;  // T1 continuous, PB7 unused.
+    VIA_T1CL = 0xfe;
+    VIA_T1CH = 0xff;                    // Loads the counter and starts it.
+}
+
+// Print the ring at exit, while stdout is still open.
+asm(".section .fini.050,\"ax\",@progbits\n"
+    "jsr mos_profile_dump\n");
@@ -1,14 +1,39 @@
 /*
- * Route standard output to the LCD display.
+ * Route standard output to the bridge terminal (device 2).
+ *
+ * Output is line-buffered: each bridge write costs a full handshake, so
+ * characters collect until a newline, a full buffer, an input read or
+ * exit, and then go out as one device 2 write.
  *
  * Licensed under the Apache License, Version 2.0 with LLVM Exceptions,
  * See https://github.com/llvm-mos/llvm-mos-sdk/blob/main/LICENSE for license
  * information.
  */
 
+#include <stdint.h>
 #include <stdio.h>
 
-// Implemented in lcd.c.
-void lcd_putchar(unsigned char c);
+#include "mattbrew.h"
+
+// One or two terminal lines, as in the common stdio buffers.
+#define STDOUT_BUF_SIZE 80
+
+static uint8_t stdout_buf[STDOUT_BUF_SIZE];
+static uint8_t stdout_len;
+
+void term_flush(void) {
+  if (stdout_len) {
+    io_write(TERM_DEVICE, stdout_buf, stdout_len);
+    stdout_len = 0;
+  }
+}
+
+void __putchar(char c) {
+  stdout_buf[stdout_len++] = (uint8_t)c;
+  if (c == '\n' || stdout_len == STDOUT_BUF_SIZE)
+    term_flush();
+}
 
-void __putchar(char c) { lcd_putchar((unsigned char)c); }
+// Flush whatever is left once main() returns, after destructors.
+asm(".section .fini.250,\"ax\",@progbits\n"
+    "jsr term_flush\n");
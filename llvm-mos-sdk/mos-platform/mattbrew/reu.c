@@ -0,0 +1,61 @@
+/*
+ * Expansion RAM on the bridge: paged storage in the Pico's SRAM, driven by
+ * device 0 commands the Pico serves itself (see protocol.md).
+ *
+ * Licensed under the Apache License, Version 2.0 with LLVM Exceptions,
+ * See https://github.com/llvm-mos/llvm-mos-sdk/blob/main/LICENSE for license
+ * information.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "mattbrew.h"
+
+// ['S'] and as much data as a device write takes.
+#define REU_STASH_MAX 254
+
+static uint8_t reu_cmd[1 + REU_STASH_MAX];
+
+void reu_seek(uint32_t addr) {
+  reu_cmd[0] = 'A';
+  reu_cmd[1] = (uint8_t)addr;
+  reu_cmd[2] = (uint8_t)(addr >> 8);
+  reu_cmd[3] = (uint8_t)(addr >> 16);
+  io_write(0, reu_cmd, 4);
+}
+
+void reu_stash(const void *buf, uint16_t len) {
+  const uint8_t *p = buf;
+  reu_cmd[0] = 'S';
+  while (len) {
+    uint8_t n = len > REU_STASH_MAX ? REU_STASH_MAX : (uint8_t)len;
+    memcpy(reu_cmd + 1, p, n);
+    io_write(0, reu_cmd, 1 + n);
+    p += n;
+    len -= n;
+  }
+}
+
+void reu_fetch(void *buf, uint16_t len) {
+  uint8_t *p = buf;
+  while (len) {
+    uint8_t n = len > REU_FETCH_MAX ? REU_FETCH_MAX : (uint8_t)len;
+    const uint8_t cmd[2] = {'F', n};
+    io_write(0, cmd, sizeof(cmd));
+    n = io_read(0, p);
+    p += n;
+    len -= n;
+  }
+}
+
+uint32_t reu_crc32(uint32_t len) {
+  reu_cmd[0] = 'C';
+  reu_cmd[1] = (uint8_t)len;
+  reu_cmd[2] = (uint8_t)(len >> 8);
+  reu_cmd[3] = (uint8_t)(len >> 16);
+  io_write(0, reu_cmd, 4);
+  io_read(0, reu_cmd);
+  return reu_cmd[0] | (uint16_t)reu_cmd[1] << 8 |
+         (uint32_t)reu_cmd[2] << 16 | (uint32_t)reu_cmd[3] << 24;
+}
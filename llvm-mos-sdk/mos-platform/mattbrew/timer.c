@@ -0,0 +1,78 @@
+/*
+ * Timers run from the main loop by timer_run(), which sleeps in
+ * wait_until() between them.
+ *
+ * Licensed under the Apache License, Version 2.0 with LLVM Exceptions,
+ * See https://github.com/llvm-mos/llvm-mos-sdk/blob/main/LICENSE for license
+ * information.
+ */
+
+#include <mattbrew.h>
+
+struct timer {
+    unsigned long due;
+    unsigned period;
+    void (*fn)(void);           // 0 if the timer is free.
+};
+
+static struct timer timers[TIMERS_MAX];
+
+int8_t timer_start(unsigned ms, unsigned period, void (*fn)(void))
+{
+    for (int8_t id = 0; id < TIMERS_MAX; id++) {
+        struct timer *t = &timers[id];
+        if (!t->fn) {
+            t->due = millis() + ms;
+            t->period = period;
+            t->fn = fn;
+            return id;
+        }
+    }
+    return -1;
+}
+
+void timer_stop(int8_t id)
+{
+    if (id >= 0 && id < TIMERS_MAX)
+        timers[id].fn = 0;
+}
+
+// Run the timers that are due, and set |next| to when the next one is.
+static bool run_due(unsigned long *next)
+{
+    bool ran = false;
+    unsigned long now = millis();
+    *next = now + 0x7fffffff;
+    for (int8_t id = 0; id < TIMERS_MAX; id++) {
+        struct timer *t = &timers[id];
+        void (*fn)(void) = t->fn;
+        if (!fn)
+            continue;
+        if ((long)(now - t->due) >= 0) {
+            if (t->period) {
+                // A late timer skips the periods it missed.
+                t->due += t->period;
+                if ((long)(now - t->due) >= 0)
+                    t->due = now + t->period;
+            } else {
+                t->fn = 0;
+            }
+            fn();
+            ran = true;
+            now = millis();
+        }
+        if (t->fn && (long)(t->due - *next) < 0)
+            *next = t->due;
+    }
+    return ran;
+}
+
+uint8_t timer_run(uint8_t event_mask)
+{
+    unsigned long next;
+    if (run_due(&next))
+        return io_irq_pending() & event_mask;
+    uint8_t ready = wait_until(next, event_mask);
+    run_due(&next);
+    return ready;
+}
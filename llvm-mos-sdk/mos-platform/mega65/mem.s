@@ -0,0 +1,271 @@
+; Copyright 2023 LLVM-MOS Project
+; Licensed under the Apache License, Version 2.0 with LLVM Exceptions.
+; See https://github.com/llvm-mos/llvm-mos-sdk/blob/main/LICENSE for license
+; information.
+
+.include "imag.inc"
+
+; Block copy and fill through the DMAgic, replacing the weak CPU loops in
+; common/c/mem.s. Requests of DMA_MIN bytes or more run as one F018B job,
+; during which the CPU is halted; shorter ones aren't worth setting up the job
+; and stay on the CPU.
+;
+; DMA addresses are physical, so this sees bank 0 RAM wherever the CPU would
+; see I/O or ROM. That is fine for everything link.ld places in $2001-$CFFF.
+
+DMA_MIN = 32
+
+DMA_ADDR_MSB = $d701
+DMA_ADDR_BANK = $d702
+DMA_ENABLE_F018B = $d703
+DMA_TRIGGER_ENHANCED = $d705
+
+DMA_COPY_CMD = $00
+DMA_FILL_CMD = $03
+
+; The job: an enhanced option list, then an F018B list. Only the command,
+; count and addresses change between calls; the rest is fixed for bank 0.
+.section .data.__mega65_mem_dma_job,"aw",@progbits
+__mega65_mem_dma_job:
+  .byte $0b         ; F018B list format
+  .byte $80, $00    ; source address bits 20-27
+  .byte $81, $00    ; destination address bits 20-27
+  .byte $00         ; end of options
+.Ldma_command:
+  .byte DMA_COPY_CMD
+.Ldma_count:
+  .short 0
+.Ldma_source:
+  .short 0
+  .byte $00         ; source bank
+.Ldma_dest:
+  .short 0
+  .byte $00         ; destination bank
+  .byte $00         ; command MSB
+  .short 0          ; modulo
+
+; Runs the job with the command in A; returns once it's done.
+.section .text.__mega65_mem_dma,"ax",@progbits
+__mega65_mem_dma:
+  sta .Ldma_command
+  lda #1
+  sta DMA_ENABLE_F018B
+  lda #0
+  sta DMA_ADDR_BANK         ; Also clears the list address megabyte.
+  lda #>__mega65_mem_dma_job
+  sta DMA_ADDR_MSB
+  lda #<__mega65_mem_dma_job
+  sta DMA_TRIGGER_ENHANCED
+  rts
+
+; void *memcpy(void *restrict s1, const void *restrict s2, size_t n)
+;
+; Copies upwards, which memmove relies on; so does the DMAgic.
+.section .text.memcpy,"ax",@progbits
+.global memcpy
+memcpy:
+  cpx #0
+  bne .Lmemcpy_dma
+  cmp #DMA_MIN
+  bcs .Lmemcpy_dma
+
+  sta __rc6
+  ldy #0
+  beq .Lmemcpy_test
+.Lmemcpy_loop:
+  lda (__rc4),y
+  sta (__rc2),y
+  iny
+.Lmemcpy_test:
+  cpy __rc6
+  bne .Lmemcpy_loop
+  rts
+
+.Lmemcpy_dma:
+  sta .Ldma_count
+  stx .Ldma_count+1
+  lda __rc4
+  sta .Ldma_source
+  lda __rc5
+  sta .Ldma_source+1
+  lda __rc2
+  sta .Ldma_dest
+  lda __rc3
+  sta .Ldma_dest+1
+  lda #DMA_COPY_CMD
+  jmp __mega65_mem_dma
+
+; void *memmove(void *s1, const void *s2, size_t n)
+;
+; When s1 lies inside s2's block, the block is copied downwards in pieces no
+; longer than s1 - s2, so no piece overlaps itself and each lands before the
+; next one down is overwritten. Pieces shorter than DMA_MIN go byte by byte.
+.section .text.memmove,"ax",@progbits
+.global memmove
+memmove:
+  ; n in __rc6/7, s1 - s2 in __rc8/9.
+  sta __rc6
+  stx __rc7
+  sec
+  lda __rc2
+  sbc __rc4
+  sta __rc8
+  lda __rc3
+  sbc __rc5
+  sta __rc9
+  ; If s1 < s2, or s1 lies at or past the end of the block, copying upwards
+  ; is safe.
+  bcc .Lmemmove_up
+  lda __rc8
+  cmp __rc6
+  lda __rc9
+  sbc __rc7
+  bcs .Lmemmove_up
+
+  ; n < 65536, so a gap under DMA_MIN fits in __rc8.
+  lda __rc9
+  bne .Lmemmove_pieces
+  lda __rc8
+  cmp #DMA_MIN
+  bcc .Lmemmove_bytes
+
+  ; Take min(gap, left) off the end of what's left, and copy it up from
+  ; s2 + left to s1 + left.
+.Lmemmove_pieces:
+  lda __rc6
+  cmp __rc8
+  lda __rc7
+  sbc __rc9
+  bcc .Lmemmove_last
+  lda __rc8
+  sta .Ldma_count
+  lda __rc9
+  sta .Ldma_count+1
+  sec
+  lda __rc6
+  sbc __rc8
+  sta __rc6
+  lda __rc7
+  sbc __rc9
+  sta __rc7
+  jmp .Lmemmove_piece
+.Lmemmove_last:
+  lda __rc6
+  sta .Ldma_count
+  lda __rc7
+  sta .Ldma_count+1
+  lda #0
+  sta __rc6
+  sta __rc7
+.Lmemmove_piece:
+  clc
+  lda __rc4
+  adc __rc6
+  sta .Ldma_source
+  lda __rc5
+  adc __rc7
+  sta .Ldma_source+1
+  clc
+  lda __rc2
+  adc __rc6
+  sta .Ldma_dest
+  lda __rc3
+  adc __rc7
+  sta .Ldma_dest+1
+  lda #DMA_COPY_CMD
+  jsr __mega65_mem_dma
+  lda __rc6
+  ora __rc7
+  bne .Lmemmove_pieces
+  rts
+
+.Lmemmove_up:
+  lda __rc6
+  ldx __rc7
+  jmp memcpy
+
+  ; Copy downwards a byte at a time, with __rc4/5 and __rc8/9 pointing to
+  ; the start of the page being copied: first the partial page at the end,
+  ; then the whole pages, last first.
+.Lmemmove_bytes:
+  lda __rc2
+  sta __rc8
+  clc
+  lda __rc3
+  adc __rc7
+  sta __rc9
+  clc
+  lda __rc5
+  adc __rc7
+  sta __rc5
+  ldx __rc7
+
+  ldy __rc6
+  beq .Lmemmove_pages
+.Lmemmove_tail:
+  dey
+  lda (__rc4),y
+  sta (__rc8),y
+  cpy #0
+  bne .Lmemmove_tail
+
+.Lmemmove_pages:
+  ; Y is zero, so the first dey below wraps it to 255.
+  cpx #0
+  beq .Lmemmove_done
+.Lmemmove_page:
+  dec __rc5
+  dec __rc9
+.Lmemmove_page_loop:
+  dey
+  lda (__rc4),y
+  sta (__rc8),y
+  cpy #0
+  bne .Lmemmove_page_loop
+  dex
+  bne .Lmemmove_page
+.Lmemmove_done:
+  rts
+
+; void *memset(void *ptr, int value, size_t num)
+;
+; Shuffles its arguments into __memset's and falls through to it; __memset
+; leaves ptr in __rc2/3 to return.
+.section .text.memset,"ax",@progbits
+.global memset
+memset:
+  ldx __rc4
+  ldy __rc5
+  sty __rc4
+  ; Fall through.
+
+; void __memset(char *ptr, char value, size_t num)
+.global __memset
+__memset:
+  ldy __rc4
+  bne .Lmemset_dma
+  cpx #DMA_MIN
+  bcs .Lmemset_dma
+
+  ; Order doesn't matter, so fill downwards and let dey set the flags.
+  stx __rc6
+  ldy __rc6
+  beq .Lmemset_done
+.Lmemset_loop:
+  dey
+  sta (__rc2),y
+  bne .Lmemset_loop
+.Lmemset_done:
+  rts
+
+  ; The fill value goes in the low byte of the source address.
+.Lmemset_dma:
+  sta .Ldma_source
+  stx .Ldma_count
+  sty .Ldma_count+1
+  lda __rc2
+  sta .Ldma_dest
+  lda __rc3
+  sta .Ldma_dest+1
+  lda #DMA_FILL_CMD
+  jmp __mega65_mem_dma
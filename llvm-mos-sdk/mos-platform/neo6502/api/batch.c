@@ -0,0 +1,146 @@
+// Copyright 2024 LLVM-MOS Project
+// Licensed under the Apache License, Version 2.0 with LLVM Exceptions.
+// See https://github.com/llvm-mos/llvm-mos-sdk/blob/main/LICENSE for license
+// information.
+
+#include <string.h>
+#include "../neo6502.h"
+#include "../kernel.h"
+#include "neo/batch.h"
+#include "neo/graphics.h"
+
+void neo_batch_init(neo_batch_t *batch, void *buffer, uint16_t size) {
+    batch->buffer = buffer;
+    batch->size = size;
+    batch->length = 0;
+    batch->text = size;
+}
+
+void neo_batch_submit(neo_batch_t *batch) {
+    const uint8_t *p = batch->buffer;
+    const uint8_t *end = p + batch->length;
+    while (p != end) {
+        uint8_t group = p[0];
+        uint8_t function = p[1];
+        uint8_t length = p[2];
+        p += 3;
+        // The mailbox holds one command at a time, so wait out the last
+        // before filling in the next.
+        KWaitMessage();
+        for (uint8_t i = 0; i < length; i++)
+            ControlPort.params[i] = p[i];
+        p += length;
+        ControlPort.function = function;
+        ControlPort.command = group;
+    }
+    KWaitMessage();
+    batch->length = 0;
+    batch->text = batch->size;
+}
+
+// Queue a command header, submitting first if the command and text_length
+// bytes of string don't fit. Returns where its parameters go, or NULL if it
+// can't fit even in an empty batch.
+static uint8_t *neo_batch_reserve(neo_batch_t *batch, uint8_t group, uint8_t function, uint8_t length, uint16_t text_length) {
+    uint16_t needed = 3 + length + text_length;
+    if (batch->text - batch->length < needed) {
+        neo_batch_submit(batch);
+        if (batch->size < needed)
+            return NULL;
+    }
+    uint8_t *p = batch->buffer + batch->length;
+    p[0] = group;
+    p[1] = function;
+    p[2] = length;
+    batch->length += 3 + length;
+    return p + 3;
+}
+
+static uint8_t *neo_batch_put16(uint8_t *p, uint16_t value) {
+    p[0] = value;
+    p[1] = value >> 8;
+    return p + 2;
+}
+
+void neo_batch_add(neo_batch_t *batch, uint8_t group, uint8_t function, const void *params, uint8_t length) {
+    uint8_t *p = neo_batch_reserve(batch, group, function, length, 0);
+    if (p)
+        memcpy(p, params, length);
+}
+
+static void neo_batch_draw_box(neo_batch_t *batch, uint8_t function, uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2) {
+    uint8_t *p = neo_batch_reserve(batch, API_GROUP_GRAPHICS, function, 8, 0);
+    if (!p)
+        return;
+    p = neo_batch_put16(p, x1);
+    p = neo_batch_put16(p, y1);
+    p = neo_batch_put16(p, x2);
+    neo_batch_put16(p, y2);
+}
+
+void neo_batch_draw_line(neo_batch_t *batch, uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2) {
+    neo_batch_draw_box(batch, API_FN_DRAW_LINE, x1, y1, x2, y2);
+}
+
+void neo_batch_draw_rectangle(neo_batch_t *batch, uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2) {
+    neo_batch_draw_box(batch, API_FN_DRAW_RECT, x1, y1, x2, y2);
+}
+
+void neo_batch_draw_ellipse(neo_batch_t *batch, uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2) {
+    neo_batch_draw_box(batch, API_FN_DRAW_ELLIPSE, x1, y1, x2, y2);
+}
+
+void neo_batch_draw_pixel(neo_batch_t *batch, uint16_t x, uint16_t y) {
+    uint8_t *p = neo_batch_reserve(batch, API_GROUP_GRAPHICS, API_FN_DRAW_PIXEL, 4, 0);
+    if (!p)
+        return;
+    p = neo_batch_put16(p, x);
+    neo_batch_put16(p, y);
+}
+
+void neo_batch_draw_text(neo_batch_t *batch, uint16_t x, uint16_t y, const char *text) {
+    uint8_t text_len = strlen(text);
+    uint8_t *p = neo_batch_reserve(batch, API_GROUP_GRAPHICS, API_FN_DRAW_TEXT, 6, text_len + 1);
+    if (!p) {
+        // Too long for the buffer at all; it's been emptied, so order holds.
+        neo_graphics_draw_text(x, y, text);
+        return;
+    }
+    batch->text -= text_len + 1;
+    uint8_t *text_p = batch->buffer + batch->text;
+    text_p[0] = text_len;
+    memcpy(text_p + 1, text, text_len);
+    p = neo_batch_put16(p, x);
+    p = neo_batch_put16(p, y);
+    neo_batch_put16(p, (uint16_t) text_p);
+}
+
+void neo_batch_draw_image(neo_batch_t *batch, uint16_t x, uint16_t y, uint8_t id) {
+    uint8_t *p = neo_batch_reserve(batch, API_GROUP_GRAPHICS, API_FN_DRAW_IMG, 5, 0);
+    if (!p)
+        return;
+    p = neo_batch_put16(p, x);
+    p = neo_batch_put16(p, y);
+    p[0] = id;
+}
+
+void neo_batch_sprite_set(neo_batch_t *batch, uint8_t id, uint16_t x, uint16_t y, uint8_t img, uint8_t flip, uint8_t anchor) {
+    uint8_t *p = neo_batch_reserve(batch, API_GROUP_SPRITES, API_FN_SPRITE_SET, 8, 0);
+    if (!p)
+        return;
+    p[0] = id;
+    p = neo_batch_put16(p + 1, x);
+    p = neo_batch_put16(p, y);
+    p[0] = img;
+    p[1] = flip;
+    p[2] = anchor;
+}
+
+void neo_batch_sprite_hide(neo_batch_t *batch, uint8_t id) {
+    neo_batch_add(batch, API_GROUP_SPRITES, API_FN_SPRITE_HIDE, &id, 1);
+}
+
+void neo_batch_sound_play_effect(neo_batch_t *batch, uint8_t channel, uint8_t id) {
+    uint8_t params[2] = {channel, id};
+    neo_batch_add(batch, API_GROUP_SOUND, API_FN_PLAY_SOUND, params, 2);
+}
@@ -21,5 +21,6 @@
 #include "sound.h"
 #include "turtle.h"
 #include "uext.h"
+#include "batch.h"
 
 #endif
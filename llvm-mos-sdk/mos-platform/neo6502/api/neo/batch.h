@@ -0,0 +1,111 @@
+// Copyright 2024 LLVM-MOS Project
+// Licensed under the Apache License, Version 2.0 with LLVM Exceptions.
+// See https://github.com/llvm-mos/llvm-mos-sdk/blob/main/LICENSE for license
+// information.
+
+#include <stdint.h>
+
+#ifndef _NEO_BATCH_H
+#define _NEO_BATCH_H
+
+#include <neo6502.h>
+#include "types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief A queue of API commands, built up in a caller-supplied buffer and
+ * sent to the coprocessor together by neo_batch_submit().
+ *
+ * Each command takes 3 bytes plus its parameters, queued from the start of
+ * the buffer. Text commands also keep their string, as a Pascal string
+ * queued from the end, so it need not outlive the call that queued it. A
+ * command that doesn't fit submits the batch queued so far first.
+ */
+typedef struct neo_batch {
+    uint8_t *buffer;
+    uint16_t size;
+    uint16_t length; //!< End of the commands
+    uint16_t text;   //!< Start of the strings
+} neo_batch_t;
+
+/**
+ * @brief Start an empty batch.
+ *
+ * @param batch Batch
+ * @param buffer Command buffer
+ * @param size Command buffer size, in bytes
+ */
+void neo_batch_init(neo_batch_t *batch, void *buffer, uint16_t size);
+
+/**
+ * @brief Send every queued command, wait for the last to finish, and empty
+ * the batch.
+ *
+ * @param batch Batch
+ */
+void neo_batch_submit(neo_batch_t *batch);
+
+/**
+ * @brief Queue any API command that returns nothing.
+ *
+ * @param batch Batch
+ * @param group Command group
+ * @param function Command function
+ * @param params Parameters, copied into the batch
+ * @param length Parameter length, up to 8 bytes
+ */
+void neo_batch_add(neo_batch_t *batch, uint8_t group, uint8_t function, const void *params, uint8_t length);
+
+/**
+ * @brief Queue neo_graphics_draw_line().
+ */
+void neo_batch_draw_line(neo_batch_t *batch, uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2);
+
+/**
+ * @brief Queue neo_graphics_draw_rectangle().
+ */
+void neo_batch_draw_rectangle(neo_batch_t *batch, uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2);
+
+/**
+ * @brief Queue neo_graphics_draw_ellipse().
+ */
+void neo_batch_draw_ellipse(neo_batch_t *batch, uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2);
+
+/**
+ * @brief Queue neo_graphics_draw_pixel().
+ */
+void neo_batch_draw_pixel(neo_batch_t *batch, uint16_t x, uint16_t y);
+
+/**
+ * @brief Queue neo_graphics_draw_text(). The text is copied into the batch.
+ */
+void neo_batch_draw_text(neo_batch_t *batch, uint16_t x, uint16_t y, const char *text);
+
+/**
+ * @brief Queue neo_graphics_draw_image().
+ */
+void neo_batch_draw_image(neo_batch_t *batch, uint16_t x, uint16_t y, uint8_t id);
+
+/**
+ * @brief Queue neo_sprite_set().
+ */
+void neo_batch_sprite_set(neo_batch_t *batch, uint8_t id, uint16_t x, uint16_t y, uint8_t img, uint8_t flip, uint8_t anchor);
+
+/**
+ * @brief Queue neo_sprite_hide().
+ */
+void neo_batch_sprite_hide(neo_batch_t *batch, uint8_t id);
+
+/**
+ * @brief Queue neo_sound_play_effect().
+ */
+void neo_batch_sound_play_effect(neo_batch_t *batch, uint8_t channel, uint8_t id);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
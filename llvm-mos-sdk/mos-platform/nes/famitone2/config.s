@@ -12,6 +12,12 @@ FT_THREAD = 1			;undefine if you are calling sound effects from the same thread
 FT_PAL_SUPPORT = 1		;undefine to exclude PAL support
 FT_NTSC_SUPPORT = 1		;undefine to exclude NTSC support
 
+FT_SPLIT_UPDATE = 0		;set to 1 to parse channels 3-5 of each row a frame after channels 1-2,
+						;roughly halving the cost of the frames that start a row; triangle,
+						;noise and DPCM then lag the pulse channels by a frame
+FT_PROFILE = 0			;set to 1 to time each update with __famitone_profile_clock and keep
+						;the last and worst in famitone_last_cycles and famitone_worst_cycles
+
 
 ;internal defines
 
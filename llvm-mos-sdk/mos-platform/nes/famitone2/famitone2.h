@@ -33,6 +33,12 @@ __attribute__((leaf)) void sfx_play(char sound, char channel);
 // play a DPCM sample, 1..63
 __attribute__((leaf)) void sample_play(char sample);
 
+// With FT_PROFILE set in config.s, the CPU cycles taken by the last music and
+// sound update, and by the slowest since startup, as timed by the weak asm hook
+// __famitone_profile_clock. Clear famitone_worst_cycles to start over.
+extern volatile unsigned famitone_last_cycles;
+extern volatile unsigned famitone_worst_cycles;
+
 #ifdef __cplusplus
 }
 #endif
@@ -131,6 +131,14 @@ FT_DPCM_LIST_H:
 	.fill 1
 FT_DPCM_EFFECT:
 	.fill 1
+	.if(FT_SPLIT_UPDATE)
+FT_ROW_PENDING:				;channels 3-5 of the last row are still to be parsed
+	.fill 1
+	.endif
+	.if(FT_PROFILE)
+FT_PROFILE_START:
+	.fill 2
+	.endif
 FT_OUT_BUF:
 	.fill 11
 
@@ -249,6 +257,27 @@ __pop_sounds_bank:
 __unbank_sounds:
 	rts
 
+.if(FT_PROFILE)
+;cycle counter for FT_PROFILE: returns a count that rises by one per CPU cycle,
+;LSB in A and MSB in X, changing no other registers or zero page; the NES has
+;none, so this default always returns 0, and those of emulators or debug
+;hardware can be supplied in its place
+.section .text.ft_profile_clock,"ax",@progbits
+.weak __famitone_profile_clock
+__famitone_profile_clock:
+	lda #0
+	tax
+	rts
+
+.section .bss.ft_profile,"aw",@nobits
+.globl famitone_last_cycles
+famitone_last_cycles:
+	.fill 2
+.globl famitone_worst_cycles
+famitone_worst_cycles:
+	.fill 2
+.endif
+
 .section .text.famitone_init,"ax",@progbits
 .globl FamiToneInit
 FamiToneInit:
@@ -337,6 +366,9 @@ music_stop:
 	lda #0
 	sta FT_SONG_SPEED		;stop music, reset pause flag
 	sta FT_DPCM_EFFECT		;no DPCM effect playing
+	.if(FT_SPLIT_UPDATE)
+	sta FT_ROW_PENDING		;drop the rest of the old song's row
+	.endif
 
 	ldx #0	;initialize channel structures
 
@@ -513,6 +545,12 @@ music_pause:
 __FamiToneUpdate:
 FamiToneUpdate:
 
+	.if(FT_PROFILE)
+	jsr __famitone_profile_clock
+	sta FT_PROFILE_START
+	stx FT_PROFILE_START+1
+	.endif
+
 	.if(FT_THREAD)
 	lda FT_TEMP_PTR_L
 	pha
@@ -529,6 +567,15 @@ FamiToneUpdate:
 .Lupdate:
 	jsr __push_music_bank
 
+	.if(FT_SPLIT_UPDATE)
+	lda FT_ROW_PENDING		;finish the row the last frame started first
+	beq .Lno_row_pending
+	lda #0
+	sta FT_ROW_PENDING
+	jsr _FT2RowUpdateLate
+.Lno_row_pending:
+	.endif
+
 	clc						;update frame counter that considers speed, tempo, and PAL/NTSC
 	lda FT_TEMPO_ACC_L
 	adc FT_TEMPO_STEP_L
@@ -565,6 +612,15 @@ FamiToneUpdate:
 	sta FT_CH2_DUTY
 .Lno_new_note2:
 
+	.if(FT_SPLIT_UPDATE)
+	inc FT_ROW_PENDING		;leave channels 3-5 to the next frame
+	jmp .Lupdate_envelopes
+
+;internal routine, the part of a row update that split updates defer
+
+_FT2RowUpdateLate:
+	.endif
+
 	ldx #mos16lo(FT_CH3_VARS)	;process channel 3
 	jsr _FT2ChannelUpdate
 	bcc .Lno_new_note3
@@ -598,59 +654,42 @@ FamiToneUpdate:
 	.endif
 
 
-.Lupdate_envelopes:
-
-	ldx #0	;process 11 envelopes
-
-.Lenv_process:
-
-	lda FT_ENV_REPEAT,x		;check envelope repeat counter
-	beq .Lenv_read			;if it is zero, process envelope
-	dec FT_ENV_REPEAT,x		;otherwise decrement the counter
-	bne .Lenv_next
-
-.Lenv_read:
-
-	lda FT_ENV_ADR_L,x		;load envelope data address into temp
-	sta <FT_TEMP_PTR_L
-	lda FT_ENV_ADR_H,x
-	sta <FT_TEMP_PTR_H
-	ldy FT_ENV_PTR,x		;load envelope pointer
-
-.Lenv_read_value:
-
-	lda (FT_TEMP_PTR),y		;read a byte of the envelope data
-	bpl .Lenv_special		;values below 128 used as a special code, loop or repeat
-	clc						;values above 128 are output value+192 (output values are signed -63..64)
-	adc #256-192
-	sta FT_ENV_VALUE,x		;store the output value
-	iny						;advance the pointer
-	bne .Lenv_next_store_ptr ;bra
-
-.Lenv_special:
-
-	bne .Lenv_set_repeat		;zero is the loop point, non-zero values used for the repeat counter
-	iny						;advance the pointer
-	lda (FT_TEMP_PTR),y		;read loop position
-	tay						;use loop position
-	jmp .Lenv_read_value		;read next byte of the envelope
+	.if(FT_SPLIT_UPDATE)
+	rts
+	.endif
 
-.Lenv_set_repeat:
 
-	iny
-	sta FT_ENV_REPEAT,x		;store the repeat counter value
+.Lupdate_envelopes:
 
-.Lenv_next_store_ptr:
+	;channels with no note playing skip their envelopes: the next note restarts
+	;them anyway, and a cut channel's output doesn't depend on them
 
-	tya						;store the envelope pointer
-	sta FT_ENV_PTR,x
+	lda FT_CH1_NOTE
+	beq .Lenv_skip1
+	ldx #FT_CH1_ENVS
+	ldy #FT_CH2_ENVS
+	jsr _FT2EnvelopeUpdate
+.Lenv_skip1:
 
-.Lenv_next:
+	lda FT_CH2_NOTE
+	beq .Lenv_skip2
+	ldx #FT_CH2_ENVS
+	ldy #FT_CH3_ENVS
+	jsr _FT2EnvelopeUpdate
+.Lenv_skip2:
 
-	inx						;next envelope
+	lda FT_CH3_NOTE
+	beq .Lenv_skip3
+	ldx #FT_CH3_ENVS
+	ldy #FT_CH4_ENVS
+	jsr _FT2EnvelopeUpdate
+.Lenv_skip3:
 
-	cpx #FT_ENVELOPES_ALL
-	bne .Lenv_process
+	lda FT_CH4_NOTE
+	beq .Lupdate_sound
+	ldx #FT_CH4_ENVS
+	ldy #FT_ENVELOPES_ALL
+	jsr _FT2EnvelopeUpdate
 
 
 .Lupdate_sound:
@@ -768,27 +807,56 @@ FamiToneUpdate:
 
 	.if(FT_SFX_ENABLE)
 
-	;process all sound effect streams
-	jsr __push_sounds_bank
+	;process all sound effect streams, skipping the idle ones, and the bank
+	;switch as well if they all are; a stream's pointer MSB is zero when idle
+
+	lda FT_SFX_PTR_H+FT_SFX_CH0
+	.if FT_SFX_STREAMS>1
+	ora FT_SFX_PTR_H+FT_SFX_CH1
+	.endif
+	.if FT_SFX_STREAMS>2
+	ora FT_SFX_PTR_H+FT_SFX_CH2
+	.endif
+	.if FT_SFX_STREAMS>3
+	ora FT_SFX_PTR_H+FT_SFX_CH3
+	.endif
+	beq .Lsfx_idle
 
+	jsr __push_sounds_bank
 
 	.if FT_SFX_STREAMS>0
 	ldx #FT_SFX_CH0
+	lda FT_SFX_PTR_H,x
+	beq .Lsfx_idle0
 	jsr _FT2SfxUpdate
+.Lsfx_idle0:
 	.endif
 	.if FT_SFX_STREAMS>1
 	ldx #FT_SFX_CH1
+	lda FT_SFX_PTR_H,x
+	beq .Lsfx_idle1
 	jsr _FT2SfxUpdate
+.Lsfx_idle1:
 	.endif
 	.if FT_SFX_STREAMS>2
 	ldx #FT_SFX_CH2
+	lda FT_SFX_PTR_H,x
+	beq .Lsfx_idle2
 	jsr _FT2SfxUpdate
+.Lsfx_idle2:
 	.endif
 	.if FT_SFX_STREAMS>3
 	ldx #FT_SFX_CH3
+	lda FT_SFX_PTR_H,x
+	beq .Lsfx_idle3
 	jsr _FT2SfxUpdate
+.Lsfx_idle3:
 	.endif
 
+	jsr __pop_sounds_bank
+
+.Lsfx_idle:
+
 	;send data from the output buffer to the APU
 
 	lda FT_OUT_BUF		;pulse 1 volume
@@ -825,8 +893,6 @@ FamiToneUpdate:
 	lda FT_OUT_BUF+10	;noise period
 	sta APU_NOISE_LO
 
-	jsr __pop_sounds_bank
-
 	.endif
 
 	jsr __pop_music_bank
@@ -838,6 +904,87 @@ FamiToneUpdate:
 	sta FT_TEMP_PTR_L
 	.endif
 
+	.if(FT_PROFILE)
+	jsr __famitone_profile_clock
+	sec						;cycles taken = end - start
+	sbc FT_PROFILE_START
+	sta famitone_last_cycles
+	txa
+	sbc FT_PROFILE_START+1
+	sta famitone_last_cycles+1
+	cmp famitone_worst_cycles+1	;keep the worst
+	bcc .Lnot_worst
+	bne .Lworst
+	lda famitone_last_cycles
+	cmp famitone_worst_cycles
+	bcc .Lnot_worst
+.Lworst:
+	lda famitone_last_cycles
+	sta famitone_worst_cycles
+	lda famitone_last_cycles+1
+	sta famitone_worst_cycles+1
+.Lnot_worst:
+	.endif
+
+	rts
+
+;internal routine, advances the envelopes of one channel
+;in X first envelope, Y envelope after the last
+
+.section .text.famitone_envelope_update,"ax",@progbits
+_FT2EnvelopeUpdate:
+
+	sty <FT_TEMP_VAR1
+
+.Lenv_process:
+
+	lda FT_ENV_REPEAT,x		;check envelope repeat counter
+	beq .Lenv_read			;if it is zero, process envelope
+	dec FT_ENV_REPEAT,x		;otherwise decrement the counter
+	bne .Lenv_next
+
+.Lenv_read:
+
+	lda FT_ENV_ADR_L,x		;load envelope data address into temp
+	sta <FT_TEMP_PTR_L
+	lda FT_ENV_ADR_H,x
+	sta <FT_TEMP_PTR_H
+	ldy FT_ENV_PTR,x		;load envelope pointer
+
+.Lenv_read_value:
+
+	lda (FT_TEMP_PTR),y		;read a byte of the envelope data
+	bpl .Lenv_special		;values below 128 used as a special code, loop or repeat
+	clc						;values above 128 are output value+192 (output values are signed -63..64)
+	adc #256-192
+	sta FT_ENV_VALUE,x		;store the output value
+	iny						;advance the pointer
+	bne .Lenv_next_store_ptr ;bra
+
+.Lenv_special:
+
+	bne .Lenv_set_repeat		;zero is the loop point, non-zero values used for the repeat counter
+	iny						;advance the pointer
+	lda (FT_TEMP_PTR),y		;read loop position
+	tay						;use loop position
+	jmp .Lenv_read_value		;read next byte of the envelope
+
+.Lenv_set_repeat:
+
+	iny
+	sta FT_ENV_REPEAT,x		;store the repeat counter value
+
+.Lenv_next_store_ptr:
+
+	tya						;store the envelope pointer
+	sta FT_ENV_PTR,x
+
+.Lenv_next:
+
+	inx						;next envelope
+
+	cpx <FT_TEMP_VAR1
+	bne .Lenv_process
 	rts
 
 ;internal routine, sets up envelopes of a channel according to current instrument
@@ -30,6 +30,28 @@ __attribute__((leaf)) void multi_vram_buffer_horz(const void *data, char len,
 __attribute__((leaf)) void multi_vram_buffer_vert(const void *data, char len,
                                                   int ppu_address);
 
+// The stripe buffer is a second, larger queue for whole rows and columns, up
+// to 255 bytes of stripes a frame, each 1-255 bytes long. It needs no set up:
+// the NMI after every ppu_wait_nmi writes whatever is queued with unrolled
+// copies, then empties it. It can be used together with the vram_buffer.
+
+// to push a horizontal run of data to the stripe buffer
+__attribute__((leaf)) void vram_stripe_horz(const void *data, char len,
+                                            int ppu_address);
+
+// to push a vertical run of data to the stripe buffer
+__attribute__((leaf)) void vram_stripe_vert(const void *data, char len,
+                                            int ppu_address);
+
+// to push len copies of one value, horizontally, to the stripe buffer
+// takes 4 bytes of the stripe buffer, however long the run
+__attribute__((leaf)) void vram_stripe_fill_horz(char value, char len,
+                                                 int ppu_address);
+
+// to push len copies of one value, vertically, to the stripe buffer
+__attribute__((leaf)) void vram_stripe_fill_vert(char value, char len,
+                                                 int ppu_address);
+
 // pad 0 or 1, use AFTER pad_poll() to get the trigger / new button presses
 // more efficient than pad_trigger, which runs the entire pad_poll code again
 char get_pad_new(char pad);
@@ -0,0 +1,12 @@
+// Copyright 2023 LLVM-MOS Project
+// Licensed under the Apache License, Version 2.0 with LLVM Exceptions.
+// See https://github.com/llvm-mos/llvm-mos-sdk/blob/main/LICENSE for license
+// information.
+
+// Bytes of stripes queued for the next NMI; the NMI drains them and resets it.
+__attribute__((section(".zp.vram_stripe_index"))) volatile char
+    VRAM_STRIPE_INDEX;
+
+// NMI scratch: the unrolled copy's entry point, and the length left.
+__attribute__((section(".zp.vram_stripe_jmp"))) void *VRAM_STRIPE_JMP;
+__attribute__((section(".zp.vram_stripe_len"))) char VRAM_STRIPE_LEN;
@@ -0,0 +1,243 @@
+; Copyright 2023 LLVM-MOS Project
+; Licensed under the Apache License, Version 2.0 with LLVM Exceptions.
+; See https://github.com/llvm-mos/llvm-mos-sdk/blob/main/LICENSE for license
+; information.
+
+; Stripe buffer: whole rows and columns of VRAM queued for the next NMI.
+;
+; Each stripe is
+;   header  bit 7 run, bit 6 vertical, bits 5-0 PPU address high
+;   address PPU address low
+;   length  1-255
+; followed by length data bytes, or for a run one byte written length times.
+; There is no terminator; the NMI copies up to VRAM_STRIPE_INDEX.
+
+.zeropage VRAM_STRIPE_INDEX, VRAM_STRIPE_JMP, VRAM_STRIPE_LEN
+
+.include "nes.inc"
+.include "neslib.inc"
+
+.section .aligned.vram_stripe_buf,"aw",@nobits
+.weak VRAM_STRIPE_BUF
+.balign 256
+VRAM_STRIPE_BUF:
+	.zero 256
+
+
+.section .nmi.070,"ax",@progbits
+.globl vram_stripe_nmi
+vram_stripe_nmi:
+	lda VRAM_STRIPE_INDEX
+	beq .LskipStripes
+	jsr flush_vram_stripes
+.LskipStripes:
+
+
+.section .text.flush_vram_stripes,"axR",@progbits
+flush_vram_stripes:
+	ldx #0
+
+.Lstripe:
+	lda VRAM_STRIPE_BUF,x ; header
+	inx
+	sta VRAM_STRIPE_LEN   ; kept for bit until the length replaces it
+	and #$3f
+	tay
+
+	lda PPUCTRL_VAR
+	and #$fb              ; horizontal
+	bit VRAM_STRIPE_LEN
+	bvc .LstripeHorz
+	ora #$04              ; vertical
+.LstripeHorz:
+	sta PPUCTRL
+
+	sty PPUADDR
+	lda VRAM_STRIPE_BUF,x ; address lo
+	inx
+	sta PPUADDR
+
+	bit VRAM_STRIPE_LEN
+	bmi .LstripeRun
+
+	lda VRAM_STRIPE_BUF,x ; length
+	inx
+	sta VRAM_STRIPE_LEN
+
+	; Whole unrolled blocks first, then enter the last one part way in.
+.LcopyBlocks:
+	lda VRAM_STRIPE_LEN
+	cmp #32
+	bcc .LcopyTail
+	sbc #32
+	sta VRAM_STRIPE_LEN
+	jsr .LcopyAll
+	jmp .LcopyBlocks
+
+.LcopyTail:
+	cmp #0
+	beq .LstripeNext
+	; 7 bytes per byte copied
+	asl a
+	asl a
+	asl a
+	sec
+	sbc VRAM_STRIPE_LEN
+	sta VRAM_STRIPE_LEN
+	lda #<.LcopyEnd
+	sec
+	sbc VRAM_STRIPE_LEN
+	sta VRAM_STRIPE_JMP
+	lda #>.LcopyEnd
+	sbc #0
+	sta VRAM_STRIPE_JMP+1
+	jsr .LstripeJmp
+	jmp .LstripeNext
+
+.LstripeRun:
+	lda VRAM_STRIPE_BUF,x   ; length
+	sta VRAM_STRIPE_LEN
+	ldy VRAM_STRIPE_BUF+1,x ; value
+	inx
+	inx
+
+.LrunBlocks:
+	lda VRAM_STRIPE_LEN
+	cmp #32
+	bcc .LrunTail
+	sbc #32
+	sta VRAM_STRIPE_LEN
+	tya
+	jsr .LrunAll
+	jmp .LrunBlocks
+
+.LrunTail:
+	cmp #0
+	beq .LstripeNext
+	; 3 bytes per byte written
+	asl a
+	adc VRAM_STRIPE_LEN
+	sta VRAM_STRIPE_LEN
+	lda #<.LrunEnd
+	sec
+	sbc VRAM_STRIPE_LEN
+	sta VRAM_STRIPE_JMP
+	lda #>.LrunEnd
+	sbc #0
+	sta VRAM_STRIPE_JMP+1
+	tya
+	jsr .LstripeJmp
+
+.LstripeNext:
+	cpx VRAM_STRIPE_INDEX
+	beq .LstripesDone
+	jmp .Lstripe
+
+.LstripesDone:
+	lda #0
+	sta VRAM_STRIPE_INDEX
+	lda PPUCTRL_VAR
+	sta PPUCTRL
+	rts
+
+.LstripeJmp:
+	jmp (VRAM_STRIPE_JMP)
+
+.LcopyAll:
+.rept 32
+	lda VRAM_STRIPE_BUF,x
+	sta PPUDATA
+	inx
+.endr
+.LcopyEnd:
+	rts
+
+.LrunAll:
+.rept 32
+	sta PPUDATA
+.endr
+.LrunEnd:
+	rts
+
+
+; Horizontal and vertical share common code and need to stay in the same section
+.section .text.vram_stripe,"ax",@progbits
+
+;void vram_stripe_horz(const void *data, char len, int ppu_address);
+.globl vram_stripe_horz
+vram_stripe_horz:
+	;     A - len
+	;     X - <ppu_address
+	; __rc2 - <data
+	; __rc3 - >data
+	; __rc4 - >ppu_address
+	sta __rc5 ; save len for loop comparison
+	lda #$00  ; load horizontal flag
+
+vram_stripe_common:
+	ora __rc4
+	ldy VRAM_STRIPE_INDEX
+	sta VRAM_STRIPE_BUF+0,y ; header
+	txa
+	sta VRAM_STRIPE_BUF+1,y ; address lo
+	lda __rc5
+	sta VRAM_STRIPE_BUF+2,y ; length
+
+	tya
+	clc
+	adc #3
+	tax
+
+	ldy #0
+.Lvram_stripe_loop:
+	lda (__rc2),y
+	sta VRAM_STRIPE_BUF,x
+	inx
+	iny
+	cpy __rc5
+	bne .Lvram_stripe_loop
+	stx VRAM_STRIPE_INDEX
+	rts
+
+;void vram_stripe_vert(const void *data, char len, int ppu_address);
+.globl vram_stripe_vert
+vram_stripe_vert:
+	sta __rc5 ; save len for loop comparison
+	lda #$40  ; load vertical flag
+	bne vram_stripe_common ; always taken
+
+
+.section .text.vram_stripe_fill,"ax",@progbits
+
+;void vram_stripe_fill_horz(char value, char len, int ppu_address);
+.globl vram_stripe_fill_horz
+vram_stripe_fill_horz:
+	;     A - value
+	;     X - len
+	; __rc2 - <ppu_address
+	; __rc3 - >ppu_address
+	ldy #$80  ; load run flag
+
+vram_stripe_fill_common:
+	sty __rc4
+	ldy VRAM_STRIPE_INDEX
+	sta VRAM_STRIPE_BUF+3,y ; value
+	txa
+	sta VRAM_STRIPE_BUF+2,y ; length
+	lda __rc3
+	ora __rc4
+	sta VRAM_STRIPE_BUF+0,y ; header
+	lda __rc2
+	sta VRAM_STRIPE_BUF+1,y ; address lo
+
+	tya
+	clc
+	adc #4
+	sta VRAM_STRIPE_INDEX
+	rts
+
+;void vram_stripe_fill_vert(char value, char len, int ppu_address);
+.globl vram_stripe_fill_vert
+vram_stripe_fill_vert:
+	ldy #$c0  ; load run and vertical flags
+	bne vram_stripe_fill_common ; always taken
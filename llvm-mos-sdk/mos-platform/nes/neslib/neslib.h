@@ -91,6 +91,20 @@ __attribute__((leaf)) void oam_spr(char x, char y, char chrnum, char attr);
 //  Note: sprid removed for speed
 __attribute__((leaf)) void oam_meta_spr(char x, char y, const void *data);
 
+// set metasprite in OAM buffer, from data already in OAM order
+// data starts with its length in bytes, four per sprite (0 for 64 sprites),
+// then four bytes per sprite in order y offset, tile, attribute, x offset.
+// Write it with OAM_META, or build it from an oam_meta_spr array at compile
+// time with oam_meta_cache in C++. Any number of sprites in a row wraps
+// around the OAM buffer, as oam_clear_flicker needs.
+__attribute__((leaf)) void oam_meta_spr_cached(char x, char y,
+                                               const void *data);
+
+// clear OAM buffer like oam_clear, but start sprid 17 sprites on from where
+// the last call did, so sprites dropped past 8 on a line differ each frame
+// Note: don't follow with oam_hide_rest, which would hide wrapped sprites
+__attribute__((leaf)) void oam_clear_flicker(void);
+
 // hide all remaining sprites from given offset
 //  Note: sprid removed for speed
 //  Now also changes sprid (index to buffer) to zero
@@ -240,6 +254,9 @@ void delay(char frames);
 // macro to calculate nametable address from X,Y in compile time
 #define NTADR_D(x, y) (NAMETABLE_D | (((y) << 5) | (x)))
 
+// one sprite of oam_meta_spr_cached data
+#define OAM_META(x, y, tile, attr) (y), (tile), (attr), (x)
+
 // macro to get MSB
 #define MSB(x) (((x) >> 8))
 
@@ -248,6 +265,29 @@ void delay(char frames);
 
 #ifdef __cplusplus
 }
+
+template <__SIZE_TYPE__ N> struct __oam_meta_cache {
+  unsigned char data[N];
+};
+
+// flatten oam_meta_spr data, including its 128 terminator, into
+// oam_meta_spr_cached data at compile time:
+//   static constexpr auto hero_cached = oam_meta_cache(hero);
+//   oam_meta_spr_cached(x, y, hero_cached.data);
+template <typename T, __SIZE_TYPE__ N>
+constexpr __oam_meta_cache<N> oam_meta_cache(const T (&meta)[N]) {
+  static_assert(N % 4 == 1 && N > 1 && N <= 257,
+                "metasprite must be 1 to 64 sprites and its terminator");
+  __oam_meta_cache<N> cache{};
+  cache.data[0] = (unsigned char)(N - 1);
+  for (__SIZE_TYPE__ i = 0; i + 1 < N; i += 4) {
+    cache.data[i + 1] = (unsigned char)meta[i + 1];
+    cache.data[i + 2] = (unsigned char)meta[i + 2];
+    cache.data[i + 3] = (unsigned char)meta[i + 3];
+    cache.data[i + 4] = (unsigned char)meta[i];
+  }
+  return cache;
+}
 #endif
 
 #endif // _NESLIB_H_
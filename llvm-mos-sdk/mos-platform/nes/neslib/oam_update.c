@@ -4,6 +4,8 @@
 // information.
 
 __attribute__((section(".zp.sprid"))) unsigned SPRID;
+// Where oam_clear_flicker last started drawing.
+__attribute__((section(".zp.oam_flicker"))) char OAM_FLICKER;
 __attribute__((weak, aligned(256), section(".aligned.oam_buf"))) char OAM_BUF[256];
 
 void oam_set(char index) { SPRID = index & 0xfc; }
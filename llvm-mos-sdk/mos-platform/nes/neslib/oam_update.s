@@ -3,7 +3,7 @@
 ; See https://github.com/llvm-mos/llvm-mos-sdk/blob/main/LICENSE for license
 ; information.
 
-.zeropage SPRID
+.zeropage SPRID, OAM_FLICKER
 
 .include "nes.inc"
 
@@ -103,6 +103,83 @@ oam_meta_spr:
 	stx SPRID
 	rts
 
+;void oam_meta_spr_cached(unsigned char x,unsigned char y,const unsigned char *data);
+;data is a byte count, 4 per sprite (0 for 64), then records in OAM order.
+;The data pointer is offset by -SPRID so Y indexes both it and OAM_BUF.
+.section .text.oam_meta_spr_cached,"ax",@progbits
+.globl oam_meta_spr_cached
+oam_meta_spr_cached:
+
+	sta __rc4
+	stx __rc5
+	ldy #0
+	lda (__rc2),y		;byte count
+	clc
+	adc SPRID
+	sta __rc6		;SPRID once drawn
+
+	inc __rc2		;skip the count
+	bne 1f
+	inc __rc3
+1:
+	lda __rc2
+	sec
+	sbc SPRID
+	sta __rc2
+	bcs 2f
+	dec __rc3
+2:
+	ldy SPRID
+3:
+	lda (__rc2),y		;y offset
+	clc
+	adc __rc5
+	sta OAM_BUF,y
+	iny
+	lda (__rc2),y		;tile
+	sta OAM_BUF,y
+	iny
+	lda (__rc2),y		;attribute
+	sta OAM_BUF,y
+	iny
+	lda (__rc2),y		;x offset
+	clc
+	adc __rc4
+	sta OAM_BUF,y
+	iny
+	beq 5f
+4:
+	cpy __rc6
+	bne 3b
+	sty SPRID
+	rts
+5:
+	;wrapped around OAM_BUF; the data carries on in its next page
+	inc __rc3
+	jmp 4b
+
+
+
+;void oam_clear_flicker(void);
+;like oam_clear, unrolled, but drawing starts 17 sprites on from last time.
+;17 is coprime with 64, so each sprite takes every priority in turn.
+.section .text.oam_clear_flicker,"ax",@progbits
+.globl oam_clear_flicker
+oam_clear_flicker:
+
+	lda #$ff
+.set i, 0
+.rept 64
+	sta OAM_BUF+i
+.set i, i+4
+.endr
+	lda OAM_FLICKER
+	clc
+	adc #17*4
+	sta OAM_FLICKER
+	sta SPRID
+	rts
+
 ;void oam_hide_rest(void);
 ;sprid removed
 .section .text.oam_hide_rest,"ax",@progbits
@@ -57,6 +57,23 @@ extern "C" {
 __attribute__((leaf)) void *pce_memop(void *dest, const void *src,
                                       uint16_t count, uint8_t mode);
 
+/**
+ * @brief Perform a memory operation in chunks of 32 bytes, letting interrupts
+ * in between them.
+ *
+ * For PCE_MEMOP_DECR_DECR, dest and src are the last bytes, as for
+ * pce_memop(). Each chunk of PCE_MEMOP_INCR_ALT and PCE_MEMOP_ALT_INCR starts
+ * again at the alternating address's first byte.
+ *
+ * @param dest The destination address.
+ * @param src The source address.
+ * @param count Number of repetitions (bytes). Unlike pce_memop(), 0 does
+ * nothing.
+ * @param mode The memory operation mode.
+ */
+__attribute__((leaf)) void *pce_memop_chunked(void *dest, const void *src,
+                                              uint16_t count, uint8_t mode);
+
 #ifdef __cplusplus
 }
 #endif
@@ -100,6 +100,10 @@ void pce_vdc_set_copy_column_128(void);
 /**
  * @brief Copy data from RAM to VRAM.
  *
+ * Runs with TIA to the data port, 32 bytes at a time, so interrupts are taken
+ * during long copies. Interrupt handlers that select another VDC register
+ * must select VDC_REG_VRAM_DATA again before returning.
+ *
  * @param dest Destination memory address, in words.
  * @param source Source memory address.
  * @param length The length, in bytes.
@@ -109,6 +113,10 @@ void pce_vdc_copy_to_vram(uint16_t dest, const void *source, uint16_t length);
 /**
  * @brief Copy data from VRAM to RAM.
  *
+ * Runs with TAI from the data port, 32 bytes at a time, so interrupts are
+ * taken during long copies. Interrupt handlers that select another VDC
+ * register must select VDC_REG_VRAM_DATA again before returning.
+ *
  * @param dest Destination memory address.
  * @param source Source memory address, in words.
  * @param length The length, in bytes.
@@ -66,14 +66,15 @@ void pce_vdc_copy_to_vram(uint16_t dest, const void *source, uint16_t length) {
   PCE_VDC_INDEX_CONST(VDC_REG_VRAM_WRITE_ADDR);
   *IO_VDC_DATA = dest;
   PCE_VDC_INDEX_CONST(VDC_REG_VRAM_DATA);
-  pce_memop((void *)IO_VDC_DATA, source, length, PCE_MEMOP_INCR_ALT);
+  pce_memop_chunked((void *)IO_VDC_DATA, source, length, PCE_MEMOP_INCR_ALT);
 }
 
 void pce_vdc_copy_from_vram(void *dest, uint16_t source, uint16_t length) {
   PCE_VDC_INDEX_CONST(VDC_REG_VRAM_READ_ADDR);
   *IO_VDC_DATA = source;
   PCE_VDC_INDEX_CONST(VDC_REG_VRAM_DATA);
-  pce_memop(dest, (const void *)IO_VDC_DATA, length, PCE_MEMOP_ALT_INCR);
+  pce_memop_chunked(dest, (const void *)IO_VDC_DATA, length,
+                    PCE_MEMOP_ALT_INCR);
 }
 
 void pce_vdc_dma_start(uint8_t mode, uint16_t source, uint16_t dest,
@@ -0,0 +1,15 @@
+#define MOS_PROFILE
+#include <6502-profile.h>
+
+#include <stdlib.h>
+
+#include "sim-io.h"
+
+uint32_t __mos_profile_clock(void) { return clock(); }
+
+// Tell mos-sim where the ring is, low byte first, so it can print it at exit.
+__attribute__((constructor)) static void announce_ring(void) {
+  extern char __mos_profile_ring[];
+  sim_reg_iface->profile = (uint16_t)__mos_profile_ring;
+  sim_reg_iface->profile = (uint16_t)__mos_profile_ring >> 8;
+}
@@ -0,0 +1,84 @@
+// Semihosted libc, for test builds only: linked with -lsemihost, these
+// replace the weak libc routines with calls that mos-sim --semihost runs on
+// the host (utils/sim/semihost.h). They take no simulated cycles, so never
+// link this into a build whose cycles are measured, and a program using it
+// runs nowhere else: a plain mos-sim aborts at the first call.
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sim-io.h"
+
+enum {
+  SEMIHOST_MEMCPY = 1,
+  SEMIHOST_MEMSET = 2,
+  SEMIHOST_STRLEN = 3,
+  SEMIHOST_VSNPRINTF = 4,
+};
+
+struct _sim_semihost {
+  uint8_t op;       // 0
+  uint16_t args[4]; // 1
+  uint16_t result;  // 9
+};
+
+static uint16_t semihost(uint8_t op, uint16_t a0, uint16_t a1, uint16_t a2,
+                         uint16_t a3) {
+  // The simulator reads and fills the block between the two writes, behind
+  // the compiler's back.
+  volatile struct _sim_semihost call;
+  call.op = op;
+  call.args[0] = a0;
+  call.args[1] = a1;
+  call.args[2] = a2;
+  call.args[3] = a3;
+  asm volatile("" ::: "memory");
+  sim_reg_iface->semihost = (uint16_t)&call;
+  sim_reg_iface->semihost = (uint16_t)&call >> 8;
+  asm volatile("" ::: "memory");
+  return call.result;
+}
+
+void *memcpy(void *restrict s1, const void *restrict s2, size_t n) {
+  return (void *)semihost(SEMIHOST_MEMCPY, (uint16_t)s1, (uint16_t)s2, n, 0);
+}
+
+void *memset(void *s, int c, size_t n) {
+  return (void *)semihost(SEMIHOST_MEMSET, (uint16_t)s, c, n, 0);
+}
+
+size_t strlen(const char *s) {
+  return semihost(SEMIHOST_STRLEN, (uint16_t)s, 0, 0, 0);
+}
+
+int vsnprintf(char *restrict s, size_t n, const char *restrict format,
+              va_list arg) {
+  return semihost(SEMIHOST_VSNPRINTF, (uint16_t)s, n, (uint16_t)format,
+                  (uint16_t)arg);
+}
+
+// Formatted into a buffer by the host, then written out through stdio as
+// usual, so output stays in order with everything else on the stream.
+int vfprintf(FILE *restrict stream, const char *restrict format,
+             va_list arg) {
+  char buf[128];
+  va_list copy;
+  va_copy(copy, arg);
+  const int len = vsnprintf(buf, sizeof(buf), format, copy);
+  va_end(copy);
+
+  char *text = buf;
+  if ((size_t)len >= sizeof(buf)) {
+    text = malloc(len + 1);
+    if (!text)
+      return EOF;
+    vsnprintf(text, len + 1, format, arg);
+  }
+  const int rc = fwrite(text, 1, len, stream) == (size_t)len ? len : EOF;
+  if (text != buf)
+    free(text);
+  return rc;
+}
@@ -4,8 +4,16 @@
 #include <stdint.h>
 
 struct _sim_reg {
-  uint8_t clock[4];  // 0
-  uint8_t unclaimed; // 4
+  union {
+    uint8_t clock[4];  // 0
+    struct {
+      uint8_t clock_lo;
+      uint8_t perf;      // 1, write only: counter buffer address, low then high
+      uint8_t semihost;  // 2, write only: call block address, low then high
+      uint8_t perf_tag;  // 3, write only
+    };
+  };
+  uint8_t profile;   // 4
   char getchar;      // 5
   char input_eof;    // 6
   uint8_t abort;     // 7
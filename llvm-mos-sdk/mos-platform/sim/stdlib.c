@@ -34,3 +34,12 @@ unsigned long clock() {
 }
 
 void reset_clock() { sim_reg_iface->clock[0] = 0; }
+
+void read_perf_counters(struct perf_counters *counters) {
+  // The second write fills the buffer, behind the compiler's back.
+  sim_reg_iface->perf = (uint16_t)counters;
+  sim_reg_iface->perf = (uint16_t)counters >> 8;
+  asm volatile("" ::: "memory");
+}
+
+void set_perf_tag(unsigned char tag) { sim_reg_iface->perf_tag = tag; }
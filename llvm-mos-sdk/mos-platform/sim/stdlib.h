@@ -10,6 +10,20 @@ extern "C" {
 unsigned long clock();
 void reset_clock();
 
+// The simulator's performance counters, from reset.
+struct perf_counters {
+  unsigned long long cycles;
+  unsigned long long instructions;
+  unsigned long long penalty_cycles; // Page crossings, included in cycles
+  unsigned long long reads;
+  unsigned long long writes;
+};
+void read_perf_counters(struct perf_counters *counters);
+
+// Credit the counts from here on to tag. Once a tag is set, the simulator
+// prints each tag's totals at exit.
+void set_perf_tag(unsigned char tag);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,4 @@
+#include "bench.h"
+
+volatile unsigned bench_opaque;
+volatile unsigned bench_sink;
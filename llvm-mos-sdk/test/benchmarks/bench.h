@@ -0,0 +1,47 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+// Each benchmark prints "<name> <cycles>" lines, the cycles one run of a body
+// took on average, timed with the sim platform's cycle counter. The count
+// includes the loop around the body, a dozen or so cycles.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Sizes and inputs read from here are unknown to the optimizer, so it can't
+// specialize the calls being timed.
+extern volatile unsigned bench_opaque;
+
+// Results stored here can't be dropped.
+extern volatile unsigned bench_sink;
+
+static inline void bench_report(const char *name, unsigned long cycles,
+                                unsigned runs) {
+  printf("%s %lu\n", name, cycles / runs);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+// Keeps the optimizer from dropping work whose results go unused, or moving
+// it out of the loop.
+#define BENCH_CLOBBER() __asm__ volatile("" ::: "memory")
+
+// Time the body, the rest of the arguments, over the given number of runs.
+// It can use bench_run, the index of the run.
+#define BENCH(name, runs, ...)                                                 \
+  do {                                                                         \
+    const unsigned long bench_start = clock();                                 \
+    for (unsigned bench_run = 0; bench_run < (runs); ++bench_run) {            \
+      __VA_ARGS__;                                                             \
+      BENCH_CLOBBER();                                                         \
+    }                                                                          \
+    bench_report(name, clock() - bench_start, runs);                           \
+  } while (0)
+
+#endif // not BENCH_H
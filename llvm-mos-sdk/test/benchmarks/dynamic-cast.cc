@@ -0,0 +1,26 @@
+#include "bench.h"
+
+// A game-object style hierarchy: one-level and two-level single inheritance,
+// plus a cast that fails.
+struct Object {
+  virtual ~Object() {}
+};
+struct Actor : Object {};
+struct Player : Actor {};
+struct Prop : Object {};
+
+static Player player;
+static Prop prop;
+static Object *objects[] = {&player, &prop};
+
+int main() {
+  // The index is opaque, so the cast can't be folded.
+  const auto obj = [] { return objects[bench_opaque & 1]; };
+
+  BENCH("dynamic_cast-hit", 50, bench_sink = dynamic_cast<Player *>(obj()) != 0);
+  BENCH("dynamic_cast-base", 50, bench_sink = dynamic_cast<Actor *>(obj()) != 0);
+  bench_opaque ^= 1;
+  BENCH("dynamic_cast-miss", 50, bench_sink = dynamic_cast<Actor *>(obj()) != 0);
+  bench_opaque ^= 1;
+  return 0;
+}
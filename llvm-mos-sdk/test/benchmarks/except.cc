@@ -0,0 +1,48 @@
+#include <except.h>
+
+#include "bench.h"
+
+// A failure three calls down, reported by error codes checked at each level
+// and by except::raise(), with a cleanup at each level.
+
+__attribute__((noinline)) static int code_leaf() { return bench_opaque ? 2 : 0; }
+__attribute__((noinline)) static int code_mid() {
+  if (int e = code_leaf())
+    return e;
+  ++bench_sink;
+  return 0;
+}
+__attribute__((noinline)) static int code_top() {
+  if (int e = code_mid())
+    return e;
+  ++bench_sink;
+  return 0;
+}
+
+static void count(void *) { ++bench_sink; }
+
+__attribute__((noinline)) static void raise_leaf() {
+  except::Cleanup c(count, nullptr);
+  if (bench_opaque)
+    except::raise(2);
+}
+__attribute__((noinline)) static void raise_mid() {
+  except::Cleanup c(count, nullptr);
+  raise_leaf();
+  ++bench_sink;
+}
+__attribute__((noinline)) static void raise_top() {
+  except::Cleanup c(count, nullptr);
+  raise_mid();
+  ++bench_sink;
+}
+
+int main() {
+  bench_opaque = 0;
+  BENCH("error-code-ok", 50, bench_sink = code_top());
+  BENCH("attempt-ok", 50, bench_sink = except::attempt(raise_top));
+  bench_opaque = 1;
+  BENCH("error-code-fail", 50, bench_sink = code_top());
+  BENCH("attempt-raise", 50, bench_sink = except::attempt(raise_top));
+  return 0;
+}
@@ -0,0 +1,34 @@
+#include <fixed_point.h>
+
+#include "bench.h"
+
+using namespace fixedpoint_literals;
+
+// Operands and results go through volatile raw values, so each run really
+// computes.
+static volatile uint16_t raw_a = (-1.5_8_8).get(), raw_b = (2.25_8_8).get(),
+                         raw_c = (6.25_u8_8).get();
+static volatile uint16_t sink;
+static char text[f8_8::chars(4)];
+
+template <typename F> static F load(volatile uint16_t &raw) {
+  F f{0};
+  f.set(raw);
+  return f;
+}
+
+int main() {
+  const auto a = [] { return load<f8_8>(raw_a); };
+  const auto b = [] { return load<f8_8>(raw_b); };
+  const auto c = [] { return load<fu8_8>(raw_c); };
+
+  BENCH("f8_8-add", 100, sink = (a() + b()).get());
+  BENCH("f8_8-operator*", 50, sink = (a() * b()).get());
+  BENCH("f8_8-mul", 50, sink = fixedpoint::mul(a(), b()).get());
+  BENCH("f8_8-operator/", 20, sink = (b() / a()).get());
+  BENCH("f8_8-div", 50, sink = fixedpoint::div(b(), a()).get());
+  BENCH("f8_8-sin", 50, sink = fixedpoint::sin(uint8_t(raw_a)).get());
+  BENCH("fu8_8-sqrt", 50, sink = fixedpoint::sqrt(c()).get());
+  BENCH("f8_8-to_chars", 20, sink = *a().to_chars(text, 4));
+  return 0;
+}
@@ -0,0 +1,28 @@
+#include "bench.h"
+
+#define BLOCKS 16
+
+static void *blocks[BLOCKS];
+
+// Runs are one malloc and one free each.
+int main(void) {
+  // The sink keeps the pair from being optimized away.
+  BENCH("malloc-free-16", 100, {
+    void *p = malloc(16);
+    bench_sink = (size_t)p;
+    free(p);
+  });
+
+  // Churn: keep BLOCKS blocks of mixed sizes live, replacing them out of
+  // order so the free list fragments.
+  for (unsigned i = 0; i < BLOCKS; ++i)
+    blocks[i] = malloc(8 + i * 4);
+  BENCH("malloc-free-churn", 200, {
+    const unsigned i = bench_run * 7 % BLOCKS;
+    free(blocks[i]);
+    blocks[i] = malloc(8 + (bench_run * 13 % 48));
+  });
+  for (unsigned i = 0; i < BLOCKS; ++i)
+    free(blocks[i]);
+  return 0;
+}
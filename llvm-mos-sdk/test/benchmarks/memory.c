@@ -0,0 +1,19 @@
+#include <string.h>
+
+#include "bench.h"
+
+static char src[256], dst[256];
+
+int main(void) {
+  bench_opaque = 16;
+  const unsigned small = bench_opaque;
+  bench_opaque = 256;
+  const unsigned large = bench_opaque;
+
+  BENCH("memcpy-16", 100, memcpy(dst, src, small));
+  BENCH("memcpy-256", 20, memcpy(dst, src, large));
+  BENCH("memset-16", 100, memset(dst, bench_opaque, small));
+  BENCH("memset-256", 20, memset(dst, bench_opaque, large));
+  BENCH("memmove-256-up", 20, memmove(dst + 1, dst, large - 1));
+  return 0;
+}
@@ -0,0 +1,17 @@
+// printf's conversions, into a buffer so the output itself isn't timed.
+
+#include "bench.h"
+
+static char buf[32];
+
+int main(void) {
+  bench_opaque = 12345;
+  const int value = bench_opaque;
+
+  BENCH("sprintf-d-5", 20, sprintf(buf, "%d", value));
+  BENCH("sprintf-d-1", 20, sprintf(buf, "%d", value % 10));
+  BENCH("sprintf-u-ld", 20, sprintf(buf, "%u %ld", value, 123456789L));
+  BENCH("sprintf-x-04", 20, sprintf(buf, "%04x", value));
+  BENCH("sprintf-s", 20, sprintf(buf, "<%s>", "hello"));
+  return 0;
+}
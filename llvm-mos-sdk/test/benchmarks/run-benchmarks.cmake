@@ -0,0 +1,34 @@
+# Runs each of BENCHMARKS (comma-separated) under MOS_SIM, and prints a table
+# of the cycles per operation they report, also written to OUTPUT.
+
+string(REPLACE "," ";" BENCHMARKS "${BENCHMARKS}")
+
+set(table "")
+foreach(benchmark ${BENCHMARKS})
+  execute_process(COMMAND ${MOS_SIM} --cycles ${benchmark}
+    OUTPUT_VARIABLE output
+    ERROR_VARIABLE error
+    RESULT_VARIABLE result)
+  if(NOT result EQUAL 0)
+    message(FATAL_ERROR "${benchmark} failed (${result}):\n${output}${error}")
+  endif()
+  string(REGEX MATCH "[0-9]+ cycles" total "${error}")
+  string(APPEND table "${benchmark} (${total} in all)\n")
+
+  string(REPLACE "\n" ";" lines "${output}")
+  foreach(line ${lines})
+    if(NOT line MATCHES "^([^ ]+) ([0-9]+)$")
+      continue()
+    endif()
+    string(LENGTH "${CMAKE_MATCH_1}" length)
+    math(EXPR padding "24 - ${length}")
+    if(padding LESS 1)
+      set(padding 1)
+    endif()
+    string(REPEAT " " ${padding} spaces)
+    string(APPEND table "  ${CMAKE_MATCH_1}${spaces}${CMAKE_MATCH_2}\n")
+  endforeach()
+endforeach()
+
+file(WRITE ${OUTPUT} "${table}")
+message("Cycles per operation:\n${table}")
@@ -0,0 +1,11 @@
+#include "bench.h"
+
+int main(void) {
+  int i, j;
+  char word[8];
+
+  BENCH("sscanf-d", 20, sscanf("12345", "%d", &i));
+  BENCH("sscanf-d-d-s", 20, sscanf("12 -34 word", "%d %d %7s", &i, &j, word));
+  BENCH("sscanf-x", 20, sscanf("beef", "%x", &i));
+  return 0;
+}
@@ -0,0 +1,24 @@
+#include <string.h>
+
+#include "bench.h"
+
+static char a[65], b[65];
+
+int main(void) {
+  memset(a, 'x', 64);
+  memset(b, 'x', 64);
+  bench_opaque = 16;
+  const unsigned small = bench_opaque;
+
+  a[small] = b[small] = '\0';
+  BENCH("strlen-16", 100, bench_sink = strlen(a));
+  BENCH("strcmp-16-equal", 100, bench_sink = strcmp(a, b));
+  a[small] = b[small] = 'x';
+
+  BENCH("strlen-64", 50, bench_sink = strlen(a));
+  BENCH("strcmp-64-equal", 50, bench_sink = strcmp(a, b));
+  b[0] = 'y';
+  BENCH("strcmp-64-first", 100, bench_sink = strcmp(a, b));
+  BENCH("strchr-64-missing", 50, bench_sink = (size_t)strchr(a, 'z'));
+  return 0;
+}
@@ -1,5 +1,4 @@
 load_core(corepath)
-load_game(rompath)
 
 -- function to extract filename from path
 function get_filename(path)
@@ -15,45 +14,78 @@ function get_filename(path)
     return result
 end
 
-romname = get_filename(rompath)
-print("Running test on", romname)
+-- run the loaded game until it reports, returning 0 if it passed, 1 if it
+-- failed and 2 if it never said; fb_crc_pass, if set, is the CRC of a
+-- video frame that passes it
+function run_test(romname, fb_crc_pass)
+    print("Running test on", romname)
+
+    print(get_logs())
 
-print(get_logs())
+    for i=1,1000 do
 
-for i=1,1000 do
+        run()
 
-    run()
+        local ram = get_ram()
 
-    local ram = get_ram()
+        -- check for a CRC match
+        if fb_crc_pass then
+            if get_fb_crc() == fb_crc_pass then
+                print("Test passed via get_fb_crc.")
+                screenshot(romname .. "-pass.png")
+                return 0
+            end
+        end
 
-    -- look for env var "EMUTEST_FB_CRC_PASS"
-    if os.getenv("EMUTEST_FB_CRC_PASS") then
-        -- if found, check for CRC match
-        if get_fb_crc() == tonumber(os.getenv("EMUTEST_FB_CRC_PASS")) then
-            print("Test passed via get_fb_crc.")
+        -- look for RAM signature
+        if string.find(ram, 'TestPass') then
+            print("Test passed via RAM signature.")
+            run()
+            print("FB_CRC=", get_fb_crc())
             screenshot(romname .. "-pass.png")
-            os.exit(0)
+            return 0
+        elseif string.find(ram, 'TestFail') then
+            print("Test failed via RAM signature.")
+            run()
+            print("FB_CRC=", get_fb_crc())
+            screenshot(romname .. "-fail.png")
+            return 1
         end
+
     end
 
-    -- look for RAM signature
-    if string.find(ram, 'TestPass') then
-        print("Test passed via RAM signature.")
-        run()
-        print("FB_CRC=", get_fb_crc())
-        screenshot(romname .. "-pass.png")
-        os.exit(0)
-    elseif string.find(ram, 'TestFail') then
-        print("Test failed via RAM signature.")
-        run()
-        print("FB_CRC=", get_fb_crc())
-        screenshot(romname .. "-fail.png")
-        os.exit(1)
+    print("Test indeterminate.")
+    print("FB_CRC=", get_fb_crc())
+    screenshot(romname .. "-unknown.png")
+    return 2
+end
+
+-- with EMUTEST_BATCH set (see test.cmake), rompath lists one ROM per line,
+-- each with a tab and its frame CRC (or nothing) after it, each loaded in
+-- turn into the one core, and each result goes to <rom>.result for its own
+-- test to check
+if os.getenv("EMUTEST_BATCH") then
+    local roms = {}
+    for line in io.lines(rompath) do
+        local path, crc = string.match(line, "^([^\t]*)\t?(%d*)$")
+        if path and path ~= "" then
+            table.insert(roms, { path = path, crc = tonumber(crc) })
+            -- a result left from an earlier run mustn't outlive a crash here
+            os.remove(path .. ".result")
+        end
     end
 
+    local results = { [0] = "pass", "fail", "indeterminate" }
+    for _, rom in ipairs(roms) do
+        local path = rom.path
+        load_game(path)
+        local result = results[run_test(get_filename(path), rom.crc)]
+        local file = io.open(path .. ".result", "w")
+        file:write(result, "\n")
+        file:close()
+    end
+    os.exit(0)
 end
 
-print("Test indeterminate.")
-print("FB_CRC=", get_fb_crc())
-screenshot(romname .. "-unknown.png")
-os.exit(2)
+load_game(rompath)
+os.exit(run_test(get_filename(rompath), tonumber(os.getenv("EMUTEST_FB_CRC_PASS"))))
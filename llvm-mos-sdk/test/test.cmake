@@ -3,16 +3,74 @@ include(CTest)
 add_library(test-lib-emutest ${CMAKE_CURRENT_SOURCE_DIR}/../test-lib-emutest.c)
 target_include_directories(test-lib-emutest PUBLIC ${CMAKE_CURRENT_SOURCE_DIR}/../)
 
+# With EMUTEST_SHARDS at n > 0, each libretro core's tests are dealt round
+# robin to n emutest processes, each loading the core once and running its
+# ROMs in turn (emutest.lua's batch mode), and ctest -j runs the processes
+# side by side. The per-ROM tests then only check the result each left, so
+# anything a ROM's run needs travels with it in the shard's ROM list.
+function(_emutest_shard libretro_core libretro_shared_lib out)
+  string(REGEX REPLACE "^LIBRETRO_(.*)_CORE$" "\\1" core ${libretro_core})
+  string(TOLOWER ${core} core)
+  get_property(count GLOBAL PROPERTY EMUTEST_${core}_COUNT)
+  if(NOT count)
+    set(count 0)
+  endif()
+  math(EXPR shard_index "${count} % ${EMUTEST_SHARDS}")
+  math(EXPR count "${count} + 1")
+  set_property(GLOBAL PROPERTY EMUTEST_${core}_COUNT ${count})
+
+  set(shard emutest-${core}-${shard_index})
+  if(NOT TARGET ${shard})
+    # Holds the shard's ROMs, listed at generate time once all are known.
+    add_custom_target(${shard})
+    set(rom_list ${CMAKE_BINARY_DIR}/${shard}.txt)
+    file(GENERATE OUTPUT ${rom_list}
+      CONTENT "$<JOIN:$<GENEX_EVAL:$<TARGET_PROPERTY:${shard},EMUTEST_ROMS>>,\n>\n")
+    add_test(NAME ${shard} COMMAND ${EMUTEST_COMMAND} -T
+      -L ${libretro_shared_lib}
+      -r ${rom_list}
+      -t ${CMAKE_CURRENT_FUNCTION_LIST_DIR}/emutest.lua)
+    set_tests_properties(${shard} PROPERTIES
+      FIXTURES_SETUP ${shard}
+      ENVIRONMENT EMUTEST_BATCH=1)
+  endif()
+  set(${out} ${shard} PARENT_SCOPE)
+endfunction()
+
 function(add_emutest_test name binext source_dir libretro_core)
   add_executable(${name}.${binext} ${source_dir}/${name}.c)
   target_link_libraries(${name}.${binext} test-lib-emutest)
   get_property(libretro_shared_lib VARIABLE PROPERTY ${libretro_core})
+  set_property(GLOBAL PROPERTY EMUTEST_TARGET_${name} ${name}.${binext})
+  if(EMUTEST_SHARDS GREATER 0)
+    _emutest_shard(${libretro_core} ${libretro_shared_lib} shard)
+    # One line per ROM: its path, a tab, and its frame CRC if it has one
+    set_property(TARGET ${shard} APPEND PROPERTY EMUTEST_ROMS
+      "$<TARGET_FILE:${name}.${binext}>\t$<TARGET_PROPERTY:${name}.${binext},EMUTEST_FB_CRC_PASS>")
+    add_test(NAME test-${name} COMMAND ${CMAKE_COMMAND} -E cat
+      $<TARGET_FILE:${name}.${binext}>.result)
+    set_tests_properties(test-${name} PROPERTIES
+      FIXTURES_REQUIRED ${shard}
+      PASS_REGULAR_EXPRESSION "^pass")
+    return()
+  endif()
   add_test(NAME test-${name} COMMAND ${EMUTEST_COMMAND} -T
     -L ${libretro_shared_lib}
     -r $<TARGET_FILE:${name}.${binext}>
     -t ${CMAKE_CURRENT_SOURCE_DIR}/../emutest.lua)
 endfunction()
 
+# Pass emutest <name> once a video frame has CRC <crc>, as well as on its
+# RAM signature. A shard has the CRC from its ROM list, not the test's
+# environment, which only the unsharded test runs in.
+function(emutest_fb_crc_pass name crc)
+  get_property(target GLOBAL PROPERTY EMUTEST_TARGET_${name})
+  set_property(TARGET ${target} PROPERTY EMUTEST_FB_CRC_PASS ${crc})
+  if(NOT EMUTEST_SHARDS GREATER 0)
+    set_property(TEST test-${name} PROPERTY ENVIRONMENT EMUTEST_FB_CRC_PASS=${crc})
+  endif()
+endfunction()
+
 function(add_common_compile_test target type)
   add_executable(${target} ${target}.c)
   add_test(NAME ${target}-${type} COMMAND ${CMAKE_CTEST_COMMAND}
@@ -32,6 +32,7 @@
 
 /* ELF structure definitions. */
 
+#define ELF32_EHDR_ENTRY offsetof(Elf32_Ehdr, e_entry)
 #define ELF32_EHDR_IDENT offsetof(Elf32_Ehdr, e_ident)
 #define ELF32_EHDR_MACHINE offsetof(Elf32_Ehdr, e_machine)
 #define ELF32_EHDR_PHENTSIZE offsetof(Elf32_Ehdr, e_phentsize)
@@ -50,6 +51,8 @@
 #define ELF32_PHDR__SIZE sizeof(Elf32_Phdr)
 
 #define ELF32_SHDR_TYPE offsetof(Elf32_Shdr, sh_type)
+#define ELF32_SHDR_FLAGS offsetof(Elf32_Shdr, sh_flags)
+#define ELF32_SHDR_LINK offsetof(Elf32_Shdr, sh_link)
 #define ELF32_SHDR_OFFSET offsetof(Elf32_Shdr, sh_offset)
 #define ELF32_SHDR_SIZE offsetof(Elf32_Shdr, sh_size)
 #define ELF32_SHDR_ENTSIZE offsetof(Elf32_Shdr, sh_entsize)
@@ -57,6 +60,7 @@
 
 #define ELF32_SYM_NAME offsetof(Elf32_Sym, st_name)
 #define ELF32_SYM_VALUE offsetof(Elf32_Sym, st_value)
+#define ELF32_SYM_INFO offsetof(Elf32_Sym, st_info)
 #define ELF32_SYM_SHNDX offsetof(Elf32_Sym, st_shndx)
 #define ELF32_SYM__SIZE sizeof(Elf32_Sym)
 
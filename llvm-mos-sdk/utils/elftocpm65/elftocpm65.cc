@@ -106,6 +106,14 @@ private:
   int _phnum;
 };
 
+/* Encodes relocations the way the CP/M-65 BDOS loader reads them: a stream of
+ * nybbles, high first, each of which either advances 0-13 bytes and relocates
+ * the byte there (0x0-0xd), advances 14 bytes without relocating (0xe), or
+ * ends the table (0xf). The loader applies the tables before the program
+ * runs, so this format is fixed by the OS; a delta stream is usually around
+ * half a byte per relocation, well under the eighth of a byte per byte of
+ * image a bitmap would take. */
+
 std::vector<uint8_t> toBytestream(const std::set<uint16_t> &differences) {
   std::vector<uint8_t> bytes;
   uint16_t pos = 0;
@@ -251,10 +259,19 @@ int main(int argc, char *const *argv) {
 
   /* Add the relocation tables. */
 
-  for (uint8_t b : toBytestream(zpRelocations))
-    bytes.push_back(b);
-  for (uint8_t b : toBytestream(memRelocations))
-    bytes.push_back(b);
+  std::vector<uint8_t> zpTable = toBytestream(zpRelocations);
+  std::vector<uint8_t> memTable = toBytestream(memRelocations);
+
+  if (verbose) {
+    printf("image=%u bytes, %u zp relocations (%u bytes), %u memory "
+           "relocations (%u bytes)\n",
+           (unsigned)bytes.size(), (unsigned)zpRelocations.size(),
+           (unsigned)zpTable.size(), (unsigned)memRelocations.size(),
+           (unsigned)memTable.size());
+  }
+
+  bytes.insert(bytes.end(), zpTable.begin(), zpTable.end());
+  bytes.insert(bytes.end(), memTable.begin(), memTable.end());
 
   /* Adjust the memory requirements to ensure the relocations can be loaded.
    */
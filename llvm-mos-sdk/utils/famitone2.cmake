@@ -0,0 +1,74 @@
+# FamiTone2 asset conversion for projects built with the SDK.
+#
+#   ft2_convert(<TEXT2DATA|NSF2DATA> <module>
+#               [OUTPUT <file>...] [OPTIONS <option>...])
+#
+# Converts a FamiTracker text export (TEXT2DATA, for ft2-text2data) or an NSF
+# of sound effects (NSF2DATA, for ft2-nsf2data) at build time, into
+# OUTPUT, by default <module name>.s (.asm for -nesasm and -asm6) in the
+# current binary directory. List every file the project uses in OUTPUT, such
+# as the .dmc of a module with samples or the per-song files of -s; they are
+# all written to the directory of the first. OPTIONS are passed to the tool.
+#
+# Add the outputs to a target's sources to build them. A module is converted
+# again only when its contents, the tool or the options change; otherwise the
+# outputs are left untouched, so nothing that uses them is rebuilt. (Once the
+# module is touched, the check runs on each build; it only hashes.)
+
+set(_FT2_CONVERT_SCRIPT ${CMAKE_CURRENT_LIST_DIR}/ft2-convert.cmake)
+# Installed to lib/cmake/llvm-mos-sdk, beside bin.
+set(_FT2_BIN_DIR ${CMAKE_CURRENT_LIST_DIR}/../../../bin)
+
+function(ft2_convert tool module)
+  cmake_parse_arguments(ARG "" "" "OUTPUT;OPTIONS" ${ARGN})
+  if(tool STREQUAL TEXT2DATA)
+    set(name ft2-text2data)
+  elseif(tool STREQUAL NSF2DATA)
+    set(name ft2-nsf2data)
+  else()
+    message(FATAL_ERROR "ft2_convert: unknown tool ${tool}.")
+  endif()
+
+  if(TARGET ${name})
+    set(command $<TARGET_FILE:${name}>)
+    set(depends ${name})
+  else()
+    string(TOUPPER ${name} var)
+    string(REPLACE "-" "_" var ${var})
+    find_program(${var} ${name} HINTS ${_FT2_BIN_DIR})
+    if(NOT ${var})
+      message(FATAL_ERROR "ft2_convert: could not find ${name}.")
+    endif()
+    set(command ${${var}})
+    set(depends ${command})
+  endif()
+
+  get_filename_component(module ${module} ABSOLUTE)
+  if(NOT ARG_OUTPUT)
+    get_filename_component(stem ${module} NAME_WLE)
+    if("-nesasm" IN_LIST ARG_OPTIONS OR "-asm6" IN_LIST ARG_OPTIONS)
+      set(ARG_OUTPUT ${stem}.asm)
+    else()
+      set(ARG_OUTPUT ${stem}.s)
+    endif()
+  endif()
+  set(outputs)
+  foreach(output ${ARG_OUTPUT})
+    get_filename_component(output ${output} ABSOLUTE
+                           BASE_DIR ${CMAKE_CURRENT_BINARY_DIR})
+    list(APPEND outputs ${output})
+  endforeach()
+  list(GET outputs 0 first)
+  get_filename_component(dir ${first} DIRECTORY)
+
+  string(REPLACE ";" "," outputs_arg "${outputs}")
+  string(REPLACE ";" "," options_arg "${ARG_OPTIONS}")
+  add_custom_command(
+    OUTPUT ${outputs}
+    COMMAND ${CMAKE_COMMAND} -DTOOL=${command} -DINPUT=${module}
+            -DOUTPUT_DIR=${dir} -DOUTPUTS=${outputs_arg}
+            -DOPTIONS=${options_arg} -P ${_FT2_CONVERT_SCRIPT}
+    DEPENDS ${module} ${depends} ${_FT2_CONVERT_SCRIPT}
+    COMMENT "Converting ${module}"
+    VERBATIM)
+endfunction()
@@ -0,0 +1,71 @@
+# Run a FamiTone2 converter on a module, unless the module, the converter and
+# its options are the same as the last time, in which case nothing is written.
+#
+# Run by the commands ft2_convert (famitone2.cmake) adds, as
+#   cmake -DTOOL=<converter> -DINPUT=<module> -DOUTPUT_DIR=<dir>
+#         -DOUTPUTS=<file,...> [-DOPTIONS=<option,...>] -P ft2-convert.cmake
+#
+# The converters write next to their input and name their labels after it, so
+# the module is converted from a copy in a scratch directory, and what it
+# produced is copied to OUTPUT_DIR. Copies only replace files whose contents
+# changed, so an unchanged conversion doesn't rebuild what includes it.
+
+foreach(var TOOL INPUT OUTPUT_DIR OUTPUTS)
+  if(NOT DEFINED ${var})
+    message(FATAL_ERROR "ft2-convert.cmake: ${var} is not set.")
+  endif()
+endforeach()
+string(REPLACE "," ";" OPTIONS "${OPTIONS}")
+string(REPLACE "," ";" OUTPUTS "${OUTPUTS}")
+
+get_filename_component(name ${INPUT} NAME)
+set(stamp ${OUTPUT_DIR}/${name}.ft2-hash)
+
+file(SHA256 ${INPUT} input_hash)
+file(SHA256 ${TOOL} tool_hash)
+string(SHA256 key "${input_hash};${tool_hash};${OPTIONS}")
+
+if(EXISTS ${stamp})
+  file(READ ${stamp} last_key)
+  set(hit TRUE)
+  foreach(output ${OUTPUTS})
+    if(NOT EXISTS ${output})
+      set(hit FALSE)
+    endif()
+  endforeach()
+  if(hit AND last_key STREQUAL key)
+    return()
+  endif()
+endif()
+
+set(work ${OUTPUT_DIR}/${name}.ft2-work)
+file(REMOVE_RECURSE ${work})
+file(MAKE_DIRECTORY ${work})
+file(COPY ${INPUT} DESTINATION ${work})
+
+execute_process(COMMAND ${TOOL} ${name} ${OPTIONS}
+                WORKING_DIRECTORY ${work}
+                RESULT_VARIABLE result
+                OUTPUT_VARIABLE output
+                ERROR_VARIABLE output)
+if(NOT result EQUAL 0)
+  file(REMOVE_RECURSE ${work})
+  file(REMOVE ${stamp})
+  message(FATAL_ERROR "${TOOL} ${name} failed:\n${output}")
+endif()
+
+file(GLOB produced RELATIVE ${work} ${work}/*)
+list(REMOVE_ITEM produced ${name})
+foreach(file ${produced})
+  execute_process(COMMAND ${CMAKE_COMMAND} -E copy_if_different
+                          ${work}/${file} ${OUTPUT_DIR}/${file})
+endforeach()
+file(REMOVE_RECURSE ${work})
+
+foreach(output ${OUTPUTS})
+  if(NOT EXISTS ${output})
+    file(REMOVE ${stamp})
+    message(FATAL_ERROR "${TOOL} ${name} did not produce ${output}.")
+  endif()
+endforeach()
+file(WRITE ${stamp} ${key})
@@ -1,8 +1,17 @@
 // clang-format off
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fake6502.h>
+
 #define OUT_NESASM 0
 #define OUT_CA65 1
 #define OUT_ASM6 2
@@ -12,17 +21,19 @@ char DB[8];
 char DW[8];
 char LL[8];
 
-unsigned char memory[65536];
-bool should_log;
-bool change;
-int wait_;
-int duration;
+// The state of one effect's emulation. Each effect is emulated on its own
+// thread, with its own copy.
+thread_local unsigned char memory[65536];
+thread_local bool should_log;
+thread_local bool change;
+thread_local int wait_;
+thread_local int duration;
 
-int volume[4];
+thread_local int volume[4];
 
-bool volume_all_zero;
+thread_local bool volume_all_zero;
 
-int regs[32];
+thread_local int regs[32];
 
 FILE *out_file;
 int out_size;
@@ -35,13 +46,50 @@ int nsf_load_adr;
 int nsf_init_adr;
 int nsf_play_adr;
 
-unsigned char effect_data[256];
+thread_local unsigned char effect_data[256];
+
+thread_local int effect_ptr;
+thread_local int effect_last_zero_volume_ptr;
+
+thread_local bool effect_stop;
+thread_local int effect_error;
+
+// What converting one effect in one mode printed and emitted, kept to be
+// merged in order once all are converted.
+struct EffectResult {
+  std::string log;
+  std::string out;
+  int size;
+  int error;
+};
+
+thread_local EffectResult *result;
+
+static void append(std::string &str, const char *format, va_list ap) {
+  va_list aq;
+  va_copy(aq, ap);
+  int len = vsnprintf(nullptr, 0, format, aq);
+  va_end(aq);
+
+  size_t start = str.size();
+  str.resize(start + len + 1);
+  vsnprintf(&str[start], len + 1, format, ap);
+  str.resize(start + len);
+}
 
-int effect_ptr;
-int effect_last_zero_volume_ptr;
+static void log_printf(const char *format, ...) {
+  va_list ap;
+  va_start(ap, format);
+  append(result->log, format, ap);
+  va_end(ap);
+}
 
-bool effect_stop;
-int effect_error;
+static void out_printf(const char *format, ...) {
+  va_list ap;
+  va_start(ap, format);
+  append(result->out, format, ap);
+  va_end(ap);
+}
 
 bool pal;
 bool ntsc;
@@ -95,7 +143,7 @@ static inline void mem_wr(int adr, unsigned char data) {
 
     if (adr == 0x4001 || adr == 0x4005) {
       if (data & 0x80) {
-        printf("\nError: sweep effects are not supported.\n");
+        log_printf("\nError: sweep effects are not supported.\n");
 
         effect_error = 1;
       }
@@ -155,139 +203,215 @@ static inline void mem_wr(int adr, unsigned char data) {
   }
 }
 
-#include "cpu2a03.h"
+// The CPU of this thread's effect. Like the NSF player, it stops at a BRK,
+// which the init and play routines return to, or at a JAM.
+thread_local cpu6502 cpu;
+thread_local bool jam;
+
+static uint8_t cpu_read(cpu6502 *, uint16_t adr) { return mem_rd(adr); }
+
+static void cpu_write(cpu6502 *, uint16_t adr, uint8_t data) {
+  mem_wr(adr, data);
+}
+
+static void cpu_reset(void) {
+  cpu6502_init(&cpu, cpu_read, cpu_write, nullptr);
+  cpu6502_reset(&cpu, 0);
+  cpu.sp = 0xff;
+  cpu.status = 0x22; // Z and the unused bit
+  jam = false;
+}
+
+// fake6502 runs the JAM opcodes ($x2 but $82, $A2, $C2 and $E2) as NOPs.
+static bool is_jam(unsigned char op) {
+  return (op & 0x0f) == 0x02 && op != 0x82 && op != 0xa2 && op != 0xc2 &&
+         op != 0xe2;
+}
+
+static void cpu_tick(void) {
+  if (jam)
+    return;
+  unsigned char op = mem_rd(cpu.pc);
+  if (op == 0x00 || is_jam(op)) {
+    jam = true;
+    return;
+  }
+  cpu6502_step(&cpu);
+}
 
-void convert_effects(void) {
-  int i, cnt, col, song, mode;
+static void convert_effect(int song, int mode) {
+  int i, cnt, col;
 
   effect_error = 0;
 
-  for (song = 0; song < nsf_songs; ++song) {
-    printf("Effect %i", song);
+  out_printf("%ssfx_%s_%i:\n", LL, !mode ? "ntsc" : "pal", song);
 
-    for (mode = 0; mode < 2; ++mode) {
-      if (!mode && !ntsc)
-        continue;
-      if (mode && !pal)
-        continue;
+  memset(memory, 0, 65536);
+  memcpy(memory + nsf_load_adr, nsf_data + 0x80, nsf_size - 0x80);
 
-      fprintf(out_file, "%ssfx_%s_%i:\n", LL, !mode ? "ntsc" : "pal", song);
+  for (i = 0; i < 32; i++)
+    regs[i] = -1;
 
-      memset(memory, 0, 65536);
-      memcpy(memory + nsf_load_adr, nsf_data + 0x80, nsf_size - 0x80);
+  regs[0x00] = 0x30;
+  regs[0x04] = 0x30;
+  regs[0x08] = 0x00;
+  regs[0x0c] = 0x30;
 
-      for (i = 0; i < 32; i++)
-        regs[i] = -1;
+  volume[0] = 0;
+  volume[1] = 0;
+  volume[2] = 0;
+  volume[3] = 0;
 
-      regs[0x00] = 0x30;
-      regs[0x04] = 0x30;
-      regs[0x08] = 0x00;
-      regs[0x0c] = 0x30;
+  volume_all_zero = true;
 
-      volume[0] = 0;
-      volume[1] = 0;
-      volume[2] = 0;
-      volume[3] = 0;
+  cpu_reset();
 
-      volume_all_zero = true;
+  cpu.a = song;
+  cpu.x = mode;
+  cpu.pc = nsf_init_adr;
+  cpu.sp = 0xFC;          // reserve 3 bytes on stack
+  memory[0x01FF] = 0x00; // BRK instruction to cause jam
+  memory[0x01FE] = 0x01; // return address 0x01FF-1
+  memory[0x01FD] = 0xFE;
 
-      cpu_reset();
+  should_log = false;
 
-      CPU.A = song;
-      CPU.X = mode;
-      CPU.PC.hl = nsf_init_adr;
-      CPU.S = 0xFC;          // reserve 3 bytes on stack
-      memory[0x01FF] = 0x00; // BRK instruction to cause jam
-      memory[0x01FE] = 0x01; // return address 0x01FF-1
-      memory[0x01FD] = 0xFE;
+  for (i = 0; i < 2000; ++i)
+    cpu_tick(); // 2000 is enough for FT init
 
-      should_log = false;
+  cpu_reset();
 
-      for (i = 0; i < 2000; ++i)
-        cpu_tick(); // 2000 is enough for FT init
+  effect_ptr = 0;
+  effect_last_zero_volume_ptr = 0;
 
-      cpu_reset();
+  should_log = true;
+  cnt = 0;
+  wait_ = -1;
+  duration = 0;
+  effect_stop = false;
 
-      effect_ptr = 0;
-      effect_last_zero_volume_ptr = 0;
+  while (!effect_stop) {
+    cpu.pc = nsf_play_adr;
+    jam = false;
+    cpu.sp = 0xff;
+    change = false;
 
-      should_log = true;
-      cnt = 0;
-      wait_ = -1;
-      duration = 0;
-      effect_stop = false;
+    for (i = 0; i < 30000 / 4 && !effect_error && !effect_stop; ++i) {
+      cpu_tick();
 
-      while (!effect_stop) {
-        CPU.PC.hl = nsf_play_adr;
-        CPU.jam = false;
-        CPU.S = 0xff;
-        change = false;
+      if (jam)
+        break;
+    }
 
-        for (i = 0; i < 30000 / 4 && !effect_error && !effect_stop; ++i) {
-          cpu_tick();
+    if (!change)
+      ++wait_;
 
-          if (CPU.jam)
-            break;
-        }
+    ++duration;
 
-        if (!change)
-          ++wait_;
+    if (duration > 10 * 60) {
+      log_printf("\nError: effect is too long, Cxx at end of the effect "
+                 "may be missing.");
+      effect_error = 1;
+      return;
+    }
+  }
 
-        ++duration;
+  if (!volume_all_zero) // if a channel is still active, record its duration
+  {
+    if (wait_ > 0)
+      effect_flush_wait();
+  } else // if there is no active channels, trim effect to the point just
+         // before last volume has been set to zero
+  {
+    effect_ptr = effect_last_zero_volume_ptr;
+  }
 
-        if (duration > 10 * 60) {
-          printf("\nError: effect is too long, Cxx at end of the effect may be "
-                 "missing.");
-          effect_error = 1;
-          return;
-        }
-      }
+  effect_add(0); // end
 
-      if (!volume_all_zero) // if a channel is still active, record its duration
-      {
-        if (wait_ > 0)
-          effect_flush_wait();
-      } else // if there is no active channels, trim effect to the point just
-             // before last volume has been set to zero
-      {
-        effect_ptr = effect_last_zero_volume_ptr;
-      }
+  log_printf("\t%s\t%i", !mode ? "NTSC" : "PAL", effect_ptr);
 
-      effect_add(0); // end
+  if (effect_ptr > 256) {
+    log_printf(
+        "\nError: effect data is too long, should be 256 bytes max.\n");
+    effect_error = 1;
+  }
 
-      printf("\t%s\t%i", !mode ? "NTSC" : "PAL", effect_ptr);
+  if (effect_error)
+    return;
 
-      if (effect_ptr > 256) {
-        printf("\nError: effect data is too long, should be 256 bytes max.\n");
-        effect_error = 1;
-      }
+  col = 0;
+
+  for (i = 0; i < effect_ptr; ++i) {
+    if (!col)
+      out_printf("\t%s ", DB);
+
+    out_printf("$%2.2x", effect_data[i]);
 
-      if (effect_error)
-        return;
+    ++col;
 
+    if (col == 16 || i == effect_ptr - 1) {
+      out_printf("\n");
       col = 0;
+    } else {
+      out_printf(",");
+    }
+  }
 
-      for (i = 0; i < effect_ptr; ++i) {
-        if (!col)
-          fprintf(out_file, "\t%s ", DB);
+  result->size = effect_ptr;
+}
 
-        fprintf(out_file, "$%2.2x", effect_data[i]);
+// Convert the effects across a pool of threads, then print and emit their
+// results in order, stopping at the first error as if converted one by one.
+int convert_effects(void) {
+  std::vector<EffectResult> results(nsf_songs * 2);
+  std::atomic<int> next(0);
 
-        ++col;
+  auto worker = [&]() {
+    for (int i; (i = next++) < nsf_songs * 2;) {
+      int song = i / 2, mode = i % 2;
+      if (!mode && !ntsc)
+        continue;
+      if (mode && !pal)
+        continue;
 
-        if (col == 16 || i == effect_ptr - 1) {
-          fprintf(out_file, "\n");
-          col = 0;
-        } else {
-          fprintf(out_file, ",");
-        }
-      }
+      result = &results[i];
+      convert_effect(song, mode);
+      result->error = effect_error;
+    }
+  };
+
+  unsigned count = std::max(1U, std::thread::hardware_concurrency());
+  count = std::min<unsigned>(count, nsf_songs * 2);
+  std::vector<std::thread> threads;
+  for (unsigned i = 1; i < count; ++i)
+    threads.emplace_back(worker);
+  worker();
+  for (auto &thread : threads)
+    thread.join();
+
+  for (int song = 0; song < nsf_songs; ++song) {
+    printf("Effect %i", song);
 
-      out_size += effect_ptr;
+    for (int mode = 0; mode < 2; ++mode) {
+      if (!mode && !ntsc)
+        continue;
+      if (mode && !pal)
+        continue;
+
+      const EffectResult &r = results[song * 2 + mode];
+      fputs(r.log.c_str(), stdout);
+      fputs(r.out.c_str(), out_file);
+
+      if (r.error)
+        return r.error;
+
+      out_size += r.size;
     }
 
     printf("\n");
   }
+
+  return 0;
 }
 
 int main(int argc, char *argv[]) {
@@ -471,13 +595,13 @@ int main(int argc, char *argv[]) {
 
   fprintf(out_file, "\n");
 
-  convert_effects();
+  int error = convert_effects();
 
   fclose(out_file);
   free(nsf_data);
 
-  if (effect_error)
-    return effect_error;
+  if (error)
+    return error;
 
   printf("\nTotal data size %i bytes\n", out_size);
 
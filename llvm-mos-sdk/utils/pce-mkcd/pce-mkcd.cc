@@ -8,13 +8,14 @@
  */
 
 #include <algorithm>
-#include <cassert>
+#include <atomic>
 #include <cctype>
 #include <cstdarg>
 #include <cstddef>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <filesystem>
 #include <fstream>
 #include <functional>
 #include <ios>
@@ -23,6 +24,7 @@
 #include <optional>
 #include <regex>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "../common/elf-mos.h"
@@ -38,12 +40,14 @@
 #define P_ARG_ISO_OFFSET 128
 #define P_ARG_ISO_NO_PAD_END 129
 #define P_ARG_IPL 130
+#define P_ARG_JOBS 131
 
 static struct parg_option long_options[] = {
     {"help", PARG_NOARG, 0, P_ARG_HELP},
     {"ipl", PARG_REQARG, 0, P_ARG_IPL},
     {"iso-no-pad-end", PARG_NOARG, 0, P_ARG_ISO_NO_PAD_END},
     {"iso-offset", PARG_REQARG, 0, P_ARG_ISO_OFFSET},
+    {"jobs", PARG_REQARG, 0, P_ARG_JOBS},
     {"quiet", PARG_NOARG, 0, P_ARG_QUIET},
     {"verbose", PARG_NOARG, 0, P_ARG_VERBOSE},
     {0, 0, 0, 0}};
@@ -54,11 +58,13 @@ static const char *long_option_descriptions[] = {
     "Specify the path to the ipl.bin file (first CD sector).",
     "Disable ISO padding mandated by the CD-ROM specification.",
     "Offset at the beginning of the ISO, in sectors.",
+    "Number of files to write at once (default: one per processor).",
     "Disable progress messages.",
     "Enable more verbose messages."};
 
 uint32_t iso_offset_sectors = 0;
 bool iso_pad = true;
+unsigned jobs = 0;
 typedef enum {
   VERBOSITY_QUIET = 0,
   VERBOSITY_INFO = 1,
@@ -142,18 +148,13 @@ static const char ipl_copyright[] =
 
 // Disc building code.
 
+// Files are copied onto the disc this many bytes at a time.
+#define COPY_BUFFER_SIZE (1024 * 1024)
+
 static uint32_t bytes_to_sectors(uint32_t bytes) {
   return (bytes + SECTOR_SIZE - 1) / SECTOR_SIZE;
 }
 
-static void pad_stream_to_sector(std::ofstream &out, uint32_t bytes) {
-  uint32_t pad = (SECTOR_SIZE - (bytes % SECTOR_SIZE));
-  if (pad == SECTOR_SIZE)
-    return;
-  while (pad--)
-    out << (uint8_t)0;
-}
-
 class Disc;
 
 class DiscEntry {
@@ -164,7 +165,10 @@ public:
   uint32_t offset(void) const { return _offset; }
   void offset(uint32_t value) { _offset = value; }
 
-  virtual void write(Disc &disc, std::ofstream &out) = 0;
+  // Write the entry at its offset. The image is zero-filled to its full size
+  // beforehand, so padding need not be written. Entries are written in
+  // parallel, each through its own stream.
+  virtual void write(Disc &disc, std::fstream &out) = 0;
   virtual uint32_t sectors(void) const = 0;
   virtual uint8_t bank_start(void) { return 0; }
   virtual uint8_t bank_end(void) { return 0; }
@@ -211,12 +215,7 @@ public:
 
   virtual bool hidden(void) { return true; }
 
-  virtual void write(Disc &disc, std::ofstream &out) {
-    char buffer[SECTOR_SIZE] = {0};
-    for (auto i = 0; i < _sectors; i++) {
-      out.write(buffer, SECTOR_SIZE);
-    }
-  }
+  virtual void write(Disc &disc, std::fstream &out) {}
 
   virtual uint32_t sectors(void) const { return _sectors; }
 
@@ -264,15 +263,57 @@ public:
     }
   }
 
-  void write(std::ofstream &out) {
+  void write(const std::string &path) {
     for (auto ent : _entries) {
       if (!ent->hidden()) {
         log(VERBOSITY_INFO, "Writing \"%s\" (%s%s) to ISO @ sector %d, size %d",
             ent->name().c_str(), cd_symbol_prefix, ent->symbol_name().c_str(),
             ent->offset(), ent->sectors());
       }
-      out.seekp(ent->offset() * SECTOR_SIZE, std::ios::beg);
-      ent->write(*this, out);
+    }
+
+    // The layout is final, so size the image up front; the gaps between and
+    // after entries are then already zero.
+    {
+      std::ofstream create(path, std::ios_base::binary | std::ios_base::trunc);
+      if (!create.good()) {
+        error(1, "Error opening \"%s\" for writing.", path.c_str());
+      }
+    }
+    std::error_code ec;
+    std::filesystem::resize_file(path, (uintmax_t)size() * SECTOR_SIZE, ec);
+    if (ec) {
+      error(1, "Error resizing \"%s\": %s", path.c_str(),
+            ec.message().c_str());
+    }
+
+    // Entries don't overlap, so each worker writes through its own stream.
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+      std::fstream out(path, std::ios_base::binary | std::ios_base::in |
+                                 std::ios_base::out);
+      if (!out.good()) {
+        error(1, "Error opening \"%s\" for writing.", path.c_str());
+      }
+      for (size_t i; (i = next++) < _entries.size();) {
+        auto ent = _entries[i];
+        out.seekp((std::streamoff)ent->offset() * SECTOR_SIZE, std::ios::beg);
+        ent->write(*this, out);
+      }
+      out.close();
+      if (out.fail()) {
+        error(1, "Error writing \"%s\".", path.c_str());
+      }
+    };
+    unsigned count = jobs ? jobs : std::thread::hardware_concurrency();
+    count = std::max(1U, std::min<unsigned>(count, _entries.size()));
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < count; i++) {
+      threads.emplace_back(worker);
+    }
+    worker();
+    for (auto &thread : threads) {
+      thread.join();
     }
     log(VERBOSITY_INFO, "Finished writing ISO, size %d", size());
   }
@@ -292,9 +333,8 @@ public:
   ArrayDiscEntry(std::string name, std::vector<char> data)
       : DiscEntry(name), _data(data) {}
 
-  virtual void write(Disc &disc, std::ofstream &out) {
+  virtual void write(Disc &disc, std::fstream &out) {
     out.write(&_data[0], _data.size());
-    pad_stream_to_sector(out, _data.size());
   }
 
   virtual uint32_t sectors(void) const {
@@ -308,30 +348,34 @@ private:
 class FileDiscEntry : public DiscEntry {
 public:
   FileDiscEntry(std::string name) : DiscEntry(name) {
-    _stream = std::ifstream(name, std::fstream::binary);
-    _stream.seekg(0, std::ios::end);
-    _length = _stream.tellg();
+    std::error_code ec;
+    _length = std::filesystem::file_size(name, ec);
+    if (ec) {
+      error(1, "Could not open \"%s\": %s", name.c_str(),
+            ec.message().c_str());
+    }
   }
 
-  virtual void write(Disc &disc, std::ofstream &out) {
-    char buffer[SECTOR_SIZE];
-    uint32_t sectors_written = 0;
-
-    _stream.seekg(0, std::ios::beg);
-    do {
-      _stream.read(buffer, SECTOR_SIZE);
-      memset(buffer + _stream.gcount(), 0, SECTOR_SIZE - _stream.gcount());
-      out.write(buffer, SECTOR_SIZE);
-      sectors_written++;
-    } while (_stream.gcount() > 0);
-
-    assert(sectors_written == sectors());
+  virtual void write(Disc &disc, std::fstream &out) {
+    // Opened only now, so that a large project doesn't hold every file open.
+    std::ifstream stream(name(), std::fstream::binary);
+    std::vector<char> buffer(std::min<uint32_t>(_length, COPY_BUFFER_SIZE));
+    uint32_t left = _length;
+
+    while (left > 0) {
+      uint32_t chunk = std::min<uint32_t>(left, buffer.size());
+      stream.read(&buffer[0], chunk);
+      if (stream.gcount() != chunk) {
+        error(1, "Error reading \"%s\".", name().c_str());
+      }
+      out.write(&buffer[0], chunk);
+      left -= chunk;
+    }
   }
 
   virtual uint32_t sectors(void) const { return bytes_to_sectors(_length); }
 
 private:
-  std::ifstream _stream;
   uint32_t _length;
 };
 
@@ -427,10 +471,10 @@ public:
     }
   }
 
-  virtual void write(Disc &disc, std::ofstream &out) override {
+  virtual void write(Disc &disc, std::fstream &out) override {
     std::vector<char> data(sectors() * SECTOR_SIZE);
     uint8_t mpr_mapping[5] = {0, 1, 2, 3, 4};
-    size_t start = out.tellp();
+    std::streamoff start = out.tellp();
 
     memset(&data[0], 0, data.size());
 
@@ -780,6 +824,9 @@ int main(int argc, char **argv) {
     case P_ARG_ISO_OFFSET:
       iso_offset_sectors = atoi(ps.optarg);
       break;
+    case P_ARG_JOBS:
+      jobs = atoi(ps.optarg);
+      break;
     case P_ARG_QUIET:
       verbosity = VERBOSITY_QUIET;
       break;
@@ -820,11 +867,7 @@ int main(int argc, char **argv) {
 
   disc.finalize();
 
-  std::ofstream outf(argv[optend], std::ios_base::binary);
-  if (!outf.good()) {
-    error(1, "Error opening \"%s\" for writing.", argv[1]);
-  }
-  disc.write(outf);
+  disc.write(argv[optend]);
 
   return 0;
 }
@@ -102,11 +102,20 @@ information.
  * uint64_t clockticks6502                           *
  *   - A running total of the emulated cycle count.  *
  *                                                   *
- * uint32_t instructions                             *
+ * uint64_t instructions                             *
  *   - A running total of the total emulated         *
  *     instruction count. This is not related to     *
  *     clock cycle timing.                           *
  *                                                   *
+ * uint64_t penaltyticks6502                         *
+ *   - A running total of the cycles added for page  *
+ *     crossings, by indexed addressing and by       *
+ *     branches, included in clockticks6502.         *
+ *                                                   *
+ *****************************************************
+ * Built with FAKE6502_INSTANCE, all of the above    *
+ * lives in a struct cpu6502 instead and the API is  *
+ * the cpu6502_*() calls in fake6502.h.              *
  *****************************************************/
 
 #include <stdio.h>
@@ -132,19 +141,58 @@ information.
 
 #define BASE_STACK     0x100
 
+#ifdef FAKE6502_INSTANCE
+#include "fake6502.h"
+
+//the CPU the calling thread is running; set by the cpu6502_*() calls, and
+//reached through the names the rest of the core uses for the globals
+static _Thread_local cpu6502 *fake6502_self;
+#define pc (fake6502_self->pc)
+#define sp (fake6502_self->sp)
+#define a (fake6502_self->a)
+#define x (fake6502_self->x)
+#define y (fake6502_self->y)
+#define status (fake6502_self->status)
+#define instructions (fake6502_self->instructions)
+#define penaltyticks6502 (fake6502_self->penaltyticks6502)
+#define clockticks6502 (fake6502_self->clockticks6502)
+#define clockgoal6502 (fake6502_self->clockgoal6502)
+#define oldpc (fake6502_self->oldpc)
+#define ea (fake6502_self->ea)
+#define reladdr (fake6502_self->reladdr)
+#define value (fake6502_self->value)
+#define result (fake6502_self->result)
+#define opcode (fake6502_self->opcode)
+#define oldstatus (fake6502_self->oldstatus)
+#define penaltyop (fake6502_self->penaltyop)
+#define penaltyaddr (fake6502_self->penaltyaddr)
+#define addrtable (fake6502_self->addrtable)
+#define optable (fake6502_self->optable)
+#define ticktable (fake6502_self->ticktable)
+#define read6502(address) (fake6502_self->read(fake6502_self, (address)))
+#define write6502(address, val) (fake6502_self->write(fake6502_self, (address), (val)))
+#define FAKE6502_HOOK() if (fake6502_self->hook) fake6502_self->hook(fake6502_self)
+//the legacy entry points only make sense inside a cpu6502_*() call
+#define FAKE6502_API static
+#else
+#define FAKE6502_HOOK() if (callexternal) (*loopexternal)()
+#define FAKE6502_API
+
 //6502 CPU registers
 uint16_t pc;
 uint8_t sp, a, x, y, status;
 
 
 //helper variables
-uint32_t instructions = 0; //keep track of total instructions executed
+uint64_t instructions = 0; //keep track of total instructions executed
+uint64_t penaltyticks6502 = 0; //page crossing cycles, included in clockticks6502
 uint64_t clockticks6502 = 0, clockgoal6502 = 0;
 uint16_t oldpc, ea, reladdr, value, result;
 uint8_t opcode, oldstatus;
+#endif
 
-static inline void saveaccum(uint16_t result) {
-  a = (uint8_t)(result & 0x00FF);
+static inline void saveaccum(uint16_t n) {
+  a = (uint8_t)(n & 0x00FF);
 }
 
 //flag modifier functions
@@ -162,65 +210,69 @@ static inline void setsign(void) { status |= FLAG_SIGN; }
 static inline void clearsign(void) { status &= ~FLAG_SIGN; }
 
 //flag calculation functions
-static inline void zerocalc(uint16_t result) {
-  if (result & 0x00FF)
+static inline void zerocalc(uint16_t n) {
+  if (n & 0x00FF)
     clearzero();
   else
     setzero();
 }
 
-static inline void signcalc(uint16_t result) {
-  if (result & 0x0080)
+static inline void signcalc(uint16_t n) {
+  if (n & 0x0080)
     setsign();
   else
     clearsign();
 }
 
-static inline void carrycalc(uint16_t result) {
-  if (result & 0xFF00)
+static inline void carrycalc(uint16_t n) {
+  if (n & 0xFF00)
     setcarry();
   else
     clearcarry();
 }
 
-static inline void overflowcalc(uint16_t result, uint16_t memory) {
-  if ((result ^ (uint16_t)a) & (result ^ memory) & 0x0080)
+static inline void overflowcalc(uint16_t n, uint16_t memory) {
+  if ((n ^ (uint16_t)a) & (n ^ memory) & 0x0080)
     setoverflow();
   else
     clearoverflow();
 }
 
+#ifndef FAKE6502_INSTANCE
 //externally supplied functions
 extern uint8_t read6502(uint16_t address);
 extern void write6502(uint16_t address, uint8_t value);
+#endif
 
 //a few general functions used by various other functions
-void push16(uint16_t pushval) {
+FAKE6502_API void push16(uint16_t pushval) {
     write6502(BASE_STACK + sp, (pushval >> 8) & 0xFF);
     write6502(BASE_STACK + ((sp - 1) & 0xFF), pushval & 0xFF);
     sp -= 2;
 }
 
-void push8(uint8_t pushval) {
+FAKE6502_API void push8(uint8_t pushval) {
     write6502(BASE_STACK + sp--, pushval);
 }
 
-uint16_t pull16() {
+FAKE6502_API uint16_t pull16() {
     uint16_t temp16;
     temp16 = read6502(BASE_STACK + ((sp + 1) & 0xFF)) | ((uint16_t)read6502(BASE_STACK + ((sp + 2) & 0xFF)) << 8);
     sp += 2;
     return(temp16);
 }
 
-uint8_t pull8() {
+FAKE6502_API uint8_t pull8() {
     return (read6502(BASE_STACK + ++sp));
 }
 
 
+#ifndef FAKE6502_INSTANCE
 static void (**addrtable)() = NULL;
 static void (**optable)() = NULL;
 static const uint32_t *ticktable = NULL;
 uint8_t penaltyop, penaltyaddr;
+#endif
 
 //addressing mode functions, calculates effective addresses
 static void imp() { //implied
@@ -384,7 +436,7 @@ static void bcc() {
     if ((status & FLAG_CARRY) == 0) {
         oldpc = pc;
         pc += reladdr;
-        if ((oldpc & 0xFF00) != (pc & 0xFF00)) clockticks6502 += 2; //check if jump crossed a page boundary
+        if ((oldpc & 0xFF00) != (pc & 0xFF00)) { clockticks6502 += 2; penaltyticks6502++; } //check if jump crossed a page boundary
             else clockticks6502++;
     }
 }
@@ -393,7 +445,7 @@ static void bcs() {
     if ((status & FLAG_CARRY) == FLAG_CARRY) {
         oldpc = pc;
         pc += reladdr;
-        if ((oldpc & 0xFF00) != (pc & 0xFF00)) clockticks6502 += 2; //check if jump crossed a page boundary
+        if ((oldpc & 0xFF00) != (pc & 0xFF00)) { clockticks6502 += 2; penaltyticks6502++; } //check if jump crossed a page boundary
             else clockticks6502++;
     }
 }
@@ -402,7 +454,7 @@ static void beq() {
     if ((status & FLAG_ZERO) == FLAG_ZERO) {
         oldpc = pc;
         pc += reladdr;
-        if ((oldpc & 0xFF00) != (pc & 0xFF00)) clockticks6502 += 2; //check if jump crossed a page boundary
+        if ((oldpc & 0xFF00) != (pc & 0xFF00)) { clockticks6502 += 2; penaltyticks6502++; } //check if jump crossed a page boundary
             else clockticks6502++;
     }
 }
@@ -410,7 +462,7 @@ static void beq() {
 static void bra() {
     oldpc = pc;
     pc += reladdr;
-    if ((oldpc & 0xFF00) != (pc & 0xFF00)) clockticks6502 += 1; //check if jump crossed a page boundary
+    if ((oldpc & 0xFF00) != (pc & 0xFF00)) { clockticks6502 += 1; penaltyticks6502++; } //check if jump crossed a page boundary
 }
 
 static void bit() {
@@ -427,7 +479,7 @@ static void bmi() {
     if ((status & FLAG_SIGN) == FLAG_SIGN) {
         oldpc = pc;
         pc += reladdr;
-        if ((oldpc & 0xFF00) != (pc & 0xFF00)) clockticks6502 += 2; //check if jump crossed a page boundary
+        if ((oldpc & 0xFF00) != (pc & 0xFF00)) { clockticks6502 += 2; penaltyticks6502++; } //check if jump crossed a page boundary
             else clockticks6502++;
     }
 }
@@ -436,7 +488,7 @@ static void bne() {
     if ((status & FLAG_ZERO) == 0) {
         oldpc = pc;
         pc += reladdr;
-        if ((oldpc & 0xFF00) != (pc & 0xFF00)) clockticks6502 += 2; //check if jump crossed a page boundary
+        if ((oldpc & 0xFF00) != (pc & 0xFF00)) { clockticks6502 += 2; penaltyticks6502++; } //check if jump crossed a page boundary
             else clockticks6502++;
     }
 }
@@ -445,7 +497,7 @@ static void bpl() {
     if ((status & FLAG_SIGN) == 0) {
         oldpc = pc;
         pc += reladdr;
-        if ((oldpc & 0xFF00) != (pc & 0xFF00)) clockticks6502 += 2; //check if jump crossed a page boundary
+        if ((oldpc & 0xFF00) != (pc & 0xFF00)) { clockticks6502 += 2; penaltyticks6502++; } //check if jump crossed a page boundary
             else clockticks6502++;
     }
 }
@@ -462,7 +514,7 @@ static void bvc() {
     if ((status & FLAG_OVERFLOW) == 0) {
         oldpc = pc;
         pc += reladdr;
-        if ((oldpc & 0xFF00) != (pc & 0xFF00)) clockticks6502 += 2; //check if jump crossed a page boundary
+        if ((oldpc & 0xFF00) != (pc & 0xFF00)) { clockticks6502 += 2; penaltyticks6502++; } //check if jump crossed a page boundary
             else clockticks6502++;
     }
 }
@@ -471,7 +523,7 @@ static void bvs() {
     if ((status & FLAG_OVERFLOW) == FLAG_OVERFLOW) {
         oldpc = pc;
         pc += reladdr;
-        if ((oldpc & 0xFF00) != (pc & 0xFF00)) clockticks6502 += 2; //check if jump crossed a page boundary
+        if ((oldpc & 0xFF00) != (pc & 0xFF00)) { clockticks6502 += 2; penaltyticks6502++; } //check if jump crossed a page boundary
             else clockticks6502++;
     }
 }
@@ -841,8 +893,10 @@ static void bbr##idx() {                                                       \
     if ((value & (1 << (idx))) == 0) {                                         \
         oldpc = pc;                                                            \
         pc += reladdr;                                                         \
-        if ((oldpc & 0xFF00) != (pc & 0xFF00)) clockticks6502 += 2;            \
-            else clockticks6502++;                                             \
+        if ((oldpc & 0xFF00) != (pc & 0xFF00)) {                               \
+            clockticks6502 += 2;                                               \
+            penaltyticks6502++;                                                \
+        } else clockticks6502++;                                               \
     }                                                                          \
 }
 DEF_BBR(0)
@@ -860,8 +914,10 @@ static void bbs##idx() {                                                       \
     if ((value & (1 << (idx))) != 0) {                                         \
         oldpc = pc;                                                            \
         pc += reladdr;                                                         \
-        if ((oldpc & 0xFF00) != (pc & 0xFF00)) clockticks6502 += 2;            \
-            else clockticks6502++;                                             \
+        if ((oldpc & 0xFF00) != (pc & 0xFF00)) {                               \
+            clockticks6502 += 2;                                               \
+            penaltyticks6502++;                                                \
+        } else clockticks6502++;                                               \
     }                                                                          \
 }
 DEF_BBS(0)
@@ -918,43 +974,43 @@ static void stp() {}
         sta();
         stx();
         putvalue(a & x);
-        if (penaltyop && penaltyaddr) clockticks6502--;
+        if (penaltyop && penaltyaddr) { clockticks6502--; penaltyticks6502--; }
     }
 
     static void dcp() {
         dec();
         cmp();
-        if (penaltyop && penaltyaddr) clockticks6502--;
+        if (penaltyop && penaltyaddr) { clockticks6502--; penaltyticks6502--; }
     }
 
     static void isb() {
         inc();
         sbc();
-        if (penaltyop && penaltyaddr) clockticks6502--;
+        if (penaltyop && penaltyaddr) { clockticks6502--; penaltyticks6502--; }
     }
 
     static void slo() {
         asl();
         ora();
-        if (penaltyop && penaltyaddr) clockticks6502--;
+        if (penaltyop && penaltyaddr) { clockticks6502--; penaltyticks6502--; }
     }
 
     static void rla() {
         rol();
         and();
-        if (penaltyop && penaltyaddr) clockticks6502--;
+        if (penaltyop && penaltyaddr) { clockticks6502--; penaltyticks6502--; }
     }
 
     static void sre() {
         lsr();
         eor();
-        if (penaltyop && penaltyaddr) clockticks6502--;
+        if (penaltyop && penaltyaddr) { clockticks6502--; penaltyticks6502--; }
     }
 
     static void rra() {
         ror();
         adc();
-        if (penaltyop && penaltyaddr) clockticks6502--;
+        if (penaltyop && penaltyaddr) { clockticks6502--; penaltyticks6502--; }
     }
 #else
     #define lax nop
@@ -1088,24 +1144,26 @@ static const uint32_t ticktable_cmos[256] = {
 /* F */      2,    5,    5,    1,    4,    4,    6,    5,    2,    4,    4,    1,    4,    4,    7,    5   /* F */
 };
 
-void nmi6502() {
+FAKE6502_API void nmi6502() {
     push16(pc);
     push8(status);
     status |= FLAG_INTERRUPT;
     pc = (uint16_t)read6502(0xFFFA) | ((uint16_t)read6502(0xFFFB) << 8);
 }
 
-void irq6502() {
+FAKE6502_API void irq6502() {
     push16(pc);
     push8(status);
     status |= FLAG_INTERRUPT;
     pc = (uint16_t)read6502(0xFFFE) | ((uint16_t)read6502(0xFFFF) << 8);
 }
 
+#ifndef FAKE6502_INSTANCE
 uint8_t callexternal = 0;
 void (*loopexternal)();
+#endif
 
-void exec6502(uint32_t tickcount) {
+FAKE6502_API void exec6502(uint32_t tickcount) {
     clockgoal6502 += tickcount;
 
     while (clockticks6502 < clockgoal6502) {
@@ -1118,16 +1176,16 @@ void exec6502(uint32_t tickcount) {
         (*addrtable[opcode])();
         (*optable[opcode])();
         clockticks6502 += ticktable[opcode];
-        if (penaltyop && penaltyaddr) clockticks6502++;
+        if (penaltyop && penaltyaddr) { clockticks6502++; penaltyticks6502++; }
 
         instructions++;
 
-        if (callexternal) (*loopexternal)();
+        FAKE6502_HOOK();
     }
 
 }
 
-void reset6502(uint8_t cmos) {
+FAKE6502_API void reset6502(uint8_t cmos) {
     if (cmos != 0) {
         addrtable = addrtable_cmos;
         optable = optable_cmos;
@@ -1146,7 +1204,7 @@ void reset6502(uint8_t cmos) {
     status |= FLAG_CONSTANT;
 }
 
-void step6502() {
+FAKE6502_API void step6502() {
     opcode = read6502(pc++);
     status |= FLAG_CONSTANT;
 
@@ -1156,17 +1214,65 @@ void step6502() {
     (*addrtable[opcode])();
     (*optable[opcode])();
     clockticks6502 += ticktable[opcode];
-    if (penaltyop && penaltyaddr) clockticks6502++;
+    if (penaltyop && penaltyaddr) { clockticks6502++; penaltyticks6502++; }
     clockgoal6502 = clockticks6502;
 
     instructions++;
 
-    if (callexternal) (*loopexternal)();
+    FAKE6502_HOOK();
 }
 
+#ifdef FAKE6502_INSTANCE
+void cpu6502_init(cpu6502 *cpu, cpu6502_read_fn read, cpu6502_write_fn write,
+                  void *user) {
+    static const cpu6502 zero;
+    *cpu = zero;
+    cpu->read = read;
+    cpu->write = write;
+    cpu->user = user;
+}
+
+//each call saves and restores fake6502_self, so a callback may drive another
+//cpu6502 and return to this one
+void cpu6502_reset(cpu6502 *cpu, uint8_t cmos) {
+    cpu6502 *saved = fake6502_self;
+    fake6502_self = cpu;
+    reset6502(cmos);
+    fake6502_self = saved;
+}
+
+void cpu6502_exec(cpu6502 *cpu, uint32_t tickcount) {
+    cpu6502 *saved = fake6502_self;
+    fake6502_self = cpu;
+    exec6502(tickcount);
+    fake6502_self = saved;
+}
+
+void cpu6502_step(cpu6502 *cpu) {
+    cpu6502 *saved = fake6502_self;
+    fake6502_self = cpu;
+    step6502();
+    fake6502_self = saved;
+}
+
+void cpu6502_irq(cpu6502 *cpu) {
+    cpu6502 *saved = fake6502_self;
+    fake6502_self = cpu;
+    irq6502();
+    fake6502_self = saved;
+}
+
+void cpu6502_nmi(cpu6502 *cpu) {
+    cpu6502 *saved = fake6502_self;
+    fake6502_self = cpu;
+    nmi6502();
+    fake6502_self = saved;
+}
+#else
 void hookexternal(void *funcptr) {
     if (funcptr != (void *)NULL) {
         loopexternal = funcptr;
         callexternal = 1;
     } else callexternal = 0;
 }
+#endif
@@ -0,0 +1,73 @@
+/*
+Copyright 2021 LLVM-MOS Project
+Licensed under the Apache License, Version 2.0 with LLVM Exceptions.
+See https://github.com/llvm-mos/llvm-mos-sdk/blob/main/LICENSE for license
+information.
+*/
+
+// Instance-based interface to the Fake6502 core, for fake6502.c built with
+// FAKE6502_INSTANCE (the fake6502 library target).
+//
+// Each cpu6502 carries its own registers and memory callbacks, so any
+// number of them can run in one process, each on whichever thread calls
+// into it.  mos-sim keeps using the global read6502()/write6502() API.
+//
+// The variant is chosen when the core is built: the fake6502 library runs
+// the NMOS 6502 or, by cpu6502_reset()'s cmos flag, the 65C02; the
+// fake6502-2a03 library is the NES's 2A03, an NMOS 6502 whose ADC and SBC
+// ignore the decimal flag.
+
+#ifndef FAKE6502_H
+#define FAKE6502_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct cpu6502 cpu6502;
+
+typedef uint8_t (*cpu6502_read_fn)(cpu6502 *cpu, uint16_t address);
+typedef void (*cpu6502_write_fn)(cpu6502 *cpu, uint16_t address, uint8_t value);
+
+struct cpu6502 {
+  // 6502 CPU registers
+  uint16_t pc;
+  uint8_t sp, a, x, y, status;
+
+  // Running totals, as the globals of the same names in the legacy build.
+  uint64_t instructions, penaltyticks6502;
+  uint64_t clockticks6502, clockgoal6502;
+
+  // Supplied by the embedder. hook, if set, runs after every instruction.
+  cpu6502_read_fn read;
+  cpu6502_write_fn write;
+  void (*hook)(cpu6502 *cpu);
+  void *user;
+
+  // Core scratch state; not for the embedder.
+  uint16_t oldpc, ea, reladdr, value, result;
+  uint8_t opcode, oldstatus, penaltyop, penaltyaddr;
+  void (**addrtable)(void);
+  void (**optable)(void);
+  const uint32_t *ticktable;
+};
+
+// Zero the state and install the callbacks. Call cpu6502_reset() next.
+void cpu6502_init(cpu6502 *cpu, cpu6502_read_fn read, cpu6502_write_fn write,
+                  void *user);
+
+// The legacy entry points, on one CPU. Each may be called from a callback
+// of another CPU.
+void cpu6502_reset(cpu6502 *cpu, uint8_t cmos);
+void cpu6502_exec(cpu6502 *cpu, uint32_t tickcount);
+void cpu6502_step(cpu6502 *cpu);
+void cpu6502_irq(cpu6502 *cpu);
+void cpu6502_nmi(cpu6502 *cpu);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FAKE6502_H
@@ -0,0 +1,142 @@
+#include "image.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../common/elf.h"
+#include "../common/elf-mos.h"
+
+uint8_t *imageReadFile(const char *filename, size_t *size) {
+  FILE *file = fopen(filename, "rb");
+  if (!file) {
+    fprintf(stderr, "Could not open '%s': ", filename);
+    perror(NULL);
+    return NULL;
+  }
+  fseek(file, 0, SEEK_END);
+  const long length = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  uint8_t *image = malloc(length > 0 ? length : 1);
+  if (!image || length < 0 ||
+      fread(image, 1, length, file) != (size_t)length) {
+    fprintf(stderr, "Error reading image file '%s': ", filename);
+    perror(NULL);
+    fclose(file);
+    free(image);
+    return NULL;
+  }
+  fclose(file);
+  *size = length;
+  return image;
+}
+
+static uint32_t readLE(const uint8_t *p, int size) {
+  uint32_t value = 0;
+  while (size--)
+    value = value << 8 | p[size];
+  return value;
+}
+
+bool imageIsElf(const uint8_t *image, size_t size) {
+  return size >= SELFMAG && image[EI_MAG0] == ELFMAG0 &&
+         image[EI_MAG1] == ELFMAG1 && image[EI_MAG2] == ELFMAG2 &&
+         image[EI_MAG3] == ELFMAG3;
+}
+
+bool imageLoadElf(uint8_t *memory, const uint8_t *elf, size_t size,
+                  const char *filename) {
+#define IN_FILE(offset, length)                                                \
+  ((uint64_t)(offset) + (uint64_t)(length) <= (uint64_t)size)
+
+  if (!IN_FILE(0, sizeof(Elf32_Ehdr)) || elf[EI_CLASS] != ELFCLASS32 ||
+      elf[EI_DATA] != ELFDATA2LSB ||
+      readLE(elf + ELF32_EHDR_MACHINE, 2) != EM_MOS) {
+    fprintf(stderr, "'%s' is not an llvm-mos ELF file.\n", filename);
+    return false;
+  }
+  const uint32_t phoff = readLE(elf + ELF32_EHDR_PHOFF, 4);
+  const uint32_t phnum = readLE(elf + ELF32_EHDR_PHNUM, 2);
+  const uint32_t phentsize = readLE(elf + ELF32_EHDR_PHENTSIZE, 2);
+  if (phentsize < ELF32_PHDR__SIZE || !IN_FILE(phoff, phnum * phentsize)) {
+    fprintf(stderr, "'%s' has a bad program header table.\n", filename);
+    return false;
+  }
+
+  bool resetVectorLoaded = false;
+  for (uint32_t i = 0; i < phnum; ++i) {
+    const uint8_t *phdr = elf + phoff + i * phentsize;
+    const uint32_t offset = readLE(phdr + ELF32_PHDR_OFFSET, 4);
+    const uint32_t address = readLE(phdr + ELF32_PHDR_PADDR, 4);
+    const uint32_t length = readLE(phdr + ELF32_PHDR_FILESZ, 4);
+    if (readLE(phdr + ELF32_PHDR_TYPE, 4) != PT_LOAD || !length)
+      continue;
+    if (!IN_FILE(offset, length) || address + (uint64_t)length > 65536) {
+      fprintf(stderr,
+              "Invalid segment in '%s': %" PRIu32 " bytes at address %" PRIu32
+              " don't fit the file or the 6502's address space.\n",
+              filename, length, address);
+      return false;
+    }
+    memcpy(&memory[address], elf + offset, length);
+    if (address <= 0xfffc && address + length >= 0xfffe)
+      resetVectorLoaded = true;
+  }
+#undef IN_FILE
+
+  // The sim platform's linker script adds the vectors to the image it writes,
+  // not to the ELF file.
+  if (!resetVectorLoaded) {
+    const uint32_t entry = readLE(elf + ELF32_EHDR_ENTRY, 4);
+    memory[0xfffc] = entry & 0xff;
+    memory[0xfffd] = entry >> 8 & 0xff;
+  }
+  return true;
+}
+
+bool imageLoadRom(uint8_t *memory, const uint8_t *image, size_t size,
+                  const char *filename) {
+  if (size > 65536) {
+    fprintf(stderr, "ROM image '%s' is larger than the address space.\n",
+            filename);
+    return false;
+  }
+  memcpy(&memory[65536 - size], image, size);
+  return true;
+}
+
+bool imageLoadBlocks(uint8_t *memory, const uint8_t *image, size_t size,
+                     const char *filename) {
+  size_t pos = 0;
+  while (pos < size) {
+    // Assumes host is little-endian.
+    if (size - pos < 4) {
+      fprintf(stderr, "Error reading image file '%s': ", filename);
+      fputs("expected block size, found EOF.", stderr);
+      return false;
+    }
+    const uint16_t address = readLE(image + pos, 2);
+    const uint16_t blockSize = readLE(image + pos + 2, 2);
+    pos += 4;
+
+    uint32_t lastAddress = address + blockSize - 1;
+    if (lastAddress >= 65536) {
+      fprintf(stderr,
+              "Invalid block: block of %d bytes at address %d would reach "
+              "location %d, which is out of bounds.\n",
+              blockSize, address, lastAddress);
+      return false;
+    }
+
+    if (size - pos < blockSize) {
+      fprintf(stderr, "Error reading image file '%s': ", filename);
+      fprintf(stderr, "expected %d byte block, found %zu bytes.", blockSize,
+              size - pos);
+      return false;
+    }
+    memcpy(&memory[address], image + pos, blockSize);
+    pos += blockSize;
+  }
+  return true;
+}
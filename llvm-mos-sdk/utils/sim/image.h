@@ -0,0 +1,33 @@
+// Program images for mos-sim and mos-bench, loaded into a 64 KiB memory.
+
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Read a whole file into a malloc'd buffer, setting *size. Prints an error
+// and returns NULL if it can't be read.
+uint8_t *imageReadFile(const char *filename, size_t *size);
+
+bool imageIsElf(const uint8_t *image, size_t size);
+
+// Copy the PT_LOAD segments of an llvm-mos ELF file to memory. Only the bytes
+// in the file are written; the rest of memory is left as it is. Unless a
+// segment sets the reset vector, it points at the entry point.
+bool imageLoadElf(uint8_t *memory, const uint8_t *elf, size_t size,
+                  const char *filename);
+
+// Copy a block image to memory: blocks of a 16-bit address, a 16-bit size and
+// that many bytes, both little-endian.
+bool imageLoadBlocks(uint8_t *memory, const uint8_t *image, size_t size,
+                     const char *filename);
+
+// Copy a raw ROM image to the top of memory, to end at $FFFF.
+bool imageLoadRom(uint8_t *memory, const uint8_t *image, size_t size,
+                  const char *filename);
+
+// Each of the loaders prints an error and returns false if the image is bad.
+
+#endif // IMAGE_H
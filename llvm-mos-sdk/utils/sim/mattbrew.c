@@ -0,0 +1,760 @@
+#include "mattbrew.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <io.h>
+#define open _open
+#define read _read
+#define close _close
+#else
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+// As mattbrew.h in the mattbrew platform.
+#define VIA_BASE 0xe000
+#define RPI_BASE 0xe040
+
+// VIA registers.
+enum {
+  kOrb,
+  kOra,
+  kDdrb,
+  kDdra,
+  kT1cl,
+  kT1ch,
+  kT1ll,
+  kT1lh,
+  kT2cl,
+  kT2ch,
+  kSr,
+  kAcr,
+  kPcr,
+  kIfr,
+  kIer,
+  kOraNoHandshake,
+};
+
+#define IFR_T2 0x20
+#define IFR_T1 0x40
+#define ACR_T1_CONTINUOUS 0x40
+
+// As bridge_defs.h in the bridge firmware.
+#define DEVICES 8
+#define READ_BLOCK 0x0e
+#define READ_ANY 0x0f
+static const uint8_t kBufferBits[DEVICES] = {8, 8, 12, 14, 14, 12, 10, 12};
+
+// How often an armed bridge IRQ looks for new input, in cycles.
+#define POLL_CYCLES 1024
+
+// A VIA timer counts down once a cycle from start, which it held at cycle
+// loaded. It underflows the cycle after it reads 0, reading $FFFF.
+typedef struct {
+  uint64_t loaded;
+  uint16_t start;
+  bool armed; // Interrupts at the next underflow.
+} Timer;
+
+static struct {
+  uint8_t orb, ora, ddrb, ddra, sr, acr, pcr, ifr, ier;
+  uint16_t t1Latch;
+  uint8_t t2Latch;
+  Timer t1, t2;
+} via;
+
+// A device's buffer of bytes for the 6502 to read, and what backs it.
+typedef struct {
+  uint8_t *data;
+  uint16_t size, head, tail, count;
+  bool attached;
+  int in;    // Reads come from this file descriptor, or -1.
+  FILE *out; // Writes go here, or nowhere if NULL.
+  bool echo; // Writes come back as reads.
+  bool zero; // Writes go to the Zero link, and its messages come back.
+} Device;
+
+static Device devices[DEVICES];
+
+// The 6502 side of bus_interface.c.
+typedef enum {
+  kIdle,
+  kGotDevice,
+  kReceiving,
+  kGotReadAny,
+  kGotReadBlock,
+  kGotBlockDevice,
+} BridgeState;
+
+static struct {
+  BridgeState state;
+  uint8_t device, length, received;
+  uint8_t message[255];
+
+  // The read command being answered.
+  bool pending;
+  uint8_t pendingDevice, pendingMask, pendingExact;
+  uint64_t readyAt;
+
+  uint8_t response[256];
+  uint16_t responseLength, responsePos;
+
+  uint8_t irqMask, readLimit;
+  uint8_t loopback[254];
+  int loopbackLength; // -1 when no loopback is pending.
+  bool resetRequested;
+  uint64_t nextPoll;
+} bridge;
+
+static uint32_t bridgeDelay = 8;
+
+static int zeroFd = -1;
+static const char *zeroName;
+// A message from the Zero, as received so far.
+static uint8_t zeroIn[2 + 255];
+static unsigned zeroInLength;
+
+//
+// VIA
+//
+
+// Process the underflows up to cycle.
+static void syncTimer(Timer *timer, uint64_t cycle, bool continuous,
+                      uint16_t latch, uint8_t flag) {
+  for (;;) {
+    const uint64_t underflow = timer->loaded + timer->start + 1;
+    if (underflow > cycle)
+      return;
+    if (timer->armed)
+      via.ifr |= flag;
+    // A continuous timer reloads from its latch; a one-shot counts on down.
+    timer->armed = continuous;
+    timer->loaded = underflow + 1;
+    timer->start = continuous ? latch : 0xfffe;
+  }
+}
+
+static void syncTimers(uint64_t cycle) {
+  syncTimer(&via.t1, cycle, via.acr & ACR_T1_CONTINUOUS, via.t1Latch, IFR_T1);
+  syncTimer(&via.t2, cycle, false, 0, IFR_T2);
+}
+
+static uint16_t timerValue(const Timer *timer, uint64_t cycle) {
+  if (cycle < timer->loaded)
+    return timer->start;
+  return timer->start - (uint16_t)(cycle - timer->loaded);
+}
+
+// Writing a timer's high byte loads it, on the next cycle.
+static void loadTimer(Timer *timer, uint16_t value, uint64_t cycle,
+                      uint8_t flag) {
+  timer->loaded = cycle + 1;
+  timer->start = value;
+  timer->armed = true;
+  via.ifr &= ~flag;
+}
+
+static uint8_t viaRead(uint8_t reg, uint64_t cycle) {
+  syncTimers(cycle);
+  switch (reg) {
+  case kOrb:
+    return via.orb & via.ddrb;
+  case kOra:
+  case kOraNoHandshake:
+    return via.ora & via.ddra;
+  case kDdrb:
+    return via.ddrb;
+  case kDdra:
+    return via.ddra;
+  case kT1cl:
+    via.ifr &= ~IFR_T1;
+    return timerValue(&via.t1, cycle) & 0xff;
+  case kT1ch:
+    return timerValue(&via.t1, cycle) >> 8;
+  case kT1ll:
+    return via.t1Latch & 0xff;
+  case kT1lh:
+    return via.t1Latch >> 8;
+  case kT2cl:
+    via.ifr &= ~IFR_T2;
+    return timerValue(&via.t2, cycle) & 0xff;
+  case kT2ch:
+    return timerValue(&via.t2, cycle) >> 8;
+  case kSr:
+    return via.sr;
+  case kAcr:
+    return via.acr;
+  case kPcr:
+    return via.pcr;
+  case kIfr:
+    return via.ifr | (via.ifr & via.ier ? 0x80 : 0);
+  default: // kIer
+    return via.ier | 0x80;
+  }
+}
+
+static void viaWrite(uint8_t reg, uint8_t value, uint64_t cycle) {
+  syncTimers(cycle);
+  switch (reg) {
+  case kOrb:
+    via.orb = value;
+    break;
+  case kOra:
+  case kOraNoHandshake:
+    via.ora = value;
+    break;
+  case kDdrb:
+    via.ddrb = value;
+    break;
+  case kDdra:
+    via.ddra = value;
+    break;
+  case kT1cl:
+  case kT1ll:
+    via.t1Latch = (via.t1Latch & 0xff00) | value;
+    break;
+  case kT1ch:
+    via.t1Latch = (via.t1Latch & 0xff) | value << 8;
+    loadTimer(&via.t1, via.t1Latch, cycle, IFR_T1);
+    break;
+  case kT1lh:
+    via.t1Latch = (via.t1Latch & 0xff) | value << 8;
+    via.ifr &= ~IFR_T1;
+    break;
+  case kT2cl:
+    via.t2Latch = value;
+    break;
+  case kT2ch:
+    loadTimer(&via.t2, value << 8 | via.t2Latch, cycle, IFR_T2);
+    break;
+  case kSr:
+    via.sr = value;
+    break;
+  case kAcr:
+    via.acr = value;
+    break;
+  case kPcr:
+    via.pcr = value;
+    break;
+  case kIfr:
+    via.ifr &= ~value;
+    break;
+  default: // kIer
+    if (value & 0x80)
+      via.ier |= value & 0x7f;
+    else
+      via.ier &= ~value;
+    break;
+  }
+}
+
+//
+// Devices
+//
+
+static uint16_t deviceSpace(const Device *device) {
+  return device->size - device->count;
+}
+
+static uint16_t devicePut(Device *device, const uint8_t *data, uint16_t len) {
+  if (len > deviceSpace(device))
+    len = deviceSpace(device);
+  for (uint16_t i = 0; i < len; ++i) {
+    device->data[device->head] = data[i];
+    device->head = (device->head + 1) & (device->size - 1);
+  }
+  device->count += len;
+  return len;
+}
+
+static uint16_t deviceTake(Device *device, uint8_t *data, uint16_t max) {
+  const uint16_t len = device->count < max ? device->count : max;
+  for (uint16_t i = 0; i < len; ++i) {
+    data[i] = device->data[device->tail];
+    device->tail = (device->tail + 1) & (device->size - 1);
+  }
+  device->count -= len;
+  return len;
+}
+
+static bool readable(int fd) {
+#ifdef _WIN32
+  (void)fd;
+  return true;
+#else
+  struct pollfd p = {.fd = fd, .events = POLLIN};
+  return poll(&p, 1, 0) > 0;
+#endif
+}
+
+static void zeroClosed(void) {
+  fprintf(stderr, "The Zero link '%s' closed.\n", zeroName);
+  close(zeroFd);
+  zeroFd = -1;
+}
+
+static void zeroSend(uint8_t device, const uint8_t *data, uint8_t len) {
+  if (zeroFd < 0)
+    return;
+  uint8_t message[2 + 255] = {device, len};
+  memcpy(message + 2, data, len);
+  size_t sent = 0;
+  while (sent < 2u + len) {
+#ifdef _WIN32
+    const long n = -1;
+#else
+    const ssize_t n = send(zeroFd, message + sent, 2 + len - sent, 0);
+#endif
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0) {
+      zeroClosed();
+      return;
+    }
+    sent += n;
+  }
+}
+
+// Take what the Zero has sent, for as long as its messages fit.
+static void zeroReceive(void) {
+  while (zeroFd >= 0) {
+    if (zeroInLength >= 2 && zeroInLength == 2u + zeroIn[1]) {
+      const uint8_t d = zeroIn[0];
+      if (d < DEVICES) {
+        if (deviceSpace(&devices[d]) < zeroIn[1])
+          return;
+        devicePut(&devices[d], zeroIn + 2, zeroIn[1]);
+      }
+      zeroInLength = 0;
+      continue;
+    }
+    if (!readable(zeroFd))
+      return;
+    const unsigned want = zeroInLength < 2 ? 2 : 2u + zeroIn[1];
+    const int n = read(zeroFd, zeroIn + zeroInLength, want - zeroInLength);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0) {
+      zeroClosed();
+      return;
+    }
+    zeroInLength += n;
+  }
+}
+
+static void pollInputs(void) {
+  for (int d = 0; d < DEVICES; ++d) {
+    Device *device = &devices[d];
+    while (device->in >= 0 && deviceSpace(device)) {
+      // A program reading the terminal has usually just prompted on it.
+      if (!device->count && device->out)
+        fflush(device->out);
+      if (!readable(device->in))
+        break;
+      uint8_t buf[256];
+      const uint16_t space = deviceSpace(device);
+      const int n = read(device->in, buf, space < sizeof(buf) ? space : sizeof(buf));
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0) {
+        if (device->in != 0)
+          close(device->in);
+        device->in = -1;
+        break;
+      }
+      devicePut(device, buf, n);
+    }
+  }
+  zeroReceive();
+}
+
+bool mattbrewAttach(int d, const char *spec) {
+  if (d < 2 || d >= DEVICES) {
+    fprintf(stderr, "Device %d is the bridge's own; only 2-7 can be "
+                    "attached.\n", d);
+    return false;
+  }
+  Device *device = &devices[d];
+  device->attached = true;
+  device->in = -1;
+
+  char *specs = strdup(spec);
+  bool ok = true;
+  for (char *s = strtok(specs, ","); s && ok; s = strtok(NULL, ",")) {
+    if (!strcmp(s, "stdio")) {
+      device->in = 0;
+      device->out = stdout;
+    } else if (!strcmp(s, "echo")) {
+      device->echo = true;
+    } else if (!strcmp(s, "zero")) {
+      device->zero = true;
+    } else if (!strcmp(s, "none")) {
+    } else if (!strncmp(s, "in:", 3)) {
+      device->in = open(s + 3, O_RDONLY);
+      if (device->in < 0) {
+        fprintf(stderr, "Could not open '%s': ", s + 3);
+        perror(NULL);
+        ok = false;
+      }
+    } else if (!strncmp(s, "out:", 4)) {
+      device->out = fopen(s + 4, "wb");
+      if (!device->out) {
+        fprintf(stderr, "Could not open '%s': ", s + 4);
+        perror(NULL);
+        ok = false;
+      }
+    } else {
+      fprintf(stderr, "Unknown device %d backing '%s'.\n", d, s);
+      ok = false;
+    }
+  }
+  free(specs);
+  return ok;
+}
+
+bool mattbrewConnectZero(const char *spec) {
+  zeroName = spec;
+#ifdef _WIN32
+  fputs("The Zero link needs POSIX sockets.\n", stderr);
+  return false;
+#else
+  if (!strncmp(spec, "unix:", 5)) {
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    if (strlen(spec + 5) >= sizeof(addr.sun_path)) {
+      fprintf(stderr, "Socket path '%s' is too long.\n", spec + 5);
+      return false;
+    }
+    strcpy(addr.sun_path, spec + 5);
+    zeroFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (zeroFd >= 0 &&
+        connect(zeroFd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+      close(zeroFd);
+      zeroFd = -1;
+    }
+  } else if (!strncmp(spec, "tcp:", 4)) {
+    char *host = strdup(spec + 4);
+    char *port = strrchr(host, ':');
+    if (!port) {
+      fprintf(stderr, "'%s' needs a port, as tcp:HOST:PORT.\n", spec);
+      free(host);
+      return false;
+    }
+    *port++ = '\0';
+    struct addrinfo hints = {.ai_socktype = SOCK_STREAM}, *addrs;
+    const int error = getaddrinfo(host, port, &hints, &addrs);
+    free(host);
+    if (error) {
+      fprintf(stderr, "Could not look up '%s': %s\n", spec,
+              gai_strerror(error));
+      return false;
+    }
+    for (struct addrinfo *a = addrs; a && zeroFd < 0; a = a->ai_next) {
+      zeroFd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+      if (zeroFd >= 0 && connect(zeroFd, a->ai_addr, a->ai_addrlen) < 0) {
+        close(zeroFd);
+        zeroFd = -1;
+      }
+    }
+    freeaddrinfo(addrs);
+  } else {
+    fprintf(stderr, "The Zero link '%s' is neither tcp:HOST:PORT nor "
+                    "unix:PATH.\n", spec);
+    return false;
+  }
+  if (zeroFd < 0) {
+    fprintf(stderr, "Could not connect to '%s': ", spec);
+    perror(NULL);
+    return false;
+  }
+  return true;
+#endif
+}
+
+void mattbrewSetBridgeDelay(uint32_t cycles) { bridgeDelay = cycles; }
+
+bool mattbrewInit(void) {
+  for (int d = 0; d < DEVICES; ++d) {
+    Device *device = &devices[d];
+    if (!device->attached) {
+      device->in = -1;
+      if (d == 2)
+        mattbrewAttach(d, "stdio");
+      else if (d == 7)
+        mattbrewAttach(d, "echo");
+      else if (d > 2)
+        device->zero = zeroFd >= 0;
+    }
+    if (device->zero && zeroFd < 0) {
+      fprintf(stderr, "Device %d is attached to the Zero, but there's no "
+                      "--zero link.\n", d);
+      return false;
+    }
+    device->size = 1u << kBufferBits[d];
+    device->data = malloc(device->size);
+    if (!device->data) {
+      fputs("Out of memory for the bridge buffers.\n", stderr);
+      return false;
+    }
+  }
+  mattbrewReset();
+  return true;
+}
+
+//
+// Bridge
+//
+
+// A device 0 read: the last loopback, or the status bytes.
+static uint8_t readStatus(uint8_t *data) {
+  if (bridge.loopbackLength >= 0) {
+    const uint8_t len = bridge.loopbackLength;
+    memcpy(data, bridge.loopback, len);
+    bridge.loopbackLength = -1;
+    return len;
+  }
+  data[0] = 0;
+  for (int d = 1; d < DEVICES; ++d)
+    if (devices[d].count)
+      data[0] |= 1 << d;
+  // The Zero side is always there.
+  data[1] = 1;
+  return 2;
+}
+
+static uint8_t readAny(uint8_t mask, uint8_t *data) {
+  uint16_t total = 0;
+  for (int d = 1; d < DEVICES; ++d) {
+    if (!(mask & 1 << d) || !devices[d].count)
+      continue;
+    if (total + 3 > bridge.readLimit)
+      break;
+    uint8_t *record = data + total;
+    record[0] = d;
+    record[1] = deviceTake(&devices[d], record + 2, bridge.readLimit - total - 2);
+    total += 2 + record[1];
+  }
+  return total;
+}
+
+// Answer the pending read, unless a read-block is still short.
+static bool respond(void) {
+  pollInputs();
+  uint8_t *data = bridge.response + 1;
+  uint8_t len;
+  if (bridge.pendingDevice == READ_ANY) {
+    len = readAny(bridge.pendingMask, data);
+  } else if (bridge.pendingDevice == 0) {
+    len = readStatus(data);
+  } else {
+    Device *device = &devices[bridge.pendingDevice];
+    if (device->count < bridge.pendingExact)
+      return false;
+    const uint8_t max =
+        bridge.pendingExact ? bridge.pendingExact : bridge.readLimit;
+    len = deviceTake(device, data, max);
+  }
+  bridge.response[0] = len;
+  bridge.responseLength = 1 + len;
+  bridge.responsePos = 0;
+  bridge.pending = false;
+  return true;
+}
+
+static void readCommand(uint8_t device, uint8_t mask, uint8_t exact,
+                        uint64_t cycle) {
+  bridge.pending = true;
+  bridge.pendingDevice = device;
+  bridge.pendingMask = mask;
+  bridge.pendingExact = exact;
+  bridge.readyAt = cycle + bridgeDelay;
+  bridge.state = kIdle;
+}
+
+static void dispatch(uint8_t d, const uint8_t *data, uint8_t len) {
+  if (d == 0) {
+    if (data[0] == 'T') {
+      bridge.loopbackLength = len - 1;
+      memcpy(bridge.loopback, data + 1, len - 1);
+    }
+    return;
+  }
+  if (d == 1) {
+    if (len >= 2 && data[0] == 'I') {
+      bridge.irqMask = data[1] & ~1u;
+      const uint8_t limit = len >= 3 ? data[2] : 0;
+      bridge.readLimit = !limit || limit > 254 ? 254 : limit;
+    } else if (len >= 2 && data[0] == 'C') {
+      // Cycles are cycles at any clock speed.
+    } else {
+      bridge.resetRequested = true;
+    }
+    return;
+  }
+  Device *device = &devices[d];
+  if (device->zero)
+    zeroSend(d, data, len);
+  if (device->out)
+    fwrite(data, 1, len, device->out);
+  if (device->echo)
+    devicePut(device, data, len);
+}
+
+static uint8_t bridgeRead(uint64_t cycle) {
+  if (bridge.responsePos < bridge.responseLength)
+    return bridge.response[bridge.responsePos++];
+  // Not ready yet, or the padding after a response.
+  if (!bridge.pending || cycle < bridge.readyAt || !respond())
+    return 0xff;
+  return bridge.response[bridge.responsePos++];
+}
+
+static void bridgeWrite(uint8_t value, uint64_t cycle) {
+  switch (bridge.state) {
+  case kIdle:
+    // Whatever is left of the last response is dropped.
+    bridge.responseLength = 0;
+    if (value == (0x80 | READ_ANY)) {
+      bridge.state = kGotReadAny;
+    } else if (value == (0x80 | READ_BLOCK)) {
+      bridge.state = kGotReadBlock;
+    } else if ((value & 0x7f) >= DEVICES) {
+      fprintf(stderr, "Bridge: invalid device %d (byte=0x%02x).\n",
+              value & 0x7f, value);
+    } else if (value & 0x80) {
+      readCommand(value & 0x7f, 0, 0, cycle);
+    } else {
+      bridge.device = value;
+      bridge.state = kGotDevice;
+    }
+    break;
+  case kGotDevice:
+    bridge.length = value;
+    bridge.received = 0;
+    bridge.state = value ? kReceiving : kIdle;
+    break;
+  case kReceiving:
+    bridge.message[bridge.received++] = value;
+    if (bridge.received == bridge.length) {
+      bridge.state = kIdle;
+      dispatch(bridge.device, bridge.message, bridge.length);
+    }
+    break;
+  case kGotReadAny:
+    readCommand(READ_ANY, value, 0, cycle);
+    break;
+  case kGotReadBlock:
+    bridge.device = value & 0x7f;
+    if (bridge.device >= DEVICES) {
+      fprintf(stderr, "Bridge: invalid read-block device %d.\n",
+              bridge.device);
+      bridge.state = kIdle;
+    } else {
+      bridge.state = kGotBlockDevice;
+    }
+    break;
+  case kGotBlockDevice:
+    readCommand(bridge.device, 0,
+                value > bridge.readLimit ? bridge.readLimit : value, cycle);
+    break;
+  }
+}
+
+static bool bridgeIrq(void) {
+  for (int d = 1; d < DEVICES; ++d)
+    if (bridge.irqMask & 1 << d && devices[d].count)
+      return true;
+  return false;
+}
+
+//
+// The machine
+//
+
+bool mattbrewDecodes(uint16_t address) {
+  return (address & 0xfff0) == VIA_BASE || address == RPI_BASE;
+}
+
+uint8_t mattbrewRead(uint16_t address, uint64_t cycle) {
+  if (address == RPI_BASE)
+    return bridgeRead(cycle);
+  return viaRead(address & 0xf, cycle);
+}
+
+void mattbrewWrite(uint16_t address, uint8_t value, uint64_t cycle) {
+  if (address == RPI_BASE)
+    bridgeWrite(value, cycle);
+  else
+    viaWrite(address & 0xf, value, cycle);
+}
+
+bool mattbrewQuietRead(uint16_t address, uint64_t cycle) {
+  if (address == RPI_BASE)
+    return bridge.responsePos >= bridge.responseLength &&
+           (!bridge.pending || cycle < bridge.readyAt);
+  // The counters move every cycle, and reading a low byte clears its flag.
+  switch (address & 0xf) {
+  case kT1cl:
+  case kT1ch:
+  case kT2cl:
+  case kT2ch:
+    return false;
+  default:
+    return true;
+  }
+}
+
+uint64_t mattbrewNextEvent(uint64_t cycle) {
+  syncTimers(cycle);
+  // Both timers, armed or not: even an unarmed underflow reloads one.
+  uint64_t next = via.t1.loaded + via.t1.start + 1;
+  const uint64_t t2 = via.t2.loaded + via.t2.start + 1;
+  if (t2 < next)
+    next = t2;
+  if (bridge.pending && bridge.readyAt > cycle && bridge.readyAt < next)
+    next = bridge.readyAt;
+  if (bridge.irqMask && bridge.nextPoll < next)
+    next = bridge.nextPoll;
+  return next;
+}
+
+MattbrewEvent mattbrewTick(uint64_t cycle) {
+  syncTimers(cycle);
+  if (bridge.resetRequested) {
+    // The Pico tells the Zero before it reboots.
+    zeroSend(1, (const uint8_t *)"R", 1);
+    return kMattbrewReset;
+  }
+  if (bridge.irqMask && cycle >= bridge.nextPoll) {
+    pollInputs();
+    bridge.nextPoll = cycle + POLL_CYCLES;
+  }
+  if (via.ifr & via.ier || bridgeIrq())
+    return kMattbrewIrq;
+  return kMattbrewRun;
+}
+
+void mattbrewReset(void) {
+  memset(&via, 0, sizeof(via));
+  // The timers run from reset, towards their first underflow.
+  via.t1.start = via.t2.start = 0xffff;
+
+  memset(&bridge, 0, sizeof(bridge));
+  bridge.readLimit = 254;
+  bridge.loopbackLength = -1;
+  for (int d = 0; d < DEVICES; ++d)
+    devices[d].head = devices[d].tail = devices[d].count = 0;
+}
+
+void mattbrewFinish(void) {
+  for (int d = 0; d < DEVICES; ++d)
+    if (devices[d].out)
+      fflush(devices[d].out);
+}
@@ -0,0 +1,84 @@
+// Mattbrew machine model for mos-sim (--machine mattbrew).
+//
+// A W65C22 VIA at $E000 and the Pico bridge port at $E040; the rest of the
+// address space is plain memory. The VIA's timers count CPU cycles and raise
+// its IRQ as the real ones do, so the systick interrupt and the profile clock
+// run as on hardware; its ports read back what was written to them, and 0 on
+// input pins. The bridge speaks the 6502 side of the protocol in protocol.md
+// (and bridge/bus_interface.c): writes, reads, read-any and read-block, device
+// 0 status and loopback, device 1's IRQ mask, read limit and soft reset, and
+// the level-triggered IRQ. Each read is answered only after a configurable
+// number of cycles, the bridge's response time, during which the port reads
+// 0xFF.
+//
+// Devices 2-7 are backed by host files and sockets, in place of the Zero.
+
+#ifndef MATTBREW_H
+#define MATTBREW_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// What the machine needs of the CPU after an instruction.
+typedef enum {
+  kMattbrewRun,   // Nothing.
+  kMattbrewIrq,   // The IRQ line is low.
+  kMattbrewReset, // A soft reset through device 1.
+} MattbrewEvent;
+
+// Back a device with spec, a comma-separated list of:
+//
+//   stdio     writes go to standard output, reads come from standard input
+//   in:PATH   reads come from the file (or fifo) at PATH
+//   out:PATH  writes go to the file at PATH
+//   echo      writes come back as reads
+//   zero      the Zero link (see mattbrewConnectZero)
+//   none      writes are dropped, reads are empty
+//
+// Prints an error and returns false if spec is bad or a file won't open.
+bool mattbrewAttach(int device, const char *spec);
+
+// Connect to a stand-in for the Zero at spec, tcp:HOST:PORT or unix:PATH, to
+// which devices 3-6 and any others attached to "zero" are routed. It speaks
+// the bridge's SPI framing, [device][length][data...] both ways: one message
+// per 6502 write, and the Zero's messages are buffered for the 6502 to read.
+// A soft reset sends device 1 ['R']. Prints an error and returns false if
+// the connection fails.
+bool mattbrewConnectZero(const char *spec);
+
+// Cycles from a read command to the first byte of its response (default 8).
+void mattbrewSetBridgeDelay(uint32_t cycles);
+
+// Attach the default devices: the terminal, 2, to stdio and 7 to echo,
+// unless attached already, and reset the machine. Call once the flags are
+// parsed. Prints an error and returns false if a device can't be backed.
+bool mattbrewInit(void);
+
+// True if address is a device register, handled by the calls below rather
+// than memory.
+bool mattbrewDecodes(uint16_t address);
+
+// Access a device register at the given cycle.
+uint8_t mattbrewRead(uint16_t address, uint64_t cycle);
+void mattbrewWrite(uint16_t address, uint8_t value, uint64_t cycle);
+
+// Run the devices up to cycle, after an instruction.
+MattbrewEvent mattbrewTick(uint64_t cycle);
+
+// True if reading a device register at cycle has no side effect, and it would
+// read the same at any cycle before mattbrewNextEvent.
+bool mattbrewQuietRead(uint16_t address, uint64_t cycle);
+
+// The first cycle after cycle at which the devices can change what the CPU
+// sees without it touching them: a timer underflow, the pending read's
+// response, or the next poll of the inputs for the IRQ. A loop that only
+// makes quiet reads sees nothing new until then, so it may be skipped to it.
+uint64_t mattbrewNextEvent(uint64_t cycle);
+
+// Reset the VIA and the bridge, as RESB does.
+void mattbrewReset(void);
+
+// Flush device output at exit.
+void mattbrewFinish(void);
+
+#endif // MATTBREW_H
@@ -0,0 +1,385 @@
+// Run sim platform images across a pool of threads, each on its own instance
+// of the fake6502 core, and check the cycles they took against a baseline.
+// Cycle counts don't depend on the host, so any change in one is a change in
+// the code it ran.
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#include "fake6502.h"
+#include "image.h"
+
+static const char usage[] =
+    "Usage: mos-bench [OPTIONS] <test>...\n"
+    "\n"
+    "Runs sim platform images, each on its own simulated 6502, across a pool\n"
+    "of threads, and reports the cycles each took to exit.\n"
+    "\n"
+    "A test is an image, block or ELF as mos-sim takes them, or\n"
+    "<image>,<input> to give it the file input on standard input ($FFF5).\n"
+    "Output ($FFF9) is dropped. A test passes if it exits with status 0.\n"
+    "\n"
+    "Results are printed in the order the tests were given, as \"<test>\n"
+    "<cycles>\" lines, followed with a baseline by its cycles and the change.\n"
+    "The exit status is 1 if any test failed or took more cycles than its\n"
+    "baseline allows.\n"
+    "\n"
+    "OPTIONS:\n"
+    "\t--jobs <n>: Run n tests at once (default: one per processor).\n"
+    "\t--baseline <file>: Compare against the \"<test> <cycles>\" lines of\n"
+    "\t                   file, as --write writes them.\n"
+    "\t--threshold <percent>: Allow tests this many percent more cycles\n"
+    "\t                       than the baseline (default: 0).\n"
+    "\t--write <file>: Write the cycles of the passing tests to file, as a\n"
+    "\t                new baseline.\n"
+    "\t--max-cycles <n>: Fail a test that hasn't exited after n cycles\n"
+    "\t                  (default: 10000000000).\n"
+    "\t--cmos: Enable 65C02 emulation.\n";
+
+typedef enum { kExited, kAborted, kTimedOut, kLoadFailed } Outcome;
+
+typedef struct {
+  const char *name;
+  char *imageFilename;
+  const char *inputFilename;
+
+  Outcome outcome;
+  uint8_t status; // The exit status, if kExited.
+  uint64_t cycles;
+} Test;
+
+// The machine a test runs on.
+typedef struct {
+  cpu6502 cpu;
+  uint8_t memory[65536];
+  uint64_t clockStart;
+  const uint8_t *input;
+  size_t inputSize, inputPos;
+  bool inputEof;
+  bool done;
+  Outcome outcome;
+  uint8_t status;
+  uint64_t cycles;
+} Machine;
+
+static Test *tests;
+static int testCount;
+static atomic_int nextTest;
+static uint64_t maxCycles = 10000000000;
+static bool cmos;
+
+// The sim platform's memory-mapped I/O, as in mos-sim.
+static uint8_t readMachine(cpu6502 *cpu, uint16_t address) {
+  Machine *m = cpu->user;
+  switch (address) {
+  case 0xfff0: {
+    const uint32_t clock = cpu->clockticks6502 - m->clockStart;
+    for (int i = 0; i < 4; ++i)
+      m->memory[0xfff0 + i] = clock >> 8 * i;
+    break;
+  }
+  case 0xfff5:
+    m->inputEof = m->inputPos == m->inputSize;
+    return m->inputEof ? 0xff : m->input[m->inputPos++];
+  case 0xfff6:
+    return m->inputEof;
+  case 0xfffe:
+    // An IRQ or BRK, which the sim platform has no handler for.
+    m->done = true;
+    m->outcome = kAborted;
+    break;
+  }
+  return m->memory[address];
+}
+
+static void writeMachine(cpu6502 *cpu, uint16_t address, uint8_t value) {
+  Machine *m = cpu->user;
+  switch (address) {
+  default:
+    m->memory[address] = value;
+    break;
+  case 0xfff0:
+    m->clockStart = cpu->clockticks6502;
+    break;
+  case 0xfff4:
+  case 0xfff9:
+    break;
+  case 0xfff2:
+    // A semihost call (mos-sim --semihost) would take no cycles.
+  case 0xfff7:
+    m->done = true;
+    m->outcome = kAborted;
+    break;
+  case 0xfff8:
+    if (!m->done) {
+      m->done = true;
+      m->outcome = kExited;
+      m->status = value;
+      // As mos-sim --cycles counts, up to the store.
+      m->cycles = cpu->clockticks6502;
+    }
+    break;
+  }
+}
+
+static void runTest(Test *test, Machine *m) {
+  memset(m, 0, sizeof(*m));
+  test->outcome = kLoadFailed;
+
+  size_t size;
+  uint8_t *image = imageReadFile(test->imageFilename, &size);
+  if (!image)
+    return;
+  const bool loaded =
+      imageIsElf(image, size)
+          ? imageLoadElf(m->memory, image, size, test->imageFilename)
+          : imageLoadBlocks(m->memory, image, size, test->imageFilename);
+  free(image);
+  if (!loaded)
+    return;
+
+  uint8_t *input = NULL;
+  if (test->inputFilename) {
+    input = imageReadFile(test->inputFilename, &m->inputSize);
+    if (!input)
+      return;
+    m->input = input;
+  }
+
+  cpu6502_init(&m->cpu, readMachine, writeMachine, m);
+  cpu6502_reset(&m->cpu, cmos);
+  while (!m->done && m->cpu.clockticks6502 < maxCycles)
+    cpu6502_step(&m->cpu);
+  free(input);
+
+  test->outcome = m->done ? m->outcome : kTimedOut;
+  test->status = m->status;
+  test->cycles = m->outcome == kExited ? m->cycles : m->cpu.clockticks6502;
+}
+
+static void *worker(void *unused) {
+  (void)unused;
+  Machine *m = malloc(sizeof(Machine));
+  if (!m) {
+    fputs("Out of memory for a machine.\n", stderr);
+    exit(1);
+  }
+  for (int i; (i = atomic_fetch_add(&nextTest, 1)) < testCount;)
+    runTest(&tests[i], m);
+  free(m);
+  return NULL;
+}
+
+typedef struct {
+  char *name;
+  uint64_t cycles;
+} BaselineEntry;
+
+static BaselineEntry *baseline;
+static int baselineCount;
+
+static bool readBaseline(const char *filename) {
+  FILE *file = fopen(filename, "r");
+  if (!file) {
+    fprintf(stderr, "Could not open '%s': ", filename);
+    perror(NULL);
+    return false;
+  }
+  char line[4096];
+  int capacity = 0;
+  for (int lineNumber = 1; fgets(line, sizeof(line), file); ++lineNumber) {
+    line[strcspn(line, "\r\n")] = '\0';
+    if (!*line)
+      continue;
+    // The name is everything up to the last space, so it may have spaces.
+    char *space = strrchr(line, ' ');
+    char *end = NULL;
+    const uint64_t cycles = space ? strtoull(space + 1, &end, 10) : 0;
+    if (!space || space == line || end == space + 1 || *end) {
+      fprintf(stderr, "%s:%d: expected \"<test> <cycles>\".\n", filename,
+              lineNumber);
+      fclose(file);
+      return false;
+    }
+    *space = '\0';
+    if (baselineCount == capacity) {
+      capacity = capacity ? capacity * 2 : 64;
+      baseline = realloc(baseline, capacity * sizeof(*baseline));
+      if (!baseline) {
+        fputs("Out of memory for the baseline.\n", stderr);
+        exit(1);
+      }
+    }
+    baseline[baselineCount].name = strdup(line);
+    baseline[baselineCount++].cycles = cycles;
+  }
+  fclose(file);
+  return true;
+}
+
+static const BaselineEntry *findBaseline(const char *name) {
+  for (int i = 0; i < baselineCount; ++i)
+    if (!strcmp(baseline[i].name, name))
+      return &baseline[i];
+  return NULL;
+}
+
+static bool parseCount(const char *arg, uint64_t *count) {
+  char *end = NULL;
+  *count = strtoull(arg, &end, 10);
+  return end != arg && !*end;
+}
+
+int main(int argc, const char *argv[]) {
+  uint64_t jobs = 0;
+  const char *baselineFilename = NULL, *writeFilename = NULL;
+  double threshold = 0;
+
+  int arg = 1;
+  for (; arg < argc && !strncmp(argv[arg], "--", 2); ++arg) {
+    const char *flag = argv[arg];
+    if (!strcmp(flag, "--cmos")) {
+      cmos = true;
+      continue;
+    }
+    if (arg + 1 == argc) {
+      fprintf(stderr, "%s requires an argument.\n", flag);
+      return 1;
+    }
+    const char *value = argv[++arg];
+    char *end = NULL;
+    if (!strcmp(flag, "--jobs")) {
+      if (!parseCount(value, &jobs) || !jobs || jobs > 1024) {
+        fprintf(stderr, "%s requires a count of threads.\n", flag);
+        return 1;
+      }
+    } else if (!strcmp(flag, "--max-cycles")) {
+      if (!parseCount(value, &maxCycles) || !maxCycles) {
+        fprintf(stderr, "%s requires a count of cycles.\n", flag);
+        return 1;
+      }
+    } else if (!strcmp(flag, "--threshold")) {
+      threshold = strtod(value, &end);
+      if (end == value || *end || threshold < 0) {
+        fprintf(stderr, "%s requires a percentage.\n", flag);
+        return 1;
+      }
+    } else if (!strcmp(flag, "--baseline")) {
+      baselineFilename = value;
+    } else if (!strcmp(flag, "--write")) {
+      writeFilename = value;
+    } else {
+      fprintf(stderr, "Unknown option '%s'.\n", flag);
+      return 1;
+    }
+  }
+  if (arg >= argc) {
+    fputs(usage, stderr);
+    return 1;
+  }
+  if (baselineFilename && !readBaseline(baselineFilename))
+    return 1;
+
+  testCount = argc - arg;
+  tests = calloc(testCount, sizeof(Test));
+  if (!tests) {
+    fputs("Out of memory for the tests.\n", stderr);
+    return 1;
+  }
+  for (int i = 0; i < testCount; ++i) {
+    Test *test = &tests[i];
+    test->name = argv[arg + i];
+    test->imageFilename = strdup(test->name);
+    char *comma = strchr(test->imageFilename, ',');
+    if (comma) {
+      *comma = '\0';
+      test->inputFilename = comma + 1;
+    }
+  }
+
+  if (!jobs) {
+#ifdef _SC_NPROCESSORS_ONLN
+    const long processors = sysconf(_SC_NPROCESSORS_ONLN);
+    jobs = processors > 0 ? processors : 1;
+#else
+    jobs = 1;
+#endif
+  }
+  if (jobs > (uint64_t)testCount)
+    jobs = testCount;
+  static pthread_t threads[1024];
+  for (uint64_t i = 0; i < jobs; ++i) {
+    if (pthread_create(&threads[i], NULL, worker, NULL)) {
+      fputs("Could not start a thread.\n", stderr);
+      return 1;
+    }
+  }
+  for (uint64_t i = 0; i < jobs; ++i)
+    pthread_join(threads[i], NULL);
+
+  FILE *write = NULL;
+  if (writeFilename && !(write = fopen(writeFilename, "w"))) {
+    fprintf(stderr, "Could not open '%s': ", writeFilename);
+    perror(NULL);
+    return 1;
+  }
+
+  int failures = 0, regressions = 0;
+  for (int i = 0; i < testCount; ++i) {
+    const Test *test = &tests[i];
+    if (test->outcome != kExited || test->status) {
+      ++failures;
+      printf("%s FAILED: ", test->name);
+      switch (test->outcome) {
+      case kExited:
+        printf("exit status %u", test->status);
+        break;
+      case kAborted:
+        printf("aborted");
+        break;
+      case kTimedOut:
+        printf("no exit in %" PRIu64 " cycles", maxCycles);
+        break;
+      case kLoadFailed:
+        printf("could not load");
+        break;
+      }
+      printf("\n");
+      continue;
+    }
+
+    printf("%s %" PRIu64, test->name, test->cycles);
+    if (write)
+      fprintf(write, "%s %" PRIu64 "\n", test->name, test->cycles);
+    const BaselineEntry *base = findBaseline(test->name);
+    if (base) {
+      const int64_t delta = (int64_t)(test->cycles - base->cycles);
+      const double percent = base->cycles ? 100.0 * delta / base->cycles : 0;
+      const bool regressed = test->cycles > base->cycles &&
+                             (!base->cycles || percent > threshold);
+      regressions += regressed;
+      printf(" %" PRIu64 " %+" PRId64 " (%+.2f%%)%s", base->cycles, delta,
+             percent, regressed ? " REGRESSION" : "");
+    } else if (baselineFilename) {
+      printf(" (new)");
+    }
+    printf("\n");
+  }
+  if (write)
+    fclose(write);
+
+  if (failures || regressions)
+    fprintf(stderr, "%d of %d tests failed, %d regressed.\n", failures,
+            testCount, regressions);
+  return failures || regressions;
+}
@@ -6,6 +6,22 @@
 #include <string.h>
 #include <time.h>
 
+#ifdef _WIN32
+#include <io.h>
+#define isatty _isatty
+#define putchar_unlocked _putchar_nolock
+#define read _read
+#define STDIN_FILENO 0
+#define STDOUT_FILENO 1
+#else
+#include <unistd.h>
+#endif
+
+#include "image.h"
+#include "mattbrew.h"
+#include "profile.h"
+#include "semihost.h"
+#include "trace.h"
 #include "types.h"
 
 #define TRACE 0
@@ -22,6 +38,11 @@ static const char usage[] =
     "The image file is a collection of blocks. Each block consists of a\n"
     "16-bit starting address, then a 16-bit block size, then that many bytes\n"
     "of contents. Both the address and size are stored little-endian.\n"
+    "It may instead be an llvm-mos ELF file, whose PT_LOAD segments are\n"
+    "loaded at their physical addresses; unless a segment sets the reset\n"
+    "vector, it points at the entry point.\n"
+    "With --machine mattbrew, an image that isn't ELF is instead a raw ROM\n"
+    "image, as the mattbrew linker writes it, loaded to end at $FFFF.\n"
     "\n"
     "The simulated 6502 will execute a reset sequence through the vector at\n"
     "$FFFC like a real 6502.\n"
@@ -31,21 +52,70 @@ static const char usage[] =
     " Addr | Len | Description\n"
     "$FFF0 |  4  | Read: CPU clock cycles from program start.\n"
     "      |     | Write: Reset counter.\n"
+    "$FFF1 |  1  | Write: Address of a 40-byte buffer, low byte then high;\n"
+    "      |     | the second write fills it with the performance counters,\n"
+    "      |     | each 64-bit little-endian: cycles, instructions, page\n"
+    "      |     | crossing penalty cycles, memory reads and writes.\n"
+    "$FFF2 |  1  | Write: Address of a semihost call block, low byte then\n"
+    "      |     | high; the second write makes the call. Only with\n"
+    "      |     | --semihost (see -lsemihost).\n"
+    "$FFF3 |  1  | Write: Tag for the counts from here on. Once one is\n"
+    "      |     | written, each tag's counter totals are printed to stderr\n"
+    "      |     | at exit; tag 0 has those from before the first.\n"
+    "$FFF4 |  1  | Write: Address of the MOS_PROFILE_SCOPE ring, low byte\n"
+    "      |     | then high; it's printed to stderr at exit.\n"
     "$FFF5 |  1  | Read: Character from standard input.\n"
     "$FFF6 |  1  | Read: 1 if last $FFF5 read was EOF.\n"
     "$FFF7 |  1  | Write: Aborts.\n"
     "$FFF8 |  1  | Write: Exits, returning the written exit code.\n"
     "$FFF9 |  1  | Write: Character to standard output.\n"
     "\n"
+    "With --machine mattbrew, these are replaced by the mattbrew computer's\n"
+    "devices: a W65C22 VIA at $E000, whose timers count cycles and interrupt,\n"
+    "and the Pico bridge port at $E040, whose devices 2-7 are backed as\n"
+    "--device says. A jump to itself, as in the mattbrew _Exit, ends the run.\n"
+    "\n"
     "OPTIONS:\n"
     "\t--cycles: Print cycle count to stderr.\n"
     "\t--trace: Print each instruction address to stderr.\n"
+    "\t--trace-ring <n>: Keep the last n instructions, and print them to\n"
+    "\t                  stderr if the program aborts.\n"
+    "\t--trace-file <file>: Write every instruction to file in a compact\n"
+    "\t                     binary format; mos-trace prints it.\n"
     "\t--profile: Print number of cycles executed at each PC address.\n"
-    "\t--cmos: Enable 65C02 emulation.\n";
+    "\t--flamegraph <file>: Write cycles per call stack to file, in the\n"
+    "\t                     collapsed-stack format of flamegraph.pl.\n"
+    "\t--symbols <elf>: Name functions in the flamegraph and trace from this\n"
+    "\t                 ELF file (default: the image, if it is ELF, or else\n"
+    "\t                 <image>.elf, if present).\n"
+    "\t--cmos: Enable 65C02 emulation.\n"
+    "\t--machine <name>: Simulate the sim platform (the default) or\n"
+    "\t                  mattbrew, which implies --cmos.\n"
+    "\t--device <n>=<spec>: Back mattbrew bridge device n with spec, a\n"
+    "\t                     comma-separated list of stdio, in:<file>,\n"
+    "\t                     out:<file>, echo, zero or none (default: 2=stdio,\n"
+    "\t                     7=echo, others zero if there's a --zero link).\n"
+    "\t--zero <spec>: Connect the bridge to a stand-in for the Pi Zero at\n"
+    "\t               tcp:<host>:<port> or unix:<path>, which exchanges\n"
+    "\t               [device][length][data...] messages, as over SPI.\n"
+    "\t--bridge-delay <n>: Cycles the bridge takes to answer a read, while\n"
+    "\t                    its port reads $FF (default: 8).\n"
+    "\t--no-fast-forward: Run mattbrew idle loops, which poll the devices\n"
+    "\t                   without changing memory, pass by pass rather than\n"
+    "\t                   skipping them to the next timer or bridge event.\n"
+    "\t                   Tracing and profiling imply it.\n"
+    "\t--semihost: Run the libc calls of a program linked with -lsemihost\n"
+    "\t            (memcpy, memset, strlen, printf formatting) on the host.\n"
+    "\t            They take no cycles, so the cycle count means nothing.\n"
+    "\t--buffered: Flush standard output only when full, when a program\n"
+    "\t            waits for input and at exit, if it is not a terminal.\n"
+    "\t            Otherwise it is also flushed at each newline.\n";
 
 void reset6502(uint8_t cmos);
+void exec6502(uint32_t tickcount);
 void step6502();
-extern uint64_t clockticks6502;
+void irq6502();
+extern uint64_t clockticks6502, instructions, penaltyticks6502;
 extern uint16_t pc;
 extern uint8_t a, x, y, sp, status;
 
@@ -55,23 +125,197 @@ bool shouldPrintCycles = false;
 bool shouldTrace = false;
 bool shouldProfile = false;
 bool cmos = false;
+bool mattbrew = false;
 bool input_eof = false;
+bool fullyBuffered = false;
+bool semihost = false;
+const char *flamegraphFilename = NULL;
+const char *symbolsFilename = NULL;
+const char *traceFilename = NULL;
+unsigned traceRingSize = 0;
+bool profileRingSet = false;
+uint16_t profileRing = 0;
+bool semihostLow = false;
+uint16_t semihostBlock = 0;
+FILE *flamegraphFile = NULL;
+
+// $FFF9 output collects here; see main.
+static char output_buf[1 << 16];
+
+// $FFF5 input that isn't from a terminal is read ahead into here, as much as
+// is ready at once.
+static unsigned char input_buf[1 << 16];
+static size_t input_pos = 0, input_len = 0;
+static bool input_tty = false;
 
 uint64_t clockTicksAtAddress[65536];
 
+// The performance counters of $FFF1 and $FFF3, and each tag's totals.
+enum {
+  PERF_CYCLES,
+  PERF_INSTRUCTIONS,
+  PERF_PENALTY,
+  PERF_READS,
+  PERF_WRITES,
+  PERF_COUNTERS
+};
+static const char *const perfNames[PERF_COUNTERS] = {
+    "cycles", "instructions", "penalty", "reads", "writes"};
+uint64_t reads6502 = 0, writes6502 = 0;
+bool perfLow = false;
+uint16_t perfBuffer = 0;
+bool perfTagged = false;
+uint8_t perfTag = 0;
+uint64_t perfMark[PERF_COUNTERS];
+uint64_t perfTotals[256][PERF_COUNTERS];
+
+static void perfRead(uint64_t counters[PERF_COUNTERS]) {
+  counters[PERF_CYCLES] = clockticks6502;
+  counters[PERF_INSTRUCTIONS] = instructions;
+  counters[PERF_PENALTY] = penaltyticks6502;
+  counters[PERF_READS] = reads6502;
+  counters[PERF_WRITES] = writes6502;
+}
+
+// Credit the counts since the last switch to the tag ending, and start tag.
+static void perfSwitch(uint8_t tag) {
+  uint64_t now[PERF_COUNTERS];
+  perfRead(now);
+  for (int i = 0; i < PERF_COUNTERS; ++i) {
+    perfTotals[perfTag][i] += now[i] - perfMark[i];
+    perfMark[i] = now[i];
+  }
+  perfTag = tag;
+}
+
+// Idle loops, with --machine mattbrew. A taken backward branch or JMP ends a
+// pass of a loop and starts the next. If that pass ends at the same branch
+// with the registers as they were, having changed no memory and read the
+// devices only quietly (see mattbrewQuietRead), each pass after it runs the
+// same until the devices' next event, so the whole passes up to that are
+// skipped, their cycles and counts added at once. The event is the one due
+// when the measured pass started: one that came during it (after its last
+// device read, say) makes the pass no guide, and its end starts another.
+bool fastForward = true;
+static struct {
+  bool started, quiet;
+  uint16_t from, to;
+  uint8_t a, x, y, sp, status;
+  uint64_t counters[PERF_COUNTERS];
+  uint64_t next; // The devices' next event, as the pass started
+} idle;
+
+static void idleBranch(uint16_t from) {
+  uint64_t now[PERF_COUNTERS];
+  perfRead(now);
+  if (idle.started && idle.quiet && idle.from == from && idle.to == pc &&
+      idle.a == a && idle.x == x && idle.y == y && idle.sp == sp &&
+      idle.status == status && clockticks6502 < idle.next) {
+    const uint64_t pass = now[PERF_CYCLES] - idle.counters[PERF_CYCLES];
+    const uint64_t passes = (idle.next - clockticks6502) / pass;
+    clockticks6502 += passes * pass;
+    instructions +=
+        passes * (now[PERF_INSTRUCTIONS] - idle.counters[PERF_INSTRUCTIONS]);
+    penaltyticks6502 +=
+        passes * (now[PERF_PENALTY] - idle.counters[PERF_PENALTY]);
+    reads6502 += passes * (now[PERF_READS] - idle.counters[PERF_READS]);
+    writes6502 += passes * (now[PERF_WRITES] - idle.counters[PERF_WRITES]);
+    perfRead(now);
+  }
+  idle.started = idle.quiet = true;
+  idle.from = from;
+  idle.to = pc;
+  idle.a = a;
+  idle.x = x;
+  idle.y = y;
+  idle.sp = sp;
+  idle.status = status;
+  memcpy(idle.counters, now, sizeof(now));
+  idle.next = mattbrewNextEvent(clockticks6502);
+}
+
+// Relative branches, BRA, BBR/BBS and JMP absolute.
+static bool isLoopBranch(uint8_t opcode) {
+  return (opcode & 0x1f) == 0x10 || opcode == 0x4c ||
+         (cmos && (opcode == 0x80 || (opcode & 0x0f) == 0x0f));
+}
+
+// After the instruction at addr, once the devices have caught up with it and
+// no interrupt is about to be taken.
+static void idleCheck(uint16_t addr) {
+  if (fastForward && pc < addr && isLoopBranch(memory[addr]))
+    idleBranch(addr);
+}
+
+static void perfWriteSummary(FILE *out) {
+  perfSwitch(perfTag);
+  fprintf(out, "tag");
+  for (int i = 0; i < PERF_COUNTERS; ++i)
+    fprintf(out, " %14s", perfNames[i]);
+  fprintf(out, "\n");
+  for (int tag = 0; tag < 256; ++tag) {
+    if (!perfTotals[tag][PERF_CYCLES])
+      continue;
+    fprintf(out, "%3d", tag);
+    for (int i = 0; i < PERF_COUNTERS; ++i)
+      fprintf(out, " %14" PRIu64, perfTotals[tag][i]);
+    fprintf(out, "\n");
+  }
+}
+
 void finish(void);
 
+static int readInput(void) {
+  if (input_pos == input_len) {
+    // A program reading input has usually just prompted for it; with input
+    // still buffered it isn't waiting, so the prompt can wait too.
+    fflush(stdout);
+    if (input_tty)
+      return getchar();
+    const int n = read(STDIN_FILENO, input_buf, sizeof(input_buf));
+    if (n <= 0)
+      return EOF;
+    input_pos = 0;
+    input_len = n;
+  }
+  return input_buf[input_pos++];
+}
+
+// Device accesses are taken to land on an instruction's fourth cycle, the last
+// of an absolute load or store.
+#define ACCESS_CYCLE 3
+
+// Cycles per exec6502() call in the uninstrumented run loop. The program
+// ends from inside one, at its exit write, so this only bounds the batch.
+#define EXEC_BATCH (1u << 20)
+
 uint8_t read6502(uint16_t address) {
-  if (address == 0xfff0) {
+  ++reads6502;
+  if (mattbrew) {
+    if (!mattbrewDecodes(address))
+      return memory[address];
+    const uint64_t cycle = clockticks6502 + ACCESS_CYCLE;
+    if (!mattbrewQuietRead(address, cycle))
+      idle.quiet = false;
+    return mattbrewRead(address, cycle);
+  }
+  // All of the sim's I/O is in page $FF.
+  if (address < 0xff00)
+    return memory[address];
+  switch (address) {
+  case 0xfff0:
     *((uint32_t *)(memory + address)) = clockticks6502 - clock_start;
-  } else if (address == 0xfff5) {
-    const int c = getchar();
+    break;
+  case 0xfff5: {
+    const int c = readInput();
     input_eof = (c == EOF);
     return (int8_t)c;
-  } else if (address == 0xfff6) {
+  }
+  case 0xfff6:
     return (int8_t)input_eof;
-  } else if (address == 0xfffe) {
+  case 0xfffe:
     fprintf(stderr, "%04x:%02x %02x %02x read fffe\n", pc, memory[pc], memory[pc+1], memory[pc+2]);
+    traceDumpRing(stderr);
     finish();
     abort();
   }
@@ -79,16 +323,54 @@ uint8_t read6502(uint16_t address) {
 }
 
 void finish(void) {
+  // Also reached before abort(), which doesn't flush stdio.
+  fflush(stdout);
+
   if (shouldPrintCycles)
     fprintf(stderr, "%" PRIu64 " cycles\n", clockticks6502);
 
+  if (perfTagged)
+    perfWriteSummary(stderr);
+
   if (shouldProfile)
     for (int addr = 0; addr < 65536; ++addr)
       if (clockTicksAtAddress[addr])
         fprintf(stderr, "%04x %" PRIu64 "\n", addr, clockTicksAtAddress[addr]);
+
+  if (profileRingSet)
+    profileWriteScopes(stderr, memory, profileRing);
+
+  if (flamegraphFile) {
+    profileWriteCollapsed(flamegraphFile);
+    fclose(flamegraphFile);
+    flamegraphFile = NULL;
+  }
+
+  if (mattbrew)
+    mattbrewFinish();
+
+  traceClose();
 }
 
 void write6502(uint16_t address, uint8_t value) {
+  ++writes6502;
+  if (mattbrew) {
+    // A write of what memory already holds, like a JSR's push in a loop,
+    // changes nothing for an idle loop.
+    if (mattbrewDecodes(address)) {
+      idle.quiet = false;
+      mattbrewWrite(address, value, clockticks6502 + ACCESS_CYCLE);
+    } else {
+      if (memory[address] != value)
+        idle.quiet = false;
+      memory[address] = value;
+    }
+    return;
+  }
+  if (address < 0xff00) {
+    memory[address] = value;
+    return;
+  }
   switch (address) {
   default:
     memory[address] = value;
@@ -96,9 +378,45 @@ void write6502(uint16_t address, uint8_t value) {
   case 0xFFF0:
     clock_start = clockticks6502;
     break;
+  case 0xFFF1: {
+    // Toggles between the buffer address's low and high byte, as $FFF2.
+    perfBuffer = perfLow ? perfBuffer | value << 8 : value;
+    perfLow = !perfLow;
+    if (perfLow)
+      break;
+    uint64_t counters[PERF_COUNTERS];
+    perfRead(counters);
+    for (int i = 0; i < PERF_COUNTERS; ++i)
+      for (int j = 0; j < 8; ++j)
+        memory[(uint16_t)(perfBuffer + 8 * i + j)] = counters[i] >> 8 * j;
+    break;
+  }
+  case 0xFFF2:
+    // The two writes toggle between the address's low and high byte.
+    semihostBlock = semihostLow ? semihostBlock | value << 8 : value;
+    semihostLow = !semihostLow;
+    if (semihostLow)
+      break;
+    if (!semihost)
+      fprintf(stderr, "%04x: semihost call without --semihost\n", pc);
+    if (!semihost || !semihostCall(memory, semihostBlock)) {
+      traceDumpRing(stderr);
+      finish();
+      abort();
+    }
+    break;
+  case 0xFFF3:
+    perfSwitch(value);
+    perfTagged = true;
+    break;
+  case 0xFFF4:
+    profileRing = profileRing >> 8 | value << 8;
+    profileRingSet = true;
+    break;
   case 0xFFF7:
     if (shouldProfile)
       fprintf(stderr, "%04x:%02x %02x %02x write fff7\n", pc, memory[pc], memory[pc+1], memory[pc+2]);
+    traceDumpRing(stderr);
     finish();
     abort();
   case 0xFFF8:
@@ -107,7 +425,7 @@ void write6502(uint16_t address, uint8_t value) {
     finish();
     exit(value);
   case 0xFFF9:
-    putchar(value);
+    putchar_unlocked(value);
     break;
   }
 }
@@ -116,7 +434,66 @@ bool parseFlag(int *argc, const char ***argv) {
   if (*argc < 2)
     return false;
   const char *flag = (*argv)[1];
-  if (!strcmp(flag, "--cycles")) {
+  int consumed = 1;
+  if (!strcmp(flag, "--flamegraph") || !strcmp(flag, "--symbols") ||
+      !strcmp(flag, "--trace-file")) {
+    if (*argc < 3) {
+      fprintf(stderr, "%s requires a file name.\n", flag);
+      exit(1);
+    }
+    if (!strcmp(flag, "--flamegraph"))
+      flamegraphFilename = (*argv)[2];
+    else if (!strcmp(flag, "--symbols"))
+      symbolsFilename = (*argv)[2];
+    else
+      traceFilename = (*argv)[2];
+    consumed = 2;
+  } else if (!strcmp(flag, "--machine") || !strcmp(flag, "--device") ||
+             !strcmp(flag, "--zero")) {
+    if (*argc < 3) {
+      fprintf(stderr, "%s requires an argument.\n", flag);
+      exit(1);
+    }
+    const char *arg = (*argv)[2];
+    if (!strcmp(flag, "--machine")) {
+      if (!strcmp(arg, "mattbrew")) {
+        mattbrew = cmos = true;
+      } else if (strcmp(arg, "sim")) {
+        fprintf(stderr, "Unknown machine '%s'.\n", arg);
+        exit(1);
+      }
+    } else if (!strcmp(flag, "--device")) {
+      char *end = NULL;
+      const long device = strtol(arg, &end, 10);
+      if (end == arg || *end != '=') {
+        fprintf(stderr, "%s requires <n>=<spec>.\n", flag);
+        exit(1);
+      }
+      if (!mattbrewAttach(device, end + 1))
+        exit(1);
+    } else if (!mattbrewConnectZero(arg)) {
+      exit(1);
+    }
+    consumed = 2;
+  } else if (!strcmp(flag, "--bridge-delay")) {
+    char *end = NULL;
+    const unsigned long cycles = *argc < 3 ? 0 : strtoul((*argv)[2], &end, 10);
+    if (!end || *end || cycles > 1u << 24) {
+      fprintf(stderr, "%s requires a count of cycles.\n", flag);
+      exit(1);
+    }
+    mattbrewSetBridgeDelay(cycles);
+    consumed = 2;
+  } else if (!strcmp(flag, "--trace-ring")) {
+    char *end = NULL;
+    const unsigned long count = *argc < 3 ? 0 : strtoul((*argv)[2], &end, 10);
+    if (!count || *end || count > 1u << 24) {
+      fprintf(stderr, "%s requires a count of instructions.\n", flag);
+      exit(1);
+    }
+    traceRingSize = count;
+    consumed = 2;
+  } else if (!strcmp(flag, "--cycles")) {
     shouldPrintCycles = true;
   } else if (!strcmp(flag, "--trace")) {
     shouldTrace = true;
@@ -124,13 +501,19 @@ bool parseFlag(int *argc, const char ***argv) {
     shouldProfile = true;
   } else if (!strcmp(flag, "--cmos")) {
     cmos = true;
+  } else if (!strcmp(flag, "--buffered")) {
+    fullyBuffered = true;
+  } else if (!strcmp(flag, "--no-fast-forward")) {
+    fastForward = false;
+  } else if (!strcmp(flag, "--semihost")) {
+    semihost = true;
   } else
     return false;
 
-  for (int i = 2; i < *argc; ++i) {
-    (*argv)[i - 1] = (*argv)[i];
+  for (int i = 1 + consumed; i < *argc; ++i) {
+    (*argv)[i - consumed] = (*argv)[i];
   }
-  --*argc;
+  *argc -= consumed;
   return true;
 }
 
@@ -144,58 +527,76 @@ int main(int argc, const char *argv[]) {
   }
   const char *filename = argv[1];
 
-  FILE *file = fopen(filename, "rb");
-  if (!file) {
-    fprintf(stderr, "Could not open '%s': ", filename);
-    perror(NULL);
+  size_t size;
+  uint8_t *image = imageReadFile(filename, &size);
+  if (!image)
     return 1;
-  }
 
-  while (1) {
-    // Assumes host is little-endian.
-    uint16_t address;
-    if (fread(&address, 2, 1, file) != 1) {
-      if (feof(file))
-        break;
-      else {
-        fprintf(stderr, "Error reading image file '%s': ", filename);
-        perror(NULL);
+  const bool elfImage = imageIsElf(image, size);
+  if (!(elfImage   ? imageLoadElf(memory, image, size, filename)
+        : mattbrew ? imageLoadRom(memory, image, size, filename)
+                   : imageLoadBlocks(memory, image, size, filename)))
+    return 1;
+  if (mattbrew && !mattbrewInit())
+    return 1;
+
+  if (flamegraphFilename || shouldTrace || traceRingSize) {
+    if (symbolsFilename) {
+      if (!profileLoadSymbols(symbolsFilename))
+        return 1;
+    } else if (elfImage) {
+      if (!profileLoadElfSymbols(image, size, filename))
         return 1;
+    } else {
+      // The llvm-mos linker writes the ELF file next to the image.
+      char *elfFilename = malloc(strlen(filename) + sizeof(".elf"));
+      strcat(strcpy(elfFilename, filename), ".elf");
+      FILE *elf = fopen(elfFilename, "rb");
+      if (elf) {
+        fclose(elf);
+        if (!profileLoadSymbols(elfFilename))
+          return 1;
       }
+      free(elfFilename);
     }
+  }
+  free(image);
 
-    uint16_t size;
-    if (fread(&size, 2, 1, file) != 1) {
-      fprintf(stderr, "Error reading image file '%s': ", filename);
-      if (feof(file))
-        fputs("expected block size, found EOF.", stderr);
-      else
-        perror(NULL);
-      return 1;
-    }
-
-    uint32_t lastAddress = address + size - 1;
-    if (lastAddress >= 65536) {
-      fprintf(stderr,
-              "Invalid block: block of %d bytes at address %d would reach "
-              "location %d, which is out of bounds.\n",
-              size, address, lastAddress);
+  if (flamegraphFilename) {
+    flamegraphFile = fopen(flamegraphFilename, "w");
+    if (!flamegraphFile) {
+      fprintf(stderr, "Could not open '%s': ", flamegraphFilename);
+      perror(NULL);
       return 1;
     }
+  }
 
-    size_t readSize = fread(&memory[address], 1, size, file);
-    if (readSize != size) {
-      fprintf(stderr, "Error reading image file '%s': ", filename);
-      if (feof(file)) {
-        fprintf(stderr, "expected %d byte block, found %zu bytes.", size,
-                readSize);
-      } else
-        perror(NULL);
-      return 1;
-    }
+  if (traceRingSize && !traceSetRing(traceRingSize)) {
+    fputs("Out of memory for the trace ring.\n", stderr);
+    return 1;
   }
+  if (traceFilename && !traceOpenFile(traceFilename))
+    return 1;
+  const bool binaryTrace = traceRingSize || traceFilename;
+
+  input_tty = isatty(STDIN_FILENO);
+  setvbuf(stdout, output_buf,
+          fullyBuffered && !isatty(STDOUT_FILENO) ? _IOFBF : _IOLBF,
+          sizeof(output_buf));
 
   reset6502(cmos);
+
+  // Skipped passes would be missing from the trace and the profiles.
+  if (shouldTrace || binaryTrace || shouldProfile || flamegraphFile)
+    fastForward = false;
+
+  // With nothing watching individual instructions, run in batches. The
+  // program exits (or aborts) from within, at its $FFF8/$FFF7 write.
+  if (!mattbrew && !shouldTrace && !binaryTrace && !shouldProfile &&
+      !flamegraphFile)
+    for (;;)
+      exec6502(EXEC_BATCH);
+
   for (;;) {
     char status_buf[9];
     status_buf[8] = '\0';
@@ -208,14 +609,67 @@ int main(int argc, const char *argv[]) {
       }
       fprintf(stderr,
 	  "%04x a:%02x x:%02x y:%02x s:%02x st:%02x (%s)"
-	  " insn:%02x %02x %02x\n",
+	  " insn:%02x %02x %02x",
 	  pc, a, x, y, sp, status, status_buf,
 	  memory[pc], memory[(pc+1)&0xffff], memory[(pc+2)&0xffff]);
+      uint16_t offset;
+      const char *name = profileSymbolAt(pc, &offset);
+      if (name)
+        fprintf(stderr, " %s+%u", name, offset);
+      fputc('\n', stderr);
+    }
+    TraceRecord *record = NULL;
+    if (binaryTrace) {
+      record = traceBegin();
+      record->pc = pc;
+      record->opcode = memory[pc];
+      record->a = a;
+      record->x = x;
+      record->y = y;
+      record->sp = sp;
+      record->status = status;
     }
     uint32_t clockTicksBefore = clockticks6502;
     uint16_t addr = pc;
     step6502();
-    clockTicksAtAddress[addr] += clockticks6502 - clockTicksBefore;
+    if (shouldProfile)
+      clockTicksAtAddress[addr] += clockticks6502 - clockTicksBefore;
+    if (record) {
+      const uint32_t cycles = clockticks6502 - clockTicksBefore;
+      record->cycles = cycles > 255 ? 255 : cycles;
+    }
+    if (flamegraphFile)
+      profileInstruction(addr, memory[addr], pc, sp,
+                         clockticks6502 - clockTicksBefore);
+
+    if (mattbrew) {
+      switch (mattbrewTick(clockticks6502)) {
+      case kMattbrewRun:
+        // The mattbrew _Exit spins on a JMP or BRA to itself.
+        if (pc == addr && (memory[addr] == 0x4c || memory[addr] == 0x80)) {
+          finish();
+          return 0;
+        }
+        idleCheck(addr);
+        break;
+      case kMattbrewIrq:
+        if (!(status & 0x04)) {
+          irq6502();
+          idle.started = false;
+          // The 65C02 clears D on an interrupt.
+          status &= ~0x08;
+          clockticks6502 += 7;
+        } else {
+          idleCheck(addr);
+        }
+        break;
+      case kMattbrewReset:
+        mattbrewReset();
+        reset6502(cmos);
+        idle.started = false;
+        break;
+      }
+    }
   }
   finish();
   return 0;
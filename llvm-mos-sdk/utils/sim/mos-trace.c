@@ -0,0 +1,51 @@
+// Print a binary trace written by mos-sim --trace-file, one instruction per
+// line.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "profile.h"
+#include "trace.h"
+
+static const char usage[] =
+    "Usage: mos-trace [--symbols <elf>] <trace>\n"
+    "\n"
+    "Prints a binary trace written by mos-sim --trace-file.\n"
+    "\n"
+    "OPTIONS:\n"
+    "\t--symbols <elf>: Name the function running each instruction, from\n"
+    "\t                 this llvm-mos ELF file.\n";
+
+int main(int argc, const char *argv[]) {
+  const char *symbolsFilename = NULL;
+  if (argc == 4 && !strcmp(argv[1], "--symbols")) {
+    symbolsFilename = argv[2];
+    argv += 2;
+    argc -= 2;
+  }
+  if (argc != 2) {
+    fputs(usage, stderr);
+    return 1;
+  }
+  if (symbolsFilename && !profileLoadSymbols(symbolsFilename))
+    return 1;
+
+  FILE *file = fopen(argv[1], "rb");
+  if (!file) {
+    fprintf(stderr, "Could not open '%s': ", argv[1]);
+    perror(NULL);
+    return 1;
+  }
+  char magic[sizeof(TRACE_MAGIC) - 1];
+  if (fread(magic, 1, sizeof(magic), file) != sizeof(magic) ||
+      memcmp(magic, TRACE_MAGIC, sizeof(magic))) {
+    fprintf(stderr, "'%s' is not a mos-sim trace.\n", argv[1]);
+    return 1;
+  }
+
+  TraceRecord record;
+  while (traceRead(file, &record))
+    traceFormat(stdout, &record);
+  fclose(file);
+  return 0;
+}
@@ -0,0 +1,346 @@
+#include "profile.h"
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../common/elf.h"
+#include "../common/elf-mos.h"
+
+// A function is a symbol index, or kAddressFunction plus the address of a JSR
+// target no symbol covers.
+enum { kNoFunction = -1, kAddressFunction = 1 << 20 };
+
+typedef struct {
+  uint16_t address;
+  bool isFunc;
+  char *name;
+} Symbol;
+
+static Symbol *symbols;
+static int symbolCount, symbolCapacity;
+
+// 1 + the index of the symbol covering each address, 0 for none.
+static int functionAt[65536];
+
+// One node per distinct call stack; node 0 is the (nameless) root.
+typedef struct {
+  int parent;
+  int function;
+  uint64_t cycles;
+} Node;
+
+static Node *nodes;
+static int nodeCount, nodeCapacity;
+
+// Open-addressed (parent, function) -> 1 + child node index, 0 for empty.
+static int *children;
+static unsigned childrenSize;
+
+// The shadow call stack. frames[0] is the function at the reset vector and is
+// never popped.
+typedef struct {
+  int node;
+  uint8_t sp; // sp just after the JSR
+} Frame;
+
+static Frame *frames;
+static int frameCount, frameCapacity;
+
+static void *growArray(void *array, int *capacity, size_t elementSize) {
+  *capacity = *capacity ? *capacity * 2 : 256;
+  array = realloc(array, *capacity * elementSize);
+  if (!array) {
+    fputs("Out of memory in profiler.\n", stderr);
+    abort();
+  }
+  return array;
+}
+
+static uint32_t readLE(const uint8_t *p, int size) {
+  uint32_t value = 0;
+  while (size--)
+    value = value << 8 | p[size];
+  return value;
+}
+
+static int compareSymbols(const void *a, const void *b) {
+  const Symbol *x = a, *y = b;
+  if (x->address != y->address)
+    return x->address < y->address ? -1 : 1;
+  // Prefer a function to any other label at the same address.
+  return (int)y->isFunc - (int)x->isFunc;
+}
+
+bool profileLoadSymbols(const char *filename) {
+  FILE *file = fopen(filename, "rb");
+  if (!file) {
+    fprintf(stderr, "Could not open '%s': ", filename);
+    perror(NULL);
+    return false;
+  }
+  fseek(file, 0, SEEK_END);
+  const long size = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  uint8_t *elf = malloc(size > 0 ? size : 1);
+  const bool ok = elf && size > 0 && fread(elf, 1, size, file) == (size_t)size;
+  fclose(file);
+
+  const bool loaded = ok && profileLoadElfSymbols(elf, size, filename);
+  if (!ok)
+    fprintf(stderr, "'%s' is not a little-endian ELF32 file.\n", filename);
+  free(elf);
+  return loaded;
+}
+
+bool profileLoadElfSymbols(const uint8_t *elf, size_t size,
+                           const char *filename) {
+#define IN_FILE(offset, length)                                                \
+  ((uint64_t)(offset) + (uint64_t)(length) <= (uint64_t)size)
+
+  if (!IN_FILE(0, sizeof(Elf32_Ehdr)) || elf[EI_MAG0] != ELFMAG0 ||
+      elf[EI_MAG1] != ELFMAG1 || elf[EI_MAG2] != ELFMAG2 ||
+      elf[EI_MAG3] != ELFMAG3 || elf[EI_CLASS] != ELFCLASS32 ||
+      elf[EI_DATA] != ELFDATA2LSB) {
+    fprintf(stderr, "'%s' is not a little-endian ELF32 file.\n", filename);
+    return false;
+  }
+
+  const uint32_t shoff = readLE(elf + ELF32_EHDR_SHOFF, 4);
+  const uint32_t shnum = readLE(elf + ELF32_EHDR_SHNUM, 2);
+  const uint32_t shentsize = readLE(elf + ELF32_EHDR_SHENTSIZE, 2);
+  if (shentsize < ELF32_SHDR__SIZE || !IN_FILE(shoff, shnum * shentsize)) {
+    fprintf(stderr, "'%s' has a bad section header table.\n", filename);
+    return false;
+  }
+  const uint8_t *shdrs = elf + shoff;
+
+  for (uint32_t i = 0; i < shnum; ++i) {
+    const uint8_t *shdr = shdrs + i * shentsize;
+    if (readLE(shdr + ELF32_SHDR_TYPE, 4) != SHT_SYMTAB)
+      continue;
+    const uint32_t offset = readLE(shdr + ELF32_SHDR_OFFSET, 4);
+    const uint32_t length = readLE(shdr + ELF32_SHDR_SIZE, 4);
+    const uint32_t entsize = readLE(shdr + ELF32_SHDR_ENTSIZE, 4);
+    const uint32_t link = readLE(shdr + ELF32_SHDR_LINK, 4);
+    if (entsize < ELF32_SYM__SIZE || !IN_FILE(offset, length) || link >= shnum)
+      continue;
+    const uint8_t *strtab = shdrs + link * shentsize;
+    const uint32_t strOffset = readLE(strtab + ELF32_SHDR_OFFSET, 4);
+    const uint32_t strLength = readLE(strtab + ELF32_SHDR_SIZE, 4);
+    if (!IN_FILE(strOffset, strLength))
+      continue;
+
+    for (uint32_t sym = offset; sym + entsize <= offset + length;
+         sym += entsize) {
+      const uint32_t name = readLE(elf + sym + ELF32_SYM_NAME, 4);
+      const uint32_t value = readLE(elf + sym + ELF32_SYM_VALUE, 4);
+      const uint8_t type = ELF32_ST_TYPE(elf[sym + ELF32_SYM_INFO]);
+      const uint32_t shndx = readLE(elf + sym + ELF32_SYM_SHNDX, 2);
+      // Code labels only: defined in an executable section, in the 6502's
+      // address space, with a name.
+      if (shndx == SHN_UNDEF || shndx >= shnum || value > 0xffff ||
+          (type != STT_FUNC && type != STT_NOTYPE) || name >= strLength)
+        continue;
+      if (!(readLE(shdrs + shndx * shentsize + ELF32_SHDR_FLAGS, 4) &
+            SHF_EXECINSTR))
+        continue;
+      const char *str = (const char *)elf + strOffset + name;
+      const size_t strMax = strLength - name;
+      const size_t len = strnlen(str, strMax);
+      if (!len || len == strMax || !strncmp(str, ".L", 2))
+        continue;
+
+      if (symbolCount == symbolCapacity)
+        symbols = growArray(symbols, &symbolCapacity, sizeof(Symbol));
+      Symbol *s = &symbols[symbolCount++];
+      s->address = value;
+      s->isFunc = type == STT_FUNC;
+      s->name = malloc(len + 1);
+      memcpy(s->name, str, len + 1);
+    }
+  }
+#undef IN_FILE
+
+  qsort(symbols, symbolCount, sizeof(Symbol), compareSymbols);
+  int s = 0, current = 0;
+  for (uint32_t addr = 0; addr < 65536; ++addr) {
+    for (; s < symbolCount && symbols[s].address == addr; ++s)
+      if (!current || symbols[current - 1].address != addr)
+        current = s + 1;
+    functionAt[addr] = current;
+  }
+  return true;
+}
+
+const char *profileSymbolAt(uint16_t addr, uint16_t *offset) {
+  if (!functionAt[addr])
+    return NULL;
+  const Symbol *s = &symbols[functionAt[addr] - 1];
+  *offset = addr - s->address;
+  return s->name;
+}
+
+static unsigned hashChild(int parent, int function) {
+  return (unsigned)parent * 0x9e3779b1u ^ (unsigned)function * 0x85ebca77u;
+}
+
+static void insertChild(int node) {
+  const unsigned mask = childrenSize - 1;
+  unsigned i = hashChild(nodes[node].parent, nodes[node].function) & mask;
+  while (children[i])
+    i = (i + 1) & mask;
+  children[i] = node + 1;
+}
+
+static int newNode(int parent, int function) {
+  if (nodeCount == nodeCapacity)
+    nodes = growArray(nodes, &nodeCapacity, sizeof(Node));
+  nodes[nodeCount].parent = parent;
+  nodes[nodeCount].function = function;
+  nodes[nodeCount].cycles = 0;
+  return nodeCount++;
+}
+
+// The node for |function| called from |parent|, made on first use.
+static int child(int parent, int function) {
+  if (2 * (unsigned)nodeCount >= childrenSize) {
+    free(children);
+    childrenSize = childrenSize ? childrenSize * 2 : 1024;
+    children = calloc(childrenSize, sizeof(int));
+    if (!children) {
+      fputs("Out of memory in profiler.\n", stderr);
+      abort();
+    }
+    for (int node = 1; node < nodeCount; ++node)
+      insertChild(node);
+  }
+  const unsigned mask = childrenSize - 1;
+  for (unsigned i = hashChild(parent, function) & mask;; i = (i + 1) & mask) {
+    const int n = children[i] - 1;
+    if (n < 0) {
+      const int node = newNode(parent, function);
+      children[i] = node + 1;
+      return node;
+    }
+    if (nodes[n].parent == parent && nodes[n].function == function)
+      return n;
+  }
+}
+
+static void pushFrame(int node, uint8_t sp) {
+  if (frameCount == frameCapacity)
+    frames = growArray(frames, &frameCapacity, sizeof(Frame));
+  frames[frameCount].node = node;
+  frames[frameCount].sp = sp;
+  ++frameCount;
+}
+
+void profileInstruction(uint16_t addr, uint8_t opcode, uint16_t pc, uint8_t sp,
+                        uint32_t cycles) {
+  if (!frameCount) {
+    const int root = newNode(-1, kNoFunction);
+    pushFrame(child(root, functionAt[addr] ? functionAt[addr] - 1
+                                           : kAddressFunction + addr),
+              0xff);
+  }
+
+  int node = frames[frameCount - 1].node;
+  const int function = functionAt[addr] - 1;
+  // Reached other than by JSR: a tail call's JMP, or falling through.
+  if (function != kNoFunction && function != nodes[node].function)
+    node = child(node, function);
+  nodes[node].cycles += cycles;
+
+  switch (opcode) {
+  case 0x20: { // JSR
+    const int callee = functionAt[pc] ? functionAt[pc] - 1
+                                      : kAddressFunction + pc;
+    pushFrame(child(node, callee), sp);
+    break;
+  }
+  case 0x40: // RTI
+  case 0x60: // RTS
+  case 0x9a: // TXS
+    while (frameCount > 1 && sp > frames[frameCount - 1].sp)
+      --frameCount;
+    break;
+  }
+}
+
+static void writeStack(FILE *file, int node) {
+  const int parent = nodes[node].parent;
+  if (parent > 0) {
+    writeStack(file, parent);
+    fputc(';', file);
+  }
+  const int function = nodes[node].function;
+  if (function >= kAddressFunction)
+    fprintf(file, "$%04x", function - kAddressFunction);
+  else
+    fputs(symbols[function].name, file);
+}
+
+void profileWriteCollapsed(FILE *file) {
+  for (int node = 1; node < nodeCount; ++node) {
+    if (!nodes[node].cycles)
+      continue;
+    writeStack(file, node);
+    fprintf(file, " %llu\n", (unsigned long long)nodes[node].cycles);
+  }
+}
+
+// The ring of MOS_PROFILE_SCOPE events: size, next, wrapped, then size records
+// of a 16-bit name pointer, an exit flag and a 32-bit cycle count.
+enum { kRingHeader = 3, kRecordSize = 7 };
+
+static void readRecord(const uint8_t *memory, uint16_t ring, int index,
+                       uint8_t *record) {
+  const uint16_t start = ring + kRingHeader + index * kRecordSize;
+  for (int j = 0; j < kRecordSize; ++j)
+    record[j] = memory[(uint16_t)(start + j)];
+}
+
+static void writeRingName(FILE *file, const uint8_t *memory, uint16_t name) {
+  for (int i = 0; i < 64 && memory[(uint16_t)(name + i)]; ++i)
+    fputc(memory[(uint16_t)(name + i)], file);
+}
+
+void profileWriteScopes(FILE *file, const uint8_t *memory, uint16_t ring) {
+  const uint8_t size = memory[ring];
+  const uint8_t next = memory[(uint16_t)(ring + 1)];
+  const bool wrapped = memory[(uint16_t)(ring + 2)];
+  if (!size || next >= size)
+    return;
+
+  // Entries of the scopes open at each point, oldest first.
+  uint8_t open[256];
+  int depth = 0;
+  int i = wrapped ? next : 0;
+  for (int left = wrapped ? size : next; left; --left, i = (i + 1) % size) {
+    uint8_t record[kRecordSize];
+    readRecord(memory, ring, i, record);
+    const uint16_t name = record[0] | record[1] << 8;
+    if (!record[2]) {
+      open[depth++] = i;
+      continue;
+    }
+    // As in mos_profile_dump: skip scopes left by longjmp, and ignore exits
+    // whose entries are older than the ring.
+    uint8_t entry[kRecordSize];
+    int d = depth;
+    for (; d; --d) {
+      readRecord(memory, ring, open[d - 1], entry);
+      if ((entry[0] | entry[1] << 8) == name)
+        break;
+    }
+    if (!d)
+      continue;
+    depth = d - 1;
+    fprintf(file, "%*s", depth * 2, "");
+    writeRingName(file, memory, name);
+    fprintf(file, " %" PRIu32 "\n",
+            readLE(record + 3, 4) - readLE(entry + 3, 4));
+  }
+}
@@ -0,0 +1,44 @@
+// Call-stack cycle profiler for mos-sim.
+//
+// Cycles are charged to the stack of functions live when each instruction
+// ran. The stack is shadowed from JSR, and unwound when RTS, RTI or TXS leaves
+// the stack pointer above a call's return address. Functions are named from
+// the symbol table of the program's ELF file (the image's .elf sibling, as
+// written by the llvm-mos linker); without one, callees are named by address.
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Load function symbols from an llvm-mos ELF file. Prints an error and returns
+// false if the file can't be read.
+bool profileLoadSymbols(const char *filename);
+
+// The same, from an ELF file already in memory; filename is for errors.
+bool profileLoadElfSymbols(const uint8_t *elf, size_t size,
+                           const char *filename);
+
+// The name of the symbol covering addr, setting *offset to addr's distance
+// from it, or NULL if no symbol does (or none are loaded).
+const char *profileSymbolAt(uint16_t addr, uint16_t *offset);
+
+// Record one instruction: the address and opcode it ran from, the pc and sp
+// it left behind and the cycles it took.
+void profileInstruction(uint16_t addr, uint8_t opcode, uint16_t pc, uint8_t sp,
+                        uint32_t cycles);
+
+// Write the profile in the collapsed-stack format read by flamegraph.pl,
+// speedscope and friends: one "outer;...;inner cycles" line per stack.
+void profileWriteCollapsed(FILE *file);
+
+// Write the scopes a program timed with MOS_PROFILE_SCOPE (see
+// 6502-profile.h), from the ring of events at ring in memory: one "name
+// cycles" line per scope whose entry is still in the ring, indented by its
+// nesting depth.
+void profileWriteScopes(FILE *file, const uint8_t *memory, uint16_t ring);
+
+#endif // PROFILE_H
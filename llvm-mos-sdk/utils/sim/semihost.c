@@ -0,0 +1,266 @@
+#include "semihost.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The 6502's address space wraps, as the program's pointers do.
+static uint16_t read16(const uint8_t *memory, uint16_t addr) {
+  return memory[addr] | memory[(uint16_t)(addr + 1)] << 8;
+}
+
+static void write16(uint8_t *memory, uint16_t addr, uint16_t value) {
+  memory[addr] = value;
+  memory[(uint16_t)(addr + 1)] = value >> 8;
+}
+
+// A little-endian value of size bytes.
+static uint64_t readN(const uint8_t *memory, uint16_t addr, int size) {
+  uint64_t value = 0;
+  for (int i = size - 1; i >= 0; --i)
+    value = value << 8 | memory[(uint16_t)(addr + i)];
+  return value;
+}
+
+// vsnprintf output: the count goes on past n, as the result must.
+typedef struct {
+  uint8_t *memory;
+  uint16_t s;
+  uint16_t n;
+  uint32_t i;
+} Output;
+
+static void put(Output *out, const char *text, size_t len) {
+  for (size_t k = 0; k < len; ++k, ++out->i)
+    if (out->i < out->n)
+      out->memory[(uint16_t)(out->s + out->i)] = text[k];
+}
+
+// Format one conversion with the host's snprintf, spec being a complete host
+// conversion specification.
+#define PUT_FORMATTED(out, spec, ...)                                          \
+  do {                                                                         \
+    const int _len = snprintf(NULL, 0, spec, __VA_ARGS__);                     \
+    char *_text = malloc(_len + 1);                                            \
+    snprintf(_text, _len + 1, spec, __VA_ARGS__);                              \
+    put(out, _text, _len);                                                     \
+    free(_text);                                                               \
+  } while (0)
+
+// vsnprintf over the program's memory, its va_list being a pointer to the
+// arguments as llvm-mos lays them out on the soft stack: packed, in order,
+// each its own size after the default promotions (int is 2 bytes). Lengths
+// and conversions are those of mos-platform/common/c/printf.cc without
+// _PRINTF_FLOAT, and a bad conversion is copied out as it is there.
+static bool semihostVsnprintf(uint8_t *memory, uint16_t s, uint16_t n,
+                              uint16_t format, uint16_t ap,
+                              uint16_t *result) {
+  Output out = {memory, s, n, 0};
+  for (;;) {
+    const char c = memory[format];
+    if (!c)
+      break;
+    if (c != '%') {
+      put(&out, &c, 1);
+      ++format;
+      continue;
+    }
+
+    uint16_t spec = format + 1;
+    if (memory[spec] == '%') {
+      put(&out, "%", 1);
+      format = spec + 1;
+      continue;
+    }
+
+    char hostSpec[32] = "%";
+    size_t h = 1;
+    while (memory[spec] && strchr("-+# 0", memory[spec])) {
+      if (h < 7)
+        hostSpec[h++] = memory[spec];
+      ++spec;
+    }
+
+    int width = 0;
+    if (memory[spec] == '*') {
+      width = (int16_t)read16(memory, ap);
+      ap += 2;
+      if (width < 0) {
+        hostSpec[h++] = '-';
+        width = -width;
+      }
+      ++spec;
+    } else {
+      while (memory[spec] >= '0' && memory[spec] <= '9')
+        width = width * 10 + memory[spec++] - '0';
+    }
+
+    int prec = -1;
+    if (memory[spec] == '.') {
+      ++spec;
+      if (memory[spec] == '*') {
+        prec = (int16_t)read16(memory, ap);
+        ap += 2;
+        ++spec;
+      } else {
+        prec = 0;
+        while (memory[spec] >= '0' && memory[spec] <= '9')
+          prec = prec * 10 + memory[spec++] - '0';
+      }
+    }
+    if (width)
+      h += sprintf(hostSpec + h, "%d", width);
+    if (prec >= 0)
+      h += sprintf(hostSpec + h, ".%d", prec);
+
+    // Bytes in the value, and bytes it takes on the stack.
+    int dstSize = 2, srcSize = 2;
+    bool longDouble = false;
+    switch (memory[spec++]) {
+    case 'h':
+      if (memory[spec] == 'h') {
+        dstSize = 1;
+        ++spec;
+      }
+      break;
+    case 'l':
+      dstSize = srcSize = 4;
+      if (memory[spec] == 'l') {
+        dstSize = srcSize = 8;
+        ++spec;
+      }
+      break;
+    case 'j':
+      dstSize = srcSize = 8;
+      break;
+    case 'z':
+    case 't':
+      break;
+    case 'L':
+      longDouble = true;
+      break;
+    default:
+      --spec;
+      break;
+    }
+
+    const char conv = memory[spec];
+    switch (conv) {
+    case 'd':
+    case 'i': {
+      const int shift = 64 - 8 * dstSize;
+      const int64_t value = (int64_t)(readN(memory, ap, srcSize) << shift) >> shift;
+      ap += srcSize;
+      strcpy(hostSpec + h, PRId64);
+      PUT_FORMATTED(&out, hostSpec, value);
+      break;
+    }
+    case 'o':
+    case 'u':
+    case 'x':
+    case 'X':
+    case 'p': {
+      uint64_t value = readN(memory, ap, srcSize);
+      if (dstSize < 8)
+        value &= ((uint64_t)1 << 8 * dstSize) - 1;
+      ap += srcSize;
+      if (conv == 'p') {
+        // printf.cc prints a pointer as %#x.
+        memmove(hostSpec + 2, hostSpec + 1, h);
+        hostSpec[1] = '#';
+        ++h;
+      }
+      strcpy(hostSpec + h, conv == 'o'   ? PRIo64
+                           : conv == 'u' ? PRIu64
+                           : conv == 'X' ? PRIX64
+                                         : PRIx64);
+      PUT_FORMATTED(&out, hostSpec, value);
+      break;
+    }
+    case 'c':
+      strcpy(hostSpec + h, "c");
+      PUT_FORMATTED(&out, hostSpec, (char)memory[ap]);
+      ap += 2;
+      break;
+    case 's': {
+      // Only as much of the string as the precision reaches is read.
+      const uint16_t str = read16(memory, ap);
+      ap += 2;
+      size_t len = 0;
+      while ((prec < 0 || len < (size_t)prec) && len < 0x10000 &&
+             memory[(uint16_t)(str + len)])
+        ++len;
+      char *text = malloc(len + 1);
+      for (size_t k = 0; k < len; ++k)
+        text[k] = memory[(uint16_t)(str + k)];
+      text[len] = '\0';
+      strcpy(hostSpec + h, "s");
+      PUT_FORMATTED(&out, hostSpec, text);
+      free(text);
+      break;
+    }
+    case 'n':
+      write16(memory, read16(memory, ap), out.i);
+      ap += 2;
+      break;
+    case 'a':
+    case 'A':
+    case 'e':
+    case 'E':
+    case 'f':
+    case 'F':
+    case 'g':
+    case 'G':
+      fprintf(stderr, "Semihosted printf can't format %%%s%c.\n",
+              longDouble ? "L" : "", conv);
+      return false;
+    default:
+      // Not a conversion: the '%' goes out as it is, then what follows.
+      put(&out, "%", 1);
+      ++format;
+      continue;
+    }
+    format = spec + 1;
+  }
+  if (out.i < out.n)
+    memory[(uint16_t)(out.s + out.i)] = '\0';
+  *result = out.i;
+  return true;
+}
+
+bool semihostCall(uint8_t *memory, uint16_t block) {
+  uint16_t args[4];
+  for (int i = 0; i < 4; ++i)
+    args[i] = read16(memory, block + 1 + 2 * i);
+  uint16_t result = 0;
+
+  switch (memory[block]) {
+  case kSemihostMemcpy:
+    for (uint16_t i = 0; i < args[2]; ++i)
+      memory[(uint16_t)(args[0] + i)] = memory[(uint16_t)(args[1] + i)];
+    result = args[0];
+    break;
+  case kSemihostMemset:
+    for (uint16_t i = 0; i < args[2]; ++i)
+      memory[(uint16_t)(args[0] + i)] = args[1];
+    result = args[0];
+    break;
+  case kSemihostStrlen:
+    while (memory[(uint16_t)(args[0] + result)] && result < 0xffff)
+      ++result;
+    break;
+  case kSemihostVsnprintf:
+    if (!semihostVsnprintf(memory, args[0], args[1], args[2], args[3],
+                           &result))
+      return false;
+    break;
+  default:
+    fprintf(stderr, "Unknown semihost call %d at $%04x.\n", memory[block],
+            block);
+    return false;
+  }
+
+  write16(memory, block + 9, result);
+  return true;
+}
@@ -0,0 +1,36 @@
+// Semihosted libc for mos-sim (--semihost).
+//
+// A sim program linked with -lsemihost (mos-platform/sim/semihost.c) hands
+// memcpy, memset, strlen and the formatting behind the printf family to the
+// simulator, which runs them on memory[] directly. Test suites that spend
+// their cycles in libc they aren't testing then run far faster. The calls
+// take no simulated cycles, so cycle counts and profiles of such a program
+// are meaningless: mos-sim refuses them without --semihost, and mos-bench
+// aborts on them.
+//
+// The program writes the address of a call block to $FFF2, low byte then
+// high, and the second write makes the call. The block is:
+//
+//   +0  op, a SemihostOp
+//   +1  up to four 16-bit little-endian arguments
+//   +9  the 16-bit result, written back by the simulator
+
+#ifndef SEMIHOST_H
+#define SEMIHOST_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum {
+  kSemihostMemcpy = 1,    // (dst, src, n) -> dst
+  kSemihostMemset = 2,    // (dst, c, n) -> dst
+  kSemihostStrlen = 3,    // (s) -> length
+  kSemihostVsnprintf = 4, // (s, n, format, va_list) -> length, as vsnprintf
+} SemihostOp;
+
+// Perform the call whose block is at address in memory. Prints an error to
+// stderr and returns false if the op is unknown or a format needs something
+// the host doesn't do (floating point).
+bool semihostCall(uint8_t *memory, uint16_t block);
+
+#endif // not SEMIHOST_H
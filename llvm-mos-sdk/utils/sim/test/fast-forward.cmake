@@ -0,0 +1,58 @@
+# Runs each mattbrew ROM in ROMS (comma-separated) under MOS_SIM with and
+# without --no-fast-forward, and fails unless the cycle counts match.
+#
+# The ROMs fill $FF00-$FFFF and wait on VIA timer 1 seven times, each pass
+# of the wait an idle loop for mos-sim to skip:
+#
+# idle-one-shot.rom re-arms a one-shot T1 each time:
+#   FF00  A2 07     LDX #7
+#   FF02  A9 33     LDA #$33
+#   FF04  8D 04 E0  STA $E004   ; T1 latch low
+#   FF07  A9 02     LDA #$02
+#   FF09  8D 05 E0  STA $E005   ; T1 counter high: starts it
+#   FF0C  2C 0D E0  BIT $E00D   ; IFR bit 6, T1
+#   FF0F  50 FB     BVC $FF0C
+#   FF11  CA        DEX
+#   FF12  D0 EE     BNE $FF02
+#   FF14  4C 14 FF  JMP $FF14   ; exit
+#
+# idle-continuous.rom runs T1 free and clears its flag each time:
+#   FF00  A9 40     LDA #$40
+#   FF02  8D 0B E0  STA $E00B   ; ACR: T1 continuous
+#   FF05  A9 33     LDA #$33
+#   FF07  8D 04 E0  STA $E004
+#   FF0A  A9 02     LDA #$02
+#   FF0C  8D 05 E0  STA $E005
+#   FF0F  A2 07     LDX #7
+#   FF11  AD 0D E0  LDA $E00D
+#   FF14  29 40     AND #$40
+#   FF16  F0 F9     BEQ $FF11
+#   FF18  AD 04 E0  LDA $E004   ; T1 counter low: clears the flag
+#   FF1B  CA        DEX
+#   FF1C  D0 F3     BNE $FF11
+#   FF1E  4C 1E FF  JMP $FF1E
+#
+# Both have their vectors at $FF00.
+
+string(REPLACE "," ";" ROMS "${ROMS}")
+
+foreach(rom ${ROMS})
+  set(counts "")
+  foreach(flag "" --no-fast-forward)
+    execute_process(COMMAND ${MOS_SIM} --machine mattbrew --cycles ${flag} ${rom}
+      OUTPUT_VARIABLE output
+      ERROR_VARIABLE error
+      RESULT_VARIABLE result)
+    if(NOT result EQUAL 0)
+      message(FATAL_ERROR "${rom} failed (${result}):\n${output}${error}")
+    endif()
+    string(REGEX MATCH "[0-9]+ cycles" total "${error}")
+    list(APPEND counts "${total}")
+  endforeach()
+  list(GET counts 0 fast)
+  list(GET counts 1 slow)
+  if(NOT fast STREQUAL slow)
+    message(FATAL_ERROR "${rom}: ${fast} fast-forwarded, ${slow} without")
+  endif()
+  message("${rom}: ${fast}")
+endforeach()
@@ -0,0 +1,184 @@
+#include "trace.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "profile.h"
+
+enum {
+  kPcFull = 3,
+  kOpcode = 1 << 2,
+  kA = 1 << 3,
+  kX = 1 << 4,
+  kY = 1 << 5,
+  kSp = 1 << 6,
+  kStatus = 1 << 7,
+};
+
+// What each end of a stream remembers of its past: the last record, and the
+// opcode last seen at each pc (0x100 | opcode, 0 for none yet).
+typedef struct {
+  TraceRecord last;
+  uint16_t opcodeAt[65536];
+} TraceState;
+
+static TraceRecord *ring;
+static unsigned ringSize, ringNext;
+static bool ringFull;
+
+static FILE *traceFile;
+static TraceState writer, reader;
+
+// The newest record, whose instruction may still be running, and where it
+// lives when there's no ring.
+static TraceRecord *pending, scratch;
+
+bool traceSetRing(unsigned size) {
+  free(ring);
+  ring = size ? calloc(size, sizeof(TraceRecord)) : NULL;
+  ringSize = ring ? size : 0;
+  ringNext = 0;
+  ringFull = false;
+  return ring || !size;
+}
+
+bool traceOpenFile(const char *filename) {
+  traceFile = fopen(filename, "wb");
+  if (!traceFile) {
+    fprintf(stderr, "Could not open '%s': ", filename);
+    perror(NULL);
+    return false;
+  }
+  fputs(TRACE_MAGIC, traceFile);
+  return true;
+}
+
+static void writeRecord(const TraceRecord *r) {
+  TraceRecord *last = &writer.last;
+  uint8_t buf[10];
+  int len = 1;
+
+  const uint16_t step = r->pc - last->pc;
+  uint8_t flags = step >= 1 && step <= 3 ? step - 1 : kPcFull;
+  if (flags == kPcFull) {
+    buf[len++] = r->pc & 0xff;
+    buf[len++] = r->pc >> 8;
+  }
+  if (writer.opcodeAt[r->pc] != (0x100 | r->opcode)) {
+    writer.opcodeAt[r->pc] = 0x100 | r->opcode;
+    flags |= kOpcode;
+    buf[len++] = r->opcode;
+  }
+#define FIELD(flag, field)                                                     \
+  if (r->field != last->field) {                                               \
+    flags |= flag;                                                             \
+    buf[len++] = r->field;                                                     \
+  }
+  FIELD(kA, a)
+  FIELD(kX, x)
+  FIELD(kY, y)
+  FIELD(kSp, sp)
+  FIELD(kStatus, status)
+#undef FIELD
+  buf[0] = flags;
+  buf[len++] = r->cycles;
+  fwrite(buf, 1, len, traceFile);
+  *last = *r;
+}
+
+TraceRecord *traceBegin(void) {
+  if (pending && traceFile)
+    writeRecord(pending);
+  pending = &scratch;
+  if (ring) {
+    pending = &ring[ringNext];
+    if (++ringNext == ringSize) {
+      ringNext = 0;
+      ringFull = true;
+    }
+  }
+  pending->cycles = 0;
+  return pending;
+}
+
+void traceDumpRing(FILE *file) {
+  if (!ring)
+    return;
+  const unsigned count = ringFull ? ringSize : ringNext;
+  fprintf(file, "Last %u instructions:\n", count);
+  for (unsigned i = 0; i < count; ++i)
+    traceFormat(file, &ring[(ringFull ? ringNext + i : i) % ringSize]);
+}
+
+void traceClose(void) {
+  if (traceFile) {
+    if (pending)
+      writeRecord(pending);
+    fclose(traceFile);
+    traceFile = NULL;
+  }
+}
+
+bool traceRead(FILE *file, TraceRecord *record) {
+  TraceRecord *last = &reader.last;
+  const int flags = getc(file);
+  if (flags == EOF)
+    return false;
+
+  // A record cut short means the program died mid-write; end there.
+#define BYTE(dest)                                                             \
+  {                                                                            \
+    const int c = getc(file);                                                  \
+    if (c == EOF)                                                              \
+      return false;                                                            \
+    dest = c;                                                                  \
+  }
+  TraceRecord r = *last;
+  if ((flags & 3) == kPcFull) {
+    uint8_t lo, hi;
+    BYTE(lo)
+    BYTE(hi)
+    r.pc = lo | hi << 8;
+  } else {
+    r.pc += (flags & 3) + 1;
+  }
+  if (flags & kOpcode) {
+    BYTE(r.opcode)
+    reader.opcodeAt[r.pc] = 0x100 | r.opcode;
+  } else {
+    r.opcode = reader.opcodeAt[r.pc] & 0xff;
+  }
+  if (flags & kA)
+    BYTE(r.a)
+  if (flags & kX)
+    BYTE(r.x)
+  if (flags & kY)
+    BYTE(r.y)
+  if (flags & kSp)
+    BYTE(r.sp)
+  if (flags & kStatus)
+    BYTE(r.status)
+  BYTE(r.cycles)
+#undef BYTE
+
+  *last = *record = r;
+  return true;
+}
+
+void traceFormat(FILE *file, const TraceRecord *r) {
+  static const char statuses[] = "czidb1vn";
+  char status[9];
+  for (int i = 0; i < 8; ++i)
+    status[7 - i] = r->status & (1 << i) ? statuses[i] : '.';
+  status[8] = '\0';
+
+  fprintf(file,
+          "%04x a:%02x x:%02x y:%02x s:%02x st:%02x (%s) op:%02x cycles:%u",
+          r->pc, r->a, r->x, r->y, r->sp, r->status, status, r->opcode,
+          r->cycles);
+  uint16_t offset;
+  const char *name = profileSymbolAt(r->pc, &offset);
+  if (name)
+    fprintf(file, " %s+%u", name, offset);
+  fputc('\n', file);
+}
@@ -0,0 +1,57 @@
+// Binary instruction trace for mos-sim.
+//
+// Each instruction is one record of the state it ran from and the cycles it
+// took. mos-sim keeps the last few in a ring, printed when the program
+// aborts, and can stream them all to a file, delta-compressed, for mos-trace
+// to print. A streamed record is a header byte of flags, then only what the
+// flags say changed:
+//
+//   bits 0-1: pc is the last one plus 1, 2 or 3; 3 = a full pc follows
+//   bit 2:    an opcode follows; otherwise it's the last one seen at this pc
+//   bits 3-7: a, x, y, sp, status follow, in that order
+//
+// and last, always, a byte of cycles. The file starts with TRACE_MAGIC.
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define TRACE_MAGIC "MOSTRAC1"
+
+typedef struct {
+  uint16_t pc;
+  uint8_t opcode, a, x, y, sp, status;
+  uint8_t cycles; // capped at 255
+} TraceRecord;
+
+// Keep the last |size| records in memory. Returns false if out of memory.
+bool traceSetRing(unsigned size);
+
+// Stream every record to |filename|. Prints an error and returns false if it
+// can't be created.
+bool traceOpenFile(const char *filename);
+
+// Start the record of the instruction about to run. The caller fills it in,
+// then sets its cycles once the instruction has run. Until the next call it
+// is the newest record, so the instruction that aborts a program is kept,
+// with 0 cycles.
+TraceRecord *traceBegin(void);
+
+// Print the ring, oldest record first, in traceFormat()'s format.
+void traceDumpRing(FILE *file);
+
+// Flush and close the trace file, if any.
+void traceClose(void);
+
+// Read the next record of a trace file, after its magic. Returns false at the
+// end of the file.
+bool traceRead(FILE *file, TraceRecord *record);
+
+// One line of text for a record, with the symbol covering its pc if
+// profile.c has symbols loaded.
+void traceFormat(FILE *file, const TraceRecord *record);
+
+#endif // TRACE_H
@@ -0,0 +1,163 @@
+//! Bus captures from the Pico's logic analyzer (firmware built with
+//! BRIDGE_BUS_CAPTURE; see "Bus Capture" in protocol.md): the Device 1
+//! ['B'] TLVs of one capture put back together, summed up into bus
+//! utilisation, and written out as a VCD for a waveform viewer.
+
+use std::fs::File;
+use std::io::{self, BufWriter, Write};
+use std::path::Path;
+
+/// Triggers, as the Device 0 ['B', trigger, arg] that arms a capture has them.
+pub const TRIGGER_NOW: u8 = 0;
+pub const TRIGGER_BYTE: u8 = 1;
+pub const TRIGGER_STALL: u8 = 2;
+
+/// A sample's bits are GPIO 0-15.
+const RW: u16 = 1 << 0;
+const CS_N: u16 = 1 << 1;
+const STAT_CS_N: u16 = 1 << 5;
+const D_SHIFT: u32 = 6;
+
+/// One capture, a sample per 6502 cycle, oldest first.
+pub struct Capture {
+    pub trigger: u8,
+    pub samples: Vec<u16>,
+    /// The first sample after the trigger.
+    pub trigger_index: usize,
+    pub clk_khz: u16,
+}
+
+/// What the cycles of a capture were spent on.
+pub struct Usage {
+    pub cycles: usize,
+    /// Cycles the bridge was selected in, reading and writing.
+    pub reads: usize,
+    pub writes: usize,
+    /// Bridge reads that returned 0xFF: the 6502 polling for a response.
+    pub polls: usize,
+    /// Status port reads.
+    pub status_reads: usize,
+}
+
+impl Capture {
+    fn data(sample: u16) -> u8 {
+        (sample >> D_SHIFT) as u8
+    }
+
+    pub fn trigger_name(&self) -> &'static str {
+        match self.trigger {
+            TRIGGER_NOW => "now",
+            TRIGGER_BYTE => "start byte",
+            TRIGGER_STALL => "stalled read",
+            _ => "?",
+        }
+    }
+
+    pub fn usage(&self) -> Usage {
+        let mut u = Usage { cycles: self.samples.len(), reads: 0, writes: 0, polls: 0, status_reads: 0 };
+        for &s in &self.samples {
+            if s & CS_N == 0 {
+                if s & RW != 0 {
+                    u.reads += 1;
+                    if Self::data(s) == 0xFF {
+                        u.polls += 1;
+                    }
+                } else {
+                    u.writes += 1;
+                }
+            } else if s & STAT_CS_N == 0 {
+                u.status_reads += 1;
+            }
+        }
+        u
+    }
+
+    /// Write the capture as a Value Change Dump, a clock period per
+    /// sample, with PHI2 rebuilt around the samples (all taken with it high).
+    pub fn write_vcd(&self, path: &Path) -> io::Result<()> {
+        let mut out = BufWriter::new(File::create(path)?);
+        let period = 1_000_000 / u64::from(self.clk_khz.max(1));
+        writeln!(out, "$version shein bus capture $end")?;
+        writeln!(out, "$timescale 1 ns $end")?;
+        writeln!(out, "$scope module bus $end")?;
+        for (id, name, width) in
+            [('!', "phi2", 1), ('"', "rw", 1), ('#', "cs_n", 1), ('$', "stat_cs_n", 1), ('%', "d", 8), ('&', "trigger", 1)]
+        {
+            writeln!(out, "$var wire {width} {id} {name} $end")?;
+        }
+        writeln!(out, "$upscope $end")?;
+        writeln!(out, "$enddefinitions $end")?;
+
+        let mut last: Option<u16> = None;
+        for (i, &s) in self.samples.iter().enumerate() {
+            let t = i as u64 * period;
+            writeln!(out, "#{t}")?;
+            writeln!(out, "1!")?;
+            let changed = last.map_or(u16::MAX, |l| l ^ s);
+            if changed & RW != 0 {
+                writeln!(out, "{}\"", (s & RW != 0) as u8)?;
+            }
+            if changed & CS_N != 0 {
+                writeln!(out, "{}#", (s & CS_N != 0) as u8)?;
+            }
+            if changed & STAT_CS_N != 0 {
+                writeln!(out, "{}$", (s & STAT_CS_N != 0) as u8)?;
+            }
+            if last.is_none() || Self::data(changed) != 0 {
+                writeln!(out, "b{:08b} %", Self::data(s))?;
+            }
+            if i == 0 || i == self.trigger_index || i == self.trigger_index + 1 {
+                writeln!(out, "{}&", (i == self.trigger_index) as u8)?;
+            }
+            writeln!(out, "#{}", t + period / 2)?;
+            writeln!(out, "0!")?;
+            last = Some(s);
+        }
+        writeln!(out, "#{}", self.samples.len() as u64 * period)?;
+        out.flush()
+    }
+}
+
+/// Puts a capture back together from its TLVs: a header, then the samples
+/// in order.
+#[derive(Default)]
+pub struct CaptureAssembler {
+    capture: Option<Capture>,
+    expected: usize,
+}
+
+impl CaptureAssembler {
+    /// Take one ['B', ...] TLV. Returns the capture once its last sample
+    /// is in; a TLV that doesn't follow on drops the capture.
+    pub fn feed(&mut self, data: &[u8]) -> Result<Option<Capture>, String> {
+        let u16_at = |i: usize| u16::from_le_bytes([data[i], data[i + 1]]);
+        match data.get(1) {
+            Some(b'H') if data.len() >= 9 => {
+                self.expected = u16_at(3) as usize;
+                self.capture = Some(Capture {
+                    trigger: data[2],
+                    samples: Vec::with_capacity(self.expected),
+                    trigger_index: u16_at(5) as usize,
+                    clk_khz: u16_at(7),
+                });
+            }
+            Some(b'D') if data.len() >= 4 && data.len() % 2 == 0 => {
+                let Some(capture) = &mut self.capture else {
+                    return Err("capture data without a header".to_string());
+                };
+                let offset = u16_at(2) as usize;
+                if offset != capture.samples.len() {
+                    let have = capture.samples.len();
+                    self.capture = None;
+                    return Err(format!("capture lost samples from {have}"));
+                }
+                capture.samples.extend(data[4..].chunks_exact(2).map(|c| u16::from_le_bytes([c[0], c[1]])));
+            }
+            _ => return Err(format!("bad capture TLV ({} bytes)", data.len())),
+        }
+        if self.capture.as_ref().is_some_and(|c| c.samples.len() >= self.expected) {
+            return Ok(self.capture.take());
+        }
+        Ok(None)
+    }
+}
@@ -0,0 +1,166 @@
+//! Device 2 raw key events (protocol.md, "Raw key events"): once the 6502
+//! sends a keyboard packet ['R', 1], keys go to it as 2-byte [code][flags]
+//! records, down and up, in place of characters and ANSI escapes.
+
+use std::collections::VecDeque;
+
+use crossterm::event::{KeyCode, KeyEvent, KeyEventKind, KeyModifiers, ModifierKeyCode};
+
+// Flags byte
+const KEY_SHIFT: u8 = 0x01;
+const KEY_CTRL: u8 = 0x02;
+const KEY_ALT: u8 = 0x04;
+const KEY_SUPER: u8 = 0x08;
+pub const KEY_RELEASED: u8 = 0x80;
+
+// Codes 0x80 and up: the keys with no character
+const KEY_UP: u8 = 0x80;
+const KEY_DOWN: u8 = 0x81;
+const KEY_RIGHT: u8 = 0x82;
+const KEY_LEFT: u8 = 0x83;
+const KEY_HOME: u8 = 0x84;
+const KEY_END: u8 = 0x85;
+const KEY_PAGE_UP: u8 = 0x86;
+const KEY_PAGE_DOWN: u8 = 0x87;
+const KEY_INSERT: u8 = 0x88;
+const KEY_DELETE: u8 = 0x89;
+const KEY_F0: u8 = 0x90; // KEY_F0 + n is Fn: F5 to F12, F1-F4 being shein's
+const KEY_LSHIFT: u8 = 0xA0;
+const KEY_RSHIFT: u8 = 0xA1;
+const KEY_LCTRL: u8 = 0xA2;
+const KEY_RCTRL: u8 = 0xA3;
+const KEY_LALT: u8 = 0xA4;
+const KEY_RALT: u8 = 0xA5;
+const KEY_LSUPER: u8 = 0xA6;
+const KEY_RSUPER: u8 = 0xA7;
+
+/// The record for a key going down or up, None for keys with no code.
+/// Letters are always lower case, with shift in the flags, so a key comes
+/// up with the code it went down with whatever happened to shift between.
+pub fn record(key: &KeyEvent) -> Option<[u8; 2]> {
+    let mut flags = 0;
+    let code = match key.code {
+        KeyCode::Char(c) if c.is_ascii_uppercase() => {
+            flags |= KEY_SHIFT;
+            c.to_ascii_lowercase() as u8
+        }
+        KeyCode::Char(c) if (' '..='~').contains(&c) => c as u8,
+        KeyCode::Backspace => 0x08,
+        KeyCode::Tab | KeyCode::BackTab => 0x09,
+        KeyCode::Enter => 0x0A,
+        KeyCode::Esc => 0x1B,
+        KeyCode::Up => KEY_UP,
+        KeyCode::Down => KEY_DOWN,
+        KeyCode::Right => KEY_RIGHT,
+        KeyCode::Left => KEY_LEFT,
+        KeyCode::Home => KEY_HOME,
+        KeyCode::End => KEY_END,
+        KeyCode::PageUp => KEY_PAGE_UP,
+        KeyCode::PageDown => KEY_PAGE_DOWN,
+        KeyCode::Insert => KEY_INSERT,
+        KeyCode::Delete => KEY_DELETE,
+        KeyCode::F(n @ 5..=12) => KEY_F0 + n,
+        KeyCode::Modifier(m) => match m {
+            ModifierKeyCode::LeftShift => KEY_LSHIFT,
+            ModifierKeyCode::RightShift => KEY_RSHIFT,
+            ModifierKeyCode::LeftControl => KEY_LCTRL,
+            ModifierKeyCode::RightControl => KEY_RCTRL,
+            ModifierKeyCode::LeftAlt => KEY_LALT,
+            ModifierKeyCode::RightAlt => KEY_RALT,
+            ModifierKeyCode::LeftSuper => KEY_LSUPER,
+            ModifierKeyCode::RightSuper => KEY_RSUPER,
+            _ => return None,
+        },
+        _ => return None,
+    };
+    let mods = key.modifiers;
+    for (m, f) in [
+        (KeyModifiers::SHIFT, KEY_SHIFT),
+        (KeyModifiers::CONTROL, KEY_CTRL),
+        (KeyModifiers::ALT, KEY_ALT),
+        (KeyModifiers::SUPER, KEY_SUPER),
+    ] {
+        if mods.contains(m) {
+            flags |= f;
+        }
+    }
+    if key.code == KeyCode::BackTab {
+        flags |= KEY_SHIFT;
+    }
+    if key.kind == KeyEventKind::Release {
+        flags |= KEY_RELEASED;
+    }
+    Some([code, flags])
+}
+
+/// Queue `record` for device 2 in the last TLV of `queue` while it has
+/// room, else in a new one: the events between two WRITEs go out as one
+/// TLV, which the 6502 takes in one read. The TLVs are still a byte
+/// stream to the 6502, so what the last one held before doesn't matter;
+/// a Device 0 marker (protocol v8) is left as it is, though.
+pub fn queue_record(queue: &mut VecDeque<Vec<u8>>, record: [u8; 2], max_data: usize) {
+    if let Some(tlv) = queue.back_mut()
+        && tlv[0] == 2
+        && tlv.len() - 2 + record.len() <= max_data
+    {
+        tlv.extend_from_slice(&record);
+        tlv[1] += record.len() as u8;
+        return;
+    }
+    let mut tlv = vec![2, record.len() as u8];
+    tlv.extend_from_slice(&record);
+    queue.push_back(tlv);
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn key(code: KeyCode, modifiers: KeyModifiers, kind: KeyEventKind) -> KeyEvent {
+        KeyEvent::new_with_kind(code, modifiers, kind)
+    }
+
+    #[test]
+    fn records_fold_letters_and_mark_releases() {
+        let press = key(KeyCode::Char('A'), KeyModifiers::SHIFT, KeyEventKind::Press);
+        let release = key(KeyCode::Char('a'), KeyModifiers::NONE, KeyEventKind::Release);
+        assert_eq!(record(&press), Some([b'a', KEY_SHIFT]));
+        assert_eq!(record(&release), Some([b'a', KEY_RELEASED]));
+
+        let ctrl_up = key(KeyCode::Up, KeyModifiers::CONTROL, KeyEventKind::Press);
+        assert_eq!(record(&ctrl_up), Some([KEY_UP, KEY_CTRL]));
+        let shift = key(
+            KeyCode::Modifier(ModifierKeyCode::LeftShift),
+            KeyModifiers::SHIFT,
+            KeyEventKind::Release,
+        );
+        assert_eq!(record(&shift), Some([KEY_LSHIFT, KEY_SHIFT | KEY_RELEASED]));
+
+        // shein's own F1-F4 have no code
+        assert_eq!(record(&key(KeyCode::F(2), KeyModifiers::NONE, KeyEventKind::Press)), None);
+        assert_eq!(
+            record(&key(KeyCode::F(5), KeyModifiers::NONE, KeyEventKind::Press)),
+            Some([KEY_F0 + 5, 0])
+        );
+    }
+
+    #[test]
+    fn records_batch_into_the_waiting_tlv() {
+        let mut queue = VecDeque::new();
+        for i in 0..9 {
+            queue_record(&mut queue, [b'a' + i, 0], 16);
+        }
+        assert_eq!(queue.len(), 2);
+        assert_eq!(queue[0][..4], [2, 16, b'a', 0]);
+        assert_eq!(queue[0].len(), 18);
+        assert_eq!(queue[1], [2, 2, b'i', 0]);
+    }
+
+    #[test]
+    fn records_leave_a_marker_alone() {
+        let mut queue = VecDeque::from([vec![0, 4, b'D', 2, 7, 0]]);
+        queue_record(&mut queue, [b'a', 0], 16);
+        assert_eq!(queue[0], [0, 4, b'D', 2, 7, 0]);
+        assert_eq!(queue[1], [2, 2, b'a', 0]);
+    }
+}
@@ -0,0 +1,175 @@
+//! SPI clock training. The wiring between the Zero and the Pico sets how
+//! fast the link can run, so rather than a fixed clock, shein tries each of
+//! `RATES_HZ` in turn, sending probes that the Pico echoes back (Device 0
+//! `['P', ...]` in, Device 1 `['P', ...]` out; see protocol.md), and keeps
+//! the fastest rate whose probes all came back intact with no CRC errors or
+//! WRITE NAKs along the way. Once running, errors that bunch up step the
+//! clock down one rate at a time.
+
+use std::collections::VecDeque;
+use std::time::{Duration, Instant};
+
+/// SPI clocks tried, slowest first. The BCM2835 divides its core clock by
+/// an even number, so spidev rounds each down to the nearest it can make.
+pub const RATES_HZ: [u32; 6] = [5_000_000, 8_000_000, 12_000_000, 16_000_000, 20_000_000, 25_000_000];
+/// Where training falls back to if no rate works, e.g. with a Pico that
+/// doesn't echo probes; also the clock before training and after a reset.
+pub const DEFAULT_RATE: usize = 1;
+
+/// Probes per rate, one pattern each.
+pub const PROBE_ROUNDS: u8 = 4;
+/// Pattern bytes per probe, after `['P', rate, round]`.
+const PROBE_PATTERN_LEN: usize = 192;
+/// How long a probe's echo may take before the rate counts as failed.
+pub const PROBE_TIMEOUT: Duration = Duration::from_millis(100);
+
+/// Link errors (READ CRC failures and WRITE NAKs) within `ERROR_WINDOW`
+/// that step the clock down.
+const ERROR_LIMIT: usize = 4;
+const ERROR_WINDOW: Duration = Duration::from_secs(10);
+
+/// The probe for one round at one rate: the rate and round, so a stale
+/// echo can't pass for a new one, then a pattern that exercises the line
+/// in a different way each round.
+pub fn probe(rate: usize, round: u8) -> Vec<u8> {
+    let mut p = Vec::with_capacity(3 + PROBE_PATTERN_LEN);
+    p.extend_from_slice(&[b'P', rate as u8, round]);
+    let mut x = 0x9E37_79B9u32 ^ ((rate as u32) << 8 | round as u32);
+    p.extend((0..PROBE_PATTERN_LEN).map(|i| match round {
+        // Every bit toggling on every clock
+        0 => if i & 1 == 0 { 0x55 } else { 0xAA },
+        // Long runs of each level, then a single bit against them
+        1 => match i % 16 {
+            0..=6 => 0x00,
+            7 => 0x80,
+            8..=14 => 0xFF,
+            _ => 0x7F,
+        },
+        // Walking ones, then a counter
+        2 if i < 64 => 1 << (i % 8),
+        2 => i as u8,
+        // Noise (xorshift)
+        _ => {
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            x as u8
+        }
+    }));
+    p
+}
+
+/// The clock in use, and the recent link errors that might step it down.
+pub struct Link {
+    /// Index into `RATES_HZ`.
+    pub rate: usize,
+    /// The probe sent and not yet echoed.
+    pending: Option<Vec<u8>>,
+    /// The last probe echoed matched what was sent.
+    pub matched: bool,
+    errors: VecDeque<Instant>,
+}
+
+impl Link {
+    pub fn new() -> Self {
+        Self { rate: DEFAULT_RATE, pending: None, matched: false, errors: VecDeque::new() }
+    }
+
+    pub fn hz(&self) -> u32 {
+        RATES_HZ[self.rate]
+    }
+
+    /// Wait for `probe` to come back.
+    pub fn expect(&mut self, probe: Vec<u8>) {
+        self.pending = Some(probe);
+        self.matched = false;
+    }
+
+    pub fn awaiting(&self) -> bool {
+        self.pending.is_some()
+    }
+
+    /// A Device 1 `['P', ...]` echo arrived. One that doesn't match the
+    /// probe sent still ends the wait, since it was either corrupted or
+    /// a late echo of an earlier probe.
+    pub fn echo(&mut self, data: &[u8]) {
+        if let Some(probe) = self.pending.take() {
+            self.matched = probe == data;
+        }
+    }
+
+    /// Settle on `rate`, forgetting errors seen at the old one.
+    pub fn set_rate(&mut self, rate: usize) {
+        self.rate = rate;
+        self.pending = None;
+        self.errors.clear();
+    }
+
+    /// Count `count` link errors seen at `now`. Returns the rate to step
+    /// down to once `ERROR_LIMIT` of them fall within `ERROR_WINDOW`, then
+    /// starts counting afresh at that rate.
+    pub fn note_errors(&mut self, now: Instant, count: u32) -> Option<usize> {
+        for _ in 0..count {
+            self.errors.push_back(now);
+        }
+        while self.errors.front().is_some_and(|&t| now.duration_since(t) > ERROR_WINDOW) {
+            self.errors.pop_front();
+        }
+        if self.errors.len() < ERROR_LIMIT || self.rate == 0 {
+            return None;
+        }
+        self.set_rate(self.rate - 1);
+        Some(self.rate)
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn probes_differ_by_rate_and_round() {
+        let mut seen = Vec::new();
+        for rate in 0..RATES_HZ.len() {
+            for round in 0..PROBE_ROUNDS {
+                let p = probe(rate, round);
+                assert_eq!(p.len(), 3 + PROBE_PATTERN_LEN);
+                assert!(p.len() <= 254, "a probe must fit one TLV");
+                assert!(!seen.contains(&p));
+                seen.push(p);
+            }
+        }
+    }
+
+    #[test]
+    fn echo_must_match() {
+        let mut link = Link::new();
+        link.expect(probe(2, 1));
+        link.echo(&probe(2, 0));
+        assert!(!link.awaiting() && !link.matched);
+        link.expect(probe(2, 1));
+        link.echo(&probe(2, 1));
+        assert!(!link.awaiting() && link.matched);
+    }
+
+    #[test]
+    fn bunched_errors_step_down() {
+        let mut link = Link::new();
+        link.set_rate(3);
+        let t = Instant::now();
+        // Spread out, they never reach the limit
+        for i in 0..10 {
+            assert_eq!(link.note_errors(t + ERROR_WINDOW * i, 1), None);
+        }
+        let t = t + ERROR_WINDOW * 20;
+        assert_eq!(link.note_errors(t, 3), None);
+        assert_eq!(link.note_errors(t + Duration::from_secs(1), 1), Some(2));
+        // Counting starts again at the new rate
+        assert_eq!(link.note_errors(t + Duration::from_secs(2), 1), None);
+        assert_eq!(link.note_errors(t + Duration::from_secs(2), 3), Some(1));
+        assert_eq!(link.note_errors(t + Duration::from_secs(2), 4), Some(0));
+        // Nowhere lower to go
+        assert_eq!(link.note_errors(t + Duration::from_secs(2), 10), None);
+        assert_eq!(link.rate, 0);
+    }
+}
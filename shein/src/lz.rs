@@ -0,0 +1,220 @@
+//! Compression for Device 0 ['Z'] TLVs (protocol v7): the LZ4-style
+//! sequences of binary_format.md's "Compressed sections", cut into chunks
+//! the Pico decodes straight into a device's buffer, as protocol.md
+//! describes under "Compressed data".
+
+const MIN_MATCH: usize = 4;
+const MAX_MATCH: usize = 512;
+const HASH_BITS: u32 = 12;
+
+/// Most bytes one chunk may decode to (the Pico's BUS_LZ_MAX_OUT).
+pub const MAX_CHUNK_OUT: usize = 1024;
+/// Most encoded bytes per chunk: a TLV's data after ['Z'][dev][out LE16].
+pub const MAX_CHUNK_IN: usize = crate::MAX_TLV_DATA - 4;
+
+/// Bytes an LZ4 extended length of `n` takes.
+fn len_bytes(n: usize) -> usize {
+    n / 255 + 1
+}
+
+fn push_len(out: &mut Vec<u8>, mut n: usize) {
+    while n >= 255 {
+        out.push(255);
+        n -= 255;
+    }
+    out.push(n as u8);
+}
+
+/// Encoded size of a sequence of `lits` literals and an optional match of
+/// `m` bytes.
+fn sequence_size(lits: usize, m: Option<usize>) -> usize {
+    let mut n = 1 + lits;
+    if lits >= 15 {
+        n += len_bytes(lits - 15);
+    }
+    if let Some(m) = m {
+        n += 2;
+        if m - MIN_MATCH >= 15 {
+            n += len_bytes(m - MIN_MATCH - 15);
+        }
+    }
+    n
+}
+
+fn push_sequence(out: &mut Vec<u8>, literals: &[u8], m: Option<(usize, usize)>) {
+    let lit_nib = literals.len().min(15) as u8;
+    let match_nib = m.map_or(0, |(_, len)| (len - MIN_MATCH).min(15) as u8);
+    out.push((lit_nib << 4) | match_nib);
+    if literals.len() >= 15 {
+        push_len(out, literals.len() - 15);
+    }
+    out.extend_from_slice(literals);
+    if let Some((offset, len)) = m {
+        out.extend_from_slice(&(offset as u16).to_le_bytes());
+        if len - MIN_MATCH >= 15 {
+            push_len(out, len - MIN_MATCH - 15);
+        }
+    }
+}
+
+/// Chunks being filled, each `(decoded length, sequences)`.
+struct Chunks {
+    done: Vec<(u16, Vec<u8>)>,
+    out: usize,
+    seqs: Vec<u8>,
+}
+
+impl Chunks {
+    fn flush(&mut self) {
+        if !self.seqs.is_empty() {
+            self.done.push((self.out as u16, std::mem::take(&mut self.seqs)));
+            self.out = 0;
+        }
+    }
+
+    fn fits(&self, size: usize, out: usize) -> bool {
+        self.seqs.len() + size <= MAX_CHUNK_IN && self.out + out <= MAX_CHUNK_OUT
+    }
+
+    /// Add `literals` then the match, splitting off literals-only sequences
+    /// (each of which ends its chunk, the decoder stopping there) while the
+    /// whole doesn't fit an empty chunk.
+    fn push(&mut self, mut literals: &[u8], m: Option<(usize, usize)>) {
+        loop {
+            let out = literals.len() + m.map_or(0, |(_, len)| len);
+            if self.fits(sequence_size(literals.len(), m.map(|(_, len)| len)), out) {
+                push_sequence(&mut self.seqs, literals, m);
+                self.out += out;
+                if m.is_none() {
+                    self.flush();
+                }
+                return;
+            }
+            if !self.seqs.is_empty() {
+                self.flush();
+                continue;
+            }
+            let mut n = literals.len().min(MAX_CHUNK_IN - 1);
+            while !self.fits(sequence_size(n, None), n) {
+                n -= 1;
+            }
+            push_sequence(&mut self.seqs, &literals[..n], None);
+            self.out = n;
+            self.flush();
+            literals = &literals[n..];
+        }
+    }
+}
+
+/// Compress `data` into chunks, each `(decoded length, sequences)`.  A
+/// match reaches back at most `window` bytes, and never before the start
+/// of `data`, so the chunks decode right as long as nothing else reaches
+/// the device buffer between them.
+pub fn compress_chunks(data: &[u8], window: usize) -> Vec<(u16, Vec<u8>)> {
+    let mut chunks = Chunks { done: Vec::new(), out: 0, seqs: Vec::new() };
+    let mut table = vec![usize::MAX; 1 << HASH_BITS];
+    let hash = |p: usize| {
+        let v = u32::from_le_bytes([data[p], data[p + 1], data[p + 2], data[p + 3]]);
+        (v.wrapping_mul(2654435761) >> (32 - HASH_BITS)) as usize
+    };
+
+    let mut anchor = 0;
+    let mut pos = 0;
+    while pos + MIN_MATCH <= data.len() {
+        let h = hash(pos);
+        let cand = table[h];
+        table[h] = pos;
+        if cand != usize::MAX
+            && pos - cand <= window
+            && data[cand..cand + MIN_MATCH] == data[pos..pos + MIN_MATCH]
+        {
+            let mut len = MIN_MATCH;
+            while len < MAX_MATCH && pos + len < data.len() && data[cand + len] == data[pos + len] {
+                len += 1;
+            }
+            chunks.push(&data[anchor..pos], Some((pos - cand, len)));
+            pos += len;
+            anchor = pos;
+        } else {
+            pos += 1;
+        }
+    }
+    if anchor < data.len() {
+        chunks.push(&data[anchor..], None);
+    }
+    chunks.flush();
+    chunks.done
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    /// The Pico's decoder, over a history of everything decoded so far.
+    fn decode(history: &mut Vec<u8>, out_len: usize, src: &[u8]) {
+        let target = history.len() + out_len;
+        let mut p = 0;
+        let read_len = |p: &mut usize, n: &mut usize| loop {
+            let b = src[*p];
+            *p += 1;
+            *n += b as usize;
+            if b != 255 {
+                break;
+            }
+        };
+        while history.len() < target {
+            let token = src[p];
+            p += 1;
+            let mut n = (token >> 4) as usize;
+            if n == 15 {
+                read_len(&mut p, &mut n);
+            }
+            history.extend_from_slice(&src[p..p + n]);
+            p += n;
+            if history.len() == target {
+                break;
+            }
+            let offset = u16::from_le_bytes([src[p], src[p + 1]]) as usize;
+            p += 2;
+            let mut n = (token & 15) as usize + MIN_MATCH;
+            if token & 15 == 15 {
+                read_len(&mut p, &mut n);
+            }
+            for _ in 0..n {
+                history.push(history[history.len() - offset]);
+            }
+        }
+        assert_eq!(p, src.len(), "chunk has bytes after its last sequence");
+        assert_eq!(history.len(), target);
+    }
+
+    fn round_trip(data: &[u8]) -> usize {
+        let chunks = compress_chunks(data, 16384);
+        let mut history = Vec::new();
+        for (out, seqs) in &chunks {
+            assert!(*out as usize <= MAX_CHUNK_OUT && seqs.len() <= MAX_CHUNK_IN);
+            decode(&mut history, *out as usize, seqs);
+        }
+        assert_eq!(history, data);
+        chunks.iter().map(|(_, seqs)| seqs.len()).sum()
+    }
+
+    #[test]
+    fn chunks_decode_back() {
+        // Runs, long matches, and noise with no matches at all
+        let mut data = vec![0u8; 5000];
+        data.extend((0..3000u32).map(|i| (i % 251) as u8));
+        let mut x = 1u32;
+        data.extend((0..4000).map(|_| {
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            x as u8
+        }));
+        data.extend_from_slice(b"hello hello hello");
+        let size = round_trip(&data);
+        assert!(size < data.len());
+        round_trip(b"");
+        round_trip(b"abc");
+    }
+}
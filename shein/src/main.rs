@@ -1,74 +1,394 @@
+mod capture;
+mod keys;
+mod link;
+mod lz;
+mod net;
+mod pixels;
+mod push;
 mod spi_master;
+mod spi_thread;
+mod telemetry;
 mod terminal;
+mod trace;
 mod ui;
+#[cfg(target_os = "linux")]
+mod usb_link;
 
-use std::collections::VecDeque;
+use std::collections::{HashMap, VecDeque};
 use std::fs;
-use std::io;
-use std::time::Duration;
+use std::io::{self, Seek, SeekFrom, Write};
+use std::sync::mpsc::{self, Receiver, RecvTimeoutError, SyncSender};
+use std::thread;
+use std::path::PathBuf;
+use std::time::{Duration, Instant, SystemTime, UNIX_EPOCH};
 
 use anyhow::Result;
 use crossterm::ExecutableCommand;
-use crossterm::event::{self, Event, KeyCode, KeyEvent, KeyModifiers};
+use crossterm::event::{
+    self, Event, KeyCode, KeyEvent, KeyEventKind, KeyModifiers, KeyboardEnhancementFlags,
+    PopKeyboardEnhancementFlags, PushKeyboardEnhancementFlags,
+};
 use crossterm::terminal::{
     EnterAlternateScreen, LeaveAlternateScreen, disable_raw_mode, enable_raw_mode,
+    supports_keyboard_enhancement,
 };
 use ratatui::backend::CrosstermBackend;
 
-use spi_master::{IrqWatcher, MAX_PAYLOAD, NUM_DEVICES, SpiMaster};
+use spi_master::{IrqWatcher, MAX_PAYLOAD, NUM_DEVICES, PROTO_V7, PROTO_V8, SpiMaster, open_usb};
+use spi_thread::{Sched, SpiEvent, SpiThread};
+use capture::{CaptureAssembler, TRIGGER_NOW, TRIGGER_STALL};
+use net::{Net, NetEvent};
+use pixels::Pixels;
 use terminal::Terminal;
-use ui::StatusInfo;
+use trace::{KIND_BRIDGE_EVENTS, KIND_HOST, KIND_WRITE, TraceRecorder};
+use ui::{StatusInfo, TerminalView};
 
 const MAX_TLV_DATA: usize = 254; // 255 reserved for busy
 const MAX_KB_TLV_DATA: usize = 16; // Device 2: keyboard — limits 6502-side read buffer requirements
 const MAX_NETBOOT_TLV_DATA: usize = 128; // Device 3: netboot — limits 6502-side read buffer requirements
+const MAX_BLOCK_DATA: usize = MAX_TLV_DATA - 4; // Device 5: block load — data after the 4-byte block header
+const MAX_FILE_READ_TLV_DATA: usize = 128; // Device 6: file read — as netboot
+const BLOCK_RAW: u8 = 0; // Block data goes straight to addr
+const BLOCK_PACKED_START: u8 = 1; // Starts a compressed stream decompressing to addr
+const BLOCK_PACKED_MORE: u8 = 2; // Continues the current compressed stream
+const BLOCK_RELOC: u8 = 3; // Adds a page delta to the bytes a bitmap marks
+const BLOCK_ZERO: u8 = 4; // Clears a 2-byte length of bytes from addr
+const SECTION_COMPRESSED: u8 = 0x01; // Section flag: data is compressed
+const SECTION_RELOCATABLE: u8 = 0x02; // Section flag: a relocation bitmap follows
+const SECTION_ZERO: u8 = 0x04; // Section flag: no data, len bytes of zeros
 const LOG_CAPACITY: usize = 1000;
-const BUS_MAX_BUFFER_SIZE: u16 = 4096; // Per-device buffer capacity on Pico
-
-/// Parse a SPI payload containing complete TLV packets (no straddling).
-fn parse_tlv_payload(payload: &[u8]) -> Vec<(u8, Vec<u8>)> {
-    let mut msgs = Vec::new();
-    let mut pos = 0;
-    while pos + 2 <= payload.len() {
-        let device = payload[pos];
-        let length = payload[pos + 1] as usize;
-        if pos + 2 + length > payload.len() {
-            break;
+const NETBOOT_CACHE_ENTRIES: usize = 8; // Netboot images kept ready to send
+/// Per-device buffer capacity on the Pico (BUS_DEVn_BUFFER_BITS in bridge_defs.h)
+const DEVICE_BUFFER_SIZE: [u16; NUM_DEVICES] = [256, 256, 4096, 16384, 32768, 4096, 1024, 4096];
+/// How long after a push the reset it asks for may come.
+const PUSH_RESET_TIME: Duration = Duration::from_secs(5);
+/// What bootloader.cpp prints when it is ready for a command.
+const BOOTLOADER_PROMPT: &[u8] = b"> ";
+const FRAME_TIME: Duration = Duration::from_millis(16); // Shortest time between redraws while busy
+/// F4 captures the bus around a read the 6502 polls for this long.
+const CAPTURE_STALL_US: u16 = 1000;
+/// Wakeups the main loop may fall behind by; READ payloads are most of
+/// them, so this is the SPI thread's slack over a slow redraw.
+const WAKE_CAPACITY: usize = 1024;
+
+/// Parse a SPI payload containing complete TLV packets (no straddling),
+/// yielding each one's device and data in place. Stops at a TLV cut short.
+fn parse_tlv_payload(payload: &[u8]) -> impl Iterator<Item = (u8, &[u8])> {
+    let mut rest = payload;
+    std::iter::from_fn(move || {
+        let (&device, &length) = (rest.first()?, rest.get(1)?);
+        let data = rest.get(2..2 + length as usize)?;
+        rest = &rest[2 + length as usize..];
+        Some((device, data))
+    })
+}
+
+/// One section of a loadable executable, as stored.
+struct Section<'a> {
+    addr: usize,
+    bank: u8,
+    len: usize,
+    compressed: bool,
+    /// Zero-fill: no data, just `len` bytes to clear.
+    zero: bool,
+    /// The section data, or for a compressed section its stream.
+    data: &'a [u8],
+    /// The relocation bitmap of a relocatable section (empty if zero-fill).
+    reloc: Option<&'a [u8]>,
+}
+
+/// Split a loadable executable (see binary_format.md) into its sections.
+fn parse_sections(image: &[u8]) -> std::result::Result<Vec<Section<'_>>, String> {
+    if image.len() < 6 || image[0] != 0x45 || image[1] != 0x69 || !(1..=4).contains(&image[2]) {
+        return Err("invalid binary magic".to_string());
+    }
+    let version = image[2];
+    let section_count = image[5];
+
+    let mut sections = Vec::new();
+    let mut pos = 6;
+    for section in 0..section_count {
+        let hdr_len = if version >= 2 { 6 } else { 5 };
+        if pos + hdr_len > image.len() {
+            return Err(format!("section {section}: truncated header"));
+        }
+        let addr = u16::from_le_bytes([image[pos], image[pos + 1]]) as usize;
+        let bank = image[pos + 2];
+        let len = u16::from_le_bytes([image[pos + 3], image[pos + 4]]) as usize;
+        let flags = if version >= 2 { image[pos + 5] } else { 0 };
+        let compressed = flags & SECTION_COMPRESSED != 0;
+        let relocatable = version >= 3 && flags & SECTION_RELOCATABLE != 0;
+        let zero = version >= 4 && flags & SECTION_ZERO != 0;
+        pos += hdr_len;
+
+        let stored_len = if zero {
+            0
+        } else if compressed {
+            if pos + 2 > image.len() {
+                return Err(format!("section {section}: truncated header"));
+            }
+            let packed_len = u16::from_le_bytes([image[pos], image[pos + 1]]) as usize;
+            pos += 2;
+            packed_len
+        } else {
+            len
+        };
+        if pos + stored_len > image.len() {
+            return Err(format!("section {section}: truncated data"));
+        }
+        let data = &image[pos..pos + stored_len];
+        pos += stored_len;
+
+        let reloc = if relocatable && zero {
+            Some(&image[pos..pos])
+        } else if relocatable {
+            let bitmap_len = len.div_ceil(8);
+            if pos + bitmap_len > image.len() {
+                return Err(format!("section {section}: truncated relocations"));
+            }
+            pos += bitmap_len;
+            Some(&image[pos - bitmap_len..pos])
+        } else {
+            None
+        };
+        sections.push(Section { addr, bank, len, compressed, zero, data, reloc });
+    }
+    Ok(sections)
+}
+
+/// Turn a loadable executable (see binary_format.md) into block-load TLV
+/// payloads for device 5: `[addr_lo][addr_hi][bank][kind][data...]`,
+/// ending with a data-less block whose address is the entry point.
+/// Compressed sections are forwarded still compressed, as a stream
+/// prefixed by the uncompressed length; the 6502 decompresses it. With a
+/// `page`, relocatable sections move so that the first starts there, each
+/// followed by its relocation bitmap for the 6502 to apply. Zero-fill
+/// sections go as a single block with their length, for the 6502 to clear.
+fn build_load_blocks(image: &[u8], page: Option<u8>) -> std::result::Result<Vec<Vec<u8>>, String> {
+    let sections = parse_sections(image)?;
+    let entrypoint = u16::from_le_bytes([image[3], image[4]]) as usize;
+
+    // Pages to move the relocatable sections by.
+    let delta = match (page, sections.iter().find(|s| s.reloc.is_some())) {
+        (Some(page), Some(first)) => page.wrapping_sub((first.addr >> 8) as u8),
+        _ => 0,
+    };
+    let moved = |addr: usize| (addr + ((delta as usize) << 8)) & 0xFFFF;
+
+    let mut blocks = Vec::new();
+    let mut push_blocks = |addr: usize, bank: u8, kind: u8, data: &[u8]| {
+        // Each relocation block carries the delta ahead of its bitmap.
+        let max = if kind == BLOCK_RELOC { MAX_BLOCK_DATA - 1 } else { MAX_BLOCK_DATA };
+        for (i, chunk) in data.chunks(max).enumerate() {
+            let (block_addr, kind) = match (kind, i) {
+                (BLOCK_RAW, _) => (addr + i * max, BLOCK_RAW),
+                (BLOCK_ZERO, _) => (addr, BLOCK_ZERO),
+                (BLOCK_RELOC, _) => (addr + i * max * 8, BLOCK_RELOC),
+                (_, 0) => (addr, BLOCK_PACKED_START),
+                (_, _) => (addr, BLOCK_PACKED_MORE),
+            };
+            let mut block = Vec::with_capacity(5 + chunk.len());
+            block.extend_from_slice(&(block_addr as u16).to_le_bytes());
+            block.push(bank);
+            block.push(kind);
+            if kind == BLOCK_RELOC {
+                block.push(delta);
+            }
+            block.extend_from_slice(chunk);
+            blocks.push(block);
+        }
+    };
+
+    let mut entry = entrypoint;
+    for (section, s) in sections.iter().enumerate() {
+        let addr = if s.reloc.is_some() { moved(s.addr) } else { s.addr };
+        if addr < 0x0400 || addr + s.len > 0xdfff {
+            return Err(format!("section {section}: 0x{addr:04x}+{} out of bounds", s.len));
+        }
+        if s.reloc.is_some() && (s.addr..s.addr + s.len).contains(&entrypoint) {
+            entry = moved(entrypoint);
+        }
+
+        if s.zero {
+            push_blocks(addr, s.bank, BLOCK_ZERO, &(s.len as u16).to_le_bytes());
+        } else if s.compressed {
+            let mut stream = Vec::with_capacity(2 + s.data.len());
+            stream.extend_from_slice(&(s.len as u16).to_le_bytes());
+            stream.extend_from_slice(s.data);
+            push_blocks(addr, s.bank, BLOCK_PACKED_START, &stream);
+        } else {
+            push_blocks(addr, s.bank, BLOCK_RAW, s.data);
+        }
+        if let Some(reloc) = s.reloc.filter(|_| delta != 0) {
+            push_blocks(addr, s.bank, BLOCK_RELOC, reloc);
         }
-        msgs.push((device, payload[pos + 2..pos + 2 + length].to_vec()));
-        pos += 2 + length;
     }
-    msgs
+
+    let mut end = Vec::with_capacity(4);
+    end.extend_from_slice(&(entry as u16).to_le_bytes());
+    end.push(0xFF);
+    end.push(BLOCK_RAW);
+    blocks.push(end);
+    Ok(blocks)
+}
+
+/// A netboot image framed as device 3 TLVs, length prefix included, with
+/// the file's modification time (None for a pushed image, which has no
+/// file) and size when it was read, and the hash the Pico's flash cache
+/// knows it by.  `ztlvs` is the same stream as Device 0 ['Z'] TLVs, if
+/// compressing makes it smaller.
+struct NetbootImage {
+    modified: Option<SystemTime>,
+    len: u64,
+    hash: u32,
+    tlvs: Vec<Vec<u8>>,
+    ztlvs: Option<Vec<Vec<u8>>>,
+}
+
+impl NetbootImage {
+    fn new(modified: Option<SystemTime>, data: &[u8]) -> Self {
+        let total_len = data.len() as u16;
+        let mut prefixed = Vec::with_capacity(2 + data.len());
+        prefixed.push((total_len >> 8) as u8);
+        prefixed.push((total_len & 0xFF) as u8);
+        prefixed.extend_from_slice(data);
+        Self {
+            modified,
+            len: data.len() as u64,
+            hash: fnv1a(&prefixed),
+            tlvs: frame_tlvs(3, &prefixed),
+            ztlvs: frame_compressed_tlvs(3, &prefixed),
+        }
+    }
+}
+
+/// What has gone to one device, for answering v8 TLV NAKs. The Pico
+/// numbers each TLV for a device as the Zero does, from the last marker.
+#[derive(Default)]
+struct SentTlvs {
+    /// Number of the next TLV taken.
+    seq: u8,
+    /// The TLVs last taken, oldest first, up to twice the device buffer.
+    history: VecDeque<Vec<u8>>,
+    cost: usize,
+    /// Epoch of the last NAK answered; the Pico repeats a NAK until it
+    /// sees the marker.
+    answered: Option<u8>,
+    /// TLVs at the front of the queue being sent again, which the trace
+    /// and the sockets have seen already.
+    resending: usize,
+}
+
+impl SentTlvs {
+    fn keep(&mut self, tlv: Vec<u8>, limit: usize) {
+        self.seq = self.seq.wrapping_add(1);
+        self.cost += tlv_cost(&tlv) as usize;
+        self.history.push_back(tlv);
+        while self.cost > limit || self.history.len() > u8::MAX as usize {
+            let old = self.history.pop_front().unwrap();
+            self.cost -= tlv_cost(&old) as usize;
+        }
+    }
+
+    /// Take back the TLVs from number `from` on, oldest first, with the
+    /// count of those too old to have been kept.
+    fn rewind(&mut self, from: u8) -> (Vec<Vec<u8>>, usize) {
+        let wanted = self.seq.wrapping_sub(from) as usize;
+        let n = wanted.min(self.history.len());
+        let tlvs: Vec<Vec<u8>> = self.history.drain(self.history.len() - n..).collect();
+        self.cost -= tlvs.iter().map(|t| tlv_cost(t) as usize).sum::<usize>();
+        self.seq = self.seq.wrapping_sub(n as u8);
+        (tlvs, wanted - n)
+    }
+
+    fn clear(&mut self) {
+        *self = Self { seq: self.seq, ..Default::default() };
+    }
+}
+
+/// A pushed image on its way to running: once the 6502 has been reset,
+/// its name is typed at the bootloader's first prompt.
+struct PushBoot {
+    name: String,
+    pushed: Instant,
+    reset: bool,
+}
+
+/// FNV-1a over a netboot stream, as the Pico's flash cache hashes it.
+fn fnv1a(data: &[u8]) -> u32 {
+    data.iter()
+        .fold(0x811c_9dc5, |h, &b| (h ^ b as u32).wrapping_mul(0x0100_0193))
 }
 
 struct App {
-    master: SpiMaster,
-    irq: IrqWatcher,
+    spi: SpiThread,
+    /// Per-device estimates of the room in the Pico's buffers.
+    buf: [u16; NUM_DEVICES],
     terminal: Terminal,
+    pixels: Pixels,
+    net: Net,
     log: Vec<String>,
     verbose: bool,
     status: StatusInfo,
     running: bool,
+    /// Something shown changed since the last redraw.
+    dirty: bool,
     /// Per-device outgoing TLV queues (already framed, ready to write).
     tx_queues: [VecDeque<Vec<u8>>; NUM_DEVICES],
+    /// Bytes-freed counts from the last v5 credit TLV (None until one arrives).
+    last_freed: Option<[u16; NUM_DEVICES]>,
+    /// Device (less 2) the next WRITE frame's round-robin starts at.
+    tx_next: usize,
+    /// Per-device TLVs sent, for v8 NAKs.
+    sent: [SentTlvs; NUM_DEVICES],
+    /// Netboot images by name, and the one last booted.
+    netboot_cache: HashMap<String, NetbootImage>,
+    last_netboot: Option<String>,
+    /// The last image pushed, until it has been booted.
+    push_boot: Option<PushBoot>,
+    /// Device trace being recorded (F2).
+    trace: Option<TraceRecorder>,
+    /// A bus capture is armed (F4) and not yet in.
+    capture_armed: bool,
+    capture: CaptureAssembler,
+    /// The 6502 asked for raw key events (a keyboard packet ['R', 1]).
+    raw_keys: bool,
+    /// The terminal reports key releases (the kitty keyboard protocol).
+    key_releases: bool,
 }
 
 impl App {
-    fn new(master: SpiMaster, irq: IrqWatcher) -> Self {
+    fn new(spi: SpiThread, buf: [u16; NUM_DEVICES]) -> Self {
         Self {
             status: StatusInfo {
                 device_status: 0,
-                buf: master.buf,
+                buf,
                 connected: true,
                 verbose: false,
+                tracing: false,
+                telemetry: None,
             },
-            master,
-            irq,
+            spi,
+            buf,
             terminal: Terminal::new(),
+            pixels: Pixels::new(),
+            net: Net::new(),
             log: Vec::new(),
             verbose: false,
             running: true,
+            dirty: true,
             tx_queues: Default::default(),
+            last_freed: None,
+            tx_next: 0,
+            sent: Default::default(),
+            netboot_cache: HashMap::new(),
+            last_netboot: None,
+            push_boot: None,
+            trace: None,
+            capture_armed: false,
+            capture: CaptureAssembler::default(),
+            raw_keys: false,
+            key_releases: false,
         }
     }
 
@@ -77,6 +397,7 @@ impl App {
             self.log.remove(0);
         }
         self.log.push(msg);
+        self.dirty = true;
     }
 
     fn log_verbose(&mut self, msg: String) {
@@ -85,66 +406,275 @@ impl App {
         }
     }
 
-    /// Poll for and handle crossterm keyboard events.
-    fn handle_input(&mut self) -> Result<()> {
-        while event::poll(Duration::ZERO)? {
-            if let Event::Key(key) = event::read()? {
-                if key.kind != event::KeyEventKind::Press {
-                    continue;
+    /// Handle a crossterm event from the input thread.
+    fn handle_input(&mut self, event: Event) {
+        match event {
+            Event::Key(key) => {
+                if key.kind != KeyEventKind::Press {
+                    if self.raw_keys {
+                        self.raw_key(&key);
+                    }
+                    return;
                 }
                 if key.modifiers.contains(KeyModifiers::CONTROL) && key.code == KeyCode::Char('c') {
                     self.running = false;
-                    return Ok(());
+                    return;
                 }
                 if key.code == KeyCode::F(1) {
                     self.verbose = !self.verbose;
                     self.status.verbose = self.verbose;
+                    self.spi.set_verbose(self.verbose);
                     let state = if self.verbose { "ON" } else { "off" };
                     self.log(format!("Verbose mode: {state}"));
-                    continue;
+                    return;
+                }
+                if key.code == KeyCode::F(2) {
+                    self.toggle_trace();
+                    return;
+                }
+                if key.code == KeyCode::F(3) {
+                    self.save_snapshot();
+                    return;
+                }
+                if key.code == KeyCode::F(4) {
+                    self.arm_capture();
+                    return;
                 }
-                if let Some(bytes) = key_to_bytes(&key) {
+                if self.raw_keys {
+                    self.raw_key(&key);
+                } else if let Some(bytes) = key_to_bytes(&key) {
                     self.enqueue_tlv(2, &bytes);
                 }
             }
+            Event::Resize(..) => self.dirty = true,
+            _ => {}
         }
-        Ok(())
     }
 
-    /// Check IRQ and drain all pending SPI data.
-    fn drain_spi(&mut self) -> Result<()> {
-        if !self.irq.is_asserted()? {
-            return Ok(());
+    /// A key going down or up, in raw key mode. A held key is down until it
+    /// comes up, so its repeats are left out. A terminal that can't report
+    /// releases gets each key straight back up.
+    fn raw_key(&mut self, key: &KeyEvent) {
+        if key.kind == KeyEventKind::Repeat {
+            return;
+        }
+        let Some(record) = keys::record(key) else {
+            return;
+        };
+        keys::queue_record(&mut self.tx_queues[2], record, MAX_KB_TLV_DATA);
+        if !self.key_releases {
+            let up = [record[0], record[1] | keys::KEY_RELEASED];
+            keys::queue_record(&mut self.tx_queues[2], up, MAX_KB_TLV_DATA);
         }
+    }
 
-        self.log_verbose(format!("drain_spi: IRQ asserted"));
-        let mut round = 0u32;
-        loop {
-            round += 1;
-            let result = self.master.request_and_read(Duration::from_millis(100))?;
-            match result {
-                Some((payload, _buf)) => {
-                    self.status.buf = self.master.buf;
-                    self.log_verbose(format!(
-                        "drain_spi[{round}]: READ {} payload bytes",
-                        payload.len()
-                    ));
-                    if !payload.is_empty() {
-                        for (device, data) in parse_tlv_payload(&payload) {
-                            self.dispatch_rx(device, &data);
-                        }
-                    }
-                    if payload.len() < MAX_PAYLOAD {
-                        break;
+    /// Switch raw key events on or off. While on, a terminal that can
+    /// report releases is asked to, along with the modifier keys on their
+    /// own and the keys it would otherwise send as plain characters.
+    fn set_raw_keys(&mut self, on: bool) {
+        if on == self.raw_keys {
+            return;
+        }
+        self.raw_keys = on;
+        if self.key_releases {
+            let flags = KeyboardEnhancementFlags::DISAMBIGUATE_ESCAPE_CODES
+                | KeyboardEnhancementFlags::REPORT_EVENT_TYPES
+                | KeyboardEnhancementFlags::REPORT_ALL_KEYS_AS_ESCAPE_CODES;
+            let result = if on {
+                io::stdout().execute(PushKeyboardEnhancementFlags(flags)).map(drop)
+            } else {
+                io::stdout().execute(PopKeyboardEnhancementFlags).map(drop)
+            };
+            if let Err(e) = result {
+                self.log(format!("Keyboard mode switch failed: {e}"));
+            }
+        }
+        let mode = if on { "raw key events" } else { "characters" };
+        self.log_verbose(format!("Keyboard: {mode}"));
+    }
+
+    /// Start recording a device trace to trace-<unix time>.mbtr, or stop.
+    /// A Pico built with BRIDGE_EVENT_TRACE sends its events for the trace
+    /// meanwhile (Device 0 ['T', on]; others ignore it).
+    fn toggle_trace(&mut self) {
+        if let Some(trace) = self.trace.take() {
+            self.status.tracing = false;
+            self.spi.set_tracing(false);
+            self.enqueue_tlv(0, &[b'T', 0]);
+            match trace.finish() {
+                Ok(path) => self.log(format!("Trace saved to {}", path.display())),
+                Err(e) => self.log(format!("Trace: {e}")),
+            }
+            return;
+        }
+        let secs = SystemTime::now().duration_since(UNIX_EPOCH).map_or(0, |d| d.as_secs());
+        let path = PathBuf::from(format!("trace-{secs}.mbtr"));
+        match TraceRecorder::create(&path) {
+            Ok(trace) => {
+                self.trace = Some(trace);
+                self.status.tracing = true;
+                self.spi.set_tracing(true);
+                self.enqueue_tlv(0, &[b'T', 1]);
+                self.log(format!("Tracing to {}", path.display()));
+            }
+            Err(e) => self.log(format!("Trace {}: {e}", path.display())),
+        }
+    }
+
+    /// Save the pixel framebuffer, as shown, to pixels-<unix time>.ppm.
+    fn save_snapshot(&mut self) {
+        let secs = SystemTime::now().duration_since(UNIX_EPOCH).map_or(0, |d| d.as_secs());
+        let path = PathBuf::from(format!("pixels-{secs}.ppm"));
+        match self.pixels.save_ppm(&path) {
+            Ok(()) => self.log(format!("Snapshot saved to {}", path.display())),
+            Err(e) => self.log(format!("Snapshot {}: {e}", path.display())),
+        }
+    }
+
+    /// Arm a bus capture on the next read the 6502 polls for over
+    /// CAPTURE_STALL_US, or if one is armed already, take it now.
+    fn arm_capture(&mut self) {
+        if self.status.telemetry.as_ref().is_some_and(|t| t.build_flags & 0x08 == 0) {
+            self.log("Bus capture: Pico built without BRIDGE_BUS_CAPTURE".to_string());
+            return;
+        }
+        let (trigger, arg) = if self.capture_armed { (TRIGGER_NOW, 0) } else { (TRIGGER_STALL, CAPTURE_STALL_US) };
+        let [lo, hi] = arg.to_le_bytes();
+        self.enqueue_tlv(0, &[b'B', trigger, lo, hi]);
+        if trigger == TRIGGER_NOW {
+            self.log("Bus capture: triggered".to_string());
+        } else {
+            self.log(format!("Bus capture armed: a read stalled {CAPTURE_STALL_US} us (F4 again to take it now)"));
+        }
+        self.capture_armed = true;
+    }
+
+    /// A Device 1 ['B'] TLV of a bus capture: once it is all in, log how
+    /// the bus was used and save it to capture-<unix time>.vcd.
+    fn capture_rx(&mut self, data: &[u8]) {
+        let capture = match self.capture.feed(data) {
+            Ok(Some(capture)) => capture,
+            Ok(None) => return,
+            Err(e) => {
+                self.capture_armed = false;
+                self.log(format!("Bus capture: {e}"));
+                return;
+            }
+        };
+        self.capture_armed = false;
+        let u = capture.usage();
+        let pct = |n: usize| 100.0 * n as f64 / u.cycles.max(1) as f64;
+        self.log(format!(
+            "Bus capture ({}): {} cycles at {} kHz, bridge {:.1}% (reads {:.1}%, writes {:.1}%), 0xFF polls {:.1}%, status port {:.1}%",
+            capture.trigger_name(),
+            u.cycles,
+            capture.clk_khz,
+            pct(u.reads + u.writes),
+            pct(u.reads),
+            pct(u.writes),
+            pct(u.polls),
+            pct(u.status_reads),
+        ));
+        let secs = SystemTime::now().duration_since(UNIX_EPOCH).map_or(0, |d| d.as_secs());
+        let path = PathBuf::from(format!("capture-{secs}.vcd"));
+        match capture.write_vcd(&path) {
+            Ok(()) => self.log(format!("Bus capture saved to {}", path.display())),
+            Err(e) => self.log(format!("Bus capture {}: {e}", path.display())),
+        }
+    }
+
+    /// Add a record to the trace, if one is recording; an error stops it.
+    fn trace(&mut self, kind: u8, device: u8, data: &[u8]) {
+        let Some(trace) = &mut self.trace else {
+            return;
+        };
+        if let Err(e) = trace.record(kind, device, data) {
+            self.trace = None;
+            self.status.tracing = false;
+            self.spi.set_tracing(false);
+            self.log(format!("Trace stopped: {e}"));
+        }
+    }
+
+    /// Add an SPI transaction from `start` to `end` to the trace, if one
+    /// is recording.
+    fn trace_event(&mut self, event: u8, arg: u16, start: Instant, end: Instant) {
+        let Some(trace) = &mut self.trace else {
+            return;
+        };
+        if let Err(e) = trace.event(event, 0xFF, arg, start, end) {
+            self.trace = None;
+            self.status.tracing = false;
+            self.spi.set_tracing(false);
+            self.log(format!("Trace stopped: {e}"));
+        }
+    }
+
+    /// Handle what the SPI thread has for us.
+    fn handle_spi(&mut self, event: SpiEvent) {
+        match event {
+            SpiEvent::Read { payload, buf, writes } => {
+                for (device, data) in parse_tlv_payload(&payload) {
+                    // Devices 0 and 1 here are the Pico's own
+                    if device >= 2 {
+                        self.trace(KIND_WRITE, device, data);
                     }
+                    self.dispatch_rx(device, data);
                 }
-                None => {
-                    self.log(format!("drain_spi[{round}]: READY timeout"));
-                    break;
+                // v5: credits moved the estimate; BUF (sampled by the Pico
+                // before them) still floors it, so bytes lost in transit
+                // don't shrink it for good. Not while WRITEs it can't have
+                // seen are on their way, though, or their room would be
+                // counted twice.
+                if let Some(hdr_buf) = buf.filter(|_| self.spi.settled(writes)) {
+                    for d in 0..NUM_DEVICES {
+                        let est = self.buf[d].max(hdr_buf[d]);
+                        self.buf[d] = est.min(DEVICE_BUFFER_SIZE[d]);
+                    }
                 }
+                self.status.buf = self.buf;
+                self.dirty = true;
             }
+            // The loop sends anything held back
+            SpiEvent::Wrote => {}
+            SpiEvent::Span { event, arg, start, end } => self.trace_event(event, arg, start, end),
+            SpiEvent::Log { verbose: true, msg } => self.log_verbose(msg),
+            SpiEvent::Log { verbose: false, msg } => self.log(msg),
+        }
+    }
+
+    /// Summarize a latency histogram from the Pico (bucket n counts samples
+    /// of [2^n, 2^(n+1)) clk_sys cycles, as little-endian u32s).
+    fn log_latency(&mut self, event: u8, device: u8, data: &[u8]) {
+        let buckets: Vec<u64> = data
+            .chunks_exact(4)
+            .map(|c| u32::from_le_bytes([c[0], c[1], c[2], c[3]]) as u64)
+            .collect();
+        let total: u64 = buckets.iter().sum();
+        if total == 0 {
+            return;
         }
-        Ok(())
+        let percentile = |permille: u64| {
+            let want = (total * permille).div_ceil(1000);
+            let mut seen = 0;
+            for (i, n) in buckets.iter().enumerate() {
+                seen += n;
+                if seen >= want {
+                    return i + 1;
+                }
+            }
+            buckets.len()
+        };
+        let name = match event {
+            0 => "bus read",
+            1 => "Zero->6502",
+            2 => "6502->Zero",
+            _ => "?",
+        };
+        let (p50, p99) = (percentile(500), percentile(990));
+        self.log_verbose(format!(
+            "Latency {name} dev{device}: n={total} p50<2^{p50} p99<2^{p99} cycles"
+        ));
     }
 
     /// Dispatch a received TLV message by device ID.
@@ -155,28 +685,130 @@ impl App {
                 if !data.is_empty() {
                     self.status.device_status = data[0];
                 }
-                if data.len() > 1 {
+                if telemetry::is_telemetry(data) {
+                    match telemetry::parse(data) {
+                        Some(t) => {
+                            self.log_verbose(format!(
+                                "Telemetry: up {}s, bus overruns {}, drops {}, SPI queue peak {}",
+                                t.uptime_ms / 1000,
+                                t.bus_rx_overruns,
+                                t.spi_to_bus_drops,
+                                t.spi_queue_high_water
+                            ));
+                            self.status.telemetry = Some(t);
+                        }
+                        None => self.log_verbose(format!(
+                            "Telemetry: truncated frame ({} bytes, v{})",
+                            data.len(),
+                            data[2]
+                        )),
+                    }
+                } else if data.len() > 1 {
                     // Error string from Pico
                     let msg = String::from_utf8_lossy(&data[1..]);
                     self.log(format!("Pico: {msg}"));
                 }
             }
             1 => {
-                // System control: reset notification from Pico
+                // System control: reset notification / version ack from Pico
                 if data == b"R" {
                     self.handle_pico_reset();
+                } else if data == b"W" {
+                    self.handle_6502_reset();
+                } else if data.len() == 2 && data[0] == b'V' {
+                    // The SPI thread has switched to it, and trains the link
+                    self.log(format!("Protocol v{} negotiated", data[1]));
+                    // A Pico that has just come up has its events off
+                    if self.trace.is_some() {
+                        self.enqueue_tlv(0, &[b'T', 1]);
+                    }
+                    // v8: tell it where each device's numbering is
+                    if data[1] >= PROTO_V8 {
+                        for d in 1..NUM_DEVICES {
+                            let marker = tlv_marker(d as u8, self.sent[d].seq, 0);
+                            self.tx_queues[d].push_front(marker);
+                        }
+                    }
+                } else if data.first() == Some(&b'B') {
+                    self.capture_rx(data);
+                } else if data.first() == Some(&b'T') {
+                    self.trace(KIND_BRIDGE_EVENTS, device, &data[1..]);
+                } else if data.len() >= 3 && data[0] == b'L' {
+                    self.log_latency(data[1], data[2], &data[3..]);
+                } else if data.len() == 1 + 2 * NUM_DEVICES && data[0] == b'K' {
+                    self.apply_credits(&data[1..]);
+                } else if data.len() == 4 && data[0] == b'D' {
+                    self.answer_nak(data[1], data[2], data[3]);
                 }
+                // Probe echoes ['P'] and resend requests ['N'] are the SPI
+                // thread's.
             }
             2 => {
                 // Video output
                 self.log_verbose(format!("Video RX {} bytes", data.len()));
-                self.terminal.feed(data);
+                match data.split_first() {
+                    // Packets of commands, not text: screen cells, pixels
+                    Some((&0x00, cmds)) => self.terminal.apply_screen(cmds),
+                    Some((&0x01, cmds)) => self.pixels.apply(cmds),
+                    Some((&0x02, [b'R', on, ..])) => self.set_raw_keys(*on != 0),
+                    Some((&0x02, _)) => {}
+                    _ => {
+                        self.terminal.feed(data);
+                        self.type_push_boot(data);
+                    }
+                }
             }
             3 => {
-                // Netboot request: data contains the filename
-                let name = String::from_utf8_lossy(data).to_string();
+                // Netboot request: data contains the filename, then
+                // [0x00][hash] when it came through the Pico's flash cache
+                let (name, cached) = match data.iter().position(|&b| b == 0) {
+                    Some(nul) => (
+                        &data[..nul],
+                        data.get(nul + 1..nul + 5)
+                            .map(|h| u32::from_le_bytes([h[0], h[1], h[2], h[3]])),
+                    ),
+                    None => (data, None),
+                };
+                let name = String::from_utf8_lossy(name).to_string();
                 self.log(format!("Netboot request: {name}"));
-                self.send_netboot(&name);
+                self.send_netboot(&name, cached);
+            }
+            5 => {
+                // Block load request: data contains the filename, then
+                // optionally [0x00][page] to place relocatable sections
+                let (name, page) = match data.iter().position(|&b| b == 0) {
+                    Some(nul) => (&data[..nul], data.get(nul + 1).copied()),
+                    None => (data, None),
+                };
+                let name = String::from_utf8_lossy(name).to_string();
+                match page {
+                    Some(page) => {
+                        self.log(format!("Block load request: {name} at page 0x{page:02x}"))
+                    }
+                    None => self.log(format!("Block load request: {name}")),
+                }
+                self.send_blockload(&name, page);
+            }
+            4 => {
+                // Network: a socket command
+                let out = self.net.command(data);
+                self.net_output(out);
+            }
+            6 => {
+                // File read request: 3-byte offset, 2-byte count, filename;
+                // or, with a zero count, a file command
+                if data.len() >= 7 && data[3] == 0 && data[4] == 0 {
+                    let offset = u32::from_le_bytes([data[0], data[1], data[2], 0]) as usize;
+                    self.file_command(offset, &data[5..]);
+                } else if data.len() < 6 {
+                    self.log(format!("File read: short request ({} bytes)", data.len()));
+                } else {
+                    let offset = u32::from_le_bytes([data[0], data[1], data[2], 0]) as usize;
+                    let count = u16::from_le_bytes([data[3], data[4]]) as usize;
+                    let name = String::from_utf8_lossy(&data[5..]).to_string();
+                    self.log_verbose(format!("File read request: {name} @{offset} +{count}"));
+                    self.send_file_range(&name, offset, count);
+                }
             }
             7 => {
                 // Echo: log summary and send back
@@ -201,6 +833,21 @@ impl App {
         }
     }
 
+    /// Handle an event from a device 4 socket's thread.
+    fn handle_net(&mut self, ev: NetEvent) {
+        let out = self.net.event(ev);
+        self.net_output(out);
+    }
+
+    fn net_output(&mut self, out: net::Output) {
+        for msg in out.log {
+            self.log_verbose(msg);
+        }
+        for reply in out.replies {
+            self.enqueue_tlv(4, &reply);
+        }
+    }
+
     /// Enqueue a TLV message for transmission, splitting into chunks if needed.
     fn enqueue_tlv(&mut self, device: u8, data: &[u8]) {
         let dev = device as usize;
@@ -210,103 +857,453 @@ impl App {
             ));
             return;
         }
-        let chunk_size = match device {
-            2 => MAX_KB_TLV_DATA,
-            3 => MAX_NETBOOT_TLV_DATA,
-            _ => MAX_TLV_DATA,
+        self.tx_queues[dev].extend(frame_tlvs(device, data));
+    }
+
+    /// Whether some device's next TLV fits its Pico buffer estimate, and
+    /// the SPI thread can take a frame of it.
+    fn tx_ready(&self) -> bool {
+        self.spi.can_write()
+            && (0..NUM_DEVICES).any(|dev| {
+                self.tx_queues[dev]
+                    .front()
+                    .is_some_and(|tlv| tlv_cost(tlv) <= self.buf[dev])
+            })
+    }
+
+    /// Take the next TLV of |dev| into |frame| if it fits both the frame and
+    /// the device's buffer estimate.
+    fn take_tlv(&mut self, dev: usize, frame: &mut Vec<u8>) -> bool {
+        let Some(tlv) = self.tx_queues[dev].front() else {
+            return false;
         };
-        for chunk in data.chunks(chunk_size) {
-            let mut payload = Vec::with_capacity(2 + chunk.len());
-            payload.push(device);
-            payload.push(chunk.len() as u8);
-            payload.extend_from_slice(chunk);
-            self.tx_queues[dev].push_back(payload);
+        // Cost in bytes (TLV header not stored in device buffer)
+        let cost = tlv_cost(tlv);
+        if frame.len() + tlv.len() > MAX_PAYLOAD || cost > self.buf[dev] {
+            return false;
+        }
+        let tlv = self.tx_queues[dev].pop_front().unwrap();
+        frame.extend_from_slice(&tlv);
+        self.buf[dev] -= cost;
+        if dev == 0 || is_tlv_marker(&tlv) {
+            return true;
         }
+        if self.sent[dev].resending > 0 {
+            self.sent[dev].resending -= 1;
+        } else {
+            // (A compressed TLV, framed as device 0, is left out of a trace.)
+            if tlv[0] as usize == dev {
+                self.trace(KIND_HOST, dev as u8, &tlv[2..]);
+            }
+            if dev == 4 {
+                self.net.sent(&tlv[2..]);
+            }
+        }
+        self.sent[dev].keep(tlv, 2 * DEVICE_BUFFER_SIZE[dev] as usize);
+        true
     }
 
-    /// Drain per-device TX queues into a single SPI frame (up to MAX_PAYLOAD).
-    /// Skips devices whose Pico buffer is full, avoiding head-of-line blocking.
-    fn drain_tx_queue(&mut self) -> Result<()> {
-        let mut frame = Vec::new();
-
-        // Keep looping until no device can contribute a frame.
-        loop {
-            let mut progress = false;
+    /// Answer a v8 NAK: the Pico had no room for |device|'s TLV number
+    /// |seq|, and has refused every one since, so they go again, behind a
+    /// marker that has it count from there.
+    fn answer_nak(&mut self, device: u8, seq: u8, epoch: u8) {
+        let dev = device as usize;
+        if dev == 0 || dev >= NUM_DEVICES || self.sent[dev].answered == Some(epoch) {
+            return;
+        }
+        let sent = &mut self.sent[dev];
+        sent.answered = Some(epoch);
+        let (tlvs, lost) = sent.rewind(seq);
+        sent.resending += tlvs.len();
+        let marker = tlv_marker(device, sent.seq, epoch);
+        let count = tlvs.len();
+        let queue = &mut self.tx_queues[dev];
+        for tlv in tlvs.into_iter().rev() {
+            queue.push_front(tlv);
+        }
+        queue.push_front(marker);
+        self.log_verbose(format!("Device {device}: Pico refused TLV {seq}, resending {count}"));
+        if lost > 0 {
+            self.log(format!("Device {device}: {lost} refused TLVs too old to resend"));
+        }
+    }
 
-            for dev in 0..NUM_DEVICES {
-                while let Some(tlv) = self.tx_queues[dev].front() {
-                    let data_len = tlv[1] as usize;
-                    let tlv_len = 2 + data_len;
+    /// Pass queued TLVs to the SPI thread as WRITE frames, each packed up to
+    /// MAX_PAYLOAD, for as long as the estimates allow and it has room.
+    ///
+    /// As the Pico does with its READ lanes, each frame takes whole TLVs
+    /// from devices 0 and 1 first, then one TLV from each other device in
+    /// turn, starting one device further on each frame.  A device whose
+    /// buffer is full is skipped, so it doesn't hold up the others, and a
+    /// bulk transfer shares the frame with keys rather than queueing ahead
+    /// of them.
+    fn drain_tx_queue(&mut self) {
+        while self.spi.can_write() {
+            let mut frame = Vec::new();
+            for dev in 0..2 {
+                while self.take_tlv(dev, &mut frame) {}
+            }
+            loop {
+                let mut progress = false;
+                for i in 0..NUM_DEVICES - 2 {
+                    let dev = 2 + (self.tx_next + i) % (NUM_DEVICES - 2);
+                    progress |= self.take_tlv(dev, &mut frame);
+                }
+                if !progress {
+                    break;
+                }
+            }
+            self.tx_next = (self.tx_next + 1) % (NUM_DEVICES - 2);
 
-                    if frame.len() + tlv_len > MAX_PAYLOAD {
-                        break;
-                    }
+            if frame.is_empty() {
+                break;
+            }
+            self.log_verbose(format!("SPI TX {} bytes", frame.len()));
+            self.spi.write(frame);
+            self.status.buf = self.buf;
+            self.dirty = true;
+        }
+    }
 
-                    // Cost in bytes (TLV header not stored in device buffer)
-                    let cost = data_len as u16;
-                    if cost > self.master.buf[dev] {
-                        break; // This device is blocked, try the next one
+    /// Read a named file and enqueue it over device 3 with a 2-byte BE length prefix.
+    ///
+    /// A request carrying the hash of the Pico's cached copy (`cached`, 0
+    /// for none) is answered first with a device 0 ['N', hit, hash] TLV:
+    /// on a hit the Pico serves the image from flash and nothing more is
+    /// sent, otherwise the image follows for it to keep.
+    ///
+    /// A v7 Pico gets the image compressed, unless a trace is being
+    /// recorded, which needs the device 3 bytes as they are.
+    fn send_netboot(&mut self, name: &str, cached: Option<u32>) {
+        let compress = self.spi.version() >= PROTO_V7 && self.trace.is_none();
+        match self.netboot_image(name) {
+            Ok(image) => {
+                let (len, hash) = (image.len, image.hash);
+                let tlvs = match &image.ztlvs {
+                    Some(ztlvs) if compress => ztlvs.clone(),
+                    _ => image.tlvs.clone(),
+                };
+                self.last_netboot = Some(name.to_string());
+                if let Some(cached) = cached {
+                    let hit = cached != 0 && cached == hash;
+                    let mut reply = vec![b'N', hit as u8];
+                    reply.extend_from_slice(&hash.to_le_bytes());
+                    self.enqueue_tlv(0, &reply);
+                    if hit {
+                        self.log(format!("Netboot: {name} is cached on the Pico"));
+                        return;
                     }
-
-                    let payload = self.tx_queues[dev].pop_front().unwrap();
-                    frame.extend_from_slice(&payload);
-                    self.master.buf[dev] = self.master.buf[dev].saturating_sub(cost);
-                    progress = true;
                 }
+                self.log(format!("Netboot: sending {len} bytes from {name}"));
+                self.tx_queues[3].extend(tlvs);
             }
+            Err(e) => {
+                self.log(format!("Netboot: file not found: {name} ({e})"));
+                if cached.is_some() {
+                    self.enqueue_tlv(0, &[b'N', 0, 0, 0, 0, 0]);
+                }
+                self.enqueue_tlv(3, &[0x00, 0x00]);
+            }
+        }
+    }
 
-            if !progress {
-                break;
+    /// The cached netboot image for `name`, read and framed again if the
+    /// file's modification time or size has changed since. A pushed image
+    /// is served in place of any file of the same name.
+    fn netboot_image(&mut self, name: &str) -> io::Result<&NetbootImage> {
+        if self.netboot_cache.get(name).is_some_and(|image| image.modified.is_none()) {
+            return Ok(&self.netboot_cache[name]);
+        }
+        let meta = fs::metadata(name)?;
+        let modified = meta.modified()?;
+        let fresh = self
+            .netboot_cache
+            .get(name)
+            .is_some_and(|image| image.modified == Some(modified) && image.len == meta.len());
+        if !fresh {
+            let file_data = fs::read(name)?;
+            if self.netboot_cache.len() >= NETBOOT_CACHE_ENTRIES {
+                // Forget the rest rather than track use: boots rarely involve
+                // more than a couple of images.
+                self.netboot_cache.retain(|n, image| {
+                    self.last_netboot.as_deref() == Some(n) || image.modified.is_none()
+                });
             }
+            self.netboot_cache
+                .insert(name.to_string(), NetbootImage::new(Some(modified), &file_data));
         }
+        Ok(&self.netboot_cache[name])
+    }
 
-        if !frame.is_empty() {
-            self.log_verbose(format!("SPI TX {} bytes", frame.len()));
-            self.master.write(&frame)?;
-            self.status.buf = self.master.buf;
+    /// Stage a pushed image as the netboot image of its name, replacing
+    /// any pushed before, and ask the Pico to reset the 6502 (Device 0
+    /// ['X']). The bootloader is then told to netload it, and a Pico with a
+    /// flash cache keeps a copy as it goes through.
+    fn handle_push(&mut self, push: push::Push) {
+        if let Err(e) = parse_sections(&push.image) {
+            self.log(format!("Push: {}: {e}", push.name));
+            push.reply(Err(e));
+            return;
         }
+        self.netboot_cache.retain(|_, image| image.modified.is_some());
+        self.netboot_cache
+            .insert(push.name.clone(), NetbootImage::new(None, &push.image));
+        self.log(format!(
+            "Push: {} bytes as {}, resetting the 6502",
+            push.image.len(),
+            push.name
+        ));
+        self.push_boot = Some(PushBoot {
+            name: push.name.clone(),
+            pushed: Instant::now(),
+            reset: false,
+        });
+        self.enqueue_tlv(0, b"X");
+        push.reply(Ok(()));
+    }
 
-        Ok(())
+    /// Once the 6502 has been reset for a push, answer the bootloader's
+    /// first prompt by typing the netload command for the pushed image.
+    fn type_push_boot(&mut self, text: &[u8]) {
+        if !text.ends_with(BOOTLOADER_PROMPT) || !self.push_boot.as_ref().is_some_and(|b| b.reset) {
+            return;
+        }
+        let Some(boot) = self.push_boot.take() else { return };
+        self.log(format!("Push: booting {}", boot.name));
+        self.enqueue_tlv(2, format!("netload {}\n", boot.name).as_bytes());
     }
 
-    /// Read a named file and enqueue it over device 3 with a 2-byte BE length prefix.
-    fn send_netboot(&mut self, name: &str) {
-        match fs::read(name) {
-            Ok(file_data) => {
-                let total_len = file_data.len() as u16;
-                let mut prefixed = Vec::with_capacity(2 + file_data.len());
-                prefixed.push((total_len >> 8) as u8);
-                prefixed.push((total_len & 0xFF) as u8);
-                prefixed.extend_from_slice(&file_data);
+    /// Read a named executable and enqueue it over device 5 as address-tagged
+    /// blocks, so the 6502 can copy each one straight to its destination.
+    /// Any failure is reported with a single end block at address 0.
+    fn send_blockload(&mut self, name: &str, page: Option<u8>) {
+        let blocks = match fs::read(name) {
+            Ok(image) => build_load_blocks(&image, page),
+            Err(e) => Err(format!("file not found ({e})")),
+        };
+        match blocks {
+            Ok(blocks) => {
                 self.log(format!(
-                    "Netboot: sending {} bytes from {name}",
-                    file_data.len()
+                    "Block load: sending {} blocks from {name}",
+                    blocks.len()
                 ));
-                self.enqueue_tlv(3, &prefixed);
+                for block in blocks {
+                    self.enqueue_tlv(5, &block);
+                }
             }
             Err(e) => {
-                self.log(format!("Netboot: file not found: {name} ({e})"));
-                self.enqueue_tlv(3, &[0x00, 0x00]);
+                self.log(format!("Block load: {name}: {e}"));
+                self.enqueue_tlv(5, &[0x00, 0x00, 0xFF, BLOCK_RAW]);
+            }
+        }
+    }
+
+    /// Enqueue exactly `count` bytes of a named file from `offset` over
+    /// device 6. Whatever lies past the end of the file, or the whole reply
+    /// if it can't be read, is zeros, so the 6502 never waits on a short one.
+    fn send_file_range(&mut self, name: &str, offset: usize, count: usize) {
+        let mut reply = vec![0u8; count];
+        match fs::read(name) {
+            Ok(file_data) => {
+                if offset < file_data.len() {
+                    let end = file_data.len().min(offset + count);
+                    reply[..end - offset].copy_from_slice(&file_data[offset..end]);
+                }
+            }
+            Err(e) => self.log(format!("File read: file not found: {name} ({e})")),
+        }
+        self.enqueue_tlv(6, &reply);
+    }
+
+    /// Run a device 6 file command: `op`, `name_len`, the filename, then any
+    /// data. 'S' stats the file, 'T' truncates (or extends) it to `offset`,
+    /// and 'W' writes the data at `offset`; the last two create the file if
+    /// need be. Every command is answered with `[ok][size x 3]`, the file's
+    /// size afterwards, little-endian.
+    fn file_command(&mut self, offset: usize, req: &[u8]) {
+        let (op, name_len) = (req[0], req[1] as usize);
+        let result = if req.len() < 2 + name_len {
+            Err(io::Error::new(io::ErrorKind::InvalidInput, "short request"))
+        } else {
+            let name = String::from_utf8_lossy(&req[2..2 + name_len]).to_string();
+            let data = &req[2 + name_len..];
+            self.log_verbose(format!(
+                "File command {}: {name} @{offset} +{}",
+                op as char,
+                data.len()
+            ));
+            let open = || fs::OpenOptions::new().write(true).create(true).open(&name);
+            match op {
+                b'S' => fs::metadata(&name).map(|m| m.len()),
+                b'T' => open().and_then(|f| {
+                    f.set_len(offset as u64)?;
+                    Ok(offset as u64)
+                }),
+                b'W' => open().and_then(|mut f| {
+                    f.seek(SeekFrom::Start(offset as u64))?;
+                    f.write_all(data)?;
+                    Ok(f.metadata()?.len())
+                }),
+                _ => Err(io::Error::new(io::ErrorKind::InvalidInput, "unknown command")),
+            }
+        };
+        let reply = match result {
+            Ok(size) => {
+                let size = size.min(0xFF_FFFF) as u32;
+                [1, size as u8, (size >> 8) as u8, (size >> 16) as u8]
+            }
+            Err(e) => {
+                // A missing file is an ordinary answer to a stat.
+                if op != b'S' || e.kind() != io::ErrorKind::NotFound {
+                    self.log(format!("File command {}: {e}", op as char));
+                }
+                [0; 4]
+            }
+        };
+        self.enqueue_tlv(6, &reply);
+    }
+
+    /// Apply a v5 credit TLV: every byte a device freed since the last one
+    /// is room the Zero may fill again.
+    fn apply_credits(&mut self, data: &[u8]) {
+        let mut freed = [0u16; NUM_DEVICES];
+        for (d, c) in data.chunks_exact(2).enumerate() {
+            freed[d] = u16::from_le_bytes([c[0], c[1]]);
+        }
+        if let Some(last) = self.last_freed {
+            for d in 0..NUM_DEVICES {
+                let delta = freed[d].wrapping_sub(last[d]);
+                let est = self.buf[d].saturating_add(delta);
+                self.buf[d] = est.min(DEVICE_BUFFER_SIZE[d]);
             }
         }
+        self.last_freed = Some(freed);
     }
 
     /// Handle a reset notification from the Pico.
     /// The Pico sends Device 1 (system control), data='R' before rebooting.
     fn handle_pico_reset(&mut self) {
         self.log("Pico reset — re-syncing".to_string());
+        self.reset_session();
 
+        // Pico is rebooting — buffers will be empty (full capacity)
+        self.buf = DEVICE_BUFFER_SIZE;
+        self.status.buf = self.buf;
+        self.last_freed = None;
+        // and with them its TLV numbering
+        self.sent = Default::default();
+        // and a bus capture under way is gone with them
+        self.capture_armed = false;
+        self.capture = CaptureAssembler::default();
+        // The SPI thread has gone back to v1 and the default clock.
+    }
+
+    /// Handle a warm reset notification from the Pico: Device 1, data='W'.
+    /// Only the 6502 restarts. The Pico keeps the SPI link as it is, and its
+    /// cleared buffers come back through the credits and BUF as usual.
+    fn handle_6502_reset(&mut self) {
+        self.log("6502 reset".to_string());
+        self.reset_session();
+    }
+
+    /// Forget everything meant for the 6502 program that was running.
+    fn reset_session(&mut self) {
         // Clear stale outgoing data
         for q in &mut self.tx_queues {
             q.clear();
         }
-
-        // Pico is rebooting — buffers will be empty (full capacity)
-        self.master.buf = [BUS_MAX_BUFFER_SIZE; NUM_DEVICES];
-        self.status.buf = self.master.buf;
+        for sent in &mut self.sent {
+            sent.clear();
+        }
 
         // Reset terminal to clean state
         self.terminal = Terminal::new();
+        self.pixels = Pixels::new();
+        self.set_raw_keys(false);
+
+        // Nothing is left on the 6502 to read from the sockets
+        self.net.close_all();
+
+        // A reset that comes too long after a push was not asked for by
+        // it: the push never took, so forget it.
+        if let Some(boot) = &mut self.push_boot {
+            if boot.pushed.elapsed() <= PUSH_RESET_TIME {
+                boot.reset = true;
+            } else {
+                self.push_boot = None;
+            }
+        }
+
+        // The 6502 is about to boot again, most likely the same image:
+        // have it read and framed before it asks.
+        if let Some(name) = self.last_netboot.clone() {
+            if let Err(e) = self.netboot_image(&name) {
+                self.log(format!("Netboot: prefetch of {name} failed ({e})"));
+            }
+        }
+    }
+}
+
+/// Split `data` into framed TLVs for `device`, sized for its 6502-side reader.
+fn frame_tlvs(device: u8, data: &[u8]) -> Vec<Vec<u8>> {
+    let chunk_size = match device {
+        2 => MAX_KB_TLV_DATA,
+        3 => MAX_NETBOOT_TLV_DATA,
+        6 => MAX_FILE_READ_TLV_DATA,
+        _ => MAX_TLV_DATA,
+    };
+    data.chunks(chunk_size)
+        .map(|chunk| {
+            let mut payload = Vec::with_capacity(2 + chunk.len());
+            payload.push(device);
+            payload.push(chunk.len() as u8);
+            payload.extend_from_slice(chunk);
+            payload
+        })
+        .collect()
+}
+
+/// `data` for |device| as Device 0 ['Z', device, out LE16, sequences...]
+/// TLVs (protocol v7), which the Pico decompresses into the device's
+/// buffer.  None if that wouldn't take fewer bytes than `frame_tlvs`.  A
+/// chunk costs its decompressed size against the device's estimate, and
+/// matches reach back no further than the device buffer holds.
+fn frame_compressed_tlvs(device: u8, data: &[u8]) -> Option<Vec<Vec<u8>>> {
+    let window = DEVICE_BUFFER_SIZE[device as usize] as usize;
+    let tlvs: Vec<Vec<u8>> = lz::compress_chunks(data, window)
+        .into_iter()
+        .map(|(out, seqs)| {
+            let mut payload = Vec::with_capacity(6 + seqs.len());
+            payload.extend_from_slice(&[0, 4 + seqs.len() as u8, b'Z', device]);
+            payload.extend_from_slice(&out.to_le_bytes());
+            payload.extend_from_slice(&seqs);
+            payload
+        })
+        .collect();
+    let size = |tlvs: &[Vec<u8>]| tlvs.iter().map(Vec::len).sum::<usize>();
+    (size(&tlvs) < size(&frame_tlvs(device, data))).then_some(tlvs)
+}
+
+/// A Device 0 ['D', device, seq, epoch] marker (protocol v8): the Pico
+/// numbers the device's next TLV `seq`. `epoch` is that of the NAK it
+/// answers, or 0 for one that only says where the numbering is.
+fn tlv_marker(device: u8, seq: u8, epoch: u8) -> Vec<u8> {
+    vec![0, 4, b'D', device, seq, epoch]
+}
+
+fn is_tlv_marker(tlv: &[u8]) -> bool {
+    tlv[0] == 0 && tlv.len() == 6 && tlv[2] == b'D'
+}
+
+/// The bytes a queued TLV takes in its device's Pico buffer: its length,
+/// or for a compressed TLV, what it decompresses to. A marker takes none.
+fn tlv_cost(tlv: &[u8]) -> u16 {
+    if tlv[0] == 0 && tlv.len() >= 6 && tlv[2] == b'Z' {
+        u16::from_le_bytes([tlv[4], tlv[5]])
+    } else if is_tlv_marker(tlv) {
+        0
+    } else {
+        tlv[1] as u16
     }
 }
 
@@ -344,11 +1341,45 @@ fn key_to_bytes(key: &KeyEvent) -> Option<Vec<u8>> {
 }
 
 fn main() -> Result<()> {
-    // Pre-TUI initialization: connect to SPI
-    println!("Connecting to Pico...");
+    // `--usb DEVICE`: a bridge built with BRIDGE_USB_LINK, on its USB
+    // serial port rather than this Zero's SPI. `--rt-priority N` runs the
+    // SPI thread SCHED_FIFO at N, `--cpu N` pins it to core N.
+    let mut args = std::env::args().skip(1);
+    let mut usb = None;
+    let mut sched = Sched::default();
+    while let Some(arg) = args.next() {
+        let value = args.next();
+        let ok = match (arg.as_str(), &value) {
+            ("--usb", Some(path)) => {
+                usb = Some(path.clone());
+                true
+            }
+            ("--rt-priority", Some(n)) => n.parse().map(|n| sched.priority = Some(n)).is_ok(),
+            ("--cpu", Some(n)) => n.parse().map(|n| sched.cpu = Some(n)).is_ok(),
+            _ => false,
+        };
+        if !ok {
+            eprintln!("usage: shein [--usb DEVICE] [--rt-priority N] [--cpu N]");
+            std::process::exit(2);
+        }
+    }
 
-    let irq = IrqWatcher::new()?;
-    let mut master = SpiMaster::new()?;
+    // Pre-TUI initialization: connect to SPI
+    let (irq, mut master) = match &usb {
+        Some(path) => {
+            println!("Connecting to Pico on {path}...");
+            let (irq, mut master) = open_usb(path)?;
+            // No BUF on the USB link, and the first credits only set the
+            // baseline: start from empty buffers. Should the 6502 still
+            // hold data from before, the Pico holds back what doesn't fit.
+            master.buf = DEVICE_BUFFER_SIZE;
+            (irq, master)
+        }
+        None => {
+            println!("Connecting to Pico...");
+            (IrqWatcher::new()?, SpiMaster::new()?)
+        }
+    };
 
     // Probably not needed, Pico will realistically be up before Zero.
 
@@ -363,51 +1394,152 @@ fn main() -> Result<()> {
     // println!("OK");
 
     // Initial sync
-    if master.request_and_read(Duration::from_secs(2))?.is_none() {
+    if master.request_and_read(Duration::from_secs(2), &mut Vec::new())?.is_none() {
         println!("TIMEOUT on initial sync");
         return Ok(());
     }
     println!("Connected (BUF={:?})", master.buf);
 
+    // Ask for v8 (pipelined, credits, CRCs, compressed device data, TLV
+    // NAKs); the Pico acks the highest version it supports, and READs keep
+    // using v1 until that ack arrives.
+    master.send_set_version(PROTO_V8)?;
+
+    // From here on the SPI thread owns the link; it wakes the main loop
+    // with what it reads.
+    let (wake, wakeups) = mpsc::sync_channel(WAKE_CAPACITY);
+    let buf = master.buf;
+    let spi = SpiThread::spawn(master, irq, wake.clone(), sched);
+
     // Set up TUI
     enable_raw_mode()?;
     io::stdout().execute(EnterAlternateScreen)?;
     let backend = CrosstermBackend::new(io::stdout());
     let mut tui = ratatui::Terminal::new(backend)?;
 
-    let mut app = App::new(master, irq);
+    let mut app = App::new(spi, buf);
+    app.key_releases = supports_keyboard_enhancement().unwrap_or(false);
     app.log("Connected to Pico".to_string());
 
     // Main event loop
-    let result = run_loop(&mut tui, &mut app);
+    let result = run_loop(&mut tui, &mut app, wake, wakeups);
 
     // Cleanup TUI
+    app.set_raw_keys(false);
     disable_raw_mode()?;
     io::stdout().execute(LeaveAlternateScreen)?;
 
     result
 }
 
+/// Something for the main loop to act on.
+enum Wake {
+    /// The SPI thread read something, finished WRITEs or has news.
+    Spi(SpiEvent),
+    /// A key press, resize or other terminal event.
+    Input(Event),
+    /// A device 4 socket's thread has something.
+    Net(NetEvent),
+    /// An image came in to push and run.
+    Push(push::Push),
+    /// A wake thread failed.
+    Failed(anyhow::Error),
+}
+
+/// Forward crossterm events to the main loop. The threads end with the
+/// process, or on their next send once the main loop has gone.
+fn spawn_input_thread(wake: SyncSender<Wake>) {
+    thread::spawn(move || {
+        loop {
+            let wakeup = match event::read() {
+                Ok(ev) => Wake::Input(ev),
+                Err(e) => Wake::Failed(e.into()),
+            };
+            let failed = matches!(wakeup, Wake::Failed(_));
+            if wake.send(wakeup).is_err() || failed {
+                return;
+            }
+        }
+    });
+}
+
 fn run_loop(
     tui: &mut ratatui::Terminal<CrosstermBackend<io::Stdout>>,
     app: &mut App,
+    wake: SyncSender<Wake>,
+    wakeups: Receiver<Wake>,
 ) -> Result<()> {
-    while app.running {
-        // Render
-        tui.draw(|frame| {
-            ui::draw(frame, &app.terminal, &app.status, &app.log);
-        })?;
+    // Sleep until the SPI thread reads something or a key arrives, rather
+    // than polling: SPI data and keys go through as soon as they're there,
+    // and the screen is only redrawn when something on it changed.
+    spawn_input_thread(wake.clone());
+    if let Err(e) = push::listen(push::PORT, wake.clone()) {
+        app.log(format!("Push: cannot listen on port {}: {e}", push::PORT));
+    }
+    app.net.set_wake(wake);
 
-        // Poll crossterm events with a short timeout
-        if event::poll(Duration::from_millis(10))? {
-            app.handle_input()?;
+    let mut view = TerminalView::new();
+    let mut last_draw: Option<Instant> = None;
+    while app.running {
+        // A frame the SPI thread had no room for goes as soon as it has.
+        // While the Pico still has data, a redraw waits for the rest of
+        // FRAME_TIME, or for the thread to catch up.
+        app.spi.flush();
+        let frame_due = last_draw.map_or(Duration::ZERO, |t| FRAME_TIME.saturating_sub(t.elapsed()));
+        let timeout = if app.tx_ready() || (app.dirty && !app.spi.busy()) {
+            Duration::ZERO
+        } else if app.dirty {
+            frame_due
+        } else {
+            Duration::MAX
+        };
+        if !wait_wakeups(&wakeups, timeout, app)? {
+            break;
         }
 
-        // Check SPI
-        app.drain_spi()?;
+        // Drain TX queue: it only fills here (keys, replies to RX), and a
+        // blocked device only frees up when a READ brings credits.
+        if app.tx_ready() {
+            app.drain_tx_queue();
+        }
 
-        // Drain TX queue
-        app.drain_tx_queue()?;
+        // Render, at most every FRAME_TIME while data keeps coming
+        if app.dirty
+            && (!app.spi.busy() || last_draw.is_none_or(|t| t.elapsed() >= FRAME_TIME))
+        {
+            view.sync(&mut app.terminal, &mut app.pixels);
+            tui.draw(|frame| {
+                ui::draw(frame, &view, &app.status, &app.log);
+            })?;
+            app.dirty = false;
+            last_draw = Some(Instant::now());
+        }
     }
     Ok(())
 }
+
+/// Wait up to |timeout| for a wakeup, then handle it and any others already
+/// queued. Returns false if the wake threads have all gone.
+fn wait_wakeups(wakeups: &Receiver<Wake>, timeout: Duration, app: &mut App) -> Result<bool> {
+    let first = if timeout == Duration::MAX {
+        wakeups.recv().map_err(|_| RecvTimeoutError::Disconnected)
+    } else {
+        wakeups.recv_timeout(timeout)
+    };
+    let mut next = match first {
+        Ok(w) => Some(w),
+        Err(RecvTimeoutError::Timeout) => None,
+        Err(RecvTimeoutError::Disconnected) => return Ok(false),
+    };
+    while let Some(w) = next {
+        match w {
+            Wake::Spi(ev) => app.handle_spi(ev),
+            Wake::Input(ev) => app.handle_input(ev),
+            Wake::Net(ev) => app.handle_net(ev),
+            Wake::Push(p) => app.handle_push(p),
+            Wake::Failed(e) => return Err(e),
+        }
+        next = wakeups.try_recv().ok();
+    }
+    Ok(true)
+}
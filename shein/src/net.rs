@@ -0,0 +1,336 @@
+//! Device 4 sockets: TCP connections the 6502 opens, listens for and
+//! streams through this side, as protocol.md describes under "Network".
+//! Connecting, accepting and reading block, so each socket gets a thread
+//! for them, which hands what it gets to the main loop as a wakeup; sends
+//! are written from the main loop.
+
+use std::io::{self, Read, Write};
+use std::net::{Shutdown, TcpListener, TcpStream, ToSocketAddrs};
+use std::sync::Arc;
+use std::sync::atomic::{AtomicBool, AtomicUsize, Ordering};
+use std::sync::mpsc::SyncSender;
+use std::thread;
+use std::time::Duration;
+
+use crate::Wake;
+
+pub const SOCKETS: usize = 8;
+/// Stream data per reply TLV, after its [sock][event] header.
+const MAX_DATA: usize = crate::MAX_TLV_DATA - 2;
+/// Bytes a socket may have queued for the Pico before its thread stops
+/// reading, leaving the rest to TCP's own flow control.
+const BACKLOG: usize = 32 * 1024;
+const CONNECT_TIMEOUT: Duration = Duration::from_secs(10);
+/// How often blocked threads look for their socket having been closed.
+const POLL: Duration = Duration::from_millis(50);
+
+/// Reply events, the second byte of each device 4 TLV the 6502 reads.
+const EV_OPEN: u8 = b'O'; // [ok]: connected, or listening, or (0) failed
+const EV_ACCEPT: u8 = b'A'; // A listening socket is now connected
+const EV_DATA: u8 = b'D'; // [data...]: received stream data
+const EV_CLOSED: u8 = b'X'; // Closed by either end, or failed; free again
+
+/// What a socket thread has for the main loop.
+pub struct NetEvent {
+    sock: u8,
+    generation: u32,
+    kind: EventKind,
+}
+
+enum EventKind {
+    Listening,
+    Connected(TcpStream),
+    Accepted(TcpStream),
+    Failed(String),
+    Data(Vec<u8>),
+    Closed,
+}
+
+struct Socket {
+    generation: u32,
+    /// Its EV_OPEN 1 has been sent: a failure now closes it.
+    opened: bool,
+    /// None while connecting or listening.
+    stream: Option<TcpStream>,
+    /// Stream data handed to the main loop and not yet sent to the Pico.
+    backlog: Arc<AtomicUsize>,
+    /// Set when the socket is closed, to stop its thread.
+    closed: Arc<AtomicBool>,
+}
+
+/// Device 4 replies (unframed TLV data) and lines for the log.
+#[derive(Default)]
+pub struct Output {
+    pub replies: Vec<Vec<u8>>,
+    pub log: Vec<String>,
+}
+
+pub struct Net {
+    sockets: [Option<Socket>; SOCKETS],
+    generation: u32,
+    wake: Option<SyncSender<Wake>>,
+}
+
+impl Net {
+    pub fn new() -> Self {
+        Self { sockets: Default::default(), generation: 0, wake: None }
+    }
+
+    /// Where socket threads send their events. Commands before this fail.
+    pub fn set_wake(&mut self, wake: SyncSender<Wake>) {
+        self.wake = Some(wake);
+    }
+
+    /// Handle a device 4 write: [op][sock][args...].
+    pub fn command(&mut self, data: &[u8]) -> Output {
+        let mut out = Output::default();
+        let (Some(&op), Some(&sock)) = (data.first(), data.get(1)) else {
+            out.log.push(format!("Net: short command ({} bytes)", data.len()));
+            return out;
+        };
+        let args = &data[2..];
+        if sock as usize >= SOCKETS {
+            out.log.push(format!("Net: socket {sock} out of range"));
+            return out;
+        }
+        match op {
+            b'C' | b'L' if args.len() >= 2 => {
+                let port = u16::from_le_bytes([args[0], args[1]]);
+                if self.sockets[sock as usize].is_some() {
+                    out.log.push(format!("Net: socket {sock} is already open"));
+                    out.replies.push(vec![sock, EV_OPEN, 0]);
+                    return out;
+                }
+                let Some(wake) = self.wake.clone() else {
+                    out.replies.push(vec![sock, EV_OPEN, 0]);
+                    return out;
+                };
+                let socket = self.open(sock);
+                let (generation, closed) = (socket.generation, Arc::clone(&socket.closed));
+                let backlog = Arc::clone(&socket.backlog);
+                let thread = SocketThread { sock, generation, wake, closed, backlog };
+                if op == b'C' {
+                    let host = String::from_utf8_lossy(&args[2..]).to_string();
+                    out.log.push(format!("Net: socket {sock} connecting to {host}:{port}"));
+                    thread::spawn(move || thread.connect(&host, port));
+                } else {
+                    out.log.push(format!("Net: socket {sock} listening on port {port}"));
+                    thread::spawn(move || thread.listen(port));
+                }
+            }
+            b'S' => {
+                let Some(stream) = self.sockets[sock as usize].as_mut().and_then(|s| s.stream.as_mut())
+                else {
+                    out.log.push(format!("Net: send on socket {sock}, which isn't connected"));
+                    return out;
+                };
+                if let Err(e) = stream.write_all(args) {
+                    out.log.push(format!("Net: socket {sock}: {e}"));
+                    self.close(sock, &mut out);
+                }
+            }
+            b'X' => self.close(sock, &mut out),
+            _ => out.log.push(format!("Net: bad command {op:#04x} for socket {sock}")),
+        }
+        out
+    }
+
+    /// Handle an event from a socket thread; those of a socket since closed
+    /// are dropped.
+    pub fn event(&mut self, ev: NetEvent) -> Output {
+        let mut out = Output::default();
+        let sock = ev.sock;
+        let Some(socket) = self.sockets[sock as usize].as_mut() else {
+            return out;
+        };
+        if socket.generation != ev.generation {
+            return out;
+        }
+        match ev.kind {
+            EventKind::Listening => {
+                socket.opened = true;
+                out.replies.push(vec![sock, EV_OPEN, 1]);
+            }
+            EventKind::Connected(stream) => {
+                socket.opened = true;
+                socket.stream = Some(stream);
+                out.replies.push(vec![sock, EV_OPEN, 1]);
+            }
+            EventKind::Accepted(stream) => {
+                if let Ok(peer) = stream.peer_addr() {
+                    out.log.push(format!("Net: socket {sock} accepted {peer}"));
+                }
+                socket.stream = Some(stream);
+                out.replies.push(vec![sock, EV_ACCEPT]);
+            }
+            EventKind::Data(data) => {
+                let mut reply = vec![sock, EV_DATA];
+                reply.extend_from_slice(&data);
+                out.replies.push(reply);
+            }
+            EventKind::Failed(e) => {
+                out.log.push(format!("Net: socket {sock}: {e}"));
+                let opened = socket.opened;
+                self.sockets[sock as usize] = None;
+                out.replies.push(if opened { vec![sock, EV_CLOSED] } else { vec![sock, EV_OPEN, 0] });
+            }
+            EventKind::Closed => {
+                out.log.push(format!("Net: socket {sock} closed by peer"));
+                self.sockets[sock as usize] = None;
+                out.replies.push(vec![sock, EV_CLOSED]);
+            }
+        }
+        out
+    }
+
+    /// A device 4 TLV went to the Pico: take its data off the socket's backlog.
+    pub fn sent(&self, tlv: &[u8]) {
+        if let [sock, EV_DATA, data @ ..] = tlv {
+            if let Some(Some(socket)) = self.sockets.get(*sock as usize) {
+                // Saturating: this may be data of an earlier socket of the id
+                let _ = socket.backlog.fetch_update(Ordering::Relaxed, Ordering::Relaxed, |n| {
+                    Some(n.saturating_sub(data.len()))
+                });
+            }
+        }
+    }
+
+    /// Close every socket without replies, as when the 6502 resets.
+    pub fn close_all(&mut self) {
+        for sock in 0..SOCKETS as u8 {
+            self.close(sock, &mut Output::default());
+        }
+    }
+
+    fn open(&mut self, sock: u8) -> &Socket {
+        self.generation = self.generation.wrapping_add(1);
+        self.sockets[sock as usize].insert(Socket {
+            generation: self.generation,
+            opened: false,
+            stream: None,
+            backlog: Arc::new(AtomicUsize::new(0)),
+            closed: Arc::new(AtomicBool::new(false)),
+        })
+    }
+
+    fn close(&mut self, sock: u8, out: &mut Output) {
+        let Some(socket) = self.sockets[sock as usize].take() else {
+            return;
+        };
+        socket.closed.store(true, Ordering::Relaxed);
+        if let Some(stream) = socket.stream {
+            // Also ends the thread's blocking read
+            let _ = stream.shutdown(Shutdown::Both);
+        }
+        out.log.push(format!("Net: socket {sock} closed"));
+        out.replies.push(vec![sock, EV_CLOSED]);
+    }
+}
+
+/// A socket's thread: it connects or accepts, then reads until the stream
+/// ends or the socket is closed.
+struct SocketThread {
+    sock: u8,
+    generation: u32,
+    wake: SyncSender<Wake>,
+    closed: Arc<AtomicBool>,
+    backlog: Arc<AtomicUsize>,
+}
+
+impl SocketThread {
+    fn send(&self, kind: EventKind) -> bool {
+        let ev = NetEvent { sock: self.sock, generation: self.generation, kind };
+        self.wake.send(Wake::Net(ev)).is_ok() && !self.closed.load(Ordering::Relaxed)
+    }
+
+    fn connect(self, host: &str, port: u16) {
+        let stream = (host, port).to_socket_addrs().and_then(|addrs| {
+            let mut last = io::Error::new(io::ErrorKind::NotFound, "no address");
+            for addr in addrs {
+                match TcpStream::connect_timeout(&addr, CONNECT_TIMEOUT) {
+                    Ok(stream) => return Ok(stream),
+                    Err(e) => last = e,
+                }
+            }
+            Err(last)
+        });
+        match stream.and_then(|s| Ok((s.try_clone()?, s))) {
+            Ok((ours, theirs)) => {
+                if self.send(EventKind::Connected(theirs)) {
+                    self.read(ours);
+                }
+            }
+            Err(e) => {
+                self.send(EventKind::Failed(format!("{host}:{port}: {e}")));
+            }
+        }
+    }
+
+    /// Take one connection on |port|, then let the port go.
+    fn listen(self, port: u16) {
+        let listener = match TcpListener::bind(("0.0.0.0", port)).and_then(|l| {
+            l.set_nonblocking(true)?;
+            Ok(l)
+        }) {
+            Ok(listener) => listener,
+            Err(e) => {
+                self.send(EventKind::Failed(format!("port {port}: {e}")));
+                return;
+            }
+        };
+        if !self.send(EventKind::Listening) {
+            return;
+        }
+        let stream = loop {
+            match listener.accept() {
+                Ok((stream, _)) => break stream,
+                Err(e) if e.kind() == io::ErrorKind::WouldBlock => {
+                    if self.closed.load(Ordering::Relaxed) {
+                        return;
+                    }
+                    thread::sleep(POLL);
+                }
+                Err(e) => {
+                    self.send(EventKind::Failed(format!("port {port}: {e}")));
+                    return;
+                }
+            }
+        };
+        drop(listener);
+        match stream.set_nonblocking(false).and_then(|()| stream.try_clone()) {
+            Ok(ours) => {
+                if self.send(EventKind::Accepted(stream)) {
+                    self.read(ours);
+                }
+            }
+            Err(e) => {
+                self.send(EventKind::Failed(format!("port {port}: {e}")));
+            }
+        }
+    }
+
+    fn read(self, mut stream: TcpStream) {
+        let mut buf = [0u8; MAX_DATA];
+        loop {
+            while self.backlog.load(Ordering::Relaxed) >= BACKLOG {
+                if self.closed.load(Ordering::Relaxed) {
+                    return;
+                }
+                thread::sleep(POLL);
+            }
+            let kind = match stream.read(&mut buf) {
+                Ok(0) => EventKind::Closed,
+                Ok(n) => {
+                    self.backlog.fetch_add(n, Ordering::Relaxed);
+                    EventKind::Data(buf[..n].to_vec())
+                }
+                Err(e) if e.kind() == io::ErrorKind::Interrupted => continue,
+                Err(e) => EventKind::Failed(e.to_string()),
+            };
+            let more = matches!(kind, EventKind::Data(_));
+            if !self.send(kind) || !more {
+                return;
+            }
+        }
+    }
+}
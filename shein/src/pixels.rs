@@ -0,0 +1,278 @@
+//! Device 2 pixel mode: a 320x200 framebuffer of palette indexes, drawn by
+//! the writes whose first byte is 0x01 (protocol.md, "Pixel packets"). They
+//! draw into a back buffer; present copies the region drawn since the last
+//! one to the front buffer, which is what's shown.
+
+use std::fs::File;
+use std::io::{self, BufWriter, Write};
+use std::path::Path;
+
+pub const WIDTH: usize = 320;
+pub const HEIGHT: usize = 200;
+pub const TILE: usize = 8;
+const TILE_COLS: usize = WIDTH / TILE;
+const TILE_ROWS: usize = HEIGHT / TILE;
+const TILE_COUNT: usize = 256;
+const ALL_TILE_ROWS: u32 = (1 << TILE_ROWS) - 1;
+
+/// The 16 ANSI colors, as the palette starts out.
+const DEFAULT_PALETTE: [[u8; 3]; 16] = [
+    [0x00, 0x00, 0x00],
+    [0xAA, 0x00, 0x00],
+    [0x00, 0xAA, 0x00],
+    [0xAA, 0x55, 0x00],
+    [0x00, 0x00, 0xAA],
+    [0xAA, 0x00, 0xAA],
+    [0x00, 0xAA, 0xAA],
+    [0xAA, 0xAA, 0xAA],
+    [0x55, 0x55, 0x55],
+    [0xFF, 0x55, 0x55],
+    [0x55, 0xFF, 0x55],
+    [0xFF, 0xFF, 0x55],
+    [0x55, 0x55, 0xFF],
+    [0xFF, 0x55, 0xFF],
+    [0x55, 0xFF, 0xFF],
+    [0xFF, 0xFF, 0xFF],
+];
+
+/// A region of the framebuffer, right and bottom edges exclusive.
+#[derive(Clone, Copy)]
+struct Rect {
+    x0: usize,
+    y0: usize,
+    x1: usize,
+    y1: usize,
+}
+
+pub struct Pixels {
+    back: Vec<u8>,
+    pub front: Vec<u8>,
+    pub palette: [[u8; 3]; 16],
+    tiles: Vec<[u8; TILE * TILE]>,
+    /// Show the framebuffer in place of the text grid ('M').
+    pub shown: bool,
+    /// Back buffer region drawn on since the last present.
+    drawn: Option<Rect>,
+    /// Rows of tiles whose pixels on show changed since
+    /// `take_dirty_tile_rows`, bit n for row n.
+    dirty_tile_rows: u32,
+}
+
+impl Pixels {
+    pub fn new() -> Self {
+        Self {
+            back: vec![0; WIDTH * HEIGHT],
+            front: vec![0; WIDTH * HEIGHT],
+            palette: DEFAULT_PALETTE,
+            tiles: vec![[0; TILE * TILE]; TILE_COUNT],
+            shown: false,
+            drawn: None,
+            dirty_tile_rows: ALL_TILE_ROWS,
+        }
+    }
+
+    /// Rows of tiles changed on show since the last call, bit n for row n.
+    pub fn take_dirty_tile_rows(&mut self) -> u32 {
+        std::mem::take(&mut self.dirty_tile_rows)
+    }
+
+    /// The color shown at (x, y).
+    pub fn rgb(&self, x: usize, y: usize) -> [u8; 3] {
+        self.palette[self.front[y * WIDTH + x] as usize & 0x0F]
+    }
+
+    /// Apply a pixel packet, the bytes after its 0x01 marker. Parsing stops
+    /// at the first unknown or truncated command.
+    pub fn apply(&mut self, mut cmds: &[u8]) {
+        while let Some((&cmd, rest)) = cmds.split_first() {
+            let args = match cmd {
+                b'M' => 1,
+                b'P' => 2 + 3 * rest.get(1).map_or(0, |&n| n as usize),
+                b'D' => match rest.get(1) {
+                    Some(&bpp @ (1 | 2 | 4)) => 2 + TILE * bpp as usize,
+                    _ => return,
+                },
+                b'T' => 3 + rest.get(2).map_or(0, |&n| n as usize),
+                b'B' => match rest.get(..6) {
+                    Some(&[_, _, _, w_lo, w_hi, bpp @ (1 | 2 | 4)]) => {
+                        6 + (u16::from_le_bytes([w_lo, w_hi]) as usize * bpp as usize).div_ceil(8)
+                    }
+                    _ => return,
+                },
+                b'R' => 7,
+                b'C' => 9,
+                b'S' => 0,
+                _ => return,
+            };
+            let Some(a) = rest.get(..args) else { return };
+            cmds = &rest[args..];
+            match cmd {
+                b'M' => {
+                    self.shown = a[0] != 0;
+                    self.dirty_tile_rows = ALL_TILE_ROWS;
+                }
+                b'P' => {
+                    // Shown colors change at once, as on palette hardware
+                    for (i, rgb) in a[2..].chunks(3).enumerate() {
+                        if let Some(entry) = self.palette.get_mut(a[0] as usize + i) {
+                            entry.copy_from_slice(rgb);
+                        }
+                    }
+                    self.dirty_tile_rows = ALL_TILE_ROWS;
+                }
+                b'D' => {
+                    let tile = &mut self.tiles[a[0] as usize];
+                    for (i, pixel) in tile.iter_mut().enumerate() {
+                        *pixel = unpack(&a[2..], a[1], i);
+                    }
+                }
+                b'T' => self.blit_tiles(a[0] as usize, a[1] as usize, &a[3..]),
+                b'B' => {
+                    let (x, y) = (le16(a, 0), a[2] as usize);
+                    let w = le16(a, 3).min(WIDTH.saturating_sub(x));
+                    if y < HEIGHT && w > 0 {
+                        for i in 0..w {
+                            self.back[y * WIDTH + x + i] = unpack(&a[6..], a[5], i);
+                        }
+                        self.draw(Rect { x0: x, y0: y, x1: x + w, y1: y + 1 });
+                    }
+                }
+                b'R' => {
+                    let Some(r) = clip(le16(a, 0), a[2] as usize, le16(a, 3), a[5] as usize) else {
+                        continue;
+                    };
+                    for y in r.y0..r.y1 {
+                        self.back[y * WIDTH + r.x0..y * WIDTH + r.x1].fill(a[6]);
+                    }
+                    self.draw(r);
+                }
+                b'C' => self.copy_rect(a),
+                _ => self.present(),
+            }
+        }
+    }
+
+    /// ['T', col, row, n, tiles[n]]: draw tiles from (col, row) of the tile
+    /// grid, on to the next row at the end of one, stopping at the last.
+    fn blit_tiles(&mut self, col: usize, row: usize, tiles: &[u8]) {
+        let mut cell = row * TILE_COLS + col;
+        for &tile in tiles {
+            if cell >= TILE_COLS * TILE_ROWS {
+                break;
+            }
+            let (x, y) = (cell % TILE_COLS * TILE, cell / TILE_COLS * TILE);
+            for (ty, line) in self.tiles[tile as usize].chunks(TILE).enumerate() {
+                self.back[(y + ty) * WIDTH + x..][..TILE].copy_from_slice(line);
+            }
+            self.draw(Rect { x0: x, y0: y, x1: x + TILE, y1: y + TILE });
+            cell += 1;
+        }
+    }
+
+    /// ['C', x, y, w, h, to_x, to_y]: copy a region of the back buffer,
+    /// clipped at both ends. The two may overlap, as when scrolling.
+    fn copy_rect(&mut self, a: &[u8]) {
+        let (x, y, to_x, to_y) = (le16(a, 0), a[2] as usize, le16(a, 6), a[8] as usize);
+        let w = le16(a, 3).min(WIDTH.saturating_sub(x)).min(WIDTH.saturating_sub(to_x));
+        let h = (a[5] as usize).min(HEIGHT.saturating_sub(y)).min(HEIGHT.saturating_sub(to_y));
+        if w == 0 || h == 0 {
+            return;
+        }
+        let rows: Vec<usize> = if to_y > y { (0..h).rev().collect() } else { (0..h).collect() };
+        for i in rows {
+            let from = (y + i) * WIDTH + x;
+            self.back.copy_within(from..from + w, (to_y + i) * WIDTH + to_x);
+        }
+        self.draw(Rect { x0: to_x, y0: to_y, x1: to_x + w, y1: to_y + h });
+    }
+
+    fn draw(&mut self, r: Rect) {
+        self.drawn = Some(match self.drawn {
+            Some(d) => Rect {
+                x0: d.x0.min(r.x0),
+                y0: d.y0.min(r.y0),
+                x1: d.x1.max(r.x1),
+                y1: d.y1.max(r.y1),
+            },
+            None => r,
+        });
+    }
+
+    /// Show what was drawn: copy the back buffer's drawn region to the front.
+    fn present(&mut self) {
+        let Some(r) = self.drawn.take() else { return };
+        for y in r.y0..r.y1 {
+            let span = y * WIDTH + r.x0..y * WIDTH + r.x1;
+            self.front[span.clone()].copy_from_slice(&self.back[span]);
+        }
+        for row in r.y0 / TILE..r.y1.div_ceil(TILE) {
+            self.dirty_tile_rows |= 1 << row;
+        }
+    }
+
+    /// Save the shown frame at full size as a binary PPM.
+    pub fn save_ppm(&self, path: &Path) -> io::Result<()> {
+        let mut out = BufWriter::new(File::create(path)?);
+        write!(out, "P6\n{WIDTH} {HEIGHT}\n255\n")?;
+        for y in 0..HEIGHT {
+            for x in 0..WIDTH {
+                out.write_all(&self.rgb(x, y))?;
+            }
+        }
+        out.flush()
+    }
+}
+
+fn le16(a: &[u8], i: usize) -> usize {
+    u16::from_le_bytes([a[i], a[i + 1]]) as usize
+}
+
+/// Pixel |i| of rows packed |bpp| bits a pixel, leftmost in the high bits.
+fn unpack(data: &[u8], bpp: u8, i: usize) -> u8 {
+    let bit = i * bpp as usize;
+    let shift = 8 - bpp as usize - bit % 8;
+    data[bit / 8] >> shift & ((1 << bpp) - 1)
+}
+
+/// The part of a region inside the framebuffer, if any.
+fn clip(x: usize, y: usize, w: usize, h: usize) -> Option<Rect> {
+    let r = Rect { x0: x, y0: y, x1: (x + w).min(WIDTH), y1: (y + h).min(HEIGHT) };
+    (r.x0 < r.x1 && r.y0 < r.y1).then_some(r)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::{Pixels, WIDTH};
+
+    #[test]
+    fn drawing_shows_at_present() {
+        let mut pixels = Pixels::new();
+        pixels.take_dirty_tile_rows();
+
+        // A 2-bit row of colors 1, 2, 3 at (10, 9), then tile 5 (1-bit, all
+        // color 1) at tile (1, 2), color 1 recolored
+        pixels.apply(b"B\x0a\x00\x09\x03\x00\x02\x6c");
+        pixels.apply(b"D\x05\x01\xff\xff\xff\xff\xff\xff\xff\xffP\x01\x01\x10\x20\x30");
+        pixels.apply(b"T\x01\x02\x01\x05");
+        assert_eq!(pixels.front[9 * WIDTH + 11], 0);
+        assert_eq!(pixels.take_dirty_tile_rows(), !0 >> 7);
+
+        pixels.apply(b"S");
+        assert_eq!(pixels.front[9 * WIDTH + 10..][..4], [1, 2, 3, 0]);
+        assert_eq!(pixels.front[23 * WIDTH + 15], 1);
+        assert_eq!(pixels.rgb(10, 9), [0x10, 0x20, 0x30]);
+        assert_eq!(pixels.take_dirty_tile_rows(), 0b110);
+    }
+
+    #[test]
+    fn copies_may_overlap() {
+        let mut pixels = Pixels::new();
+        // Fill row 0 with 4, row 1 with 5, then scroll rows 0-1 down one
+        pixels.apply(b"R\x00\x00\x00\x40\x01\x01\x04R\x00\x00\x01\x40\x01\x01\x05");
+        pixels.apply(b"C\x00\x00\x00\x40\x01\x02\x00\x00\x01S");
+        assert_eq!(pixels.front[WIDTH - 1], 4);
+        assert_eq!(pixels.front[WIDTH], 4);
+        assert_eq!(pixels.front[2 * WIDTH + 100], 5);
+        assert_eq!(pixels.front[3 * WIDTH], 0);
+    }
+}
@@ -0,0 +1,88 @@
+//! Push to run: a TCP port a workstation sends a netboot image to, for the
+//! 6502 to boot straight away (see "Push to run" in protocol.md). A
+//! connection carries the name to boot it as, a newline, then the image up
+//! to the end of the stream, e.g.
+//!
+//!     (echo hello.bin; cat hello.bin) | nc -N zero 6502
+//!
+//! and gets one line back, `ok` or `error: ...`, once it has been staged.
+//! Connections are taken one at a time by a thread of their own, which
+//! hands each push to the main loop as a wakeup.
+
+use std::io::{self, BufRead, BufReader, Read, Write};
+use std::net::{TcpListener, TcpStream};
+use std::sync::mpsc::SyncSender;
+use std::thread;
+use std::time::Duration;
+
+use crate::Wake;
+
+pub const PORT: u16 = 6502;
+/// Netboot's length prefix is 16 bits.
+const MAX_IMAGE: usize = 0xFFFF;
+/// Longest name, so the Pico's flash cache takes the image too.
+const MAX_NAME: usize = 64;
+/// How long a client may stall before its push is dropped.
+const READ_TIMEOUT: Duration = Duration::from_secs(5);
+
+/// An image pushed, and the connection to answer.
+pub struct Push {
+    pub name: String,
+    pub image: Vec<u8>,
+    stream: TcpStream,
+}
+
+impl Push {
+    /// Tell the client how it went. It may have gone already.
+    pub fn reply(mut self, result: Result<(), String>) {
+        let line = match result {
+            Ok(()) => "ok\n".to_string(),
+            Err(e) => format!("error: {e}\n"),
+        };
+        let _ = self.stream.write_all(line.as_bytes());
+    }
+}
+
+/// Listen on |port| and send pushes to |wake| until the main loop goes.
+pub fn listen(port: u16, wake: SyncSender<Wake>) -> io::Result<()> {
+    let listener = TcpListener::bind(("0.0.0.0", port))?;
+    thread::spawn(move || {
+        for stream in listener.incoming() {
+            let Ok(mut stream) = stream else { continue };
+            match receive(&stream) {
+                Ok((name, image)) => {
+                    if wake.send(Wake::Push(Push { name, image, stream })).is_err() {
+                        return;
+                    }
+                }
+                Err(e) => {
+                    let _ = writeln!(stream, "error: {e}");
+                }
+            }
+        }
+    });
+    Ok(())
+}
+
+/// Read a push's name line and image.
+fn receive(stream: &TcpStream) -> io::Result<(String, Vec<u8>)> {
+    let invalid = |msg: &str| io::Error::new(io::ErrorKind::InvalidData, msg.to_string());
+    stream.set_read_timeout(Some(READ_TIMEOUT))?;
+    let mut reader = BufReader::new(stream);
+    let mut name = Vec::new();
+    (&mut reader).take(MAX_NAME as u64 + 1).read_until(b'\n', &mut name)?;
+    if name.pop() != Some(b'\n') {
+        return Err(invalid("no name line"));
+    }
+    let name = String::from_utf8(name).map_err(|_| invalid("name is not UTF-8"))?;
+    let name = name.trim();
+    if name.is_empty() || name.contains(char::is_whitespace) {
+        return Err(invalid("bad name"));
+    }
+    let mut image = Vec::new();
+    reader.take(MAX_IMAGE as u64 + 1).read_to_end(&mut image)?;
+    if image.len() > MAX_IMAGE {
+        return Err(invalid("image over 64K"));
+    }
+    Ok((name.to_string(), image))
+}
@@ -1,33 +1,115 @@
 pub const MAX_PAYLOAD: usize = 1542; // 257*6: room for 6 max-size TLV packets
 pub const NUM_DEVICES: usize = 8;
+/// The longest READ of any version: a v6 header and CRC, and a full payload.
+pub const MAX_READ_FRAME: usize = MAX_PAYLOAD + 10 + 4;
+
+/// READ framing versions. v1 always clocks `READ_SIZE` bytes; v2 clocks the
+/// 10-byte header, then exactly LEN payload bytes in a second transfer; v3
+/// is v2 plus pipelining (a READ flagged MORE is followed by another frame
+/// without a REQUEST); v4 is v3 with BUF counted in 64-byte units; v5 is
+/// v4 plus Device 1 `['K', freed u16 LE x8]` credit TLVs, and BUF is then
+/// only a floor for the caller's own estimate. v6 is v5 plus a CRC-32 on
+/// every frame: bad READs are NAKed and read again, and WRITEs carry a
+/// sequence number so the Pico can name the first one it dropped. v7 is v6
+/// framing, and the Pico also takes compressed device data as Device 0
+/// `['Z']` TLVs. v8 is v7 plus TLV NAKs: a TLV the Pico has no room for is
+/// answered with a Device 1 `['D', device, seq, epoch]` TLV, and the Zero
+/// sends it and those after it again.
+pub const PROTO_V1: u8 = 1;
+pub const PROTO_V2: u8 = 2;
+pub const PROTO_V3: u8 = 3;
+pub const PROTO_V4: u8 = 4;
+pub const PROTO_V5: u8 = 5;
+pub const PROTO_V6: u8 = 6;
+pub const PROTO_V7: u8 = 7;
+pub const PROTO_V8: u8 = 8;
+
+/// Bytes per BUF count in a READ header for a given protocol version.
+pub fn buf_unit(version: u8) -> u16 {
+    if version >= PROTO_V4 { 64 } else { 16 }
+}
+
+/// The reflected IEEE CRC-32 (as zlib) that v6 frames carry, matching the
+/// Pico's DMA sniffer.
+pub fn crc32(data: &[u8]) -> u32 {
+    !crc32_feed(!0, data)
+}
+
+/// Run `data` through a CRC-32 register: start from `!0` and invert the
+/// result, so spans can be fed one after another.
+fn crc32_feed(crc: u32, data: &[u8]) -> u32 {
+    const TABLE: [u32; 256] = {
+        let mut table = [0u32; 256];
+        let mut i = 0;
+        while i < 256 {
+            let mut c = i as u32;
+            let mut k = 0;
+            while k < 8 {
+                c = if c & 1 != 0 { 0xEDB8_8320 ^ (c >> 1) } else { c >> 1 };
+                k += 1;
+            }
+            table[i] = c;
+            i += 1;
+        }
+        table
+    };
+    data.iter().fold(crc, |c, &b| TABLE[((c ^ b as u32) & 0xFF) as usize] ^ (c >> 8))
+}
 
 // ── Linux (real hardware) ───────────────────────────────────────────────────
 
 #[cfg(target_os = "linux")]
 mod hw {
+    use std::collections::VecDeque;
     use std::io::Write;
+    use std::ops::Range;
     use std::time::{Duration, Instant};
 
     use anyhow::{Context, Result};
     use gpiocdev::Request;
-    use gpiocdev::line::{Bias, EdgeDetection, Value};
+    use gpiocdev::line::{Bias, EdgeDetection, EdgeKind, Value};
     use spidev::{SpiModeFlags, Spidev, SpidevOptions, SpidevTransfer};
 
+    use crate::usb_link::UsbPort;
+
     const SPI_CMD_WRITE: u8 = 0x01;
     const SPI_CMD_REQUEST: u8 = 0x02;
     const SPI_CMD_READ: u8 = 0x03;
-
-    const READ_SIZE: usize = super::MAX_PAYLOAD + 10; // 8 buf + 2 len + payload
+    const SPI_CMD_SET_VERSION: u8 = 0x04;
+    const SPI_CMD_NAK: u8 = 0x05;
+
+    const READ_HDR_SIZE: usize = 10; // 8 buf + 2 len
+    const CRC_SIZE: usize = 4; // v6 CRC-32, little-endian
+    /// v6 frames NAKed in a row before a READ is given up on.
+    const READ_RETRIES: u32 = 3;
+    /// v6 WRITE frames kept for resending after a Pico `['N', seq]`.
+    const WRITE_HISTORY: usize = 64;
+    const READ_LEN_MORE: u8 = 0x80; // LEN_HI flag (v3): next frame is pipelined
+    const READ_SIZE: usize = super::MAX_PAYLOAD + READ_HDR_SIZE;
 
     const GPIO_CHIP: &str = "/dev/gpiochip0";
     const PIN_IRQ: u32 = 25;
     const PIN_READY: u32 = 24;
 
     const SPI_DEVICE: &str = "/dev/spidev0.0";
-    const SPI_SPEED_HZ: u32 = 8_000_000;
+    /// The clock until link training picks one (link.rs).
+    const SPI_SPEED_HZ: u32 = crate::link::RATES_HZ[crate::link::DEFAULT_RATE];
+
+    /// Open the USB link at `path` in place of the SPI hardware.
+    pub fn open_usb(path: &str) -> Result<(IrqWatcher, SpiMaster)> {
+        let usb = UsbPort::open(path)?;
+        Ok((IrqWatcher::usb(usb.clone()), SpiMaster::usb(usb)))
+    }
+
+    /// The SPI hardware, or on the USB link (`usb`) its stand-ins.
+    fn port<T>(p: &mut Option<T>) -> Result<&mut T> {
+        p.as_mut().context("SPI hardware used on the USB link")
+    }
 
+    /// The IRQ line, or on the USB link, TLVs having arrived.
     pub struct IrqWatcher {
-        req: Request,
+        req: Option<Request>,
+        usb: Option<UsbPort>,
     }
 
     impl IrqWatcher {
@@ -41,28 +123,66 @@ mod hw {
                 .with_consumer("shein-irq")
                 .request()
                 .context("Failed to request IRQ GPIO")?;
-            Ok(Self { req })
+            Ok(Self { req: Some(req), usb: None })
+        }
+
+        fn usb(usb: UsbPort) -> Self {
+            Self { req: None, usb: Some(usb) }
         }
 
         pub fn is_asserted(&self) -> Result<bool> {
-            let val = self.req.value(PIN_IRQ)?;
-            Ok(val == Value::Inactive)
+            match (&self.usb, &self.req) {
+                (Some(usb), _) => Ok(usb.has_tlv()),
+                (None, Some(req)) => Ok(req.value(PIN_IRQ)? == Value::Inactive),
+                (None, None) => unreachable!(),
+            }
         }
 
         pub fn wait_edge(&self, timeout: Duration) -> Result<bool> {
-            Ok(self.req.wait_edge_event(timeout)?)
+            match (&self.usb, &self.req) {
+                (Some(usb), _) => Ok(usb.wait_fresh(timeout)),
+                (None, Some(req)) => Ok(req.wait_edge_event(timeout)?),
+                (None, None) => unreachable!(),
+            }
         }
 
         pub fn consume_edge(&self) -> Result<()> {
-            self.req.read_edge_event()?;
+            match (&self.usb, &self.req) {
+                (Some(usb), _) => usb.consume_fresh(),
+                (None, Some(req)) => {
+                    req.read_edge_event()?;
+                }
+                (None, None) => unreachable!(),
+            }
             Ok(())
         }
     }
 
     pub struct SpiMaster {
-        spi: Spidev,
-        ready: Request,
+        spi: Option<Spidev>,
+        ready: Option<Request>,
+        /// The USB link in place of both, if shein was started on one.
+        usb: Option<UsbPort>,
         pub buf: [u16; super::NUM_DEVICES],
+        /// READ framing in use; switched by `set_version` once the Pico acks.
+        pub version: u8,
+        /// The last READ promised a pipelined follow-up frame (v3).
+        pub more: bool,
+        /// Sequence number of the next v6 WRITE.
+        write_seq: u8,
+        /// Recent v6 WRITE frames, oldest first, as sent.
+        sent: VecDeque<(u8, Vec<u8>)>,
+        /// v6 READs that failed their CRC check.
+        pub crc_errors: u32,
+        /// When the last `request_and_read` clocked its frame out, start to
+        /// end, for the trace; None if it got none.
+        pub read_span: Option<(Instant, Instant)>,
+        /// What a READ clocks out: the command, then zeros.
+        read_tx: Vec<u8>,
+        /// A READY wait ended without reading the edge that ended it, so a
+        /// stale falling edge may be queued: clear them before the next
+        /// command.
+        ready_stale: bool,
     }
 
     impl SpiMaster {
@@ -80,92 +200,338 @@ mod hw {
                 .with_line(PIN_READY)
                 .as_input()
                 .with_bias(Bias::PullUp)
+                .with_edge_detection(EdgeDetection::BothEdges)
                 .with_consumer("shein-ready")
                 .request()
                 .context("Failed to request READY GPIO")?;
 
-            Ok(Self {
+            Ok(Self::with_ports(Some(spi), Some(ready), None, super::PROTO_V1))
+        }
+
+        /// Talk over the USB link instead. Its stream has one framing, the
+        /// TLVs and credits of v7 without the READ header, so `version`
+        /// starts at v7 and stays there.
+        fn usb(usb: UsbPort) -> Self {
+            Self::with_ports(None, None, Some(usb), super::PROTO_V7)
+        }
+
+        fn with_ports(
+            spi: Option<Spidev>,
+            ready: Option<Request>,
+            usb: Option<UsbPort>,
+            version: u8,
+        ) -> Self {
+            Self {
                 spi,
                 ready,
+                usb,
                 buf: [0u16; super::NUM_DEVICES],
-            })
+                version,
+                more: false,
+                write_seq: 0,
+                sent: VecDeque::new(),
+                read_tx: {
+                    let mut tx = vec![0u8; super::MAX_READ_FRAME];
+                    tx[0] = SPI_CMD_READ;
+                    tx
+                },
+                crc_errors: 0,
+                read_span: None,
+                ready_stale: false,
+            }
         }
 
-        fn wait_ready(&self, timeout: Duration) -> Result<bool> {
+        /// Block until the next READY edge of `kind`, reading and skipping
+        /// the others. Returns false if none comes within `timeout`.
+        fn wait_ready_edge(&mut self, kind: EdgeKind, timeout: Duration) -> Result<bool> {
             let deadline = Instant::now() + timeout;
-            while Instant::now() < deadline {
-                if self.ready.value(PIN_READY)? == Value::Inactive {
+            loop {
+                let left = deadline.saturating_duration_since(Instant::now());
+                let ready = port(&mut self.ready)?;
+                if left.is_zero() || !ready.wait_edge_event(left)? {
+                    self.ready_stale = true;
+                    return Ok(false);
+                }
+                if ready.read_edge_event()?.kind == kind {
                     return Ok(true);
                 }
-                std::thread::sleep(Duration::from_micros(100));
             }
-            Ok(false)
         }
 
-        fn wait_ready_deasserted(&self, timeout: Duration) -> Result<bool> {
-            let deadline = Instant::now() + timeout;
-            while Instant::now() < deadline {
-                if self.ready.value(PIN_READY)? == Value::Active {
-                    return Ok(true);
-                }
-                std::thread::sleep(Duration::from_micros(100));
+        /// Read every READY edge already queued.
+        fn clear_ready_edges(&mut self) -> Result<()> {
+            let ready = port(&mut self.ready)?;
+            while ready.has_edge_event()? {
+                ready.read_edge_event()?;
             }
-            Ok(false)
+            self.ready_stale = false;
+            Ok(())
+        }
+
+        /// Wait for READY to assert after a command: the kernel wakes this
+        /// thread on the falling edge, so the READ goes out as soon as the
+        /// Pico has staged it. Each frame's rising edge is still queued
+        /// when the next wait starts and is skipped. An edge missed
+        /// altogether (READY was already low) is caught by the level once
+        /// the wait times out.
+        fn wait_ready(&mut self, timeout: Duration) -> Result<bool> {
+            if self.wait_ready_edge(EdgeKind::Falling, timeout)? {
+                return Ok(true);
+            }
+            Ok(port(&mut self.ready)?.value(PIN_READY)? == Value::Inactive)
+        }
+
+        /// Wait for READY to deassert. The level settles it when READY is
+        /// already high, as it is by the time a READ's transfer returns;
+        /// otherwise the edges queued so far belong to the assertion that
+        /// is still up, so they are cleared before waiting for the rise.
+        fn wait_ready_deasserted(&mut self, timeout: Duration) -> Result<bool> {
+            if port(&mut self.ready)?.value(PIN_READY)? == Value::Active {
+                return Ok(true);
+            }
+            self.clear_ready_edges()?;
+            if port(&mut self.ready)?.value(PIN_READY)? == Value::Active {
+                return Ok(true);
+            }
+            self.wait_ready_edge(EdgeKind::Rising, timeout)
         }
 
         pub fn write(&mut self, payload: &[u8]) -> Result<bool> {
             if payload.len() > super::MAX_PAYLOAD {
                 return Ok(false);
             }
+            if let Some(usb) = &self.usb {
+                usb.write(payload)?;
+                return Ok(true);
+            }
 
             let len = payload.len() as u16;
-            let mut tx = Vec::with_capacity(3 + payload.len());
+            let mut tx = Vec::with_capacity(4 + payload.len() + CRC_SIZE);
             tx.push(SPI_CMD_WRITE);
             tx.push((len >> 8) as u8);
             tx.push((len & 0xFF) as u8);
+            if self.version >= super::PROTO_V6 {
+                tx.push(self.write_seq);
+            }
             tx.extend_from_slice(payload);
+            if self.version >= super::PROTO_V6 {
+                let crc = super::crc32(&tx[1..]);
+                tx.extend_from_slice(&crc.to_le_bytes());
+            }
 
-            self.spi
+            port(&mut self.spi)?
                 .write_all(&tx)
                 .context("SPI WRITE transfer failed")?;
 
+            if self.version >= super::PROTO_V6 {
+                if self.sent.len() == WRITE_HISTORY {
+                    self.sent.pop_front();
+                }
+                self.sent.push_back((self.write_seq, tx));
+                self.write_seq = self.write_seq.wrapping_add(1);
+            }
+
             Ok(true)
         }
 
-        pub fn request_and_read(
+        /// Resend every v6 WRITE from `seq` on, after the Pico dropped that
+        /// one. Returns how many were resent, 0 if `seq` is no longer kept.
+        pub fn resend_from(&mut self, seq: u8) -> Result<usize> {
+            let Some(start) = self.sent.iter().position(|(s, _)| *s == seq) else {
+                return Ok(0);
+            };
+            let spi = port(&mut self.spi)?;
+            for (_, tx) in self.sent.range(start..) {
+                spi.write_all(tx)
+                    .context("SPI WRITE resend failed")?;
+            }
+            Ok(self.sent.len() - start)
+        }
+
+        /// Change the SPI clock. Takes effect from the next transfer.
+        pub fn set_speed(&mut self, hz: u32) -> Result<()> {
+            if self.usb.is_some() {
+                return Ok(());
+            }
+            let options = SpidevOptions::new().max_speed_hz(hz).build();
+            port(&mut self.spi)?
+                .configure(&options)
+                .context("Failed to set SPI clock")?;
+            Ok(())
+        }
+
+        /// Ask the Pico to switch READ framing. The Pico acks with a Device 1
+        /// `['V', version]` TLV; call `set_version` when that arrives.
+        pub fn send_set_version(&mut self, version: u8) -> Result<()> {
+            if self.usb.is_some() {
+                return Ok(());
+            }
+            port(&mut self.spi)?
+                .write_all(&[SPI_CMD_SET_VERSION, version])
+                .context("SPI SET_VERSION transfer failed")?;
+            Ok(())
+        }
+
+        /// Switch READ framing. WRITE numbering restarts with it, as it
+        /// does on the Pico.
+        pub fn set_version(&mut self, version: u8) {
+            if self.usb.is_none() {
+                self.version = version;
+            }
+            self.more = false;
+            self.write_seq = 0;
+            self.sent.clear();
+        }
+
+        /// Fetch the next frame. Skips the REQUEST when the previous READ
+        /// promised a pipelined follow-up; the Pico drops READY as the READ
+        /// ends (well before the transfer call returns), so the next
+        /// READY seen is the new frame's. In v6 a frame failing its CRC is
+        /// NAKed, which makes the Pico stage it again; after READ_RETRIES
+        /// this gives up, returning None as on a timeout.
+        ///
+        /// The frame is read into `frame`, which keeps its allocation from
+        /// one READ to the next, and the payload is returned as a slice of
+        /// it along with the header's BUF estimates.
+        ///
+        /// On the USB link the "frame" is the whole TLVs that have arrived,
+        /// up to a payload's worth, and empty on a timeout; with no header,
+        /// BUF is all zeros and only the credits move `buf`.
+        pub fn request_and_read<'a>(
             &mut self,
             timeout: Duration,
-        ) -> Result<Option<(Vec<u8>, [u16; super::NUM_DEVICES])>> {
-            self.spi
-                .write_all(&[SPI_CMD_REQUEST])
-                .context("SPI REQUEST transfer failed")?;
-
-            if !self.wait_ready(timeout)? {
-                return Ok(None);
+            frame: &'a mut Vec<u8>,
+        ) -> Result<Option<(&'a [u8], [u16; super::NUM_DEVICES])>> {
+            let mut cmd = (!self.more).then_some(SPI_CMD_REQUEST);
+            self.more = false;
+            self.read_span = None;
+
+            if let Some(usb) = &self.usb {
+                self.more = usb.read_tlvs(timeout, frame, super::MAX_PAYLOAD);
+                return Ok(Some((&frame[..], [0u16; super::NUM_DEVICES])));
             }
 
-            let mut tx_buf = vec![0u8; READ_SIZE];
-            tx_buf[0] = SPI_CMD_READ;
-            let mut rx_buf = vec![0u8; READ_SIZE];
+            let mut retries = 0;
+            let payload = loop {
+                if let Some(cmd) = cmd {
+                    if self.ready_stale {
+                        self.clear_ready_edges()?;
+                    }
+                    port(&mut self.spi)?
+                        .write_all(&[cmd])
+                        .context("SPI REQUEST/NAK transfer failed")?;
+                }
+                if cmd == Some(SPI_CMD_NAK) {
+                    // READY may still be up for a pipelined frame; the Pico
+                    // drops it when it takes the NAK.
+                    let _ = self.wait_ready_deasserted(Duration::from_millis(10));
+                }
 
-            let mut transfer = SpidevTransfer::read_write(&tx_buf, &mut rx_buf);
-            self.spi
-                .transfer(&mut transfer)
-                .context("SPI READ transfer failed")?;
+                if !self.wait_ready(timeout)? {
+                    // A NAK lost in transit (or sent into a bad frame's tail)
+                    // is simply sent again.
+                    if cmd == Some(SPI_CMD_NAK) && retries < READ_RETRIES {
+                        retries += 1;
+                        continue;
+                    }
+                    return Ok(None);
+                }
 
-            let _ = self.wait_ready_deasserted(Duration::from_millis(100));
+                let start = Instant::now();
+                let payload = if self.version >= super::PROTO_V2 {
+                    self.read_v2(frame)?
+                } else {
+                    self.read_v1(frame)?
+                };
+                self.read_span = Some((start, Instant::now()));
+                if self.version < super::PROTO_V6 || Self::frame_crc_ok(frame) {
+                    break payload;
+                }
+                self.crc_errors += 1;
+                if retries == READ_RETRIES {
+                    return Ok(None);
+                }
+                retries += 1;
+                cmd = Some(SPI_CMD_NAK);
+            };
+
+            // Bytes 8..10: payload length (big-endian), MORE flag in v3
+            let more = self.version >= super::PROTO_V3 && frame[8] & READ_LEN_MORE != 0;
+            if !more {
+                let _ = self.wait_ready_deasserted(Duration::from_millis(100));
+            }
+            self.more = more;
 
-            // Bytes 0..8: per-device buffer estimates (in 16-byte units), convert to bytes
+            // Bytes 0..8: per-device buffer estimates (in BUF units), convert
+            // to bytes. From v5 on the caller folds them into `buf` along
+            // with the frame's credits.
+            let unit = super::buf_unit(self.version);
+            let mut hdr_buf = [0u16; super::NUM_DEVICES];
             for i in 0..super::NUM_DEVICES {
-                self.buf[i] = (rx_buf[i] as u16) * 16;
+                hdr_buf[i] = (frame[i] as u16) * unit;
+            }
+            if self.version < super::PROTO_V5 {
+                self.buf = hdr_buf;
+            }
+
+            Ok(Some((&frame[payload], hdr_buf)))
+        }
+
+        /// The payload bytes of a READ header, MORE flag masked off.
+        fn payload_len(hdr: &[u8]) -> usize {
+            ((((hdr[8] & !READ_LEN_MORE) as usize) << 8) | (hdr[9] as usize))
+                .min(super::MAX_PAYLOAD)
+        }
+
+        /// READ header bytes: v6 adds the CRC.
+        fn read_hdr_size(&self) -> usize {
+            if self.version >= super::PROTO_V6 {
+                READ_HDR_SIZE + CRC_SIZE
+            } else {
+                READ_HDR_SIZE
             }
+        }
+
+        /// Check a v6 frame's CRC, which covers the first 10 header bytes
+        /// and the payload.
+        fn frame_crc_ok(rx_buf: &[u8]) -> bool {
+            let (hdr, payload) = rx_buf.split_at(READ_HDR_SIZE + CRC_SIZE);
+            let sent = u32::from_le_bytes([hdr[10], hdr[11], hdr[12], hdr[13]]);
+            !super::crc32_feed(super::crc32_feed(!0, &hdr[..READ_HDR_SIZE]), payload) == sent
+        }
 
-            // Bytes 8..10: payload length (big-endian)
-            let payload_len = ((rx_buf[8] as usize) << 8) | (rx_buf[9] as usize);
-            let payload_len = payload_len.min(super::MAX_PAYLOAD);
-            let payload = rx_buf[10..10 + payload_len].to_vec();
+        /// v1 READ: one fixed `READ_SIZE` transfer into `frame`. Returns
+        /// where the payload is.
+        fn read_v1(&mut self, frame: &mut Vec<u8>) -> Result<Range<usize>> {
+            frame.resize(READ_SIZE, 0);
+            let mut transfer = SpidevTransfer::read_write(&self.read_tx[..READ_SIZE], frame);
+            port(&mut self.spi)?
+                .transfer(&mut transfer)
+                .context("SPI READ transfer failed")?;
+            Ok(READ_HDR_SIZE..READ_HDR_SIZE + Self::payload_len(frame))
+        }
 
-            Ok(Some((payload, self.buf)))
+        /// v2 READ: header transfer, then exactly LEN payload bytes, into
+        /// `frame`. Returns where the payload is.
+        fn read_v2(&mut self, frame: &mut Vec<u8>) -> Result<Range<usize>> {
+            let hdr_size = self.read_hdr_size();
+            frame.resize(hdr_size, 0);
+            let mut transfer = SpidevTransfer::read_write(&self.read_tx[..hdr_size], frame);
+            port(&mut self.spi)?
+                .transfer(&mut transfer)
+                .context("SPI READ header transfer failed")?;
+
+            let payload_len = Self::payload_len(frame);
+            if payload_len > 0 {
+                frame.resize(hdr_size + payload_len, 0);
+                // The zeros after the command byte
+                let tx_payload = &self.read_tx[hdr_size..hdr_size + payload_len];
+                let mut transfer = SpidevTransfer::read_write(tx_payload, &mut frame[hdr_size..]);
+                port(&mut self.spi)?
+                    .transfer(&mut transfer)
+                    .context("SPI READ payload transfer failed")?;
+            }
+            Ok(hdr_size..hdr_size + payload_len)
         }
     }
 }
@@ -175,7 +541,11 @@ mod hw {
 #[cfg(not(target_os = "linux"))]
 mod hw {
     use anyhow::Result;
-    use std::time::Duration;
+    use std::time::{Duration, Instant};
+
+    pub fn open_usb(_path: &str) -> Result<(IrqWatcher, SpiMaster)> {
+        anyhow::bail!("The USB link needs Linux")
+    }
 
     pub struct IrqWatcher;
 
@@ -200,15 +570,36 @@ mod hw {
 
     pub struct SpiMaster {
         pub buf: [u16; super::NUM_DEVICES],
+        pub version: u8,
+        pub more: bool,
+        pub crc_errors: u32,
+        pub read_span: Option<(Instant, Instant)>,
     }
 
     impl SpiMaster {
         pub fn new() -> Result<Self> {
             Ok(Self {
                 buf: [255 * 16; super::NUM_DEVICES],
+                version: super::PROTO_V1,
+                more: false,
+                crc_errors: 0,
+                read_span: None,
             })
         }
 
+        pub fn set_speed(&mut self, _hz: u32) -> Result<()> {
+            Ok(())
+        }
+
+        pub fn send_set_version(&mut self, _version: u8) -> Result<()> {
+            Ok(())
+        }
+
+        pub fn set_version(&mut self, version: u8) {
+            self.version = version;
+            self.more = false;
+        }
+
         pub fn write(&mut self, payload: &[u8]) -> Result<bool> {
             if payload.len() > super::MAX_PAYLOAD {
                 return Ok(false);
@@ -216,14 +607,20 @@ mod hw {
             Ok(true)
         }
 
-        pub fn request_and_read(
+        pub fn resend_from(&mut self, _seq: u8) -> Result<usize> {
+            Ok(0)
+        }
+
+        pub fn request_and_read<'a>(
             &mut self,
             _timeout: Duration,
-        ) -> Result<Option<(Vec<u8>, [u16; super::NUM_DEVICES])>> {
-            self.buf = [255 * 16; super::NUM_DEVICES];
-            Ok(Some((Vec::new(), self.buf)))
+            frame: &'a mut Vec<u8>,
+        ) -> Result<Option<(&'a [u8], [u16; super::NUM_DEVICES])>> {
+            self.buf = [255 * super::buf_unit(self.version); super::NUM_DEVICES];
+            frame.clear();
+            Ok(Some((&frame[..], self.buf)))
         }
     }
 }
 
-pub use hw::{IrqWatcher, SpiMaster};
+pub use hw::{IrqWatcher, SpiMaster, open_usb};
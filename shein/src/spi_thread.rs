@@ -0,0 +1,566 @@
+//! The SPI I/O thread. It owns the `SpiMaster` and the IRQ line, so the
+//! Pico is read as soon as it has data, and WRITEs go out as soon as the UI
+//! queues them, whatever the UI thread is doing: a redraw that is slow over
+//! SSH no longer holds the link up. The link's own business is done here
+//! too (version switches, v6 resends, clock training); everything for the
+//! devices, the credits among it, stays with the UI.
+//!
+//! Both ways go through std's bounded (lock-free) channels: READ payloads
+//! and the rest reach the UI as `Wake::Spi` on its wake channel, and WRITE
+//! frames come back as `ToSpi::Write`. A UI that falls far enough behind to
+//! fill its channel still holds reads up, as the Pico holds back data that
+//! the Zero has no room for.
+//!
+//! With `--rt-priority N` the thread and the IRQ watcher run SCHED_FIFO at
+//! that priority, and with `--cpu N` they're pinned to that CPU, so the rest
+//! of the system can't delay them either.
+
+use std::sync::Arc;
+use std::sync::atomic::{AtomicBool, AtomicU8, Ordering};
+use std::sync::mpsc::{self, Receiver, RecvTimeoutError, SyncSender, TrySendError};
+use std::thread;
+use std::time::{Duration, Instant};
+
+use anyhow::{Result, anyhow};
+
+use crate::link::{self, Link};
+use crate::parse_tlv_payload;
+use crate::spi_master::{IrqWatcher, MAX_PAYLOAD, NUM_DEVICES, PROTO_V1, PROTO_V5, PROTO_V8, SpiMaster};
+use crate::trace::{EVT_SPI_READ, EVT_SPI_REQUEST, EVT_SPI_WRITE};
+use crate::Wake;
+
+/// WRITEs sent back to back before checking for READ data: 4 full frames
+/// stay inside the Pico's 8 KB SPI RX ring.
+const MAX_WRITE_BURST: usize = 4;
+/// WRITE frames the UI may have queued for the thread.
+const WRITE_QUEUE: usize = 2 * MAX_WRITE_BURST;
+const PICO_REBOOT_TIME: Duration = Duration::from_millis(500); // Reset 'R' -> Pico serving again
+const READ_TIMEOUT: Duration = Duration::from_millis(100);
+const EDGE_WAIT: Duration = Duration::from_secs(1); // IRQ thread checks for shutdown this often
+
+/// Something for the SPI thread to act on.
+pub enum ToSpi {
+    /// The IRQ line fell: the Pico has data.
+    Irq,
+    /// A frame of whole TLVs to WRITE.
+    Write(Vec<u8>),
+    /// The IRQ thread failed.
+    Failed(anyhow::Error),
+}
+
+/// What the SPI thread has for the UI.
+pub enum SpiEvent {
+    /// A READ's payload of whole TLVs. `buf` is its header's BUF estimates
+    /// (v5 on), and `writes` the WRITE frames from the UI sent before it
+    /// was asked for.
+    Read { payload: Vec<u8>, buf: Option<[u16; NUM_DEVICES]>, writes: u64 },
+    /// WRITE frames went out: there's room in the queue again.
+    Wrote,
+    /// An SPI transaction, start to end, for the trace being recorded.
+    Span { event: u8, arg: u16, start: Instant, end: Instant },
+    /// A line for the log; a `verbose` one only shows in verbose mode.
+    Log { verbose: bool, msg: String },
+}
+
+/// Scheduling for the SPI and IRQ threads.
+#[derive(Default)]
+pub struct Sched {
+    /// SCHED_FIFO priority, 1-99.
+    pub priority: Option<i32>,
+    pub cpu: Option<usize>,
+}
+
+/// What the UI reads of the thread's state without a message for it.
+#[derive(Default)]
+struct Shared {
+    /// READ framing in use.
+    version: AtomicU8,
+    /// The IRQ line was asserted when last looked at: more is coming.
+    busy: AtomicBool,
+    /// Send `Span`s and verbose `Log`s.
+    tracing: AtomicBool,
+    verbose: AtomicBool,
+}
+
+/// The UI's end of the SPI thread.
+pub struct SpiThread {
+    tx: SyncSender<ToSpi>,
+    shared: Arc<Shared>,
+    /// A WRITE frame the queue had no room for, sent before any other.
+    held: Option<Vec<u8>>,
+    /// WRITE frames queued so far.
+    queued: u64,
+}
+
+impl SpiThread {
+    /// Start the thread, and the IRQ watcher that wakes it, on a link that
+    /// has had its initial sync.
+    pub fn spawn(master: SpiMaster, irq: IrqWatcher, wake: SyncSender<Wake>, sched: Sched) -> Self {
+        let (tx, rx) = mpsc::sync_channel(WRITE_QUEUE);
+        let shared = Arc::new(Shared::default());
+        shared.version.store(master.version, Ordering::Relaxed);
+        let irq = Arc::new(irq);
+        let sched = Arc::new(sched);
+        spawn_irq_thread(Arc::clone(&irq), tx.clone(), Arc::clone(&sched));
+
+        let mut worker = Worker {
+            master,
+            irq,
+            rx,
+            wake: wake.clone(),
+            shared: Arc::clone(&shared),
+            frame: Vec::new(),
+            written: 0,
+            renegotiate_after: None,
+            link: Link::new(),
+            train_pending: false,
+            write_naks: 0,
+            link_errors_seen: 0,
+        };
+        thread::spawn(move || {
+            for e in apply_sched(&sched) {
+                if worker.log(format!("SPI thread: {e}")).is_err() {
+                    return;
+                }
+            }
+            if let Err(e) = worker.run() {
+                let _ = wake.send(Wake::Failed(e));
+            }
+        });
+        Self { tx, shared, held: None, queued: 0 }
+    }
+
+    /// The READ framing in use.
+    pub fn version(&self) -> u8 {
+        self.shared.version.load(Ordering::Relaxed)
+    }
+
+    /// The Pico had more data when the thread last looked.
+    pub fn busy(&self) -> bool {
+        self.shared.busy.load(Ordering::Relaxed)
+    }
+
+    pub fn set_tracing(&self, on: bool) {
+        self.shared.tracing.store(on, Ordering::Relaxed);
+    }
+
+    pub fn set_verbose(&self, on: bool) {
+        self.shared.verbose.store(on, Ordering::Relaxed);
+    }
+
+    /// Whether `write` may be called: no frame is held.
+    pub fn can_write(&self) -> bool {
+        self.held.is_none()
+    }
+
+    /// Queue a WRITE frame. One the queue has no room for is held until
+    /// `flush` gets it in.
+    pub fn write(&mut self, frame: Vec<u8>) {
+        debug_assert!(self.held.is_none());
+        self.held = Some(frame);
+        self.flush();
+    }
+
+    /// Queue the held frame, if there's room now.
+    pub fn flush(&mut self) {
+        let Some(frame) = self.held.take() else {
+            return;
+        };
+        match self.tx.try_send(ToSpi::Write(frame)) {
+            Ok(()) => self.queued += 1,
+            Err(TrySendError::Full(ToSpi::Write(frame))) => self.held = Some(frame),
+            // Gone: its Wake::Failed says why.
+            Err(_) => {}
+        }
+    }
+
+    /// Whether a READ sent before `writes` WRITEs went out came after
+    /// every frame queued: its BUF then knows about all of them.
+    pub fn settled(&self, writes: u64) -> bool {
+        writes == self.queued && self.held.is_none()
+    }
+}
+
+/// The SPI thread's side.
+struct Worker {
+    master: SpiMaster,
+    irq: Arc<IrqWatcher>,
+    rx: Receiver<ToSpi>,
+    wake: SyncSender<Wake>,
+    shared: Arc<Shared>,
+    /// Every READ frame lands here, so it is allocated once, not per READ.
+    frame: Vec<u8>,
+    /// WRITE frames from the UI sent so far.
+    written: u64,
+    /// After a Pico reset, send SET_VERSION on the first READ past this time.
+    renegotiate_after: Option<Instant>,
+    /// The SPI clock, and the errors that may lower it.
+    link: Link,
+    /// A version ack came in: train the link once the drain is done.
+    train_pending: bool,
+    /// v6 WRITEs the Pico NAKed.
+    write_naks: u32,
+    /// READ CRC errors and WRITE NAKs already passed to `link`.
+    link_errors_seen: u32,
+}
+
+impl Worker {
+    fn run(&mut self) -> Result<()> {
+        loop {
+            self.drain()?;
+            if self.train_pending {
+                self.train()?;
+            }
+            self.check_link()?;
+
+            // The level, not the edge, says whether the Pico still has
+            // data: an edge may have come and gone during the last drain.
+            let busy = self.irq.is_asserted()?;
+            self.shared.busy.store(busy, Ordering::Relaxed);
+            let first = if busy {
+                self.rx.recv_timeout(Duration::ZERO)
+            } else {
+                self.rx.recv().map_err(|_| RecvTimeoutError::Disconnected)
+            };
+            let mut next = match first {
+                Ok(msg) => Some(msg),
+                Err(RecvTimeoutError::Timeout) => None,
+                Err(RecvTimeoutError::Disconnected) => return Ok(()),
+            };
+            let mut writes = 0;
+            while let Some(msg) = next {
+                match msg {
+                    // drain checks the line itself
+                    ToSpi::Irq => {}
+                    ToSpi::Write(frame) => {
+                        self.write(&frame)?;
+                        self.written += 1;
+                        writes += 1;
+                    }
+                    ToSpi::Failed(e) => return Err(e),
+                }
+                if writes == MAX_WRITE_BURST {
+                    break;
+                }
+                next = self.rx.try_recv().ok();
+            }
+            if writes > 0 {
+                self.send(SpiEvent::Wrote)?;
+            }
+        }
+    }
+
+    fn send(&self, event: SpiEvent) -> Result<()> {
+        self.wake.send(Wake::Spi(event)).map_err(|_| anyhow!("SPI thread: the UI has gone"))
+    }
+
+    fn log(&self, msg: String) -> Result<()> {
+        self.send(SpiEvent::Log { verbose: false, msg })
+    }
+
+    fn log_verbose(&self, msg: impl FnOnce() -> String) -> Result<()> {
+        if !self.shared.verbose.load(Ordering::Relaxed) {
+            return Ok(());
+        }
+        self.send(SpiEvent::Log { verbose: true, msg: msg() })
+    }
+
+    /// Pass an SPI transaction to the trace, if one is recording.
+    fn span(&self, event: u8, arg: u16, start: Instant, end: Instant) -> Result<()> {
+        if !self.shared.tracing.load(Ordering::Relaxed) {
+            return Ok(());
+        }
+        self.send(SpiEvent::Span { event, arg, start, end })
+    }
+
+    /// WRITE a frame, timing it for the trace.
+    fn write(&mut self, frame: &[u8]) -> Result<()> {
+        let start = Instant::now();
+        self.master.write(frame)?;
+        self.span(EVT_SPI_WRITE, frame.len() as u16, start, Instant::now())
+    }
+
+    /// Check IRQ and drain all pending SPI data.
+    fn drain(&mut self) -> Result<()> {
+        if !self.irq.is_asserted()? {
+            return Ok(());
+        }
+
+        self.log_verbose(|| "drain_spi: IRQ asserted".to_string())?;
+        let mut round = 0u32;
+        loop {
+            round += 1;
+            // Out of self while the payload is borrowed from it.
+            let mut frame = std::mem::take(&mut self.frame);
+            let requested = !self.master.more;
+            let writes = self.written;
+            let start = Instant::now();
+            let result = self.master.request_and_read(READ_TIMEOUT, &mut frame)?;
+            let done = match result {
+                Some((payload, hdr_buf)) => {
+                    if let Some((read_start, read_end)) = self.master.read_span {
+                        if requested {
+                            self.span(EVT_SPI_REQUEST, 0, start, read_start)?;
+                        }
+                        self.span(EVT_SPI_READ, payload.len() as u16, read_start, read_end)?;
+                    }
+                    if !self.master.more
+                        && self.renegotiate_after.is_some_and(|t| Instant::now() >= t)
+                    {
+                        self.renegotiate_after = None;
+                        self.master.send_set_version(PROTO_V8)?;
+                    }
+                    self.log_verbose(|| {
+                        format!("drain_spi[{round}]: READ {} payload bytes", payload.len())
+                    })?;
+                    // v5: BUF, sampled by the Pico before the credits in
+                    // the frame, floors the UI's estimates.
+                    let buf = (self.master.version >= PROTO_V5).then_some(hdr_buf);
+                    let done = !self.master.more && payload.len() < MAX_PAYLOAD;
+                    let payload = payload.to_vec();
+                    self.link_rx(&payload)?;
+                    if !payload.is_empty() || buf.is_some() {
+                        self.send(SpiEvent::Read { payload, buf, writes })?;
+                    }
+                    done
+                }
+                None => {
+                    self.log(format!(
+                        "drain_spi[{round}]: READY timeout or CRC errors ({} so far)",
+                        self.master.crc_errors
+                    ))?;
+                    true
+                }
+            };
+            self.frame = frame;
+            if done {
+                break;
+            }
+        }
+        Ok(())
+    }
+
+    /// Act on the link's own TLVs in a READ, here rather than in the UI:
+    /// a version switch or a Pico reset changes how the next READ goes.
+    /// The UI gets them all the same.
+    fn link_rx(&mut self, payload: &[u8]) -> Result<()> {
+        for (device, data) in parse_tlv_payload(payload) {
+            if device != 1 {
+                continue;
+            }
+            match data {
+                b"R" => self.pico_reset()?,
+                [b'V', version] => {
+                    self.master.set_version(*version);
+                    self.shared.version.store(*version, Ordering::Relaxed);
+                    self.train_pending = true;
+                }
+                [b'P', ..] => self.link.echo(data),
+                [b'N', seq] => {
+                    // v6: the Pico dropped WRITE seq (bad CRC or a gap)
+                    self.write_naks += 1;
+                    match self.master.resend_from(*seq) {
+                        Ok(0) => self.log(format!("WRITE {seq} lost: too old to resend"))?,
+                        Ok(n) => self.log_verbose(|| format!("Resent {n} WRITEs from {seq}"))?,
+                        Err(e) => self.log(format!("WRITE resend failed: {e}"))?,
+                    }
+                }
+                _ => {}
+            }
+        }
+        Ok(())
+    }
+
+    /// The Pico is rebooting (Device 1 ['R']).
+    fn pico_reset(&mut self) -> Result<()> {
+        // The rebooted Pico starts on v1 framing; negotiate again once it
+        // has had time to come back up and answered a READ.
+        self.master.set_version(PROTO_V1);
+        self.shared.version.store(PROTO_V1, Ordering::Relaxed);
+        self.renegotiate_after = Some(Instant::now() + PICO_REBOOT_TIME);
+
+        // Resync at the default clock; the ack trains the link again.
+        self.link.set_rate(link::DEFAULT_RATE);
+        if let Err(e) = self.master.set_speed(self.link.hz()) {
+            self.log(format!("SPI clock reset failed: {e}"))?;
+        }
+        Ok(())
+    }
+
+    /// Link errors so far: READs that failed their CRC and WRITEs NAKed.
+    fn link_errors(&self) -> u32 {
+        self.master.crc_errors + self.write_naks
+    }
+
+    /// Find the fastest SPI clock the wiring takes: step up through
+    /// `link::RATES_HZ` until a rate's probes fail, and settle on the last
+    /// that passed. Traffic that arrives meanwhile goes to the UI as usual.
+    fn train(&mut self) -> Result<()> {
+        self.train_pending = false;
+        let mut best = None;
+        for rate in 0..link::RATES_HZ.len() {
+            self.master.set_speed(link::RATES_HZ[rate])?;
+            if !self.probe(rate)? {
+                break;
+            }
+            best = Some(rate);
+        }
+        let rate = best.unwrap_or(link::DEFAULT_RATE);
+        self.link.set_rate(rate);
+        self.master.set_speed(self.link.hz())?;
+        self.link_errors_seen = self.link_errors();
+        match best {
+            Some(_) => self.log(format!("SPI link trained to {} MHz", self.link.hz() / 1_000_000)),
+            None => self.log(format!(
+                "SPI link training: no probe came back, staying at {} MHz",
+                self.link.hz() / 1_000_000
+            )),
+        }
+    }
+
+    /// Send each of `rate`'s probes and wait for its echo. The rate passes
+    /// if every echo matches and no link errors came up meanwhile.
+    fn probe(&mut self, rate: usize) -> Result<bool> {
+        let errors = self.link_errors();
+        for round in 0..link::PROBE_ROUNDS {
+            let probe = link::probe(rate, round);
+            let mut tlv = vec![0, probe.len() as u8];
+            tlv.extend_from_slice(&probe);
+            self.link.expect(probe);
+            self.write(&tlv)?;
+
+            let deadline = Instant::now() + link::PROBE_TIMEOUT;
+            while self.link.awaiting() {
+                if Instant::now() >= deadline {
+                    return Ok(false);
+                }
+                if self.irq.is_asserted()? {
+                    self.drain()?;
+                } else {
+                    thread::sleep(Duration::from_millis(1));
+                }
+            }
+            if !self.link.matched {
+                return Ok(false);
+            }
+        }
+        Ok(self.link_errors() == errors)
+    }
+
+    /// Step the clock down if link errors have been bunching up.
+    fn check_link(&mut self) -> Result<()> {
+        let errors = self.link_errors();
+        let new = errors - self.link_errors_seen;
+        if new == 0 {
+            return Ok(());
+        }
+        self.link_errors_seen = errors;
+        if let Some(rate) = self.link.note_errors(Instant::now(), new) {
+            self.master.set_speed(link::RATES_HZ[rate])?;
+            self.log(format!(
+                "SPI link errors rising: clock down to {} MHz",
+                link::RATES_HZ[rate] / 1_000_000
+            ))?;
+        }
+        Ok(())
+    }
+}
+
+/// Forward IRQ falling edges to the SPI thread. The thread ends with the
+/// process, or on its next send once the SPI thread has gone.
+fn spawn_irq_thread(irq: Arc<IrqWatcher>, tx: SyncSender<ToSpi>, sched: Arc<Sched>) {
+    thread::spawn(move || {
+        // Its complaints are the SPI thread's, so it alone logs them.
+        let _ = apply_sched(&sched);
+        loop {
+            let msg = match irq.wait_edge(EDGE_WAIT) {
+                Ok(false) => continue,
+                Ok(true) => match irq.consume_edge() {
+                    Ok(()) => ToSpi::Irq,
+                    Err(e) => ToSpi::Failed(e),
+                },
+                Err(e) => ToSpi::Failed(e),
+            };
+            let failed = matches!(msg, ToSpi::Failed(_));
+            if tx.send(msg).is_err() || failed {
+                return;
+            }
+        }
+    });
+}
+
+/// Apply `sched` to the calling thread, returning a note on each setting
+/// for the log, whether it took or not (SCHED_FIFO wants root or
+/// CAP_SYS_NICE).
+fn apply_sched(sched: &Sched) -> Vec<String> {
+    let mut notes = Vec::new();
+    if let Some(priority) = sched.priority {
+        match sched::set_fifo(priority) {
+            Ok(()) => notes.push(format!("SCHED_FIFO priority {priority}")),
+            Err(e) => notes.push(format!("SCHED_FIFO priority {priority} failed: {e}")),
+        }
+    }
+    if let Some(cpu) = sched.cpu {
+        match sched::set_cpu(cpu) {
+            Ok(()) => notes.push(format!("pinned to CPU {cpu}")),
+            Err(e) => notes.push(format!("pinning to CPU {cpu} failed: {e}")),
+        }
+    }
+    notes
+}
+
+#[cfg(target_os = "linux")]
+mod sched {
+    use std::io;
+
+    const SCHED_FIFO: i32 = 1;
+    /// CPUs in a glibc cpu_set_t.
+    const CPU_SETSIZE: usize = 1024;
+
+    #[repr(C)]
+    struct SchedParam {
+        sched_priority: i32,
+    }
+
+    unsafe extern "C" {
+        fn sched_setscheduler(pid: i32, policy: i32, param: *const SchedParam) -> i32;
+        fn sched_setaffinity(pid: i32, cpusetsize: usize, mask: *const u64) -> i32;
+    }
+
+    /// Run the calling thread SCHED_FIFO at `priority`.
+    pub fn set_fifo(priority: i32) -> io::Result<()> {
+        let param = SchedParam { sched_priority: priority };
+        // SAFETY: `param` outlives the call; pid 0 is the calling thread.
+        if unsafe { sched_setscheduler(0, SCHED_FIFO, &param) } != 0 {
+            return Err(io::Error::last_os_error());
+        }
+        Ok(())
+    }
+
+    /// Keep the calling thread on `cpu`.
+    pub fn set_cpu(cpu: usize) -> io::Result<()> {
+        if cpu >= CPU_SETSIZE {
+            return Err(io::Error::from(io::ErrorKind::InvalidInput));
+        }
+        let mut mask = [0u64; CPU_SETSIZE / 64];
+        mask[cpu / 64] |= 1 << (cpu % 64);
+        // SAFETY: `mask` is a whole cpu_set_t and outlives the call.
+        if unsafe { sched_setaffinity(0, size_of_val(&mask), mask.as_ptr()) } != 0 {
+            return Err(io::Error::last_os_error());
+        }
+        Ok(())
+    }
+}
+
+#[cfg(not(target_os = "linux"))]
+mod sched {
+    use std::io;
+
+    pub fn set_fifo(_priority: i32) -> io::Result<()> {
+        Err(io::Error::new(io::ErrorKind::Unsupported, "needs Linux"))
+    }
+
+    pub fn set_cpu(_cpu: usize) -> io::Result<()> {
+        Err(io::Error::new(io::ErrorKind::Unsupported, "needs Linux"))
+    }
+}
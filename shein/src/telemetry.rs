@@ -0,0 +1,162 @@
+//! Decoder for the Pico's Device 0 telemetry TLV.
+//!
+//! Layout (little-endian, see protocol.md): `[status][0x00][version]`, then
+//! the bridge, bus and SPI counters, high-water marks, per-device buffer
+//! levels and a PIO snapshot. Version 2 appends ring occupancy times, version 3
+//! the bytes dropped by bus RX resyncs, version 4 the 6502 writes dropped and
+//! the TLVs NAKed. Each
+//! version only appends fields, so older frames decode with the rest zeroed.
+
+use crate::spi_master::NUM_DEVICES;
+
+/// Marker byte after the status byte; error strings never contain NUL.
+pub const TELEMETRY_MARKER: u8 = 0x00;
+
+// Decoded in full for logging/debugging; the status pane shows a subset.
+#[allow(dead_code)]
+#[derive(Clone, Debug, Default)]
+pub struct Telemetry {
+    pub uptime_ms: u32,
+
+    pub bus_to_spi_msgs: u32,
+    pub bus_to_spi_bytes: u32,
+    pub spi_to_bus_msgs: u32,
+    pub spi_to_bus_bytes: u32,
+    pub spi_to_bus_drops: u32,
+
+    pub bus_rx_bytes: u32,
+    pub bus_tx_bytes: u32,
+    pub bus_rx_overruns: u32,
+    pub bus_rx_bankruptcies: u32,
+    pub bus_empty_reads: u32,
+
+    pub spi_writes: u32,
+    pub spi_rx_bytes: u32,
+    pub spi_reads: u32,
+    pub spi_tx_bytes: u32,
+    pub spi_requests: u32,
+    pub spi_proto_errors: u32,
+    pub spi_rx_overruns: u32,
+
+    pub bus_ring_high_water: u16,
+    pub spi_queue_high_water: u16,
+    pub buf_count: [u16; NUM_DEVICES],
+    pub buf_high_water: [u16; NUM_DEVICES],
+
+    pub pio_pc: u8,
+    pub pio_tx_fifo: u8,
+    pub pio_rx_fifo: u8,
+    pub proto_state: u8,
+    /// Bit 0: dual core, bit 1: event loop, bit 2: latency stats, bit 3: bus capture,
+    /// bit 4: trace events, bit 5: USB link.
+    pub build_flags: u8,
+
+    // Version 2
+    pub spi_ring_high_water: u16,
+    /// Milliseconds each ring spent at or above the Pico's RING_HIGH_PCT.
+    pub bus_ring_high_ms: u32,
+    pub spi_ring_high_ms: u32,
+    pub spi_queue_high_ms: u32,
+    pub buf_high_ms: [u32; NUM_DEVICES],
+
+    // Version 3
+    pub bus_rx_lost: u32,
+
+    // Version 4
+    pub bus_to_spi_drops: u32,
+    /// Zero -> 6502 TLVs refused with a v8 NAK, to be sent again.
+    pub spi_to_bus_refused: u32,
+}
+
+struct Reader<'a> {
+    data: &'a [u8],
+}
+
+impl Reader<'_> {
+    fn u8(&mut self) -> Option<u8> {
+        let (&b, rest) = self.data.split_first()?;
+        self.data = rest;
+        Some(b)
+    }
+
+    fn u16(&mut self) -> Option<u16> {
+        Some(u16::from_le_bytes([self.u8()?, self.u8()?]))
+    }
+
+    fn u32(&mut self) -> Option<u32> {
+        Some(u32::from_le_bytes([self.u8()?, self.u8()?, self.u8()?, self.u8()?]))
+    }
+}
+
+/// True if a Device 0 TLV is a telemetry frame rather than an error string.
+pub fn is_telemetry(data: &[u8]) -> bool {
+    data.len() >= 3 && data[1] == TELEMETRY_MARKER
+}
+
+/// Decode a telemetry frame, or None if it is truncated. Fields newer than
+/// the frame's version are left at zero; trailing bytes (fields added by
+/// newer firmware) are ignored.
+pub fn parse(data: &[u8]) -> Option<Telemetry> {
+    if !is_telemetry(data) || data[2] == 0 {
+        return None;
+    }
+    let version = data[2];
+    let mut r = Reader { data: &data[3..] };
+    let mut t = Telemetry {
+        uptime_ms: r.u32()?,
+        bus_to_spi_msgs: r.u32()?,
+        bus_to_spi_bytes: r.u32()?,
+        spi_to_bus_msgs: r.u32()?,
+        spi_to_bus_bytes: r.u32()?,
+        spi_to_bus_drops: r.u32()?,
+        bus_rx_bytes: r.u32()?,
+        bus_tx_bytes: r.u32()?,
+        bus_rx_overruns: r.u32()?,
+        bus_rx_bankruptcies: r.u32()?,
+        bus_empty_reads: r.u32()?,
+        spi_writes: r.u32()?,
+        spi_rx_bytes: r.u32()?,
+        spi_reads: r.u32()?,
+        spi_tx_bytes: r.u32()?,
+        spi_requests: r.u32()?,
+        spi_proto_errors: r.u32()?,
+        spi_rx_overruns: r.u32()?,
+        bus_ring_high_water: r.u16()?,
+        spi_queue_high_water: r.u16()?,
+        ..Default::default()
+    };
+    for count in t.buf_count.iter_mut() {
+        *count = r.u16()?;
+    }
+    for high in t.buf_high_water.iter_mut() {
+        *high = r.u16()?;
+    }
+    t.pio_pc = r.u8()?;
+    t.pio_tx_fifo = r.u8()?;
+    t.pio_rx_fifo = r.u8()?;
+    t.proto_state = r.u8()?;
+    t.build_flags = r.u8()?;
+    if version < 2 {
+        return Some(t);
+    }
+
+    t.spi_ring_high_water = r.u16()?;
+    t.bus_ring_high_ms = r.u32()?;
+    t.spi_ring_high_ms = r.u32()?;
+    t.spi_queue_high_ms = r.u32()?;
+    for ms in t.buf_high_ms.iter_mut() {
+        *ms = r.u32()?;
+    }
+    if version < 3 {
+        return Some(t);
+    }
+
+    t.bus_rx_lost = r.u32()?;
+    if version < 4 {
+        return Some(t);
+    }
+
+    t.bus_to_spi_drops = r.u32()?;
+    t.spi_to_bus_refused = r.u32()?;
+    Some(t)
+}
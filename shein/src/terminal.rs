@@ -3,6 +3,7 @@ use vte::{Params, Parser, Perform};
 
 pub const COLS: usize = 40;
 pub const ROWS: usize = 25;
+const ALL_ROWS: u32 = (1 << ROWS) - 1;
 
 #[derive(Clone, Copy)]
 pub struct Cell {
@@ -26,6 +27,8 @@ pub struct Terminal {
     current_style: Style,
     parser: Parser,
     last_line_ending: Option<u8>,
+    /// Rows whose cells changed since `take_dirty_rows`, bit n for row n.
+    dirty_rows: u32,
 }
 
 impl Terminal {
@@ -37,9 +40,16 @@ impl Terminal {
             current_style: Style::default(),
             parser: Parser::new(),
             last_line_ending: None,
+            dirty_rows: ALL_ROWS,
         }
     }
 
+    /// Rows whose cells changed since the last call, bit n for row n.
+    /// Cursor moves alone don't count.
+    pub fn take_dirty_rows(&mut self) -> u32 {
+        std::mem::take(&mut self.dirty_rows)
+    }
+
     /// Feed raw bytes from device 2 into the terminal.
     pub fn feed(&mut self, bytes: &[u8]) {
         for &b in bytes {
@@ -62,6 +72,7 @@ impl Terminal {
             self.cells[row - 1] = self.cells[row];
         }
         self.cells[ROWS - 1] = [Cell::default(); COLS];
+        self.dirty_rows = ALL_ROWS;
     }
 
     fn advance_cursor(&mut self) {
@@ -105,6 +116,95 @@ impl Terminal {
         if self.cursor_col > 0 {
             self.cursor_col -= 1;
             self.cells[self.cursor_row][self.cursor_col] = Cell::default();
+            self.dirty_rows |= 1 << self.cursor_row;
+        }
+    }
+
+    /// Apply a device 2 screen packet, the bytes after its 0x00 marker: cell
+    /// commands as protocol.md describes under "Screen packets". Parsing
+    /// stops at the first unknown or truncated command.
+    pub fn apply_screen(&mut self, mut cmds: &[u8]) {
+        self.clear_line_ending_state();
+        while let Some((&cmd, rest)) = cmds.split_first() {
+            let args = match cmd {
+                b'G' => 2,
+                b'A' => 3,
+                b'W' => 1 + rest.first().map_or(0, |&n| n as usize),
+                b'F' => 2,
+                b'R' => 5,
+                b'C' => 6,
+                _ => return,
+            };
+            let Some(a) = rest.get(..args) else { return };
+            cmds = &rest[args..];
+            match cmd {
+                b'G' => {
+                    self.cursor_row = (a[0] as usize).min(ROWS - 1);
+                    self.cursor_col = (a[1] as usize).min(COLS - 1);
+                }
+                b'A' => self.current_style = screen_style(a[0], a[1], a[2]),
+                b'W' => {
+                    for &b in &a[1..] {
+                        if !self.put_cell(b as char) {
+                            break;
+                        }
+                    }
+                }
+                b'F' => {
+                    for _ in 0..a[0] {
+                        if !self.put_cell(a[1] as char) {
+                            break;
+                        }
+                    }
+                }
+                b'R' => {
+                    let cell = Cell { ch: a[4] as char, style: self.current_style };
+                    let (row, col) = (a[0] as usize, a[1] as usize);
+                    let end = (col + a[3] as usize).min(COLS);
+                    for r in row..(row + a[2] as usize).min(ROWS) {
+                        if col < end {
+                            self.cells[r][col..end].fill(cell);
+                            self.dirty_rows |= 1 << r;
+                        }
+                    }
+                }
+                _ => self.copy_rect(a),
+            }
+        }
+    }
+
+    /// Write one cell at the cursor and move right, on to the next row at
+    /// the end of one. Screen packets never scroll: false once the bottom
+    /// right cell is written, where the cursor then stays.
+    fn put_cell(&mut self, ch: char) -> bool {
+        self.cells[self.cursor_row][self.cursor_col] = Cell { ch, style: self.current_style };
+        self.dirty_rows |= 1 << self.cursor_row;
+        if self.cursor_col + 1 < COLS {
+            self.cursor_col += 1;
+        } else if self.cursor_row + 1 < ROWS {
+            self.cursor_col = 0;
+            self.cursor_row += 1;
+        } else {
+            return false;
+        }
+        true
+    }
+
+    /// ['C', row, col, h, w, to_row, to_col]: copy a rectangle of cells,
+    /// clipped to the screen at both ends. The regions may overlap, as when
+    /// scrolling part of the screen.
+    fn copy_rect(&mut self, a: &[u8]) {
+        let (row, col, to_row, to_col) = (a[0] as usize, a[1] as usize, a[4] as usize, a[5] as usize);
+        let h = (a[2] as usize).min(ROWS.saturating_sub(row)).min(ROWS.saturating_sub(to_row));
+        let w = (a[3] as usize).min(COLS.saturating_sub(col)).min(COLS.saturating_sub(to_col));
+        if h == 0 || w == 0 {
+            return;
+        }
+        let rows: Vec<usize> = if to_row > row { (0..h).rev().collect() } else { (0..h).collect() };
+        for i in rows {
+            let src = self.cells[row + i];
+            self.cells[to_row + i][to_col..to_col + w].copy_from_slice(&src[col..col + w]);
+            self.dirty_rows |= 1 << (to_row + i);
         }
     }
 
@@ -203,6 +303,7 @@ impl Terminal {
                 for row in (self.cursor_row + 1)..ROWS {
                     self.cells[row] = [Cell::default(); COLS];
                 }
+                self.dirty_rows |= ALL_ROWS & !((1 << self.cursor_row) - 1);
             }
             1 => {
                 // Erase from start to cursor
@@ -212,16 +313,19 @@ impl Terminal {
                 for col in 0..=self.cursor_col {
                     self.cells[self.cursor_row][col] = Cell::default();
                 }
+                self.dirty_rows |= (2 << self.cursor_row) - 1;
             }
             2 | 3 => {
                 // Erase entire display
                 self.cells = [[Cell::default(); COLS]; ROWS];
+                self.dirty_rows = ALL_ROWS;
             }
             _ => {}
         }
     }
 
     fn erase_in_line(&mut self, mode: u16) {
+        self.dirty_rows |= 1 << self.cursor_row;
         match mode {
             0 => {
                 // Erase from cursor to end of line
@@ -244,6 +348,23 @@ impl Terminal {
     }
 }
 
+/// The style a screen packet's ['A', attr, fg, bg] selects: attr bits 0-3
+/// bold, italic, underline and reverse, colors as SGR 38;5 indexes them,
+/// 0xFF for the default.
+fn screen_style(attr: u8, fg: u8, bg: u8) -> Style {
+    let color = |c: u8| if c == 0xFF { Color::Reset } else { Color::Indexed(c) };
+    let mut style = Style::default().fg(color(fg)).bg(color(bg));
+    for (bit, modifier) in [Modifier::BOLD, Modifier::ITALIC, Modifier::UNDERLINED, Modifier::REVERSED]
+        .into_iter()
+        .enumerate()
+    {
+        if attr & 1 << bit != 0 {
+            style = style.add_modifier(modifier);
+        }
+    }
+    style
+}
+
 /// Parse extended color from remaining SGR params after a 38 or 48.
 /// Returns (Color, number_of_params_consumed) or None.
 fn parse_extended_color(rest: &[u16]) -> Option<(Color, usize)> {
@@ -271,6 +392,7 @@ impl Perform for Terminal {
                 ch: c,
                 style: self.current_style,
             };
+            self.dirty_rows |= 1 << self.cursor_row;
         }
         self.advance_cursor();
     }
@@ -378,6 +500,20 @@ mod tests {
         assert_eq!(terminal.cursor_col, 1);
     }
 
+    #[test]
+    fn only_changed_rows_are_dirty() {
+        let mut terminal = Terminal::new();
+        terminal.feed(b"A\r\nB");
+        terminal.take_dirty_rows();
+
+        terminal.feed(b"\x1b[3;1HC\x1b[1;5H");
+        assert_eq!(terminal.take_dirty_rows(), 1 << 2);
+        assert_eq!(terminal.take_dirty_rows(), 0);
+
+        terminal.feed(b"\x1b[2J");
+        assert_eq!(terminal.take_dirty_rows(), super::ALL_ROWS);
+    }
+
     #[test]
     fn lfcr_is_a_single_line_break() {
         let mut terminal = Terminal::new();
@@ -388,4 +524,27 @@ mod tests {
         assert_eq!(terminal.cursor_row, 1);
         assert_eq!(terminal.cursor_col, 1);
     }
+
+    #[test]
+    fn screen_packets_fill_and_copy_cells() {
+        let mut terminal = Terminal::new();
+        terminal.take_dirty_rows();
+
+        // Row 1 "abc", a run of '-' wrapping from the end of row 2, then
+        // rows 1-3 copied down one (overlapping) and row 1 cleared.
+        terminal.apply_screen(b"G\x01\x00W\x03abcG\x02\x26F\x04-");
+        terminal.apply_screen(b"C\x01\x00\x03\x28\x02\x00R\x01\x00\x01\x28 ");
+        assert_eq!(terminal.take_dirty_rows(), 0b11110);
+        assert_eq!(terminal.cells[1][0].ch, ' ');
+        assert_eq!(terminal.cells[2][2].ch, 'c');
+        assert_eq!(terminal.cells[3][38].ch, '-');
+        assert_eq!(terminal.cells[4][1].ch, '-');
+        assert_eq!(terminal.cells[4][2].ch, ' ');
+        assert_eq!((terminal.cursor_row, terminal.cursor_col), (3, 2));
+
+        // Writes stop at the bottom right cell instead of scrolling.
+        terminal.apply_screen(b"G\x18\x27W\x02xy");
+        assert_eq!(terminal.cells[24][39].ch, 'x');
+        assert_eq!(terminal.cells[0][0].ch, ' ');
+    }
 }
@@ -0,0 +1,77 @@
+//! Device trace recorder: every TLV between the 6502's devices and this
+//! side, timed in microseconds, in the format protocol.md describes under
+//! "Device traces". emu-core's emu-replay plays one back, and its
+//! emu-perfetto lines one up with the Pico's events for a timeline.
+
+use std::fs::File;
+use std::io::{self, BufWriter, Write};
+use std::path::{Path, PathBuf};
+use std::time::Instant;
+
+const TRACE_MAGIC: &[u8; 4] = b"MBTR";
+const TRACE_VERSION: u8 = 1;
+const UNIT_MICROS: u8 = 1;
+
+/// Record kinds.
+pub const KIND_WRITE: u8 = 0; // 6502 wrote a TLV (as READ brought it here)
+pub const KIND_HOST: u8 = 2; // Data for a device (as a WRITE frame took it)
+pub const KIND_EVENT: u8 = 3; // An SPI transaction of ours, timed at its end
+pub const KIND_BRIDGE_EVENTS: u8 = 4; // A Device 1 ['T'] batch, less the 'T'
+
+/// KIND_EVENT events, numbered as the Pico's (bridge/events.h).
+pub const EVT_SPI_WRITE: u8 = 3;
+pub const EVT_SPI_REQUEST: u8 = 4;
+pub const EVT_SPI_READ: u8 = 5;
+
+pub struct TraceRecorder {
+    out: BufWriter<File>,
+    pub path: PathBuf,
+    start: Instant,
+    last: u64,
+}
+
+impl TraceRecorder {
+    pub fn create(path: &Path) -> io::Result<Self> {
+        let mut out = BufWriter::new(File::create(path)?);
+        out.write_all(TRACE_MAGIC)?;
+        out.write_all(&[TRACE_VERSION, UNIT_MICROS])?;
+        Ok(Self { out, path: path.to_path_buf(), start: Instant::now(), last: 0 })
+    }
+
+    pub fn record(&mut self, kind: u8, device: u8, data: &[u8]) -> io::Result<()> {
+        self.record_at(Instant::now(), kind, device, data)
+    }
+
+    /// Record at `at` rather than now (never before the last record).
+    pub fn record_at(&mut self, at: Instant, kind: u8, device: u8, data: &[u8]) -> io::Result<()> {
+        let now = at.saturating_duration_since(self.start).as_micros() as u64;
+        let mut delta = now.saturating_sub(self.last);
+        self.last = self.last.max(now);
+        let mut head = Vec::with_capacity(13);
+        while delta >= 0x80 {
+            head.push(delta as u8 | 0x80);
+            delta >>= 7;
+        }
+        head.push(delta as u8);
+        let len = data.len().min(255);
+        head.extend_from_slice(&[kind, device, len as u8]);
+        self.out.write_all(&head)?;
+        self.out.write_all(&data[..len])
+    }
+
+    /// A KIND_EVENT record of an SPI transaction from `start` to `end`:
+    /// [event][arg LE16][duration us LE32].
+    pub fn event(&mut self, event: u8, device: u8, arg: u16, start: Instant, end: Instant) -> io::Result<()> {
+        let us = end.saturating_duration_since(start).as_micros().min(u32::MAX as u128) as u32;
+        let mut data = [0u8; 7];
+        data[0] = event;
+        data[1..3].copy_from_slice(&arg.to_le_bytes());
+        data[3..].copy_from_slice(&us.to_le_bytes());
+        self.record_at(end, KIND_EVENT, device, &data)
+    }
+
+    pub fn finish(mut self) -> io::Result<PathBuf> {
+        self.out.flush()?;
+        Ok(self.path)
+    }
+}
@@ -4,6 +4,8 @@ use ratatui::style::{Color, Style};
 use ratatui::text::{Line, Span};
 use ratatui::widgets::{Block, Borders, Paragraph, Wrap};
 
+use crate::pixels::{Pixels, TILE};
+use crate::telemetry::Telemetry;
 use crate::terminal::{COLS, ROWS, Terminal};
 
 const PANE_HEIGHT: u16 = ROWS as u16 + 2; // 25 content rows + 2 border rows
@@ -15,9 +17,13 @@ pub struct StatusInfo {
     pub buf: [u16; super::NUM_DEVICES],
     pub connected: bool,
     pub verbose: bool,
+    /// A device trace is recording (F2).
+    pub tracing: bool,
+    /// Last telemetry snapshot from the Pico.
+    pub telemetry: Option<Telemetry>,
 }
 
-pub fn draw(frame: &mut Frame, terminal: &Terminal, status: &StatusInfo, log: &[String]) {
+pub fn draw(frame: &mut Frame, terminal: &TerminalView, status: &StatusInfo, log: &[String]) {
     let area = frame.area();
     if area.height < MIN_HEIGHT || area.width < MIN_WIDTH {
         let msg = format!(
@@ -51,23 +57,110 @@ pub fn draw(frame: &mut Frame, terminal: &Terminal, status: &StatusInfo, log: &[
     draw_log(frame, log, outer[1]);
 }
 
-fn draw_terminal(frame: &mut Frame, terminal: &Terminal, area: Rect) {
-    let mut lines = Vec::with_capacity(ROWS);
-    for (row_idx, row) in terminal.cells.iter().enumerate() {
-        let mut spans = Vec::new();
-        for (col_idx, cell) in row.iter().enumerate() {
-            let mut style = cell.style;
-            // Show cursor as reversed
-            if row_idx == terminal.cursor_row && col_idx == terminal.cursor_col {
-                style = style.fg(Color::Black).bg(Color::White);
+/// The terminal pane's lines, rebuilt only for rows that changed.
+pub struct TerminalView {
+    lines: Vec<Line<'static>>,
+    cursor: (usize, usize),
+    /// The lines are of the pixel framebuffer, not the text grid.
+    pixels: bool,
+}
+
+impl TerminalView {
+    pub fn new() -> Self {
+        Self {
+            lines: vec![Line::default(); ROWS],
+            cursor: (0, 0),
+            pixels: false,
+        }
+    }
+
+    /// Catch up with `terminal`, or `pixels` if they're shown: the dirty
+    /// rows, the rows the cursor left and moved to, and all of them when
+    /// the pane switches between the two.
+    pub fn sync(&mut self, terminal: &mut Terminal, pixels: &mut Pixels) {
+        if pixels.shown {
+            let mut dirty = pixels.take_dirty_tile_rows();
+            if !self.pixels {
+                dirty = !0;
+                self.pixels = true;
+            }
+            for row in 0..ROWS {
+                if dirty & (1 << row) != 0 {
+                    self.lines[row] = pixel_line(pixels, row);
+                }
+            }
+            return;
+        }
+        let mut dirty = terminal.take_dirty_rows();
+        if self.pixels {
+            dirty = !0;
+            self.pixels = false;
+        }
+        let cursor = (terminal.cursor_row, terminal.cursor_col);
+        if cursor != self.cursor {
+            dirty |= 1 << self.cursor.0 | 1 << cursor.0;
+            self.cursor = cursor;
+        }
+        for row in 0..ROWS {
+            if dirty & (1 << row) != 0 {
+                self.lines[row] = row_line(terminal, row);
             }
-            spans.push(Span::styled(String::from(cell.ch), style));
         }
-        lines.push(Line::from(spans));
     }
+}
 
-    let block = Block::default().title(" Terminal ").borders(Borders::ALL);
-    let paragraph = Paragraph::new(lines).block(block);
+/// One terminal row as a span per run of same-styled cells.
+fn row_line(terminal: &Terminal, row_idx: usize) -> Line<'static> {
+    let mut spans = Vec::new();
+    let mut text = String::new();
+    let mut run_style = None;
+    for (col_idx, cell) in terminal.cells[row_idx].iter().enumerate() {
+        let mut style = cell.style;
+        // Show cursor as reversed
+        if row_idx == terminal.cursor_row && col_idx == terminal.cursor_col {
+            style = style.fg(Color::Black).bg(Color::White);
+        }
+        if run_style.is_some_and(|s| s != style) {
+            spans.push(Span::styled(std::mem::take(&mut text), run_style.unwrap()));
+        }
+        run_style = Some(style);
+        text.push(cell.ch);
+    }
+    if let Some(style) = run_style {
+        spans.push(Span::styled(text, style));
+    }
+    Line::from(spans)
+}
+
+/// One row of tiles as half blocks, a cell each: the pixels a quarter and
+/// three quarters of the way down the tile, from its middle column. F3
+/// saves the frame at full size.
+fn pixel_line(pixels: &Pixels, row: usize) -> Line<'static> {
+    let mut spans = Vec::new();
+    let mut text = String::new();
+    let mut run_style = None;
+    for col in 0..COLS {
+        let x = col * TILE + TILE / 2;
+        let [r, g, b] = pixels.rgb(x, row * TILE + TILE / 4);
+        let top = Color::Rgb(r, g, b);
+        let [r, g, b] = pixels.rgb(x, row * TILE + TILE * 3 / 4);
+        let style = Style::default().fg(top).bg(Color::Rgb(r, g, b));
+        if run_style.is_some_and(|s| s != style) {
+            spans.push(Span::styled(std::mem::take(&mut text), run_style.unwrap()));
+        }
+        run_style = Some(style);
+        text.push('\u{2580}');
+    }
+    if let Some(style) = run_style {
+        spans.push(Span::styled(text, style));
+    }
+    Line::from(spans)
+}
+
+fn draw_terminal(frame: &mut Frame, view: &TerminalView, area: Rect) {
+    let title = if view.pixels { " Pixels " } else { " Terminal " };
+    let block = Block::default().title(title).borders(Borders::ALL);
+    let paragraph = Paragraph::new(view.lines.clone()).block(block);
     frame.render_widget(paragraph, area);
 }
 
@@ -82,12 +175,16 @@ fn draw_status(frame: &mut Frame, status: &StatusInfo, area: Rect) {
             "Verbose: {}",
             if status.verbose { "ON" } else { "off" }
         )),
+        Line::from(format!(
+            "Trace: {}",
+            if status.tracing { "ON" } else { "off" }
+        )),
         Line::from(""),
         Line::from("Devices:"),
     ];
 
     let device_names = [
-        "Status", "System", "Video/KB", "Netboot", "Network", "Free", "Free", "Echo",
+        "Status", "System", "Video/KB", "Netboot", "Network", "Blockload", "FileRead", "Echo",
     ];
     for (i, name) in device_names.iter().enumerate() {
         let active = status.device_status & (1 << i) != 0;
@@ -99,14 +196,54 @@ fn draw_status(frame: &mut Frame, status: &StatusInfo, area: Rect) {
             Style::default().fg(Color::DarkGray)
         };
         lines.push(Line::styled(
-            format!(" {marker} {i}: {name:<8} [{buf_val:>4}]"),
+            format!(" {marker} {i}: {name:<8} [{buf_val:>5}]"),
             style,
         ));
     }
 
+    if let Some(t) = &status.telemetry {
+        lines.push(Line::from(""));
+        lines.push(Line::from(format!("Pico up {}s", t.uptime_ms / 1000)));
+        lines.push(Line::from(format!(
+            " 6502->Z {} / Z->6502 {}",
+            t.bus_to_spi_msgs, t.spi_to_bus_msgs
+        )));
+        let faults = t.bus_rx_overruns + t.bus_rx_bankruptcies + t.spi_rx_overruns;
+        let drops = t.spi_to_bus_drops + t.bus_to_spi_drops;
+        let style = if faults + drops + t.spi_proto_errors > 0 {
+            Style::default().fg(Color::Red)
+        } else {
+            Style::default()
+        };
+        lines.push(Line::styled(
+            format!(
+                " drops {} err {} ovr {} lost {}",
+                drops, t.spi_proto_errors, faults, t.bus_rx_lost
+            ),
+            style,
+        ));
+        if t.spi_to_bus_refused > 0 {
+            lines.push(Line::from(format!(" refused {} (resent)", t.spi_to_bus_refused)));
+        }
+        lines.push(Line::from(format!(
+            " peak ring {}/{} queue {}",
+            t.bus_ring_high_water, t.spi_ring_high_water, t.spi_queue_high_water
+        )));
+        let high_ms = t.bus_ring_high_ms
+            + t.spi_ring_high_ms
+            + t.spi_queue_high_ms
+            + t.buf_high_ms.iter().sum::<u32>();
+        if high_ms > 0 {
+            lines.push(Line::styled(
+                format!(" rings high {high_ms}ms"),
+                Style::default().fg(Color::Yellow),
+            ));
+        }
+    }
+
     lines.push(Line::from(""));
     lines.push(Line::styled(
-        "F1 verbose | Ctrl-C quit",
+        "F1 verbose | F2 trace | F3 snapshot | F4 capture | Ctrl-C quit",
         Style::default().fg(Color::DarkGray),
     ));
 
@@ -0,0 +1,170 @@
+//! The bridge's USB link (protocol.md, "USB Link"): a bridge built with
+//! BRIDGE_USB_LINK talks over its USB serial port instead of SPI, so shein
+//! can drive it from any Linux machine with `shein --usb /dev/ttyACM0`.
+//!
+//! Each way the stream is TLVs back to back, with no framing around them.
+//! A reader thread queues what arrives and wakes the IRQ thread, standing
+//! in for the IRQ line; `SpiMaster` takes whole TLVs from the queue.
+
+use std::collections::VecDeque;
+use std::fs::{File, OpenOptions};
+use std::io::{self, Read, Write};
+use std::path::{Path, PathBuf};
+use std::process::Command;
+use std::sync::{Arc, Condvar, Mutex};
+use std::thread;
+use std::time::{Duration, Instant};
+
+use anyhow::{Context, Result};
+
+/// How often a port that went away (Pico reset or unplugged) is tried again.
+const REOPEN_INTERVAL: Duration = Duration::from_millis(100);
+
+#[derive(Default)]
+struct Rx {
+    bytes: VecDeque<u8>,
+    /// Bytes arrived since the IRQ thread last looked.
+    fresh: bool,
+}
+
+struct Shared {
+    path: PathBuf,
+    rx: Mutex<Rx>,
+    arrived: Condvar,
+    /// None while the port is gone; writes are then dropped, as SPI WRITEs
+    /// to a Pico that isn't listening are.
+    writer: Mutex<Option<File>>,
+}
+
+#[derive(Clone)]
+pub struct UsbPort {
+    shared: Arc<Shared>,
+}
+
+/// Open the port and put the tty in raw mode, so the TLV bytes pass through
+/// untouched.
+fn open_port(path: &Path) -> io::Result<File> {
+    let file = OpenOptions::new().read(true).write(true).open(path)?;
+    let status = Command::new("stty")
+        .arg("-F")
+        .arg(path)
+        .args(["raw", "-echo"])
+        .status()?;
+    if !status.success() {
+        return Err(io::Error::other("stty failed"));
+    }
+    Ok(file)
+}
+
+/// Bytes at the front of `bytes` that are whole TLVs, at most `max`.
+fn whole_tlvs(bytes: &VecDeque<u8>, max: usize) -> usize {
+    let mut pos = 0;
+    while pos + 2 <= bytes.len() {
+        let end = pos + 2 + bytes[pos + 1] as usize;
+        if end > bytes.len() || end > max {
+            break;
+        }
+        pos = end;
+    }
+    pos
+}
+
+impl UsbPort {
+    pub fn open(path: &str) -> Result<Self> {
+        let path = PathBuf::from(path);
+        let file = open_port(&path).with_context(|| format!("Failed to open {}", path.display()))?;
+        let writer = file.try_clone().context("Failed to open USB port for writing")?;
+        let shared = Arc::new(Shared {
+            path,
+            rx: Mutex::new(Rx::default()),
+            arrived: Condvar::new(),
+            writer: Mutex::new(Some(writer)),
+        });
+        let reader = Arc::clone(&shared);
+        thread::spawn(move || read_port(reader, file));
+        Ok(Self { shared })
+    }
+
+    /// Send TLVs. Dropped while the port is gone.
+    pub fn write(&self, payload: &[u8]) -> Result<()> {
+        let mut writer = self.shared.writer.lock().unwrap();
+        if let Some(file) = writer.as_mut() {
+            if file.write_all(payload).is_err() {
+                *writer = None;
+            }
+        }
+        Ok(())
+    }
+
+    /// Wait up to `timeout` for whole TLVs and move them, at most `max`
+    /// bytes, into `frame`, which is left empty if none came. Returns
+    /// whether more whole TLVs are already waiting.
+    pub fn read_tlvs(&self, timeout: Duration, frame: &mut Vec<u8>, max: usize) -> bool {
+        let deadline = Instant::now() + timeout;
+        let mut rx = self.shared.rx.lock().unwrap();
+        loop {
+            let n = whole_tlvs(&rx.bytes, max);
+            let left = deadline.saturating_duration_since(Instant::now());
+            if n > 0 || left.is_zero() {
+                frame.clear();
+                frame.extend(rx.bytes.drain(..n));
+                return whole_tlvs(&rx.bytes, usize::MAX) > 0;
+            }
+            rx = self.shared.arrived.wait_timeout(rx, left).unwrap().0;
+        }
+    }
+
+    /// A whole TLV is waiting: the IRQ line's level.
+    pub fn has_tlv(&self) -> bool {
+        whole_tlvs(&self.shared.rx.lock().unwrap().bytes, usize::MAX) > 0
+    }
+
+    /// Wait up to `timeout` for bytes to arrive: the IRQ line's falling
+    /// edge.
+    pub fn wait_fresh(&self, timeout: Duration) -> bool {
+        let rx = self.shared.rx.lock().unwrap();
+        let (rx, _) = self
+            .shared
+            .arrived
+            .wait_timeout_while(rx, timeout, |rx| !rx.fresh)
+            .unwrap();
+        rx.fresh
+    }
+
+    pub fn consume_fresh(&self) {
+        self.shared.rx.lock().unwrap().fresh = false;
+    }
+}
+
+/// The reader thread: queue what arrives, and when the port goes away wait
+/// for it to come back. A TLV cut short by that is dropped; the whole ones
+/// before it (a reset's 'R' among them) are kept.
+fn read_port(shared: Arc<Shared>, mut file: File) {
+    let mut buf = [0u8; 4096];
+    loop {
+        match file.read(&mut buf) {
+            Ok(n) if n > 0 => {
+                let mut rx = shared.rx.lock().unwrap();
+                rx.bytes.extend(&buf[..n]);
+                rx.fresh = true;
+                shared.arrived.notify_all();
+            }
+            Err(e) if e.kind() == io::ErrorKind::Interrupted => {}
+            _ => {
+                *shared.writer.lock().unwrap() = None;
+                {
+                    let mut rx = shared.rx.lock().unwrap();
+                    let keep = whole_tlvs(&rx.bytes, usize::MAX);
+                    rx.bytes.truncate(keep);
+                }
+                file = loop {
+                    thread::sleep(REOPEN_INTERVAL);
+                    if let Ok(f) = open_port(&shared.path) {
+                        break f;
+                    }
+                };
+                *shared.writer.lock().unwrap() = file.try_clone().ok();
+            }
+        }
+    }
+}